@@ -0,0 +1,612 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# DOTT agent which runs on a host with attached boards (lab machine) and makes these boards available to DOTT
+# sessions running on other hosts (e.g., a central CI runner; config option dott_agent_addr in dott.ini). For each
+# session the agent launches the J-Link GDB server of the requested board and hands over a pre-started GDB instance
+# (see dottmi.gdb_broker) which connects to it. Hence, all latency-critical traffic (GDB remote protocol, intercept
+# point handling in GDB) stays on the lab machine.
+# All traffic between session and agent is multiplexed over a single TCP connection (see ChannelMux):
+#   CTRL ... JSON requests and responses (target setup, intercept channel setup, file transfers)
+#   MI   ... GDB's MI input/output (relayed 1:1)
+#   BP   ... the intercept point channel between GDB and DOTT (relayed 1:1)
+#   MEM  ... binary live memory access requests which are served by the agent via pylink (see AgentTargetDirect)
+# Memory requests carry a sequence number and are pipelined, i.e., a batch of requests costs a single network round
+# trip (see AgentTargetDirect.mem_read_batch). Files referenced by GDB commands (ELF, hex files) are transferred
+# once and cached by the agent by content hash.
+# Note: The agent relies on the GDB broker which is only supported on POSIX hosts.
+#
+# Usage: python -m dottmi.agent [--gdb <gdb client binary>] [--gdb-server <J-Link GDB server binary>]
+#                               [--jlink-path <J-Link installation>] [--port <port>] [--pool-size <n>]
+
+import argparse
+import base64
+import contextlib
+import hashlib
+import json
+import logging
+import os
+import platform
+import queue
+import socket
+import struct
+import tempfile
+import threading
+from pathlib import Path, PurePosixPath
+from typing import Callable, Dict, Iterator, List, Tuple
+
+import dottmi.target  # note: dottmi.target and dottmi.gdb import each other; dottmi.target must be loaded first
+from dottmi.dott import DottConf
+from dottmi.dottexceptions import DottConnectionError, DottException
+from dottmi.gdb import GdbServerJLink, PortReservation
+from dottmi.gdb_broker import GdbBroker
+from dottmi.gdb_shared import BpSharedConf
+from dottmi.utils import BlockingDict, log, log_setup
+
+CH_CTRL = 0
+CH_MI = 1
+CH_BP = 2
+CH_MEM = 3
+
+# memory access operations (see AgentTargetDirect)
+OP_READ = 0
+OP_READ32 = 1
+OP_WRITE32 = 2
+OP_SCATTER = 3
+
+
+# -------------------------------------------------------------------------------------------------
+class ChannelMux(object):
+    """
+    Multiplexes several byte channels over one stream socket. Each frame consists of the channel number (1 byte),
+    the payload length (4 bytes) and the payload. An empty payload signals the end of a (relayed) channel.
+    """
+    FRAME_HDR = struct.Struct('>BI')
+
+    def __init__(self, sock: socket.socket) -> None:
+        self._sock: socket.socket = sock
+        if sock.family in (socket.AF_INET, socket.AF_INET6):
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self._send_lock: threading.Lock = threading.Lock()
+        self._handlers: Dict[int, Callable[[bytes], None]] = {}
+        self._close_listeners: List[Callable[[], None]] = []
+
+    def set_handler(self, channel: int, handler: Callable[[bytes], None]) -> None:
+        """
+        Sets the function which is called (in the context of the receive loop) with the payload of each frame
+        received on the given channel.
+        """
+        self._handlers[channel] = handler
+
+    def add_close_listener(self, listener: Callable[[], None]) -> None:
+        self._close_listeners.append(listener)
+
+    def send(self, channel: int, data: bytes) -> None:
+        with self._send_lock:
+            self._sock.sendall(ChannelMux.FRAME_HDR.pack(channel, len(data)) + data)
+
+    def attach(self, channel: int, sock: socket.socket) -> None:
+        """
+        Relays the given (local) socket to the channel in both directions.
+        """
+        def on_data(data: bytes) -> None:
+            try:
+                if len(data) == 0:
+                    sock.shutdown(socket.SHUT_WR)
+                else:
+                    sock.sendall(data)
+            except OSError:
+                pass
+
+        def forward() -> None:
+            try:
+                while True:
+                    data = sock.recv(65536)
+                    if not data:
+                        break
+                    self.send(channel, data)
+                self.send(channel, b'')
+            except OSError:
+                pass
+
+        self.set_handler(channel, on_data)
+        threading.Thread(target=forward, name=f'ChannelMuxForward{channel}', daemon=True).start()
+
+    def _recv_exact(self, num_bytes: int) -> bytes:
+        data = b''
+        while len(data) < num_bytes:
+            chunk = self._sock.recv(num_bytes - len(data))
+            if not chunk:
+                raise ConnectionError('Connection closed.')
+            data += chunk
+        return data
+
+    def run(self) -> None:
+        """
+        Receive loop which dispatches the received frames to the channel handlers until the connection is closed.
+        """
+        try:
+            while True:
+                channel, length = ChannelMux.FRAME_HDR.unpack(self._recv_exact(ChannelMux.FRAME_HDR.size))
+                payload = self._recv_exact(length) if length > 0 else b''
+                handler = self._handlers.get(channel)
+                if handler is not None:
+                    handler(payload)
+        except (OSError, ConnectionError, struct.error):
+            pass
+        finally:
+            for listener in self._close_listeners:
+                listener()
+
+    def start(self) -> None:
+        threading.Thread(target=self.run, name='ChannelMux', daemon=True).start()
+
+    def close(self) -> None:
+        try:
+            self._sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self._sock.close()
+
+
+# -------------------------------------------------------------------------------------------------
+class _AgentSession(object):
+    """
+    Agent-side state of one DOTT session (i.e., one target).
+    """
+    def __init__(self, agent: 'DottAgent', conn: socket.socket) -> None:
+        self._agent: 'DottAgent' = agent
+        self._mux: ChannelMux = ChannelMux(conn)
+        self._gdb_server: GdbServerJLink = None
+        self._gdb_proc = None
+        self._device_name: str = None
+        self._jlink_serial: str = None
+        self._live = None
+        self._mem_queue: queue.Queue = queue.Queue()
+        self._bp_srv: socket.socket = None
+
+    def serve(self) -> None:
+        self._mux.set_handler(CH_CTRL, self._on_ctrl)
+        self._mux.set_handler(CH_MEM, self._mem_queue.put)
+        threading.Thread(target=self._mem_loop, name='DottAgentMem', daemon=True).start()
+        try:
+            self._mux.run()
+        finally:
+            self._mem_queue.put(None)
+            self._cleanup()
+
+    def _cleanup(self) -> None:
+        if self._bp_srv is not None:
+            self._bp_srv.close()
+        if self._gdb_proc is not None:
+            if self._gdb_proc.poll() is None:
+                self._gdb_proc.kill()
+            self._gdb_proc.wait()
+        if self._live is not None:
+            self._live.disconnect()
+        if self._gdb_server is not None:
+            self._gdb_server.shutdown()
+        self._mux.close()
+        log.info(f'Session for {self._device_name} (SN: {self._jlink_serial}) closed.')
+
+    def _on_ctrl(self, data: bytes) -> None:
+        req = json.loads(data)
+        try:
+            res = getattr(self, f'_op_{req["op"]}')(req)
+            res['ok'] = True
+        except Exception as ex:
+            res = {'ok': False, 'error': str(ex)}
+        res['id'] = req.get('id')
+        self._mux.send(CH_CTRL, json.dumps(res).encode())
+
+    def _op_open(self, req: Dict) -> Dict:
+        if self._gdb_server is not None:
+            raise DottException('Target of this session is already open.')
+        self._device_name = req['device_name']
+        self._jlink_serial = req.get('jlink_serial')
+        reservation = self._agent.reserve_ports()
+        self._gdb_server = GdbServerJLink(self._agent.gdb_server_binary, None, reservation.port, self._device_name,
+                                          req.get('interface', 'SWD'), req.get('endian', 'little'),
+                                          req.get('speed', '15000'), self._jlink_serial,
+                                          port_reservation=reservation)
+        self._gdb_proc = self._agent.get_gdb()
+
+        def gdb_out() -> None:
+            try:
+                while True:
+                    data = os.read(self._gdb_proc.stdout.fileno(), 65536)
+                    if not data:
+                        break
+                    self._mux.send(CH_MI, data)
+            except OSError:
+                pass
+            self._mux.close()  # GDB has terminated; the session ends
+
+        def gdb_in(data: bytes) -> None:
+            try:
+                while data:
+                    data = data[os.write(self._gdb_proc.stdin.fileno(), data):]
+            except OSError:
+                pass
+
+        self._mux.set_handler(CH_MI, gdb_in)
+        threading.Thread(target=gdb_out, name='DottAgentMi', daemon=True).start()
+        log.info(f'Session for {self._device_name} (SN: {self._jlink_serial}) opened (GDB pid {self._gdb_proc.pid}, '
+                 f'GDB server port {self._gdb_server.port}).')
+        return {'gdb_server_port': self._gdb_server.port}
+
+    def _op_bp_channel(self, req: Dict) -> Dict:
+        # GDB connects to this (agent-local) endpoint; the connection is relayed to the session's BP channel
+        self._bp_srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self._bp_srv.bind((BpSharedConf.GDB_CMD_SERVER_ADDR, 0))
+        self._bp_srv.listen(1)
+        self._bp_srv.settimeout(DottAgent.BP_CONNECT_TIMEOUT_SEC)
+
+        def accept() -> None:
+            try:
+                conn, _ = self._bp_srv.accept()
+            except OSError:
+                return
+            finally:
+                self._bp_srv.close()
+            conn.settimeout(None)
+            conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            self._mux.attach(CH_BP, conn)
+
+        threading.Thread(target=accept, name='DottAgentBpAccept', daemon=True).start()
+        return {'endpoint': str(self._bp_srv.getsockname()[1])}
+
+    def _op_file(self, req: Dict) -> Dict:
+        path = self._agent.cached_file(req['sha1'], req['name'])
+        return {'path': path} if path is not None else {'missing': True}
+
+    def _op_put_file(self, req: Dict) -> Dict:
+        return {'path': self._agent.store_file(req['sha1'], req['name'], base64.b64decode(req['data']))}
+
+    def _mem_loop(self) -> None:
+        while True:
+            data = self._mem_queue.get()
+            if data is None:
+                return
+            seq, op = AgentTargetDirect.REQ_HDR.unpack_from(data)
+            body = data[AgentTargetDirect.REQ_HDR.size:]
+            try:
+                res = self._mem_op(op, body)
+                status = 0
+            except Exception as ex:
+                res = str(ex).encode()
+                status = 1
+            try:
+                self._mux.send(CH_MEM, AgentTargetDirect.RESP_HDR.pack(seq, status) + res)
+            except OSError:
+                return
+
+    def _mem_op(self, op: int, body: bytes) -> bytes:
+        if self._live is None:
+            from dottmi.pylinkdott import TargetDirect
+            self._live = TargetDirect(self._device_name, jlink_serial=self._jlink_serial)
+        if op == OP_READ:
+            addr, num_bytes = struct.unpack('>II', body)
+            return self._live.mem_read(addr, num_bytes)
+        if op == OP_READ32:
+            addr, cnt = struct.unpack('>II', body)
+            words = self._live.mem_read_32(addr, cnt)
+            words = [words] if cnt == 1 else words
+            return struct.pack(f'<{len(words)}I', *words)
+        if op == OP_WRITE32:
+            addr, = struct.unpack_from('>I', body)
+            words = struct.unpack(f'<{(len(body) - 4) // 4}I', body[4:])
+            return struct.pack('>I', self._live.mem_write_32(addr, list(words)))
+        if op == OP_SCATTER:
+            addrs = struct.unpack(f'<{len(body) // 4}I', body)
+            words = self._live.mem_read_scatter(list(addrs))
+            return struct.pack(f'<{len(words)}I', *words)
+        raise DottException(f'Unknown memory operation {op}.')
+
+
+class DottAgent(GdbBroker):
+    # default TCP port the agent listens on
+    DEFAULT_PORT = 20092
+
+    # time GDB is given to connect to the intercept point channel endpoint
+    BP_CONNECT_TIMEOUT_SEC = 5
+
+    def __init__(self, gdb_client_binary: str, gdb_server_binary: str, port: int = DEFAULT_PORT, pool_size: int = 2,
+                 addr: str = '0.0.0.0', first_srv_port: int = 2331) -> None:
+        super().__init__(gdb_client_binary, port, pool_size, addr)
+        self._gdb_server_binary: str = gdb_server_binary
+        self._first_srv_port: int = first_srv_port
+        self._next_srv_port: int = first_srv_port
+        self._lock: threading.Lock = threading.Lock()
+        self._file_dir: str = tempfile.mkdtemp(prefix='dott_agent_')
+
+    @property
+    def gdb_server_binary(self) -> str:
+        return self._gdb_server_binary
+
+    def get_gdb(self):
+        return self._get_gdb()
+
+    def reserve_ports(self) -> PortReservation:
+        # see Dott._reserve_srv_ports; the agent hands out the ports of all its sessions
+        with self._lock:
+            port = self._next_srv_port
+            wrapped = False
+            while True:
+                if port + 2 >= 65535:
+                    if wrapped:
+                        raise DottException('Unable do find three (consecutive) free ports!')
+                    port, wrapped = self._first_srv_port, True
+                try:
+                    reservation = PortReservation('127.0.0.1', port, 3)
+                    break
+                except OSError as ex:
+                    port += getattr(ex, 'offset', 0) + 1
+            self._next_srv_port = port + 3
+            return reservation
+
+    def _file_path(self, sha1: str, name: str) -> Path:
+        return Path(self._file_dir, sha1, os.path.basename(name))
+
+    def cached_file(self, sha1: str, name: str) -> str:
+        path = self._file_path(sha1, name)
+        # note: GDB expects paths to be POSIX-formatted
+        return str(PurePosixPath(path)) if path.exists() else None
+
+    def store_file(self, sha1: str, name: str, data: bytes) -> str:
+        if hashlib.sha1(data).hexdigest() != sha1:
+            raise DottException(f'Checksum mismatch for file {name}.')
+        path = self._file_path(sha1, name)
+        path.parent.mkdir(parents=True, exist_ok=True)
+        tmp_path = path.with_name(f'{path.name}.{threading.get_ident()}.tmp')
+        tmp_path.write_bytes(data)
+        os.replace(str(tmp_path), str(path))
+        return str(PurePosixPath(path))
+
+    def _serve_session(self, conn: socket.socket) -> None:
+        _AgentSession(self, conn).serve()
+
+
+# -------------------------------------------------------------------------------------------------
+class AgentClient(object):
+    """
+    Session-side connection to a DOTT agent (one connection per target).
+    """
+    CONNECT_TIMEOUT_SEC = 5.0
+
+    # timeout for control requests (opening a target includes the startup of the GDB server)
+    REQUEST_TIMEOUT_SEC = 30.0
+
+    def __init__(self, agent_addr: str) -> None:
+        host, port = agent_addr.rsplit(':', 1)
+        sock = socket.create_connection((host, int(port)), timeout=AgentClient.CONNECT_TIMEOUT_SEC)
+        sock.settimeout(None)
+        self._addr: str = agent_addr
+        self._mux: ChannelMux = ChannelMux(sock)
+        self._ctrl_responses: BlockingDict = BlockingDict(discard_orphans=True)
+        self._mem_responses: BlockingDict = BlockingDict(discard_orphans=True)
+        self._next_id: int = 1
+        self._id_lock: threading.Lock = threading.Lock()
+        self._files: Dict[Tuple[str, float, int], str] = {}  # (local path, mtime, size) -> path on agent host
+        self._closed: bool = False
+        self._mux.set_handler(CH_CTRL, self._on_ctrl)
+        self._mux.set_handler(CH_MEM, self._on_mem)
+        self._mux.add_close_listener(self._on_close)
+        self._mux.start()
+
+    @property
+    def addr(self) -> str:
+        return self._addr
+
+    @property
+    def closed(self) -> bool:
+        return self._closed
+
+    def _on_ctrl(self, data: bytes) -> None:
+        res = json.loads(data)
+        self._ctrl_responses.put(res.get('id'), res)
+
+    def _on_mem(self, data: bytes) -> None:
+        seq, status = AgentTargetDirect.RESP_HDR.unpack_from(data)
+        self._mem_responses.put(seq, (status, data[AgentTargetDirect.RESP_HDR.size:]))
+
+    def _on_close(self) -> None:
+        self._closed = True
+        ex = DottConnectionError(f'Connection to DOTT agent {self._addr} has been lost.')
+        self._ctrl_responses.abort(ex)
+        self._mem_responses.abort(ex)
+
+    def next_id(self) -> int:
+        with self._id_lock:
+            req_id = self._next_id
+            self._next_id = (self._next_id % 0xffffffff) + 1
+        return req_id
+
+    def request(self, op: str, **kwargs) -> Dict:
+        """
+        Sends a control request to the agent and returns its response.
+        """
+        if self._closed:
+            raise DottException(f'Connection to DOTT agent {self._addr} is closed.')
+        req_id = self.next_id()
+        self._mux.send(CH_CTRL, json.dumps(dict(kwargs, op=op, id=req_id)).encode())
+        try:
+            res = self._ctrl_responses.pop(req_id, timeout=AgentClient.REQUEST_TIMEOUT_SEC)
+        except TimeoutError:
+            raise DottException(f'DOTT agent {self._addr} did not respond to {op} request.') from None
+        if not res['ok']:
+            raise DottException(f'DOTT agent {self._addr}: {op} failed ({res["error"]}).')
+        return res
+
+    def send_mem(self, data: bytes) -> None:
+        self._mux.send(CH_MEM, data)
+
+    def recv_mem(self, seq: int) -> Tuple[int, bytes]:
+        try:
+            return self._mem_responses.pop(seq, timeout=AgentClient.REQUEST_TIMEOUT_SEC)
+        except TimeoutError:
+            raise DottException(f'DOTT agent {self._addr} did not respond to memory request.') from None
+
+    def open_target(self, device_name: str, jlink_serial: str = None, interface: str = 'SWD',
+                    endian: str = 'little', speed: str = '15000') -> int:
+        """
+        Launches the GDB server of the given board on the agent host and returns its port (on the agent host).
+        """
+        res = self.request('open', device_name=device_name, jlink_serial=jlink_serial, interface=interface,
+                           endian=endian, speed=speed)
+        return res['gdb_server_port']
+
+    def mi_socket(self) -> socket.socket:
+        """
+        Returns a local stream which is connected to the GDB instance of the session (see GdbControllerBroker).
+        """
+        local, remote = socket.socketpair()
+        self._mux.attach(CH_MI, local)
+        return remote
+
+    def open_bp_channel(self) -> Tuple[str, socket.socket]:
+        """
+        Sets up the intercept point channel. Returns the endpoint which is to be passed to GDB (dott-bp-channel) and
+        a local stream which is connected to GDB's end of the channel once GDB has connected.
+        """
+        res = self.request('bp_channel')
+        local, remote = socket.socketpair()
+        self._mux.attach(CH_BP, local)
+        return res['endpoint'], remote
+
+    def file_path(self, file_name: str) -> str:
+        """
+        Returns the path of the given local file on the agent host (the file is transferred if the agent does not
+        have it yet).
+        """
+        st = os.stat(file_name)
+        key = (os.path.abspath(file_name), st.st_mtime, st.st_size)
+        if key not in self._files:
+            with open(file_name, 'rb') as f:
+                data = f.read()
+            sha1 = hashlib.sha1(data).hexdigest()
+            res = self.request('file', sha1=sha1, name=file_name)
+            if res.get('missing', False):
+                log.debug(f'Transferring {file_name} ({len(data)} bytes) to DOTT agent {self._addr}.')
+                res = self.request('put_file', sha1=sha1, name=file_name, data=base64.b64encode(data).decode())
+            self._files[key] = res['path']
+        return self._files[key]
+
+    def target_direct(self) -> 'AgentTargetDirect':
+        return AgentTargetDirect(self)
+
+    def close(self) -> None:
+        self._mux.close()
+
+
+# -------------------------------------------------------------------------------------------------
+class AgentTargetDirect(object):
+    """
+    Live access (see TargetDirect) to a board attached to a DOTT agent. The accesses are performed by the agent
+    which keeps the probe connection open. Requests are pipelined: mem_read_batch sends all requests at once such
+    that a batch costs a single network round trip. Note: Sampling, SWO and RTT are not available remotely.
+    """
+    REQ_HDR = struct.Struct('>IB')  # sequence number, operation
+    RESP_HDR = struct.Struct('>IB')  # sequence number, status (0: ok; otherwise the payload is the error message)
+
+    def __init__(self, agent: AgentClient) -> None:
+        self._agent: AgentClient = agent
+
+    def _send(self, op: int, body: bytes) -> int:
+        seq = self._agent.next_id()
+        self._agent.send_mem(AgentTargetDirect.REQ_HDR.pack(seq, op) + body)
+        return seq
+
+    def _recv(self, seq: int) -> bytes:
+        status, data = self._agent.recv_mem(seq)
+        if status != 0:
+            raise DottException(f'Remote live access failed ({data.decode()}).')
+        return data
+
+    def resync(self) -> None:
+        # note: the agent's probe connection is re-synchronized by the agent
+        pass
+
+    @contextlib.contextmanager
+    def session(self) -> Iterator['AgentTargetDirect']:
+        # note: per-call synchronization is handled by the agent; sessions are a no-op
+        yield self
+
+    def mem_read_32(self, addr: int, cnt: int = 1):
+        data = self._recv(self._send(OP_READ32, struct.pack('>II', addr, cnt)))
+        words = list(struct.unpack(f'<{len(data) // 4}I', data))
+        return words[0] if cnt == 1 else words
+
+    def mem_write_32(self, addr: int, data: List) -> int:
+        body = struct.pack('>I', addr) + struct.pack(f'<{len(data)}I', *data)
+        return struct.unpack('>I', self._recv(self._send(OP_WRITE32, body)))[0]
+
+    def mem_read(self, addr: int, num_bytes: int) -> bytes:
+        return self._recv(self._send(OP_READ, struct.pack('>II', addr, num_bytes)))
+
+    def mem_read_batch(self, reqs: List[Tuple[int, int]]) -> List[bytes]:
+        """
+        Reads several memory blocks given as (address, number of bytes) with a single network round trip.
+        """
+        seqs = [self._send(OP_READ, struct.pack('>II', addr, num_bytes)) for addr, num_bytes in reqs]
+        return [self._recv(seq) for seq in seqs]
+
+    def mem_read_scatter(self, addrs: List[int]) -> List[int]:
+        data = self._recv(self._send(OP_SCATTER, struct.pack(f'<{len(addrs)}I', *addrs)))
+        return list(struct.unpack(f'<{len(data) // 4}I', data))
+
+    def disconnect(self) -> None:
+        # note: the probe connection is owned by the agent session and closed with it
+        pass
+
+
+def main() -> None:
+    default_gdb = None
+    if 'DOTTGDBPATH' in os.environ:
+        default_gdb = str(Path(f'{os.environ["DOTTGDBPATH"]}/arm-none-eabi-gdb-py'))
+    default_srv = 'JLinkGDBServerCL.exe' if platform.system() == 'Windows' else 'JLinkGDBServerCLExe'
+
+    parser = argparse.ArgumentParser(description='DOTT agent which makes locally attached boards available remotely.')
+    parser.add_argument('--gdb', default=default_gdb, help='GDB client binary (default: from DOTTGDBPATH)')
+    parser.add_argument('--gdb-server', default=None, help='J-Link GDB server binary (default: from --jlink-path)')
+    parser.add_argument('--jlink-path', default=None, help='J-Link installation (required for live access)')
+    parser.add_argument('--port', type=int, default=DottAgent.DEFAULT_PORT, help='TCP port to listen on')
+    parser.add_argument('--pool-size', type=int, default=2, help='number of GDB instances kept ready')
+    args = parser.parse_args()
+    if args.gdb is None:
+        parser.error('GDB client binary not given and DOTTGDBPATH not set.')
+
+    gdb_server = args.gdb_server
+    if gdb_server is None:
+        gdb_server = str(Path(args.jlink_path, default_srv)) if args.jlink_path is not None else default_srv
+    # settings used by the live access (see ProbeBroker); the probe serial number is given per session
+    DottConf.set('jlink_path', args.jlink_path)
+    DottConf.set('jlink_lib_name', 'JLink_x64.dll' if platform.system() == 'Windows' else 'libjlinkarm.so')
+    DottConf.set('jlink_serial', None)
+    DottConf.set('jlink_server_addr', None)
+    DottConf.set('jlink_server_port', '19020')
+
+    logging.basicConfig(format='%(asctime)s %(message)s')
+    log_setup()
+    DottAgent(args.gdb, gdb_server, args.port, args.pool_size).serve_forever()
+
+
+if __name__ == '__main__':
+    main()
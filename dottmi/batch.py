@@ -0,0 +1,240 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import re
+import struct
+from typing import List, Tuple, Union
+
+from dottmi.dottexceptions import DottException
+
+
+# -------------------------------------------------------------------------------------------------
+class BatchResult(object):
+    """
+    Result of a command of a TargetBatch. The value is available once the batch has been run.
+    """
+    def __init__(self, signed: bool = False) -> None:
+        self._value = None
+        self._done: bool = False
+        self._signed: bool = signed
+
+    @property
+    def done(self) -> bool:
+        return self._done
+
+    @property
+    def value(self) -> Union[int, bytes]:
+        """
+        Result of the command: return value (call), CRC-32 (crc32), data (read) or None (other commands).
+        """
+        if not self._done:
+            raise DottException('Batch has not been run yet.')
+        return self._value
+
+    def _set(self, value: Union[int, bytes]) -> None:
+        if self._signed and isinstance(value, int) and value & 0x80000000:
+            value -= 0x100000000
+        self._value = value
+        self._done = True
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetBatch(object):
+    """
+    Batch of memory and call commands which are executed on the target with a single target resume. The commands are
+    collected on the host. When the batch is run, the command table together with the data to be written is uploaded
+    into the on-target scratch memory (Target.mem) in one bulk write, an on-target executor (DOTT_batch_run in
+    testhelpers.c) is invoked via the resident call stub (see Target.call) and the table with the results and read
+    data is transferred back in one bulk read. Compared to individual memory accesses and calls, a batch of N commands
+    costs a constant number of MI round trips. Batches are typically used as context manager (the batch is run on
+    exit). For example:
+        with dt.batch() as b:
+            b.write(buf_addr, b'\x01\x02\x03\x04')
+            res = b.call('example_Checksum', buf_addr, 4)
+            crc = b.crc32(buf_addr, 4)
+        assert res.value == 10
+    Note: Commands are executed in order; calls are subject to the same restrictions as Target.call.
+    """
+    # see DOTT_BATCH_xxx and DOTT_batch_cmd_t in testhelpers.h
+    _OP_MEMCPY = 1
+    _OP_MEMSET = 2
+    _OP_CRC32 = 3
+    _OP_CALL = 4
+    _OP_UNRLE = 5
+    _CMD_FMT = 'IIIIIII'  # op, p[5], ret
+
+    def __init__(self, target: 'Target', timeout: float = None) -> None:
+        self._target: 'Target' = target
+        self._timeout: float = timeout
+        self._bo: str = '<' if target.byte_order == 'little' else '>'
+        self._cmds: List[Tuple[int, List, BatchResult]] = []  # note: data offsets are resolved when the batch is run
+        self._data: bytearray = bytearray()  # staging area (data to be written and space for data to be read)
+        self._reads: List[Tuple[int, int, BatchResult]] = []  # (staging offset, size, result)
+
+    def __enter__(self) -> 'TargetBatch':
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        if exc_type is None:
+            self.run()
+
+    def __len__(self) -> int:
+        return len(self._cmds)
+
+    def _add(self, op: int, params: List, signed: bool = False) -> BatchResult:
+        res = BatchResult(signed)
+        self._cmds.append((op, params, res))
+        return res
+
+    def _stage(self, data: bytes) -> int:
+        # returns the offset of the data in the staging area (word aligned)
+        self._data += b'\x00' * (-len(self._data) % 4)
+        offset = len(self._data)
+        self._data += data
+        return offset
+
+    def memcpy(self, dst: int, src: int, num_bytes: int) -> BatchResult:
+        return self._add(TargetBatch._OP_MEMCPY, [dst, src, num_bytes])
+
+    def memset(self, dst: int, value: int, num_bytes: int) -> BatchResult:
+        return self._add(TargetBatch._OP_MEMSET, [dst, value & 0xff, num_bytes])
+
+    def crc32(self, addr: int, num_bytes: int) -> BatchResult:
+        """
+        Queues the computation of the CRC-32 (as computed by zlib.crc32) of the given memory range.
+        """
+        return self._add(TargetBatch._OP_CRC32, [addr, num_bytes])
+
+    def call(self, func: Union[str, int], *args: int, signed: bool = False) -> BatchResult:
+        """
+        Queues a call of a target function with up to four integer arguments (see Target.call).
+        """
+        if len(args) > 4:
+            raise DottException(f'TargetBatch.call supports at most four arguments ({len(args)} given).')
+        func = self._target._call_func_addr(func) | 0x1
+        return self._add(TargetBatch._OP_CALL, [func] + [a & 0xffffffff for a in args], signed)
+
+    def write(self, addr: int, data: bytes) -> BatchResult:
+        """
+        Queues a write of the given data to target memory. The data is uploaded together with the batch.
+        """
+        return self._add(TargetBatch._OP_MEMCPY, [addr, ('staged', self._stage(bytes(data))), len(data)])
+
+    # runs of at least 3 equal bytes (longer runs are split into records of at most 130 bytes)
+    _RLE_RUN = re.compile(rb'(.)\1{2,}', re.DOTALL)
+
+    @staticmethod
+    def rle_encode(data: bytes) -> bytes:
+        """
+        Run-length encodes the given data in the format decoded by the target (see DOTT_BATCH_UNRLE in testhelpers.h).
+        """
+        out = bytearray()
+
+        def literal(chunk: bytes) -> None:
+            for i in range(0, len(chunk), 128):
+                part = chunk[i:i + 128]
+                out.append(len(part) - 1)
+                out.extend(part)
+
+        pos = 0
+        for m in TargetBatch._RLE_RUN.finditer(data):
+            literal(data[pos:m.start()])
+            run = m.end() - m.start()
+            while run >= 3:
+                n = min(run, 130)
+                out += bytes([0x80 | (n - 3)]) + m.group(1)
+                run -= n
+            pos = m.end() - run  # note: a rest of 1 or 2 bytes is emitted as literal
+        literal(data[pos:])
+        return bytes(out)
+
+    def write_rle(self, addr: int, data: bytes, encoded: bytes = None) -> BatchResult:
+        """
+        Queues a write of the given data which is uploaded run-length encoded (encoded, if already known) and decoded
+        by the target. The result is the number of bytes written.
+        """
+        enc = encoded if encoded is not None else TargetBatch.rle_encode(bytes(data))
+        return self._add(TargetBatch._OP_UNRLE, [addr, ('staged', self._stage(enc)), len(enc)])
+
+    def fill(self, addr: int, pattern: bytes, num_bytes: int) -> None:
+        """
+        Queues a fill of the given memory range with a pattern (repeated and truncated to num_bytes). Only the
+        pattern is uploaded; the range is filled by the target (memset or memcpys doubling the filled part).
+        """
+        if len(pattern) == 1:
+            self.memset(addr, pattern[0], num_bytes)
+            return
+        first = min(len(pattern), num_bytes)
+        self.write(addr, pattern[:first])
+        done = first
+        while done < num_bytes:
+            n = min(done, num_bytes - done)
+            self.memcpy(addr + done, addr, n)
+            done += n
+
+    def read(self, addr: int, num_bytes: int) -> BatchResult:
+        """
+        Queues a read of target memory. The data is transferred back together with the batch results.
+        """
+        offset = self._stage(b'\x00' * num_bytes)
+        res = self._add(TargetBatch._OP_MEMCPY, [('staged', offset), addr, num_bytes])
+        self._reads.append((offset, num_bytes, res))
+        return res
+
+    def run(self) -> None:
+        """
+        Runs all queued commands on the (halted) target and sets their results. The batch is empty afterwards.
+        """
+        if len(self._cmds) == 0:
+            return
+        cmd_fmt = self._bo + TargetBatch._CMD_FMT
+        cmd_sz = struct.calcsize(cmd_fmt)
+        table_sz = len(self._cmds) * cmd_sz
+        total_sz = table_sz + len(self._data)
+        if total_sz + 4 > self._target.mem.get_num_free_bytes():  # note: 4 bytes for alignment
+            raise DottException(f'Not enough on-target memory available for a batch of {total_sz} bytes. Split the '
+                                f'batch into smaller ones.')
+
+        buf = self._target.mem.alloc(total_sz)
+        try:
+            data_addr = buf.addr + table_sz
+            table = bytearray()
+            for op, params, _ in self._cmds:
+                params = [data_addr + p[1] if isinstance(p, tuple) else p for p in params]
+                table += struct.pack(cmd_fmt, op, *(params + [0] * (5 - len(params))), 0)
+            self._target.mem._write_raw(buf.addr, bytes(table) + bytes(self._data), compress=False)
+
+            num_done = self._target.call('DOTT_batch_run', buf.addr, len(self._cmds), timeout=self._timeout)
+            # note: only the table and the staged read data (and not the uploaded data after it) are read back
+            read_end = max((offset + num_bytes for offset, num_bytes, _ in self._reads), default=0)
+            content = self._target.mem.read(buf.addr, table_sz + read_end)
+        finally:
+            self._target.mem.free(buf)
+
+        if num_done != len(self._cmds):
+            raise DottException(f'Target batch stopped after {num_done} of {len(self._cmds)} commands.')
+        for i, (op, _, res) in enumerate(self._cmds):
+            if op in (TargetBatch._OP_CRC32, TargetBatch._OP_CALL, TargetBatch._OP_UNRLE):
+                res._set(struct.unpack_from(cmd_fmt, content, i * cmd_sz)[6])
+            else:
+                res._set(None)
+        for offset, num_bytes, res in self._reads:
+            res._set(bytes(content[table_sz + offset:table_sz + offset + num_bytes]))
+        self._cmds, self._data, self._reads = [], bytearray(), []
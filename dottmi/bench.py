@@ -0,0 +1,148 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import json
+import math
+import os
+import subprocess
+from typing import Dict, List
+
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class BenchResult(object):
+    """
+    Result of an on-target benchmark (see Target.bench) holding the CPU cycles of each measured call and (if measured)
+    the peak stack usage of the function in bytes.
+    """
+    def __init__(self, name: str, cycles: List[int], stack: int = None) -> None:
+        self._name: str = name
+        self._cycles: List[int] = cycles
+        self._sorted: List[int] = sorted(cycles)
+        self._stack: int = stack
+
+    @property
+    def name(self) -> str:
+        return self._name
+
+    @property
+    def cycles(self) -> List[int]:
+        return self._cycles
+
+    @property
+    def stack(self) -> int:
+        return self._stack
+
+    @property
+    def min(self) -> int:
+        return self._sorted[0]
+
+    @property
+    def max(self) -> int:
+        return self._sorted[-1]
+
+    @property
+    def mean(self) -> float:
+        return sum(self._cycles) / len(self._cycles)
+
+    @property
+    def median(self) -> float:
+        mid = len(self._sorted) // 2
+        if len(self._sorted) % 2 == 1:
+            return float(self._sorted[mid])
+        return (self._sorted[mid - 1] + self._sorted[mid]) / 2
+
+    def percentile(self, p: float) -> int:
+        """
+        Returns the p-th percentile (0 < p <= 100, nearest-rank method) of the measured cycles.
+        """
+        rank = max(1, math.ceil(p / 100 * len(self._sorted)))
+        return self._sorted[rank - 1]
+
+    @property
+    def p99(self) -> int:
+        return self.percentile(99)
+
+    def to_dict(self) -> Dict:
+        res = {'name': self.name, 'iterations': len(self._cycles), 'min': self.min, 'median': self.median,
+               'p99': self.p99, 'max': self.max, 'mean': self.mean}
+        if self._stack is not None:
+            res['stack'] = self._stack
+        return res
+
+    def __str__(self) -> str:
+        stack = f'; stack: {self._stack} bytes' if self._stack is not None else ''
+        return f'{len(self._cycles)} iterations; min: {self.min}, median: {self.median:.1f}, p99: {self.p99}, ' \
+               f'max: {self.max} cycles{stack}'
+
+
+# -------------------------------------------------------------------------------------------------
+class BenchRecorder(object):
+    """
+    Collects the benchmark results of a test session (see the target_bench fixture), writes them to a JSON file
+    (tagged with the current git commit) and compares them against the results of a baseline file.
+    """
+    FILE_VERSION = 1
+
+    def __init__(self, results_file: str = None, baseline_file: str = None, tolerance: float = 0.05) -> None:
+        self._results_file: str = results_file
+        self._tolerance: float = tolerance
+        self._results: Dict[str, Dict] = {}
+        self._baseline: Dict[str, Dict] = {}
+        if baseline_file is not None:
+            try:
+                with open(baseline_file, 'r') as f:
+                    content = json.load(f)
+                if content.get('version') == BenchRecorder.FILE_VERSION:
+                    self._baseline = content['results']
+            except (OSError, ValueError, KeyError) as ex:
+                log.warn(f'Ignoring unreadable benchmark baseline file {baseline_file} ({ex}).')
+
+    def record(self, key: str, result: BenchResult) -> str:
+        """
+        Records the result under the given key. Returns a message describing the regression if the median is more
+        than the configured tolerance above the one of the baseline, otherwise None.
+        """
+        self._results[key] = result.to_dict()
+        base = self._baseline.get(key)
+        if base is not None and result.median > base['median'] * (1.0 + self._tolerance):
+            return f'{key}: median of {result.median:.1f} cycles exceeds baseline ({base["median"]:.1f} cycles) ' \
+                   f'by more than {self._tolerance * 100:.1f}%'
+        return None
+
+    @staticmethod
+    def _git_commit() -> str:
+        try:
+            return subprocess.check_output(['git', 'rev-parse', 'HEAD'], stderr=subprocess.DEVNULL).decode().strip()
+        except (OSError, subprocess.CalledProcessError):
+            return None
+
+    def save(self) -> None:
+        if self._results_file is None or len(self._results) == 0:
+            return
+        try:
+            tmp_file = f'{self._results_file}.{os.getpid()}.tmp'
+            with open(tmp_file, 'w') as f:
+                json.dump({'version': BenchRecorder.FILE_VERSION, 'commit': BenchRecorder._git_commit(),
+                           'results': self._results}, f, indent=2)
+            os.replace(tmp_file, self._results_file)
+        except OSError as ex:
+            log.warn(f'Unable to write benchmark results file {self._results_file} ({ex}).')
@@ -0,0 +1,165 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Bisection of a benchmark regression between two commits of the firmware repository. The commits between the good
+# and the bad commit are checked out one at a time; each is built, downloaded and benchmarked in a regular DOTT pytest
+# session on the connected board (as bench_compare does for a variant). Since consecutive builds differ in a few
+# sectors only, configuring flash_download_mode=incremental (dott.ini) makes each download take a fraction of a full
+# flash programming. A commit is considered bad if the median cycle count of the benchmark (target_bench key) is
+# closer to the one of the bad commit than to the one of the good commit. Commits which fail to build or to produce
+# the benchmark result are skipped (as with git bisect skip). The originally checked out commit is restored at the end.
+#
+# Usage: python -m dottmi.bench_bisect <good> <bad> --benchmark <key> --build <cmd> [--build <cmd> ...]
+#                                      [--repo <dir>] [--cwd <dir>] [--tolerance <percent>] [pytest args]
+#   Example: python -m dottmi.bench_bisect v1.2 HEAD --benchmark test_dsp_bench.py::test_fir_q15 \
+#                --build "make -C target clean all" host/test_dsp_bench.py
+#   Exits with status 0 if the first bad commit was identified, otherwise status 1.
+
+import argparse
+import subprocess
+import sys
+from pathlib import Path
+from typing import Dict, List, Optional
+
+from dottmi.bench_compare import run_variant
+
+
+# -------------------------------------------------------------------------------------------------
+class BenchBisect(object):
+    """
+    Bisection of a benchmark regression (see module description).
+    """
+    def __init__(self, repo: Path, work_dir: Path, build: List[str], benchmark: str, pytest_args: List[str]) -> None:
+        self._repo: Path = repo
+        self._work_dir: Path = work_dir
+        self._build: List[str] = build
+        self._benchmark: str = benchmark
+        self._pytest_args: List[str] = pytest_args
+        self._medians: Dict[str, Optional[float]] = {}  # commit -> median cycles (None: skipped)
+
+    def git(self, *args: str) -> str:
+        return subprocess.check_output(['git', '-C', str(self._repo)] + list(args)).decode().strip()
+
+    def commits(self, good: str, bad: str) -> List[str]:
+        """
+        Returns the commits from good to bad (both included, oldest first) on the ancestry path between them.
+        """
+        good, bad = self.git('rev-parse', good), self.git('rev-parse', bad)
+        path = self.git('rev-list', '--reverse', '--ancestry-path', f'{good}..{bad}').split()
+        if len(path) == 0 or path[-1] != bad:
+            raise ValueError(f'{bad} is not a descendant of {good}.')
+        return [good] + path
+
+    def measure(self, commit: str) -> Optional[float]:
+        """
+        Checks out, builds and benchmarks the given commit. Returns the median cycles of the benchmark (None if the
+        commit could not be benchmarked). Results are cached per commit.
+        """
+        if commit in self._medians:
+            return self._medians[commit]
+        self.git('checkout', '--quiet', '--detach', commit)
+        name = self.git('log', '-1', '--format=%h %s', commit)
+        results_file = self._work_dir.joinpath('.dott_bench_bisect.json')
+        res = run_variant({'name': name, 'build': self._build}, self._work_dir, self._pytest_args, results_file)
+        bench = res.get('benchmarks', {}).get(self._benchmark)
+        median = bench['median'] if bench is not None else None
+        if median is None:
+            print(f'[{name}] skipped ({res.get("error", "benchmark result missing")})', flush=True)
+        else:
+            print(f'[{name}] {self._benchmark}: {median:.1f} cycles', flush=True)
+        self._medians[commit] = median
+        return median
+
+    def run(self, good: str, bad: str, tolerance: float) -> Optional[str]:
+        """
+        Returns the first bad commit (None if it could not be identified).
+
+        Args:
+            good: Commit without the regression.
+            bad: Commit with the regression.
+            tolerance: Relative increase of the median between good and bad which is considered a regression.
+        """
+        commits = self.commits(good, bad)
+        good_cycles, bad_cycles = self.measure(commits[0]), self.measure(commits[-1])
+        if good_cycles is None or bad_cycles is None:
+            print('The good and the bad commit have to be benchmarked successfully.')
+            return None
+        if bad_cycles <= good_cycles * (1.0 + tolerance):
+            print(f'No regression between good ({good_cycles:.1f} cycles) and bad ({bad_cycles:.1f} cycles) commit.')
+            return None
+        threshold = (good_cycles + bad_cycles) / 2
+        print(f'Bisecting {len(commits) - 2} commits (bad: more than {threshold:.1f} cycles).', flush=True)
+
+        lo, hi = 0, len(commits) - 1  # invariant: commits[lo] is good, commits[hi] is bad
+        while hi - lo > 1:
+            # the commit closest to the middle which can be benchmarked (skipped commits are passed over)
+            mid = (lo + hi) // 2
+            candidates = sorted(range(lo + 1, hi), key=lambda i: abs(i - mid))
+            median = None
+            for idx in candidates:
+                median = self.measure(commits[idx])
+                if median is not None:
+                    mid = idx
+                    break
+            if median is None:
+                print(f'Unable to benchmark the commits between {commits[lo][:12]} and {commits[hi][:12]}; the first '
+                      f'bad commit is one of them or {commits[hi][:12]}.')
+                return None
+            if median > threshold:
+                hi = mid
+            else:
+                lo = mid
+        return commits[hi]
+
+
+# -------------------------------------------------------------------------------------------------
+def main() -> int:
+    parser = argparse.ArgumentParser(prog='python -m dottmi.bench_bisect',
+                                     description='Identifies the commit which introduced a benchmark regression.')
+    parser.add_argument('good', help='Commit without the regression.')
+    parser.add_argument('bad', help='Commit with the regression.')
+    parser.add_argument('--benchmark', required=True, help='Key of the benchmark (see target_bench).')
+    parser.add_argument('--build', action='append', default=[], help='Build command (may be given several times).')
+    parser.add_argument('--repo', default='.', help='Firmware git repository (default: current directory).')
+    parser.add_argument('--cwd', default=None, help='Directory of build and pytest (default: the repository).')
+    parser.add_argument('--tolerance', type=float, default=5.0, help='Regression threshold in percent (default: 5).')
+    args, pytest_args = parser.parse_known_args()
+
+    repo = Path(args.repo).resolve()
+    bisector = BenchBisect(repo, Path(args.cwd).resolve() if args.cwd is not None else repo, args.build,
+                           args.benchmark, pytest_args)
+    if bisector.git('status', '--porcelain', '--untracked-files=no') != '':
+        print(f'The working tree of {repo} has uncommitted changes.')
+        return 1
+    # note: the branch (if any) is restored at the end, otherwise the commit
+    head = bisector.git('rev-parse', '--abbrev-ref', 'HEAD')
+    head = head if head != 'HEAD' else bisector.git('rev-parse', 'HEAD')
+    try:
+        first_bad = bisector.run(args.good, args.bad, args.tolerance / 100.0)
+    finally:
+        bisector.git('checkout', '--quiet', head)
+    if first_bad is None:
+        return 1
+    print(f'First bad commit: {bisector.git("log", "-1", "--format=%H %an: %s", first_bad)}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
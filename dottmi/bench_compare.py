@@ -0,0 +1,185 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Comparison of firmware build variants (toolchains, optimization levels, ...). The variants are described in a JSON
+# file. For each variant, the build commands are run, the benchmark tests are executed in a regular DOTT pytest session
+# (the results of the target_bench fixture are written to a per-variant results file, see DOTTBENCHRESULTS) and the
+# image size is determined from the variant's ELF file. Finally, cycles (median), code size and stack usage (if
+# bench_stack_bytes is configured) of each benchmark are reported side by side. Variants are built and run one after
+# the other; hence, all variants may use the same output folder. Example variants file (paths are relative to it):
+# {
+#   "pytest": ["host"],
+#   "variants": [
+#     {"name": "armclang -Oz", "build": ["make -C target clean all"], "elf": "target/build/app.axf"},
+#     {"name": "gcc -O2", "build": ["make -C target clean all USE_GCC=1 OPT=-O2"], "elf": "target/build/app.axf",
+#      "env": {"APP_TOOLCHAIN": "gcc"}}
+#   ]
+# }
+#
+# Usage: python -m dottmi.bench_compare <variants file> [--output <report>] [--variants <name>,<name>,...] [pytest args]
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+from pathlib import Path
+from typing import Dict, List
+
+from dottmi.elf_file import ElfFile
+
+_SHT_NOBITS = 8
+_SHF_WRITE = 0x1
+_SHF_ALLOC = 0x2
+
+
+def image_sizes(elf_file: str) -> Dict[str, int]:
+    """
+    Returns the sizes (in bytes) of the allocated sections of the given ELF: text (code and read-only data), data
+    (initialized data) and bss (zero-initialized data).
+    """
+    _, _, sections, _ = ElfFile.open(elf_file).sections
+    sizes = {'text': 0, 'data': 0, 'bss': 0}
+    for sec in sections:
+        sec_type, flags, size = sec[1], sec[2], sec[5]
+        if not flags & _SHF_ALLOC:
+            continue
+        if sec_type == _SHT_NOBITS:
+            sizes['bss'] += size
+        elif flags & _SHF_WRITE:
+            sizes['data'] += size
+        else:
+            sizes['text'] += size
+    return sizes
+
+
+def run_variant(variant: Dict, base_dir: Path, pytest_args: List[str], results_file: Path) -> Dict:
+    """
+    Builds the variant, runs the benchmark tests and returns the variant's results (benchmarks and image sizes).
+    """
+    name = variant['name']
+    for cmd in variant.get('build', []):
+        print(f'[{name}] {cmd}', flush=True)
+        if subprocess.run(cmd, shell=True, cwd=base_dir).returncode != 0:
+            return {'error': f'build command failed: {cmd}'}
+
+    env = dict(os.environ)
+    env.update({k: str(v) for k, v in variant.get('env', {}).items()})
+    env['DOTTBENCHRESULTS'] = str(results_file.resolve())
+    if results_file.exists():
+        results_file.unlink()
+    print(f'[{name}] pytest {" ".join(pytest_args)}', flush=True)
+    exit_code = subprocess.run([sys.executable, '-m', 'pytest'] + pytest_args, cwd=base_dir, env=env).returncode
+
+    res = {'exit_code': exit_code, 'benchmarks': {}, 'sizes': None, 'func_sizes': {}}
+    try:
+        with open(results_file, 'r') as f:
+            res['benchmarks'] = json.load(f)['results']
+    except (OSError, ValueError, KeyError):
+        res['error'] = 'no benchmark results'
+    elf = variant.get('elf')
+    if elf is not None and base_dir.joinpath(elf).exists():
+        elf_file = str(base_dir.joinpath(elf))
+        res['sizes'] = image_sizes(elf_file)
+        symbols = ElfFile.open(elf_file).symbols
+        for bench in res['benchmarks'].values():
+            if bench.get('name') in symbols:
+                res['func_sizes'][bench['name']] = symbols[bench['name']]['size']
+    return res
+
+
+def report(results: Dict[str, Dict]) -> str:
+    """
+    Returns a side by side report (one row per benchmark and one column per variant) of the given variant results.
+    """
+    names = list(results.keys())
+    keys: List[str] = []
+    for res in results.values():
+        keys += [k for k in res.get('benchmarks', {}) if k not in keys]
+
+    def cell(res: Dict, key: str) -> str:
+        bench = res.get('benchmarks', {}).get(key)
+        if bench is None:
+            return '-'
+        text = f'{bench["median"]:.0f} cyc'
+        size = res.get('func_sizes', {}).get(bench.get('name'))
+        if size is not None:
+            text += f', {size} B'
+        if bench.get('stack') is not None:
+            text += f', stack {bench["stack"]} B'
+        return text
+
+    rows = [['benchmark'] + names]
+    for key in keys:
+        rows.append([key] + [cell(results[n], key) for n in names])
+        medians = {n: results[n]['benchmarks'][key]['median'] for n in names if key in results[n].get('benchmarks', {})}
+        if len(medians) > 1:
+            best = min(medians, key=medians.get)
+            rows[-1][names.index(best) + 1] += ' *'
+
+    common = [k for k in keys if all(k in results[n].get('benchmarks', {}) for n in names)]
+    rows.append([f'total cycles ({len(common)} common benchmarks)'] +
+                [f'{sum(results[n]["benchmarks"][k]["median"] for k in common):.0f}' for n in names])
+    for section in ('text', 'data', 'bss'):
+        rows.append([f'image {section} (bytes)'] +
+                    [str(results[n]['sizes'][section]) if results[n].get('sizes') else '-' for n in names])
+    rows.append(['status'] + [results[n].get('error', 'ok' if results[n].get('exit_code') == 0 else
+                                              f'tests failed ({results[n].get("exit_code")})') for n in names])
+
+    widths = [max(len(r[i]) for r in rows) for i in range(len(rows[0]))]
+    lines = ['  '.join(c.ljust(w) for c, w in zip(r, widths)).rstrip() for r in rows]
+    lines.insert(1, '  '.join('-' * w for w in widths))
+    lines.append('(* fastest variant of the benchmark)')
+    return '\n'.join(lines)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Builds firmware variants, benchmarks them and compares the results.')
+    parser.add_argument('variants_file', help='JSON file describing the variants')
+    parser.add_argument('--output', default=None, help='JSON file the results of all variants are written to')
+    parser.add_argument('--variants', default=None, help='comma-separated names of the variants to run (default: all)')
+    args, pytest_args = parser.parse_known_args()
+
+    variants_file = Path(args.variants_file).resolve()
+    with open(variants_file, 'r') as f:
+        conf = json.load(f)
+    base_dir = variants_file.parent
+    pytest_args = conf.get('pytest', []) + pytest_args
+    variants = conf['variants']
+    if args.variants is not None:
+        selected = [v.strip() for v in args.variants.split(',')]
+        variants = [v for v in variants if v['name'] in selected]
+    if len(variants) == 0:
+        sys.exit('No variants to run.')
+
+    results: Dict[str, Dict] = {}
+    for i, variant in enumerate(variants):
+        results_file = base_dir.joinpath(f'.dott_bench_variant_{i}.json')
+        results[variant['name']] = run_variant(variant, base_dir, pytest_args, results_file)
+
+    print(report(results))
+    if args.output is not None:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=2)
+    sys.exit(0 if all(r.get('exit_code') == 0 and 'error' not in r for r in results.values()) else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -18,37 +18,72 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import binascii
+import collections
 import json
-import multiprocessing
 import queue
-import socket
+import struct
 import threading
+import time
 import warnings
 from abc import *
-from typing import List, Union, Dict
+from typing import Deque, List, Tuple, Union, Dict
 
 from dottmi.dott import dott
-from dottmi.dottexceptions import DottException
+from dottmi.dottexceptions import DottConnectionError, DottException
 from dottmi.gdb_mi import GdbMiContext
-from dottmi.gdb_shared import BpMsg, BpSharedConf
+from dottmi.gdb_shared import BpMsg
 from dottmi.utils import log, cast_str
 
 
 # Abstract base class defining common methods for all breakpoints
 class Breakpoint(ABC):
+    # set to False by sub-classes whose location is an expression (e.g., watchpoints) instead of a code location
+    _check_location: bool = True
+
+    # set to False by sub-classes which do not use a (hardware) breakpoint comparator (e.g., watchpoints)
+    _uses_bp_comparator: bool = True
 
     def __init__(self, location: str, target: 'Target' = None):
         self._dott_target: 'Target' = target
         if self._dott_target is None:
             self._dott_target: 'Target' = dott().target  # Note: _target used by Thread; InterceptPoint inherits from it
 
-        if not location.startswith(('+', '-', '*')):  # GDB locations may be an address (*)
+        if self._check_location and not location.startswith(('+', '-', '*')):  # GDB locations may be an address (*)
                                                       # or a line offset (+/-) instead of a symbol
             if not self._dott_target.symbols.exists(location):
                 raise DottException(f'No symbol "{location}" found in target binary symbols.')
         self._location: str = location
+        # note: code labels are resolved to addresses using the symbol index (no symbol lookup on GDB side)
+        self._gdb_location: str = self._dott_target.symbols.gdb_location(location) if self._check_location \
+            else location
         self._hits: int = 0
+        self._hit_time: float = None  # host time (time.perf_counter) of the latest hit
         self._num: int = -1
+        self._complete_listeners: List = []
+        self._condition: str = None
+        self._ignore_count: int = 0
+
+    # interval in which waits for the completion of a breakpoint check if the target connection has been lost
+    _LOST_CHECK_INTERVAL_SEC = 0.25
+
+    def _wait_or_lost(self, wait_fn, timeout: float) -> bool:
+        # calls wait_fn (which waits for at most the given number of seconds and returns True on completion) in slices
+        # such that a lost target connection (see Target.check_health) fails the wait instead of waiting for timeout
+        end_time = None if timeout is None else time.monotonic() + timeout
+        if self._dott_target.fault_pending and not wait_fn(0):
+            self._dott_target.check_fault()
+        while True:
+            remaining = Breakpoint._LOST_CHECK_INTERVAL_SEC
+            if end_time is not None:
+                remaining = min(remaining, end_time - time.monotonic())
+            if wait_fn(max(remaining, 0)):
+                return True
+            self._dott_target.check_fault()
+            if self._dott_target.connection_lost:
+                raise DottConnectionError(f'Connection to target lost while waiting for breakpoint {self._location}.')
+            if end_time is not None and time.monotonic() >= end_time:
+                return False
 
     @property
     def num(self) -> int:
@@ -70,6 +105,34 @@ class Breakpoint(ABC):
     def delete(self) -> None:
         pass
 
+    def poll_complete(self) -> bool:
+        """
+        Non-blocking variant of wait_complete. Returns True (and consumes the completion) if the breakpoint has been
+        completed, False otherwise.
+        """
+        return False
+
+    def _fault_wakeup(self) -> None:
+        # called if the target halted in DOTT's fault hook; breakpoints with a blocking wait wake up their waiter
+        # which then raises a TargetFaultException (see _wait_or_lost)
+        pass
+
+    def add_complete_listener(self, listener) -> None:
+        """
+        Registers a callable which is called (without arguments) whenever the breakpoint has been completed. The
+        listener is called from a DOTT-internal thread and hence shall return quickly and shall not interact with
+        the target.
+        """
+        self._complete_listeners.append(listener)
+
+    def remove_complete_listener(self, listener) -> None:
+        if listener in self._complete_listeners:
+            self._complete_listeners.remove(listener)
+
+    def _notify_complete_listeners(self) -> None:
+        for listener in self._complete_listeners[:]:
+            listener()
+
     @abstractmethod
     def exec(self, cmd: str) -> None:
         pass
@@ -82,57 +145,228 @@ class Breakpoint(ABC):
     def ret(self, ret_val: Union[int, str] = None) -> None:
         pass
 
+    @property
+    def condition(self) -> str:
+        return self._condition
+
+    def set_condition(self, condition: str) -> None:
+        """
+        Sets a condition (target expression) for the breakpoint. Hits where the condition evaluates to false are
+        filtered by GDB, i.e., they neither wake up DOTT nor require a round trip to the host. None removes the
+        condition.
+        """
+        self._condition = condition
+        self._apply_filter()
+
+    @property
+    def ignore_count(self) -> int:
+        return self._ignore_count
+
+    def set_ignore_count(self, count: int) -> None:
+        """
+        Sets the number of (matching) hits which shall be ignored by GDB before the breakpoint becomes active.
+        """
+        self._ignore_count = count
+        self._apply_filter()
+
+    def _apply_filter(self) -> None:
+        # default for breakpoints implemented in GDB's Python context (see dott-bp-nostop-filter in gdb_cmds.py)
+        spec = json.dumps({'location': self._gdb_location, 'condition': self._condition,
+                           'ignore_count': self._ignore_count})
+        self._dott_target.cli_exec(f'dott-bp-nostop-filter {binascii.hexlify(spec.encode()).decode()}')
+
     def get_location(self) -> str:
         return self._location
 
     def get_hits(self) -> int:
         return self._hits
 
+    @property
+    def hit_time(self) -> float:
+        """
+        Host time (time.perf_counter) at which DOTT received the latest hit of the breakpoint (None if it was not hit
+        yet), e.g., to correlate hits with captured UART output (see UartCapture).
+        """
+        return self._hit_time
+
 
 # -------------------------------------------------------------------------------------------------
 class HaltPoint(Breakpoint):
-    def __init__(self, location: str, temporary: bool = False, target: 'Target' = None):
+    """
+    Breakpoint which halts the target. With skip and every, hits which are not of interest are passed by GDB (ignore
+    counts) without halting the target and notifying DOTT. For example, HaltPoint('app_Process', skip=99) halts on the
+    100th call and HaltPoint('app_Process', every=10) on every 10th call.
+
+    Args:
+        skip: Number of (matching) hits to pass before the first halt (same as ignore_count).
+        every: Halt only on every n-th (matching) hit (counted after the skipped hits).
+        watch: Expressions which GDB evaluates whenever the halt point halts the target (see watch).
+    """
+    # id of the DottResp lines with the values of the watch expressions (None: no watch expressions)
+    _watch_id: int = None
+
+    # maximum time to wait for the values of the watch expressions after a hit
+    _WATCH_TIMEOUT_SEC = 2.0
+
+    def __init__(self, location: str, temporary: bool = False, target: 'Target' = None, condition: str = None,
+                 ignore_count: int = 0, skip: int = 0, every: int = 1, watch: List[str] = None):
         super().__init__(location, target)
-        self._bp_info: Dict = None
-        self._q: queue.Queue = queue.Queue()
+        if every < 1 or skip < 0:
+            raise DottException('HaltPoint: every has to be at least 1 and skip must not be negative.')
+        ignore_count += skip + every - 1
+        self._init_state(temporary, condition, ignore_count, every)
 
         args = ''
         if temporary:
             args += '-t'
+        if condition is not None:
+            escaped = condition.replace('"', '\\"')
+            args += f' -c "{escaped}"'
+        if ignore_count > 0:
+            args += f' -i {ignore_count}'
 
         try:
-            msg = self._dott_target.exec(f'-break-insert {args} {location}')
+            # note: the breakpoint manager re-uses a previously deleted breakpoint for the same location if possible
+            bp_info = self._dott_target.bp_manager.insert(self._gdb_location, args, self._is_reusable())
         except Exception as ex:
             log.error('Creating breakpoint failed.')
             log.exception(ex)
             raise ex
+        self._attach(bp_info)
 
-        if 'payload' in msg:
-            payload = msg['payload']
-            if 'bkpt' in payload:
-                self._bp_info = payload['bkpt']
-        if self._bp_info is None:
-            raise Exception('Invalid breakpoint information.')
+        if every > 1:
+            # GDB re-arms the ignore count whenever the breakpoint halts the target (no host round trip per hit)
+            self._dott_target.exec(f'-break-commands {self._num} "ignore {self._num} {every - 1}"')
+        if watch is not None:
+            self.watch(watch)
 
+    def _init_state(self, temporary: bool, condition: str, ignore_count: int, every: int = 1) -> None:
+        self._bp_info: Dict = None
+        self._q: queue.Queue = queue.Queue()
+        self._condition = condition
+        self._ignore_count = ignore_count
+        self._every: int = every
+        self._temporary: bool = temporary
+        self._watch_exprs: List[str] = []
+        self._values: Dict = {}
+
+    def _attach(self, bp_info: Dict) -> None:
+        self._bp_info = bp_info
         self._num = int(self._bp_info['number'])
         self._addr = self._bp_info['addr']
 
         # add breakpoint to breakpoint handler
         self._dott_target.bp_handler.add_bp(self)
 
+    @classmethod
+    def create_many(cls, locations: List[str], target: 'Target' = None) -> List['HaltPoint']:
+        """
+        Creates halt points for all given locations in one batched MI exchange (instead of one exchange per halt
+        point). Note: The constructor of cls is not called; hence, this is intended for HaltPoint and sub-classes
+        which only override methods such as reached.
+
+        Args:
+            locations: Locations of the halt points.
+            target: Target the halt points are created for (default: dott().target).
+
+        Returns:
+            List with the halt points (in the order of the given locations).
+        """
+        bps: List['HaltPoint'] = []
+        for location in locations:
+            bp = cls.__new__(cls)
+            Breakpoint.__init__(bp, location, target)
+            bp._init_state(False, None, 0)
+            bps.append(bp)
+        if len(bps) > 0:
+            bp_infos = bps[0]._dott_target.bp_manager.insert_many([bp._gdb_location for bp in bps])
+            for bp, bp_info in zip(bps, bp_infos):
+                bp._attach(bp_info)
+        return bps
+
     # allow the test thread to wait for a breakpoint event to occur
     def wait_complete(self, timeout: float = None) -> None:
-        try:
-            self._q.get(block=True, timeout=timeout)
-        except queue.Empty:
+        def get(secs: float) -> bool:
+            try:
+                # note: a fault wakeup (see _fault_wakeup) is not a completion; the fault is raised by _wait_or_lost
+                return self._q.get(block=True, timeout=secs) is not HaltPoint._FAULT_WAKEUP
+            except queue.Empty:
+                return False
+
+        if not self._wait_or_lost(get, timeout):
             raise TimeoutError(f'Timeout while waiting to reach halt point at {self._location}.') from None
 
+    def watch(self, exprs: List[str]) -> None:
+        """
+        Adds watch expressions to the halt point. Whenever the halt point halts the target, GDB evaluates them in its
+        stop handler and sends their values along with the stop notification. Hence, once wait_complete returns (or
+        reached is called), values holds the values of the hit without further requests to GDB. For example:
+          bp = HaltPoint('app_Process', watch=['_tick_cnt', 'ctx->state', 'buf[0]'])
+          dt.cont()
+          bp.wait_complete()
+          assert bp.values['ctx->state'] == 2
+        """
+        self._watch_exprs = self._watch_exprs + list(exprs)
+        self._watch_send(self._watch_exprs)
+
+    def _watch_send(self, exprs: List[str]) -> None:
+        if self._watch_id is None:
+            self._watch_id = self._dott_target.gdb_client.gdb_mi.reserve_resp_id()
+        spec = binascii.hexlify(json.dumps(exprs).encode()).decode()
+        self._dott_target.exec_dott('dott-bp-watch', f'{self._num} {self._watch_id} {spec}')
+
+    @property
+    def values(self) -> Dict[str, Union[int, float, bool, str, Dict, List]]:
+        """
+        Values of the watch expressions at the most recent hit (structs as dicts and arrays as lists; None for
+        expressions which could not be evaluated).
+        """
+        return self._values
+
+    def _watch_receive(self) -> None:
+        try:
+            status, payload = self._dott_target.gdb_client.gdb_mi.pop_dott_resp(self._watch_id,
+                                                                                HaltPoint._WATCH_TIMEOUT_SEC)
+        except TimeoutError:
+            log.warn(f'Values of the watch expressions of halt point at {self._location} not received.')
+            self._values = {}
+            return
+        values = {}
+        for expr, (ok, value) in zip(self._watch_exprs, json.loads(binascii.unhexlify(payload).decode())):
+            if not ok:
+                log.warn(f'Evaluation of watch expression "{expr}" failed: {value}')
+                value = None
+            values[expr] = value
+        self._values = values
+
+    def _is_reusable(self) -> bool:
+        return not self._temporary and self._condition is None and self._ignore_count == 0 and self._every == 1
+
     def reached_internal(self, payload=None) -> None:
         self._hits += 1
+        if self._temporary:
+            self._dott_target.bp_manager.forget(self._num)  # GDB deletes temporary breakpoints when hit
         self._dott_target.wait_halted()
+        if self._watch_id is not None:
+            self._watch_receive()
         self.reached()
         # queue is used to notify one potentially waiting thread
         self._q.put(None, block=False)
+        self._notify_complete_listeners()
+
+    def poll_complete(self) -> bool:
+        try:
+            while self._q.get(block=False) is HaltPoint._FAULT_WAKEUP:
+                pass
+            return True
+        except queue.Empty:
+            return False
+
+    # queue item which wakes up a waiting thread if the target halted in DOTT's fault hook
+    _FAULT_WAKEUP = object()
+
+    def _fault_wakeup(self) -> None:
+        self._q.put(HaltPoint._FAULT_WAKEUP, block=False)
 
     def reached(self) -> None:
         # to be implemented by sub-class as needed
@@ -146,12 +380,26 @@ class HaltPoint(Breakpoint):
         # a halt breakpoint can rely on normal DOTT exec command
         self._dott_target.exec(cmd)
 
+    def eval_many(self, cmds: List[str]) -> List[Union[int, float, bool, str]]:
+        return self._dott_target.eval_many(cmds)
+
+    def exec_many(self, cmds: List[str]) -> None:
+        self._dott_target.exec_many(cmds)
+
     def ret(self, ret_val: Union[int, str] = None):
         # a halt breakpoint can rely on normal DOTT exec command
         self._dott_target.ret(ret_val)
 
+    def _apply_filter(self) -> None:
+        # for halt points, GDB evaluates the condition (and ignore count) when the target stops at the breakpoint.
+        # note: both MI commands pass their arguments to the CLI as is (i.e., the condition must not be quoted)
+        self._dott_target.exec(f'-break-condition {self._num} {self._condition if self._condition else ""}')
+        self._dott_target.exec(f'-break-after {self._num} {self._ignore_count}')
+
     def delete(self) -> None:
-        self._dott_target.exec(f'-break-delete {self._num}')
+        if self._watch_id is not None:
+            self._watch_send([])  # note: the breakpoint number may be re-used by the breakpoint manager
+        self._dott_target.bp_manager.remove(self._num, self._is_reusable())
 
 
 # -------------------------------------------------------------------------------------------------
@@ -170,14 +418,221 @@ class Barrier(HaltPoint):
         return self.wait_complete(timeout)
 
 
+# -------------------------------------------------------------------------------------------------
+class SyncResult(object):
+    """
+    Timing of a synchronized release of a SyncGroup. All times are host times (time.perf_counter) in seconds.
+    """
+    def __init__(self, issue_times: List[float], ack_times: List[float]) -> None:
+        self._issue_times: List[float] = issue_times
+        self._ack_times: List[float] = ack_times
+
+    @property
+    def issue_times(self) -> List[float]:
+        """
+        Times at which -exec-continue was issued to the GDB instances (in the order of the group's targets).
+        """
+        return self._issue_times
+
+    @property
+    def ack_times(self) -> List[float]:
+        """
+        Times at which the GDB instances acknowledged that the targets are running.
+        """
+        return self._ack_times
+
+    @property
+    def issue_skew(self) -> float:
+        return max(self._issue_times) - min(self._issue_times)
+
+    @property
+    def ack_skew(self) -> float:
+        """
+        Spread of the acknowledge times. It is an upper bound for the skew between the actual restarts of the targets
+        (plus the difference in the latencies of GDB servers and probes).
+        """
+        return max(self._ack_times) - min(self._ack_times)
+
+    def __str__(self) -> str:
+        return f'issue skew: {self.issue_skew * 1e3:.3f} ms, acknowledge skew: {self.ack_skew * 1e3:.3f} ms'
+
+
+class SyncGroup(object):
+    """
+    Cross-target barrier: halts several targets (e.g., the boards of a multi-board system test) at chosen points and
+    releases them together. To keep the skew between the targets' restarts low, the run-control preparation of all
+    targets is done first and then all threads issuing -exec-continue (one per target, i.e., one per GDB instance)
+    are released at once. The measured skew is reported for each release (see SyncResult). Example:
+
+    group = SyncGroup({master: 'app_main', slave: 'app_main'})
+    group.wait_reached(timeout=5)
+    res = group.release()
+    """
+    def __init__(self, points: Dict['Target', str] = None, targets: List['Target'] = None) -> None:
+        """
+        Constructor.
+
+        Args:
+            points: Halt point location per target. For each target a halt point is created; the targets have to be
+                    continued (e.g., by release) to eventually reach them.
+            targets: Targets of the group which are halted by other means (e.g., halt); used if points is None.
+        """
+        if points is not None:
+            self._targets: List['Target'] = list(points.keys())
+            self._hps: List[HaltPoint] = [HaltPoint(location, target=t) for t, location in points.items()]
+        else:
+            self._targets = list(targets) if targets is not None else []
+            self._hps = []
+        if len(self._targets) < 1:
+            raise DottException('A SyncGroup requires at least one target.')
+
+    @property
+    def targets(self) -> List['Target']:
+        return self._targets
+
+    def wait_reached(self, timeout: float = None) -> None:
+        """
+        Waits until all targets have reached their halt point.
+        """
+        for hp in self._hps:
+            hp.wait_complete(timeout)
+
+    def halt(self) -> None:
+        """
+        Halts all targets of the group (one after the other).
+        """
+        for t in self._targets:
+            t.halt()
+
+    def release(self, timeout: float = 5.0) -> SyncResult:
+        """
+        Resumes all (halted) targets of the group with minimal skew.
+
+        Returns: Timing of the release.
+        """
+        num = len(self._targets)
+        start = threading.Barrier(num)
+        issue_times: List[float] = [0.0] * num
+        ack_times: List[float] = [0.0] * num
+        errors: List[Exception] = []
+
+        def resume(idx: int, t: 'Target') -> None:
+            try:
+                # note: everything which may take time (memory cache write-back, probe coordination) is done before
+                # the threads are released at the start barrier
+                t._mem_cache_sync()
+                with t._run_control():
+                    start.wait(timeout)
+                    issue_times[idx] = time.perf_counter()
+                    t.exec('-exec-continue')
+                    ack_times[idx] = time.perf_counter()
+                    t.wait_running()
+            except Exception as ex:
+                errors.append(ex)
+                start.abort()  # note: releases the other threads (with an error) if they wait at the barrier
+
+        threads = [threading.Thread(target=resume, args=(idx, t), name=f'SyncGroup{idx}', daemon=True)
+                   for idx, t in enumerate(self._targets)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        if len(errors) > 0:
+            raise DottException(f'Synchronized release failed ({errors[0]}).')
+
+        res = SyncResult(issue_times, ack_times)
+        log.debug(f'SyncGroup released {num} targets ({res}).')
+        return res
+
+    def sync(self, timeout: float = None) -> SyncResult:
+        """
+        Waits until all targets have reached their halt point and releases them together.
+        """
+        self.wait_reached(timeout)
+        return self.release()
+
+    def delete(self) -> None:
+        for hp in self._hps:
+            hp.delete()
+        self._hps = []
+
+
+# -------------------------------------------------------------------------------------------------
+class WatchPoint(HaltPoint):
+    """
+    Hardware watchpoint (e.g., backed by the DWT comparators of Cortex-M devices) which halts the target when the
+    given expression is written (mode 'write'), read ('read') or accessed ('access'). Waiting for, evaluating and
+    continuing from a watchpoint works the same way as for a HaltPoint. Note: When a data watchpoint triggers, the
+    target is halted after the instruction which accessed the memory.
+    """
+    _check_location: bool = False
+
+    # MI option and key of the watchpoint information in the MI response per watch mode
+    _MODES = {'write': ('', 'wpt'), 'read': ('-r', 'hw-rwpt'), 'access': ('-a', 'hw-awpt')}
+
+    def __init__(self, expr: str, mode: str = 'write', target: 'Target' = None, condition: str = None,
+                 ignore_count: int = 0):
+        if mode not in WatchPoint._MODES:
+            raise DottException(f'Unsupported watch mode "{mode}" (supported: {list(WatchPoint._MODES.keys())}).')
+        Breakpoint.__init__(self, expr, target)
+        self._q: queue.Queue = queue.Queue()
+        self._value: Dict = None
+        self._temporary: bool = False
+        self._watch_exprs: List[str] = []
+        self._values: Dict = {}
+
+        option, key = WatchPoint._MODES[mode]
+        try:
+            msg = self._dott_target.exec(f'-break-watch {option} {expr}')
+            self._dott_target.bp_registry.applied('-break-watch', msg)
+        except Exception as ex:
+            log.error('Creating watchpoint failed.')
+            log.exception(ex)
+            raise ex
+
+        self._bp_info: Dict = msg.get('payload', {}).get(key) if msg is not None else None
+        if self._bp_info is None:
+            raise Exception('Invalid watchpoint information.')
+        self._num = int(self._bp_info['number'])
+
+        if condition is not None or ignore_count > 0:
+            self._condition = condition
+            self._ignore_count = ignore_count
+            self._apply_filter()
+
+        # add watchpoint to breakpoint handler
+        self._dott_target.bp_handler.add_bp(self)
+
+    @property
+    def value(self) -> Dict:
+        """
+        Value information reported by GDB for the most recent trigger (write: 'old' and 'new'; read: 'value').
+        """
+        return self._value
+
+    def reached_internal(self, payload=None) -> None:
+        if payload is not None:
+            self._value = payload.get('value')
+        super().reached_internal(payload)
+
+    def delete(self) -> None:
+        # watchpoints use data watchpoint comparators and are not handled by the breakpoint manager
+        if self._watch_id is not None:
+            self._watch_send([])
+        self._dott_target.exec(f'-break-delete {self._num}')
+        self._dott_target.bp_registry.applied(f'-break-delete {self._num}')
+        self._dott_target.bp_handler.remove_bp(self)
+
+
 # -------------------------------------------------------------------------------------------------
 class InterceptPointCmds(Breakpoint):
     def __init__(self, location: str, commands: List, target: 'Target' = None):
         super().__init__(location, target)
         # serialize function name and commands using JSON and supply them to custom GDB command
-        com = json.dumps([location] + commands)
+        com = json.dumps([self._gdb_location] + commands)
         com = com.replace('"', '\\"')
         self._dott_target.exec(f'dott-bp-nostop-cmd {com}')
+        self._dott_target.bp_manager.reserve()
 
     def wait_complete(self, timeout: float = None) -> None:
         warnings.warn('You can not wait for the completion of a intercept breakpoint.')
@@ -195,14 +650,21 @@ class InterceptPointCmds(Breakpoint):
         warnings.warn('A command intercept point only executes the commands set in the constructor.')
 
     def delete(self) -> None:
-        self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._location}')
+        self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}')
+        self._dott_target.bp_manager.release()
 
     def get_hits(self) -> None:
         warnings.warn('Unable to report hits for intercept point with command list.')
 
 
 # -------------------------------------------------------------------------------------------------
-class InterceptPoint(threading.Thread, Breakpoint):
+class InterceptPoint(Breakpoint):
+    """
+    Breakpoint which does not halt the target from DOTT's point of view. When the breakpoint is reached, its reached
+    method is called (from DOTT's intercept point dispatcher thread) while GDB is still processing the breakpoint. In
+    reached, commands can be executed in the context of the breakpoint (exec, eval, ret). The target resumes execution
+    once reached returns. All intercept points of a target share one channel to GDB (see InterceptPointChannel).
+    """
     _intercept_points = []
 
     @staticmethod
@@ -213,61 +675,162 @@ class InterceptPoint(threading.Thread, Breakpoint):
     def _unregister(ipoint: 'InterceptPoint') -> None:
         InterceptPoint._intercept_points.remove(ipoint)
 
+    @staticmethod
+    def _release(item) -> None:
+        # host-side cleanup of an intercept point (or other no-stop breakpoint) after it was deleted on GDB side
+        if item._uses_bp_comparator:
+            for _ in range(getattr(item, '_num_comparators', 1)):
+                item._dott_target.bp_manager.release()
+        if getattr(item, '_channel', None) is not None:
+            item._channel.remove_ip(item._id)
+        if isinstance(item, AssertPoint):
+            item._dott_target.bp_handler.remove_bp(item)
+        InterceptPoint._unregister(item)
+
     @staticmethod
     def delete_all() -> None:
-        # iterate over a copy
-        for item in InterceptPoint._intercept_points[:]:
-            item.delete()
+        # the intercept points of a target are deleted with one GDB command (instead of one exchange per point)
+        per_target: Dict['Target', List] = {}
+        for item in InterceptPoint._intercept_points[:]:  # iterate over a copy
+            if item._running:
+                item._running = False
+                per_target.setdefault(item._dott_target, []).append(item)
+        for target, items in per_target.items():
+            spec = binascii.hexlify(json.dumps([i._gdb_location for i in items]).encode('utf-8')).decode('ascii')
+            try:
+                target.cli_exec(f'dott-bp-nostop-delete-many {spec}', timeout=1)
+            except Exception as ex:
+                log.warn(f'Deleting intercept points failed ({ex}).')
+            for item in items:
+                InterceptPoint._release(item)
         if len(InterceptPoint._intercept_points) != 0:
             log.warn('Not all Intercept points were deleted!')
 
+    @staticmethod
+    def discard_all(target: 'Target') -> None:
+        # drops the intercept points of a target whose connection has been lost without contacting GDB (see
+        # Target.recover); the breakpoints are gone together with the GDB instance
+        for item in InterceptPoint._intercept_points[:]:
+            if item._dott_target is target:
+                item._running = False
+                InterceptPoint._unregister(item)
+
     # ---------------------------------------------------------------------------------------------
-    def __init__(self, location: str, target: 'Target' = None):
+    def __init__(self, location: str, target: 'Target' = None, condition: str = None, ignore_count: int = 0):
         Breakpoint.__init__(self, location, target)
-        threading.Thread.__init__(self, name='InterceptPoint')
         self._running: bool = False
-        self._event: multiprocessing.Event = multiprocessing.Event()
-        self._event.clear()
-
-        # open server socket for incoming connection from custom GDB command
-        srv_sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-        srv_sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-        srv_sock.bind(('127.0.0.1', BpSharedConf.GDB_CMD_SERVER_PORT))
-        srv_sock.listen(1)
-
-        # call custom GDB command
-        self._dott_target.cli_exec(f'dott-bp-nostop-tcp {self._location}')
-
-        self._sock, addr = srv_sock.accept()
-        srv_sock.close()
+        # completed hits and hits consumed by waiters (see wait_hits); counting (instead of a flag) does not lose hits
+        # which complete while no thread is waiting
+        self._hit_cond: threading.Condition = threading.Condition()
+        self._hits_done: int = 0
+        self._hits_taken: int = 0
+
+        # register with the channel shared by all intercept points and create the breakpoint via custom GDB command
+        self._channel: 'InterceptPointChannel' = self._dott_target.ip_channel
+        self._id: int = self._channel.add_ip(self)
+        self._dott_target.cli_exec(self._create_cmd())
+        self._running = True
+        if self._uses_bp_comparator:
+            self._dott_target.bp_manager.reserve()
+        if condition is not None or ignore_count > 0:
+            self._condition = condition
+            self._ignore_count = ignore_count
+            self._apply_filter()
 
         InterceptPoint._register(self)
-        self.start()
 
-    def exec(self, cmd: str) -> None:
-        msg = BpMsg(BpMsg.MSG_TYPE_EXEC, payload=bytes(cmd, 'ascii'))
-        msg.send_to_socket(self._sock)
+    def _create_cmd(self) -> str:
+        return f'dott-bp-nostop-tcp {self._id} {self._gdb_location}'
 
-        res = BpMsg.read_from_socket(self._sock)
+    def _request(self, msg_type: bytes, cmd: Union[str, bytes], desc: str = None) -> BpMsg:
+        payload = bytes(cmd, 'ascii') if isinstance(cmd, str) else cmd
+        if len(payload) > BpMsg.MSG_PAYLOAD_LEN_MAX:
+            raise DottException(f'Breakpoint message exceeds maximum length of {BpMsg.MSG_PAYLOAD_LEN_MAX} bytes.')
+        res = self._channel.request(BpMsg(msg_type, payload=payload, bp_id=self._id))
         if res.get_type() == BpMsg.MSG_TYPE_EXCEPT:
-            raise RuntimeError(f'Execution of command "{cmd}" in breakpoint context failed. '
+            raise RuntimeError(f'Execution of command "{cmd if desc is None else desc}" in breakpoint context failed. '
                                f'{res.get_payload().decode("ascii")}')
+        return res
 
-    def eval(self, cmd: str) -> Union[int, float, str]:
-        msg = BpMsg(BpMsg.MSG_TYPE_EVAL, payload=bytes(cmd, 'ascii'))
-        msg.send_to_socket(self._sock)
+    def exec(self, cmd: str) -> None:
+        self._request(BpMsg.MSG_TYPE_EXEC, cmd)
 
-        res = BpMsg.read_from_socket(self._sock)
-        if res.get_type() == BpMsg.MSG_TYPE_EXCEPT:
-            raise RuntimeError(f'Execution of command "{cmd}" in breakpoint context failed. '
-                               f'{res.get_payload().decode("ascii")}')
-        res = cast_str(res.get_payload())
+    def eval(self, cmd: str) -> Union[int, float, str]:
+        res = BpMsg.decode_value(self._request(BpMsg.MSG_TYPE_EVAL, cmd).get_payload())
+        if isinstance(res, str):
+            res = cast_str(res)
 
         if '<optimized out>' in str(res):
             log.warn(f'Accessed entity {cmd} is optimized out in the binary.')
 
         return res
 
+    def read_mem(self, addr: Union[int, str], num_bytes: int) -> bytes:
+        """
+        Reads target memory in the context of the breakpoint. The memory is transferred as raw binary data in a
+        single message (i.e., also large buffers are transferred without text conversion).
+
+        Args:
+            addr: Start address (or name of a global variable) of the memory to read.
+            num_bytes: Number of bytes to read.
+
+        Returns:
+            The memory content.
+        """
+        addr = self._dott_target.symbols.addr(addr) if isinstance(addr, str) else addr
+        payload = struct.pack(BpMsg.MEM_FMT, addr, num_bytes)
+        res = self._request(BpMsg.MSG_TYPE_READ_MEM, payload, f'read_mem(0x{addr:x}, {num_bytes})')
+        return res.get_payload() if res.get_payload() is not None else b''
+
+    def write_mem(self, addr: Union[int, str], data: bytes) -> None:
+        """
+        Writes target memory in the context of the breakpoint (raw binary data in a single message).
+
+        Args:
+            addr: Start address (or name of a global variable) of the memory to write.
+            data: Data to be written (bytes or any object supporting the buffer protocol, e.g., numpy arrays).
+        """
+        addr = self._dott_target.symbols.addr(addr) if isinstance(addr, str) else addr
+        data = memoryview(data).cast('B').tobytes()
+        payload = struct.pack(BpMsg.MEM_FMT, addr, len(data)) + data
+        self._request(BpMsg.MSG_TYPE_WRITE_MEM, payload, f'write_mem(0x{addr:x}, {len(data)})')
+
+    # names used by the direct target connections (see TargetDirect)
+    mem_read = read_mem
+    mem_write = write_mem
+
+    def eval_many(self, cmds: List[str]) -> List[Union[int, float, str]]:
+        """
+        Batched variant of eval. All expressions are sent to GDB in a single message and all results are returned in
+        a single response which considerably reduces the time the target is halted in the breakpoint.
+
+        Args:
+            cmds: Expressions to be evaluated in the context of the breakpoint.
+
+        Returns:
+            List with the evaluation results.
+        """
+        res = self._request(BpMsg.MSG_TYPE_EVAL_MANY, json.dumps(cmds))
+        ret_vals = []
+        for cmd, (ok, val) in zip(cmds, json.loads(res.get_payload().decode('ascii'))):
+            if not ok:
+                raise RuntimeError(f'Execution of command "{cmd}" in breakpoint context failed. {val}')
+            val = cast_str(val)
+            if '<optimized out>' in str(val):
+                log.warn(f'Accessed entity {cmd} is optimized out in the binary.')
+            ret_vals.append(val)
+        return ret_vals
+
+    def exec_many(self, cmds: List[str]) -> None:
+        """
+        Batched variant of exec. All commands are sent to GDB in a single message. Execution stops at the first
+        failing command.
+
+        Args:
+            cmds: Commands to be executed in the context of the breakpoint.
+        """
+        self._request(BpMsg.MSG_TYPE_EXEC_MANY, json.dumps(cmds))
+
     def ret(self, ret_val: Union[int, str] = None) -> None:
         if ret_val is not None:
             self.exec(f'return {ret_val}')
@@ -279,9 +842,64 @@ class InterceptPoint(threading.Thread, Breakpoint):
         pass
 
     def _signal_complete(self) -> None:
-        self._event.set()
+        with self._hit_cond:
+            self._hits_done += 1
+            self._hit_cond.notify_all()
+        self._notify_complete_listeners()
+
+    def _wait_pending(self, num_hits: int, timeout: float) -> bool:
+        # waits until at least num_hits completed hits have not been consumed yet
+        with self._hit_cond:
+            return self._hit_cond.wait_for(lambda: self._hits_done - self._hits_taken >= num_hits, timeout)
+
+    def _take(self, num_hits: int = None) -> List[int]:
+        # consumes the given number of pending hits (all if None) and returns their hit numbers (starting at 1)
+        with self._hit_cond:
+            first = self._hits_taken + 1
+            self._hits_taken = self._hits_done if num_hits is None else self._hits_taken + num_hits
+            return list(range(first, self._hits_taken + 1))
+
+    def poll_complete(self) -> bool:
+        return len(self._take()) > 0
+
+    def wait_hits(self, num_hits: int, timeout: float = None) -> List[int]:
+        """
+        Waits until the breakpoint has been completed num_hits times since the hits have last been consumed (by
+        wait_hits, hits, wait_complete or poll_complete) and consumes them. Hits which complete while no thread is
+        waiting are not lost.
+
+        Args:
+            num_hits: Number of hits to wait for.
+            timeout: Maximum time to wait (seconds). If None, a timeout of 20 seconds per hit is used.
+
+        Returns:
+            The numbers of the consumed hits (the first hit of the breakpoint has number 1).
+        """
+        if timeout is None:
+            timeout = 20 * num_hits
+        if not self._wait_or_lost(lambda secs: self._wait_pending(num_hits, secs), timeout):
+            with self._hit_cond:
+                pending = self._hits_done - self._hits_taken
+            raise TimeoutError(f'Breakpoint {self._location} reached {pending} of {num_hits} times within timeout of '
+                               f'{timeout}secs.')
+        return self._take(num_hits)
+
+    def hits(self, timeout: float = 0):
+        """
+        Iterator over the hits of the breakpoint (hit numbers, see wait_hits). The iteration ends once no further hit
+        completes within the given timeout (seconds); with the default timeout of 0, only the hits which have already
+        completed are returned. For example:
+            for hit in ip.hits(timeout=1.0):
+                ...
+        """
+        while True:
+            try:
+                yield self.wait_hits(1, timeout)[0]
+            except TimeoutError:
+                return
 
     def wait_complete(self, timeout: float = None) -> None:
+        # note: all hits completed so far are consumed (use wait_hits to consume hits one by one)
         timeout_override = False
 
         # If no timeout was given set a reasonable high override timeout
@@ -289,66 +907,934 @@ class InterceptPoint(threading.Thread, Breakpoint):
         if timeout is None:
             timeout_override = True
             timeout = 20
-        wait_ok = self._event.wait(timeout)
-        self._event.clear()
+        wait_ok = self._wait_or_lost(lambda secs: self._wait_pending(1, secs), timeout)
+        self._take()
 
         if (not wait_ok) and timeout_override:
             raise TimeoutError(f'Breakpoint {self._location} not reached after override timeout of {timeout}secs.')
         elif (not wait_ok) and (not timeout_override):
             raise TimeoutError(f'Breakpoint {self._location} not reached after timeout of {timeout}secs.')
 
-    def run(self) -> None:
+    def reached_internal(self) -> None:
+        # called by the channel's dispatcher thread when GDB reports that the breakpoint was hit
+        self._hits += 1
+        try:
+            self._dott_target.gdb_client.gdb_mi.context.acquire_context(self, GdbMiContext.BP_INTERCEPT)
+            self.reached()
+        except Exception as ex:
+            log.exception(ex)
+            log.warn('Breakpoint execution failed. Letting target continue anyway. '
+                     'Remaining breakpoint commands in "reached" are discarded')
+        finally:
+            self._dott_target.gdb_client.gdb_mi.context.release_context(self)
+
+        self._channel.send(BpMsg(BpMsg.MSG_TYPE_FINISH_CONT, bp_id=self._id))
+
+        # notify threads which are potentially waiting for completion of this breakpoint
+        self._signal_complete()
+
+    def delete(self) -> None:
+        try:
+            if self._running:
+                self._running = False
+                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}', timeout=1)
+                InterceptPoint._release(self)
+        except:
+            pass
+
+    def __del__(self):
+        self.delete()
+
+
+# -------------------------------------------------------------------------------------------------
+class InterceptWatchPoint(InterceptPoint):
+    """
+    Hardware watchpoint which behaves like an InterceptPoint: When the expression is written (mode 'write'), read
+    ('read') or accessed ('access'), reached is called while GDB keeps the target halted; afterwards the target
+    continues automatically.
+    """
+    _check_location: bool = False
+    _uses_bp_comparator: bool = False
+    _MODES = {'write': '-w', 'read': '-r', 'access': '-a'}
+
+    def __init__(self, expr: str, mode: str = 'write', target: 'Target' = None, condition: str = None,
+                 ignore_count: int = 0):
+        if mode not in InterceptWatchPoint._MODES:
+            raise DottException(f'Unsupported watch mode "{mode}" (supported: {list(InterceptWatchPoint._MODES)}).')
+        self._mode: str = mode
+        super().__init__(expr, target, condition, ignore_count)
+
+    def _create_cmd(self) -> str:
+        return f'dott-bp-nostop-tcp {self._id} {InterceptWatchPoint._MODES[self._mode]} {self._location}'
+
+
+# -------------------------------------------------------------------------------------------------
+class InterceptAction(object):
+    """
+    Factory for the actions of an InterceptPointActions. Every action (except count) can be made conditional using
+    the cond argument which is a target expression evaluated when the breakpoint is hit.
+    """
+    @staticmethod
+    def _action(op: str, cond: str = None, **kwargs) -> Dict:
+        action = {'op': op}
+        action.update(kwargs)
+        if cond is not None:
+            action['if'] = cond
+        return action
+
+    @staticmethod
+    def read(expr: str, cond: str = None) -> Dict:
+        """ Evaluates expr and adds the result to the record of the hit. """
+        return InterceptAction._action('read', cond, expr=expr)
+
+    @staticmethod
+    def set(expr: str, val: Union[int, str], cond: str = None) -> Dict:
+        """ Assigns val to expr (e.g., a variable or register). """
+        return InterceptAction._action('set', cond, expr=expr, val=str(val))
+
+    @staticmethod
+    def ret(val: Union[int, str] = None, cond: str = None) -> Dict:
+        """ Returns from the intercepted function (optionally with a return value). Skips the remaining actions. """
+        return InterceptAction._action('ret', cond, val=None if val is None else str(val))
+
+    @staticmethod
+    def count(name: str, cond: str = None) -> Dict:
+        """ Increments the counter with the given name. """
+        return InterceptAction._action('count', cond, name=name)
+
+
+# -------------------------------------------------------------------------------------------------
+class InterceptPointActions(Breakpoint):
+    """
+    Intercept point which executes a list of declarative actions (see InterceptAction) entirely in GDB's context
+    without a round trip to DOTT. The values read on every hit are streamed to DOTT asynchronously and are kept in a
+    ring buffer. This allows to intercept high-frequency events (e.g., interrupts) where the latency of an
+    InterceptPoint is not acceptable. Example:
+
+    ip = InterceptPointActions('my_isr', [InterceptAction.read('status'),
+                                          InterceptAction.count('errors', cond='status & 0x80'),
+                                          InterceptAction.set('status', 0, cond='status & 0x80')])
+    ...
+    records = ip.pop_records()  # list of records; each record is a list with the read values
+    """
+    def __init__(self, location: str, actions: List[Dict], buffer_size: int = 1024, target: 'Target' = None):
+        super().__init__(location, target)
+        self._records: Deque = collections.deque(maxlen=buffer_size)
+        self._counts: Dict[str, int] = {}
+        self._errors: int = 0
+        self._lock: threading.Lock = threading.Lock()
+        self._event: threading.Event = threading.Event()
+        self._running: bool = False
+
+        self._channel: 'InterceptPointChannel' = self._dott_target.ip_channel
+        self._id: int = self._channel.add_ip(self)
+        spec = json.dumps({'location': self._gdb_location, 'actions': actions})
+        self._dott_target.cli_exec(f'dott-bp-nostop-actions {self._id} {binascii.hexlify(spec.encode()).decode()}')
         self._running = True
+        self._dott_target.bp_manager.reserve()
 
-        while self._running:
-            # wait for 'breakpoint hit' message
-            try:
-                msg = BpMsg.read_from_socket(self._sock)
-                if msg.get_type() != BpMsg.MSG_TYPE_HIT:
-                    log.warn(f'Received breakpoint message of type {msg.get_type()} while waiting for type "HIT"')
-                self._hits += 1
-            except ConnectionAbortedError:
-                log.warn(f'Breakpoint {self._location}: connection aborted')
+        InterceptPoint._register(self)
+
+    def record_internal(self, payload: bytes) -> None:
+        # called by the channel's dispatcher thread for every hit of the breakpoint
+        record = json.loads(payload.decode('utf-8'))
+        with self._lock:
+            self._hits = record['hit']
+            self._counts = record['counts']
+            self._records.append([cast_str(v) for v in record['vals']])
+            if 'err' in record:
+                self._errors += 1
+                log.warn(f'Intercept point {self._location}: action failed ({record["err"]}).')
+        self._event.set()
+        self._notify_complete_listeners()
+
+    @property
+    def counts(self) -> Dict[str, int]:
+        with self._lock:
+            return dict(self._counts)
+
+    @property
+    def errors(self) -> int:
+        return self._errors
+
+    def pop_records(self) -> List[List]:
+        """
+        Returns (and removes) all records received so far. Each record is the list of values read on one hit. If more
+        records than the buffer size were received, only the most recent ones are kept.
+        """
+        with self._lock:
+            records = list(self._records)
+            self._records.clear()
+        return records
+
+    def poll_complete(self) -> bool:
+        if self._event.is_set():
+            self._event.clear()
+            return True
+        return False
+
+    def wait_complete(self, timeout: float = None) -> None:
+        if not self._wait_or_lost(self._event.wait, timeout if timeout is not None else 20):
+            raise TimeoutError(f'Breakpoint {self._location} not reached.')
+        self._event.clear()
+
+    def exec(self, cmd: str) -> None:
+        warnings.warn('An action intercept point only executes the actions set in the constructor.')
+
+    def eval(self, cmd: str) -> None:
+        warnings.warn('An action intercept point only executes the actions set in the constructor.')
+
+    def ret(self, ret_val: Union[int, str] = None):
+        warnings.warn('An action intercept point only executes the actions set in the constructor.')
+
+    def reached(self) -> None:
+        warnings.warn('An action intercept point only executes the actions set in the constructor.')
+
+    def delete(self) -> None:
+        try:
+            if self._running:
+                self._running = False
+                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}', timeout=1)
+                InterceptPoint._release(self)
+        except:
+            pass
+
+    def __del__(self):
+        self.delete()
+
+
+# -------------------------------------------------------------------------------------------------
+class Snapshot(object):
+    """
+    Memory of the regions of a SnapshotPoint captured on one hit.
+    """
+    def __init__(self, hit: int, gdb_time: float, host_time: float, data: Dict[str, bytes], byte_order: str) -> None:
+        self.hit: int = hit
+        self.gdb_time: float = gdb_time  # GDB host time (time.time) when the memory was read
+        self.host_time: float = host_time  # DOTT host time (time.perf_counter) when the snapshot was received
+        self.data: Dict[str, bytes] = data  # raw memory per region
+        self._bo: str = byte_order
+
+    def value(self, region: str, fmt: str = 'I') -> Union[int, float]:
+        """
+        Returns the first value of the given region decoded with the given struct format character in the byte order
+        of the target (e.g., 'I' for uint32_t, 'h' for int16_t, 'f' for float).
+        """
+        return struct.unpack_from(self._bo + fmt, self.data[region])[0]
+
+    def values(self, region: str, fmt: str = 'I') -> List[Union[int, float]]:
+        """
+        Returns all values of the given region (e.g., of an array) decoded with the given struct format character.
+        """
+        num = len(self.data[region]) // struct.calcsize(fmt)
+        return list(struct.unpack_from(f'{self._bo}{num}{fmt}', self.data[region]))
+
+
+class SnapshotPoint(Breakpoint):
+    """
+    Breakpoint (or hardware watchpoint) which captures the memory of a set of regions on every hit without waking up
+    DOTT. The regions are resolved to addresses once, when the snapshot point is created; on a hit, GDB only reads the
+    memory (adjacent regions are merged into one read) and streams it to DOTT asynchronously via the intercept point
+    channel. The target continues as soon as the memory has been read. The snapshots are kept in a ring buffer.
+    Example:
+
+    sp = SnapshotPoint('ADC_IRQHandler', ['adc_raw', 'filter_state', ('0x40012440', 4)])
+    dt.cont()
+    ...
+    for snap in sp.wait(100, timeout=2.0):
+        log.info(f'{snap.hit}: {snap.value("adc_raw", "H")} {snap.values("filter_state", "i")}')
+
+    sp = SnapshotPoint('rx_count', ['rx_buf'], mode='write')  # capture whenever rx_count is written (DWT)
+    """
+    _MODES = {'write': '-w', 'read': '-r', 'access': '-a'}
+
+    # maximum distance (bytes) of two regions which are still captured with one memory read
+    MERGE_GAP = 16
+
+    def __init__(self, location: str, regions: List[Union[str, Tuple[Union[int, str], int]]], buffer_size: int = 4096,
+                 mode: str = None, target: 'Target' = None):
+        """
+        Args:
+            location: Location which triggers the capture (e.g., a function name) or, if mode is given, the expression
+                      which is watched with a hardware watchpoint.
+            regions: Regions to capture. Each region is a symbol or expression (address and size are determined
+                     once, e.g., 'adc_raw' or 'ctx.state') or an (address, size) tuple.
+            buffer_size: Maximum number of snapshots which are kept until they are popped.
+            mode: None (breakpoint at location) or 'write', 'read', 'access' (watchpoint on the location expression).
+        """
+        if mode is not None and mode not in SnapshotPoint._MODES:
+            raise DottException(f'Unsupported watch mode "{mode}" (supported: {list(SnapshotPoint._MODES)}).')
+        if mode is not None:
+            self._check_location = False
+            self._uses_bp_comparator = False
+        super().__init__(location, target)
+        self._snapshots: Deque[Snapshot] = collections.deque(maxlen=buffer_size)
+        self._lost: int = 0
+        self._errors: int = 0
+        self._lock: threading.Lock = threading.Lock()
+        self._cond: threading.Condition = threading.Condition(self._lock)
+        self._bo: str = '<' if self._dott_target.byte_order == 'little' else '>'
+        self._running: bool = False
+
+        self._regions: List[Tuple[str, int, int]] = [self._resolve(r) for r in regions]
+        self._reads: List[Tuple[int, int]] = self._merge(self._regions)
+
+        self._channel: 'InterceptPointChannel' = self._dott_target.ip_channel
+        self._id: int = self._channel.add_ip(self)
+        spec = json.dumps({'location': self._gdb_location, 'watch': SnapshotPoint._MODES.get(mode),
+                           'regions': self._reads})
+        self._dott_target.cli_exec(f'dott-bp-snapshot {self._id} {binascii.hexlify(spec.encode()).decode()}')
+        self._running = True
+        self._dott_target.bp_manager.reserve()
+
+        InterceptPoint._register(self)
+
+    def _resolve(self, region: Union[str, Tuple[Union[int, str], int]]) -> Tuple[str, int, int]:
+        # returns name, address and size of the given region
+        if not isinstance(region, str):
+            addr, size = region
+            addr = int(addr, 0) if isinstance(addr, str) else int(addr)
+            return f'0x{addr:08x}', addr, int(size)
+        sym = self._dott_target.symbols.lookup(region)
+        if sym is not None and sym['size'] > 0:
+            return region, sym['addr'], sym['size']
+        addr, size = self._dott_target.eval_many([f'(unsigned long)&({region})', f'sizeof({region})'])
+        if not isinstance(addr, int) or not isinstance(size, int):
+            raise DottException(f'Unable to determine address and size of snapshot region "{region}".')
+        return region, addr, size
+
+    @staticmethod
+    def _merge(regions: List[Tuple[str, int, int]]) -> List[List[int]]:
+        # memory reads (address, size) covering all regions; regions closer than MERGE_GAP are read at once
+        reads: List[List[int]] = []
+        for _, addr, size in sorted(regions, key=lambda r: r[1]):
+            if len(reads) > 0 and addr <= reads[-1][0] + reads[-1][1] + SnapshotPoint.MERGE_GAP:
+                reads[-1][1] = max(reads[-1][1], addr + size - reads[-1][0])
+            else:
+                reads.append([addr, size])
+        return reads
+
+    def record_internal(self, payload: bytes) -> None:
+        # called by the channel's dispatcher thread for every hit of the snapshot point
+        host_time = time.perf_counter()
+        hit, gdb_time, status = struct.unpack_from(BpMsg.SNAPSHOT_FMT, payload)
+        data = payload[struct.calcsize(BpMsg.SNAPSHOT_FMT):]
+        if status != 0:
+            with self._lock:
+                self._hits = hit
+                self._errors += 1
+            log.warn(f'Snapshot point {self._location}: capture failed ({data.decode("utf-8", "replace")}).')
+            return
+
+        # note: the payload holds the memory of the merged reads back to back
+        offsets: Dict[int, int] = {}
+        pos = 0
+        for addr, size in self._reads:
+            offsets[addr] = pos
+            pos += size
+        regions: Dict[str, bytes] = {}
+        for name, addr, size in self._regions:
+            base = max(a for a in offsets if a <= addr)
+            start = offsets[base] + addr - base
+            regions[name] = data[start:start + size]
+
+        with self._cond:
+            if len(self._snapshots) == self._snapshots.maxlen:
+                self._lost += 1
+            self._hits = hit
+            self._hit_time = host_time
+            self._snapshots.append(Snapshot(hit, gdb_time, host_time, regions, self._bo))
+            self._cond.notify_all()
+        self._notify_complete_listeners()
+
+    @property
+    def regions(self) -> List[Tuple[str, int, int]]:
+        """
+        Name, address and size of the captured regions.
+        """
+        return list(self._regions)
+
+    @property
+    def lost(self) -> int:
+        """
+        Number of snapshots which were discarded because the buffer was full.
+        """
+        return self._lost
+
+    @property
+    def errors(self) -> int:
+        return self._errors
+
+    def pop(self) -> List[Snapshot]:
+        """
+        Returns (and removes) all snapshots received so far (oldest first).
+        """
+        with self._lock:
+            snapshots = list(self._snapshots)
+            self._snapshots.clear()
+        return snapshots
+
+    def wait(self, count: int, timeout: float = None) -> List[Snapshot]:
+        """
+        Waits until at least count snapshots are buffered and returns (and removes) them. A TimeoutError is raised if
+        fewer snapshots were received within the timeout (seconds, default: 20).
+        """
+        def wait_fn(secs: float) -> bool:
+            with self._cond:
+                return self._cond.wait_for(lambda: len(self._snapshots) >= count, secs)
+
+        if not self._wait_or_lost(wait_fn, timeout if timeout is not None else 20):
+            raise TimeoutError(f'Snapshot point {self._location}: {len(self._snapshots)} of {count} snapshots '
+                               f'received.')
+        return self.pop()
+
+    def poll_complete(self) -> bool:
+        with self._lock:
+            return len(self._snapshots) > 0
+
+    def wait_complete(self, timeout: float = None) -> None:
+        self.wait(1, timeout)
+
+    def exec(self, cmd: str) -> None:
+        warnings.warn('A snapshot point only captures the regions set in the constructor.')
+
+    def eval(self, cmd: str) -> None:
+        warnings.warn('A snapshot point only captures the regions set in the constructor.')
+
+    def ret(self, ret_val: Union[int, str] = None):
+        warnings.warn('A snapshot point only captures the regions set in the constructor.')
+
+    def reached(self) -> None:
+        warnings.warn('A snapshot point only captures the regions set in the constructor.')
+
+    def delete(self) -> None:
+        try:
+            if self._running:
                 self._running = False
-                break
-            except ConnectionResetError:
-                log.warn(f'Breakpoint {self._location}: connection reset')
+                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}', timeout=1)
+                InterceptPoint._release(self)
+        except:
+            pass
+
+    def __del__(self):
+        self.delete()
+
+
+# -------------------------------------------------------------------------------------------------
+class TracePoint(Breakpoint):
+    """
+    Breakpoint which records every hit (hit number, GDB host timestamp and the values of the given expressions) in a
+    GDB-side ring buffer without waking up DOTT. The target only halts for as long as GDB needs to evaluate the
+    expressions. The recorded hits are fetched on demand using drain. Example:
+
+    tp = TracePoint('timer_advance', ['ticks', 'delta'])
+    ...
+    for hit, timestamp, (ticks, delta) in tp.drain():
+        ...
+    """
+    _next_id: int = 1
+
+    def __init__(self, location: str, exprs: List[str] = None, buffer_size: int = 4096, target: 'Target' = None):
+        super().__init__(location, target)
+        self._id: int = TracePoint._next_id
+        TracePoint._next_id += 1
+        self._running: bool = False
+
+        spec = json.dumps({'location': self._gdb_location, 'exprs': exprs if exprs is not None else [],
+                           'buffer_size': buffer_size})
+        self._dott_target.cli_exec(f'dott-bp-trace {self._id} {binascii.hexlify(spec.encode()).decode()}')
+        self._running = True
+        self._dott_target.bp_manager.reserve()
+
+        InterceptPoint._register(self)
+
+    def _drain(self, clear: bool) -> Dict:
+        status, payload = self._dott_target.gdb_client.gdb_mi.write_dott_cmd('dott-bp-trace-drain',
+                                                                            f'{self._id} {1 if clear else 0}')
+        payload = bytes.fromhex(payload).decode()
+        if status != 'OK':
+            raise DottException(f'Unable to drain trace point {self._location} ({payload}).')
+        trace = json.loads(payload)
+        self._hits = trace['hits']
+        return trace
+
+    def drain(self) -> List[Tuple[int, float, List]]:
+        """
+        Returns (and removes) the hits recorded so far. Each hit is a tuple with the hit number, the (GDB host)
+        timestamp and the list of values of the expressions. If there were more hits than the buffer size, only the
+        most recent ones are returned.
+        """
+        return [(hit, ts, [cast_str(v) for v in vals]) for hit, ts, vals in self._drain(True)['records']]
+
+    def get_hits(self) -> int:
+        return self._drain(False)['hits']
+
+    def wait_complete(self, timeout: float = None) -> None:
+        warnings.warn('You can not wait for the completion of a trace point. Use drain instead.')
+
+    def exec(self, cmd: str) -> None:
+        warnings.warn('A trace point only records the expressions set in the constructor.')
+
+    def eval(self, cmd: str) -> None:
+        warnings.warn('A trace point only records the expressions set in the constructor.')
+
+    def ret(self, ret_val: Union[int, str] = None):
+        warnings.warn('A trace point only records the expressions set in the constructor.')
+
+    def reached(self) -> None:
+        warnings.warn('A trace point only records the expressions set in the constructor.')
+
+    def delete(self) -> None:
+        try:
+            if self._running:
                 self._running = False
-                break
-            except Exception as ex:
-                if self._running:
-                    log.warn(f'Breakpoint {self._location}: exception: {str(ex)}')
-                    self._running = False
-                else:
-                    # Got a socket error while no longer supposed to be running (i.e., during delete).
-                    # We don't need to do anything about this.
-                    pass
-                break
+                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}', timeout=1)
+                InterceptPoint._release(self)
+        except:
+            pass
+
+    def __del__(self):
+        self.delete()
+
+
+# -------------------------------------------------------------------------------------------------
+class AssertPoint(Breakpoint):
+    """
+    Assertion which GDB evaluates on every hit of the given location without waking up DOTT. Passing hits only cost
+    the time GDB needs to evaluate the expression (no host round trip). On a failing hit (expression is false or can
+    not be evaluated), the frame is captured on GDB side (location, registers, arguments and locals, backtrace) and
+    the target is halted (unless halt is False in which case the failure is only recorded). Example:
+
+    ap = AssertPoint('TIM2_IRQHandler', 'htim2.State != HAL_TIM_STATE_ERROR')
+    dt.cont()
+    ...
+    ap.check()  # raises an AssertionError describing the first failure (if any)
+    """
+    _next_id: int = 1
+
+    def __init__(self, location: str, expr: str, halt: bool = True, max_records: int = 64, target: 'Target' = None):
+        """
+        Args:
+            location: Location of the assertion (e.g., a function name).
+            expr: Expression (in the target's language) which has to be true on each hit.
+            halt: Halt the target on the first failing hit (default). Otherwise, failures are recorded only.
+            max_records: Maximum number of failures (the first ones) for which the captured frame is kept.
+        """
+        super().__init__(location, target)
+        self._expr: str = expr
+        self._halt: bool = halt
+        self._id: int = AssertPoint._next_id
+        AssertPoint._next_id += 1
+        self._running: bool = False
+        self._q: queue.Queue = queue.Queue()
+        self._failures: List[Dict] = []
+
+        spec = json.dumps({'location': self._gdb_location, 'expr': expr, 'halt': halt, 'max_records': max_records})
+        self._dott_target.cli_exec(f'dott-bp-assert {self._id} {binascii.hexlify(spec.encode()).decode()}')
+        self._running = True
+        self._dott_target.bp_manager.reserve()
+        InterceptPoint._register(self)
+
+        # the stop notification of a failing hit (if halt is set) is dispatched by the breakpoint handler
+        self._num = self._drain(False)['number']
+        self._dott_target.bp_handler.add_bp(self)
+
+    def _drain(self, clear: bool) -> Dict:
+        status, payload = self._dott_target.gdb_client.gdb_mi.write_dott_cmd('dott-bp-assert-drain',
+                                                                            f'{self._id} {1 if clear else 0}')
+        payload = bytes.fromhex(payload).decode()
+        if status != 'OK':
+            raise DottException(f'Unable to drain assert point {self._location} ({payload}).')
+        res = json.loads(payload)
+        self._hits = res['hits']
+        self._failures += res['records']
+        return res
+
+    @staticmethod
+    def _describe(failure: Dict) -> str:
+        frame = failure['frame']
+        if frame is None:
+            where = 'unknown location'
+        else:
+            where = f'{frame["func"]} at 0x{frame["pc"]:x}'
+            if frame['file'] is not None:
+                where += f' ({frame["file"]}:{frame["line"]})'
+        msg = f'hit {failure["hit"]} in {where}'
+        if failure['error'] is not None:
+            msg += f': evaluation failed ({failure["error"]})'
+        if frame is not None and len(frame['locals']) > 0:
+            msg += ', ' + ', '.join(f'{name}={val}' for name, val in frame['locals'].items())
+        return msg
+
+    def failures(self) -> List[Dict]:
+        """
+        Returns the failures recorded so far. Each failure is a dictionary with the hit number, the (GDB host)
+        timestamp, an evaluation error (or None) and the captured frame (pc, func, file, line, regs, locals and
+        backtrace).
+        """
+        if self._running:
+            self._drain(True)
+        return list(self._failures)
+
+    def get_failure_count(self) -> int:
+        """
+        Returns the number of failing hits (including failures whose frame was not kept, see max_records).
+        """
+        return self._drain(False)['failures']
+
+    def check(self) -> None:
+        """
+        Raises an AssertionError if the assertion failed on at least one hit.
+        """
+        failures = self.failures()
+        if len(failures) > 0:
+            raise AssertionError(f'Assertion "{self._expr}" at {self._location} failed {self.get_failure_count()} '
+                                 f'time(s); first failure: {AssertPoint._describe(failures[0])}')
 
+    def wait_complete(self, timeout: float = None) -> None:
+        """
+        Waits until a failing hit halted the target (halt has to be set).
+        """
+        def get(secs: float) -> bool:
             try:
-                self._dott_target.gdb_client.gdb_mi.context.acquire_context(self, GdbMiContext.BP_INTERCEPT)
-                self.reached()
-            except Exception as ex:
-                log.exception(ex)
-                log.warn('Breakpoint execution failed. Letting target continue anyway. '
-                         'Remaining breakpoint commands in "reached" are discarded')
-            finally:
-                self._dott_target.gdb_client.gdb_mi.context.release_context(self)
+                return self._q.get(block=True, timeout=secs) is None
+            except queue.Empty:
+                return False
+
+        if not self._wait_or_lost(get, timeout):
+            raise TimeoutError(f'Timeout while waiting for a failure of assert point at {self._location}.') from None
+
+    def _fault_wakeup(self) -> None:
+        self._q.put(HaltPoint._FAULT_WAKEUP, block=False)
+
+    def reached_internal(self, payload=None) -> None:
+        # called by the breakpoint handler if a failing hit halted the target
+        log.error(f'Assertion "{self._expr}" at {self._location} failed (target halted).')
+        self._q.put(None, block=False)
+        self._notify_complete_listeners()
+
+    def get_hits(self) -> int:
+        return self._drain(False)['hits']
+
+    def exec(self, cmd: str) -> None:
+        warnings.warn('An assert point only evaluates the expression set in the constructor.')
+
+    def eval(self, cmd: str) -> None:
+        warnings.warn('An assert point only evaluates the expression set in the constructor.')
 
-            msg = BpMsg(BpMsg.MSG_TYPE_FINISH_CONT)
-            msg.send_to_socket(self._sock)
+    def ret(self, ret_val: Union[int, str] = None):
+        warnings.warn('An assert point only evaluates the expression set in the constructor.')
+
+    def reached(self) -> None:
+        warnings.warn('An assert point only evaluates the expression set in the constructor.')
+
+    def delete(self) -> None:
+        try:
+            if self._running:
+                self._drain(True)  # keep the failures recorded so far (see failures)
+                self._running = False
+                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}', timeout=1)
+                InterceptPoint._release(self)
+        except:
+            pass
+
+    def __del__(self):
+        self.delete()
+
+
+# -------------------------------------------------------------------------------------------------
+class HostCallPoint(Breakpoint):
+    """
+    Services host calls of the firmware (DOTT_host_call in testhelpers.c) entirely in GDB's context: a no-stop
+    breakpoint on DOTT_host_call_bp reads the request from the mailbox, services it and resumes the target without
+    waking up DOTT. Supported services (DOTT_HOST_CALL_xxx): log (text is buffered and fetched using drain), file write
+    (data is appended to write_file on GDB's host), random data (reproducible if a seed is given) and stimulus (data
+    queued using stimulus). Example:
+
+    hc = HostCallPoint(write_file='capture.bin', seed=1)
+    hc.stimulus(b'\x01\x02\x03')
+    ...
+    for line in hc.drain():
+        log.info(line)
+    """
+    _next_id: int = 1
+
+    def __init__(self, write_file: str = None, seed: int = None, log_size: int = 4096, target: 'Target' = None):
+        super().__init__('DOTT_host_call_bp', target)
+        if not self._dott_target.symbols.exists('DOTT_host_call_mailbox'):
+            raise DottException('DOTT_host_call (testhelpers.c) is not part of the target binary.')
+        self._id: int = HostCallPoint._next_id
+        HostCallPoint._next_id += 1
+        self._running: bool = False
+
+        if write_file is not None:
+            write_file = self._dott_target.gdb_client.file_path(write_file)
+        spec = json.dumps({'location': self._gdb_location,
+                           'mailbox': self._dott_target.symbols.addr('DOTT_host_call_mailbox'),
+                           'byte_order': self._dott_target.byte_order, 'write_file': write_file, 'seed': seed,
+                           'log_size': log_size})
+        self._dott_target.cli_exec(f'dott-host-call {self._id} {binascii.hexlify(spec.encode()).decode()}')
+        self._running = True
+        self._dott_target.bp_manager.reserve()
+
+        InterceptPoint._register(self)
+
+    def stimulus(self, data: bytes) -> None:
+        """
+        Queues stimulus data which is returned to the firmware by DOTT_HOST_CALL_STIMULUS requests (in order). The
+        target has to be halted.
+        """
+        if len(data) > 0:
+            self._dott_target.cli_exec(f'dott-host-call-stim {self._id} {bytes(data).hex()}')
+
+    def _drain(self, clear: bool) -> Dict:
+        status, payload = self._dott_target.gdb_client.gdb_mi.write_dott_cmd('dott-host-call-drain',
+                                                                            f'{self._id} {1 if clear else 0}')
+        payload = bytes.fromhex(payload).decode()
+        if status != 'OK':
+            raise DottException(f'Unable to drain host calls ({payload}).')
+        res = json.loads(payload)
+        self._hits = res['calls']
+        for err in res['errors']:
+            log.warn(f'Host call failed: {err}')
+        return res
+
+    def drain(self) -> List[str]:
+        """
+        Returns (and removes) the lines logged by the firmware (DOTT_HOST_CALL_LOG) so far. If there were more lines
+        than the log size, only the most recent ones are returned.
+        """
+        return self._drain(True)['log']
+
+    def get_hits(self) -> int:
+        """
+        Returns the number of host calls serviced so far.
+        """
+        return self._drain(False)['calls']
+
+    def get_unhandled(self) -> int:
+        """
+        Returns the number of host calls with an unknown service (or a file write without write_file).
+        """
+        return self._drain(False)['unhandled']
+
+    def wait_complete(self, timeout: float = None) -> None:
+        warnings.warn('You can not wait for the completion of a host call point. Use drain instead.')
 
-            # notify threads which are potentially waiting for completion of this breakpoint
-            self._signal_complete()
+    def exec(self, cmd: str) -> None:
+        warnings.warn('A host call point only services host calls.')
+
+    def eval(self, cmd: str) -> None:
+        warnings.warn('A host call point only services host calls.')
+
+    def ret(self, ret_val: Union[int, str] = None):
+        warnings.warn('A host call point only services host calls.')
+
+    def reached(self) -> None:
+        warnings.warn('A host call point only services host calls.')
+
+    def delete(self) -> None:
+        try:
+            if self._running:
+                self._running = False
+                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}', timeout=1)
+                InterceptPoint._release(self)
+        except:
+            pass
+
+    def __del__(self):
+        self.delete()
+
+
+# -------------------------------------------------------------------------------------------------
+class FunctionTimerReport(object):
+    """
+    Result of a FunctionTimer: per function the number of (completed) calls and the inclusive and exclusive time (in
+    cycles of the timer's clock and, if cpu_hz is given, in seconds) and the call graph edges (caller, callee, calls).
+    Calls from functions which are not timed are attributed to the caller <root>.
+    """
+    def __init__(self, res: Dict, cpu_hz: float = None) -> None:
+        self.cpu_hz: float = cpu_hz
+        self.hits: int = res['hits']
+        self.unmatched: int = res['unmatched']  # exits without entry and entries without exit (e.g., tail calls)
+        self.depth: int = res['depth']  # functions entered but not yet returned from
+        self.functions: Dict[str, Dict] = {}
+        for func, (calls, incl, excl, incl_max) in res['stats'].items():
+            self.functions[func] = {'calls': calls, 'incl': incl, 'excl': excl, 'incl_max': incl_max,
+                                    'incl_avg': incl / calls if calls > 0 else 0}
+        self.edges: List[Tuple[str, str, int]] = sorted((c, f, n) for c, f, n in res['edges'])
+
+    def seconds(self, cycles: float) -> float:
+        return cycles / self.cpu_hz if self.cpu_hz is not None else None
+
+    def __str__(self) -> str:
+        unit = 'us' if self.cpu_hz is not None else 'cycles'
+
+        def fmt(cycles: float) -> str:
+            return f'{cycles * 1e6 / self.cpu_hz:.1f}' if self.cpu_hz is not None else f'{cycles:.0f}'
+
+        lines = [f'Function timing ({self.hits} hits, {self.unmatched} unmatched, times in {unit})',
+                 f'  {"function":<32}{"calls":>8}{"incl":>14}{"excl":>14}{"avg":>12}{"max":>12}']
+        for func, s in sorted(self.functions.items(), key=lambda i: -i[1]['incl']):
+            lines.append(f'  {func:<32}{s["calls"]:>8}{fmt(s["incl"]):>14}{fmt(s["excl"]):>14}'
+                         f'{fmt(s["incl_avg"]):>12}{fmt(s["incl_max"]):>12}')
+        return '\n'.join(lines)
+
+    def dot(self) -> str:
+        """
+        Returns the call graph in Graphviz dot format (nodes annotated with the inclusive time of the functions).
+        """
+        lines = ['digraph calls {']
+        for func, s in self.functions.items():
+            lines.append(f'  "{func}" [label="{func}\\n{s["calls"]} calls, {s["incl"]:.0f} cycles"];')
+        for caller, callee, calls in self.edges:
+            lines.append(f'  "{caller}" -> "{callee}" [label="{calls}"];')
+        lines.append('}')
+        return '\n'.join(lines)
+
+
+class FunctionTimer(Breakpoint):
+    """
+    Timing of functions using no-stop breakpoints on their entries and return instructions. On each hit, GDB reads
+    the DWT cycle counter (or SysTick) and keeps a shadow call stack from which the inclusive and exclusive time per
+    function and the call graph are accumulated on GDB side, i.e., there is no round trip to DOTT per hit. The cycle
+    counters do not advance while the core is halted, hence the time GDB needs to process a hit is not included.
+    Example:
+
+    ft = FunctionTimer(['app_process', 'crc_calc', 'uart_send'])
+    dt.cont()
+    ...
+    dt.halt()
+    print(ft.report(cpu_hz=64e6))
+
+    The return instructions are found by scanning the (Thumb) code of the functions in the ELF file. Each function
+    needs one breakpoint comparator for its entry plus one per return instruction. Functions left by a tail call or
+    longjmp show up as unmatched.
+    """
+    _check_location: bool = False
+    _next_id: int = 1
+
+    # DWT cycle counter enable (see SwoCapture)
+    _DEMCR = 0xe000edfc
+    _DEMCR_TRCENA = 0x01000000
+    _DWT_CTRL = 0xe0001000
+    _DWT_CTRL_CYCCNTENA = 0x00000001
+
+    def __init__(self, funcs: List[str], clock: str = 'dwt', target: 'Target' = None):
+        """
+        Args:
+            funcs: Names of the functions to be timed.
+            clock: Clock used for the timestamps: 'dwt' (DWT CYCCNT, enabled by the constructor; not available on
+                   Cortex-M0/M0+) or 'systick' (SysTick current value; the SysTick has to be running).
+        """
+        if clock not in ('dwt', 'systick'):
+            raise DottException(f'Unsupported function timer clock {clock}.')
+        self._id: int = FunctionTimer._next_id
+        FunctionTimer._next_id += 1
+        super().__init__(f'dott-ftimer-{self._id}', target)
+        self._running: bool = False
+
+        spec_funcs = []
+        for func in funcs:
+            if not self._dott_target.symbols.exists(func):
+                raise DottException(f'No symbol "{func}" found in target binary symbols.')
+            entry = self._dott_target.symbols.addr(func)
+            exits = FunctionTimer.find_returns(self._dott_target.symbols.content(func), entry)
+            if len(exits) == 0:
+                log.warn(f'No return instruction found in {func}; its time is not accounted.')
+            spec_funcs.append([func, entry, exits])
+        self._num_comparators: int = sum(1 + len(exits) for _, _, exits in spec_funcs)
+
+        if clock == 'dwt':
+            self._enable_cyccnt()
+        spec = json.dumps({'funcs': spec_funcs, 'clock': clock, 'byte_order': self._dott_target.byte_order})
+        self._dott_target.cli_exec(f'dott-ftimer {self._id} {binascii.hexlify(spec.encode()).decode()}')
+        self._running = True
+        for _ in range(self._num_comparators):
+            self._dott_target.bp_manager.reserve()
+
+        InterceptPoint._register(self)
+
+    @staticmethod
+    def find_returns(code: bytes, addr: int) -> List[int]:
+        """
+        Returns the addresses of the return instructions (bx lr, pop {..., pc}, ldm sp!, {..., pc} and
+        ldr pc, [sp], #4) in the given Thumb code starting at addr. Literal pools are scanned as if they were code;
+        a false match only costs a breakpoint which is never hit.
+        """
+        exits = []
+        if code is None:
+            return exits
+        pos = 0
+        while pos + 2 <= len(code):
+            hw = struct.unpack_from('<H', code, pos)[0]
+            if hw >> 11 in (0x1d, 0x1e, 0x1f):  # 32bit instruction
+                if pos + 4 > len(code):
+                    break
+                hw2 = struct.unpack_from('<H', code, pos + 2)[0]
+                if (hw == 0xe8bd and hw2 & 0x8000) or (hw == 0xf85d and hw2 == 0xfb04):
+                    exits.append(addr + pos)
+                pos += 4
+                continue
+            if hw == 0x4770 or hw & 0xff00 == 0xbd00:
+                exits.append(addr + pos)
+            pos += 2
+        return exits
+
+    def _enable_cyccnt(self) -> None:
+        fmt = '<I' if self._dott_target.byte_order == 'little' else '>I'
+        for reg, bit in ((FunctionTimer._DEMCR, FunctionTimer._DEMCR_TRCENA),
+                         (FunctionTimer._DWT_CTRL, FunctionTimer._DWT_CTRL_CYCCNTENA)):
+            val = struct.unpack(fmt, self._dott_target.mem.read(reg, 4))[0]
+            if val & bit == 0:
+                self._dott_target.mem.write(reg, struct.pack(fmt, val | bit))
+
+    def _drain(self, clear: bool) -> Dict:
+        status, payload = self._dott_target.gdb_client.gdb_mi.write_dott_cmd('dott-ftimer-drain',
+                                                                            f'{self._id} {1 if clear else 0}')
+        payload = bytes.fromhex(payload).decode()
+        if status != 'OK':
+            raise DottException(f'Unable to drain function timer ({payload}).')
+        res = json.loads(payload)
+        self._hits = res['hits']
+        for err in res['errors']:
+            log.warn(f'Function timer hit failed: {err}')
+        return res
+
+    def report(self, cpu_hz: float = None, clear: bool = False) -> FunctionTimerReport:
+        """
+        Returns the timing of the functions and the call graph accumulated so far.
+
+        Args:
+            cpu_hz: Frequency of the timer's clock (core clock) used to convert cycles into seconds.
+            clear: Clears the accumulated statistics (functions currently on the call stack stay on it).
+        """
+        return FunctionTimerReport(self._drain(clear), cpu_hz)
+
+    def get_hits(self) -> int:
+        return self._drain(False)['hits']
+
+    def wait_complete(self, timeout: float = None) -> None:
+        warnings.warn('You can not wait for the completion of a function timer. Use report instead.')
+
+    def exec(self, cmd: str) -> None:
+        warnings.warn('A function timer only records the function timing.')
+
+    def eval(self, cmd: str) -> None:
+        warnings.warn('A function timer only records the function timing.')
+
+    def ret(self, ret_val: Union[int, str] = None):
+        warnings.warn('A function timer only records the function timing.')
+
+    def reached(self) -> None:
+        warnings.warn('A function timer only records the function timing.')
 
     def delete(self) -> None:
         try:
             if self._running:
                 self._running = False
-                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._location}', timeout=1)
-                self._sock.close()
-                self.join(timeout=1)
-                InterceptPoint._unregister(self)
+                self._dott_target.cli_exec(f'dott-bp-nostop-delete {self._gdb_location}', timeout=1)
+                InterceptPoint._release(self)
         except:
             pass
 
@@ -18,32 +18,179 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import os
 import queue
+import shutil
+import socket
+import tempfile
 import threading
-from typing import Dict
+import time
+from typing import Dict, List, Set, Tuple
 
 from dottmi.breakpoint import Breakpoint
 from dottmi.gdb_mi import NotifySubscriber
+from dottmi.timeline import timeline
+from dottmi.gdb_replay import RecordingSocket
+from dottmi.gdb_shared import BpMsg, BpSharedConf, ShmChannel
 from dottmi.utils import log
 
 
+# -------------------------------------------------------------------------------------------------
+class BreakpointRegistry(NotifySubscriber):
+    """
+    Host-side table of the breakpoints (and watchpoints) known to GDB with GDB's breakpoint info and the DOTT
+    breakpoint (if any) owning each of them. The table is kept up-to-date with the =breakpoint-created, -modified and
+    -deleted notifications (breakpoints set via CLI or GDB's Python API, hit counts, temporary breakpoints deleted by
+    GDB) and with the results of DOTT's own -break-* commands (GDB does not send notifications for changes made by MI
+    commands; see applied). Hence, counting breakpoints and looking them up by number or location are host-local
+    operations which do not need a -break-list exchange.
+    """
+    _NOTIFICATIONS = ('breakpoint-created', 'breakpoint-modified', 'breakpoint-deleted')
+    _WATCH_KEYS = ('wpt', 'hw-rwpt', 'hw-awpt')
+
+    def __init__(self) -> None:
+        NotifySubscriber.__init__(self)
+        self._lock: threading.Lock = threading.Lock()
+        self._bps: Dict[int, Dict] = {}  # bp number -> GDB's breakpoint info
+        self._owners: Dict[int, Breakpoint] = {}  # bp number -> DOTT breakpoint
+
+    def notify(self, msg: Dict) -> None:
+        # note: called in the context of the MI response handler (before the result of a subsequent command is
+        # delivered); only the table is updated, i.e., no queueing and no dispatch thread
+        payload = msg.get('payload')
+        if not isinstance(payload, dict):
+            return
+        if msg['message'] == 'breakpoint-deleted':
+            self.remove(int(payload['id']))
+        elif isinstance(payload.get('bkpt'), dict):
+            self.update(payload['bkpt'])
+
+    def update(self, bp_info: Dict) -> None:
+        if '.' in str(bp_info.get('number', '.')):
+            return  # note: locations of multi-location breakpoints are not tracked separately
+        with self._lock:
+            num = int(bp_info['number'])
+            self._bps[num] = {**self._bps.get(num, {}), **bp_info}
+
+    def remove(self, num: int) -> None:
+        with self._lock:
+            self._bps.pop(num, None)
+
+    def set_enabled(self, nums: List[int], enabled: bool) -> None:
+        with self._lock:
+            for num in nums:
+                if num in self._bps:
+                    self._bps[num]['enabled'] = 'y' if enabled else 'n'
+
+    def applied(self, cmd: str, msg: Dict = None) -> None:
+        """
+        Updates the table with the effect of a successfully executed -break-* command (and its result message).
+        """
+        verb, _, args = cmd.partition(' ')
+        if verb in ('-break-insert', '-break-watch'):
+            payload = msg.get('payload', {}) if msg is not None else {}
+            for key in ('bkpt',) + BreakpointRegistry._WATCH_KEYS:
+                if isinstance(payload.get(key), dict):
+                    self.update(payload[key])
+            return
+        nums = [int(arg) for arg in args.split() if arg.isdigit()]
+        if verb == '-break-delete':
+            for num in nums:
+                self.remove(num)
+        elif verb in ('-break-enable', '-break-disable'):
+            self.set_enabled(nums, verb == '-break-enable')
+
+    def clear(self) -> None:
+        # used if the GDB client is replaced (see Target.recover)
+        with self._lock:
+            self._bps.clear()
+            self._owners.clear()
+
+    def attach(self, bp: Breakpoint) -> None:
+        with self._lock:
+            self._owners[bp.num] = bp
+
+    def detach(self, bp: Breakpoint) -> None:
+        with self._lock:
+            if self._owners.get(bp.num) is bp:
+                self._owners.pop(bp.num)
+
+    def owner(self, num: int) -> Breakpoint:
+        """
+        Returns the DOTT breakpoint for the given breakpoint number (None if there is none).
+        """
+        with self._lock:
+            return self._owners.get(num)
+
+    def owners(self) -> List[Breakpoint]:
+        with self._lock:
+            return list(self._owners.values())
+
+    @property
+    def count(self) -> int:
+        with self._lock:
+            return len(self._bps)
+
+    def numbers(self) -> List[int]:
+        with self._lock:
+            return sorted(self._bps)
+
+    def info(self, num: int) -> Dict:
+        """
+        Returns (a copy of) GDB's breakpoint info for the given breakpoint number (None if it is unknown).
+        """
+        with self._lock:
+            bp_info = self._bps.get(num)
+            return dict(bp_info) if bp_info is not None else None
+
+    def find(self, location: str) -> List[Dict]:
+        """
+        Returns the breakpoint infos whose original location, function or expression (watchpoints) is the given
+        location.
+        """
+        with self._lock:
+            return [dict(bp_info) for bp_info in self._bps.values()
+                    if location in (bp_info.get('original-location'), bp_info.get('func'), bp_info.get('exp'),
+                                    bp_info.get('what'))]
+
+    def hits(self, num: int) -> int:
+        """
+        Returns GDB's hit count of the given breakpoint (0 if unknown).
+        """
+        with self._lock:
+            return int(self._bps.get(num, {}).get('times', 0))
+
+
 # -------------------------------------------------------------------------------------------------
 class BreakpointHandler(NotifySubscriber, threading.Thread):
+    # stop reasons of watchpoints and the key of the watchpoint information in the stop notification
+    WATCH_REASONS = {'watchpoint-trigger': 'wpt', 'read-watchpoint-trigger': 'hw-rwpt',
+                     'access-watchpoint-trigger': 'hw-awpt'}
+
     def __init__(self) -> None:
         NotifySubscriber.__init__(self)
         threading.Thread.__init__(self, name='BreakpointHandler')
-        self._breakpoints: Dict = {}
+        self._registry: BreakpointRegistry = BreakpointRegistry()
         self._running: bool = False
 
+    @property
+    def registry(self) -> BreakpointRegistry:
+        return self._registry
+
     def add_bp(self, bp: Breakpoint) -> None:
-        self._breakpoints[bp.num] = bp
+        self._registry.attach(bp)
 
     def remove_bp(self, bp: Breakpoint) -> None:
-        self._breakpoints.pop(bp.num)
+        self._registry.detach(bp)
 
     def stop(self) -> None:
         self._running = False
 
+    def fault_wakeup(self) -> None:
+        # wakes up threads waiting for a breakpoint if the target halted in DOTT's fault hook (see Target.check_fault)
+        for bp in self._registry.owners():
+            bp._fault_wakeup()
+
     def run(self) -> None:
         self._running = True
         while self._running:
@@ -54,11 +201,454 @@ class BreakpointHandler(NotifySubscriber, threading.Thread):
 
             if 'reason' in msg['payload']:
                 payload = msg['payload']
+                bp_num = None
                 if payload['reason'] == 'breakpoint-hit':
                     bp_num = int(payload['bkptno'])
-                    if bp_num in self._breakpoints:
-                        self._breakpoints[bp_num].reached_internal(payload)
+                elif payload['reason'] in BreakpointHandler.WATCH_REASONS:
+                    bp_num = int(payload[BreakpointHandler.WATCH_REASONS[payload['reason']]]['number'])
+
+                if bp_num is not None:
+                    bp = self._registry.owner(bp_num)
+                    if bp is not None:
+                        bp._hit_time = time.perf_counter()
+                        bp._dott_target.bp_manager.hit(bp_num)
+                        timeline.instant(f'hit {bp.get_location()}', 'breakpoint',
+                                         {'number': bp_num, 'reason': payload['reason']})
+                        bp.reached_internal(payload)
                     else:
                         log.warn(f'Breakpoint with number {bp_num} not found in list of known breakpoints.')
                 else:
                     log.error(f'stop notification received with wrong reason: {payload["reason"]}')
+
+
+# -------------------------------------------------------------------------------------------------
+class InterceptPointChannel(threading.Thread):
+    """
+    Channel between DOTT and the GDB process which is shared by all intercept points of a target. The channel
+    consists of a single socket connection (see __init__) and a single dispatcher thread which handles the
+    breakpoint hit messages of all intercept points. Since GDB processes intercept points one at a time (GDB is halted
+    in the breakpoint's stop method until DOTT finishes the breakpoint), messages on the channel never interleave.
+    """
+    CONNECT_TIMEOUT_SEC = 5
+
+    def __init__(self, target: 'Target', shm: bool = False) -> None:
+        super().__init__(name='InterceptPointChannel', daemon=True)
+        self._intercept_points: Dict[int, 'InterceptPoint'] = {}
+        self._next_id: int = 1
+        self._lock: threading.Lock = threading.Lock()
+        self._running: bool = False
+
+        # On POSIX hosts a Unix domain socket in a private directory is used. Otherwise a TCP socket on an OS-assigned
+        # port is used. In both cases each channel (i.e., each GDB instance) gets its own endpoint such that any number
+        # of DOTT sessions can run in parallel on the same host. With shm, the messages are exchanged through shared
+        # memory and the Unix domain socket only serves as doorbell (see ShmChannel).
+        sock_dir: str = None
+        shm_file: str = None
+        if target.gdb_client.agent is not None:
+            # GDB runs on the host of a DOTT agent which relays the channel
+            endpoint, self._sock = target.gdb_client.agent.open_bp_channel()
+            target.cli_exec(f'dott-bp-channel {endpoint}')
+            self._finish_setup(target)
+            return
+        if target.gdb_client.replay is not None:
+            # replayed session (see dottmi.gdb_replay); the GDB side of the channel is served from the session log
+            self._sock = target.gdb_client.replay.ip_socket()
+            target.cli_exec('dott-bp-channel replay')
+            self._finish_setup(target)
+            return
+        if InterceptPointChannel.use_unix_socket():
+            sock_dir = tempfile.mkdtemp(prefix='dott_bp_')
+            sock_path = os.path.join(sock_dir, 'channel')
+            srv_sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            srv_sock.bind(sock_path)
+            endpoint = f'unix:{sock_path}'
+            if shm:
+                # note: a tmpfs (if available) keeps the shared file's pages from being written back to disk
+                shm_dir = tempfile.mkdtemp(prefix='dott_bp_', dir='/dev/shm' if os.path.isdir('/dev/shm') else None)
+                shm_file = os.path.join(shm_dir, 'ring')
+                ShmChannel.create_file(shm_file)
+                endpoint = f'shm:{sock_path} {shm_file}'
+        else:
+            srv_sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            srv_sock.bind((BpSharedConf.GDB_CMD_SERVER_ADDR, 0))
+            endpoint = str(srv_sock.getsockname()[1])
+        srv_sock.listen(1)
+        srv_sock.settimeout(InterceptPointChannel.CONNECT_TIMEOUT_SEC)
+        try:
+            target.cli_exec(f'dott-bp-channel {endpoint}')
+            self._sock, _ = srv_sock.accept()
+            if shm_file is not None:
+                # note: GDB maps the file before it connects; the mappings stay valid once the file is removed
+                self._sock = ShmChannel(shm_file, self._sock, ShmChannel.RING_DOTT)
+        finally:
+            srv_sock.close()
+            if sock_dir is not None:
+                shutil.rmtree(sock_dir, ignore_errors=True)
+            if shm_file is not None:
+                shutil.rmtree(os.path.dirname(shm_file), ignore_errors=True)
+        self._finish_setup(target)
+
+    def _finish_setup(self, target: 'Target') -> None:
+        self._sock.settimeout(None)
+        if self._sock.family == socket.AF_INET:
+            self._sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        recorder = target.gdb_client.gdb_mi.recorder
+        if recorder is not None:
+            self._sock = RecordingSocket(self._sock, recorder)
+        self.start()
+
+    @staticmethod
+    def use_unix_socket() -> bool:
+        return os.name == 'posix' and hasattr(socket, 'AF_UNIX')
+
+    def add_ip(self, ipoint: 'InterceptPoint') -> int:
+        with self._lock:
+            bp_id = self._next_id
+            self._next_id = (self._next_id % 0xffff) + 1
+            self._intercept_points[bp_id] = ipoint
+        return bp_id
+
+    def remove_ip(self, bp_id: int) -> None:
+        with self._lock:
+            self._intercept_points.pop(bp_id, None)
+
+    def request(self, msg: BpMsg) -> BpMsg:
+        """
+        Sends a message (exec, eval) to GDB and returns the response. Only to be called while an intercept point is
+        being processed (i.e., from within its reached method).
+        """
+        msg.send_to_socket(self._sock)
+        return BpMsg.read_from_socket(self._sock)
+
+    def send(self, msg: BpMsg) -> None:
+        msg.send_to_socket(self._sock)
+
+    def close(self) -> None:
+        self._running = False
+        try:
+            self._sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self._sock.close()
+
+    def run(self) -> None:
+        self._running = True
+        while self._running:
+            # wait for 'breakpoint hit' message
+            try:
+                msg = BpMsg.read_from_socket(self._sock)
+            except Exception as ex:
+                if self._running:
+                    log.warn(f'Intercept point channel: {str(ex)}')
+                break
+
+            if msg.get_type() not in (BpMsg.MSG_TYPE_HIT, BpMsg.MSG_TYPE_RECORD, BpMsg.MSG_TYPE_SNAPSHOT):
+                log.warn(f'Received breakpoint message of type {msg.get_type()} while waiting for type "HIT"')
+                continue
+
+            with self._lock:
+                ipoint = self._intercept_points.get(msg.get_bp_id())
+
+            # records of action-based intercept points and snapshot points are sent asynchronously (GDB does not wait
+            # for a response)
+            if msg.get_type() in (BpMsg.MSG_TYPE_RECORD, BpMsg.MSG_TYPE_SNAPSHOT):
+                if ipoint is not None:
+                    ipoint.record_internal(msg.get_payload())
+                continue
+
+            if ipoint is None:
+                log.warn(f'Intercept point with id {msg.get_bp_id()} not found. Letting target continue.')
+                self.send(BpMsg(BpMsg.MSG_TYPE_FINISH_CONT, bp_id=msg.get_bp_id()))
+                continue
+            ipoint._hit_time = time.perf_counter()
+            with timeline.span(f'intercept {ipoint.get_location()}', 'breakpoint'):
+                ipoint.reached_internal()
+        self._running = False
+
+
+# -------------------------------------------------------------------------------------------------
+class BreakpointManager(object):
+    """
+    Keeps track of the hardware breakpoint comparators used by the halt points of a target. Halt points which are
+    deleted are not removed from GDB but are disabled ('parked') instead. If a halt point is created again for the
+    same location (e.g., main or DOTT_test_hook_chained in every test), the parked breakpoint is re-enabled instead of
+    being re-created. Disabled breakpoints are not inserted into the target and hence do not use a comparator.
+    If more breakpoints are used than hardware comparators are available, J-Link's flash breakpoints are enabled
+    (with a warning) such that the GDB server can fall back to flash/software breakpoints. From then on, the hits of
+    each location (counted over the whole session) decide the placement of new halt points: the most frequently hit
+    locations are pinned to hardware comparators (GDB hardware breakpoints) as long as comparators are left; all
+    other ones become flash breakpoints. Each arming and disarming of a flash breakpoint requires a reprogramming of the
+    flash sector when the target resumes. The reprogrammings and the time they take (measured for Target.cont) are
+    accounted per location (see flash_report).
+    """
+    _KIND_HW = 'hw'
+    _KIND_FLASH = 'flash'
+
+    def __init__(self, target: 'Target', num_hw_bps: int) -> None:
+        self._target: 'Target' = target
+        self._num_hw_bps: int = num_hw_bps
+        self._active: Dict[int, Tuple[str, Dict]] = {}  # bp number -> (location, bkpt info) of enabled halt points
+        self._parked: Dict[str, Dict] = {}  # location -> bkpt info of disabled breakpoints available for reuse
+        self._num_nostop: int = 0  # breakpoints implemented in GDB's Python context (intercept points etc.)
+        self._fallback_enabled: bool = False
+        self._kinds: Dict[int, str] = {}  # bp number -> placement (_KIND_HW or _KIND_FLASH) of enabled halt points
+        self._hits: Dict[str, int] = {}  # location -> number of hits (whole session)
+        self._flash_stats: Dict[str, List] = {}  # location -> [number of reprogrammings, reprogramming seconds]
+        self._flash_changed: Set[str] = set()  # flash breakpoints (locations) armed/disarmed since the last resume
+
+    def _exec(self, cmd: str) -> Dict:
+        # executes a -break-* command and applies it to the breakpoint registry
+        msg = self._target.exec(cmd)
+        self._target.bp_registry.applied(cmd, msg)
+        return msg
+
+    @property
+    def num_hw_bps(self) -> int:
+        return self._num_hw_bps
+
+    @property
+    def num_used(self) -> int:
+        """
+        Number of breakpoints which currently are enabled (i.e., which are inserted when the target resumes).
+        """
+        return len(self._active) + self._num_nostop
+
+    @property
+    def num_parked(self) -> int:
+        return len(self._parked)
+
+    @property
+    def num_flash(self) -> int:
+        """
+        Number of enabled halt points which are placed in flash (i.e., for which no hardware comparator is left).
+        """
+        return sum(1 for kind in self._kinds.values() if kind == BreakpointManager._KIND_FLASH)
+
+    def _thread_arg(self) -> str:
+        # breakpoints of multi-core targets only halt at hits of their own core (see Target.add_core)
+        thread_ids = self._target.thread_ids
+        return f'-p {thread_ids[0]} ' if thread_ids else ''
+
+    def _is_hot(self, location: str) -> bool:
+        # True if the location is among the most frequently hit locations (one per hardware comparator)
+        hits = self._hits.get(location, 0)
+        num = self._num_hw_bps - self._num_nostop
+        if hits == 0 or num <= 0:
+            return False
+        ranked = sorted(self._hits.values(), reverse=True)
+        return hits >= ranked[min(num, len(ranked)) - 1]
+
+    def _placement(self, location: str, num_hw: int, num_used: int) -> Tuple[str, bool]:
+        # returns the placement of a new halt point and whether it is pinned to a comparator (GDB hardware breakpoint)
+        # given the number of enabled halt points on comparators and the number of used breakpoints
+        if num_used + 1 <= self._num_hw_bps and not self._fallback_enabled:
+            return BreakpointManager._KIND_HW, False
+        self._fallback_enable(num_used + 1)
+        if num_hw + self._num_nostop < self._num_hw_bps:
+            # note: the GDB server places (software) breakpoints which are not pinned in flash if it runs out of
+            # comparators; pinning ensures that hot locations keep a comparator
+            return BreakpointManager._KIND_HW, self._is_hot(location)
+        return BreakpointManager._KIND_FLASH, False
+
+    def _num_hw(self) -> int:
+        return sum(1 for kind in self._kinds.values() if kind == BreakpointManager._KIND_HW)
+
+    def _activate(self, location: str, bp_info: Dict, kind: str) -> None:
+        num = int(bp_info['number'])
+        self._active[num] = (location, bp_info)
+        if bp_info.get('type') == 'hw breakpoint':
+            kind = BreakpointManager._KIND_HW
+        self._kinds[num] = kind
+        if kind == BreakpointManager._KIND_FLASH:
+            self._flash_changed.add(location)
+            self._flash_stats.setdefault(location, [0, 0.0])
+
+    def _deactivate(self, num: int) -> Tuple[str, Dict]:
+        location, bp_info = self._active.pop(num, (None, None))
+        if self._kinds.pop(num, None) == BreakpointManager._KIND_FLASH:
+            self._flash_changed.add(location)
+        return location, bp_info
+
+    def _reusable(self, location: str, pin: bool) -> Dict:
+        # returns the parked breakpoint for the location if it can be re-enabled (a location to be pinned to a
+        # hardware comparator needs a hardware breakpoint; the parked one is deleted otherwise)
+        bp_info = self._parked.get(location)
+        if bp_info is None:
+            return None
+        if pin and bp_info.get('type') != 'hw breakpoint':
+            self._exec(f'-break-delete {self._parked.pop(location)["number"]}')
+            return None
+        return self._parked.pop(location)
+
+    def insert(self, location: str, args: str = '', reusable: bool = True) -> Dict:
+        """
+        Inserts a halt point (or re-enables a parked one for the same location) and returns GDB's breakpoint info.
+        """
+        kind, pin = self._placement(location, self._num_hw(), self.num_used)
+        bp_info = self._reusable(location, pin) if reusable else None
+        if bp_info is not None:
+            self._exec(f'-break-enable {bp_info["number"]}')
+        else:
+            msg = self._exec(f'-break-insert {self._thread_arg()}{"-h " if pin else ""}{args} {location}')
+            bp_info = msg.get('payload', {}).get('bkpt') if msg is not None else None
+            if bp_info is None:
+                raise Exception('Invalid breakpoint information.')
+        self._activate(location, bp_info, kind)
+        return bp_info
+
+    def insert_many(self, locations: List[str]) -> List[Dict]:
+        """
+        Inserts (reusable) halt points for all given locations in one pipelined MI exchange and returns GDB's
+        breakpoint info for each location (in the given order).
+        """
+        bp_infos: List[Dict] = [None] * len(locations)
+        kinds: List[str] = [None] * len(locations)
+        inserts: Dict[int, str] = {}  # location index -> insert command
+        enable: List[str] = []
+        num_hw, num_used = self._num_hw(), self.num_used
+        # note: the most frequently hit locations are placed first (i.e., get the comparators which are left)
+        for i in sorted(range(len(locations)), key=lambda idx: self._hits.get(locations[idx], 0), reverse=True):
+            location = locations[i]
+            kinds[i], pin = self._placement(location, num_hw, num_used)
+            num_hw += 1 if kinds[i] == BreakpointManager._KIND_HW else 0
+            num_used += 1
+            bp_infos[i] = self._reusable(location, pin)
+            if bp_infos[i] is not None:
+                enable.append(bp_infos[i]['number'])
+            else:
+                inserts[i] = f'-break-insert {self._thread_arg()}{"-h " if pin else ""}{location}'
+        cmds = [inserts[i] for i in sorted(inserts)]
+        if len(enable) > 0:
+            cmds.append(f'-break-enable {" ".join(enable)}')
+
+        msgs = self._target.exec_many(cmds)
+        for cmd, msg in zip(cmds, msgs):
+            self._target.bp_registry.applied(cmd, msg)
+        results = iter(msgs)
+        for i, location in enumerate(locations):
+            if bp_infos[i] is None:
+                msg = next(results)
+                bp_infos[i] = msg.get('payload', {}).get('bkpt') if msg is not None else None
+                if bp_infos[i] is None:
+                    raise Exception('Invalid breakpoint information.')
+            self._activate(location, bp_infos[i], kinds[i])
+        return bp_infos
+
+    def remove(self, num: int, reusable: bool = True) -> None:
+        """
+        Removes a halt point. Reusable breakpoints are parked (disabled); all others are deleted.
+        """
+        location, bp_info = self._deactivate(num)
+        if reusable and location is not None and location not in self._parked:
+            self._exec(f'-break-disable {num}')
+            self._parked[location] = bp_info
+        else:
+            self._exec(f'-break-delete {num}')
+
+    def forget(self, num: int) -> None:
+        # used for breakpoints which are deleted by GDB itself (temporary breakpoints)
+        self._deactivate(num)
+
+    def hit(self, num: int) -> None:
+        # called by the breakpoint handler for each hit of a halt point
+        location = self._active.get(num, (None, None))[0]
+        if location is not None:
+            self._hits[location] = self._hits.get(location, 0) + 1
+
+    def reserve(self) -> None:
+        self._num_nostop += 1
+        self._check_budget()
+
+    def release(self) -> None:
+        self._num_nostop = max(self._num_nostop - 1, 0)
+
+    def clear_cmds(self, bp_nums: List[int]) -> List[str]:
+        """
+        Returns the MI commands which park all reusable breakpoints and delete all other ones (given the numbers of
+        all breakpoints currently known to GDB).
+        """
+        for num, (location, bp_info) in list(self._active.items()):
+            if location not in self._parked:
+                self._parked[location] = bp_info
+            self._deactivate(num)
+        self._num_nostop = 0
+
+        # drop parked breakpoints which no longer exist in GDB (e.g., deleted by the user)
+        self._parked = {loc: bp_info for loc, bp_info in self._parked.items() if int(bp_info['number']) in bp_nums}
+        keep = {int(bp_info['number']) for bp_info in self._parked.values()}
+        to_delete = [str(num) for num in bp_nums if num not in keep]
+        cmds = []
+        if len(keep) > 0:
+            cmds.append(f'-break-disable {" ".join(str(num) for num in sorted(keep))}')
+        if len(to_delete) > 0:
+            cmds.append(f'-break-delete {" ".join(to_delete)}')
+        return cmds
+
+    def reset_fallback(self) -> None:
+        # called if flash breakpoints were disabled (e.g., after loading a new binary)
+        self._fallback_enabled = False
+        self._flash_changed.clear()
+        self._kinds = {num: BreakpointManager._KIND_HW for num in self._kinds}
+        self._check_budget()
+
+    @property
+    def flash_pending(self) -> bool:
+        """
+        True if flash breakpoints were armed or disarmed since the target was resumed the last time (i.e., the GDB
+        server reprograms flash on the next resume).
+        """
+        return len(self._flash_changed) > 0
+
+    def flash_resumed(self, secs: float) -> None:
+        """
+        Accounts the given time the target took to resume (including the flash reprogramming of the GDB server) to
+        the flash breakpoints armed or disarmed since the previous resume.
+        """
+        if len(self._flash_changed) == 0:
+            return
+        for location in self._flash_changed:
+            stats = self._flash_stats.setdefault(location, [0, 0.0])
+            stats[0] += 1
+            stats[1] += secs / len(self._flash_changed)
+        self._flash_changed.clear()
+
+    def flash_stats(self) -> Dict[str, Dict]:
+        """
+        Returns the flash breakpoint cost per location as dictionary with reprogrammings, secs and hits.
+        """
+        return {loc: {'reprogrammings': stats[0], 'secs': stats[1], 'hits': self._hits.get(loc, 0)}
+                for loc, stats in self._flash_stats.items()}
+
+    def flash_report(self) -> str:
+        """
+        Returns a report of the flash breakpoints of the session (None if no flash breakpoints were used).
+        """
+        if len(self._flash_stats) == 0:
+            return None
+        stats = sorted(self.flash_stats().items(), key=lambda i: i[1]['secs'], reverse=True)
+        total = sum(s['secs'] for _, s in stats)
+        lines = [f'Flash breakpoints: {len(stats)} locations, {sum(s["reprogrammings"] for _, s in stats)} '
+                 f'reprogrammings, {total:.2f}s (hardware comparators: {self._num_hw_bps})',
+                 f'  {"location":<40}{"reprog":>8}{"hits":>8}{"total[s]":>10}']
+        for loc, s in stats:
+            lines.append(f'  {loc:<40}{s["reprogrammings"]:>8}{s["hits"]:>8}{s["secs"]:>10.2f}')
+        return '\n'.join(lines)
+
+    def _check_budget(self) -> None:
+        if self.num_used > self._num_hw_bps:
+            self._fallback_enable(self.num_used)
+
+    def _fallback_enable(self, num_used: int) -> None:
+        if self._fallback_enabled:
+            return
+        log.warn(f'{num_used} breakpoints in use but only {self._num_hw_bps} hardware breakpoints '
+                 f'available. Enabling flash breakpoints (slower; causes flash wear).')
+        self._fallback_enabled = True
+        cmd = self._target.gdb_srv_quirks.monitor_flash_breakpoints(True)
+        if cmd is None:
+            log.warn('The GDB server does not support flash breakpoints.')
+            return
+        try:
+            self._target.cli_exec(cmd)
+        except Exception as ex:
+            log.warn(f'Enabling flash breakpoints failed ({ex}).')
@@ -0,0 +1,121 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Per-test performance budgets. A test marked with dott_budget fails if it exceeds one of its budgets:
+#
+#   @pytest.mark.dott_budget(cycles=2_000_000, stack=512, wall_ms=250)
+#   def test_filter(self, target_load, target_reset):
+#       ...
+#
+#   cycles:  CPU cycles the target executed during the test (DWT CYCCNT, cleared once the target_reset_xxx fixture
+#            has initialized the memory model; not available on Cortex-M0/M0+)
+#   stack:   peak stack usage of the test in bytes (see StackMonitor; the stack is painted for tests with a stack
+#            budget even if stack_watch is not enabled)
+#   wall_ms: host time of the test in milliseconds, excluding the time spent in DOTT's fixtures (download, reset,
+#            memory model initialization, ...; see FixtureProfile)
+#
+# The measured values are attached to the test's JUnit XML properties (dott_budget_<name>) in any case.
+
+import struct
+from typing import Dict, List
+
+from dottmi.dottexceptions import DottException
+
+
+# -------------------------------------------------------------------------------------------------
+class CycleCounter(object):
+    """
+    CPU cycle count of the target based on the DWT cycle counter (CYCCNT). The counter is 32 bit wide, i.e., it wraps
+    around after 2^32 cycles (e.g., after 89s at 48MHz).
+    """
+    _DEMCR = 0xe000edfc
+    _DEMCR_TRCENA = 0x01000000
+    _DWT_CTRL = 0xe0001000
+    _DWT_CTRL_CYCCNTENA = 0x00000001
+    _DWT_CTRL_NOCYCCNT = 0x02000000
+    _DWT_CYCCNT = 0xe0001004
+
+    def __init__(self, target: 'Target') -> None:
+        self._target: 'Target' = target
+        self._fmt: str = '<I' if target.byte_order == 'little' else '>I'
+
+    def _read(self, reg: int) -> int:
+        return struct.unpack(self._fmt, self._target.mem.read(reg, 4))[0]
+
+    def _write(self, reg: int, val: int) -> None:
+        self._target.mem.write(reg, struct.pack(self._fmt, val))
+
+    def start(self) -> None:
+        """
+        Enables the cycle counter and clears it. The target has to be halted.
+        """
+        self._write(CycleCounter._DEMCR, self._read(CycleCounter._DEMCR) | CycleCounter._DEMCR_TRCENA)
+        ctrl = self._read(CycleCounter._DWT_CTRL)
+        if ctrl & CycleCounter._DWT_CTRL_NOCYCCNT or ctrl == 0:
+            raise DottException('The target does not implement the DWT cycle counter (CYCCNT).')
+        self._write(CycleCounter._DWT_CYCCNT, 0)
+        self._write(CycleCounter._DWT_CTRL, ctrl | CycleCounter._DWT_CTRL_CYCCNTENA)
+
+    def read(self) -> int:
+        """
+        Returns the cycles counted since start. The target has to be halted.
+        """
+        return self._read(CycleCounter._DWT_CYCCNT)
+
+
+# -------------------------------------------------------------------------------------------------
+class PerfBudget(object):
+    """
+    Budgets of a test as given by its dott_budget marker (see module description). Budgets which are not given are
+    None.
+    """
+    NAMES = ('cycles', 'stack', 'wall_ms')
+
+    def __init__(self, cycles: int = None, stack: int = None, wall_ms: float = None) -> None:
+        self.cycles: int = cycles
+        self.stack: int = stack
+        self.wall_ms: float = wall_ms
+
+    @staticmethod
+    def from_marker(marker) -> 'PerfBudget':
+        """
+        Returns the budget of the given dott_budget marker (None if no marker is given).
+        """
+        if marker is None:
+            return None
+        unknown = [name for name in marker.kwargs if name not in PerfBudget.NAMES]
+        if len(marker.args) > 0 or len(unknown) > 0:
+            raise DottException(f'dott_budget only accepts the keyword arguments {", ".join(PerfBudget.NAMES)} '
+                                f'(got {", ".join(unknown) if len(unknown) > 0 else "positional arguments"}).')
+        return PerfBudget(**marker.kwargs)
+
+    def exceeded(self, measured: Dict[str, float]) -> List[str]:
+        """
+        Returns a description of each budget exceeded by the measured values (name -> value; values which were not
+        measured are None).
+        """
+        units = {'cycles': 'cycles', 'stack': 'bytes', 'wall_ms': 'ms'}
+        res = []
+        for name in PerfBudget.NAMES:
+            budget, value = getattr(self, name), measured.get(name)
+            if budget is not None and value is not None and value > budget:
+                res.append(f'{name}: {value:.0f} {units[name]} exceed the budget of {budget} {units[name]} '
+                           f'(+{(value - budget) / budget * 100 if budget > 0 else float("inf"):.1f}%)')
+        return res
@@ -0,0 +1,320 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Core dumps of a halted target (see Target.core_dump) and offline analysis of them. A core dump is an ELF core file
+# with one PT_LOAD segment per captured memory region, an NT_PRSTATUS note (ARM layout) and a DOTT note with all
+# registers, peripheral snapshots and meta information (JSON). For the analysis, GdbServerCoreDump serves the dump
+# via GDB's remote protocol such that a Target (and hence eval, mem.read, symbols, ...) can be used exactly like with
+# hardware, only read-only:
+#
+#     dt.core_dump('failure.core')   # board is free again afterwards
+#     ...
+#     off = open_core_dump('failure.core')
+#     assert 42 == off.eval('app_state')
+#     off.disconnect()
+
+import binascii
+import json
+import socket
+import struct
+import threading
+from typing import Dict, List, Tuple, Union
+
+import dottmi.target  # note: dottmi.target and dottmi.gdb import each other; dottmi.target must be loaded first
+from dottmi.dottexceptions import DottException
+from dottmi.gdb import GdbServer, GdbServerQuirks
+from dottmi.utils import log
+
+# ELF constants
+_ET_CORE = 4
+_EM_ARM = 40
+_PT_LOAD = 1
+_PT_NOTE = 4
+_PF_RW = 0x6
+_NT_PRSTATUS = 1
+_NT_DOTT = 0x444f5454  # 'DOTT'
+
+# registers of the ARM M-profile core (org.gnu.gdb.arm.m-profile) in the order of the remote protocol
+_CORE_REGS = ['r0', 'r1', 'r2', 'r3', 'r4', 'r5', 'r6', 'r7', 'r8', 'r9', 'r10', 'r11', 'r12', 'sp', 'lr', 'pc',
+              'xpsr']
+
+
+def _pad4(data: bytes) -> bytes:
+    return data + b'\x00' * (-len(data) % 4)
+
+
+def _note(name: bytes, note_type: int, desc: bytes) -> bytes:
+    name += b'\x00'
+    return struct.pack('<III', len(name), len(desc), note_type) + _pad4(name) + _pad4(desc)
+
+
+# -------------------------------------------------------------------------------------------------
+class CoreDump(object):
+    """
+    Content of a core dump: register values, memory regions, peripheral snapshot values and meta information (e.g.,
+    the symbol ELF and the time of the capture).
+    """
+    def __init__(self, regs: Dict[str, int], regions: List[Tuple[int, bytes]], periph: Dict[str, Dict[str, int]] = None,
+                 info: Dict = None) -> None:
+        self.regs: Dict[str, int] = regs
+        self.regions: List[Tuple[int, bytes]] = sorted(regions)
+        self.periph: Dict[str, Dict[str, int]] = periph if periph is not None else {}
+        self.info: Dict = info if info is not None else {}
+
+    def reg(self, name: str) -> Union[int, None]:
+        return self.regs.get(name, self.regs.get(name.lower()))
+
+    def read(self, addr: int, num_bytes: int) -> bytes:
+        """
+        Returns the captured memory content starting at addr (up to num_bytes; less if the range is not captured
+        entirely).
+        """
+        data = b''
+        for start, content in self.regions:
+            if start <= addr + len(data) < start + len(content):
+                offset = addr + len(data) - start
+                data += content[offset:offset + num_bytes - len(data)]
+                if len(data) == num_bytes:
+                    break
+        return data
+
+    def save(self, file_name: str) -> None:
+        prstatus = bytearray(148)
+        struct.pack_into('<hxx', prstatus, 12, 5)  # pr_cursig: SIGTRAP
+        struct.pack_into('<I', prstatus, 24, 1)  # pr_pid
+        arm_regs = [self.regs.get(name, 0) for name in _CORE_REGS[:16]] + [self.regs.get('xpsr', 0), 0]
+        struct.pack_into('<18I', prstatus, 72, *arm_regs)
+        meta = {'regs': self.regs, 'periph': self.periph, 'info': self.info}
+        notes = _note(b'CORE', _NT_PRSTATUS, bytes(prstatus)) + _note(b'DOTT', _NT_DOTT, json.dumps(meta).encode())
+
+        num_ph = 1 + len(self.regions)
+        offset = 52 + 32 * num_ph
+        phdrs = [struct.pack('<IIIIIIII', _PT_NOTE, offset, 0, 0, len(notes), 0, 0, 4)]
+        offset += len(notes)
+        for addr, content in self.regions:
+            phdrs.append(struct.pack('<IIIIIIII', _PT_LOAD, offset, addr, addr, len(content), len(content), _PF_RW, 4))
+            offset += len(content)
+
+        ehdr = b'\x7fELF' + bytes([1, 1, 1]) + bytes(9) + \
+            struct.pack('<HHIIIIIHHHHHH', _ET_CORE, _EM_ARM, 1, 0, 52, 0, 0, 52, 32, num_ph, 0, 0, 0)
+        with open(file_name, 'wb') as f:
+            f.write(ehdr)
+            f.write(b''.join(phdrs))
+            f.write(notes)
+            for _, content in self.regions:
+                f.write(content)
+
+    @staticmethod
+    def load(file_name: str) -> 'CoreDump':
+        with open(file_name, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF' or data[4] != 1 or struct.unpack_from('<H', data, 16)[0] != _ET_CORE:
+            raise DottException(f'{file_name} is no (32bit) ELF core file.')
+        ph_off, = struct.unpack_from('<I', data, 28)
+        ph_size, ph_num = struct.unpack_from('<HH', data, 42)
+
+        regs: Dict[str, int] = {}
+        regions: List[Tuple[int, bytes]] = []
+        meta: Dict = {}
+        for i in range(ph_num):
+            phdr = struct.unpack_from('<IIIIIIII', data, ph_off + i * ph_size)
+            p_type, p_offset, p_vaddr, p_filesz = phdr[0], phdr[1], phdr[2], phdr[4]
+            if p_type == _PT_LOAD:
+                regions.append((p_vaddr, data[p_offset:p_offset + p_filesz]))
+            elif p_type == _PT_NOTE:
+                pos = p_offset
+                while pos + 12 <= p_offset + p_filesz:
+                    namesz, descsz, note_type = struct.unpack_from('<III', data, pos)
+                    desc_pos = pos + 12 + namesz + (-namesz % 4)
+                    desc = data[desc_pos:desc_pos + descsz]
+                    if note_type == _NT_DOTT:
+                        meta = json.loads(desc.decode())
+                    elif note_type == _NT_PRSTATUS and len(desc) >= 144:
+                        vals = struct.unpack_from('<17I', desc, 72)
+                        regs.update(zip(_CORE_REGS, vals))
+                    pos = desc_pos + descsz + (-descsz % 4)
+        regs.update(meta.get('regs', {}))
+        return CoreDump(regs, regions, meta.get('periph'), meta.get('info'))
+
+
+# -------------------------------------------------------------------------------------------------
+class GdbServerCoreDump(GdbServer):
+    """
+    Minimal GDB server (remote serial protocol) which serves a core dump: registers and captured memory can be read,
+    writes are rejected and the target is always halted (continuing or stepping stops immediately). It runs in a
+    thread of DOTT and listens on a free local port.
+    """
+    def __init__(self, dump: CoreDump, device_id: str = None) -> None:
+        self._dump: CoreDump = dump
+        self._sock: socket.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self._sock.bind(('127.0.0.1', 0))
+        self._sock.listen(1)
+        super().__init__('127.0.0.1', self._sock.getsockname()[1], device_id or dump.info.get('device'))
+        self._extra_regs: List[str] = [name for name in dump.regs if name not in _CORE_REGS]
+        self._running: bool = True
+        self._thread: threading.Thread = threading.Thread(target=self._serve, name='GdbServerCoreDump', daemon=True)
+        self._thread.start()
+
+    @property
+    def dump(self) -> CoreDump:
+        return self._dump
+
+    def quirks(self) -> 'GdbServerQuirks':
+        # note: there is neither a reset nor a breakpoint monitor command
+        return GdbServerQuirks('xpsr', None, None)
+
+    def _launch(self, block: bool = True):
+        pass
+
+    def shutdown(self):
+        self._running = False
+        try:
+            self._sock.close()
+        except OSError:
+            pass
+
+    def _target_xml(self) -> str:
+        regs = ''.join(f'<reg name="{name}" bitsize="32" regnum="{i}"/>' for i, name in enumerate(_CORE_REGS))
+        extra = ''.join(f'<reg name="{name}" bitsize="32" regnum="{len(_CORE_REGS) + i}" group="system"/>'
+                        for i, name in enumerate(self._extra_regs))
+        return ('<?xml version="1.0"?><!DOCTYPE target SYSTEM "gdb-target.dtd"><target><architecture>arm'
+                '</architecture><feature name="org.gnu.gdb.arm.m-profile">' + regs + '</feature>' +
+                (f'<feature name="org.dott.core-dump">{extra}</feature>' if extra != '' else '') + '</target>')
+
+    def _reg_hex(self, idx: int) -> str:
+        names = _CORE_REGS + self._extra_regs
+        val = self._dump.regs.get(names[idx]) if idx < len(names) else None
+        return 'xxxxxxxx' if val is None else struct.pack('<I', val & 0xffffffff).hex()
+
+    def _handle(self, pkt: str) -> Union[str, None]:
+        # returns the response or None if the connection shall be closed
+        if pkt.startswith('qSupported'):
+            return 'PacketSize=4000;qXfer:features:read+;QStartNoAckMode+'
+        if pkt.startswith('qXfer:features:read:target.xml:'):
+            offset, length = (int(v, 16) for v in pkt.rsplit(':', 1)[1].split(','))
+            xml = self._target_xml()
+            return ('l' if offset + length >= len(xml) else 'm') + xml[offset:offset + length]
+        if pkt in ('?', 'c', 's') or pkt.startswith('vCont;') or pkt.startswith('C') or pkt.startswith('S'):
+            return 'S05'
+        if pkt == 'g':
+            return ''.join(self._reg_hex(i) for i in range(len(_CORE_REGS) + len(self._extra_regs)))
+        if pkt.startswith('p'):
+            return self._reg_hex(int(pkt[1:], 16))
+        if pkt.startswith('m'):
+            addr, length = (int(v, 16) for v in pkt[1:].split(','))
+            data = self._dump.read(addr, length)
+            return binascii.hexlify(data).decode() if len(data) > 0 else 'E14'
+        if pkt[:1] in ('M', 'X', 'P', 'G'):
+            return 'E01'  # read-only
+        if pkt.startswith('qRcmd,'):
+            return 'OK'
+        if pkt in ('qAttached',):
+            return '1'
+        if pkt in ('qfThreadInfo',):
+            return 'm1'
+        if pkt in ('qsThreadInfo',):
+            return 'l'
+        if pkt == 'qC':
+            return 'QC1'
+        if pkt.startswith('H') or pkt.startswith('T') or pkt == 'qSymbol::' or pkt == 'vKill' or pkt.startswith('z'):
+            return 'OK'
+        if pkt.startswith('D'):
+            return None
+        return ''  # not supported
+
+    def _serve(self) -> None:
+        while self._running:
+            try:
+                conn, _ = self._sock.accept()
+            except OSError:
+                return
+            with conn:
+                self._serve_connection(conn)
+
+    def _serve_connection(self, conn: socket.socket) -> None:
+        buf = b''
+        ack = True
+        while self._running:
+            try:
+                chunk = conn.recv(4096)
+            except OSError:
+                return
+            if len(chunk) == 0:
+                return
+            buf += chunk
+            while True:
+                buf = buf.lstrip(b'+-')
+                if buf.startswith(b'\x03'):  # interrupt: the target is always halted
+                    buf = buf[1:]
+                    conn.sendall(self._packet('S05'))
+                    continue
+                start, end = buf.find(b'$'), buf.find(b'#')
+                if start < 0 or end < 0 or len(buf) < end + 3:
+                    break
+                pkt = buf[start + 1:end].decode(errors='replace')
+                buf = buf[end + 3:]
+                if pkt == 'k':
+                    return
+                if ack:
+                    conn.sendall(b'+')
+                if pkt == 'QStartNoAckMode':
+                    conn.sendall(self._packet('OK'))
+                    ack = False
+                    continue
+                resp = self._handle(pkt)
+                if resp is None:
+                    conn.sendall(self._packet('OK'))
+                    return
+                conn.sendall(self._packet(resp))
+
+    @staticmethod
+    def _packet(data: str) -> bytes:
+        payload = data.encode()
+        return b'$' + payload + b'#' + f'{sum(payload) & 0xff:02x}'.encode()
+
+
+def open_core_dump(file_name: str, symbol_elf: str = None) -> 'Target':
+    """
+    Opens a core dump (see Target.core_dump) for offline analysis. A GDB instance is started and connected to a core
+    dump server (see GdbServerCoreDump); no hardware is involved. The returned target supports all read-only
+    operations (eval, mem.read, symbols, ...). It has to be disconnected (disconnect) once the analysis is done.
+
+    Args:
+        file_name: Core dump file.
+        symbol_elf: Symbol ELF of the firmware. Default: the symbol ELF recorded in the core dump.
+    """
+    from dottmi.dott import DottConf
+    from dottmi.gdb import GdbClient
+    from dottmi.target import Target
+
+    dump = CoreDump.load(file_name)
+    server = GdbServerCoreDump(dump, dump.info.get('device', DottConf.get('device_name')))
+    client = GdbClient(DottConf.conf['gdb_client_binary'])
+    try:
+        client.connect()
+        tgt = Target(server, client)
+    except Exception:
+        server.shutdown()
+        raise
+    symbol_elf = symbol_elf if symbol_elf is not None else dump.info.get('symbol_elf')
+    if symbol_elf is not None:
+        tgt.load(None, symbol_elf, download=False)
+    log.info(f'Opened core dump {file_name} (captured {dump.info.get("time", "at unknown time")}).')
+    return tgt
@@ -0,0 +1,299 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import bisect
+import binascii
+import json
+import os
+from typing import Dict, List, Set, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class CoverageCollector(object):
+    """
+    Collects function or line coverage of unmodified firmware by breakpoint sweeping: every probe location (function
+    entry or first instruction of a source line) is covered by a one-shot breakpoint. Only as many breakpoints as
+    hardware comparators are budgeted are armed at a time; a probe which has been hit is replaced by the next pending
+    one without waking up DOTT (see CoverageSweep in gdb_cmds.py). At every rotation (e.g., at the end of each test)
+    the hits are collected and probes which were not hit are re-queued such that the sweep progresses through all
+    probe locations over the course of the test session.
+    Locations are mapped back to source files and lines using GDB's line table of the symbol ELF.
+    """
+    MODE_FUNCTION = 'function'
+    MODE_LINE = 'line'
+
+    # number of probe addresses sent to GDB per command
+    _CHUNK_SIZE = 1000
+
+    def __init__(self, target: 'Target', mode: str = MODE_FUNCTION, budget: int = None, rearm: bool = False,
+                 functions: List[str] = None, tag_addr: int = None) -> None:
+        """
+        Constructor.
+
+        Args:
+            target: Target to collect the coverage for (the symbol ELF has to be loaded).
+            mode: MODE_FUNCTION (function entries) or MODE_LINE (source lines).
+            budget: Number of breakpoints used for probes. Default: number of hardware breakpoints minus two (leaving
+                    comparators for the halt points of the tests).
+            rearm: If True, probes which have been hit are re-armed at each rotation such that the locations executed
+                   by each individual test are recorded (see last_functions). This keeps all probes in the sweep;
+                   the per-test record is complete only if the budget covers all probes.
+            functions: If given, only locations within these functions are probed.
+            tag_addr: If given, the 32 bit word at this address is recorded with each probe hit (see last_tags).
+        """
+        if mode not in (CoverageCollector.MODE_FUNCTION, CoverageCollector.MODE_LINE):
+            raise DottException(f'Unknown coverage mode {mode}.')
+        self._target: 'Target' = target
+        self._mode: str = mode
+        self._budget: int = budget if budget is not None else max(1, target.bp_manager.num_hw_bps - 2)
+        self._elf_key: str = None
+        self._lines: List[Tuple[int, str, int]] = []  # line table (address, file, line) sorted by address
+        self._line_addrs: List[int] = []
+        self._funcs: Dict[int, str] = {}  # function start address -> name
+        self._probes: Dict[int, Tuple[str, str, int]] = {}  # probe address -> (function, file, line)
+        self._hit: Set[int] = set()
+        self._last_hits: Set[int] = set()  # probes hit during the last rotation
+        self._rearm: bool = rearm
+        self._functions: Set[str] = set(functions) if functions is not None else None
+        self._tag_addr: int = tag_addr
+        self._last_tags: Dict[int, int] = {}  # probe address -> tag recorded with its hit during the last rotation
+        self._unarmed: int = 0
+        self._active: bool = False
+
+    @property
+    def mode(self) -> str:
+        return self._mode
+
+    @property
+    def active(self) -> bool:
+        return self._active
+
+    @property
+    def num_probes(self) -> int:
+        return len(self._probes)
+
+    @property
+    def num_hit(self) -> int:
+        return len(self._hit)
+
+    @property
+    def last_functions(self) -> Set[str]:
+        """
+        Names of the functions whose probes were hit between the last two rotations (e.g., during the last test).
+        """
+        return {self._probes[addr][0] for addr in self._last_hits if addr in self._probes and
+                self._probes[addr][0] is not None}
+
+    @property
+    def last_tags(self) -> Dict[int, int]:
+        """
+        Tags (value of the word at tag_addr at the time of the hit) of the probes hit during the last rotation.
+        """
+        return self._last_tags
+
+    @property
+    def num_unarmed(self) -> int:
+        """
+        Number of probe locations which have not been armed so far (their coverage state is unknown).
+        """
+        return self._unarmed
+
+    def _line_table(self) -> List[Tuple[int, str, int]]:
+        res = self._target.exec('-file-list-exec-source-files')
+        files = sorted({f.get('fullname', f.get('file')) for f in res.get('payload', {}).get('files', [])})
+        files = [f for f in files if f is not None]
+        cmds = [f'-symbol-list-lines "{f}"' for f in files]
+        try:
+            results = self._target.exec_many(cmds)
+        except Exception:
+            results = []
+            for cmd in cmds:  # note: some files (e.g., headers without code) may not have a line table
+                try:
+                    results.append(self._target.exec(cmd))
+                except Exception:
+                    results.append(None)
+
+        table: Dict[int, Tuple[int, str, int]] = {}
+        for file, res in zip(files, results):
+            if res is None:
+                continue
+            for entry in res.get('payload', {}).get('lines', []):
+                addr, line = int(entry['pc'], 0), int(entry['line'])
+                if line > 0 and addr not in table:
+                    table[addr] = (addr, file, line)
+        return sorted(table.values())
+
+    def _source_of(self, addr: int) -> Tuple[str, int]:
+        i = bisect.bisect_right(self._line_addrs, addr) - 1
+        if i < 0:
+            return None, 0
+        return self._lines[i][1], self._lines[i][2]
+
+    def start(self) -> None:
+        """
+        Determines the probe locations of the loaded symbol ELF and starts the sweep. Coverage collected so far is
+        kept if the same ELF is still loaded; otherwise it is discarded.
+        """
+        symbols = self._target.symbols
+        if symbols.key is None:
+            raise DottException('Coverage collection requires the symbol ELF to be loaded.')
+        if symbols.key != self._elf_key:
+            if self._elf_key is not None:
+                log.warn('Symbol ELF changed. Discarding coverage collected so far.')
+            self._elf_key = symbols.key
+            self._lines = self._line_table()
+            self._line_addrs = [addr for addr, _, _ in self._lines]
+            self._funcs = {addr: name for name, addr in symbols.functions().items()}
+            self._hit = set()
+            self._probes = {}
+            if self._mode == CoverageCollector.MODE_FUNCTION:
+                for addr, name in self._funcs.items():
+                    i = bisect.bisect_right(self._line_addrs, addr) - 1
+                    # note: functions without debug information (line table entry outside the function) are not probed
+                    if i >= 0 and symbols.func_at(self._line_addrs[i]) == name:
+                        self._probes[addr] = (name, self._lines[i][1], self._lines[i][2])
+            else:
+                lines_seen: Set[Tuple[str, int]] = set()
+                for addr, file, line in self._lines:
+                    if (file, line) not in lines_seen:  # note: the first (lowest) address of each line is probed
+                        lines_seen.add((file, line))
+                        self._probes[addr] = (symbols.func_at(addr), file, line)
+            if self._functions is not None:
+                self._probes = {addr: p for addr, p in self._probes.items() if p[0] in self._functions}
+
+        addrs = [addr for addr in sorted(self._probes) if self._rearm or addr not in self._hit]
+        size = CoverageCollector._CHUNK_SIZE
+        chunks = [addrs[i:i + size] for i in range(0, len(addrs), size)]
+        spec = json.dumps({'addrs': chunks[0] if len(chunks) > 0 else [], 'budget': self._budget,
+                           'rearm': self._rearm, 'tag': self._tag_addr, 'byte_order': self._target.byte_order})
+        self._dott_cmd('dott-cov-start', binascii.hexlify(spec.encode()).decode())
+        for chunk in chunks[1:]:
+            self._dott_cmd('dott-cov-add', binascii.hexlify(json.dumps(chunk).encode()).decode())
+        self._unarmed = max(0, len(addrs) - self._budget)
+        self._active = True
+        log.info(f'Coverage sweep started ({len(addrs)} of {len(self._probes)} {self._mode} probes pending, '
+                 f'{self._budget} breakpoints).')
+
+    def _dott_cmd(self, cmd: str, args: str = '') -> Dict:
+        status, payload = self._target.gdb_client.gdb_mi.write_dott_cmd(cmd, args)
+        payload = bytes.fromhex(payload).decode()
+        if status != 'OK':
+            raise DottException(f'Coverage command {cmd} failed ({payload}).')
+        return json.loads(payload)
+
+    def rotate(self) -> int:
+        """
+        Collects the probes hit since the last rotation and arms the next batch of probes. The target should be
+        halted. Returns the number of newly covered locations.
+        """
+        if not self._active:
+            return 0
+        res = self._dott_cmd('dott-cov-rotate')
+        self._last_hits = set(res['hits'])
+        self._last_tags = dict(zip(res['hits'], res.get('tags', [])))
+        new = self._last_hits - self._hit
+        self._hit.update(new)
+        self._unarmed = res['unarmed']
+        return len(new)
+
+    def stop(self) -> None:
+        """
+        Collects the remaining hits and removes all probes.
+        """
+        if not self._active:
+            return
+        self.rotate()
+        self._target.cli_exec('dott-cov-stop')
+        self._active = False
+
+    def functions(self) -> Dict[str, bool]:
+        """
+        Returns the covered state of each probed function (function coverage) or of each function containing probed
+        lines (line coverage; a function counts as covered if any of its lines was hit).
+        """
+        funcs: Dict[str, bool] = {}
+        for addr, (func, _, _) in self._probes.items():
+            if func is not None:
+                funcs[func] = funcs.get(func, False) or addr in self._hit
+        return funcs
+
+    def lines(self) -> Dict[str, Dict[int, bool]]:
+        """
+        Returns the covered state of the probed lines per source file (line coverage) or of the function entry lines
+        (function coverage).
+        """
+        files: Dict[str, Dict[int, bool]] = {}
+        for addr, (_, file, line) in self._probes.items():
+            lines = files.setdefault(file, {})
+            lines[line] = lines.get(line, False) or addr in self._hit
+        return files
+
+    def summary(self) -> str:
+        funcs = self.functions()
+        num_funcs_hit = sum(1 for hit in funcs.values() if hit)
+        text = f'Coverage: {num_funcs_hit} of {len(funcs)} functions'
+        if self._mode == CoverageCollector.MODE_LINE:
+            lines = [hit for file_lines in self.lines().values() for hit in file_lines.values()]
+            text += f', {sum(1 for hit in lines if hit)} of {len(lines)} lines'
+        if self._unarmed > 0:
+            text += f' ({self._unarmed} probes not armed yet; coverage is incomplete)'
+        return text
+
+    def save_lcov(self, file_name: str) -> None:
+        """
+        Writes the coverage in lcov trace file format (e.g., for genhtml or CI coverage reports).
+        """
+        by_file: Dict[str, List[Tuple[int, str, int, bool]]] = {}
+        for addr, (func, file, line) in self._probes.items():
+            by_file.setdefault(file, []).append((addr, func, line, addr in self._hit))
+
+        func_addrs = {name: addr for addr, name in self._funcs.items()}
+        out: List[str] = ['TN:dott']
+        for file in sorted(by_file):
+            out.append(f'SF:{file}')
+            probes = sorted(by_file[file], key=lambda p: p[2])
+            funcs: Dict[str, bool] = {}
+            for _, name, _, hit in probes:
+                if name is not None:
+                    funcs[name] = funcs.get(name, False) or hit
+            func_entries = sorted((self._source_of(func_addrs[name])[1] if name in func_addrs else 0, name, hit)
+                                  for name, hit in funcs.items())
+            for line, name, _ in func_entries:
+                out.append(f'FN:{line},{name}')
+            for _, name, hit in func_entries:
+                out.append(f'FNDA:{1 if hit else 0},{name}')
+            out.append(f'FNF:{len(func_entries)}')
+            out.append(f'FNH:{sum(1 for _, _, hit in func_entries if hit)}')
+            lines: Dict[int, bool] = {}
+            for _, _, line, hit in probes:
+                lines[line] = lines.get(line, False) or hit
+            for line in sorted(lines):
+                out.append(f'DA:{line},{1 if lines[line] else 0}')
+            out.append(f'LF:{len(lines)}')
+            out.append(f'LH:{sum(1 for hit in lines.values() if hit)}')
+            out.append('end_of_record')
+
+        tmp_file = f'{file_name}.{os.getpid()}.tmp'
+        with open(tmp_file, 'w') as f:
+            f.write('\n'.join(out) + '\n')
+        os.replace(tmp_file, file_name)
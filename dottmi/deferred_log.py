@@ -0,0 +1,269 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Host side of DOTT's deferred firmware logging (DOTT_LOG in testhelpers.h). The firmware only writes the address of
+# the format string and the raw arguments of each DOTT_LOG call into the DOTT_log ring buffer; the format strings are
+# read from the ELF file and the records are formatted on the host (printf conversions d, i, u, o, x, X, c, s, p and
+# f, e, g for arguments passed with DOTT_LOG_F32). The buffer is drained with one bulk read (at most two if the
+# records wrap around the end of the buffer), either while the target is halted (drain) or while it keeps running
+# (drain_live, collect). For example:
+#
+#   fw_log = DeferredLog(dt)
+#   dt.cont()
+#   ...
+#   dt.halt()
+#   for rec in fw_log.drain():
+#       log.info(f'[fw] {rec.text}')
+#   assert fw_log.wait_for(live_access, 'calibration done', timeout=2.0) is not None
+#
+# Note: Records are discarded by the firmware (and counted, see DeferredLog.dropped) while the buffer is full, i.e.,
+# the buffer has to be drained in time (or enlarged with DOTT_LOG_BUFFER_WORDS) if no record shall be lost.
+
+import re
+import struct
+import time
+from typing import Callable, Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.elf_file import ElfFile
+
+# layout of DOTT_log_t (see testhelpers.h): head, tail, num_words, flags, dropped
+_HEADER_FMT = 'IIIII'
+_HEADER_SIZE = 20
+_TAIL_OFFSET = 4
+_FLAG_TIMESTAMP = 1
+
+# printf conversion specification (flags, width, precision, length modifier, conversion)
+_CONV_RE = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?([diouxXcspfFeEgGaA%])')
+
+# maximum length of a string argument (%s) read from the target
+_MAX_STR_LEN = 256
+
+
+# -------------------------------------------------------------------------------------------------
+class LogRecord(object):
+    """
+    A formatted record of DOTT_LOG.
+    """
+    def __init__(self, fmt: str, args: Tuple[int, ...], text: str, timestamp: int = None) -> None:
+        self.fmt: str = fmt
+        self.args: Tuple[int, ...] = args  # raw argument words
+        self.text: str = text
+        self.timestamp: int = timestamp  # value of DOTT_LOG_TIMESTAMP (None if not enabled)
+
+    def __str__(self) -> str:
+        return self.text if self.timestamp is None else f'{self.timestamp:>10}: {self.text}'
+
+
+class DeferredLog(object):
+    """
+    Drains and formats the records of the DOTT_log ring buffer (see module description). The firmware has to be built
+    with DOTT_DEFERRED_LOG and its ELF file has to be loaded.
+    """
+    # interval (seconds) in which collect and wait_for poll the ring buffer
+    POLL_INTERVAL_SEC = 0.01
+
+    def __init__(self, target: 'Target', fmt_section: str = '.dott_log_fmt') -> None:
+        """
+        Args:
+            target: Target with the instrumented firmware.
+            fmt_section: Section of the format strings (see DOTT_LOG_FMT_SECTION).
+        """
+        self._target: 'Target' = target
+        self._fmt_section: str = fmt_section
+        if not target.symbols.exists('DOTT_log'):
+            raise DottException('DOTT_log not found. Build the firmware with DOTT_DEFERRED_LOG.')
+        if target.symbols.elf_file is None:
+            raise DottException('DeferredLog requires the ELF file of the firmware (format strings).')
+        self._addr: int = target.symbols.addr('DOTT_log')
+        self._elf: ElfFile = ElfFile.open(target.symbols.elf_file)
+        self._bo: str = '<' if target.byte_order == 'little' else '>'
+        self._fmts: Dict[int, str] = {}
+        self._dropped: int = 0
+        self._records: List[LogRecord] = []  # records drained by collect and wait_for
+
+    @property
+    def dropped(self) -> int:
+        """
+        Number of records the firmware discarded because the buffer was full (as of the last drain).
+        """
+        return self._dropped
+
+    @property
+    def records(self) -> List[LogRecord]:
+        """
+        The records drained by collect and wait_for so far.
+        """
+        return list(self._records)
+
+    def _elf_str(self, addr: int) -> str:
+        # returns the NUL-terminated string at the given address from the ELF sections with content (None if the
+        # address is not part of any of them)
+        _, _, sections, sec_names = self._elf.sections
+        for sec, name in zip(sections, sec_names):
+            if sec[1] in (0, 8) or not sec[3] <= addr < sec[3] + sec[5]:  # SHT_NULL, SHT_NOBITS
+                continue
+            # note: non-allocated sections (e.g., the format section declared as INFO) have the address 0
+            if sec[3] == 0 and name != self._fmt_section:
+                continue
+            data = self._elf.read(sec[4] + addr - sec[3], sec[3] + sec[5] - addr)
+            end = data.find(b'\x00')
+            return data[:end if end >= 0 else len(data)].decode(errors='replace')
+        return None
+
+    def _fmt(self, addr: int) -> str:
+        fmt = self._fmts.get(addr)
+        if fmt is None:
+            fmt = self._elf_str(addr)
+            if fmt is None:
+                fmt = f'<unknown format 0x{addr:08x}>'
+            self._fmts[addr] = fmt
+        return fmt
+
+    def _str_arg(self, addr: int, read: Callable[[int, int], bytes]) -> str:
+        s = self._elf_str(addr)
+        if s is not None:
+            return s
+        try:
+            data = read(addr, _MAX_STR_LEN)
+        except Exception:
+            return f'<0x{addr:08x}>'
+        end = data.find(b'\x00')
+        return data[:end if end >= 0 else len(data)].decode(errors='replace')
+
+    def format(self, fmt: str, args: Tuple[int, ...], read: Callable[[int, int], bytes] = None) -> str:
+        """
+        Formats the given raw argument words according to the (printf) format string. String arguments which are not
+        part of the ELF file are read with read(addr, num_bytes).
+        """
+        args = list(args)
+
+        def next_arg() -> int:
+            return args.pop(0) if len(args) > 0 else 0
+
+        def conv(m) -> str:
+            flags, width, prec, length, c = m.groups()
+            if c == '%':
+                return '%'
+            width = str(next_arg()) if width == '*' else (width or '')
+            prec = str(next_arg()) if prec == '*' else prec
+            spec = '%' + flags + width + ('.' + prec if prec is not None else '')
+            val = next_arg()
+            if c in 'di':
+                bits = 8 if length == 'hh' else 16 if length == 'h' else 32
+                val &= (1 << bits) - 1
+                return (spec + 'd') % (val - (1 << bits) if val >= 1 << (bits - 1) else val)
+            if c in 'ouxX':
+                val &= 0xff if length == 'hh' else 0xffff if length == 'h' else 0xffffffff
+                return (spec + ('d' if c == 'u' else c)) % val
+            if c == 'c':
+                return (spec + 'c') % (val & 0xff)
+            if c == 'p':
+                return (spec + 's') % f'0x{val:08x}'
+            if c == 's':
+                return (spec + 's') % self._str_arg(val, read if read is not None else self._target.mem.read)
+            f = struct.unpack('<f', struct.pack('<I', val & 0xffffffff))[0]
+            return (spec + ('e' if c in 'aA' else c)) % f
+
+        return _CONV_RE.sub(conv, fmt)
+
+    def _parse(self, words: List[int], flags: int, read: Callable[[int, int], bytes]) -> List[LogRecord]:
+        res: List[LogRecord] = []
+        ts_words = 1 if flags & _FLAG_TIMESTAMP else 0
+        pos = 0
+        while pos < len(words):
+            hdr = words[pos]
+            num_args = hdr & 0x7
+            ts = words[pos + 1] if ts_words else None
+            args = tuple(words[pos + 1 + ts_words:pos + 1 + ts_words + num_args])
+            fmt = self._fmt(hdr & ~0x7)
+            res.append(LogRecord(fmt, args, self.format(fmt, args, read), ts))
+            pos += 1 + ts_words + num_args
+        return res
+
+    def _drain(self, read: Callable[[int, int], bytes], write: Callable[[int, bytes], None]) -> List[LogRecord]:
+        head, tail, num_words, flags, dropped = struct.unpack(self._bo + _HEADER_FMT, read(self._addr, _HEADER_SIZE))
+        if num_words == 0:
+            raise DottException('DOTT_log is not initialized.')
+        self._dropped = dropped
+        count = (head - tail) & 0xffffffff
+        if count > num_words:
+            raise DottException(f'DOTT_log is corrupted (head {head}, tail {tail}).')
+        words: List[int] = []
+        pos = tail
+        while len(words) < count:
+            # note: the records may wrap around the end of the buffer (the words are read with two bulk reads)
+            idx = pos % num_words
+            num = min(count - len(words), num_words - idx)
+            data = read(self._addr + _HEADER_SIZE + idx * 4, num * 4)
+            words += struct.unpack(f'{self._bo}{num}I', data)
+            pos += num
+        if count > 0:
+            # note: the words are released before they are formatted (formatting may read strings from the target)
+            write(self._addr + _TAIL_OFFSET, struct.pack(self._bo + 'I', head))
+        return self._parse(words, flags, read)
+
+    def drain(self) -> List[LogRecord]:
+        """
+        Returns the records written since the last drain and releases their space in the buffer. The target has to be
+        halted.
+        """
+        return self._drain(self._target.mem.read, self._target.mem.write)
+
+    def drain_live(self, live) -> List[LogRecord]:
+        """
+        Like drain but while the target is running using the given live access connection with write support (e.g.,
+        live_access fixture).
+        """
+        if not hasattr(live, 'mem_write'):
+            raise DottException('DeferredLog: the live access connection does not support writes.')
+        return self._drain(live.mem_read, live.mem_write)
+
+    def collect(self, live, duration: float) -> List[LogRecord]:
+        """
+        Drains the buffer periodically (see drain_live) for the given time (seconds) and returns the records.
+        """
+        res: List[LogRecord] = []
+        deadline = time.monotonic() + duration
+        with live.session():
+            while True:
+                res += self.drain_live(live)
+                if time.monotonic() >= deadline:
+                    break
+                time.sleep(DeferredLog.POLL_INTERVAL_SEC)
+        self._records += res
+        return res
+
+    def wait_for(self, live, text: str, timeout: float = 5.0) -> LogRecord:
+        """
+        Drains the buffer periodically (see drain_live) until a record containing the given text has been written
+        (returned) or the timeout expired (returns None).
+        """
+        deadline = time.monotonic() + timeout
+        with live.session():
+            while True:
+                recs = self.drain_live(live)
+                self._records += recs
+                for rec in recs:
+                    if text in rec.text:
+                        return rec
+                if time.monotonic() >= deadline:
+                    return None
+                time.sleep(DeferredLog.POLL_INTERVAL_SEC)
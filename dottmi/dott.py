@@ -20,20 +20,26 @@
 
 import configparser
 import glob
+import json
 import os
 import os.path
 import platform
-import socket
+import shutil
 import subprocess
 import sys
+import tempfile
+import threading
 import types
+from concurrent.futures import ThreadPoolExecutor
+from contextlib import contextmanager
 from ctypes import CDLL
 from importlib.machinery import SourceFileLoader
 from pathlib import Path
-from typing import List, Tuple
+from typing import Any, Callable, Dict, Iterator, List, Tuple
 
 from dottmi.dottexceptions import DottException
 from dottmi.target_mem import TargetMemModel
+from dottmi.timeline import timeline
 from dottmi.utils import log, log_setup, singleton
 
 
@@ -55,7 +61,9 @@ class Dott(object):
 
     def __init__(self) -> None:
         self._default_target = None
+        self._default_target_pending: bool = True
         self._all_targets: List = []
+        self._current: threading.local = threading.local()  # current target per thread (see use_target)
 
         # initialize logging subsystem
         log_setup()
@@ -66,65 +74,65 @@ class Dott(object):
         # the port number used by the internal auto port discovery; discovery starts at config's gdb server port
         self._next_gdb_srv_port: int = int(DottConf.conf['gdb_server_port'])
 
-        # Hook called before the first debugger connection is made
-        DottHooks.exec_pre_connect_hook()
+        # number of GDB sessions recorded or replayed so far (see _session_file)
+        self._num_sessions: int = 0
+        # number of GDB sessions whose console output is captured so far (see gdb_console_file)
+        self._num_console_files: int = 0
 
-        self._default_target = self.create_target(DottConf.conf['device_name'], DottConf.conf['jlink_serial'])
+        # note: the default target is created (and GDB is started) on first use (see target)
 
-    def _get_next_srv_port(self, srv_addr: str) -> int:
+    def _reserve_srv_ports(self, srv_addr: str) -> 'PortReservation':
         """
-        Find the next triplet of free ("bind-able") TCP ports on the given server IP address.
-        Ports are automatically advanced unit a free port triplet is found.
+        Reserves the next triplet of free ("bind-able") TCP ports on the given server IP address. The ports stay bound
+        until the GDB server is started. Since ports handed out before are still bound (by the reservation or by the
+        running GDB server), the common case requires a single bind attempt per port.
+        Ports are automatically advanced until a free port triplet is found; the search wraps around once.
 
         Args:
             srv_addr: IP address of the server.
         Returns:
-            Returns the first port number of the discovered, free port triplet.
+            Returns the reservation of the discovered, free port triplet.
         """
-        port = self._next_gdb_srv_port
-        sequentially_free_ports = 0
-        start_port = 0
+        from dottmi.gdb import PortReservation
 
+        first_port = int(DottConf.conf['gdb_server_port'])
+        port = self._next_gdb_srv_port
+        wrapped = False
         while True:
-            s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            if port + 2 >= 65535:
+                if wrapped:
+                    raise DottException(f'Unable do find three (consecutive) free ports for IP {srv_addr}!')
+                port, wrapped = first_port, True
             try:
-                s.bind((srv_addr, port))
-                sequentially_free_ports += 1
-                if sequentially_free_ports == 1:
-                    start_port = port
-            except socket.error:
-                # log.debug(f'Can not bind port {port} as it is already in use.')
-                sequentially_free_ports = 0
-            finally:
-                s.close()
-
-            if sequentially_free_ports > 2:
                 # JLINK GDB server needs 3 free ports in a row
+                reservation = PortReservation(srv_addr, port, 3)
                 break
+            except OSError as ex:
+                # log.debug(f'Can not bind port {port + ex.offset} as it is already in use.')
+                port += getattr(ex, 'offset', 0) + 1
 
-            port += 1
-            if port >= 65535:
-                raise DottException(f'Unable do find three (consecutive) free ports for IP {srv_addr}!')
-
-        self._next_gdb_srv_port = start_port + sequentially_free_ports
+        self._next_gdb_srv_port = port + 3
         if self._next_gdb_srv_port > 65500:
-            self._next_gdb_srv_port = int(DottConf.conf['gdb_server_port'])
-        return start_port
+            self._next_gdb_srv_port = first_port
+        return reservation
 
-    def create_gdb_server(self, dev_name: str, jlink_serial: str = None, srv_addr: str = None, srv_port: int = -1) -> 'GdbServer':
+    def create_gdb_server(self, dev_name: str, jlink_serial: str = None, srv_addr: str = None, srv_port: int = -1,
+                          block: bool = True) -> 'GdbServer':
         """
         Factory method to create a new GDB server instance. The following parameters are defined via DottConfig:
-        gdb_server_binary, jlink_interface, device_endianess, jlink_speed, and jlink_server_addr.
+        gdb_server_type, gdb_server_binary, jlink_interface, device_endianess, jlink_speed, jlink_server_addr,
+        openocd_cfg, pyocd_target, qemu_machine, qemu_args and renode_platform.
 
         Args:
             dev_name: Device name as in JLinkDevices.xml
-            jlink_serial: JLINK serial number.
+            jlink_serial: JLINK serial number (or serial number/unique id of the OpenOCD/pyOCD probe).
             srv_addr: Server address.
-            launch: Whether or not to launch the GDB server process.
+            srv_port: Server port (only used for servers not launched by DOTT).
+            block: If False, the launched GDB server process is not waited for (see GdbServer.wait_ready).
         Returns:
             The created GdbServer instance.
         """
-        from dottmi.gdb import GdbServerJLink
+        from dottmi.gdb import GdbServerJLink, GdbServerOpenOCD, GdbServerPyOCD, GdbServerQemu, GdbServerRenode
 
         if srv_port == -1:
             srv_port = int(DottConf.conf['gdb_server_port'])
@@ -132,9 +140,57 @@ class Dott(object):
         if srv_addr is None:
             srv_addr = DottConf.conf['gdb_server_addr']
 
+        port_reservation = None
         if srv_addr is None:
             # if gdb server is launched by DOTT, we determine the port ourselves
-            srv_port = self._get_next_srv_port('127.0.0.1')
+            port_reservation = self._reserve_srv_ports('127.0.0.1')
+            srv_port = port_reservation.port
+
+        if DottConf.conf['gdb_server_type'] == 'qemu':
+            return GdbServerQemu(DottConf.conf['gdb_server_binary'],
+                                 srv_addr,
+                                 srv_port,
+                                 dev_name,
+                                 DottConf.conf['qemu_machine'],
+                                 DottConf.conf['qemu_args'],
+                                 DottConf.conf['reset_snapshot'],
+                                 block,
+                                 port_reservation)
+
+        if DottConf.conf['gdb_server_type'] == 'renode':
+            return GdbServerRenode(DottConf.conf['gdb_server_binary'],
+                                   srv_addr,
+                                   srv_port,
+                                   dev_name,
+                                   DottConf.conf['renode_platform'],
+                                   block,
+                                   port_reservation)
+
+        jlink_speed = DottConf.conf['jlink_speed']
+        if jlink_speed == 'auto':
+            jlink_speed = self._tuned_jlink_speed(dev_name, jlink_serial, srv_addr)
+
+        if DottConf.conf['gdb_server_type'] == 'openocd':
+            return GdbServerOpenOCD(DottConf.conf['gdb_server_binary'],
+                                    srv_addr,
+                                    srv_port,
+                                    dev_name,
+                                    DottConf.conf['openocd_cfg'],
+                                    jlink_speed,
+                                    jlink_serial,
+                                    block,
+                                    port_reservation)
+
+        if DottConf.conf['gdb_server_type'] == 'pyocd':
+            return GdbServerPyOCD(DottConf.conf['gdb_server_binary'],
+                                  srv_addr,
+                                  srv_port,
+                                  DottConf.conf['pyocd_target'],
+                                  jlink_speed,
+                                  jlink_serial,
+                                  block,
+                                  port_reservation,
+                                  DottConf.conf.get('attach_only', False))
 
         gdb_server = GdbServerJLink(DottConf.conf['gdb_server_binary'],
                                     srv_addr,
@@ -142,43 +198,306 @@ class Dott(object):
                                     dev_name,
                                     DottConf.conf['jlink_interface'],
                                     DottConf.conf['device_endianess'],
-                                    DottConf.conf['jlink_speed'],
+                                    jlink_speed,
                                     jlink_serial,
-                                    DottConf.conf['jlink_server_addr'])
+                                    DottConf.conf['jlink_server_addr'],
+                                    block,
+                                    port_reservation,
+                                    DottConf.conf.get('gdb_server_persistent', False),
+                                    DottConf.conf.get('flash_state_dir') or tempfile.gettempdir(),
+                                    DottConf.conf.get('attach_only', False))
 
         return gdb_server
 
+    @staticmethod
+    def _tuned_jlink_speed(dev_name: str, jlink_serial: str, srv_addr: str) -> str:
+        # jlink_speed=auto: fastest reliable speed of the board (measured once per board, see dottmi.probe_speed)
+        from dottmi.probe_speed import ProbeSpeedCache, tuned_speed
+
+        if srv_addr is not None:
+            log.warn('jlink_speed=auto requires a GDB server launched by DOTT. Using 15000 kHz.')
+            return '15000'
+        if jlink_serial is None:
+            jlink_serial = DottConf.conf['jlink_serial']
+        jlink_ip_addr = DottConf.conf['jlink_server_addr']
+        jlink_addr_port = f'{jlink_ip_addr}:{DottConf.conf["jlink_server_port"]}' if jlink_ip_addr is not None else None
+        cache = ProbeSpeedCache(DottConf.conf['flash_state_dir'] or tempfile.gettempdir())
+        return tuned_speed(cache, dev_name, jlink_serial, DottConf.conf['jlink_interface'],
+                           DottConf.conf['jlink_speed_tune_region'], jlink_addr_port)
+
     def create_target(self, dev_name: str, jlink_serial: str = None) -> 'Target':
+        return self.create_targets([(dev_name, jlink_serial)])[0]
+
+    def create_targets(self, targets: List[Tuple[str, str]], process: bool = None) -> List['Target']:
+        """
+        Creates several targets at once. The GDB servers and GDB clients of all targets are started first and are
+        then waited for together such that the startup time is determined by the slowest target instead of the sum
+        of all targets.
+
+        Args:
+            targets: List of (device name, JLINK serial number) tuples.
+            process: If True, each target is hosted in a worker process of its own and a TargetProxy is returned for
+                     it (see dottmi.target_process; default: target_process in dott.ini).
+        Returns:
+            The created targets (None for targets whose GDB server could not be reached).
+        """
         from dottmi import target
+
+        if process is None:
+            process = DottConf.conf['target_process']
+        if process:
+            from dottmi.target_process import TargetProxy
+            proxies = TargetProxy.start(targets, DottConf.conf)
+            self._all_targets.extend(proxies)
+            return proxies
+
+        if DottConf.conf['gdb_replay_file'] is not None:
+            return self._create_replay_targets(targets)
+        if DottConf.conf['dott_agent_addr'] is not None:
+            return self._create_agent_targets(targets)
+
+        res = []
+        for gdb_server, gdb_client in self._launch_gdb(targets):
+            try:
+                # create target instance and set GDB server address
+                tgt = target.Target(gdb_server, gdb_client)
+            except TimeoutError:
+                tgt = None
+
+            # add target to list of created targets to enable proper cleanup on shutdown
+            if tgt:
+                self._all_targets.append(tgt)
+            res.append(tgt)
+        return res
+
+    def _launch_gdb(self, targets: List[Tuple[str, str]]) -> List[Tuple['GdbServer', 'GdbClient']]:
+        # launches GDB server and GDB client of the given targets (see create_targets)
         from dottmi.gdb import GdbClient
 
         srv_addr = DottConf.conf['gdb_server_addr']
 
+        gdb_servers = [self.create_gdb_server(dev_name, jlink_serial, srv_addr=srv_addr, block=False)
+                       for dev_name, jlink_serial in targets]
         try:
-            gdb_server = self.create_gdb_server(dev_name, jlink_serial, srv_addr=srv_addr)
+            # start GDB Clients (while the GDB servers are still starting up)
+            gdb_clients = []
+            for _ in targets:
+                gdb_client = GdbClient(DottConf.conf['gdb_client_binary'], DottConf.conf['gdb_broker_addr'])
+                gdb_client.connect()
+                self._setup_gdb_client(gdb_client)
+                gdb_clients.append(gdb_client)
+            for gdb_server in gdb_servers:
+                gdb_server.wait_ready()
+        except Exception:
+            for gdb_server in gdb_servers:
+                gdb_server.shutdown()
+            raise
+        return list(zip(gdb_servers, gdb_clients))
+
+    def _session_file(self, file_name: str, idx: int = None) -> str:
+        # the first GDB session uses the configured file name; further sessions (targets) get an index suffix
+        if idx is None:
+            idx = self._num_sessions
+            self._num_sessions += 1
+        if idx == 0:
+            return file_name
+        stem, ext = os.path.splitext(file_name)
+        return f'{stem}.{idx}{ext}'
+
+    def _setup_gdb_client(self, gdb_client: 'GdbClient') -> None:
+        gdb_client.gdb_mi.stats.enabled = DottConf.conf['gdb_mi_stats']
+        if DottConf.conf['gdb_record_file'] is not None:
+            gdb_client.gdb_mi.start_recording(self._session_file(DottConf.conf['gdb_record_file']))
+        if DottConf.conf['gdb_console_file'] is not None:
+            gdb_client.gdb_mi.capture_console(self._session_file(DottConf.conf['gdb_console_file'],
+                                                                 self._num_console_files))
+            self._num_console_files += 1
+        # note: with a DOTT agent, GDB runs on the agent's host and the directory refers to that host's file system
+        if DottConf.conf['gdb_index_cache'] is not None:
+            index_dir = DottConf.conf['gdb_index_cache'].replace('\\', '/')
+            try:
+                gdb_client.gdb_mi.write_blocking(f'-interpreter-exec console "set index-cache directory {index_dir}"')
+                try:
+                    gdb_client.gdb_mi.write_blocking('-interpreter-exec console "set index-cache enabled on"')
+                except Exception:
+                    gdb_client.gdb_mi.write_blocking('-interpreter-exec console "set index-cache on"')  # GDB < 13
+            except Exception as ex:
+                log.warn(f'GDB index cache could not be enabled ({ex}).')
 
-            # start GDB Client
-            gdb_client = GdbClient(DottConf.conf['gdb_client_binary'])
+    def _create_replay_targets(self, targets: List[Tuple[str, str]]) -> List['Target']:
+        # targets of a replayed session (see dottmi.gdb_replay); neither GDB nor a GDB server is started
+        from dottmi import target
+        from dottmi.gdb import GdbClientReplay, GdbServerQuirks, GdbServerReplay
+
+        quirks = {'jlink': GdbServerQuirks.segger, 'openocd': GdbServerQuirks.openocd,
+                  'pyocd': GdbServerQuirks.pyocd, 'qemu': GdbServerQuirks.qemu,
+                  'renode': GdbServerQuirks.renode}[DottConf.conf['gdb_server_type']]()
+        res = []
+        for dev_name, jlink_serial in targets:
+            gdb_client = GdbClientReplay(self._session_file(DottConf.conf['gdb_replay_file']))
             gdb_client.connect()
+            gdb_client.gdb_mi.stats.enabled = DottConf.conf['gdb_mi_stats']
+            tgt = target.Target(GdbServerReplay(dev_name, jlink_serial, quirks), gdb_client)
+            self._all_targets.append(tgt)
+            res.append(tgt)
+        return res
 
-            # create target instance and set GDB server address
-            target = target.Target(gdb_server, gdb_client)
+    def recover_target(self, tgt: 'Target') -> None:
+        """
+        Re-establishes the connection of a target whose connection to GDB or the GDB server has been lost (see
+        Target.check_health). A new GDB server and a new GDB client are started for the target's board and the target
+        is reconnected (see Target.recover). The target binary has to be loaded again afterwards.
 
-        except TimeoutError:
-            target = None
+        Args:
+            tgt: The target to be recovered.
+        """
+        from dottmi.gdb import GdbClient, GdbServerJLink
+
+        dev_name, jlink_serial = tgt.device_name, tgt.serial_number
+        if isinstance(tgt.gdb_server, GdbServerJLink):
+            tgt.gdb_server.terminate()  # note: a persistent server would otherwise be reused
+        log.warn(f'Recovering connection to target {dev_name}' +
+                 ('...' if jlink_serial is None else f' (SN: {jlink_serial})...'))
+        if DottConf.conf['dott_agent_addr'] is not None:
+            gdb_server = self._open_agent_target(dev_name, jlink_serial)
+            gdb_client = GdbClient(DottConf.conf['gdb_client_binary'], agent=gdb_server.agent)
+            gdb_client.connect()
+            self._setup_gdb_client(gdb_client)
+        else:
+            gdb_server, gdb_client = self._launch_gdb([(dev_name, jlink_serial)])[0]
+        tgt.recover(gdb_server, gdb_client)
 
-        # add target to list of created targets to enable proper cleanup on shutdown
-        if target:
-            self._all_targets.append(target)
-        return target
+    @staticmethod
+    def _open_agent_target(dev_name: str, jlink_serial: str) -> 'GdbServerAgent':
+        from dottmi.agent import AgentClient
+        from dottmi.gdb import GdbServerAgent
+
+        jlink_speed = DottConf.conf['jlink_speed']
+        if jlink_speed == 'auto':
+            # note: the probe is attached to the agent's host; speed tuning is only supported for local probes
+            log.warn('jlink_speed=auto is not supported for boards attached to a DOTT agent. Using 15000 kHz.')
+            jlink_speed = '15000'
+        agent = AgentClient(DottConf.conf['dott_agent_addr'])
+        try:
+            port = agent.open_target(dev_name, jlink_serial, DottConf.conf['jlink_interface'],
+                                     DottConf.conf['device_endianess'], jlink_speed)
+        except Exception:
+            agent.close()
+            raise
+        return GdbServerAgent(agent, port, dev_name, jlink_serial)
+
+    def _create_agent_targets(self, targets: List[Tuple[str, str]]) -> List['Target']:
+        # targets provided by a DOTT agent (see dottmi.agent); the agent launches the GDB servers in parallel
+        from concurrent.futures import ThreadPoolExecutor
+        from dottmi import target
+        from dottmi.gdb import GdbClient
+
+        with ThreadPoolExecutor(max_workers=max(1, len(targets))) as executor:
+            futures = [executor.submit(self._open_agent_target, dev_name, jlink_serial)
+                       for dev_name, jlink_serial in targets]
+        gdb_servers = []
+        try:
+            for future in futures:
+                gdb_servers.append(future.result())
+        except Exception:
+            for future in futures:
+                if future.exception() is None:
+                    future.result().shutdown()
+            raise
+
+        res = []
+        for gdb_server in gdb_servers:
+            gdb_client = GdbClient(DottConf.conf['gdb_client_binary'], agent=gdb_server.agent)
+            gdb_client.connect()
+            self._setup_gdb_client(gdb_client)
+            try:
+                tgt = target.Target(gdb_server, gdb_client)
+            except TimeoutError:
+                tgt = None
+            if tgt:
+                self._all_targets.append(tgt)
+            res.append(tgt)
+        return res
 
     @property
     def target(self):
+        """
+        The current target of the calling thread (see use_target) or, if none is set, the default target. Halt points,
+        intercept points and fixtures created without an explicit target use this target.
+        """
+        current = getattr(self._current, 'target', None)
+        if current is not None:
+            return current
+        return self.default_target
+
+    @property
+    def default_target(self):
+        """
+        The default target. It is created on first access (i.e., not if the test session only collects tests). While
+        collecting tests (pytest --collect-only) no target is created and None is returned.
+        """
+        if self._default_target_pending:
+            if DottConf.conf.get('collect_only', False):
+                log.debug('Default target not created (test collection only).')
+                return None
+            # Hook called before the first debugger connection is made
+            DottHooks.exec_pre_connect_hook()
+            # note: the default target is used by the fixtures in the test process (see target_process)
+            self._default_target = self.create_targets([(DottConf.conf['device_name'],
+                                                         DottConf.conf['jlink_serial'])], process=False)[0]
+            self._default_target_pending = False
         return self._default_target
 
+    @property
+    def target_created(self) -> bool:
+        """
+        True if the default target has been created (accessing target would not create it).
+        """
+        return not self._default_target_pending
+
     @target.setter
     def target(self, target: object):
-        raise ValueError('Target can not be set directly.')
+        raise ValueError('Target can not be set directly. Use use_target instead.')
+
+    @contextmanager
+    def use_target(self, target: object) -> Iterator[object]:
+        """
+        Makes the given target the current target of the calling thread for the duration of the with statement, i.e.,
+        test code which uses dott().target (directly or via the default target argument of breakpoints and helpers)
+        operates on the given target. For example:
+            with dott().use_target(targets[1]):
+                bp = HaltPoint('app_Process')  # created for targets[1]
+                dott().target.cont()
+
+        Note: The current target is local to the thread; threads started within the with statement use the default
+        target unless they set a current target themselves (see run_parallel).
+        """
+        prev = getattr(self._current, 'target', None)
+        self._current.target = target
+        try:
+            yield target
+        finally:
+            self._current.target = prev
+
+    def run_parallel(self, targets: List[object], func: Callable[..., Any], *args, **kwargs) -> List[Any]:
+        """
+        Calls func(*args, **kwargs) once per target, concurrently in one thread per target, with the target set as the
+        thread's current target (see use_target). Returns the results in the order of the targets once all calls have
+        completed; the exception of the first failing call (in target order) is re-raised. For example:
+            def flash_and_check():
+                dott().target.load('build/app.elf', 'build/app.elf')
+                assert dott().target.eval('app_version') == 3
+            dott().run_parallel(dott().create_targets(boards), flash_and_check)
+        """
+        def run(target: object) -> Any:
+            with self.use_target(target):
+                return func(*args, **kwargs)
+
+        if len(targets) == 0:
+            return []
+        with ThreadPoolExecutor(max_workers=len(targets), thread_name_prefix='DottTarget') as executor:
+            futures = [executor.submit(run, t) for t in targets]
+        return [f.result() for f in futures]
 
     def shutdown(self) -> None:
         for t in self._all_targets:
@@ -198,6 +517,7 @@ def dott() -> Dott:
 class DottConf:
     conf = {}
     dott_runtime = None
+    _jlink_libs_cache: Dict[str, Dict[int, str]] = {}
 
     @staticmethod
     def set(key: str, val: str) -> None:
@@ -229,11 +549,12 @@ class DottConf:
                         break
                     line = f.readline()
             os.environ['DOTTGDBPATH'] = str(Path(f'{dott_runtime_path}/apps/gdb/bin'))
-            os.environ['PYTHONPATH27'] = str(Path(f'{dott_runtime_path}/apps/python27/python-2.7.13'))
+            # note: an already set PYTHONPATH27 (an empty one selects a GDB with embedded Python 3) is kept
+            os.environ.setdefault('PYTHONPATH27', str(Path(f'{dott_runtime_path}/apps/python27/python-2.7.13')))
             DottConf.set('DOTTRUNTIME', f'{dott_runtime_path} (dott-runtime package)')
             DottConf.set('DOTT_RUNTIME_VER', runtime_version)
             DottConf.set('DOTTGDBPATH', str(Path(f'{dott_runtime_path}/apps/gdb/bin')))
-            DottConf.set('PYTHONPATH27', str(Path(f'{dott_runtime_path}/apps/python27/python-2.7.13')))
+            DottConf.set('PYTHONPATH27', os.environ['PYTHONPATH27'])
 
             # Linux: check if libpython2.7 and libnurses5 are installed. Windows: They are included in the DOTT runtime.
             if platform.system() == 'Linux':
@@ -261,9 +582,41 @@ class DottConf:
             raise Exception('Runtime components neither found in DOTT data path nor in DOTTRUNTIME folder.')
 
     @staticmethod
-    def _get_jlink_path(segger_paths: List[str], segger_lib_name: str, jlink_gdb_server_binary: str) -> Tuple[str, str, str]:
-        all_libs = {}
+    def _jlink_search_signature(segger_paths: List[str]) -> List:
+        # note: installing or removing a J-Link software version modifies (the mtime of) its parent folder
+        sig = []
+        for search_path in segger_paths:
+            try:
+                sig.append([search_path, os.stat(search_path).st_mtime])
+            except OSError:
+                sig.append([search_path, None])
+        return sig
+
+    @staticmethod
+    def _find_jlink_libs(segger_paths: List[str], segger_lib_name: str, jlink_gdb_server_binary: str) -> Dict[int, str]:
+        """
+        Returns the J-Link libraries (version -> path) found in the given search paths. Searching recursively and
+        loading each library to query its version is slow (esp. on Windows). Hence, the result is cached in-process
+        and in a file in the temp directory which is valid as long as the search paths and libraries are unmodified.
+        """
+        key = json.dumps([segger_paths, segger_lib_name, jlink_gdb_server_binary])
+        if key in DottConf._jlink_libs_cache:
+            return DottConf._jlink_libs_cache[key]
 
+        signature = DottConf._jlink_search_signature(segger_paths)
+        cache_file = os.path.join(tempfile.gettempdir(), 'dott_jlink_cache.json')
+        try:
+            with open(cache_file, 'r') as f:
+                entry = json.load(f).get(key)
+            if entry is not None and entry['signature'] == signature and \
+                    all(os.path.exists(lib) and os.stat(lib).st_mtime == mtime for lib, mtime in entry['libs'].values()):
+                all_libs = {int(ver): lib for ver, (lib, _) in entry['libs'].items()}
+                DottConf._jlink_libs_cache[key] = all_libs
+                return all_libs
+        except (OSError, ValueError, KeyError, TypeError, AttributeError):
+            pass
+
+        all_libs = {}
         for search_path in segger_paths:
             libs = glob.glob(os.path.join(search_path, '**', segger_lib_name), recursive=True)
 
@@ -281,6 +634,27 @@ class DottConf:
                 ver = clib.JLINKARM_GetDLLVersion()
                 all_libs[ver] = lib
 
+        DottConf._jlink_libs_cache[key] = all_libs
+        try:
+            try:
+                with open(cache_file, 'r') as f:
+                    cache = json.load(f)
+            except (OSError, ValueError):
+                cache = {}
+            cache[key] = {'signature': signature,
+                          'libs': {str(ver): [lib, os.stat(lib).st_mtime] for ver, lib in all_libs.items()}}
+            tmp_file = f'{cache_file}.{os.getpid()}.tmp'
+            with open(tmp_file, 'w') as f:
+                json.dump(cache, f)
+            os.replace(tmp_file, cache_file)
+        except OSError as ex:
+            log.debug(f'Unable to write J-Link cache file {cache_file} ({ex}).')
+        return all_libs
+
+    @staticmethod
+    def _get_jlink_path(segger_paths: List[str], segger_lib_name: str, jlink_gdb_server_binary: str) -> Tuple[str, str, str]:
+        all_libs = DottConf._find_jlink_libs(segger_paths, segger_lib_name, jlink_gdb_server_binary)
+
         jlink_path: str = ''
         jlink_version: str = '0'
         if len(all_libs) > 0:
@@ -344,11 +718,38 @@ class DottConf:
             log.info(f'No dott.ini found in working directory.')
             conf_tmp = {}
 
+        # the DOTTJLINKSERIAL and DOTTGDBSRVPORT environment variables override the ini file (used, e.g., by the farm
+        # runner to bind each of its worker processes to a different board)
+        if os.environ.get('DOTTJLINKSERIAL', '').strip() != '':
+            DottConf.conf['jlink_serial'] = os.environ['DOTTJLINKSERIAL'].strip()
+        if os.environ.get('DOTTGDBSRVPORT', '').strip() != '':
+            DottConf.conf['gdb_server_port'] = os.environ['DOTTGDBSRVPORT'].strip()
+        # DOTTBENCHRESULTS overrides the benchmark results file (used by the benchmark variant comparison runner)
+        if os.environ.get('DOTTBENCHRESULTS', '').strip() != '':
+            DottConf.conf['bench_results_file'] = os.environ['DOTTBENCHRESULTS'].strip()
+
         # only copy items from ini to in-memory config which are not already present (i.e., set programmatically)
         for k, v in conf_tmp.items():
             if k not in DottConf.conf.keys():
                 DottConf.conf[k] = v
 
+        # pytest-xdist workers (PYTEST_XDIST_WORKER=gw<n>) are bound to the n-th board of jlink_serials and use their
+        # own GDB server port range (unless DOTTJLINKSERIAL is set); their result files get the worker name as suffix
+        xdist_worker = os.environ.get('PYTEST_XDIST_WORKER', '').strip()
+        DottConf.conf['xdist_worker'] = xdist_worker if xdist_worker != '' else None
+        if xdist_worker != '':
+            log.info(f'pytest-xdist worker:   {xdist_worker}')
+        serials = [s.strip() for s in str(DottConf.conf.get('jlink_serials') or '').split(',') if s.strip() != '']
+        if xdist_worker.startswith('gw') and len(serials) > 0 and os.environ.get('DOTTJLINKSERIAL', '').strip() == '':
+            from dottmi.farm import PORT_STRIDE
+            idx = int(xdist_worker[2:])
+            if idx >= len(serials):
+                raise ValueError(f'No board for pytest-xdist worker {xdist_worker} (jlink_serials in {dott_ini} lists '
+                                 f'{len(serials)} boards). Run with at most -n {len(serials)}.')
+            DottConf.conf['jlink_serial'] = serials[idx]
+            base_port = int(str(DottConf.conf.get('gdb_server_port') or '2331').strip() or '2331')
+            DottConf.conf['gdb_server_port'] = str(base_port + idx * PORT_STRIDE)
+
         # Go through the individual config options and set reasonable defaults
         # where they are missing (or return an error)
 
@@ -399,8 +800,59 @@ class DottConf:
                 raise ValueError(f'device_endianess in {dott_ini} should be either "little" or "big".')
         log.info(f'Device endianess:      {DottConf.conf["device_endianess"]}')
 
-        # determine J-Link path and version
-        jlink_path, jlink_lib_name, jlink_version = DottConf._get_jlink_path(jlink_default_path, jlink_lib_name, jlink_gdb_server_binary)
+        if 'svd_file' not in DottConf.conf or DottConf.conf['svd_file'] is None or \
+                DottConf.conf['svd_file'].strip() == '':
+            DottConf.conf['svd_file'] = None
+        else:
+            DottConf.conf['svd_file'] = DottConf.conf['svd_file'].strip()
+            if not os.path.exists(DottConf.conf['svd_file']):
+                raise ValueError(f'{DottConf.conf["svd_file"]} (svd_file) does not exist.')
+            log.info(f'SVD file:              {DottConf.conf["svd_file"]}')
+
+        if 'gdb_server_type' not in DottConf.conf or DottConf.conf['gdb_server_type'].strip() == '':
+            DottConf.conf['gdb_server_type'] = 'jlink'
+        DottConf.conf['gdb_server_type'] = DottConf.conf['gdb_server_type'].strip().lower()
+        if DottConf.conf['gdb_server_type'] not in ('jlink', 'openocd', 'pyocd', 'qemu', 'renode'):
+            raise ValueError(f'gdb_server_type in {dott_ini} should be "jlink", "openocd", "pyocd", "qemu" or '
+                             f'"renode".')
+        log.info(f'GDB server type:       {DottConf.conf["gdb_server_type"]}')
+
+        if DottConf.conf['gdb_server_type'] == 'openocd':
+            if 'openocd_cfg' not in DottConf.conf or DottConf.conf['openocd_cfg'].strip() == '':
+                raise ValueError(f'openocd_cfg not set in {dott_ini} (required for gdb_server_type openocd).')
+            DottConf.conf['openocd_cfg'] = [f.strip() for f in DottConf.conf['openocd_cfg'].split(',')]
+            for cfg_file in DottConf.conf['openocd_cfg']:
+                if not os.path.exists(cfg_file):
+                    raise ValueError(f'OpenOCD configuration file {cfg_file} does not exist.')
+            log.info(f'OpenOCD config:        {", ".join(DottConf.conf["openocd_cfg"])}')
+
+        if DottConf.conf['gdb_server_type'] == 'pyocd':
+            if 'pyocd_target' not in DottConf.conf or DottConf.conf['pyocd_target'].strip() == '':
+                DottConf.conf['pyocd_target'] = DottConf.conf['device_name'].lower()
+            log.info(f'pyOCD target:          {DottConf.conf["pyocd_target"]}')
+
+        if DottConf.conf['gdb_server_type'] == 'qemu':
+            if 'qemu_machine' not in DottConf.conf or str(DottConf.conf['qemu_machine'] or '').strip() == '':
+                raise ValueError(f'qemu_machine not set in {dott_ini} (required for gdb_server_type qemu).')
+            DottConf.conf['qemu_machine'] = DottConf.conf['qemu_machine'].strip()
+            DottConf.conf['qemu_args'] = str(DottConf.conf.get('qemu_args') or '').split()
+            log.info(f'QEMU machine:          {DottConf.conf["qemu_machine"]} {" ".join(DottConf.conf["qemu_args"])}')
+
+        if DottConf.conf['gdb_server_type'] == 'renode':
+            if 'renode_platform' not in DottConf.conf or str(DottConf.conf['renode_platform'] or '').strip() == '':
+                raise ValueError(f'renode_platform not set in {dott_ini} (required for gdb_server_type renode).')
+            DottConf.conf['renode_platform'] = DottConf.conf['renode_platform'].strip()
+            log.info(f'Renode platform:       {DottConf.conf["renode_platform"]}')
+
+        # determine J-Link path and version (J-Link software is optional for OpenOCD/pyOCD, for boards attached to a
+        # DOTT agent and for replayed sessions; it is only needed, e.g., for local live access)
+        try:
+            jlink_path, jlink_lib_name, jlink_version = DottConf._get_jlink_path(jlink_default_path, jlink_lib_name, jlink_gdb_server_binary)
+        except DottException:
+            if DottConf.conf['gdb_server_type'] == 'jlink' and (DottConf.conf.get('dott_agent_addr') or '').strip() == '' \
+                    and (DottConf.conf.get('gdb_replay_file') or '').strip() == '':
+                raise
+            jlink_path, jlink_version = '', None
         DottConf.conf["jlink_path"] = jlink_path
         DottConf.conf["jlink_lib_name"] = jlink_lib_name
         DottConf.conf["jlink_version"] = jlink_version
@@ -413,10 +865,45 @@ class DottConf:
             DottConf.conf['jlink_interface'] = 'SWD'
         log.info(f'J-LINK interface:      {DottConf.conf["jlink_interface"]}')
 
-        if 'jlink_speed' not in DottConf.conf:
+        if 'jlink_speed' not in DottConf.conf or str(DottConf.conf['jlink_speed']).strip() == '':
             DottConf.conf['jlink_speed'] = '15000'
+        DottConf.conf['jlink_speed'] = str(DottConf.conf['jlink_speed']).strip().lower()
         log.info(f'J-LINK speed (set):    {DottConf.conf["jlink_speed"]}')
 
+        # speed auto-tuning (see dottmi.probe_speed); the memory region is only read
+        speed_tune_region: Tuple[int, int] = (0x0, 0x1000)
+        if str(DottConf.conf.get('jlink_speed_tune_region') or '').strip() != '':
+            try:
+                start, size = str(DottConf.conf['jlink_speed_tune_region']).split(':')
+                speed_tune_region = (int(start, 0), int(size, 0))
+            except ValueError:
+                raise ValueError(f'jlink_speed_tune_region in {dott_ini} should be a <start>:<size> memory '
+                                 f'region.') from None
+        DottConf.conf['jlink_speed_tune_region'] = speed_tune_region
+        if DottConf.conf['jlink_speed'] == 'auto' and DottConf.conf['gdb_server_type'] != 'jlink':
+            raise ValueError(f'jlink_speed=auto ({dott_ini}) is only supported for gdb_server_type jlink.')
+
+        # per-phase interface speeds (see Target.clock_phase); None keeps the launch speed during the phase
+        for phase in ('bulk', 'safe'):
+            key = f'jlink_speed_{phase}'
+            if str(DottConf.conf.get(key) or '').strip() == '':
+                DottConf.conf[key] = None
+                continue
+            try:
+                DottConf.conf[key] = int(str(DottConf.conf[key]).strip(), 0)
+            except ValueError:
+                raise ValueError(f'{key} in {dott_ini} should be an interface speed in kHz.') from None
+            log.info(f'{"J-LINK speed (" + phase + "):":<22} {DottConf.conf[key]}')
+
+        # tuning of GDB's memory packet sizes at connect time (see dottmi.probe_speed.PacketSizeTuner)
+        if 'gdb_packet_tune' not in DottConf.conf or DottConf.conf['gdb_packet_tune'] is None:
+            DottConf.conf['gdb_packet_tune'] = False
+        elif not isinstance(DottConf.conf['gdb_packet_tune'], bool):
+            DottConf.conf['gdb_packet_tune'] = \
+                str(DottConf.conf['gdb_packet_tune']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['gdb_packet_tune']:
+            log.info('GDB packet tuning:     yes')
+
         if 'jlink_serial' not in DottConf.conf:
             DottConf.conf['jlink_serial'] = None
         elif DottConf.conf['jlink_serial'] is not None and DottConf.conf['jlink_serial'].strip() == '':
@@ -437,6 +924,15 @@ class DottConf:
             DottConf.conf['gdb_server_addr'] = DottConf.conf['gdb_server_addr'].strip()
         log.info(f'GDB server address:    {DottConf.conf["gdb_server_addr"]}')
 
+        # link latency (milliseconds) to a remote GDB server above which transfers are batched (see Target.link_rtt)
+        remote_rtt_threshold: float = 5.0  # 0 disables the measurement
+        if DottConf.conf.get('remote_rtt_threshold') is not None:
+            if str(DottConf.conf['remote_rtt_threshold']).strip() != '':
+                remote_rtt_threshold = float(str(DottConf.conf['remote_rtt_threshold']))
+        DottConf.conf['remote_rtt_threshold'] = remote_rtt_threshold
+        if DottConf.conf['gdb_server_addr'] is not None:
+            log.info(f'Remote RTT threshold:  {remote_rtt_threshold}ms')
+
         if 'gdb_server_port' not in DottConf.conf or DottConf.conf['gdb_server_port'] is None:
             DottConf.conf['gdb_server_port'] = '2331'
         elif DottConf.conf['gdb_server_port'].strip() == '':
@@ -456,12 +952,120 @@ class DottConf:
             DottConf.conf['jlink_server_port'] = '19020'
         if DottConf.conf["jlink_server_port"] != '19020':
             log.info(f'JLINK server port:     {DottConf.conf["jlink_server_port"]}')
-        if DottConf.conf['gdb_server_addr'] is None:
+        if 'gdb_server_persistent' not in DottConf.conf or DottConf.conf['gdb_server_persistent'] is None:
+            DottConf.conf['gdb_server_persistent'] = False
+        elif not isinstance(DottConf.conf['gdb_server_persistent'], bool):
+            DottConf.conf['gdb_server_persistent'] = \
+                str(DottConf.conf['gdb_server_persistent']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['gdb_server_persistent']:
+            log.info('GDB server persistent: yes (J-Link GDB servers are kept running across sessions)')
+        if 'dott_agent_addr' not in DottConf.conf or DottConf.conf['dott_agent_addr'].strip() == '':
+            DottConf.conf['dott_agent_addr'] = None
+        else:
+            DottConf.conf['dott_agent_addr'] = DottConf.conf['dott_agent_addr'].strip()
+            log.info(f'DOTT agent address:    {DottConf.conf["dott_agent_addr"]}')
+
+        # shared-memory intercept point channel (see ShmChannel); its rings rely on the store order of x86 hosts
+        if 'bp_channel_shm' not in DottConf.conf or DottConf.conf['bp_channel_shm'] is None:
+            DottConf.conf['bp_channel_shm'] = False
+        elif not isinstance(DottConf.conf['bp_channel_shm'], bool):
+            bp_channel_shm = str(DottConf.conf['bp_channel_shm']).strip().lower()
+            DottConf.conf['bp_channel_shm'] = bp_channel_shm in ('yes', 'true', '1')
+        if DottConf.conf['bp_channel_shm']:
+            if os.name != 'posix' or platform.machine().lower() not in ('x86_64', 'amd64', 'i386', 'i686'):
+                log.warn('bp_channel_shm is only supported on POSIX hosts with x86 CPUs. Using a socket.')
+                DottConf.conf['bp_channel_shm'] = False
+            else:
+                log.info('Intercept channel:     shared memory')
+
+        # host each target created with Dott.create_targets in a worker process (see dottmi.target_process)
+        if 'target_process' not in DottConf.conf or DottConf.conf['target_process'] is None:
+            DottConf.conf['target_process'] = False
+        elif not isinstance(DottConf.conf['target_process'], bool):
+            target_process = str(DottConf.conf['target_process']).strip().lower()
+            DottConf.conf['target_process'] = target_process in ('yes', 'true', '1')
+        if DottConf.conf['target_process']:
+            log.info('Target processes:      enabled')
+
+        # record and replay of GDB sessions (see dottmi.gdb_replay) and capture of GDB's console output
+        for key in ('gdb_record_file', 'gdb_replay_file', 'gdb_console_file'):
+            if DottConf.conf.get(key) is None or str(DottConf.conf[key]).strip() == '':
+                DottConf.conf[key] = None
+            else:
+                DottConf.conf[key] = str(DottConf.conf[key]).strip()
+        if DottConf.conf['gdb_record_file'] is not None and DottConf.conf['gdb_replay_file'] is not None:
+            raise ValueError(f'gdb_record_file and gdb_replay_file ({dott_ini}) can not be used at the same time.')
+        if DottConf.conf['gdb_record_file'] is not None:
+            log.info(f'GDB session record:    {DottConf.conf["gdb_record_file"]}')
+        if DottConf.conf['gdb_console_file'] is not None:
+            log.info(f'GDB console capture:   {DottConf.conf["gdb_console_file"]}')
+
+        # directory in which GDB caches the symbol indices of the ELF files it loads (see GDB's index-cache)
+        if DottConf.conf.get('gdb_index_cache') is None or str(DottConf.conf['gdb_index_cache']).strip() == '':
+            DottConf.conf['gdb_index_cache'] = None
+        else:
+            DottConf.conf['gdb_index_cache'] = os.path.abspath(str(DottConf.conf['gdb_index_cache']).strip())
+            log.info(f'GDB index cache:       {DottConf.conf["gdb_index_cache"]}')
+
+        # target description and memory map recorded per board instead of being fetched on each connect
+        if 'gdb_tdesc_cache' not in DottConf.conf or DottConf.conf['gdb_tdesc_cache'] is None:
+            DottConf.conf['gdb_tdesc_cache'] = False
+        elif not isinstance(DottConf.conf['gdb_tdesc_cache'], bool):
+            DottConf.conf['gdb_tdesc_cache'] = \
+                str(DottConf.conf['gdb_tdesc_cache']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['gdb_tdesc_cache']:
+            log.info('GDB tdesc cache:       yes')
+
+        # GDB data cache for the memory regions of the loaded image (see Target.load)
+        if 'gdb_mem_cache' not in DottConf.conf or DottConf.conf['gdb_mem_cache'] is None:
+            DottConf.conf['gdb_mem_cache'] = False
+        elif not isinstance(DottConf.conf['gdb_mem_cache'], bool):
+            DottConf.conf['gdb_mem_cache'] = \
+                str(DottConf.conf['gdb_mem_cache']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['gdb_mem_cache']:
+            log.info('GDB memory cache:      yes')
+
+        # GDB non-stop mode: the cores of a multi-core target are halted and resumed independently (see add_core)
+        if 'gdb_non_stop' not in DottConf.conf or DottConf.conf['gdb_non_stop'] is None:
+            DottConf.conf['gdb_non_stop'] = False
+        elif not isinstance(DottConf.conf['gdb_non_stop'], bool):
+            DottConf.conf['gdb_non_stop'] = \
+                str(DottConf.conf['gdb_non_stop']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['gdb_non_stop']:
+            log.info('GDB non-stop mode:     yes')
+
+        # attach only: the GDB server connects without halting (or resetting) the target; GDB attaches in non-stop
+        # mode such that the target keeps running (see Target.gdb_client_connect)
+        if 'attach_only' not in DottConf.conf or DottConf.conf['attach_only'] is None:
+            DottConf.conf['attach_only'] = False
+        elif not isinstance(DottConf.conf['attach_only'], bool):
+            DottConf.conf['attach_only'] = \
+                str(DottConf.conf['attach_only']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['attach_only']:
+            log.info('Attach only:           yes (target is neither halted nor reset on connect)')
+
+        if DottConf.conf['gdb_replay_file'] is not None:
+            if not os.path.exists(DottConf.conf['gdb_replay_file']):
+                raise ValueError(f'GDB session log {DottConf.conf["gdb_replay_file"]} ({dott_ini}) not found.')
+            log.info(f'GDB session replay:    {DottConf.conf["gdb_replay_file"]} (no GDB server is started)')
+            DottConf.conf['gdb_server_binary'] = None
+        elif DottConf.conf['dott_agent_addr'] is not None:
+            log.info('GDB server launched by DOTT agent.')
+            DottConf.conf['gdb_server_binary'] = None
+        elif DottConf.conf['gdb_server_addr'] is None:
             # no (remote) GDB server address given. try to find a local GDB server binary to launch instead
 
             if 'gdb_server_binary' in DottConf.conf:
                 if not os.path.exists(DottConf.conf['gdb_server_binary']):
                     raise Exception(f'GDB server binary {DottConf.conf["gdb_server_binary"]} ({dott_ini}) not found!')
+            elif DottConf.conf['gdb_server_type'] != 'jlink':
+                # OpenOCD, pyOCD and the emulators are expected to be in PATH
+                srv_name = {'qemu': 'qemu-system-arm'}.get(DottConf.conf['gdb_server_type'],
+                                                           DottConf.conf['gdb_server_type'])
+                srv_binary = shutil.which(srv_name)
+                if srv_binary is None:
+                    raise Exception(f'GDB server binary {srv_name} not found! Checked {dott_ini} and PATH. Giving up.')
+                DottConf.conf['gdb_server_binary'] = srv_binary
             elif os.path.exists(jlink_path):
                 DottConf.conf['gdb_server_binary'] = str(Path(f'{jlink_path}/{jlink_gdb_server_binary}'))
             else:
@@ -479,6 +1083,260 @@ class DottConf:
             log.info('GDB server assumed to be already running (not started by DOTT).')
             DottConf.conf['gdb_server_binary'] = None
 
+        if 'gdb_mi_stats_file' not in DottConf.conf or DottConf.conf['gdb_mi_stats_file'] is None:
+            DottConf.conf['gdb_mi_stats_file'] = None
+        elif DottConf.conf['gdb_mi_stats_file'].strip() == '':
+            DottConf.conf['gdb_mi_stats_file'] = None
+
+        if 'gdb_mi_stats' not in DottConf.conf or DottConf.conf['gdb_mi_stats'] is None:
+            DottConf.conf['gdb_mi_stats'] = False
+        elif not isinstance(DottConf.conf['gdb_mi_stats'], bool):
+            DottConf.conf['gdb_mi_stats'] = str(DottConf.conf['gdb_mi_stats']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['gdb_mi_stats_file'] is not None:
+            DottConf.conf['gdb_mi_stats'] = True
+        if DottConf.conf['gdb_mi_stats']:
+            log.info(f'GDB MI stats:          enabled (file: {DottConf.conf["gdb_mi_stats_file"]})')
+
+        if 'timeline_file' not in DottConf.conf or DottConf.conf['timeline_file'] is None:
+            DottConf.conf['timeline_file'] = None
+        elif DottConf.conf['timeline_file'].strip() == '':
+            DottConf.conf['timeline_file'] = None
+        if DottConf.conf['timeline_file'] is not None:
+            log.info(f'Timeline file:         {DottConf.conf["timeline_file"]}')
+            timeline.start()
+
+        hw_breakpoints: int = 4  # Cortex-M0 FPB
+        if 'hw_breakpoints' in DottConf.conf and DottConf.conf['hw_breakpoints'] is not None:
+            if str(DottConf.conf['hw_breakpoints']).strip() != '':
+                hw_breakpoints = int(DottConf.conf['hw_breakpoints'])
+        DottConf.conf['hw_breakpoints'] = hw_breakpoints
+        log.info(f'HW breakpoints:        {DottConf.conf["hw_breakpoints"]}')
+
+        # connection health monitoring and recovery (see Target.check_health)
+        health_check_interval: float = 1.0  # seconds; 0 disables the background monitor
+        if DottConf.conf.get('health_check_interval') is not None:
+            if str(DottConf.conf['health_check_interval']).strip() != '':
+                health_check_interval = float(str(DottConf.conf['health_check_interval']))
+        DottConf.conf['health_check_interval'] = health_check_interval
+        if 'health_auto_recover' not in DottConf.conf or DottConf.conf['health_auto_recover'] is None:
+            DottConf.conf['health_auto_recover'] = True
+        elif not isinstance(DottConf.conf['health_auto_recover'], bool):
+            DottConf.conf['health_auto_recover'] = \
+                str(DottConf.conf['health_auto_recover']).strip().lower() in ('yes', 'true', '1')
+        log.info(f'Health check interval: {health_check_interval}s (auto recover: '
+                 f'{"enabled" if DottConf.conf["health_auto_recover"] else "disabled"})')
+
+        if 'gdb_broker_addr' not in DottConf.conf or DottConf.conf['gdb_broker_addr'] is None:
+            DottConf.conf['gdb_broker_addr'] = None
+        elif DottConf.conf['gdb_broker_addr'].strip() == '':
+            DottConf.conf['gdb_broker_addr'] = None
+        else:
+            DottConf.conf['gdb_broker_addr'] = DottConf.conf['gdb_broker_addr'].strip()
+            log.info(f'GDB broker address:    {DottConf.conf["gdb_broker_addr"]}')
+
+        if 'type_cache_dir' not in DottConf.conf or DottConf.conf['type_cache_dir'] is None:
+            DottConf.conf['type_cache_dir'] = None
+        elif DottConf.conf['type_cache_dir'].strip() == '':
+            DottConf.conf['type_cache_dir'] = None
+        else:
+            DottConf.conf['type_cache_dir'] = DottConf.conf['type_cache_dir'].strip()
+            log.info(f'Type cache directory:  {DottConf.conf["type_cache_dir"]}')
+
+        if 'flash_download_mode' not in DottConf.conf or str(DottConf.conf['flash_download_mode']).strip() == '':
+            DottConf.conf['flash_download_mode'] = 'full'
+        else:
+            DottConf.conf['flash_download_mode'] = str(DottConf.conf['flash_download_mode']).strip().lower()
+            if DottConf.conf['flash_download_mode'] not in ('full', 'incremental'):
+                raise ValueError(f'flash_download_mode in {dott_ini} should be either "full" or "incremental".')
+        log.info(f'Flash download mode:   {DottConf.conf["flash_download_mode"]}')
+
+        flash_sector_size: int = 2048
+        if 'flash_sector_size' in DottConf.conf and DottConf.conf['flash_sector_size'] is not None:
+            if str(DottConf.conf['flash_sector_size']).strip() != '':
+                flash_sector_size = int(str(DottConf.conf['flash_sector_size']), 0)
+        DottConf.conf['flash_sector_size'] = flash_sector_size
+        if DottConf.conf['flash_download_mode'] == 'incremental':
+            log.info(f'Flash sector size:     {DottConf.conf["flash_sector_size"]}')
+
+        if 'flash_skip_identical' not in DottConf.conf or DottConf.conf['flash_skip_identical'] is None:
+            DottConf.conf['flash_skip_identical'] = False
+        elif not isinstance(DottConf.conf['flash_skip_identical'], bool):
+            DottConf.conf['flash_skip_identical'] = \
+                str(DottConf.conf['flash_skip_identical']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['flash_skip_identical']:
+            log.info('Flash skip identical:  enabled')
+
+        if 'sram_fast_reload' not in DottConf.conf or DottConf.conf['sram_fast_reload'] is None:
+            DottConf.conf['sram_fast_reload'] = False
+        elif not isinstance(DottConf.conf['sram_fast_reload'], bool):
+            DottConf.conf['sram_fast_reload'] = \
+                str(DottConf.conf['sram_fast_reload']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['sram_fast_reload']:
+            log.info('SRAM fast reload:      enabled')
+
+        if 'flash_state_dir' not in DottConf.conf or DottConf.conf['flash_state_dir'] is None:
+            DottConf.conf['flash_state_dir'] = None
+        elif DottConf.conf['flash_state_dir'].strip() == '':
+            DottConf.conf['flash_state_dir'] = None
+        else:
+            DottConf.conf['flash_state_dir'] = DottConf.conf['flash_state_dir'].strip()
+            log.info(f'Flash state directory: {DottConf.conf["flash_state_dir"]}')
+
+        if 'flash_loader_elf' not in DottConf.conf or DottConf.conf['flash_loader_elf'] is None or \
+                DottConf.conf['flash_loader_elf'].strip() == '':
+            DottConf.conf['flash_loader_elf'] = None
+        else:
+            DottConf.conf['flash_loader_elf'] = DottConf.conf['flash_loader_elf'].strip()
+            if not os.path.exists(DottConf.conf['flash_loader_elf']):
+                raise ValueError(f'Flash loader ELF {DottConf.conf["flash_loader_elf"]} (flash_loader_elf) not found.')
+            log.info(f'Flash loader ELF:      {DottConf.conf["flash_loader_elf"]}')
+
+        if 'flash_loader_live' not in DottConf.conf or DottConf.conf['flash_loader_live'] is None:
+            DottConf.conf['flash_loader_live'] = False
+        elif not isinstance(DottConf.conf['flash_loader_live'], bool):
+            DottConf.conf['flash_loader_live'] = \
+                str(DottConf.conf['flash_loader_live']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['flash_loader_elf'] is not None and DottConf.conf['flash_loader_live']:
+            log.info('Flash loader mode:     live (double buffering)')
+
+        for key in ('bench_results_file', 'bench_baseline_file'):
+            if key not in DottConf.conf or DottConf.conf[key] is None or DottConf.conf[key].strip() == '':
+                DottConf.conf[key] = None
+            else:
+                DottConf.conf[key] = DottConf.conf[key].strip()
+        if DottConf.conf['bench_results_file'] is not None:
+            log.info(f'Benchmark results:     {DottConf.conf["bench_results_file"]}')
+        if DottConf.conf['bench_baseline_file'] is not None:
+            log.info(f'Benchmark baseline:    {DottConf.conf["bench_baseline_file"]}')
+
+        bench_tolerance: float = 5.0  # percent
+        if 'bench_tolerance' in DottConf.conf and DottConf.conf['bench_tolerance'] is not None:
+            if str(DottConf.conf['bench_tolerance']).strip() != '':
+                bench_tolerance = float(str(DottConf.conf['bench_tolerance']))
+        DottConf.conf['bench_tolerance'] = bench_tolerance / 100.0
+
+        bench_stack_bytes = str(DottConf.conf.get('bench_stack_bytes') or '').strip()
+        DottConf.conf['bench_stack_bytes'] = int(bench_stack_bytes, 0) if bench_stack_bytes != '' else None
+        if DottConf.conf['bench_stack_bytes'] is not None:
+            log.info(f'Benchmark stack:       {DottConf.conf["bench_stack_bytes"]} bytes painted')
+
+        perf_history_file = str(DottConf.conf.get('perf_history_file') or '').strip()
+        DottConf.conf['perf_history_file'] = perf_history_file if perf_history_file != '' else None
+        if DottConf.conf['perf_history_file'] is not None:
+            log.info(f'Performance history:   {DottConf.conf["perf_history_file"]}')
+
+        if DottConf.conf.get('swo_cpu_speed') is None or str(DottConf.conf['swo_cpu_speed']).strip() == '':
+            DottConf.conf['swo_cpu_speed'] = None
+        else:
+            DottConf.conf['swo_cpu_speed'] = int(str(DottConf.conf['swo_cpu_speed']), 0)
+            log.info(f'SWO CPU speed:         {DottConf.conf["swo_cpu_speed"]}')
+
+        if DottConf.conf.get('swo_speed') is None or str(DottConf.conf['swo_speed']).strip() == '':
+            DottConf.conf['swo_speed'] = None
+        else:
+            DottConf.conf['swo_speed'] = int(str(DottConf.conf['swo_speed']), 0)
+            log.info(f'SWO speed:             {DottConf.conf["swo_speed"]}')
+
+        if 'swo_pc_sampling' not in DottConf.conf or DottConf.conf['swo_pc_sampling'] is None:
+            DottConf.conf['swo_pc_sampling'] = False
+        elif not isinstance(DottConf.conf['swo_pc_sampling'], bool):
+            DottConf.conf['swo_pc_sampling'] = \
+                str(DottConf.conf['swo_pc_sampling']).strip().lower() in ('yes', 'true', '1')
+
+        # UART capture (see uart_capture fixture)
+        uart_port = str(DottConf.conf.get('uart_port') or '').strip()
+        DottConf.conf['uart_port'] = uart_port if uart_port != '' else None
+        if DottConf.conf.get('uart_baudrate') is None or str(DottConf.conf['uart_baudrate']).strip() == '':
+            DottConf.conf['uart_baudrate'] = 115200
+        else:
+            DottConf.conf['uart_baudrate'] = int(str(DottConf.conf['uart_baudrate']), 0)
+        if DottConf.conf['uart_port'] is not None:
+            log.info(f'UART capture:          {DottConf.conf["uart_port"]} ({DottConf.conf["uart_baudrate"]} baud)')
+
+        # coverage collection by breakpoint sweeping (see CoverageCollector)
+        coverage = str(DottConf.conf.get('coverage') or 'no').strip().lower()
+        if coverage in ('', 'no', 'false', '0', 'off'):
+            DottConf.conf['coverage'] = None
+        elif coverage in ('function', 'line'):
+            DottConf.conf['coverage'] = coverage
+            log.info(f'Coverage:              {coverage}')
+        else:
+            raise ValueError(f'coverage in {dott_ini} should be one of no, function or line.')
+        if DottConf.conf.get('coverage_file') is None or DottConf.conf['coverage_file'].strip() == '':
+            DottConf.conf['coverage_file'] = 'dott_coverage.info'
+        else:
+            DottConf.conf['coverage_file'] = DottConf.conf['coverage_file'].strip()
+        if DottConf.conf.get('coverage_bp_budget') is None or str(DottConf.conf['coverage_bp_budget']).strip() == '':
+            DottConf.conf['coverage_bp_budget'] = None
+        else:
+            DottConf.conf['coverage_bp_budget'] = int(str(DottConf.conf['coverage_bp_budget']), 0)
+
+        # RAM regions (start:size) captured and restored by the warm reset (see target_reset_common)
+        warm_reset_ram: List[Tuple[int, int]] = None
+        if 'warm_reset_ram' in DottConf.conf and DottConf.conf['warm_reset_ram'] is not None:
+            if str(DottConf.conf['warm_reset_ram']).strip() != '':
+                try:
+                    warm_reset_ram = [(int(r.split(':')[0], 0), int(r.split(':')[1], 0))
+                                      for r in str(DottConf.conf['warm_reset_ram']).split(',')]
+                except (ValueError, IndexError):
+                    raise ValueError(f'warm_reset_ram in {dott_ini} should be a comma-separated list of '
+                                     f'<start>:<size> memory regions.') from None
+                log.info(f'Warm reset RAM:        {", ".join(f"0x{a:x}:0x{n:x}" for a, n in warm_reset_ram)}')
+        DottConf.conf['warm_reset_ram'] = warm_reset_ram
+
+        # warm reset of emulated targets by machine snapshots (see GdbServerQemu)
+        if 'reset_snapshot' not in DottConf.conf or DottConf.conf['reset_snapshot'] is None:
+            DottConf.conf['reset_snapshot'] = False
+        elif not isinstance(DottConf.conf['reset_snapshot'], bool):
+            DottConf.conf['reset_snapshot'] = \
+                str(DottConf.conf['reset_snapshot']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['reset_snapshot']:
+            log.info('Reset snapshot:        yes')
+
+        # stack high-water mark measurement per test (see StackMonitor); the stack region (start:size) defaults to
+        # the stack symbols of the application
+        if not isinstance(DottConf.conf.get('stack_watch'), bool):
+            DottConf.conf['stack_watch'] = str(DottConf.conf.get('stack_watch') or 'no').strip().lower() in \
+                                           ('yes', 'true', '1')
+        stack_region: Tuple[int, int] = None
+        if str(DottConf.conf.get('stack_region') or '').strip() != '':
+            try:
+                start, size = str(DottConf.conf['stack_region']).split(':')
+                stack_region = (int(start, 0), int(size, 0))
+            except ValueError:
+                raise ValueError(f'stack_region in {dott_ini} should be a <start>:<size> memory region.') from None
+        DottConf.conf['stack_region'] = stack_region
+        if DottConf.conf['stack_watch']:
+            log.info(f'Stack watch:           '
+                     f'{"0x%x:0x%x" % stack_region if stack_region is not None else "region from symbols"}')
+
+        # heap instrumentation (see HeapTrace): no, yes (leaks are reported) or strict (tests with leaks fail)
+        heap_trace = str(DottConf.conf.get('heap_trace') or 'no').strip().lower()
+        if heap_trace in ('', 'no', 'false', '0', 'off'):
+            DottConf.conf['heap_trace'] = None
+        elif heap_trace in ('yes', 'true', '1', 'on', 'strict'):
+            DottConf.conf['heap_trace'] = 'strict' if heap_trace == 'strict' else 'yes'
+            log.info(f'Heap trace:            {DottConf.conf["heap_trace"]}')
+        else:
+            raise ValueError(f'heap_trace in {dott_ini} should be one of no, yes or strict.')
+
+        # deferred firmware log (DOTT_LOG, see DeferredLog) drained after each test and added to the test report
+        if 'firmware_log' not in DottConf.conf or DottConf.conf['firmware_log'] is None:
+            DottConf.conf['firmware_log'] = False
+        elif not isinstance(DottConf.conf['firmware_log'], bool):
+            DottConf.conf['firmware_log'] = str(DottConf.conf['firmware_log']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['firmware_log']:
+            log.info('Firmware log:          yes')
+
+        # compressed memory writes via the on-target batch executor (see TargetMem._write_compressed)
+        if 'mem_write_compress' not in DottConf.conf or DottConf.conf['mem_write_compress'] is None:
+            DottConf.conf['mem_write_compress'] = False
+        elif not isinstance(DottConf.conf['mem_write_compress'], bool):
+            DottConf.conf['mem_write_compress'] = \
+                str(DottConf.conf['mem_write_compress']).strip().lower() in ('yes', 'true', '1')
+        if DottConf.conf['mem_write_compress']:
+            log.info('Compressed mem writes: yes')
+
         default_mem_model: TargetMemModel = TargetMemModel.TESTHOOK
         if 'on_target_mem_model' not in DottConf.conf:
             DottConf.conf['on_target_mem_model'] = default_mem_model
@@ -523,3 +1381,10 @@ class DottConf:
                  f'total stack: {on_target_mem_prestack_total_stack_size if on_target_mem_prestack_total_stack_size is not None else "unknown"})')
         else:
             log.info(f'Std. target mem model for DOTT default fixtures:  {DottConf.conf["on_target_mem_model"]}')
+
+        if DottConf.conf['xdist_worker'] is not None:
+            for key in ('bench_results_file', 'coverage_file', 'gdb_console_file', 'gdb_mi_stats_file',
+                        'gdb_record_file', 'gdb_replay_file', 'timeline_file'):
+                if DottConf.conf.get(key) is not None:
+                    stem, ext = os.path.splitext(DottConf.conf[key])
+                    DottConf.conf[key] = f'{stem}.{DottConf.conf["xdist_worker"]}{ext}'
@@ -21,3 +21,16 @@
 class DottException(Exception):
     pass
 
+
+
+class DottConnectionError(DottException):
+    # raised if the connection to GDB or the GDB server has been lost (see Target.check_health)
+    pass
+
+
+class TargetFaultException(DottException):
+    # raised if the target halted in DOTT's fault hook (DOTT_fault_hook in testhelpers.c); info holds the saved
+    # exception frame and fault status registers (see DOTT_fault_info_t) or None if they could not be read
+    def __init__(self, msg: str, info: dict = None) -> None:
+        super().__init__(msg)
+        self.info = info
@@ -0,0 +1,147 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Shared host-side access to ELF files. Instead of reading an ELF file into memory in full (debug builds with DWARF
+# information easily exceed 100 MB), the file is memory-mapped while it is parsed; only the pages touched by the
+# parser (headers, symbol and string tables, the requested section contents) are read from disk. The parse results
+# (section headers, symbol index, build-id, ...) are computed lazily, on first use, and cached per file. All targets
+# and host modules of a process which use the same ELF file share these results (ElfFile.open returns the same
+# instance as long as the file is unchanged). For example:
+#
+#   elf = ElfFile.open('build/app.elf')
+#   syms = elf.symbols  # parsed once per process
+#   data = elf.read(sec_offset, num_bytes)
+#
+# Note: The file is only mapped while it is being parsed, i.e., no mapping is held between the calls; hence, the
+# ELF file can be rebuilt (and overwritten by the linker, also on Windows) while a DOTT session is running. A rebuilt
+# file (different modification time or size) results in a new instance.
+
+import hashlib
+import mmap
+import os
+import threading
+from contextlib import contextmanager
+from typing import Any, Callable, Dict, Iterator, List, Tuple, Union
+
+
+# -------------------------------------------------------------------------------------------------
+class ElfFile(object):
+    """
+    Lazily parsed, memory-mapped ELF file shared within the process (see module description).
+    """
+    _files: Dict[str, 'ElfFile'] = {}
+    _files_lock: threading.Lock = threading.Lock()
+
+    def __init__(self, file_name: str, version: Tuple[int, int]) -> None:
+        self._file_name: str = file_name
+        self._version: Tuple[int, int] = version  # modification time (ns) and size of the parsed file
+        self._lock: threading.RLock = threading.RLock()
+        self._results: Dict[str, Any] = {}
+
+    @staticmethod
+    def open(file_name: str) -> 'ElfFile':
+        """
+        Returns the (shared) instance for the given ELF file. An OSError is raised if the file cannot be accessed.
+        """
+        path = os.path.abspath(file_name)
+        st = os.stat(path)
+        version = (st.st_mtime_ns, st.st_size)
+        with ElfFile._files_lock:
+            elf = ElfFile._files.get(path)
+            if elf is None or elf._version != version:
+                elf = ElfFile(path, version)
+                ElfFile._files[path] = elf
+            return elf
+
+    @property
+    def file_name(self) -> str:
+        return self._file_name
+
+    @property
+    def size(self) -> int:
+        return self._version[1]
+
+    @contextmanager
+    def mapped(self) -> Iterator[Union[mmap.mmap, bytes]]:
+        """
+        Context manager which provides the content of the file as read-only memory map (supports slicing, indexing
+        and struct.unpack_from like bytes). The mapping is closed at the end of the with statement.
+        """
+        with open(self._file_name, 'rb') as f:
+            if self._version[1] == 0:
+                yield b''  # note: empty files cannot be mapped
+                return
+            data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+            try:
+                yield data
+            finally:
+                data.close()
+
+    def parsed(self, name: str, parse: Callable[[Union[mmap.mmap, bytes]], Any]) -> Any:
+        """
+        Returns the result of the given parser (called with the mapped content of the file) which is computed once
+        per file and cached under the given name. Callers must not modify the returned result.
+        """
+        with self._lock:
+            if name not in self._results:
+                with self.mapped() as data:
+                    self._results[name] = parse(data)
+            return self._results[name]
+
+    def read(self, offset: int, num_bytes: int) -> bytes:
+        """
+        Returns num_bytes of the file starting at the given file offset.
+        """
+        with open(self._file_name, 'rb') as f:
+            f.seek(offset)
+            return f.read(num_bytes)
+
+    @property
+    def is_elf(self) -> bool:
+        return self.parsed('is_elf', lambda data: data[:4] == b'\x7fELF')
+
+    @property
+    def sections(self) -> Tuple[str, int, List[Tuple], List[str]]:
+        """
+        Byte order, machine, section headers and section names (see BinarySymbols.elf_sections).
+        """
+        from dottmi.symbols import BinarySymbols
+        return self.parsed('sections', BinarySymbols.elf_sections)
+
+    @property
+    def symbols(self) -> Dict[str, Dict]:
+        """
+        Symbol index of the file (see BinarySymbols).
+        """
+        from dottmi.symbols import BinarySymbols
+        return self.parsed('symbols', BinarySymbols._elf_symbols)
+
+    @property
+    def key(self) -> str:
+        """
+        GNU build-id of the file as hex string or the SHA-1 hash of the file if it has no build-id (see
+        TypeCache.elf_key).
+        """
+        from dottmi.type_cache import TypeCache
+
+        def elf_key(data) -> str:
+            build_id = TypeCache._elf_build_id(data)
+            return build_id if build_id is not None else 'sha1_' + hashlib.sha1(data).hexdigest()
+        return self.parsed('key', elf_key)
@@ -0,0 +1,212 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Test farm runner which distributes a pytest session across all boards (J-Link probes) attached to the host. The
+# tests are collected once and sharded across one worker process per board. Each worker is a regular DOTT pytest
+# session whose default target is bound to its board (DOTTJLINKSERIAL) and which uses its own GDB server port range
+# (DOTTGDBSRVPORT). Shards are balanced using the test durations of previous runs (longest tests first, each assigned
+# to the least loaded board); tests without recorded duration are assumed to take the median duration. The durations
+# measured by the workers are merged into the durations file after the run.
+# This module also serves as pytest plugin of the workers (loaded with -p dottmi.farm): it restricts the session to
+# the tests of the worker's shard (DOTTFARMTESTS) and records the test durations (DOTTFARMREPORT).
+# Alternatively, pytest-xdist may distribute the tests (pytest -n <boards>, see jlink_serials in dott.ini).
+# With --flash, the given ELF is programmed to all boards concurrently (see flash_broadcast.py) before the workers
+# are started; boards which fail to be programmed (or verified) are excluded from the run.
+#
+# Usage: python -m dottmi.farm [--serials <sn>,<sn>,...] [--durations <file>] [--port-base <port>] [--flash <elf>]
+#                              [pytest args]
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from typing import Dict, List
+
+# default file which holds the test durations of previous runs
+DEFAULT_DURATIONS_FILE = '.dott_farm_durations.json'
+
+# difference of the GDB server base ports of two workers (each GDB server occupies three consecutive ports)
+PORT_STRIDE = 100
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+# pytest plugin (worker side)
+_durations: Dict[str, float] = {}
+
+
+def pytest_collection_modifyitems(session, config, items) -> None:
+    tests_file = os.environ.get('DOTTFARMTESTS')
+    if tests_file is None:
+        return
+    with open(tests_file, 'r') as f:
+        shard = {line.strip() for line in f if line.strip() != ''}
+    selected = [item for item in items if item.nodeid in shard]
+    deselected = [item for item in items if item.nodeid not in shard]
+    if len(deselected) > 0:
+        config.hook.pytest_deselected(items=deselected)
+    items[:] = selected
+
+
+def pytest_runtest_logreport(report) -> None:
+    # note: setup, call and teardown durations are accumulated (fixture overhead is part of the test's cost)
+    _durations[report.nodeid] = _durations.get(report.nodeid, 0.0) + report.duration
+
+
+def pytest_sessionfinish(session, exitstatus) -> None:
+    report_file = os.environ.get('DOTTFARMREPORT')
+    if report_file is not None:
+        with open(report_file, 'w') as f:
+            json.dump(_durations, f)
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+# farm runner
+def discover_serials() -> List[str]:
+    """
+    Returns the serial numbers of all J-Link probes attached via USB.
+    """
+    import pylink
+    lib = None
+    if 'DOTTJLINKPATH' in os.environ:
+        lib_name = 'libjlinkarm.so' if sys.platform.startswith('linux') else 'JLink_x64.dll'
+        lib = pylink.library.Library(dllpath=os.path.join(os.environ['DOTTJLINKPATH'], lib_name))
+    jlink = pylink.JLink(lib=lib)
+    return [str(emu.SerialNumber) for emu in jlink.connected_emulators(pylink.enums.JLinkHost.USB)]
+
+
+def collect_tests(pytest_args: List[str]) -> List[str]:
+    """
+    Returns the node ids of the tests selected by the given pytest arguments (in collection order).
+    """
+    res = subprocess.run([sys.executable, '-m', 'pytest', '--collect-only', '-q', '-p', 'no:cacheprovider'] +
+                         pytest_args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    nodeids = [line.strip() for line in res.stdout.splitlines() if '::' in line and not line.startswith(' ')]
+    if len(nodeids) == 0:
+        print(res.stdout)
+    return nodeids
+
+
+def load_durations(file_name: str) -> Dict[str, float]:
+    try:
+        with open(file_name, 'r') as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+
+def shard(nodeids: List[str], durations: Dict[str, float], num_shards: int) -> List[List[str]]:
+    """
+    Distributes the tests across num_shards shards such that the expected durations of the shards are balanced
+    (longest processing time first). Within a shard, tests keep their collection order such that module and class
+    scoped fixtures are shared by consecutive tests.
+    """
+    known = [durations[n] for n in nodeids if n in durations]
+    default = statistics.median(known) if len(known) > 0 else 1.0
+    order = {nodeid: i for i, nodeid in enumerate(nodeids)}
+
+    loads = [0.0] * num_shards
+    shards: List[List[str]] = [[] for _ in range(num_shards)]
+    for nodeid in sorted(nodeids, key=lambda n: durations.get(n, default), reverse=True):
+        idx = loads.index(min(loads))
+        shards[idx].append(nodeid)
+        loads[idx] += durations.get(nodeid, default)
+    return [sorted(s, key=lambda n: order[n]) for s in shards]
+
+
+def flash_boards(serials: List[str], elf: str) -> List[str]:
+    """
+    Programs the given ELF to all boards (broadcast) and returns the serial numbers of the boards which succeeded.
+    """
+    from dottmi.dott import DottConf, dott
+    from dottmi.flash_broadcast import broadcast_load
+
+    targets = dott().create_targets([(DottConf.conf['device_name'], serial) for serial in serials])
+    try:
+        res = broadcast_load([t for t in targets if t is not None], elf,
+                             progress=lambda serial, stage: print(f'Board {serial}: flash {stage}'))
+    finally:
+        dott().shutdown()  # note: the probes are used by the workers afterwards
+    print(str(res))
+    return [b.serial for b in res.boards if b.ok]
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Runs a DOTT pytest session sharded across all attached boards.')
+    parser.add_argument('--serials', default=None, help='comma-separated J-Link serials (default: all attached)')
+    parser.add_argument('--durations', default=DEFAULT_DURATIONS_FILE, help='file with the durations of previous runs')
+    parser.add_argument('--port-base', type=int, default=2331, help='GDB server port of the first worker')
+    parser.add_argument('--flash', default=None, help='ELF file to be programmed to all boards before the run')
+    args, pytest_args = parser.parse_known_args()
+
+    serials = args.serials.split(',') if args.serials is not None else discover_serials()
+    if len(serials) == 0:
+        sys.exit('No boards (J-Link probes) found.')
+    if args.flash is not None:
+        serials = flash_boards(serials, args.flash)
+        if len(serials) == 0:
+            sys.exit(f'Programming {args.flash} failed on all boards.')
+    nodeids = collect_tests(pytest_args)
+    if len(nodeids) == 0:
+        sys.exit('No tests collected.')
+    durations = load_durations(args.durations)
+    shards = shard(nodeids, durations, len(serials))
+
+    tmp_dir = tempfile.mkdtemp(prefix='dott_farm_')
+    workers = []
+    time_start = time.time()
+    for idx, (serial, tests) in enumerate(zip(serials, shards)):
+        if len(tests) == 0:
+            continue
+        tests_file = os.path.join(tmp_dir, f'tests_{serial}.txt')
+        with open(tests_file, 'w') as f:
+            f.write('\n'.join(tests) + '\n')
+        env = dict(os.environ, DOTTJLINKSERIAL=serial, DOTTGDBSRVPORT=str(args.port_base + idx * PORT_STRIDE),
+                   DOTTFARMTESTS=tests_file, DOTTFARMREPORT=os.path.join(tmp_dir, f'durations_{serial}.json'))
+        log_file = open(f'dott_farm_{serial}.log', 'w')
+        proc = subprocess.Popen([sys.executable, '-m', 'pytest', '-p', 'dottmi.farm'] + pytest_args, env=env,
+                                stdout=log_file, stderr=subprocess.STDOUT)
+        expected = sum(durations.get(n, 0.0) for n in tests)
+        print(f'Board {serial}: {len(tests)} tests (expected duration: {expected:.0f}s), log: {log_file.name}')
+        workers.append((serial, proc, log_file, env['DOTTFARMREPORT']))
+
+    exit_code = 0
+    for serial, proc, log_file, report_file in workers:
+        ret = proc.wait()
+        log_file.close()
+        durations.update(load_durations(report_file))
+        print(f'Board {serial}: finished with exit code {ret}.')
+        if ret not in (0, 5):  # note: 5 means that no tests were collected
+            exit_code = ret if exit_code == 0 else exit_code
+
+    try:
+        with open(args.durations, 'w') as f:
+            json.dump(durations, f, indent=1, sort_keys=True)
+    except OSError as ex:
+        print(f'Unable to write durations file {args.durations} ({ex}).')
+    print(f'{len(nodeids)} tests on {len(workers)} boards took {time.time() - time_start:.1f}s.')
+    sys.exit(exit_code)
+
+
+if __name__ == '__main__':
+    main()
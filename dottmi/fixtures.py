@@ -18,18 +18,128 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import contextlib
+import time
 import traceback
 import types
-from typing import Dict
+from typing import Dict, List, Tuple
 
 import pytest
 
+from dottmi.bench import BenchRecorder, BenchResult
+from dottmi.budget import CycleCounter, PerfBudget
 from dottmi.breakpoint import HaltPoint, InterceptPoint
+from dottmi.coverage import CoverageCollector
+from dottmi.deferred_log import DeferredLog
 from dottmi.dott import DottConf, dott
-from dottmi.dottexceptions import DottException
+from dottmi.dottexceptions import DottConnectionError, DottException
+from dottmi.gdb_mi import GdbMiStats
+from dottmi.heap import HeapTrace
+from dottmi.perf_history import PerfHistory
+from dottmi.profiler import PcProfiler
 from dottmi.pylinkdott import TargetDirect
-from dottmi.target_mem import TargetMemModel, TargetMemTestHook, TargetMem, TargetMemNoAlloc
+from dottmi.stack import StackMonitor
+from dottmi.stub import FunctionStub
+from dottmi.target_mem import TargetMemModel, TargetMemTestHook, TargetMem, TargetMemNoAlloc, TargetMemSection
+from dottmi.timeline import timeline
+from dottmi.type_cache import TypeCache
+from dottmi.uart import UartCapture
 from dottmi.utils import log
+from dottmi.watch import WatchService
+
+# target states captured at the initial halt location of the memory models (see warm_reset_ram)
+_warm_reset_states: Dict[Tuple, Tuple] = {}
+
+# coverage of the test session (if enabled, see CoverageCollector)
+_coverage: CoverageCollector = None
+
+# (name, load to flash) of the last download to the default target; repeated after recovering its connection
+_last_load: Tuple[str, bool] = None
+
+# stack of the default target painted by the target_reset_xxx fixtures and peak usage per test (see stack_watch)
+_stack_monitor: StackMonitor = None
+_stack_peaks: Dict[str, int] = {}
+
+# heap trace of the default target started by the target_reset_xxx fixtures (see heap_trace)
+_heap_trace: HeapTrace = None
+
+# deferred firmware log (DOTT_LOG) of the default target drained after each test (see firmware_log)
+_firmware_log: DeferredLog = None
+
+# cycle counter of the default target started by the target_reset_xxx fixtures for tests with a cycles budget
+_cycle_counter: CycleCounter = None
+
+# performance results of the session ((test or benchmark key, metric) -> samples) added to perf_history_file
+_perf_results: Dict[Tuple[str, str], List[float]] = {}
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class FixtureProfile(object):
+    """
+    Records the time spent in the phases of DOTT's fixtures (download, reset, bp clear, run-to-main, mem init, ...).
+    The phases of each test (including session-scoped fixtures set up for the test) are attached to the test's JUnit
+    XML properties (dott_fixture_<phase>_s) and a summary of the session is logged at the end of the session. The
+    phases are also added to the timeline (if recorded).
+    """
+    def __init__(self) -> None:
+        self._totals: Dict[str, List] = {}  # phase -> [count, total seconds, max seconds]
+        self._test: Dict[str, float] = {}  # phase -> seconds since the previous test's teardown
+        self._session_start: float = time.perf_counter()
+
+    @contextlib.contextmanager
+    def phase(self, name: str):
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            end = time.perf_counter()
+            self.add(name, end - start)
+            timeline.complete(name, 'fixture', start, end)
+
+    def add(self, name: str, secs: float) -> None:
+        total = self._totals.setdefault(name, [0, 0.0, 0.0])
+        total[0] += 1
+        total[1] += secs
+        total[2] = max(total[2], secs)
+        self._test[name] = self._test.get(name, 0.0) + secs
+
+    def take_test(self) -> Dict[str, float]:
+        """
+        Returns the time per phase recorded since the previous call (i.e., for the current test) and starts over.
+        """
+        res, self._test = self._test, {}
+        return res
+
+    def totals(self) -> Dict[str, float]:
+        return {name: total[1] for name, total in self._totals.items()}
+
+    def total(self) -> float:
+        return sum(t[1] for t in self._totals.values())
+
+    def summary(self) -> str:
+        session = time.perf_counter() - self._session_start
+        lines = [f'DOTT fixture time: {self.total():.2f}s of {session:.2f}s session time',
+                 f'  {"phase":<14}{"count":>7}{"total[s]":>10}{"mean[ms]":>10}{"max[ms]":>10}{"share":>8}']
+        for name, (count, total, max_secs) in sorted(self._totals.items(), key=lambda i: i[1][1], reverse=True):
+            lines.append(f'  {name:<14}{count:>7}{total:>10.2f}{total / count * 1000:>10.1f}{max_secs * 1000:>10.1f}'
+                         f'{total / session * 100 if session > 0 else 0:>7.1f}%')
+        return '\n'.join(lines)
+
+
+# time spent in the fixture phases of the test session
+_fixture_profile: FixtureProfile = FixtureProfile()
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+def _target_image_outdated(dt: 'Target', load_elf: str, load_to_flash: bool, silent: bool) -> bool:
+    # checks if the image has to be downloaded (i.e., it is not already on the target, see flash_skip_identical)
+    if not load_to_flash or not DottConf.get('flash_skip_identical'):
+        return True
+    if dt.flash_image_matches(load_elf):
+        if not silent:
+            log.info(f'Target already holds {load_elf}. Skipping download.')
+        return False
+    return True
 
 
 # ----------------------------------------------------------------------------------------------------------------------
@@ -39,29 +149,60 @@ def target_load_common(name: str, load_to_flash: bool, silent: bool = False, dt:
         log.error('Connection to target (via JLINK) was not properly established. Please check your JLINK parameters!')
         pytest.exit('Aborting test execution.')
 
+    global _last_load
+    if dt is dott().target:
+        _last_load = (name, load_to_flash)
+
+    with _fixture_profile.phase('download'):
+        _target_load(dt, name, load_to_flash, silent)
+
+
+def _target_load(dt: 'Target', name: str, load_to_flash: bool, silent: bool) -> None:
     try:
         if not silent:
             log.info(f'Triggering download of APP to {name}...')
 
-        # optionally load bootloader binary (load elf ONLY - symbols are loaded after the app)
         bl_load_elf = DottConf.get('bl_load_elf')
-        if bl_load_elf is not None:
-            dt.load(bl_load_elf, None, enable_flash=load_to_flash)
-
-        # load application binaries
         app_load_elf = DottConf.get('app_load_elf')
         app_symbol_elf = DottConf.get('app_symbol_elf')
-        if app_load_elf is not None:
-            dt.load(app_load_elf, app_symbol_elf, enable_flash=load_to_flash)
+        if bl_load_elf is not None and app_load_elf is not None and load_to_flash:
+            # bootloader and application are programmed in a single download (sectors are erased and programmed once)
+            download = _target_image_outdated(dt, bl_load_elf, load_to_flash, silent) or \
+                       _target_image_outdated(dt, app_load_elf, load_to_flash, silent)
+            dt.load(app_load_elf, app_symbol_elf, enable_flash=True, download=download, extra_load_elfs=[bl_load_elf])
+        else:
+            # optionally load bootloader binary (load elf ONLY - symbols are loaded after the app)
+            if bl_load_elf is not None:
+                dt.load(bl_load_elf, None, enable_flash=load_to_flash,
+                        download=_target_image_outdated(dt, bl_load_elf, load_to_flash, silent))
+
+            # load application binaries
+            if app_load_elf is not None:
+                dt.load(app_load_elf, app_symbol_elf, enable_flash=load_to_flash,
+                        download=_target_image_outdated(dt, app_load_elf, load_to_flash, silent))
 
         # add bootloader symbol file; note: it is important to this 'add' so after doing target.load() with symbol elf.
+        # If the application symbols were kept (unchanged symbol ELF), the bootloader symbols are still loaded as well.
         bl_symbol_elf = DottConf.get('bl_symbol_elf')
-        if bl_symbol_elf is not None:
-            dt.cli_exec('add-symbol-file %s 0x%x' % (DottConf.get('bl_symbol_elf'),
+        if bl_symbol_elf is not None and not (app_load_elf is not None and app_symbol_elf and dt.symbol_reload_skipped):
+            dt.cli_exec('add-symbol-file %s 0x%x' % (dt.gdb_client.file_path(DottConf.get('bl_symbol_elf')),
                                                                 int(DottConf.get('bl_symbol_addr'))))
 
-        # disable FLASH breakpoints
-        dt.cli_exec('monitor flash breakpoints=0')
+        # disable FLASH breakpoints (re-enabled by the breakpoint manager if HW breakpoints are exhausted)
+        cmd = dt.gdb_srv_quirks.monitor_flash_breakpoints(False)
+        if cmd is not None:
+            dt.cli_exec(cmd)
+        dt.bp_manager.reset_fallback()
+
+        # (re-)start the coverage sweep once the symbols are loaded (test impact recording, see impact.py, relies on
+        # the sweep to record the functions executed by each test)
+        global _coverage
+        impact: bool = DottConf.conf.get('impact_recording', False)
+        if (DottConf.get('coverage') is not None or impact) and dt is dott().target:
+            if _coverage is None:
+                _coverage = CoverageCollector(dt, DottConf.get('coverage') or CoverageCollector.MODE_FUNCTION,
+                                              DottConf.get('coverage_bp_budget'), rearm=impact)
+            _coverage.start()
     except Exception as ex:
         log.exception(str(ex))
         pytest.exit('Unhandled exception target download. See trace above.')
@@ -72,7 +213,8 @@ def target_load_common(name: str, load_to_flash: bool, silent: bool = False, dt:
 def target_load_sram() -> None:
     """
     This fixture loads the application (and optionally the bootloader) binary onto the target SRAM.
-    This fixture has FUNCTION scope and hence is execute for each test where it is specified.
+    This fixture has FUNCTION scope and hence is execute for each test where it is specified. If sram_fast_reload is
+    enabled, only the parts of the image which were modified since the previous download are restored.
     """
     target_load_common('SRAM', load_to_flash=False)
 
@@ -107,10 +249,19 @@ def target_load_symbols_only(silent: bool = False) -> None:
     """
     This fixture loads the symbols from the app_symbol_elf file but does NOT perform actual target download. Hence,
     this fixture is useful if the code has already been loaded onto the target before and only symbol information
-    is needed in the test.
+    is needed in the test. In attach only mode (see attach_only in dott.ini), the target keeps running and the live
+    access connection (see Target.live_direct) is established right away such that the test can access the memory of
+    the running target without further delay.
     """
+    dt = dott().target
     app_symbol_elf = DottConf.get('app_symbol_elf')
-    dott().target.load(None, app_symbol_elf, enable_flash=False)
+    dt.load(None, app_symbol_elf, enable_flash=False)
+    if DottConf.get('attach_only') and DottConf.get('gdb_server_type') == 'jlink':
+        try:
+            with _fixture_profile.phase('live access'):
+                dt.live_direct()
+        except Exception as ex:
+            log.warn(f'Live access not available ({ex}).')
 
 
 # ----------------------------------------------------------------------------------------------------------------------
@@ -122,19 +273,21 @@ def _target_mem_init_noalloc(dt: 'Target' = None) -> None:
         log.info(f'Overriding std. target mem model with {TargetMemModel.NOALLOC}.')
 
     # define the initial test breakpoint, start the target and wait until the breakpoint is reached
-    bp = HaltPoint('main')
-    dt.cont()
-    try:
-        bp.wait_complete(timeout=5)
-    except Exception:
-        dt.halt()
-        log.warn('main not reached. Target halted after timeout at PC: 0x%x' % dt.eval('$pc'))
-
-    # remove test hook breakpoint
-    bp.delete()
+    with _fixture_profile.phase('run-to-main'):
+        bp = HaltPoint('main')
+        dt.cont()
+        try:
+            bp.wait_complete(timeout=5)
+        except Exception:
+            dt.halt()
+            log.warn('main not reached. Target halted after timeout at PC: 0x%x' % dt.eval('$pc'))
+
+        # remove test hook breakpoint
+        bp.delete()
 
     # once we have reached the initial breakpoint we initialize the on-target memory access model
-    dt.mem = TargetMemNoAlloc(dt)
+    with _fixture_profile.phase('mem init'):
+        dt.mem = TargetMemNoAlloc(dt)
 
     yield
 
@@ -148,19 +301,37 @@ def _target_mem_init_testhook(dt: 'Target' = None) -> None:
         log.info(f'Overriding std. target mem model with {TargetMemModel.TESTHOOK}.')
 
     # define the initial test breakpoint, start the target and wait until the breakpoint is reached
-    bp = HaltPoint('DOTT_test_hook_chained')
-    dt.cont()
-    try:
-        bp.wait_complete(timeout=5)
-    except Exception:
-        dt.halt()
-        log.warn('DOTT_test_hook_chained not reached. Target halted after timeout at PC: 0x%x' % dt.eval('$pc'))
-
-    # remove test hook breakpoint
-    bp.delete()
+    with _fixture_profile.phase('run-to-main'):
+        bp = HaltPoint('DOTT_test_hook_chained')
+        dt.cont()
+        try:
+            bp.wait_complete(timeout=5)
+        except Exception:
+            dt.halt()
+            log.warn('DOTT_test_hook_chained not reached. Target halted after timeout at PC: 0x%x' % dt.eval('$pc'))
+
+        # remove test hook breakpoint
+        bp.delete()
 
     # once we have reached the initial breakpoint we initialize the on-target memory access model
-    dt.mem = TargetMemTestHook(dt)
+    with _fixture_profile.phase('mem init'):
+        dt.mem = TargetMemTestHook(dt)
+
+    yield
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+def _target_mem_init_section(dt: 'Target' = None) -> None:
+    dt = dott().target if dt is None else dt
+
+    # print mem model override information
+    if DottConf.conf['on_target_mem_model'] != TargetMemModel.SECTION:
+        log.info(f'Overriding std. target mem model with {TargetMemModel.SECTION}.')
+
+    # the scratchpad section is available right after reset; no need to run the target up to an initial breakpoint.
+    # note: the target remains halted at its reset location.
+    with _fixture_profile.phase('mem init'):
+        dt.mem = TargetMemSection(dt)
 
     yield
 
@@ -206,53 +377,129 @@ def _target_mem_init_prestack(mem_model_args: Dict = None, dt: 'Target' = None)
                  f'total stack: {total_stack_num_bytes if total_stack_num_bytes is not None else "unknown"}).')
 
     # define the initial allocation breakpoint, start the target and wait until the breakpoint is reached
-    bp = HaltPoint(alloc_location)
-    dt.cont()
-    try:
-        bp.wait_complete(timeout=5)
-    except Exception:
-        dt.halt()
-        log.warn(f'{alloc_location} not reached. Target halted after timeout at PC: 0x{dt.eval("$pc"):x}')
-    bp.delete()
-
-    # adjust the stack pointer (i.e., steal the requested amount of on-target memory)
-    dt.eval(f'$sp -= {target_mem_num_bytes}')
-
-    # initialize the on-target memory access model using the 'stolen' memory
-    target_mem_stack_start = dt.eval('$sp')
-    dt.mem = TargetMem(dt, target_mem_stack_start, target_mem_num_bytes)
+    with _fixture_profile.phase('run-to-main'):
+        bp = HaltPoint(alloc_location)
+        dt.cont()
+        try:
+            bp.wait_complete(timeout=5)
+        except Exception:
+            dt.halt()
+            log.warn(f'{alloc_location} not reached. Target halted after timeout at PC: 0x{dt.eval("$pc"):x}')
+        bp.delete()
+
+    with _fixture_profile.phase('mem init'):
+        # adjust the stack pointer (i.e., steal the requested amount of on-target memory)
+        dt.eval(f'$sp -= {target_mem_num_bytes}')
+
+        # initialize the on-target memory access model using the 'stolen' memory
+        target_mem_stack_start = dt.eval('$sp')
+        dt.mem = TargetMem(dt, target_mem_stack_start, target_mem_num_bytes)
 
     # define the halt breakpoint, start the target and wait until the breakpoint is reached
-    bp = HaltPoint(halt_location)
-    dt.cont()
-    try:
-        bp.wait_complete(timeout=5)
-    except Exception:
-        dt.halt()
-        log.warn(f'{halt_location} not reached. Target halted after timeout at PC: 0x{dt.eval("$pc"):x}')
-    bp.delete()
+    with _fixture_profile.phase('run-to-main'):
+        bp = HaltPoint(halt_location)
+        dt.cont()
+        try:
+            bp.wait_complete(timeout=5)
+        except Exception:
+            dt.halt()
+            log.warn(f'{halt_location} not reached. Target halted after timeout at PC: 0x{dt.eval("$pc"):x}')
+        bp.delete()
 
     # pass control to test
     yield
 
 
 # ----------------------------------------------------------------------------------------------------------------------
-def target_reset_common(request, sp: str = None, pc: str = None, setup_cb: types.FunctionType = None, dt: 'Target' = None) -> None:
-    dt = dott().target if dt is None else dt
-    # reset target and clear all potentially existing breakpoints
-    dt.halt()
-    dt.reset()
-    dt.bp_clear_all()
+def _snapshot_reset(dt: 'Target') -> bool:
+    # machine snapshots (reset_snapshot) are used for the warm reset if the GDB server supports them (emulators)
+    return DottConf.conf.get('reset_snapshot', False) and dt.gdb_srv_quirks is not None and \
+        dt.gdb_srv_quirks.supports_snapshots
+
+
+def _target_mem_init_warm(dt: 'Target', key: Tuple, mem_init) -> None:
+    # Warm reset: The first time the initial halt location of the memory model is reached, the core registers and
+    # the RAM content are captured. Subsequent tests restore this state without resetting the target and without
+    # executing the boot code. Note: Peripheral state is not restored. For emulated targets with reset_snapshot, a
+    # machine snapshot (CPU, memory and peripherals) is taken and restored by the emulator instead.
+    state = _warm_reset_states.get(key)
+    if state is not None:
+        with _fixture_profile.phase('warm restore'):
+            regs, mem_snapshot, mem_cls, mem_region = state
+            if regs is None:
+                dt.snapshot_restore(mem_snapshot)
+            else:
+                dt.mem.restore(mem_snapshot)
+                dt.reg_restore(regs)
+            # note: PRESTACK uses a plain TargetMem on the stack region stolen during the captured boot
+            dt.mem = TargetMem(dt, *mem_region) if mem_cls is TargetMem else mem_cls(dt)
+        yield
+        return
+
+    for _ in mem_init:
+        with _fixture_profile.phase('warm capture'):
+            if _snapshot_reset(dt):
+                name = f'dott_warm_{len(_warm_reset_states)}'
+                dt.snapshot_save(name)
+                _warm_reset_states[key] = (None, name, type(dt.mem), dt.mem.region)
+            else:
+                _warm_reset_states[key] = (dt.reg_snapshot(), dt.mem.snapshot(DottConf.conf['warm_reset_ram']),
+                                           type(dt.mem), dt.mem.region)
+        yield
 
-    # set sp and pc for execution from RAM area
-    if sp is not None:
-        dt.eval(f'$sp = *{sp}')
-    if pc is not None:
-        dt.eval(f'$pc = *{pc}')
 
-    # if a callback was specified give user code a chance to to early device initialization
-    if setup_cb is not None:
-        setup_cb()
+def _target_warm_reset_key(dt: 'Target', mem_model: TargetMemModel, sp: str, pc: str,
+                           mem_model_args: Dict = None) -> Tuple:
+    # key of the warm reset state; the state is only valid for the same application image and memory model arguments
+    # (e.g., the alloc_size of a PRESTACK marker)
+    app_load_elf = DottConf.get('app_load_elf')
+    elf_key = TypeCache.elf_key(app_load_elf) if app_load_elf is not None else None
+    args = tuple(sorted((k, str(v)) for k, v in (mem_model_args or {}).items()))
+    return id(dt), mem_model, sp, pc, elf_key, args
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+def _target_watch_start(dt: 'Target', mem_init, budget: PerfBudget = None):
+    # paints the stack (stack_watch or stack budget), starts the heap trace (heap_trace), the firmware log
+    # (firmware_log) and the cycle counter (cycles budget) of the default target once the memory model has been
+    # initialized; all are evaluated after the test by dott_auto_func_cleanup
+    global _stack_monitor, _heap_trace, _firmware_log, _cycle_counter
+    for _ in mem_init:
+        _stack_monitor = None
+        _heap_trace = None
+        _firmware_log = None
+        _cycle_counter = None
+        if (DottConf.conf['stack_watch'] or (budget is not None and budget.stack is not None)) \
+                and dt is dott().target:
+            with _fixture_profile.phase('stack paint'):
+                _stack_monitor = StackMonitor(dt, DottConf.conf['stack_region'])
+                _stack_monitor.paint()
+        if DottConf.conf['heap_trace'] is not None and dt is dott().target:
+            with _fixture_profile.phase('heap trace'):
+                _heap_trace = HeapTrace(dt)
+                _heap_trace.start()
+        if DottConf.conf['firmware_log'] and dt is dott().target:
+            with _fixture_profile.phase('firmware log'):
+                _firmware_log = DeferredLog(dt)
+                _firmware_log.drain()  # note: records of previous tests and of the reset are discarded
+        if budget is not None and budget.cycles is not None and dt is dott().target:
+            with _fixture_profile.phase('reset'):
+                _cycle_counter = CycleCounter(dt)
+                _cycle_counter.start()
+        yield
+
+
+def _test_budget(request) -> PerfBudget:
+    # performance budget of the test given by its dott_budget marker (None if the test is not marked)
+    try:
+        return PerfBudget.from_marker(request.node.get_closest_marker('dott_budget'))
+    except DottException as ex:
+        pytest.fail(str(ex))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+def target_reset_common(request, sp: str = None, pc: str = None, setup_cb: types.FunctionType = None, dt: 'Target' = None) -> None:
+    dt = dott().target if dt is None else dt
 
     # set on-target memory allocation model either from config or from pytest marker
     mem_model: TargetMemModel = DottConf.conf['on_target_mem_model']
@@ -263,13 +510,54 @@ def target_reset_common(request, sp: str = None, pc: str = None, setup_cb: types
                 mem_model = m.kwargs['model']
                 mem_model_args = m.kwargs
                 break
+    budget = _test_budget(request)
+
+    # warm reset (if configured) for memory models which run the target up to an initial halt location
+    warm_key = None
+    if (DottConf.conf.get('warm_reset_ram') is not None or _snapshot_reset(dt)) and \
+            mem_model in (TargetMemModel.NOALLOC, TargetMemModel.TESTHOOK, TargetMemModel.PRESTACK):
+        warm_key = _target_warm_reset_key(dt, mem_model, sp, pc, mem_model_args)
+        if warm_key in _warm_reset_states:
+            with _fixture_profile.phase('reset'):
+                dt.halt()
+            with _fixture_profile.phase('bp clear'):
+                dt.bp_clear_all()
+            yield from _target_watch_start(dt, _target_mem_init_warm(dt, warm_key, None), budget)
+            return
+
+    # reset target and clear all potentially existing breakpoints
+    with _fixture_profile.phase('reset'):
+        dt.halt()
+        dt.reset()
+    with _fixture_profile.phase('bp clear'):
+        dt.bp_clear_all()
+
+    # set sp and pc for execution from RAM area
+    with _fixture_profile.phase('reset'):
+        if sp is not None:
+            dt.eval(f'$sp = *{sp}')
+        if pc is not None:
+            dt.eval(f'$pc = *{pc}')
+
+    # if a callback was specified give user code a chance to to early device initialization
+    if setup_cb is not None:
+        with _fixture_profile.phase('setup cb'):
+            setup_cb()
 
     if mem_model == TargetMemModel.NOALLOC:
-        yield from _target_mem_init_noalloc()
+        mem_init = _target_mem_init_noalloc()
+        yield from _target_watch_start(dt, mem_init if warm_key is None else _target_mem_init_warm(dt, warm_key,
+                                                                                                   mem_init), budget)
     elif mem_model == TargetMemModel.TESTHOOK:
-        yield from _target_mem_init_testhook()
+        mem_init = _target_mem_init_testhook()
+        yield from _target_watch_start(dt, mem_init if warm_key is None else _target_mem_init_warm(dt, warm_key,
+                                                                                                   mem_init), budget)
     elif mem_model == TargetMemModel.PRESTACK:
-        yield from _target_mem_init_prestack(mem_model_args)
+        mem_init = _target_mem_init_prestack(mem_model_args)
+        yield from _target_watch_start(dt, mem_init if warm_key is None else _target_mem_init_warm(dt, warm_key,
+                                                                                                   mem_init), budget)
+    elif mem_model == TargetMemModel.SECTION:
+        yield from _target_watch_start(dt, _target_mem_init_section(), budget)
     else:
         log.warn(f'Selected target memory allocation model is not implemented!')
 
@@ -281,7 +569,9 @@ def target_reset_sram(request) -> None:
     This fixture halts the target devices, resets it and clears all potentially active breakpoints. Additionally, it
     sets the SP and PC to the default Cortex-M on-chip SRAM locations (0x20000000 and 0x20000004). The target memory
     model can be selected either via the global config system or via the pytest marker 'dott_mem' where the model
-    argument is one of the models specified in TargetMemModel.
+    argument is one of the models specified in TargetMemModel. If warm_reset_ram (or reset_snapshot for emulated
+    targets) is configured, the target state captured at the initial halt location of the first test is restored
+    instead (all models except SECTION).
 
     Args:
         request: PyTest request object.
@@ -295,7 +585,9 @@ def target_reset_flash(request) -> None:
     """
     This fixture halts the target device, resets it and clears all potentially active breakpoints. The target memory
     model can be selected either via the global config system or via the pytest marker 'dott_mem' where the model
-    argument is one of the models specified in TargetMemModel.
+    argument is one of the models specified in TargetMemModel. If warm_reset_ram (or reset_snapshot for emulated
+    targets) is configured, the target state captured at the initial halt location of the first test is restored
+    instead (all models except SECTION).
     Args:
         request: PyTest request object.
     """
@@ -303,34 +595,313 @@ def target_reset_flash(request) -> None:
 
 
 # ----------------------------------------------------------------------------------------------------------------------
+@pytest.fixture(scope='session')
+def live_access_session():
+    """
+    Live access connection which is established once and shared by all tests of the session (see live_access).
+    """
+    if dott().target.gdb_client.agent is not None:
+        # the board is attached to a DOTT agent; live accesses are performed by the agent
+        live = dott().target.gdb_client.agent.target_direct()
+    else:
+        live = TargetDirect(DottConf.conf['device_name'], dott().target)
+    yield live
+    live.disconnect()
+
+
 @pytest.fixture(scope='function')
-def live_access():
+def live_access(live_access_session):
     """
-    This fixture provides access to target memory while the target is running.
+    This fixture provides access to target memory while the target is running. The connection is established once
+    per session and is re-synchronized with the target at the start of each test (it is re-established if it was
+    lost). The probe connection is shared with other live access users (e.g., swo_capture) and live accesses are
+    paused while the target is halted, continued or reset via GDB (see ProbeBroker).
 
     Returns: Instance of TargetLive which provides memory read/write functions while target is running.
     """
-    live = TargetDirect(DottConf.conf['device_name'])
-    yield live
+    live_access_session.resync()
+    yield live_access_session
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+@pytest.fixture(scope='function')
+def pc_profiler(live_access):
+    """
+    This fixture provides a statistical PC-sampling profiler (see PcProfiler) which uses the live access connection
+    to sample the PC of the running target. Example:
+
+    dott().target.cont()
+    profile = pc_profiler.sample(duration=2.0)
+    log.info(profile.flat_str())
+
+    Returns: Instance of PcProfiler.
+    """
+    yield PcProfiler(live_access, dott().target.symbols)
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+@pytest.fixture(scope='function')
+def live_watch(live_access):
+    """
+    This fixture provides a function which starts a live variable watch service (see WatchService) for the running
+    target. Viewers (e.g., 'python -m dottmi.watch --plot') subscribe via the service's TCP port. Example:
+
+    dott().target.cont()
+    watch = live_watch(['_tick_cnt', '_timer_cnt'], rate=200)
+    time.sleep(10)  # subscribed viewers receive the samples while the test runs
+
+    Returns: Function with the signature (variables, rate=100.0, port=WatchService.DEFAULT_PORT) returning the
+             started WatchService. All services are stopped at the end of the test.
+    """
+    services = []
+
+    def start(variables, rate: float = 100.0, port: int = WatchService.DEFAULT_PORT) -> WatchService:
+        service = WatchService(live_access, variables, rate=rate, port=port, symbols=dott().target.symbols)
+        service.start()
+        services.append(service)
+        return service
+
+    yield start
+    for service in services:
+        service.stop()
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+@pytest.fixture(scope='function')
+def swo_capture():
+    """
+    This fixture provides a running SWO capture (see SwoCapture) of ITM stimulus port writes and DWT PC samples while
+    the target is running. It requires swo_cpu_speed to be set in the DOTT config.
+
+    Returns: Instance of SwoCapture. Stimulus port data is available via channel(port), PC samples via pc_samples.
+    """
+    live = TargetDirect(DottConf.conf['device_name'], dott().target)
+    swo = live.swo_capture(pc_sampling=DottConf.conf['swo_pc_sampling'])
+    swo.start()
+    yield swo
+    swo.stop()
     live.disconnect()
 
 
+# ----------------------------------------------------------------------------------------------------------------------
+@pytest.fixture(scope='session')
+def uart_capture_session():
+    """
+    UART capture (see UartCapture) of the serial port given by uart_port in the DOTT config which is kept running for
+    the whole session such that no output is lost between the tests (see uart_capture).
+    """
+    if DottConf.conf['uart_port'] is None:
+        pytest.skip('uart_port is not set in the DOTT config.')
+    capture = UartCapture(DottConf.conf['uart_port'], DottConf.conf['uart_baudrate'])
+    capture.start()
+    yield capture
+    capture.stop()
+
+
+@pytest.fixture(scope='function')
+def uart_capture(uart_capture_session):
+    """
+    This fixture provides the UART capture of the target's serial output. The data received before the setup of the
+    fixture is discarded; list the fixture after target_reset such that the output of the reset is kept. The received
+    data is time-aligned with DOTT's events (e.g., Breakpoint.hit_time). Example:
+
+    dott().target.cont()
+    t = uart_capture.wait_for('boot done', timeout=2.0)
+    log.info(uart_capture.lines())
+
+    Returns: Instance of UartCapture.
+    """
+    uart_capture_session.clear()
+    yield uart_capture_session
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+# benchmark results of the test session (see target_bench)
+_bench_recorder: BenchRecorder = None
+
+
+@pytest.fixture(scope='function')
+def target_bench(request):
+    """
+    This fixture provides a function which benchmarks a target function (see Target.bench) and records the result
+    for the test session. If bench_results_file is configured, all results are written to this file (together with
+    the current git commit) at the end of the session. If bench_baseline_file is configured (e.g., the results file of
+    a previous commit), the test fails if the median cycle count exceeds the baseline by more than bench_tolerance.
+    If bench_stack_bytes is configured, the peak stack usage of the benchmarked function is measured as well.
+    Example:
+
+    def test_addition_perf(self, target_load, target_reset, target_bench):
+        res = target_bench('example_Addition', 3, 4, iterations=1000)
+        assert res.max < 100
+
+    Returns: Function with the signature of Target.bench (plus optional name under which the result is recorded).
+    """
+    global _bench_recorder
+    if _bench_recorder is None:
+        _bench_recorder = BenchRecorder(DottConf.conf['bench_results_file'], DottConf.conf['bench_baseline_file'],
+                                        DottConf.conf['bench_tolerance'])
+
+    def bench(func, *args: int, iterations: int = 100, warmup: int = 3, name: str = None) -> BenchResult:
+        res = dott().target.bench(func, *args, iterations=iterations, warmup=warmup,
+                                  stack_bytes=DottConf.conf['bench_stack_bytes'])
+        key = f'{request.node.nodeid}::{name if name is not None else res.name}'
+        request.node.add_report_section('call', 'DOTT benchmark', f'{key}: {res}')
+        _perf_results[(key, 'cycles')] = list(res.cycles)
+        if res.stack is not None:
+            _perf_results[(key, 'stack')] = [res.stack]
+        regression = _bench_recorder.record(key, res)
+        if regression is not None:
+            pytest.fail(f'Performance regression: {regression}')
+        return res
+
+    return bench
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+# GDB MI command statistics of the individual tests (collected if gdb_mi_stats is enabled)
+_gdb_mi_stats_per_test: Dict[str, Dict] = {}
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+def _target_recover(dt: 'Target') -> None:
+    # re-establishes the lost connection of the default target and repeats the last download such that the following
+    # tests find the target in the expected state; the session is aborted if the board can not be recovered
+    try:
+        dott().recover_target(dt)
+    except Exception:
+        log.error(traceback.format_exc(limit=None))
+        pytest.exit('Connection to target lost and recovery failed. Aborting test execution.')
+    _warm_reset_states.clear()
+    if _last_load is not None:
+        _target_load(dt, _last_load[0], _last_load[1], silent=True)
+
+
 # ----------------------------------------------------------------------------------------------------------------------
 # DOTT-internal fixture which performs DOTT related cleanup on a per-function basis
 @pytest.fixture(scope='function', autouse=True)
-def dott_auto_func_cleanup():
+def dott_auto_func_cleanup(request):
+    global _cycle_counter
+    budget = _test_budget(request)
+    stats: GdbMiStats = None
+    stats_before: Dict = None
+    if DottConf.conf['gdb_mi_stats'] and dott().target is not None:
+        stats = dott().target.gdb_client.gdb_mi.stats
+        stats_before = stats.get()
+
+    test_start = time.perf_counter()
+    fixture_start = _fixture_profile.total()
     yield
-    dott().target.halt()
-    InterceptPoint.delete_all()
+    timeline.complete(request.node.nodeid, 'test', test_start)
+    wall_ms = (time.perf_counter() - test_start - (_fixture_profile.total() - fixture_start)) * 1000
+    dt = dott().target
+    auto_recover: bool = DottConf.conf['health_auto_recover']
+    with _fixture_profile.phase('cleanup'):
+        try:
+            healthy = not auto_recover or dt.check_health()
+            if healthy:
+                dt.halt()
+        except DottConnectionError:
+            if not auto_recover:
+                raise
+            healthy = False
+    cycles: int = None
+    if healthy and _cycle_counter is not None:
+        with _fixture_profile.phase('cleanup'):
+            cycles = _cycle_counter.read()
+    _cycle_counter = None
+    if not healthy:
+        with _fixture_profile.phase('recover'):
+            _target_recover(dt)
+    stack_peak: int = None
+    if healthy and _stack_monitor is not None and _stack_monitor.painted:
+        with _fixture_profile.phase('stack scan'):
+            stack_peak = _stack_monitor.peak()
+        _stack_peaks[request.node.nodeid] = stack_peak
+        _perf_results[(request.node.nodeid, 'stack')] = [stack_peak]
+        request.node.user_properties.append(('dott_stack_peak_bytes', stack_peak))
+        request.node.add_report_section('teardown', 'DOTT stack',
+                                        f'peak stack usage: {stack_peak} of {_stack_monitor.size} bytes')
+    heap_report: 'HeapReport' = None
+    if healthy and _heap_trace is not None and _heap_trace.active:
+        with _fixture_profile.phase('heap trace'):
+            heap_report = _heap_trace.stop()
+        request.node.user_properties.append(('dott_heap_peak_bytes', heap_report.peak_bytes))
+        request.node.user_properties.append(('dott_heap_leaked_bytes', heap_report.live_bytes))
+        request.node.add_report_section('teardown', 'DOTT heap', str(heap_report))
+    if healthy and _firmware_log is not None:
+        with _fixture_profile.phase('firmware log'):
+            records = _firmware_log.drain()
+        lost = f'\n({_firmware_log.dropped} records dropped, buffer full)' if _firmware_log.dropped > 0 else ''
+        request.node.add_report_section('teardown', 'DOTT firmware log', '\n'.join(str(r) for r in records) + lost)
+    with _fixture_profile.phase('cleanup'):
+        FunctionStub.restore_all(discard=not healthy)
+        InterceptPoint.delete_all()
+        if _coverage is not None:
+            _coverage.rotate()
+            request.node._dott_functions = _coverage.last_functions
+
+    for phase, secs in sorted(_fixture_profile.take_test().items()):
+        request.node.user_properties.append((f'dott_fixture_{phase.replace(" ", "_")}_s', f'{secs:.3f}'))
+
+    if stats is not None:
+        test_stats = GdbMiStats.diff(stats.get(), stats_before)
+        _gdb_mi_stats_per_test[request.node.nodeid] = test_stats
+        request.node.add_report_section('teardown', 'DOTT GDB MI stats', GdbMiStats.to_str(test_stats))
+
+    if budget is not None:
+        measured = {'cycles': cycles, 'stack': stack_peak, 'wall_ms': wall_ms}
+        for name in PerfBudget.NAMES:
+            if getattr(budget, name) is not None and measured[name] is not None:
+                request.node.user_properties.append((f'dott_budget_{name}', f'{measured[name]:.0f}'))
+                _perf_results[(request.node.nodeid, name)] = [measured[name]]
+        if budget.cycles is not None and cycles is None:
+            log.warn(f'{request.node.nodeid}: cycles budget not checked (the test does not use a target_reset_xxx '
+                     f'fixture).')
+        exceeded = budget.exceeded(measured)
+        if len(exceeded) > 0:
+            pytest.fail('Performance budget exceeded: ' + '; '.join(exceeded))
+
+    if stack_peak is not None and _stack_monitor.overflow(stack_peak):
+        pytest.fail(f'Stack overflow: the test used the entire stack ({_stack_monitor.size} bytes).')
+    if heap_report is not None and len(heap_report.leaks) > 0:
+        msg = f'Heap leak: {heap_report.live_bytes} bytes in {len(heap_report.leaks)} blocks not released by the test.'
+        if DottConf.conf['heap_trace'] == 'strict':
+            pytest.fail(msg)
+        log.warn(msg)
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+def _perf_history_add(dt: 'Target') -> None:
+    # adds the performance results of the session to the history and reports the regressions compared to the
+    # previous run on the same board
+    try:
+        history = PerfHistory(DottConf.conf['perf_history_file'])
+    except Exception as ex:
+        log.warn(f'Unable to open performance history {DottConf.conf["perf_history_file"]} ({ex}).')
+        return
+    try:
+        run_id = history.add_run(dt.symbols.key, PerfHistory.dott_version() or DottConf.conf.get('DOTT_RUNTIME_VER'),
+                                 DottConf.conf.get('jlink_serial'), BenchRecorder._git_commit(), _perf_results)
+        diffs = history.compare(run_id, tolerance=DottConf.conf['bench_tolerance'])
+        regressions = [d for d in diffs if d.regression]
+        log.info(f'Performance history: run {run_id} with {len(_perf_results)} results; {len(regressions)} of '
+                 f'{len(diffs)} metrics regressed compared to the previous run.')
+        if len(regressions) > 0:
+            log.warn(f'Performance regressions:\n{PerfHistory.compare_str(regressions)}')
+    except Exception as ex:
+        log.warn(f'Unable to update performance history {DottConf.conf["perf_history_file"]} ({ex}).')
+    finally:
+        history.close()
 
 
 # ----------------------------------------------------------------------------------------------------------------------
 # DOTT-internal fixture which ensures that the DOTT target is properly terminated
 # at end of test session (including DOTT's internal threads).
 @pytest.fixture(scope='session', autouse=True)
-def dott_auto_connect_and_disconnect():
+def dott_auto_connect_and_disconnect(record_testsuite_property):
     try:
-        dott()
+        with _fixture_profile.phase('connect'):
+            dott().target  # note: the default target is created on first use
     except Exception:
         log.error(traceback.format_exc(limit=None))
         pytest.exit('DOTT failed to initialize. Check exception trace for details.')
@@ -340,10 +911,40 @@ def dott_auto_connect_and_disconnect():
         log.error(traceback.format_exc(limit=None))
         pytest.exit('Unhandled exception during test session. Check exception trace for details.')
 
-    if dott().target is not None:
+    if dott().target_created and dott().target is not None:
+        if DottConf.conf['gdb_mi_stats_file'] is not None:
+            dott().target.gdb_client.gdb_mi.stats.save_json(DottConf.conf['gdb_mi_stats_file'], _gdb_mi_stats_per_test)
+        if _bench_recorder is not None:
+            _bench_recorder.save()
+        if DottConf.conf['perf_history_file'] is not None and len(_perf_results) > 0:
+            _perf_history_add(dott().target)
+        if _coverage is not None:
+            _coverage.stop()
+        if _coverage is not None and DottConf.conf['coverage'] is not None:
+            _coverage.save_lcov(DottConf.conf['coverage_file'])
+            log.info(f'{_coverage.summary()}. Written to {DottConf.conf["coverage_file"]}.')
+        flash_report = dott().target.bp_manager.flash_report()
+        if flash_report is not None:
+            log.info(flash_report)
+            flash_secs = sum(s['secs'] for s in dott().target.bp_manager.flash_stats().values())
+            record_testsuite_property('dott_flash_bp_reprogram_s', f'{flash_secs:.3f}')
         dott().shutdown()
+    if DottConf.conf.get('timeline_file') is not None:
+        timeline.save(DottConf.conf['timeline_file'])
+
+    if len(_stack_peaks) > 0:
+        node_id = max(_stack_peaks, key=_stack_peaks.get)
+        log.info(f'Peak stack usage: {_stack_peaks[node_id]} bytes ({node_id}).')
+        record_testsuite_property('dott_stack_peak_bytes', _stack_peaks[node_id])
+    log.info(_fixture_profile.summary())
+    for phase, secs in sorted(_fixture_profile.totals().items()):
+        record_testsuite_property(f'dott_fixture_{phase.replace(" ", "_")}_s', f'{secs:.3f}')
 
 
 def pytest_configure(config):
+    # no target is created (and no GDB is started) if tests are only collected (e.g., by IDEs for test discovery)
+    DottConf.conf['collect_only'] = config.getoption('collectonly', False)
+
     # register markers with pytest
     config.addinivalue_line("markers", "dott_mem: marker to select on-target memory allocation model")
+    config.addinivalue_line("markers", "dott_budget(cycles, stack, wall_ms): per-test performance budget")
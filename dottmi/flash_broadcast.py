@@ -0,0 +1,146 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Broadcast flashing of one firmware image to many boards. The ELF file is parsed (and split into sectors with their
+# CRCs) once; the boards are then programmed concurrently, one thread per board (each target has its own GDB and GDB
+# server). Intel HEX files of the changed sectors (used if no flash loader is configured) are shared by boards which
+# need the same sectors, which is the common case in a farm where all boards hold the same previous firmware.
+# Example:
+#     targets = dott().create_targets([(dev, sn) for sn in serials])
+#     res = broadcast_load(targets, 'app.elf', progress=lambda sn, stage: print(sn, stage))
+#     assert res.ok, str(res)
+
+import shutil
+import threading
+import time
+from pathlib import Path
+from typing import Callable, Dict, List, NamedTuple
+
+from dottmi.dott import DottConf
+from dottmi.flash_image import FlashImage
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class BoardFlashResult(NamedTuple):
+    serial: str
+    ok: bool
+    sectors: int  # number of sectors programmed
+    verified: bool  # None if verification was not requested
+    duration: float  # seconds
+    error: str  # None if successful
+
+
+class BroadcastResult(object):
+    def __init__(self, elf: str, num_sectors: int, boards: List[BoardFlashResult], duration: float) -> None:
+        self.elf: str = elf
+        self.num_sectors: int = num_sectors
+        self.boards: List[BoardFlashResult] = boards
+        self.duration: float = duration
+
+    @property
+    def ok(self) -> bool:
+        return all(b.ok for b in self.boards)
+
+    @property
+    def failed(self) -> List[str]:
+        return [b.serial for b in self.boards if not b.ok]
+
+    def __str__(self) -> str:
+        lines = [f'Broadcast of {self.elf} ({self.num_sectors} sectors) to {len(self.boards)} boards took '
+                 f'{self.duration:.1f}s ({len(self.failed)} failed)']
+        for b in self.boards:
+            verified = '' if b.verified is None else (', verified' if b.verified else ', VERIFICATION FAILED')
+            status = f'{b.sectors} sector(s) programmed{verified}' if b.error is None else f'failed: {b.error}'
+            lines.append(f'  {b.serial}: {status} ({b.duration:.1f}s)')
+        return '\n'.join(lines)
+
+
+def broadcast_load(targets: List['Target'], load_elf_file_name: str, symbol_elf_file_name: str = None,
+                   incremental: bool = True, verify: bool = True, reset: bool = True,
+                   progress: Callable[[str, str], None] = None) -> BroadcastResult:
+    """
+    Programs the given ELF file to the flash of all given targets concurrently.
+
+    Args:
+        targets: Targets (boards) to be programmed.
+        load_elf_file_name: ELF file to be programmed.
+        symbol_elf_file_name: Symbol ELF which is loaded into GDB (default: the load ELF).
+        incremental: If True, only sectors which differ from the ones on a board are programmed (see
+                     flash_download_mode).
+        verify: If True, the flash content of each board is verified (CRCs computed on the target) after programming.
+        reset: If True, the boards are reset after programming.
+        progress: Optional callback which gets the serial number of a board and its current stage ('download',
+                  'verify', 'done' or 'failed'). The callback is called from the board threads.
+
+    Returns:
+        Per-board result of programming and verification.
+    """
+    time_start = time.time()
+    image = FlashImage(load_elf_file_name, DottConf.conf.get('flash_sector_size', 2048))
+    image_crcs = image.crcs()
+    symbol_elf = symbol_elf_file_name if symbol_elf_file_name is not None else load_elf_file_name
+    hex_files: Dict = {}
+    results: List[BoardFlashResult] = [None] * len(targets)
+
+    def stage(serial: str, name: str) -> None:
+        if progress is not None:
+            progress(serial, name)
+
+    def program(idx: int, tgt: 'Target') -> None:
+        serial = tgt.serial_number
+        board_start = time.time()
+        sectors = 0
+        verified = None
+        try:
+            stage(serial, 'download')
+            tgt.load(load_elf_file_name, symbol_elf, enable_flash=True, download=False)
+            sectors = tgt.flash_download(image, incremental, hex_files)
+            if verify:
+                stage(serial, 'verify')
+                verified = tgt._flash_read_crcs(image) == image_crcs
+                if not verified:
+                    tgt._flash_state.invalidate(serial)
+            if reset:
+                tgt.reset()
+            ok = verified is not False
+            results[idx] = BoardFlashResult(serial, ok, sectors, verified, time.time() - board_start,
+                                            None if ok else 'flash content differs from image')
+        except Exception as ex:
+            results[idx] = BoardFlashResult(serial, False, sectors, verified, time.time() - board_start, str(ex))
+        stage(serial, 'done' if results[idx].ok else 'failed')
+
+    threads = [threading.Thread(target=program, args=(idx, tgt), name=f'DottBroadcast-{tgt.serial_number}',
+                                daemon=True) for idx, tgt in enumerate(targets)]
+    try:
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+    finally:
+        for hex_file in hex_files.values():
+            shutil.rmtree(Path(hex_file).parent, ignore_errors=True)
+
+    res = BroadcastResult(load_elf_file_name, len(image.sectors), results, time.time() - time_start)
+    if res.ok:
+        log.info(str(res))
+    else:
+        log.error(str(res))
+    return res
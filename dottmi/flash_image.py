@@ -0,0 +1,275 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import json
+import os
+import re
+import struct
+import zlib
+from pathlib import Path
+from typing import Dict, List, Tuple
+
+from dottmi.elf_file import ElfFile
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class FlashImage(object):
+    """
+    Load image of an ELF file (i.e., the content of its loadable segments at their load addresses) split into
+    fixed-size sectors. It is used for incremental flash downloads where only sectors whose content differs from the
+    one on the target are programmed. It is also used to restore SRAM images (see sram_fast_reload).
+    """
+    _PT_LOAD = 1
+    _SHT_NOTE = 7
+    _NT_GNU_BUILD_ID = 3
+
+    def __init__(self, elf_file: str, sector_size: int, zero_fill: bool = False) -> None:
+        """
+        Constructor.
+
+        Args:
+            elf_file: ELF file (load file).
+            sector_size: Size of the sectors (in bytes) the image is split into. Shall match the target's flash
+            sector (erase block) size.
+            zero_fill: If True, the zero-initialized part of segments executing at their load address (i.e., .bss
+            of SRAM images) is made part of the image.
+        """
+        self._sector_size: int = sector_size
+        with ElfFile.open(elf_file).mapped() as data:
+            self._entry, segments = FlashImage._elf_load_segments(data, zero_fill)
+            self._build_id: Tuple[int, bytes] = FlashImage._elf_build_id_note(data)
+        self._crcs: Dict[int, int] = None
+
+        # split segments into the pieces covered by each sector
+        self._sectors: Dict[int, List[Tuple[int, bytes]]] = {}
+        for addr, data in segments:
+            pos = 0
+            while pos < len(data):
+                sector = (addr + pos) - (addr + pos) % sector_size
+                num = min(len(data) - pos, sector + sector_size - (addr + pos))
+                self._sectors.setdefault(sector, []).append((addr + pos, data[pos:pos + num]))
+                pos += num
+
+    @staticmethod
+    def combined(images: List['FlashImage']) -> 'FlashImage':
+        """
+        Returns an image with the content of all given images (e.g., bootloader and application) such that they are
+        programmed in one download; sectors containing data of several images are erased and programmed once. The
+        images must use the same sector size and must not overlap. Entry point and build-id are the ones of the last
+        image.
+        """
+        if len({img.sector_size for img in images}) != 1:
+            raise ValueError('images to be combined must use the same sector size')
+        res = FlashImage.__new__(FlashImage)
+        res._sector_size = images[0].sector_size
+        res._entry = images[-1].entry
+        res._build_id = images[-1].build_id_note
+        res._crcs = None
+        res._sectors = {}
+        for img in images:
+            for sector in img.sectors:
+                res._sectors.setdefault(sector, []).extend(img.sector_pieces(sector))
+        for sector, pieces in res._sectors.items():
+            pieces.sort()
+            for (a, d), (b, _) in zip(pieces, pieces[1:]):
+                if a + len(d) > b:
+                    raise ValueError(f'images to be combined overlap at 0x{b:x}')
+        return res
+
+    @staticmethod
+    def _elf_load_segments(data: bytes, zero_fill: bool = False) -> Tuple[int, List[Tuple[int, bytes]]]:
+        if data[:4] != b'\x7fELF':
+            raise ValueError('not an ELF file')
+        bo = '<' if data[5] == 1 else '>'
+        if data[4] == 1:  # 32 bit ELF
+            entry, ph_off = struct.unpack_from(bo + 'II', data, 0x18)
+            ph_entsize, ph_num = struct.unpack_from(bo + 'HH', data, 0x2a)
+            ph_fmt, fields = bo + 'IIIIIIII', (0, 1, 2, 3, 4, 5)  # type, offset, vaddr, paddr, filesz, memsz
+        else:  # 64 bit ELF
+            entry, ph_off = struct.unpack_from(bo + 'QQ', data, 0x18)
+            ph_entsize, ph_num = struct.unpack_from(bo + 'HH', data, 0x36)
+            ph_fmt, fields = bo + 'IIQQQQQQ', (0, 2, 3, 4, 5, 6)
+
+        segments: List[Tuple[int, bytes]] = []
+        for i in range(ph_num):
+            ph = struct.unpack_from(ph_fmt, data, ph_off + i * ph_entsize)
+            p_type, p_offset, p_vaddr, p_paddr, p_filesz, p_memsz = (ph[f] for f in fields)
+            if p_type != FlashImage._PT_LOAD:
+                continue
+            content = data[p_offset:p_offset + p_filesz]
+            if zero_fill and p_vaddr == p_paddr and p_memsz > p_filesz:
+                content += bytes(p_memsz - p_filesz)
+            if len(content) > 0:
+                segments.append((p_paddr, content))
+        return entry, sorted(segments)
+
+    @staticmethod
+    def _elf_build_id_note(data: bytes) -> Tuple[int, bytes]:
+        # returns load address and content of the GNU build-id note if it is part of a loadable segment
+        bo = '<' if data[5] == 1 else '>'
+        if data[4] == 1:  # 32 bit ELF
+            ph_off, sh_off = struct.unpack_from(bo + 'II', data, 0x1c)
+            ph_entsize, ph_num, sh_entsize, sh_num = struct.unpack_from(bo + 'HHHH', data, 0x2a)
+            ph_fmt, ph_fields = bo + 'IIIIIIII', (0, 1, 3, 4)
+            sh_fmt, sh_fields = bo + 'IIIIIIIIII', (1, 4, 5)  # type, offset, size
+        else:  # 64 bit ELF
+            ph_off, sh_off = struct.unpack_from(bo + 'QQ', data, 0x20)
+            ph_entsize, ph_num, sh_entsize, sh_num = struct.unpack_from(bo + 'HHHH', data, 0x36)
+            ph_fmt, ph_fields = bo + 'IIQQQQQQ', (0, 2, 4, 5)
+            sh_fmt, sh_fields = bo + 'IIQQQQIIQQ', (1, 4, 5)
+
+        for i in range(sh_num):
+            sh = struct.unpack_from(sh_fmt, data, sh_off + i * sh_entsize)
+            sh_type, offset, size = (sh[f] for f in sh_fields)
+            if sh_type != FlashImage._SHT_NOTE or size < 12:
+                continue
+            name_sz, desc_sz, note_type = struct.unpack_from(bo + 'III', data, offset)
+            if note_type != FlashImage._NT_GNU_BUILD_ID or data[offset + 12:offset + 12 + name_sz] != b'GNU\x00':
+                continue
+            for j in range(ph_num):
+                ph = struct.unpack_from(ph_fmt, data, ph_off + j * ph_entsize)
+                p_type, p_offset, p_paddr, p_filesz = (ph[f] for f in ph_fields)
+                if p_type == FlashImage._PT_LOAD and p_offset <= offset and offset + size <= p_offset + p_filesz:
+                    return p_paddr + (offset - p_offset), data[offset:offset + size]
+        return None
+
+    @property
+    def build_id_note(self) -> Tuple[int, bytes]:
+        """
+        Load address and content of the image's GNU build-id note or None if the build-id is not part of the image
+        (e.g., if the linker script does not place .note.gnu.build-id into flash).
+        """
+        return self._build_id
+
+    @property
+    def entry(self) -> int:
+        return self._entry
+
+    @property
+    def sector_size(self) -> int:
+        return self._sector_size
+
+    @property
+    def sectors(self) -> List[int]:
+        """
+        Start addresses of all sectors which contain image data.
+        """
+        return sorted(self._sectors.keys())
+
+    def sector_pieces(self, sector: int) -> List[Tuple[int, bytes]]:
+        """
+        Returns the (address, data) pieces of the image located in the given sector.
+        """
+        return self._sectors[sector]
+
+    @staticmethod
+    def pieces_crc(pieces: List[Tuple[int, bytes]]) -> int:
+        """
+        CRC-32 over the given (address, data) pieces (including their addresses).
+        """
+        crc = 0
+        for addr, data in pieces:
+            crc = zlib.crc32(data, zlib.crc32(struct.pack('<Q', addr), crc))
+        return crc
+
+    def sector_crc(self, sector: int) -> int:
+        return FlashImage.pieces_crc(self._sectors[sector])
+
+    def crcs(self) -> Dict[int, int]:
+        # note: computed once per image since an image may be programmed to (and verified on) many boards
+        if self._crcs is None:
+            self._crcs = {sector: self.sector_crc(sector) for sector in self._sectors}
+        return dict(self._crcs)
+
+    def write_ihex(self, file_name: str, sectors: List[int]) -> None:
+        """
+        Writes the image data of the given sectors as Intel HEX file (which is understood by GDB's load command).
+        """
+        def record(rec_type: int, addr: int, payload: bytes) -> str:
+            rec = struct.pack('>BHB', len(payload), addr, rec_type) + payload
+            return ':' + rec.hex().upper() + f'{(-sum(rec)) & 0xff:02X}\n'
+
+        with open(file_name, 'w') as f:
+            ext_addr = None
+            for sector in sorted(sectors):
+                for addr, data in self._sectors[sector]:
+                    pos = 0
+                    while pos < len(data):
+                        a = addr + pos
+                        num = min(16, len(data) - pos, 0x10000 - (a & 0xffff))  # records must not cross 64k
+                        if a >> 16 != ext_addr:
+                            ext_addr = a >> 16
+                            f.write(record(0x04, 0, struct.pack('>H', ext_addr)))
+                        f.write(record(0x00, a & 0xffff, data[pos:pos + num]))
+                        pos += num
+            f.write(record(0x05, 0, struct.pack('>I', self._entry & 0xffffffff)))
+            f.write(record(0x01, 0, b''))
+
+
+# -------------------------------------------------------------------------------------------------
+class FlashStateCache(object):
+    """
+    Host-side record of the flash content (sector CRCs, see FlashImage) of individual boards (identified by the
+    serial number of their debug probe). Note: The record is only correct as long as the board is exclusively
+    programmed by DOTT.
+    """
+    def __init__(self, state_dir: str) -> None:
+        self._state_dir: str = state_dir
+
+    def _file_name(self, board: str) -> Path:
+        board = re.sub(r'[^\w.-]', '_', board)
+        return Path(self._state_dir).joinpath(f'dott_flash_{board}.json')
+
+    def load(self, board: str, sector_size: int) -> Dict[int, int]:
+        """
+        Returns the recorded sector CRCs of the given board or None if there is no (matching) record.
+        """
+        if self._state_dir is None or board is None or not self._file_name(board).exists():
+            return None
+        try:
+            with open(self._file_name(board), 'r') as f:
+                content = json.load(f)
+            if content.get('sector_size') != sector_size:
+                return None
+            return {int(sector): crc for sector, crc in content['crcs'].items()}
+        except (OSError, ValueError, KeyError) as ex:
+            log.warn(f'Ignoring unreadable flash state file {self._file_name(board)} ({ex}).')
+            return None
+
+    def save(self, board: str, sector_size: int, crcs: Dict[int, int]) -> None:
+        if self._state_dir is None or board is None:
+            return
+        try:
+            os.makedirs(self._state_dir, exist_ok=True)
+            tmp_file = f'{self._file_name(board)}.{os.getpid()}.tmp'
+            with open(tmp_file, 'w') as f:
+                json.dump({'sector_size': sector_size, 'crcs': {str(s): c for s, c in crcs.items()}}, f)
+            os.replace(tmp_file, self._file_name(board))
+        except OSError as ex:
+            log.warn(f'Unable to write flash state file {self._file_name(board)} ({ex}).')
+
+    def invalidate(self, board: str) -> None:
+        if self._state_dir is None or board is None:
+            return
+        try:
+            os.remove(self._file_name(board))
+        except OSError:
+            pass
@@ -0,0 +1,219 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import struct
+import time
+from typing import List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.elf_file import ElfFile
+from dottmi.flash_image import FlashImage
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class FlashLoader(object):
+    """
+    Host side of DOTT's RAM-resident flash loader (flashloader.c). The loader image (a RAM-only ELF built from
+    flashloader.c and a board specific port) is downloaded into RAM and fed with erase and program commands through a
+    ring of RAM page buffers. Two modes are supported:
+    - halt mode (default): the host fills all buffers in one MI exchange, resumes the loader and waits until it halts
+      once all posted commands are done. One round trip per num_bufs commands.
+    - live mode (requires J-Link live access, see TargetDirect): the loader keeps running and the host fills the next
+      buffer while the loader programs the previous one (double buffering).
+    Note: the loader overwrites RAM contents; the target has to be reset afterwards (as after any flash download).
+    """
+    # see flashloader.h
+    _MAGIC = 0x464C4453
+    _OP_ERASE = 1
+    _OP_PROGRAM = 2
+    _OP_EXIT = 3
+    _STATE_EMPTY = 0
+    _STATE_FULL = 1
+    _STATE_DONE = 3
+    _STATE_ERROR = 4
+    _CTRL_FMT = 'IIIIIi'  # magic, page_size, num_bufs, halt_when_idle, next, init_result
+    _CMD_FMT = 'IIIII'  # op, addr, len, state, error
+
+    # time between polls of the command states in live mode
+    _POLL_INTERVAL_SEC = 0.001
+
+    def __init__(self, target: 'Target', loader_elf: str, live_access: 'TargetDirect' = None,
+                 timeout: float = 10.0) -> None:
+        """
+        Constructor.
+
+        Args:
+            target: Target to program.
+            loader_elf: Loader image (RAM-only ELF).
+            live_access: Live access to the target. If given, the live (double buffering) mode is used.
+            timeout: Time (in seconds) to wait for a command (e.g., a sector erase) to complete.
+        """
+        self._target: 'Target' = target
+        self._loader_elf: str = loader_elf
+        self._live: 'TargetDirect' = live_access
+        self._timeout: float = timeout
+        self._bo: str = '<' if target.byte_order == 'little' else '>'
+
+        syms = ElfFile.open(loader_elf).symbols
+        for name in ('DOTT_flash_loader_ctrl', 'DOTT_flash_loader_run', 'DOTT_flash_loader_stack',
+                     'DOTT_flash_loader_bufs'):
+            if name not in syms:
+                raise DottException(f'Flash loader {loader_elf} does not provide {name} (see flashloader.c).')
+        self._ctrl: int = syms['DOTT_flash_loader_ctrl']['addr']
+        self._entry: int = syms['DOTT_flash_loader_run']['addr']
+        self._sp: int = syms['DOTT_flash_loader_stack']['addr'] + syms['DOTT_flash_loader_stack']['size']
+        self._bufs: int = syms['DOTT_flash_loader_bufs']['addr']
+        self._page_size: int = 0
+        self._num_bufs: int = 0
+        self._next: int = 0
+
+    @property
+    def page_size(self) -> int:
+        return self._page_size
+
+    def _cmd_addr(self, slot: int) -> int:
+        return self._ctrl + struct.calcsize(FlashLoader._CTRL_FMT) + 4 * self._num_bufs + \
+               slot * struct.calcsize(FlashLoader._CMD_FMT)
+
+    def _start(self) -> None:
+        # downloads the loader image into RAM and reads its configuration
+        self._target.cli_exec(f'load \\"{self._target.gdb_client.file_path(self._loader_elf)}\\"')
+        hdr = self._target.mem.read(self._ctrl, struct.calcsize(FlashLoader._CTRL_FMT))
+        magic, self._page_size, self._num_bufs, _, self._next, _ = struct.unpack(self._bo + FlashLoader._CTRL_FMT, hdr)
+        if magic != FlashLoader._MAGIC or self._num_bufs < 1:
+            raise DottException(f'Flash loader control block not found in RAM (magic: {magic:#x}).')
+        halt_when_idle = 0 if self._live is not None else 1
+        self._target.mem.write(self._ctrl + 12, struct.pack(self._bo + 'I', halt_when_idle))
+
+    def _resume(self) -> int:
+        # (re-)starts the loader and returns the stop count to wait for
+        sp, pc = self._sp & ~0x7, self._entry
+        self._target.exec_check([f'-data-evaluate-expression "$sp = {sp}"', f'-data-evaluate-expression "$pc = {pc}"'])
+        self._target.reg_cache_invalidate()
+        with self._target._cv_target_state:
+            stop_count = self._target._stop_count
+        self._target.exec('-exec-continue')
+        return stop_count + 1
+
+    @staticmethod
+    def _check(states: List[Tuple]) -> None:
+        # raises an exception if one of the given commands (op, addr, len, state, error) is not done
+        for op, addr, num, state, error in states:
+            what = 'erase' if op == FlashLoader._OP_ERASE else 'program'
+            if state == FlashLoader._STATE_ERROR:
+                raise DottException(f'Flash loader: {what} at {addr:#x} ({num} bytes) failed with error {error:#x}.')
+            if state != FlashLoader._STATE_DONE:
+                raise DottException(f'Flash loader: {what} at {addr:#x} ({num} bytes) not completed (state {state}).')
+
+    def _init_result(self) -> None:
+        hdr = self._target.mem.read(self._ctrl, struct.calcsize(FlashLoader._CTRL_FMT))
+        init_result = struct.unpack(self._bo + FlashLoader._CTRL_FMT, hdr)[5]
+        if init_result != 0:
+            raise DottException(f'Flash loader: port initialization failed with error {init_result:#x}.')
+
+    def _run_halted(self, cmds: List[Tuple[int, int, int, bytes]]) -> None:
+        cmd_fmt = self._bo + FlashLoader._CMD_FMT
+        cmd_sz = struct.calcsize(cmd_fmt)
+        for start in range(0, len(cmds), self._num_bufs):
+            group = cmds[start:start + self._num_bufs]
+            writes = []
+            for i, (op, addr, num, data) in enumerate(group):
+                slot = (self._next + i) % self._num_bufs
+                if len(data) > 0:
+                    writes.append(f'-data-write-memory-bytes {self._bufs + slot * self._page_size} "{data.hex()}"')
+                hdr = struct.pack(cmd_fmt, op, addr, num, FlashLoader._STATE_FULL, 0)
+                writes.append(f'-data-write-memory-bytes {self._cmd_addr(slot)} "{hdr.hex()}"')
+            self._target.exec_check(writes)
+            self._target._wait_stop_count(self._resume(), self._timeout * len(group))
+            if start == 0:
+                self._init_result()
+
+            content = self._target.mem.read(self._cmd_addr(0), self._num_bufs * cmd_sz)
+            states = [struct.unpack_from(cmd_fmt, content, ((self._next + i) % self._num_bufs) * cmd_sz)
+                      for i in range(len(group))]
+            FlashLoader._check(states)
+            self._next = (self._next + len(group)) % self._num_bufs
+
+    def _wait_slot(self, slot: int) -> None:
+        # waits (live mode) until the command of the given slot is done or the slot has not been used yet
+        cmd_fmt = self._bo + FlashLoader._CMD_FMT
+        deadline = time.time() + self._timeout
+        while True:
+            words = self._live.mem_read_32(self._cmd_addr(slot), 5)
+            state = struct.unpack(cmd_fmt, struct.pack(self._bo + '5I', *words))
+            if state[3] in (FlashLoader._STATE_EMPTY, FlashLoader._STATE_DONE, FlashLoader._STATE_ERROR):
+                if state[3] != FlashLoader._STATE_EMPTY:
+                    FlashLoader._check([state])
+                return
+            if time.time() > deadline:
+                raise DottException(f'Flash loader: command in slot {slot} did not complete within {self._timeout}s.')
+            time.sleep(FlashLoader._POLL_INTERVAL_SEC)
+
+    def _run_live(self, cmds: List[Tuple[int, int, int, bytes]]) -> None:
+        stop_count = self._resume()
+        with self._live.session():
+            for i, (op, addr, num, data) in enumerate(cmds + [(FlashLoader._OP_EXIT, 0, 0, b'')]):
+                slot = (self._next + i) % self._num_bufs
+                self._wait_slot(slot)
+                if i == 0:
+                    self._init_result_live()
+                if len(data) > 0:
+                    padded = data + b'\xff' * (-len(data) % 4)
+                    self._live.mem_write_32(self._bufs + slot * self._page_size,
+                                            list(struct.unpack(f'{self._bo}{len(padded) // 4}I', padded)))
+                # note: the state is written last such that the loader only sees complete commands
+                self._live.mem_write_32(self._cmd_addr(slot), [op, addr, num])
+                self._live.mem_write_32(self._cmd_addr(slot) + 12, [FlashLoader._STATE_FULL])
+        self._target._wait_stop_count(stop_count, self._timeout * self._num_bufs)
+        for slot in range(self._num_bufs):
+            self._wait_slot(slot)
+        self._next = (self._next + len(cmds) + 1) % self._num_bufs
+
+    def _init_result_live(self) -> None:
+        init_result = struct.unpack('i', struct.pack('I', self._live.mem_read_32(self._ctrl + 20)))[0]
+        if init_result not in (0, 1):  # note: 1 means that the port has not been initialized yet
+            raise DottException(f'Flash loader: port initialization failed with error {init_result:#x}.')
+
+    def program(self, image: FlashImage, sectors: List[int]) -> None:
+        """
+        Erases the given sectors of the image and programs their content.
+        """
+        if len(sectors) == 0:
+            return
+        time_start = time.time()
+        self._start()
+        cmds: List[Tuple[int, int, int, bytes]] = []
+        num_bytes = 0
+        for sector in sectors:
+            cmds.append((FlashLoader._OP_ERASE, sector, image.sector_size, b''))
+            for addr, data in image.sector_pieces(sector):
+                for pos in range(0, len(data), self._page_size):
+                    page = data[pos:pos + self._page_size]
+                    cmds.append((FlashLoader._OP_PROGRAM, addr + pos, len(page), page))
+                    num_bytes += len(page)
+        if self._live is not None:
+            self._run_live(cmds)
+        else:
+            self._run_halted(cmds)
+        self._target.reg_cache_invalidate()
+        secs = time.time() - time_start
+        log.info(f'Flash loader: {len(sectors)} sector(s), {num_bytes} bytes programmed in {secs:.2f}s '
+                 f'({num_bytes / 1024 / max(secs, 1e-6):.1f} KB/s).')
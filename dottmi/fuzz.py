@@ -0,0 +1,319 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Coverage-guided on-target fuzzing of firmware functions. The host mutates inputs taken from a corpus and uploads a
+# whole batch of them (one bulk write) into the on-target scratch memory (Target.mem). An on-target driver loop
+# (DOTT_fuzz_run in testhelpers.c) started via the resident call stub restores the state region from a pristine copy
+# and calls the function under test for every input of the batch. Coverage is collected with one-shot breakpoint
+# probes on the source lines of the fuzzed functions (see CoverageCollector) which record the index of the input
+# being processed; inputs which hit a new probe are added to the corpus. Since every probe only fires once, the
+# overhead of the coverage feedback vanishes as the coverage saturates and a batch costs a few round trips regardless
+# of its size. Faults (DOTT's fault hook), hangs (batch timeout) and failed checks are attributed to their input;
+# the memory state is restored from a snapshot afterwards. For example:
+#
+#   fuzz = Fuzzer(dt, 'example_StringLen', args=('data',), terminate=True, check=lambda d, r: r == len(d))
+#   report = fuzz.run(execs=20000)
+#   log.info(str(report))
+#   fuzz.close()
+#
+# Note: The coverage sweep of the session (coverage option in dott.ini) must not be active while fuzzing since both
+# use GDB's coverage probes.
+
+import random
+import struct
+import time
+from typing import Callable, List, NamedTuple, Tuple
+
+from dottmi.coverage import CoverageCollector
+from dottmi.dottexceptions import DottException, TargetFaultException
+from dottmi.utils import log
+
+# layout of DOTT_fuzz_desc_t and of an input record (see testhelpers.h)
+_DESC_FMT = 'IIIIIIII'
+_DESC_CURRENT_OFFSET = 28
+_RECORD_HEADER_SIZE = 20
+
+
+# -------------------------------------------------------------------------------------------------
+class FuzzFinding(NamedTuple):
+    data: bytes  # input which caused the finding
+    kind: str  # 'fault', 'hang' or 'check' (check function returned False)
+    pc: int  # program counter after the fault or hang (None for failed checks)
+    func: str  # function containing pc
+    message: str
+
+
+class FuzzReport(object):
+    """
+    Result of a fuzzing run (see Fuzzer.run).
+    """
+    def __init__(self, execs: int, elapsed: float, corpus: List[bytes], findings: List[FuzzFinding],
+                 num_covered: int, num_probes: int) -> None:
+        self.execs: int = execs
+        self.elapsed: float = elapsed
+        self.corpus: List[bytes] = corpus
+        self.findings: List[FuzzFinding] = findings
+        self.num_covered: int = num_covered
+        self.num_probes: int = num_probes
+
+    @property
+    def execs_per_sec(self) -> float:
+        return self.execs / self.elapsed if self.elapsed > 0 else 0.0
+
+    def __str__(self) -> str:
+        lines = [f'{self.execs} executions in {self.elapsed:.1f}s ({self.execs_per_sec:.0f}/s); corpus: '
+                 f'{len(self.corpus)} inputs; coverage: {self.num_covered} of {self.num_probes} probes; '
+                 f'{len(self.findings)} findings']
+        for f in self.findings:
+            where = f' at 0x{f.pc:08x} ({f.func})' if f.pc is not None else ''
+            lines.append(f'  {f.kind}{where}: {f.data[:32].hex()}{"..." if len(f.data) > 32 else ""} {f.message}')
+        return '\n'.join(lines)
+
+
+# -------------------------------------------------------------------------------------------------
+class Fuzzer(object):
+    """
+    Coverage-guided fuzzer of a target function (see module description). The function is called with up to four
+    arguments given by args: integers are passed as they are, 'data' is replaced by the address of the input data and
+    'len' by its size in bytes.
+    """
+    # values which commonly trigger boundary cases
+    _INTERESTING = [0x00, 0x01, 0x7f, 0x80, 0xff, 0x20, 0x40, 0x0a, 0x0d, 0x25]
+
+    def __init__(self, target: 'Target', func: str, args: Tuple = ('data', 'len'), max_len: int = 64,
+                 seeds: List[bytes] = None, state: Tuple[int, int] = None, scope: List[str] = None,
+                 coverage: bool = True, budget: int = None, batch_size: int = 256, timeout: float = 1.0,
+                 check: Callable[[bytes, int], bool] = None, terminate: bool = False, rng_seed: int = None) -> None:
+        """
+        Constructor. Allocates the batch buffers in the on-target scratch memory and starts the coverage probes.
+
+        Args:
+            target: Target (halted, with the scratch memory of the test initialized).
+            func: Name of the function under test.
+            args: Arguments of the function (at most four; integers, 'data' or 'len').
+            max_len: Maximum size of the generated inputs in bytes.
+            seeds: Initial corpus (default: a single empty input).
+            state: Memory region (address, size) restored on the target before each call (e.g., the variables of the
+                   module under test). Default: no restore between the calls of a batch.
+            scope: Functions whose source lines are probed for coverage. Default: func.
+            coverage: If False, inputs are generated blindly (no coverage probes).
+            budget: Number of breakpoints used as coverage probes (see CoverageCollector).
+            batch_size: Maximum number of inputs per batch (reduced if the scratch memory is too small).
+            timeout: Time (seconds) a batch may take before the current input is considered to hang.
+            check: Optional oracle called with each input and the function's return value; False is a finding.
+            terminate: If True, a zero byte is appended to the input data (e.g., for string functions). The size
+                       passed as 'len' does not include it.
+            rng_seed: Seed of the random generator (for reproducible runs).
+        """
+        if len(args) > 4 or any(not isinstance(a, int) and a not in ('data', 'len') for a in args):
+            raise DottException("Fuzzer args have to be at most four integers, 'data' or 'len'.")
+        self._dt: 'Target' = target
+        self._func: str = func
+        self._func_addr: int = target.symbols.addr(func) | 0x1
+        self._args: Tuple = tuple(args)
+        self._max_len: int = max_len
+        self._terminate: bool = terminate
+        self._timeout: float = timeout
+        self._check: Callable[[bytes, int], bool] = check
+        self._rng: random.Random = random.Random(rng_seed)
+        self._corpus: List[bytes] = [bytes(s)[:max_len] for s in seeds] if seeds else [b'']
+        self._findings: List[FuzzFinding] = []
+        self._finding_keys = set()
+        self._execs: int = 0
+        self._bo: str = '<' if target.byte_order == 'little' else '>'
+
+        self._record_size: int = _RECORD_HEADER_SIZE + (max_len + 1 + 3) // 4 * 4
+        desc_size = struct.calcsize(_DESC_FMT)
+        state_size = state[1] if state is not None else 0
+        free = target.mem.get_num_free_bytes() - desc_size - (state_size + 3) // 4 * 4 - 8  # note: alignment
+        self._batch_size: int = min(batch_size, free // (self._record_size + 4))
+        if self._batch_size < 1:
+            raise DottException('Not enough on-target memory available for the Fuzzer.')
+        self._alloc = target.mem.alloc(desc_size + self._batch_size * (4 + self._record_size))
+        self._desc_addr: int = self._alloc.addr
+        self._results_addr: int = self._desc_addr + desc_size
+        self._inputs_addr: int = self._results_addr + self._batch_size * 4
+        self._state: Tuple[int, int] = state
+        self._state_copy = None
+        self._snapshot = None
+        if state is not None:
+            self._state_copy = target.mem.alloc(state_size)
+            target.mem.write(self._state_copy.addr, target.mem.read(state[0], state_size))
+            self._snapshot = target.mem.snapshot([state])
+
+        self._cov: CoverageCollector = None
+        if coverage:
+            self._cov = CoverageCollector(target, CoverageCollector.MODE_LINE, budget, rearm=False,
+                                          functions=scope if scope is not None else [func],
+                                          tag_addr=self._desc_addr + _DESC_CURRENT_OFFSET)
+            self._cov.start()
+        log.debug(f'Fuzzer for {func}: batches of {self._batch_size} inputs (up to {max_len} bytes).')
+
+    @property
+    def corpus(self) -> List[bytes]:
+        return self._corpus
+
+    @property
+    def findings(self) -> List[FuzzFinding]:
+        return self._findings
+
+    def mutate(self, data: bytes) -> bytes:
+        """
+        Returns a mutation of the given input (one to four stacked byte-level mutations or a splice with another
+        corpus entry).
+        """
+        rng = self._rng
+        buf = bytearray(data)
+        for _ in range(1 << rng.randrange(3)):
+            op = rng.randrange(8)
+            pos = rng.randrange(len(buf)) if len(buf) > 0 else 0
+            if len(buf) == 0 or op == 0:  # insert random bytes
+                buf[pos:pos] = bytes(rng.randrange(256) for _ in range(rng.randint(1, 4)))
+            elif op == 1:  # flip a bit
+                buf[pos] ^= 1 << rng.randrange(8)
+            elif op == 2:  # interesting value
+                buf[pos] = rng.choice(Fuzzer._INTERESTING)
+            elif op == 3:  # random byte
+                buf[pos] = rng.randrange(256)
+            elif op == 4:  # small arithmetic
+                buf[pos] = (buf[pos] + rng.choice([-1, 1]) * rng.randint(1, 35)) & 0xff
+            elif op == 5:  # delete bytes
+                del buf[pos:pos + rng.randint(1, 4)]
+            elif op == 6:  # duplicate a chunk
+                n = rng.randint(1, min(8, len(buf) - pos))
+                buf[pos:pos] = buf[pos:pos + n]
+            else:  # splice with another corpus entry
+                other = rng.choice(self._corpus)
+                buf = buf[:pos] + bytearray(other[rng.randrange(len(other) + 1):])
+        return bytes(buf[:self._max_len])
+
+    def _call_args(self, data_addr: int, size: int) -> List[int]:
+        args = [data_addr if a == 'data' else size if a == 'len' else a & 0xffffffff for a in self._args]
+        return args + [0] * (4 - len(args))
+
+    def _upload(self, inputs: List[bytes]) -> None:
+        # writes descriptor and input table with one bulk write (results are written by the driver)
+        state = self._state if self._state is not None else (0, 0)
+        copy = self._state_copy.addr if self._state_copy is not None else 0
+        data = bytearray(struct.pack(self._bo + _DESC_FMT, self._func_addr, len(inputs), self._inputs_addr,
+                                     self._results_addr, state[0], copy, state[1], 0))
+        data += bytes(self._inputs_addr - self._results_addr)
+        addr = self._inputs_addr
+        for inp in inputs:
+            payload = inp + b'\0' if self._terminate else inp
+            padded = payload + bytes(-len(payload) % 4)
+            data += struct.pack(self._bo + 'IIIII', len(payload), *self._call_args(addr + _RECORD_HEADER_SIZE,
+                                                                                   len(inp)))
+            data += padded
+            addr += _RECORD_HEADER_SIZE + len(padded)
+        self._dt.mem.write(self._desc_addr, bytes(data))
+
+    def _finding(self, data: bytes, kind: str, pc: int, message: str) -> None:
+        func = self._dt.symbols.func_at(pc) if pc is not None else None
+        key = (kind, pc if kind != 'check' else data)
+        if key in self._finding_keys:
+            return
+        self._finding_keys.add(key)
+        self._findings.append(FuzzFinding(data, kind, pc, func, message))
+        log.info(f'Fuzzer finding ({kind}{f" in {func}" if func else ""}): {data.hex()} {message}')
+
+    def _run_batch(self, inputs: List[bytes]) -> int:
+        # runs the inputs on the target and returns the number of inputs which were processed (less than len(inputs)
+        # if an input faulted or hung; the remaining inputs are not executed)
+        self._upload(inputs)
+        failure = None
+        with self._dt.call_session():
+            try:
+                self._dt.call('DOTT_fuzz_run', self._desc_addr, timeout=self._timeout)
+            except TargetFaultException as ex:
+                failure = ('fault', str(ex))
+            except DottException as ex:
+                self._dt.halt()
+                failure = ('hang', str(ex))
+            if failure is not None:
+                pc = self._dt.eval('$pc')
+        num_done = len(inputs)
+        if failure is not None:
+            num_done = struct.unpack(self._bo + 'I', self._dt.mem.read(self._desc_addr + _DESC_CURRENT_OFFSET, 4))[0]
+            num_done = min(num_done, len(inputs) - 1)
+            self._finding(inputs[num_done], failure[0], pc, failure[1])
+            if self._snapshot is not None:
+                self._dt.mem.restore(self._snapshot)
+        results = struct.unpack(f'{self._bo}{num_done}I', self._dt.mem.read(self._results_addr, num_done * 4)) \
+            if num_done > 0 else ()
+        if self._check is not None:
+            for inp, ret in zip(inputs, results):
+                if not self._check(inp, ret):
+                    self._finding(inp, 'check', None, f'(returned {ret:#x})')
+        if self._cov is not None and self._cov.rotate() > 0:
+            # every probe fires once; the inputs which hit a probe (tag: index of the input) covered new code
+            new = sorted({idx for idx in self._cov.last_tags.values() if idx < num_done})
+            self._corpus += [inputs[idx] for idx in new]
+        self._execs += num_done + (failure is not None)
+        return num_done + (failure is not None)
+
+    def run(self, execs: int = None, duration: float = None, stop_on_finding: bool = False) -> FuzzReport:
+        """
+        Fuzzes the function until the given number of executions or the duration (seconds) is reached.
+
+        Args:
+            execs: Number of executions (function calls).
+            duration: Maximum duration of the run in seconds.
+            stop_on_finding: Stop at the first fault, hang or failed check.
+        """
+        if execs is None and duration is None:
+            raise DottException('Fuzzer.run requires execs or duration.')
+        start = time.perf_counter()
+        start_execs = self._execs
+        pending: List[bytes] = list(self._corpus)  # note: the seeds are executed as they are first
+        while (execs is None or self._execs - start_execs < execs) and \
+                (duration is None or time.perf_counter() - start < duration):
+            num = self._batch_size if execs is None else min(self._batch_size, execs - (self._execs - start_execs))
+            while len(pending) < num:
+                pending.append(self.mutate(self._rng.choice(self._corpus)))
+            batch, pending = pending[:num], pending[num:]
+            done = self._run_batch(batch)
+            pending = batch[done:] + pending
+            if stop_on_finding and len(self._findings) > 0:
+                break
+        return self.report(time.perf_counter() - start, self._execs - start_execs)
+
+    def report(self, elapsed: float = 0.0, execs: int = None) -> FuzzReport:
+        num_covered = self._cov.num_hit if self._cov is not None else 0
+        num_probes = self._cov.num_probes if self._cov is not None else 0
+        return FuzzReport(execs if execs is not None else self._execs, elapsed, list(self._corpus),
+                          list(self._findings), num_covered, num_probes)
+
+    def close(self) -> None:
+        """
+        Removes the coverage probes and frees the on-target memory of the fuzzer.
+        """
+        if self._cov is not None:
+            self._cov.stop()
+            self._cov = None
+        if self._alloc is not None:
+            self._dt.mem.free(self._alloc)
+            self._alloc = None
+        if self._state_copy is not None:
+            self._dt.mem.free(self._state_copy)
+            self._state_copy = None
+
+    def __enter__(self) -> 'Fuzzer':
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.close()
@@ -19,13 +19,18 @@
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
 import atexit
+import json
 import os
 import platform
+import shutil
 import signal
+import socket
 import subprocess
+import tempfile
 import time
 from abc import ABC, abstractmethod
-from pathlib import Path
+from pathlib import Path, PurePosixPath
+from typing import List
 
 import psutil
 from psutil import NoSuchProcess
@@ -33,10 +38,47 @@ from psutil import NoSuchProcess
 import dottmi.target
 from dottmi.dottexceptions import DottException
 from dottmi.gdb_mi import GdbMi
-from dottmi.gdbcontrollerdott import GdbControllerDott
+from dottmi.gdbcontrollerdott import GdbControllerBroker, GdbControllerDott
 from dottmi.utils import log
 
 
+class PortReservation(object):
+    """
+    Set of consecutive TCP ports reserved for a GDB server to be launched. The ports are kept bound until the
+    reservation is released (immediately before the GDB server is started) such that neither other DOTT targets
+    nor other processes can grab them in the meantime.
+    """
+    def __init__(self, addr: str, port: int, count: int) -> None:
+        """
+        Constructor. Tries to bind count ports starting at port.
+
+        Raises:
+            OSError if one of the ports is in use. The offset attribute of the exception holds the index of the
+            offending port.
+        """
+        self._port: int = port
+        self._sockets: List[socket.socket] = []
+        for offset in range(count):
+            s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            try:
+                s.bind((addr, port + offset))
+            except OSError as ex:
+                s.close()
+                self.release()
+                ex.offset = offset
+                raise ex
+            self._sockets.append(s)
+
+    @property
+    def port(self) -> int:
+        return self._port
+
+    def release(self) -> None:
+        for s in self._sockets:
+            s.close()
+        self._sockets = []
+
+
 class GdbServer(ABC):
     def __init__(self, addr, port, device_id):
         self._addr: str = addr
@@ -55,8 +97,38 @@ class GdbServer(ABC):
     def port(self):
         return self._port
 
+    @property
+    def serial_number(self) -> str:
+        # serial number of the debug probe (if known); used to identify the board connected via the GDB server
+        return None
+
+    @property
+    def speed(self) -> str:
+        # interface speed (kHz) the GDB server was launched with (None if not known or not launched by DOTT)
+        return getattr(self, '_speed', None)
+
+    def quirks(self) -> 'GdbServerQuirks':
+        """
+        Returns the quirks of this GDB server type or None if they are unknown (e.g., for servers not launched by
+        DOTT). In the latter case the quirks are determined by inspecting the target (see GdbServerQuirks).
+        """
+        return None
+
+    def is_alive(self) -> bool:
+        """
+        Returns False if the GDB server is known to have terminated (only detectable for servers launched by DOTT).
+        """
+        return True
+
+    def wait_ready(self, timeout: float = None) -> None:
+        """
+        Waits until a GDB server launched without blocking (see block argument of the constructor) accepts
+        connections. Does nothing for servers which are already running.
+        """
+        pass
+
     @abstractmethod
-    def _launch(self):
+    def _launch(self, block: bool = True):
         pass
 
     @abstractmethod
@@ -64,24 +136,36 @@ class GdbServer(ABC):
         pass
 
 
-class GdbServerJLink(GdbServer):
-    def __init__(self, gdb_svr_binary: str, addr: str, port: int, device_id: str, interface: str, endian: str,
-                 speed: str = '15000', serial_number: str = None, jlink_addr: str = None):
+class GdbServerProcess(GdbServer):
+    """
+    Base class of GDB servers which are launched by DOTT as local processes. Derived classes provide the server's
+    command line which has to make the server listen for GDB on the given port (and may use the two following ports).
+    """
+    # time (in seconds) the GDB server is given to open its listening port
+    STARTUP_TIMEOUT = 8
+
+    # name of the server used in log messages
+    NAME = 'GDB'
+
+    def __init__(self, gdb_svr_binary: str, addr: str, port: int, device_id: str, serial_number: str = None,
+                 block: bool = True, port_reservation: PortReservation = None):
         super().__init__(addr, port, device_id)
         self._srv_binary: str = gdb_svr_binary
         self._srv_process = None
-        self._target_interface: str = interface
-        self._target_endian: str = endian
-        self._speed: str = speed
+        self._srv_args: List[str] = []
         self._serial_number: str = serial_number
-        self._jlink_addr: str = jlink_addr
+        self._port_reservation: PortReservation = port_reservation
+        # servers which are not launched by DOTT may be of any type; their quirks are determined from the target
+        self._launched: bool = addr is None
         # Popen.__del__ occasionally complains under Windows about invalid file handles on interpreter shutdown.
         # This is somewhat distracting and is silenced by a custom delete function.
-        subprocess.Popen.__del_orig__ = subprocess.Popen.__del__
-        subprocess.Popen.__del__ = GdbServerJLink._popen_del
+        if not hasattr(subprocess.Popen, '__del_orig__'):
+            subprocess.Popen.__del_orig__ = subprocess.Popen.__del__
+            subprocess.Popen.__del__ = GdbServerProcess._popen_del
 
-        if self.addr is None:
-            self._launch()
+    @property
+    def serial_number(self) -> str:
+        return self._serial_number
 
     @staticmethod
     def _popen_del(instance):
@@ -90,84 +174,87 @@ class GdbServerJLink(GdbServer):
         except:
             pass
 
-    def _launch_internal(self):
-        args = [self._srv_binary, '-device', self.device_id, '-if', self._target_interface , '-endian',
-                self._target_endian, '-vd', '-noir', '-timeout', '2000', '-singlerun', '-silent', '-speed',
-                self._speed]
-        if self._jlink_addr is not None:
-            args.append('-select')
-            args.append(f'IP={self._jlink_addr}')
-        if self._serial_number is not None:
-            if self._jlink_addr is not None:
-                log.warn('JLink address and JLINK serial number given. Ignoring serial in favour of address.')
-            else:
-                args.append('-select')
-                args.append(f'USB={self._serial_number}')
-        if self._port is not None:
-            args.append('-port')
-            args.append(f'{self._port}')
+    @abstractmethod
+    def _args(self) -> List[str]:
+        pass
+
+    def _start(self, detach: bool = False):
+        # note: a detached server (see GdbServerJLink's persistent mode) survives the termination of this process
+        args = self._args()
         cflags = 0
         if platform.system() == 'Windows':
             cflags = subprocess.CREATE_NEW_PROCESS_GROUP
+            if detach:
+                cflags |= subprocess.DETACHED_PROCESS
+        self._srv_args = args
+        if self._port_reservation is not None:
+            # hand the reserved ports over to the GDB server
+            self._port_reservation.release()
+            self._port_reservation = None
         self._srv_process = subprocess.Popen(args, shell=False, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
-                                             creationflags=cflags)
+                                             creationflags=cflags, start_new_session=detach)
 
-        p = psutil.Process(self._srv_process.pid)
-        startup_done = False
+    def _listening(self) -> bool:
+        # note: the server's sockets are inspected instead of connecting to the port since some servers (e.g., J-Link
+        # started in single run mode) terminate when the probe connection is closed
         try:
-            # query the started process until it has opened a listening socket on the expected port
-            end_time = time.time() + 8
-            while not startup_done and time.time() < end_time:
-                for c in p.connections():
-                    if c.laddr.port == self.port:
-                        if self._serial_number is None:
-                            log.info(f'GDB server is now listening on port {self.port}!')
-                        else:
-                            log.info(f'GDB server (JLINK SN: {self._serial_number}) now listening on port {self.port}!')
-                        startup_done = True
-
-        except psutil.AccessDenied as ex:
-            # On Linux the situation was observed that from newly launched GDB server processes
-            # an AccessDenied exception is raised when accessing them with psutils. This exception
-            # is then 'thrown' upwards where it is handled by retrying to create the process.
-            raise ex
-
-        except (NoSuchProcess, PermissionError) as ex:
-            log.error('JLINK GDB server has terminated!')
-            end_time = time.time() + 2
-            res_poll = None
-            while not startup_done and time.time() < end_time:
-                res_poll = self._srv_process.poll()
-                if res_poll is not None:
-                    break
-            if res_poll is not None:
-                err_code, err_str = self._conv_jlink_error(self._srv_process.poll())
-                log.error(f'J-Link gdb server termination reason: {err_code:x} ({err_str})')
-                if err_code == -2:
-                    log.error('Already a JLINK GDB server instance running?')
-                if err_code == -5:
-                    log.debug('GDB server command line:')
-                    log.debug(' '.join(args))
-            raise DottException('Startup of JLINK gdb server failed!') from None
-
-        if not startup_done:
-            raise DottException('Startup of JLINK gdb server failed due to timeout!') from None
+            p = psutil.Process(self._srv_process.pid)
+            return any(c.laddr.port == self.port and c.status == psutil.CONN_LISTEN for c in p.connections('tcp'))
+        except psutil.AccessDenied:
+            # On Linux the situation was observed that newly launched GDB server processes raise an AccessDenied
+            # exception when accessing them with psutils. This is transient and the query is simply repeated.
+            return False
+        except NoSuchProcess:
+            return False
+
+    def _log_termination(self, ret_code: int) -> None:
+        log.error(f'{self.NAME} server exit code: {ret_code}')
+        log.debug('GDB server command line:')
+        log.debug(' '.join(self._srv_args))
+
+    def _startup_failed(self) -> None:
+        log.error(f'{self.NAME} GDB server has terminated!')
+        self._log_termination(self._srv_process.poll())
+        self._srv_process = None
+        raise DottException(f'Startup of {self.NAME} gdb server failed!') from None
+
+    def wait_ready(self, timeout: float = None) -> None:
+        if self._addr is not None or self._srv_process is None:
+            return
+
+        # poll with exponential backoff: fast servers are detected within a few milliseconds while slow ones (e.g.,
+        # several servers started at once) do not keep a CPU core busy
+        end_time = time.time() + (self.STARTUP_TIMEOUT if timeout is None else timeout)
+        delay = 0.005
+        while not self._listening():
+            if self._srv_process.poll() is not None:
+                self._startup_failed()
+            if time.time() >= end_time:
+                self.shutdown()
+                raise DottException(f'Startup of {self.NAME} gdb server failed due to timeout!') from None
+            time.sleep(delay)
+            delay = min(delay * 2, 0.1)
+
+        if self._serial_number is None:
+            log.info(f'GDB server is now listening on port {self.port}!')
         else:
-            self._addr = '127.0.0.1'
-            atexit.register(self.shutdown)
+            log.info(f'GDB server ({self.NAME} SN: {self._serial_number}) now listening on port {self.port}!')
+        self._addr = '127.0.0.1'
+        atexit.register(self.shutdown)
 
-    def _launch(self):
-        start_done: bool = False
-        while not start_done:
-            try:
-                self._launch_internal()
-                start_done = True
-            except psutil.AccessDenied as ex:
-                pass
+    def is_alive(self) -> bool:
+        return self._srv_process is None or self._srv_process.poll() is None
+
+    def _launch(self, block: bool = True):
+        self._start()
+        if block:
+            self.wait_ready()
 
     def shutdown(self):
+        if self._srv_process is not None and self._srv_process.poll() is not None:
+            self._srv_process = None  # already terminated (e.g., singlerun mode or lost probe connection)
         if self._srv_process is not None:
-            # if the gdb server is still running (despite being started in single run mode) it is terminated here
+            # if the gdb server is still running (e.g., despite being started in single run mode) it is terminated here
             try:
                 if platform.system() == 'Windows':
                     os.kill(self._srv_process.pid, signal.CTRL_BREAK_EVENT)
@@ -178,6 +265,170 @@ class GdbServerJLink(GdbServer):
                 self._srv_process.terminate()
             self._srv_process = None
 
+
+class GdbServerJLink(GdbServerProcess):
+    """
+    J-Link GDB server. By default, the server is started in single run mode, i.e., it terminates at the end of the
+    GDB session. In persistent mode (see gdb_server_persistent in dott.ini), one server per probe is started
+    detached from DOTT and is kept alive across pytest sessions; subsequent sessions connect to the running server
+    (if it was started with the same configuration) instead of paying process start, probe open and target connect
+    again. Running servers are recorded in state files (one per probe) in the given state directory. In attach only
+    mode (see attach_only in dott.ini), the server connects to the target without halting it.
+    """
+    NAME = 'JLINK'
+
+    def __init__(self, gdb_svr_binary: str, addr: str, port: int, device_id: str, interface: str, endian: str,
+                 speed: str = '15000', serial_number: str = None, jlink_addr: str = None, block: bool = True,
+                 port_reservation: PortReservation = None, persistent: bool = False, state_dir: str = None,
+                 attach_only: bool = False):
+        super().__init__(gdb_svr_binary, addr, port, device_id, serial_number, block, port_reservation)
+        self._attach_only: bool = attach_only
+        self._target_interface: str = interface
+        self._target_endian: str = endian
+        self._speed: str = speed
+        self._jlink_addr: str = jlink_addr
+        self._persistent: bool = persistent and addr is None
+        self._state_dir: str = state_dir
+        self._persistent_pid: int = None  # process id of a persistent server which was started by an earlier session
+
+        if self.addr is None:
+            if not (self._persistent and self._attach_persistent()):
+                self._launch(block)
+
+    def quirks(self) -> 'GdbServerQuirks':
+        return GdbServerQuirks.segger() if self._launched else None
+
+    def _state_file(self) -> Path:
+        probe = self._serial_number if self._serial_number is not None else (self._jlink_addr or 'default')
+        return Path(self._state_dir).joinpath(f'dott_jlink_server_{probe}.json'.replace(':', '_'))
+
+    def _attach_persistent(self) -> bool:
+        # connects to the persistent server of the probe if it is still running with the same command line
+        try:
+            with open(self._state_file(), 'r') as f:
+                state = json.load(f)
+            proc = psutil.Process(state['pid'])
+            listening = any(c.laddr.port == state['port'] and c.status == psutil.CONN_LISTEN
+                            for c in proc.connections('tcp'))
+        except (OSError, ValueError, KeyError, NoSuchProcess, psutil.AccessDenied):
+            return False
+        self._port, args = state['port'], self._args()
+        if not listening or state.get('args') != args:
+            log.info(f'Terminating persistent {self.NAME} GDB server (pid {state["pid"]}) which does not match the '
+                     f'current configuration.')
+            GdbServerJLink._kill(state['pid'])
+            return False
+        if self._port_reservation is not None:
+            self._port_reservation.release()
+            self._port_reservation = None
+        self._srv_args = args
+        self._persistent_pid = state['pid']
+        self._addr = '127.0.0.1'
+        log.info(f'Using persistent GDB server ({self.NAME} SN: {self._serial_number}) on port {self._port}.')
+        return True
+
+    @staticmethod
+    def _kill(pid: int) -> None:
+        try:
+            psutil.Process(pid).terminate()
+        except (NoSuchProcess, psutil.AccessDenied):
+            pass
+
+    def _launch(self, block: bool = True):
+        self._start(detach=self._persistent)
+        if block:
+            self.wait_ready()
+
+    def wait_ready(self, timeout: float = None) -> None:
+        launching = self._addr is None and self._srv_process is not None
+        try:
+            super().wait_ready(timeout)
+        except DottException:
+            if launching and self._persistent:
+                self.terminate()
+            raise
+        if launching and self._persistent:
+            try:
+                with open(self._state_file(), 'w') as f:
+                    json.dump({'pid': self._srv_process.pid, 'port': self._port, 'args': self._srv_args}, f)
+            except OSError as ex:
+                log.warn(f'Unable to record persistent GDB server ({ex}); it is not reused by later sessions.')
+
+    def is_alive(self) -> bool:
+        if self._persistent_pid is not None:
+            return psutil.pid_exists(self._persistent_pid)
+        return super().is_alive()
+
+    def shutdown(self):
+        if self._persistent:
+            self._srv_process = None  # note: the persistent server is kept running for subsequent sessions
+            return
+        super().shutdown()
+
+    def terminate(self) -> None:
+        """
+        Terminates the server (also a persistent one), e.g., if the connection to it has been lost.
+        """
+        if self._persistent:
+            pid = self._persistent_pid if self._persistent_pid is not None else \
+                (self._srv_process.pid if self._srv_process is not None else None)
+            if pid is not None:
+                GdbServerJLink._kill(pid)
+            try:
+                self._state_file().unlink()
+            except OSError:
+                pass
+            self._persistent_pid = None
+            self._persistent = False
+        super().shutdown()
+
+    @staticmethod
+    def stop_persistent(state_dir: str) -> int:
+        """
+        Terminates all persistent J-Link GDB servers recorded in the given state directory (e.g., at the end of a CI
+        job). Returns the number of servers terminated.
+        """
+        num = 0
+        for state_file in Path(state_dir).glob('dott_jlink_server_*.json'):
+            try:
+                with open(state_file, 'r') as f:
+                    GdbServerJLink._kill(json.load(f)['pid'])
+                state_file.unlink()
+                num += 1
+            except (OSError, ValueError, KeyError):
+                pass
+        return num
+
+    def _args(self) -> List[str]:
+        args = [self._srv_binary, '-device', self.device_id, '-if', self._target_interface , '-endian',
+                self._target_endian, '-vd', '-noir', '-timeout', '2000', '-silent', '-speed', self._speed]
+        if not self._persistent:
+            args.append('-singlerun')
+        if self._attach_only:
+            args.append('-nohalt')
+        if self._jlink_addr is not None:
+            args.append('-select')
+            args.append(f'IP={self._jlink_addr}')
+        if self._serial_number is not None:
+            if self._jlink_addr is not None:
+                log.warn('JLink address and JLINK serial number given. Ignoring serial in favour of address.')
+            else:
+                args.append('-select')
+                args.append(f'USB={self._serial_number}')
+        if self._port is not None:
+            args.append('-port')
+            args.append(f'{self._port}')
+        return args
+
+    def _log_termination(self, ret_code: int) -> None:
+        err_code, err_str = self._conv_jlink_error(ret_code)
+        log.error(f'J-Link gdb server termination reason: {err_code:x} ({err_str})')
+        if err_code == -2:
+            log.error('Already a JLINK GDB server instance running?')
+        if err_code == -5:
+            log.debug('GDB server command line:')
+            log.debug(' '.join(self._srv_args))
+
     def _conv_jlink_error(self, jlink_error: int) -> (int, str):
         bits_in_word = 32
         err_code = jlink_error - (1 << bits_in_word)
@@ -203,23 +454,191 @@ class GdbServerJLink(GdbServer):
         return err_code, err_str
 
 
+class GdbServerOpenOCD(GdbServerProcess):
+    """
+    OpenOCD GDB server (e.g., for CMSIS-DAP or ST-Link probes). The probe, transport and target are defined by the
+    given OpenOCD configuration file(s) (see scripts/oocd). The configuration files must neither set the GDB, telnet
+    and TCL ports (they are set by DOTT to the three consecutive ports starting at port) nor call init.
+    """
+    NAME = 'OpenOCD'
+
+    def __init__(self, gdb_svr_binary: str, addr: str, port: int, device_id: str, cfg_files: List[str],
+                 speed: str = None, serial_number: str = None, block: bool = True,
+                 port_reservation: PortReservation = None):
+        super().__init__(gdb_svr_binary, addr, port, device_id, serial_number, block, port_reservation)
+        self._cfg_files: List[str] = cfg_files
+        self._speed: str = speed
+
+        if self.addr is None:
+            self._launch(block)
+
+    def quirks(self) -> 'GdbServerQuirks':
+        return GdbServerQuirks.openocd() if self._launched else None
+
+    def _args(self) -> List[str]:
+        args = [self._srv_binary,
+                '-c', 'bindto 127.0.0.1',
+                '-c', f'gdb_port {self._port}',
+                '-c', f'telnet_port {self._port + 1}',
+                '-c', f'tcl_port {self._port + 2}']
+        if self._serial_number is not None:
+            args += ['-c', f'adapter serial {self._serial_number}']
+        for cfg_file in self._cfg_files:
+            args += ['-f', cfg_file]
+        if self._speed is not None:
+            args += ['-c', f'adapter speed {self._speed}']
+        return args
+
+
+class GdbServerPyOCD(GdbServerProcess):
+    """
+    pyOCD GDB server (e.g., for CMSIS-DAP probes). The device_id is the pyOCD target type (see 'pyocd list --targets').
+    In attach only mode (see attach_only in dott.ini), the server connects to the target without halting it.
+    """
+    NAME = 'pyOCD'
+
+    def __init__(self, gdb_svr_binary: str, addr: str, port: int, device_id: str, speed: str = None,
+                 serial_number: str = None, block: bool = True, port_reservation: PortReservation = None,
+                 attach_only: bool = False):
+        super().__init__(gdb_svr_binary, addr, port, device_id, serial_number, block, port_reservation)
+        self._speed: str = speed
+        self._attach_only: bool = attach_only
+
+        if self.addr is None:
+            self._launch(block)
+
+    def quirks(self) -> 'GdbServerQuirks':
+        return GdbServerQuirks.pyocd() if self._launched else None
+
+    def _args(self) -> List[str]:
+        args = [self._srv_binary, 'gdbserver', '--port', f'{self._port}', '--telnet-port', f'{self._port + 1}',
+                '--target', self.device_id]
+        if self._speed is not None:
+            # note: the speed is given in kHz (as for J-Link) while pyOCD expects Hz
+            args += ['--frequency', f'{int(self._speed) * 1000}']
+        if self._serial_number is not None:
+            args += ['--uid', self._serial_number]
+        if self._attach_only:
+            args += ['--connect', 'attach']
+        return args
+
+
+class GdbServerQemu(GdbServerProcess):
+    """
+    GDB stub of a QEMU system emulator instance (e.g., qemu-system-arm) launched by DOTT. The emulated board is given
+    by the QEMU machine (e.g., microbit for a Cortex-M0 or mps2-an385 for a Cortex-M3; see 'qemu-system-arm -machine
+    help'). The emulator starts halted (-S) with empty memory; the firmware is downloaded by GDB as for real boards.
+    Each instance is an independent board, i.e., any number of instances can run in parallel (e.g., with
+    pytest-xdist) on a single host.
+    """
+    NAME = 'QEMU'
+
+    def __init__(self, gdb_svr_binary: str, addr: str, port: int, device_id: str, machine: str,
+                 extra_args: List[str] = None, snapshots: bool = False, block: bool = True,
+                 port_reservation: PortReservation = None):
+        super().__init__(gdb_svr_binary, addr, port, device_id, None, block, port_reservation)
+        self._machine: str = machine
+        self._extra_args: List[str] = extra_args if extra_args is not None else []
+        # scratch qcow2 image which holds the machine snapshots (QEMU's savevm requires a snapshot-capable drive)
+        self._snapshot_file: str = None
+        if snapshots and self.addr is None:
+            self._snapshot_file = self._snapshot_image_create()
+
+        if self.addr is None:
+            self._launch(block)
+
+    @property
+    def machine(self) -> str:
+        return self._machine
+
+    def quirks(self) -> 'GdbServerQuirks':
+        return GdbServerQuirks.qemu() if self._launched else None
+
+    def _snapshot_image_create(self) -> str:
+        qemu_img = shutil.which('qemu-img', path=os.path.dirname(self._srv_binary)) or shutil.which('qemu-img')
+        if qemu_img is None:
+            raise DottException('qemu-img (required for machine snapshots) not found.')
+        fd, file_name = tempfile.mkstemp(prefix='dott_snap_', suffix='.qcow2')
+        os.close(fd)
+        subprocess.check_call([qemu_img, 'create', '-f', 'qcow2', file_name, '1M'], stdout=subprocess.DEVNULL)
+        return file_name
+
+    def _args(self) -> List[str]:
+        args = [self._srv_binary, '-machine', self._machine, '-S', '-gdb', f'tcp:127.0.0.1:{self._port}',
+                '-display', 'none', '-monitor', 'none', '-serial', 'null']
+        if self._snapshot_file is not None:
+            args += ['-drive', f'if=none,id=dott_snapshots,format=qcow2,file={self._snapshot_file}']
+        return args + self._extra_args
+
+    def shutdown(self):
+        super().shutdown()
+        if self._snapshot_file is not None:
+            try:
+                os.remove(self._snapshot_file)
+            except OSError:
+                pass
+            self._snapshot_file = None
+
+
+class GdbServerRenode(GdbServerProcess):
+    """
+    GDB server of a Renode emulator instance launched by DOTT. The emulated board is given by a Renode platform
+    description (e.g., @platforms/cpus/stm32f072.repl). The GDB server starts the emulation once GDB connects; the
+    firmware is downloaded by GDB as for real boards. The Renode monitor listens on the port following the GDB port.
+    """
+    NAME = 'Renode'
+
+    def __init__(self, gdb_svr_binary: str, addr: str, port: int, device_id: str, platform: str,
+                 block: bool = True, port_reservation: PortReservation = None):
+        super().__init__(gdb_svr_binary, addr, port, device_id, None, block, port_reservation)
+        self._platform: str = platform
+
+        if self.addr is None:
+            self._launch(block)
+
+    @property
+    def platform(self) -> str:
+        return self._platform
+
+    def quirks(self) -> 'GdbServerQuirks':
+        return GdbServerQuirks.renode() if self._launched else None
+
+    def _args(self) -> List[str]:
+        script = (f'mach create "dott_{self._port}"; machine LoadPlatformDescription {self._platform}; '
+                  f'machine StartGdbServer {self._port} true')
+        return [self._srv_binary, '--disable-xwt', '--hide-log', '--port', f'{self._port + 1}', '-e', script]
+
+
 class GdbClient(object):
 
     # Create a new gdb instance
     # gdb_client_binary ... binary of gdb client (in PATH or with full-qualified path)
     # gdb_server_addr   ... gdb server address as supplied to GDB's target command (e.g., remote :2331);
     #                       if none DOTT tries to start a Segger GDB server instance and connect to it
-    def __init__(self, gdb_client_binary: str) -> None:
+    # gdb_broker_addr   ... optional address (host:port) of a GDB broker (dottmi.gdb_broker) which provides
+    #                       already started GDB instances; if the broker can't be reached, GDB is started locally
+    # agent             ... optional connection to a DOTT agent (dottmi.agent) which provides the GDB instance and
+    #                       relays all GDB traffic; GDB then runs on the agent's host
+    def __init__(self, gdb_client_binary: str, gdb_broker_addr: str = None,
+                 agent: 'dottmi.agent.AgentClient' = None) -> None:
         self._gdb_client_binary: str = gdb_client_binary
+        self._gdb_broker_addr: str = gdb_broker_addr
+        self._agent = agent
         self._mi_controller: GdbControllerDott = None
         self._gdb_mi: GdbMi = None
+        self._gdb_cmds_loaded: bool = False
+        GdbClient.prepare_env()
 
-        # set Python 2.7 (used for GDB commands) path such that gdb subprocess actually finds it
+    @staticmethod
+    def prepare_env() -> None:
+        # set Python 2.7 (used for GDB commands) path such that gdb subprocess actually finds it. If PYTHONPATH27 is
+        # not set, GDB is expected to embed Python 3 (e.g., arm-none-eabi-gdb of the Arm GNU Toolchain 11 and newer)
+        # which uses its own runtime; only DOTT's package path is passed in this case.
         my_env = os.environ.copy()
         python27_path = os.environ.get('PYTHONPATH27')
-        if python27_path is None:
-            raise Exception('PYTHONPATH27 not set. Can not load gdb command support. Aborting.')
-        if platform.system() == 'Windows':
+        if python27_path is None or python27_path.strip() == '':
+            os.environ['PYTHONPATH'] = ''
+        elif platform.system() == 'Windows':
             os.environ['PATH'] = f'{python27_path};{my_env["PATH"]}'
             os.environ['PYTHONPATH'] = '%s;%s\\lib;%s\\lib\\site-packages;%s\\DLLs' % ((python27_path,) * 4)
         else:
@@ -228,37 +647,212 @@ class GdbClient(object):
         my_dir = os.path.dirname(os.path.realpath(__file__))
         os.environ['PYTHONPATH'] += os.pathsep + str(Path(my_dir + '/..'))
 
+    @staticmethod
+    def gdb_cmds_script() -> str:
+        """
+        Returns the path of the script with DOTT's custom GDB commands. Note: GDB expects paths to be POSIX-formatted.
+        """
+        return str(PurePosixPath(Path(__file__).absolute().parent.joinpath('./gdb_cmds.py')))
+
     # connect to already running gdb server
     def connect(self) -> None:
         # create 'GDB Machine Interface' instance and put it async mode
-        self._mi_controller = GdbControllerDott([self._gdb_client_binary, "--nx", "--quiet", "--interpreter=mi3"])
+        self._mi_controller = None
+        if self._agent is not None:
+            self._mi_controller = GdbControllerBroker(None, None, sock=self._agent.mi_socket())
+            # agent-provided GDB instances have DOTT's custom GDB commands already loaded
+            self._gdb_cmds_loaded = True
+            log.info(f'Using GDB instance provided by DOTT agent at {self._agent.addr}.')
+        elif self._gdb_broker_addr is not None:
+            try:
+                host, port = self._gdb_broker_addr.rsplit(':', 1)
+                self._mi_controller = GdbControllerBroker(host, int(port))
+                # brokered GDB instances have DOTT's custom GDB commands already loaded
+                self._gdb_cmds_loaded = True
+                log.info(f'Using GDB instance provided by GDB broker at {self._gdb_broker_addr}.')
+            except (OSError, ValueError) as ex:
+                log.warn(f'Could not get GDB instance from GDB broker at {self._gdb_broker_addr} ({ex}). '
+                         f'Starting GDB locally.')
+        if self._mi_controller is None:
+            self._mi_controller = GdbControllerDott([self._gdb_client_binary, "--nx", "--quiet", "--interpreter=mi3"])
         self._gdb_mi = GdbMi(self._mi_controller)
 
     @property
     def gdb_mi(self) -> GdbMi:
         return self._gdb_mi
 
+    @property
+    def gdb_cmds_loaded(self) -> bool:
+        return self._gdb_cmds_loaded
+
+    @property
+    def agent(self) -> 'dottmi.agent.AgentClient':
+        return self._agent
+
+    @property
+    def replay(self) -> 'SessionReplay':
+        # recorded session served by this client (see GdbClientReplay)
+        return None
+
+    def file_path(self, file_name: str) -> str:
+        """
+        Returns the path under which GDB can access the given local file (if GDB runs on the host of a DOTT agent, the
+        file is transferred to the agent host).
+        """
+        if self._agent is None:
+            return file_name
+        return self._agent.file_path(file_name)
+
+
+class GdbClientReplay(GdbClient):
+    """
+    GDB client which does not start GDB but serves a session which has been recorded before (see dottmi.gdb_replay).
+    """
+    def __init__(self, replay_file: str) -> None:
+        super().__init__(None)
+        self._replay_file: str = replay_file
+        self._replay: 'SessionReplay' = None
+
+    def connect(self) -> None:
+        from dottmi.gdb_replay import GdbControllerReplay, SessionReplay
+        self._replay = SessionReplay(self._replay_file)
+        self._mi_controller = GdbControllerReplay(self._replay)
+        self._gdb_mi = GdbMi(self._mi_controller)
+
+    @property
+    def replay(self) -> 'SessionReplay':
+        return self._replay
+
+
+class GdbServerReplay(GdbServer):
+    """
+    Placeholder for the GDB server of a replayed session (see GdbClientReplay). No server is started. The quirks have
+    to be those of the recorded server type such that the same commands are issued as during the recording.
+    """
+    def __init__(self, device_id: str, serial_number: str = None, quirks: 'GdbServerQuirks' = None):
+        super().__init__('127.0.0.1', 0, device_id)
+        self._serial_number: str = serial_number
+        self._quirks: GdbServerQuirks = quirks
+
+    @property
+    def serial_number(self) -> str:
+        return self._serial_number
+
+    def quirks(self) -> 'GdbServerQuirks':
+        return self._quirks
+
+    def _launch(self, block: bool = True):
+        pass
+
+    def shutdown(self):
+        pass
+
+
+class GdbServerAgent(GdbServer):
+    """
+    J-Link GDB server which has been launched by a DOTT agent on a remote host (see dottmi.agent). The address and
+    port are those seen by the GDB instance of the session (which also runs on the agent host). The server is
+    terminated by the agent once the session's connection is closed.
+    """
+    def __init__(self, agent: 'dottmi.agent.AgentClient', port: int, device_id: str, serial_number: str = None):
+        super().__init__('127.0.0.1', port, device_id)
+        self._agent = agent
+        self._serial_number: str = serial_number
+
+    @property
+    def serial_number(self) -> str:
+        return self._serial_number
+
+    @property
+    def agent(self) -> 'dottmi.agent.AgentClient':
+        return self._agent
+
+    def quirks(self) -> 'GdbServerQuirks':
+        return GdbServerQuirks.segger()
+
+    def is_alive(self) -> bool:
+        return self._agent is not None and not self._agent.closed
+
+    def _launch(self, block: bool = True):
+        pass
+
+    def shutdown(self):
+        if self._agent is not None:
+            self._agent.close()
+            self._agent = None
+
 
 class GdbServerQuirks(object):
+    @staticmethod
+    def segger() -> 'GdbServerQuirks':
+        return GdbServerQuirks('xpsr',
+                               'monitor clrbp',
+                               'monitor reset',
+                               'monitor flash device {device}',
+                               'monitor flash download=1',
+                               'monitor flash breakpoints={enable:d}',
+                               monitor_speed='monitor speed {khz}')
+
+    @staticmethod
+    def openocd() -> 'GdbServerQuirks':
+        # note: OpenOCD selects the flash driver via its configuration and downloads to flash transparently
+        return GdbServerQuirks('xPSR',
+                               'monitor rbp all',
+                               'monitor reset halt',
+                               monitor_speed='monitor adapter speed {khz}')
+
+    @staticmethod
+    def pyocd() -> 'GdbServerQuirks':
+        # note: pyOCD has no command to remove all breakpoints; GDB's own breakpoints are deleted by GDB
+        return GdbServerQuirks('xpsr',
+                               None,
+                               'monitor reset halt')
+
+    @staticmethod
+    def qemu() -> 'GdbServerQuirks':
+        # note: monitor commands are handled by QEMU's human monitor; system_reset keeps the (stopped) CPU halted and
+        # debugger writes also modify emulated flash (no flash programming needed)
+        return GdbServerQuirks('xpsr',
+                               None,
+                               'monitor system_reset',
+                               monitor_snapshot_save='monitor savevm {name}',
+                               monitor_snapshot_load='monitor loadvm {name}')
+
+    @staticmethod
+    def renode() -> 'GdbServerQuirks':
+        # note: monitor commands are handled by the Renode monitor
+        return GdbServerQuirks('xpsr',
+                               None,
+                               'monitor machine Reset')
+
     @staticmethod
     def instantiate_quirks(dt: 'dottmi.target.Target') -> 'GdbServerQuirks':
+        quirks = dt.gdb_server.quirks() if dt.gdb_server is not None else None
+        if quirks is not None:
+            return quirks
+
         # Segger and OpenOCD don't agree on xpsr naming (all lowercase vs. mixed case)
         if 'xPSR' in dt.reg_get_names():
             log.info("Using OpenOCD's xPSR naming")
-            return GdbServerQuirks('xPSR',
-                                   'monitor rbp all',
-                                   'monitor reset halt')
+            return GdbServerQuirks.openocd()
         else:
             # falling back to Segger's naming as default
             log.info("Using Segger's xpsr naming")
-            return GdbServerQuirks('xpsr',
-                                   'monitor clrbp',
-                                   'monitor reset')
+            return GdbServerQuirks.segger()
 
-    def __init__(self, xpsr_name: str, monitor_clr_all_bps: str, monitor_reset: str):
+    def __init__(self, xpsr_name: str, monitor_clr_all_bps: str, monitor_reset: str,
+                 monitor_flash_device: str = None, monitor_flash_download: str = None,
+                 monitor_flash_breakpoints: str = None, monitor_snapshot_save: str = None,
+                 monitor_snapshot_load: str = None, monitor_speed: str = None):
         self._xpsr_name: str = xpsr_name
         self._monitor_clr_all_bps: str = monitor_clr_all_bps
         self._monitor_reset: str = monitor_reset
+        self._monitor_flash_device: str = monitor_flash_device
+        self._monitor_flash_download: str = monitor_flash_download
+        self._monitor_flash_breakpoints: str = monitor_flash_breakpoints
+        self._monitor_snapshot_save: str = monitor_snapshot_save
+        self._monitor_snapshot_load: str = monitor_snapshot_load
+        self._monitor_speed: str = monitor_speed
 
     @property
     def xpsr_name(self) -> str:
@@ -266,8 +860,39 @@ class GdbServerQuirks(object):
 
     @property
     def monitor_clear_all_bps(self) -> str:
+        # None if not supported by the GDB server
         return self._monitor_clr_all_bps
 
     @property
     def monitor_reset(self) -> str:
         return self._monitor_reset
+
+    def monitor_flash_device(self, device: str) -> str:
+        # None if the GDB server does not need to be told the device (flash algorithm)
+        return None if self._monitor_flash_device is None else self._monitor_flash_device.format(device=device)
+
+    @property
+    def monitor_flash_download(self) -> str:
+        # None if the GDB server does not need flash download to be enabled explicitly
+        return self._monitor_flash_download
+
+    def monitor_flash_breakpoints(self, enable: bool) -> str:
+        # None if the GDB server does not support (switching) flash breakpoints
+        if self._monitor_flash_breakpoints is None:
+            return None
+        return self._monitor_flash_breakpoints.format(enable=enable)
+
+    def monitor_snapshot_save(self, name: str) -> str:
+        # None if the GDB server does not support machine snapshots (emulators only, see Target.snapshot_save)
+        return None if self._monitor_snapshot_save is None else self._monitor_snapshot_save.format(name=name)
+
+    def monitor_snapshot_load(self, name: str) -> str:
+        return None if self._monitor_snapshot_load is None else self._monitor_snapshot_load.format(name=name)
+
+    def monitor_speed(self, khz: int) -> str:
+        # None if the GDB server does not support changing the interface speed at runtime (see Target.clock_phase)
+        return None if self._monitor_speed is None else self._monitor_speed.format(khz=khz)
+
+    @property
+    def supports_snapshots(self) -> bool:
+        return self._monitor_snapshot_save is not None and self._monitor_snapshot_load is not None
@@ -0,0 +1,178 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# GDB broker daemon which keeps a pool of already started ('warm') GDB instances and hands them over to DOTT
+# sessions. Every GDB instance in the pool is started with DOTT's custom GDB commands already loaded. A DOTT session
+# obtains a GDB instance by connecting to the broker (config option gdb_broker_addr in dott.ini). The broker then
+# relays all MI traffic between the session and the GDB instance. Once the session disconnects (or GDB exits) the
+# instance is discarded and the pool is refilled with a fresh instance. GDB instances are never reused across
+# sessions since their state (symbols, breakpoints, target connection) is not reset reliably.
+# Note: The broker waits on GDB's pipes using select and is therefore only supported on POSIX hosts.
+#
+# Usage: python -m dottmi.gdb_broker [--gdb <gdb client binary>] [--port <port>] [--pool-size <n>]
+
+import argparse
+import logging
+import os
+import queue
+import select
+import socket
+import subprocess
+import threading
+import time
+from pathlib import Path
+
+import dottmi.target  # note: dottmi.target and dottmi.gdb import each other; dottmi.target must be loaded first
+from dottmi.gdb import GdbClient
+from dottmi.gdbcontrollerdott import GdbControllerBroker
+from dottmi.utils import log, log_setup
+
+
+class GdbBroker(object):
+    # default TCP port the broker listens on
+    DEFAULT_PORT = 20090
+
+    # maximum time to wait for a newly started GDB instance to present its first MI prompt
+    GDB_STARTUP_TIMEOUT_SEC = 20.0
+
+    def __init__(self, gdb_client_binary: str, port: int = DEFAULT_PORT, pool_size: int = 2,
+                 addr: str = '127.0.0.1') -> None:
+        self._gdb_client_binary: str = gdb_client_binary
+        self._addr: str = addr
+        self._port: int = port
+        self._pool: queue.Queue = queue.Queue(maxsize=pool_size)
+        self._running: bool = False
+        GdbClient.prepare_env()
+
+    def _spawn_gdb(self) -> subprocess.Popen:
+        args = [self._gdb_client_binary, '--nx', '--quiet', '--interpreter=mi3',
+                '-ex', f'source {GdbClient.gdb_cmds_script()}']
+        proc = subprocess.Popen(args, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                bufsize=0)
+
+        # Consume all startup output up to the first MI prompt such that the session only sees responses to its
+        # own commands.
+        out = b''
+        end_time = time.time() + GdbBroker.GDB_STARTUP_TIMEOUT_SEC
+        while b'(gdb)' not in out:
+            remaining = end_time - time.time()
+            readable, _, _ = select.select([proc.stdout], [], [], max(remaining, 0))
+            chunk = os.read(proc.stdout.fileno(), 4096) if readable else b''
+            if not chunk:
+                proc.kill()
+                raise RuntimeError(f'GDB instance did not start up properly: {out}')
+            out += chunk
+        return proc
+
+    def _refill(self) -> None:
+        while self._running:
+            try:
+                proc = self._spawn_gdb()
+            except (OSError, RuntimeError) as ex:
+                log.error(f'Failed to start GDB instance: {ex}')
+                time.sleep(1)
+                continue
+            self._pool.put(proc)  # blocks while the pool is full
+
+    def _get_gdb(self) -> subprocess.Popen:
+        while True:
+            proc = self._pool.get()
+            if proc.poll() is None:
+                return proc
+            log.warn('Discarding GDB instance from pool which has terminated.')
+
+    @staticmethod
+    def _relay(conn: socket.socket, proc: subprocess.Popen) -> None:
+        gdb_out = proc.stdout.fileno()
+        try:
+            while True:
+                readable, _, _ = select.select([conn, gdb_out], [], [])
+                if conn in readable:
+                    data = conn.recv(65536)
+                    if not data:
+                        break
+                    while data:
+                        data = data[os.write(proc.stdin.fileno(), data):]
+                if gdb_out in readable:
+                    data = os.read(gdb_out, 65536)
+                    if not data:
+                        break
+                    conn.sendall(data)
+        except OSError:
+            pass
+        finally:
+            conn.close()
+            if proc.poll() is None:
+                proc.kill()
+            proc.wait()
+
+    def _serve_session(self, conn: socket.socket) -> None:
+        proc = self._get_gdb()
+        log.info(f'Handing over GDB instance (pid {proc.pid}).')
+        try:
+            conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            conn.sendall(GdbControllerBroker.ACK + b'\n')
+        except OSError:
+            conn.close()
+            proc.kill()
+            proc.wait()
+            return
+        GdbBroker._relay(conn, proc)
+        log.info(f'GDB instance (pid {proc.pid}) released.')
+
+    def serve_forever(self) -> None:
+        self._running = True
+        threading.Thread(target=self._refill, name='GdbBrokerRefill', daemon=True).start()
+
+        srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        srv.bind((self._addr, self._port))
+        srv.listen()
+        log.info(f'GDB broker listening on {self._addr}:{self._port}.')
+        try:
+            while self._running:
+                conn, _ = srv.accept()
+                threading.Thread(target=self._serve_session, args=(conn,), name='GdbBrokerSession',
+                                 daemon=True).start()
+        finally:
+            self._running = False
+            srv.close()
+
+
+def main() -> None:
+    default_gdb = None
+    if 'DOTTGDBPATH' in os.environ:
+        default_gdb = str(Path(f'{os.environ["DOTTGDBPATH"]}/arm-none-eabi-gdb-py'))
+
+    parser = argparse.ArgumentParser(description='DOTT GDB broker which provides pre-started GDB instances.')
+    parser.add_argument('--gdb', default=default_gdb, help='GDB client binary (default: from DOTTGDBPATH)')
+    parser.add_argument('--port', type=int, default=GdbBroker.DEFAULT_PORT, help='TCP port to listen on')
+    parser.add_argument('--pool-size', type=int, default=2, help='number of GDB instances kept ready')
+    args = parser.parse_args()
+    if args.gdb is None:
+        parser.error('GDB client binary not given and DOTTGDBPATH not set.')
+
+    logging.basicConfig(format='%(asctime)s %(message)s')
+    log_setup()
+    GdbBroker(args.gdb, args.port, args.pool_size).serve_forever()
+
+
+if __name__ == '__main__':
+    main()
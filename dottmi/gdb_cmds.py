@@ -18,15 +18,84 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import binascii
+import collections
 import json
+import random
+import re
+import struct
+import sys
+import time
 
 import gdb
 
-from dottmi.gdb_shared import BpMsg, BpSharedConf
+from dottmi.gdb_shared import BpMsg, BpSharedConf, DottResp, ShmChannel
 
 # global variable with all no-stop breakpoints
 no_stop_bps = []
 
+# channel (socket) to the MI process shared by all intercept points
+bp_channel_sock = None
+
+
+def skip_hit(bp):
+    """
+    Applies condition and ignore count (see dott-bp-nostop-filter) of a no-stop breakpoint. GDB does not allow to set
+    a condition for Python breakpoints with a stop method; hence both are evaluated at the beginning of stop.
+    Returns True if the hit shall be ignored.
+    """
+    cond = getattr(bp, 'dott_condition', None)
+    if cond is not None:
+        try:
+            if not bool(gdb.parse_and_eval(cond)):
+                return True
+        except Exception as ex:
+            print('DOTT BP: evaluation of condition "%s" failed (%s)' % (cond, str(ex)))
+    if getattr(bp, 'dott_ignore_count', 0) > 0:
+        bp.dott_ignore_count -= 1
+        return True
+    return False
+
+
+class EvalCache(object):
+    """
+    Memoizes the values of side-effect free expressions evaluated while the target is stopped at an intercept point
+    (e.g., the same expressions evaluated repeatedly by the test while the intercept point is reached). The cache is
+    valid for one stop (stop_id); it is invalidated when a new stop begins, when the target resumes and whenever memory
+    or registers might have been modified (write messages, executed commands, expressions with side effects).
+    """
+    # assignments, increments/decrements and function calls (e.g., 'a = 1', 'a += 1', 'i++' or 'func(1)')
+    _SIDE_EFFECT_RE = re.compile(r'(?<![=!<>])=(?!=)|<<=|>>=|\+\+|--|[A-Za-z_]\w*\s*\(')
+
+    def __init__(self):
+        self.stop_id = 0
+        self._values = {}
+        for name in ('stop', 'cont', 'memory_changed', 'register_changed'):
+            event = getattr(gdb.events, name, None)  # note: memory/register events are not available in older GDBs
+            if event is not None:
+                event.connect(self.invalidate)
+
+    def invalidate(self, *args):
+        self.stop_id += 1
+        self._values.clear()
+
+    def eval(self, expr):
+        val = self._values.get(expr)
+        if val is not None:
+            return val
+        if EvalCache._SIDE_EFFECT_RE.search(expr) is not None:
+            val = gdb.parse_and_eval(expr)
+            self.invalidate()
+            return val
+        val = gdb.parse_and_eval(expr)
+        if hasattr(val, 'fetch_lazy'):
+            val.fetch_lazy()  # note: reads the target memory now (lazy values would be read on every conversion)
+        self._values[expr] = val
+        return val
+
+
+eval_cache = EvalCache()
+
 
 # ----------------------------------------------------------------------------------------------------------------------
 class DottCmdInterceptPointCmds(gdb.Command):
@@ -45,6 +114,8 @@ class DottCmdInterceptPointCmds(gdb.Command):
                 return self._func
 
             def stop(self):
+                if skip_hit(self):
+                    return False
                 try:
                     if self._commands is not None:
                         for cmd in self._commands:
@@ -71,41 +142,104 @@ class DottCmdInterceptPointCmds(gdb.Command):
             print(str(ex))
 
 
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdInterceptPointChannel(gdb.Command):
+    def __init__(self):
+        super(DottCmdInterceptPointChannel, self).__init__("dott-bp-channel", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        global bp_channel_sock
+        try:
+            # connect to the channel server socket (in MI process) which is shared by all intercept points
+            import socket
+            if bp_channel_sock is not None:
+                bp_channel_sock.close()
+            # endpoint is either 'unix:<socket path>', 'shm:<doorbell socket path> <shared file>' or a TCP port
+            if arg.startswith('shm:'):
+                sock_path, shm_file = arg[len('shm:'):].split(' ', 1)
+                doorbell = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                channel = ShmChannel(shm_file, doorbell, ShmChannel.RING_GDB)
+                doorbell.connect(sock_path)
+                bp_channel_sock = channel
+            elif arg.startswith('unix:'):
+                bp_channel_sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                bp_channel_sock.connect(arg[len('unix:'):])
+            else:
+                bp_channel_sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+                bp_channel_sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                bp_channel_sock.connect((BpSharedConf.GDB_CMD_SERVER_ADDR, int(arg)))
+            bp_channel_sock.setblocking(True)
+        except Exception as ex:
+            bp_channel_sock = None
+            print(str(ex))
+
+
 # ----------------------------------------------------------------------------------------------------------------------
 class DottCmdInterceptPoint(gdb.Command):
     def __init__(self):
         super(DottCmdInterceptPoint, self).__init__("dott-bp-nostop-tcp", gdb.COMMAND_USER)
 
+    @staticmethod
+    def eval_to_str(res):
+        try:
+            return str(int(res))
+        except:
+            return str(res)
+
+    @staticmethod
+    def eval_to_py(res):
+        # convert gdb.Value into int, float or str (in this order of preference)
+        if res.type.strip_typedefs().code == gdb.TYPE_CODE_FLT:
+            return float(res)
+        try:
+            return int(res)
+        except:
+            return str(res)
+
+    @staticmethod
+    def mem_to_bytes(mem):
+        # gdb.Membuf supports the buffer protocol (Python 3) or can be converted to str (Python 2)
+        try:
+            return memoryview(mem).tobytes()
+        except TypeError:
+            return str(mem)
+
     def invoke(self, arg, from_tty):
 
         # No-Stop Breakpoint implementation executed in GDB context
         class InterceptPoint(gdb.Breakpoint):
-            def __init__(self, func, sock):
-                super(InterceptPoint, self).__init__(func)
+            def __init__(self, func, bp_id, wp_class=None):
+                if wp_class is None:
+                    super(InterceptPoint, self).__init__(func)
+                else:
+                    super(InterceptPoint, self).__init__(func, gdb.BP_WATCHPOINT, wp_class)
                 self._func = func
-                self._sock = sock
-                self._sock.setblocking(True)
+                self._bp_id = bp_id
+                self._closed = False
 
             def get_func(self):
                 return self._func
 
             def close(self):
-                self._sock.close()
-                self._sock = None
+                # note: the channel is shared by all intercept points and hence is not closed here
+                self._closed = True
+
+            def _send(self, msg_type, payload=None):
+                BpMsg(msg_type, payload, self._bp_id).send_to_socket(bp_channel_sock)
 
             def stop(self):
                 stop_inferior = False
 
-                if self._sock is None:
+                if self._closed or bp_channel_sock is None or skip_hit(self):
                     return stop_inferior
 
+                eval_cache.invalidate()  # new stop
                 try:
-                    msg = BpMsg(BpMsg.MSG_TYPE_HIT) # bp hit message
-                    msg.send_to_socket(self._sock)
+                    self._send(BpMsg.MSG_TYPE_HIT)  # bp hit message
 
                     while True:
                         # blocks until new message is available
-                        msg = BpMsg.read_from_socket(self._sock)
+                        msg = BpMsg.read_from_socket(bp_channel_sock)
 
                         # 'finish' message - resume target execution
                         if msg.get_type() == BpMsg.MSG_TYPE_FINISH_CONT:
@@ -116,32 +250,60 @@ class DottCmdInterceptPoint(gdb.Command):
                         elif msg.get_type() == BpMsg.MSG_TYPE_EXEC:
                             try:
                                 cmd = msg.get_payload().decode('ascii')
+                                eval_cache.invalidate()
                                 gdb.execute(cmd)
-                                msg = BpMsg(BpMsg.MSG_TYPE_RESP)  # response message
-                                msg.send_to_socket(self._sock)
+                                self._send(BpMsg.MSG_TYPE_RESP)  # response message
                             except Exception as ex:
-                                msg = BpMsg(BpMsg.MSG_TYPE_EXCEPT, str(ex))  # exception message
-                                msg.send_to_socket(self._sock)
+                                self._send(BpMsg.MSG_TYPE_EXCEPT, str(ex))  # exception message
 
                         # 'eval' message
                         elif msg.get_type() == BpMsg.MSG_TYPE_EVAL:
                             try:
                                 cmd = msg.get_payload().decode('ascii')
-                                res = gdb.parse_and_eval(cmd)
-                                pload = None
+                                res = DottCmdInterceptPoint.eval_to_py(eval_cache.eval(cmd))
+                                self._send(BpMsg.MSG_TYPE_RESP, BpMsg.encode_value(res))
+                            except Exception as ex:
+                                self._send(BpMsg.MSG_TYPE_EXCEPT, str(ex))  # exception message
+
+                        # memory read/write messages (raw binary data)
+                        elif msg.get_type() in (BpMsg.MSG_TYPE_READ_MEM, BpMsg.MSG_TYPE_WRITE_MEM):
+                            try:
+                                hdr_len = struct.calcsize(BpMsg.MEM_FMT)
+                                addr, num_bytes = struct.unpack(BpMsg.MEM_FMT, msg.get_payload()[:hdr_len])
+                                inferior = gdb.selected_inferior()
+                                if msg.get_type() == BpMsg.MSG_TYPE_READ_MEM:
+                                    data = DottCmdInterceptPoint.mem_to_bytes(inferior.read_memory(addr, num_bytes))
+                                    self._send(BpMsg.MSG_TYPE_RESP, data)
+                                else:
+                                    eval_cache.invalidate()
+                                    inferior.write_memory(addr, msg.get_payload()[hdr_len:hdr_len + num_bytes])
+                                    self._send(BpMsg.MSG_TYPE_RESP)
+                            except Exception as ex:
+                                self._send(BpMsg.MSG_TYPE_EXCEPT, str(ex))
+
+                        # batched 'eval' message
+                        elif msg.get_type() == BpMsg.MSG_TYPE_EVAL_MANY:
+                            results = []
+                            for cmd in json.loads(msg.get_payload().decode('ascii')):
                                 try:
-                                    pload = str(int(res))
-                                except:
-                                    pload = str(res)
-                                msg = BpMsg(BpMsg.MSG_TYPE_RESP, pload)  # response message
-                                msg.send_to_socket(self._sock)
+                                    results.append([True, DottCmdInterceptPoint.eval_to_str(eval_cache.eval(cmd))])
+                                except Exception as ex:
+                                    results.append([False, str(ex)])
+                            self._send(BpMsg.MSG_TYPE_RESP, json.dumps(results))
+
+                        # batched 'execute' message
+                        elif msg.get_type() == BpMsg.MSG_TYPE_EXEC_MANY:
+                            cmd = None
+                            eval_cache.invalidate()
+                            try:
+                                for cmd in json.loads(msg.get_payload().decode('ascii')):
+                                    gdb.execute(cmd)
+                                self._send(BpMsg.MSG_TYPE_RESP)
                             except Exception as ex:
-                                msg = BpMsg(BpMsg.MSG_TYPE_EXCEPT, str(ex))  # exception message
-                                msg.send_to_socket(self._sock)
+                                self._send(BpMsg.MSG_TYPE_EXCEPT, '%s (command: %s)' % (str(ex), cmd))
 
                         else:
-                            msg = BpMsg(BpMsg.MSG_TYPE_EXCEPT, 'Unknown breakpoint message type')
-                            msg.send_to_socket(self._sock)
+                            self._send(BpMsg.MSG_TYPE_EXCEPT, 'Unknown breakpoint message type')
 
                 except Exception as ex:
                     print('Execution of NoStopBreakpoint in GDB context failed.')
@@ -151,13 +313,95 @@ class DottCmdInterceptPoint(gdb.Command):
                 return stop_inferior
 
         try:
-            # connect to server socket (in MI process)
-            import socket
-            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-            sock.connect(('127.0.0.1', BpSharedConf.GDB_CMD_SERVER_PORT))
+            if bp_channel_sock is None:
+                raise Exception('Intercept point channel is not connected (see dott-bp-channel).')
+
+            # arguments: <bp_id> [-w|-r|-a] <location or watch expression>
+            bp_id, location = arg.split(' ', 1)
+            wp_class = None
+            wp_classes = {'-w': gdb.WP_WRITE, '-r': gdb.WP_READ, '-a': gdb.WP_ACCESS}
+            if location[:3].strip() in wp_classes and location[2:3] == ' ':
+                wp_class = wp_classes[location[:2]]
+                location = location[3:]
 
             # create breakpoint and add it to the list
-            bp = InterceptPoint(arg, sock)
+            bp = InterceptPoint(location, int(bp_id), wp_class)
+            global no_stop_bps
+            no_stop_bps.append(bp)
+
+        except Exception as ex:
+            print(str(ex))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdInterceptPointActions(gdb.Command):
+    def __init__(self):
+        super(DottCmdInterceptPointActions, self).__init__("dott-bp-nostop-actions", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+
+        # Intercept point which executes a list of declarative actions entirely in GDB's context. The results of
+        # every hit are streamed to the MI process without waiting for a response.
+        class InterceptPointActions(gdb.Breakpoint):
+            def __init__(self, func, bp_id, actions):
+                super(InterceptPointActions, self).__init__(func)
+                self._func = func
+                self._bp_id = bp_id
+                self._actions = actions
+                self._hits = 0
+                self._counts = {}
+                self._closed = False
+
+            def get_func(self):
+                return self._func
+
+            def close(self):
+                self._closed = True
+
+            def _run_actions(self, record):
+                eval_cache.invalidate()  # new stop
+                for a in self._actions:
+                    if 'if' in a and not bool(eval_cache.eval(a['if'])):
+                        continue
+                    if a['op'] == 'read':
+                        record['vals'].append(DottCmdInterceptPoint.eval_to_str(eval_cache.eval(a['expr'])))
+                    elif a['op'] == 'set':
+                        eval_cache.eval('%s = %s' % (a['expr'], a['val']))
+                    elif a['op'] == 'count':
+                        self._counts[a['name']] = self._counts.get(a['name'], 0) + 1
+                    elif a['op'] == 'ret':
+                        if a.get('val') is None:
+                            gdb.execute('return')
+                        else:
+                            gdb.execute('return %s' % a['val'])
+                        break  # the frame is gone; remaining actions are skipped
+
+            def stop(self):
+                if self._closed or bp_channel_sock is None or skip_hit(self):
+                    return False
+
+                self._hits += 1
+                record = {'hit': self._hits, 'vals': []}
+                try:
+                    self._run_actions(record)
+                except Exception as ex:
+                    record['err'] = str(ex)
+                record['counts'] = self._counts
+
+                try:
+                    BpMsg(BpMsg.MSG_TYPE_RECORD, json.dumps(record), self._bp_id).send_to_socket(bp_channel_sock)
+                except Exception as ex:
+                    print('Sending intercept point record failed (%s).' % str(ex))
+                return False
+
+        try:
+            if bp_channel_sock is None:
+                raise Exception('Intercept point channel is not connected (see dott-bp-channel).')
+
+            # arguments: <bp_id> <hex-encoded JSON with location and actions>
+            bp_id, spec = arg.split(' ', 1)
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            bp = InterceptPointActions(spec['location'], int(bp_id), spec['actions'])
             global no_stop_bps
             no_stop_bps.append(bp)
 
@@ -165,6 +409,161 @@ class DottCmdInterceptPoint(gdb.Command):
             print(str(ex))
 
 
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdTracePoint(gdb.Command):
+    def __init__(self):
+        super(DottCmdTracePoint, self).__init__("dott-bp-trace", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+
+        # Trace point which records hits (hit number, timestamp and values of the configured expressions) in a
+        # GDB-side ring buffer. Nothing is sent to the MI process on a hit; the buffer is drained on demand.
+        class TracePoint(gdb.Breakpoint):
+            def __init__(self, func, trace_id, exprs, buffer_size):
+                super(TracePoint, self).__init__(func)
+                self._func = func
+                self._trace_id = trace_id
+                self._exprs = exprs
+                self._hits = 0
+                self._records = collections.deque(maxlen=buffer_size)
+
+            def get_func(self):
+                return self._func
+
+            def get_trace_id(self):
+                return self._trace_id
+
+            def close(self):
+                pass
+
+            def drain(self, clear):
+                records = list(self._records)
+                if clear:
+                    self._records.clear()
+                return {'hits': self._hits, 'records': records}
+
+            def stop(self):
+                if skip_hit(self):
+                    return False
+                self._hits += 1
+                vals = []
+                for expr in self._exprs:
+                    try:
+                        vals.append(DottCmdInterceptPoint.eval_to_str(gdb.parse_and_eval(expr)))
+                    except Exception as ex:
+                        vals.append('<error: %s>' % str(ex))
+                self._records.append([self._hits, time.time(), vals])
+                return False
+
+        try:
+            # arguments: <trace_id> <hex-encoded JSON with location, expressions and buffer size>
+            trace_id, spec = arg.split(' ', 1)
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            bp = TracePoint(spec['location'], int(trace_id), spec['exprs'], spec['buffer_size'])
+            global no_stop_bps
+            no_stop_bps.append(bp)
+
+        except Exception as ex:
+            print(str(ex))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdSnapshotPoint(gdb.Command):
+    def __init__(self):
+        super(DottCmdSnapshotPoint, self).__init__("dott-bp-snapshot", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+
+        # Snapshot point which reads the raw memory of a list of regions on every hit (one read per region, no
+        # expression evaluation) and streams it to the MI process without waiting for a response.
+        class SnapshotPoint(gdb.Breakpoint):
+            def __init__(self, func, bp_id, regions, wp_class=None):
+                if wp_class is None:
+                    super(SnapshotPoint, self).__init__(func)
+                else:
+                    super(SnapshotPoint, self).__init__(func, gdb.BP_WATCHPOINT, wp_class)
+                self._func = func
+                self._bp_id = bp_id
+                self._regions = regions
+                self._hits = 0
+                self._closed = False
+
+            def get_func(self):
+                return self._func
+
+            def close(self):
+                self._closed = True
+
+            def stop(self):
+                if self._closed or bp_channel_sock is None or skip_hit(self):
+                    return False
+                self._hits += 1
+                try:
+                    inferior = gdb.selected_inferior()
+                    data = b''.join([DottCmdInterceptPoint.mem_to_bytes(inferior.read_memory(addr, size))
+                                     for addr, size in self._regions])
+                    payload = struct.pack(BpMsg.SNAPSHOT_FMT, self._hits, time.time(), 0) + data
+                except Exception as ex:
+                    payload = struct.pack(BpMsg.SNAPSHOT_FMT, self._hits, time.time(), 1) + str(ex).encode('utf-8')
+                try:
+                    BpMsg(BpMsg.MSG_TYPE_SNAPSHOT, payload, self._bp_id).send_to_socket(bp_channel_sock)
+                except Exception as ex:
+                    print('Sending snapshot failed (%s).' % str(ex))
+                return False
+
+        try:
+            if bp_channel_sock is None:
+                raise Exception('Intercept point channel is not connected (see dott-bp-channel).')
+
+            # arguments: <bp_id> <hex-encoded JSON with location, watchpoint class (or null) and regions>
+            bp_id, spec = arg.split(' ', 1)
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            wp_classes = {'-w': gdb.WP_WRITE, '-r': gdb.WP_READ, '-a': gdb.WP_ACCESS}
+            bp = SnapshotPoint(spec['location'], int(bp_id), spec['regions'], wp_classes.get(spec['watch']))
+            global no_stop_bps
+            no_stop_bps.append(bp)
+
+        except Exception as ex:
+            print(str(ex))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdTracePointDrain(gdb.Command):
+    def __init__(self):
+        super(DottCmdTracePointDrain, self).__init__("dott-bp-trace-drain", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        resp_id, trace_id, clear = arg.split(' ')
+        for bp in no_stop_bps:
+            if hasattr(bp, 'get_trace_id') and bp.get_trace_id() == int(trace_id):
+                trace = json.dumps(bp.drain(clear == '1'))
+                print(DottResp.format(int(resp_id), 'dott-bp-trace-drain', 'OK',
+                                      binascii.hexlify(trace.encode()).decode()))
+                return
+        print(DottResp.format(int(resp_id), 'dott-bp-trace-drain', 'ERR',
+                              binascii.hexlify(b'unknown trace point').decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdInterceptPointFilter(gdb.Command):
+    def __init__(self):
+        super(DottCmdInterceptPointFilter, self).__init__("dott-bp-nostop-filter", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        try:
+            # argument: hex-encoded JSON with location, condition and ignore count
+            spec = json.loads(binascii.unhexlify(arg.strip()).decode('utf-8'))
+            # note: the most recently created breakpoint for the location is used
+            for bp in reversed(no_stop_bps):
+                if spec['location'].strip() == bp.get_func().strip():
+                    bp.dott_condition = spec['condition']
+                    bp.dott_ignore_count = spec['ignore_count']
+                    return
+            print('DOTT BP: no breakpoint at %s found' % spec['location'])
+        except Exception as ex:
+            print(str(ex))
+
+
 # ----------------------------------------------------------------------------------------------------------------------
 class DottCmdInterceptPointDelete(gdb.Command):
     def __init__(self):
@@ -177,7 +576,7 @@ class DottCmdInterceptPointDelete(gdb.Command):
             # note: iterating over a copy of the list
             for bp in no_stop_bps[:]:
                 bp.delete()  # delete function of gdb.Breakpoint
-                bp.close()  # close down socket connection to MI process
+                bp.close()  # detach breakpoint from channel to MI process
                 no_stop_bps.remove(bp)
 
         else:
@@ -185,7 +584,25 @@ class DottCmdInterceptPointDelete(gdb.Command):
             for bp in no_stop_bps[:]:
                 if arg.strip() == bp.get_func().strip():
                     bp.delete()  # delete function of gdb.Breakpoint
-                    bp.close()  # close down socket connection to MI process
+                    bp.close()  # detach breakpoint from channel to MI process
+                    no_stop_bps.remove(bp)
+                    break
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdInterceptPointDeleteMany(gdb.Command):
+    def __init__(self):
+        super(DottCmdInterceptPointDeleteMany, self).__init__("dott-bp-nostop-delete-many", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        # arguments: <hex-encoded JSON list of locations>; deletes one no-stop breakpoint per location (as
+        # dott-bp-nostop-delete <location> does) such that many breakpoints are deleted in a single exchange
+        global no_stop_bps
+        for location in json.loads(binascii.unhexlify(arg.strip()).decode('utf-8')):
+            for bp in no_stop_bps[:]:
+                if location.strip() == bp.get_func().strip():
+                    bp.delete()  # delete function of gdb.Breakpoint
+                    bp.close()  # detach breakpoint from channel to MI process
                     no_stop_bps.remove(bp)
                     break
 
@@ -198,14 +615,877 @@ class DottCmdIsRunning(gdb.Command):
     def invoke(self, arg, from_tty):
         try:
             gdb.parse_and_eval('$pc')
-            print('DOTT_RESP, %d, dott-is-running, NO, DOTT_RESP_END' % int(arg))
+            print(DottResp.format(int(arg), 'dott-is-running', 'NO'))
+        except Exception as ex:
+            print(DottResp.format(int(arg), 'dott-is-running', 'YES', str(ex).replace(',', ';')))
+
+
+class DottCmdPythonVersion(gdb.Command):
+    def __init__(self):
+        super(DottCmdPythonVersion, self).__init__("dott-python-version", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        print(DottResp.format(int(arg), 'dott-python-version', 'OK', '%d.%d.%d' % tuple(sys.version_info[:3])))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdTypeLayout(gdb.Command):
+    def __init__(self):
+        super(DottCmdTypeLayout, self).__init__("dott-type-layout", gdb.COMMAND_USER)
+
+    @staticmethod
+    def _layout(t):
+        st = t.strip_typedefs()
+        ret = {'type': str(t), 'size': st.sizeof}
+
+        if st.code in (gdb.TYPE_CODE_STRUCT, gdb.TYPE_CODE_UNION):
+            ret['fields'] = []
+            for f in st.fields():
+                fl = DottCmdTypeLayout._layout(f.type)
+                fl['name'] = f.name
+                fl['offset'] = f.bitpos // 8
+                if f.bitsize > 0:
+                    fl['bitpos'] = f.bitpos % 8
+                    fl['bitsize'] = f.bitsize
+                ret['fields'].append(fl)
+        elif st.code == gdb.TYPE_CODE_ARRAY:
+            lo, hi = st.range()
+            ret['count'] = hi - lo + 1
+            ret['elem'] = DottCmdTypeLayout._layout(st.target())
+        elif st.code == gdb.TYPE_CODE_FLT:
+            ret['kind'] = 'float'
+        elif st.code == gdb.TYPE_CODE_PTR:
+            ret['kind'] = 'int'
+            ret['signed'] = False
+        elif st.code in (gdb.TYPE_CODE_INT, gdb.TYPE_CODE_ENUM, gdb.TYPE_CODE_BOOL, gdb.TYPE_CODE_CHAR):
+            ret['kind'] = 'int'
+            ret['signed'] = bool(int(gdb.parse_and_eval('((%s)-1) < 0' % str(t))))
+            if st.code == gdb.TYPE_CODE_ENUM:
+                ret['values'] = [int(f.enumval) for f in st.fields()]
+        elif st.code == gdb.TYPE_CODE_FUNC:
+            ret['kind'] = 'func'
+            ret['params'] = [DottCmdTypeLayout._layout(f.type) for f in st.fields()]
+            rt = st.target()
+            ret['ret'] = DottCmdTypeLayout._layout(rt) if rt.strip_typedefs().code != gdb.TYPE_CODE_VOID else None
+        else:
+            ret['kind'] = 'raw'
+        return ret
+
+    def invoke(self, arg, from_tty):
+        resp_id, type_name = arg.split(' ', 1)
+        try:
+            # note: using a pointer cast allows any type expression (e.g., 'struct xyz' or typedef names)
+            t = gdb.parse_and_eval('(%s*)0' % type_name).type.target()
+            layout = json.dumps(DottCmdTypeLayout._layout(t))
+            print(DottResp.format(int(resp_id), 'dott-type-layout', 'OK',
+                                  binascii.hexlify(layout.encode()).decode()))
+        except Exception as ex:
+            print(DottResp.format(int(resp_id), 'dott-type-layout', 'ERR',
+                                  binascii.hexlify(str(ex).encode()).decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdEvalValue(gdb.Command):
+    def __init__(self):
+        super(DottCmdEvalValue, self).__init__("dott-eval-value", gdb.COMMAND_USER)
+
+    @staticmethod
+    def _to_py(v):
+        # convert gdb.Value into nested Python objects (structs and unions: dicts, arrays: lists)
+        t = v.type.strip_typedefs()
+        if t.code in (gdb.TYPE_CODE_STRUCT, gdb.TYPE_CODE_UNION):
+            ret = {}
+            for f in t.fields():
+                if f.is_base_class or f.name is None:
+                    # members of base classes and anonymous structs/unions are merged into the dict
+                    ret.update(DottCmdEvalValue._to_py(v[f]))
+                elif not hasattr(f, 'bitpos'):
+                    continue  # static member
+                else:
+                    ret[f.name] = DottCmdEvalValue._to_py(v[f.name])
+            return ret
+        if t.code == gdb.TYPE_CODE_ARRAY:
+            lo, hi = t.range()
+            return [DottCmdEvalValue._to_py(v[i]) for i in range(lo, hi + 1)]
+        if t.code == gdb.TYPE_CODE_REF:
+            return DottCmdEvalValue._to_py(v.referenced_value())
+        if t.code == gdb.TYPE_CODE_FLT:
+            return float(v)
+        if t.code == gdb.TYPE_CODE_BOOL:
+            return bool(int(v))
+        if t.code in (gdb.TYPE_CODE_INT, gdb.TYPE_CODE_ENUM, gdb.TYPE_CODE_CHAR, gdb.TYPE_CODE_PTR):
+            return int(v)
+        return str(v)
+
+    def invoke(self, arg, from_tty):
+        resp_id, expr = arg.split(' ', 1)
+        try:
+            # note: the expression is passed hex-encoded such that it may contain quotes
+            v = gdb.parse_and_eval(binascii.unhexlify(expr.strip()).decode())
+            res = json.dumps(DottCmdEvalValue._to_py(v))
+            print(DottResp.format(int(resp_id), 'dott-eval-value', 'OK', binascii.hexlify(res.encode()).decode()))
+        except Exception as ex:
+            print(DottResp.format(int(resp_id), 'dott-eval-value', 'ERR',
+                                  binascii.hexlify(str(ex).encode()).decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdStopRegs(gdb.Command):
+    """
+    Registers which are captured at every stop of an inferior (e.g., pc, sp and xPSR; see Target.halt). They are sent
+    as DottResp line with the response id given at registration such that the host has them together with the stop
+    notification (one register fetch which GDB's register cache serves for the frame of the stop anyway).
+    """
+    def __init__(self):
+        super(DottCmdStopRegs, self).__init__("dott-stop-regs", gdb.COMMAND_USER)
+        self._regs = {}  # inferior number -> (response id, register names)
+        gdb.events.stop.connect(self._on_stop)
+
+    def _on_stop(self, event):
+        entry = self._regs.get(gdb.selected_inferior().num)
+        if entry is None:
+            return
+        try:
+            regs = dict((r, int(gdb.parse_and_eval('$' + r)) & 0xffffffff) for r in entry[1])
+            res = binascii.hexlify(json.dumps(regs).encode()).decode()
+            print(DottResp.format(entry[0], 'dott-stop-regs', 'OK', res))
         except Exception as ex:
-            print('DOTT_RESP, %d, dott-is-running, YES, %s, DOTT_RESP_END' % (int(arg), str(ex)))
+            print(DottResp.format(entry[0], 'dott-stop-regs', 'ERR', binascii.hexlify(str(ex).encode()).decode()))
+
+    def invoke(self, arg, from_tty):
+        # arguments: response id, id of the stop responses and hex-encoded JSON list with the register names
+        resp_id, stop_id, regs = arg.split(' ')
+        self._regs[gdb.selected_inferior().num] = (int(stop_id), json.loads(binascii.unhexlify(regs).decode()))
+        print(DottResp.format(int(resp_id), 'dott-stop-regs', 'OK'))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdRunScript(gdb.Command):
+    """
+    Executes a script of steps (see Target.run_script) in GDB's context and returns the results of all steps in one
+    response. Steps: ['eval', expr], ['set', lvalue, value], ['exec', cli_cmd], ['read', addr_expr, num_bytes] and
+    ['write', addr_expr, hex_data]. Execution stops at the first failing step.
+    """
+    def __init__(self):
+        super(DottCmdRunScript, self).__init__("dott-run-script", gdb.COMMAND_USER)
+
+    @staticmethod
+    def _step(step):
+        op = step[0]
+        if op == 'eval':
+            return DottCmdEvalValue._to_py(gdb.parse_and_eval(step[1]))
+        if op == 'set':
+            gdb.parse_and_eval('(%s) = (%s)' % (step[1], step[2]))
+            return None
+        if op == 'exec':
+            return gdb.execute(step[1], to_string=True)
+        addr = int(gdb.parse_and_eval(step[1]))
+        if op == 'read':
+            mem = gdb.selected_inferior().read_memory(addr, step[2])
+            return binascii.hexlify(DottCmdInterceptPoint.mem_to_bytes(mem)).decode()
+        if op == 'write':
+            gdb.selected_inferior().write_memory(addr, binascii.unhexlify(step[2]))
+            return None
+        raise Exception('unknown step %s' % op)
+
+    def invoke(self, arg, from_tty):
+        resp_id, steps = arg.split(' ', 1)
+        results = []
+        try:
+            for step in json.loads(binascii.unhexlify(steps.strip()).decode()):
+                results.append(DottCmdRunScript._step(step))
+        except Exception as ex:
+            res = json.dumps({'step': len(results), 'msg': str(ex), 'results': results})
+            print(DottResp.format(int(resp_id), 'dott-run-script', 'ERR', binascii.hexlify(res.encode()).decode()))
+            return
+        res = json.dumps(results)
+        print(DottResp.format(int(resp_id), 'dott-run-script', 'OK', binascii.hexlify(res.encode()).decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdBpWatch(gdb.Command):
+    """
+    Watch expressions of halt points. Whenever the target stops at a breakpoint with watch expressions, they are
+    evaluated in the stop event and their values are sent as DottResp line with the response id given at registration
+    (i.e., they arrive together with the stop notification without further requests by the host).
+    """
+    def __init__(self):
+        super(DottCmdBpWatch, self).__init__("dott-bp-watch", gdb.COMMAND_USER)
+        self._watches = {}  # breakpoint number -> (response id, expressions)
+        gdb.events.stop.connect(self._on_stop)
+
+    def _on_stop(self, event):
+        if not isinstance(event, gdb.BreakpointEvent):
+            return
+        for bp in event.breakpoints:
+            watch = self._watches.get(bp.number)
+            if watch is None:
+                continue
+            res = []
+            for expr in watch[1]:
+                try:
+                    res.append([True, DottCmdEvalValue._to_py(gdb.parse_and_eval(expr))])
+                except Exception as ex:
+                    res.append([False, str(ex)])
+            print(DottResp.format(watch[0], 'dott-bp-watch', 'OK', binascii.hexlify(json.dumps(res).encode()).decode()))
+
+    def invoke(self, arg, from_tty):
+        # arguments: response id, breakpoint number, id of the watch responses and hex-encoded JSON list with the
+        # expressions (an empty list removes the watch expressions of the breakpoint)
+        resp_id, bp_num, watch_id, exprs = arg.split(' ')
+        exprs = json.loads(binascii.unhexlify(exprs).decode())
+        if len(exprs) > 0:
+            self._watches[int(bp_num)] = (int(watch_id), exprs)
+        else:
+            self._watches.pop(int(bp_num), None)
+        print(DottResp.format(int(resp_id), 'dott-bp-watch', 'OK'))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdExecCapture(gdb.Command):
+    # executes a (hex-encoded) CLI command and returns its console output hex-encoded (e.g., maint print xml-tdesc)
+    def __init__(self):
+        super(DottCmdExecCapture, self).__init__("dott-exec-capture", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        resp_id, cmd = arg.split(' ', 1)
+        try:
+            res = gdb.execute(binascii.unhexlify(cmd.strip()).decode(), to_string=True)
+            print(DottResp.format(int(resp_id), 'dott-exec-capture', 'OK', binascii.hexlify(res.encode()).decode()))
+        except Exception as ex:
+            print(DottResp.format(int(resp_id), 'dott-exec-capture', 'ERR',
+                                  binascii.hexlify(str(ex).encode()).decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class DottCmdStepInst(gdb.Command):
+    def __init__(self):
+        super(DottCmdStepInst, self).__init__("dott-step-inst", gdb.COMMAND_USER)
+
+    @staticmethod
+    def in_it_block(xpsr):
+        return ((xpsr >> 25) & 0b11) > 0 or ((xpsr >> 10) & 0b111111) > 0
+
+    def invoke(self, arg, from_tty):
+        # arguments: response id and hex-encoded JSON with number of steps (n) and optional stop conditions
+        # (until_pc: stop once pc is reached; it_exit_reg: stop once the xPSR register indicates no IT block)
+        resp_id, spec = arg.split(' ', 1)
+        steps = 0
+        try:
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            until_pc = spec.get('until_pc')
+            it_exit_reg = spec.get('it_exit_reg')
+            while steps < spec['n']:
+                if until_pc is not None and int(gdb.parse_and_eval('$pc')) == until_pc:
+                    break
+                if it_exit_reg is not None and not self.in_it_block(int(gdb.parse_and_eval('$' + it_exit_reg))):
+                    break
+                gdb.execute('stepi', to_string=True)
+                steps += 1
+            res = json.dumps({'steps': steps, 'pc': int(gdb.parse_and_eval('$pc'))})
+            print(DottResp.format(int(resp_id), 'dott-step-inst', 'OK', binascii.hexlify(res.encode()).decode()))
+        except Exception as ex:
+            res = json.dumps({'steps': steps, 'error': str(ex)})
+            print(DottResp.format(int(resp_id), 'dott-step-inst', 'ERR', binascii.hexlify(res.encode()).decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class CoverageProbe(gdb.Breakpoint):
+    # one-shot breakpoint of a coverage sweep; internal breakpoints are not reported by -break-list and are hence not
+    # touched by DOTT's breakpoint housekeeping (bp_clear_all)
+    def __init__(self, sweep, addr):
+        super(CoverageProbe, self).__init__('*0x%x' % addr, internal=True)
+        self.sweep = sweep
+        self.addr = addr
+
+    def stop(self):
+        self.sweep.hit(self)
+        return False
+
+
+class CoverageSweep(object):
+    """
+    Coverage collection by breakpoint sweeping. At most 'budget' probes (one-shot breakpoints) are armed at a time.
+    Once a probe is hit, it is replaced by the next pending address. Probes which were not hit are moved to the end of
+    the queue upon rotate such that subsequent tests cover other addresses. With rearm, probes which were hit are
+    re-queued upon rotate as well (the hits of each test are recorded instead of the session's coverage only).
+    If a tag address is given, the 32 bit word at this address (e.g., the index of the input processed by a fuzzing
+    driver) is recorded with each hit.
+    """
+    def __init__(self, addrs, budget, rearm=False, tag=None, byte_order='little'):
+        self.pending = collections.deque(addrs)
+        self.unarmed = set(addrs)  # addresses which have never been armed
+        self.budget = budget
+        self.rearm = rearm
+        self.tag = tag
+        self.bo = '<' if byte_order == 'little' else '>'
+        self.armed = {}
+        self.hits = []
+        self.tags = []
+        self.active = True
+        self.arm()
+
+    def arm(self):
+        while len(self.armed) < self.budget and len(self.pending) > 0:
+            addr = self.pending.popleft()
+            self.unarmed.discard(addr)
+            try:
+                self.armed[addr] = CoverageProbe(self, addr)
+            except Exception as ex:
+                print('DOTT coverage: unable to set probe at 0x%x (%s)' % (addr, str(ex)))
+
+    def hit(self, probe):
+        if self.armed.get(probe.addr) is probe:
+            del self.armed[probe.addr]
+            self.hits.append(probe.addr)
+            if self.tag is not None:
+                mem = DottCmdInterceptPoint.mem_to_bytes(gdb.selected_inferior().read_memory(self.tag, 4))
+                self.tags.append(struct.unpack(self.bo + 'I', mem)[0])
+            # note: breakpoints must not be modified in stop; the probe is replaced once GDB has resumed the target
+            gdb.post_event(lambda: self.replace(probe))
+
+    def replace(self, probe):
+        try:
+            probe.delete()
+        except RuntimeError:
+            pass  # already deleted (sweep stopped)
+        if self.active:
+            self.arm()
+
+    def rotate(self):
+        for addr, probe in list(self.armed.items()):
+            probe.delete()
+            self.pending.append(addr)
+        self.armed = {}
+        hits = self.hits
+        self.hits = []
+        self.tags = []
+        if self.rearm:
+            self.pending.extend(hits)
+        self.arm()
+        return hits
+
+    def stop(self):
+        self.active = False
+        for probe in self.armed.values():
+            probe.delete()
+        self.armed = {}
+
+
+# active coverage sweep (see dott-cov-start)
+cov_sweep = None
+
+
+class DottCmdCoverageStart(gdb.Command):
+    def __init__(self):
+        super(DottCmdCoverageStart, self).__init__("dott-cov-start", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        # arguments: response id and hex-encoded JSON with the probe addresses and the breakpoint budget
+        global cov_sweep
+        resp_id, spec = arg.split(' ', 1)
+        try:
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            if cov_sweep is not None:
+                cov_sweep.stop()
+            cov_sweep = CoverageSweep(spec['addrs'], spec['budget'], spec.get('rearm', False), spec.get('tag'),
+                                      spec.get('byte_order', 'little'))
+            res = json.dumps({'armed': len(cov_sweep.armed)})
+            print(DottResp.format(int(resp_id), 'dott-cov-start', 'OK', binascii.hexlify(res.encode()).decode()))
+        except Exception as ex:
+            print(DottResp.format(int(resp_id), 'dott-cov-start', 'ERR', binascii.hexlify(str(ex).encode()).decode()))
+
+
+class DottCmdCoverageAdd(gdb.Command):
+    def __init__(self):
+        super(DottCmdCoverageAdd, self).__init__("dott-cov-add", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        # arguments: response id and hex-encoded JSON list of further probe addresses (large sweeps are set up in
+        # chunks to keep the command lines short)
+        resp_id, addrs = arg.split(' ', 1)
+        try:
+            addrs = json.loads(binascii.unhexlify(addrs.strip()).decode('utf-8'))
+            cov_sweep.pending.extend(addrs)
+            cov_sweep.unarmed.update(addrs)
+            cov_sweep.arm()
+            res = json.dumps({'armed': len(cov_sweep.armed)})
+            print(DottResp.format(int(resp_id), 'dott-cov-add', 'OK', binascii.hexlify(res.encode()).decode()))
+        except Exception as ex:
+            print(DottResp.format(int(resp_id), 'dott-cov-add', 'ERR', binascii.hexlify(str(ex).encode()).decode()))
+
+
+class DottCmdCoverageRotate(gdb.Command):
+    def __init__(self):
+        super(DottCmdCoverageRotate, self).__init__("dott-cov-rotate", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        # returns (and clears) the addresses hit since the last rotation and arms the next batch of probes
+        resp_id = arg.split(' ')[0]
+        if cov_sweep is None:
+            print(DottResp.format(int(resp_id), 'dott-cov-rotate', 'ERR',
+                                  binascii.hexlify(b'no coverage sweep active').decode()))
+            return
+        tags = cov_sweep.tags
+        hits = cov_sweep.rotate()
+        res = json.dumps({'hits': hits, 'tags': tags, 'pending': len(cov_sweep.pending),
+                          'unarmed': len(cov_sweep.unarmed)})
+        print(DottResp.format(int(resp_id), 'dott-cov-rotate', 'OK', binascii.hexlify(res.encode()).decode()))
+
+
+class DottCmdCoverageStop(gdb.Command):
+    def __init__(self):
+        super(DottCmdCoverageStop, self).__init__("dott-cov-stop", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        global cov_sweep
+        if cov_sweep is not None:
+            cov_sweep.stop()
+            cov_sweep = None
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class HostCallPoint(gdb.Breakpoint):
+    """
+    No-stop breakpoint on DOTT_host_call_bp (testhelpers.c) which services the host call request in the mailbox
+    (DOTT_host_call_mailbox_t) entirely in GDB's context. Log lines are kept in a buffer which is drained by the MI
+    process; stimulus data is queued by the MI process (dott-host-call-stim).
+    """
+    LOG, WRITE, RANDOM, STIMULUS = 1, 2, 3, 4  # see DOTT_HOST_CALL_xxx
+    UNHANDLED = -1
+
+    def __init__(self, call_id, spec):
+        super(HostCallPoint, self).__init__(spec['location'])
+        self._func = spec['location']
+        self._call_id = call_id
+        self._mailbox = spec['mailbox']
+        self._bo = '<' if spec['byte_order'] == 'little' else '>'
+        self._write_file = spec.get('write_file')
+        self._random = random.Random(spec.get('seed'))
+        self._log = collections.deque(maxlen=spec.get('log_size', 4096))
+        self._stimulus = collections.deque()
+        self._calls = 0
+        self._unhandled = 0
+        self._errors = []
+
+    def get_func(self):
+        return self._func
+
+    def get_call_id(self):
+        return self._call_id
+
+    def close(self):
+        pass
+
+    def queue_stimulus(self, data):
+        self._stimulus.append(data)
+
+    def drain(self, clear):
+        res = {'calls': self._calls, 'unhandled': self._unhandled, 'log': list(self._log), 'errors': self._errors,
+               'stimulus': sum(len(s) for s in self._stimulus)}
+        if clear:
+            self._log.clear()
+            self._errors = []
+        return res
+
+    def _service(self, inferior, call_id, buf, num):
+        if call_id == HostCallPoint.LOG:
+            text = DottCmdInterceptPoint.mem_to_bytes(inferior.read_memory(buf, num))
+            self._log.append(text.decode('utf-8', 'replace'))
+            return num
+        if call_id == HostCallPoint.WRITE and self._write_file is not None:
+            with open(self._write_file, 'ab') as f:
+                f.write(DottCmdInterceptPoint.mem_to_bytes(inferior.read_memory(buf, num)))
+            return num
+        if call_id == HostCallPoint.RANDOM:
+            inferior.write_memory(buf, bytearray(self._random.getrandbits(8) for _ in range(num)))
+            return num
+        if call_id == HostCallPoint.STIMULUS:
+            data = b''
+            while len(self._stimulus) > 0 and len(data) < num:
+                chunk = self._stimulus.popleft()
+                if len(data) + len(chunk) > num:
+                    self._stimulus.appendleft(chunk[num - len(data):])
+                    chunk = chunk[:num - len(data)]
+                data += chunk
+            if len(data) > 0:
+                inferior.write_memory(buf, data)
+            return len(data)
+        return None
+
+    def stop(self):
+        if skip_hit(self):
+            return False
+        self._calls += 1
+        inferior = gdb.selected_inferior()
+        try:
+            mailbox = DottCmdInterceptPoint.mem_to_bytes(inferior.read_memory(self._mailbox, 12))
+            call_id, buf, num = struct.unpack(self._bo + 'III', mailbox)
+            ret = self._service(inferior, call_id, buf, num)
+            if ret is None:
+                self._unhandled += 1
+                ret = HostCallPoint.UNHANDLED
+        except Exception as ex:
+            self._errors.append(str(ex))
+            ret = HostCallPoint.UNHANDLED
+        try:
+            inferior.write_memory(self._mailbox + 12, struct.pack(self._bo + 'i', ret))
+        except Exception as ex:
+            self._errors.append(str(ex))
+        return False
+
+
+def find_host_call_point(call_id):
+    for bp in no_stop_bps:
+        if hasattr(bp, 'get_call_id') and bp.get_call_id() == call_id:
+            return bp
+    return None
+
+
+class DottCmdHostCall(gdb.Command):
+    def __init__(self):
+        super(DottCmdHostCall, self).__init__("dott-host-call", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        try:
+            # arguments: <call_id> <hex-encoded JSON with location, mailbox address, byte order and options>
+            call_id, spec = arg.split(' ', 1)
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            bp = HostCallPoint(int(call_id), spec)
+            global no_stop_bps
+            no_stop_bps.append(bp)
+
+        except Exception as ex:
+            print(str(ex))
+
+
+class DottCmdHostCallStimulus(gdb.Command):
+    def __init__(self):
+        super(DottCmdHostCallStimulus, self).__init__("dott-host-call-stim", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        # arguments: <call_id> <hex-encoded stimulus data>
+        call_id, data = arg.split(' ', 1)
+        bp = find_host_call_point(int(call_id))
+        if bp is None:
+            print('Unknown host call point %s.' % call_id)
+            return
+        bp.queue_stimulus(binascii.unhexlify(data.strip()))
+
+
+class DottCmdHostCallDrain(gdb.Command):
+    def __init__(self):
+        super(DottCmdHostCallDrain, self).__init__("dott-host-call-drain", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        resp_id, call_id, clear = arg.split(' ')
+        bp = find_host_call_point(int(call_id))
+        if bp is None:
+            print(DottResp.format(int(resp_id), 'dott-host-call-drain', 'ERR',
+                                  binascii.hexlify(b'unknown host call point').decode()))
+            return
+        res = json.dumps(bp.drain(clear == '1'))
+        print(DottResp.format(int(resp_id), 'dott-host-call-drain', 'OK', binascii.hexlify(res.encode()).decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class AssertPoint(gdb.Breakpoint):
+    """
+    No-stop breakpoint which evaluates an assertion expression on each hit. Passing hits are only counted; for failing
+    hits the frame (location, registers, arguments and locals and the backtrace) is captured and, if configured, the
+    target is halted (i.e., the MI process is only notified on failure). Failures are drained by the MI process.
+    """
+    REGS = ['r0', 'r1', 'r2', 'r3', 'r4', 'r5', 'r6', 'r7', 'r8', 'r9', 'r10', 'r11', 'r12', 'sp', 'lr', 'pc']
+    MAX_BACKTRACE = 16
+
+    def __init__(self, assert_id, spec):
+        super(AssertPoint, self).__init__(spec['location'])
+        self._func = spec['location']
+        self._assert_id = assert_id
+        self._expr = spec['expr']
+        self._halt = spec['halt']
+        self._records = collections.deque(maxlen=spec['max_records'])
+        self._hits = 0
+        self._failures = 0
+
+    def get_func(self):
+        return self._func
+
+    def get_assert_id(self):
+        return self._assert_id
+
+    def close(self):
+        pass
+
+    def drain(self, clear):
+        records = list(self._records)
+        if clear:
+            self._records.clear()
+        return {'number': self.number, 'hits': self._hits, 'failures': self._failures, 'records': records}
+
+    @staticmethod
+    def capture_frame():
+        frame = gdb.selected_frame()
+        sal = frame.find_sal()
+        regs = {}
+        for reg in AssertPoint.REGS:
+            try:
+                regs[reg] = int(frame.read_register(reg)) & 0xffffffff
+            except Exception:
+                pass
+        variables = {}
+        try:
+            # innermost scope first (shadowed names keep the innermost value) up to the function's scope
+            block = frame.block()
+            while block is not None:
+                for sym in block:
+                    if (sym.is_variable or sym.is_argument) and sym.name not in variables:
+                        variables[sym.name] = DottCmdInterceptPoint.eval_to_str(sym.value(frame))
+                if block.function is not None:
+                    break
+                block = block.superblock
+        except Exception:
+            pass  # no debug information for the frame
+        backtrace = []
+        f = frame
+        while f is not None and len(backtrace) < AssertPoint.MAX_BACKTRACE:
+            backtrace.append(f.name() if f.name() is not None else '0x%x' % f.pc())
+            try:
+                f = f.older()
+            except Exception:
+                break
+        return {'pc': frame.pc(), 'func': frame.name(), 'file': sal.symtab.filename if sal.symtab else None,
+                'line': sal.line, 'regs': regs, 'locals': variables, 'backtrace': backtrace}
+
+    def stop(self):
+        if skip_hit(self):
+            return False
+        self._hits += 1
+        error = None
+        try:
+            if bool(gdb.parse_and_eval(self._expr)):
+                return False
+        except Exception as ex:
+            error = str(ex)
+        self._failures += 1
+        record = {'hit': self._hits, 'time': time.time(), 'error': error}
+        try:
+            record['frame'] = AssertPoint.capture_frame()
+        except Exception as ex:
+            record['frame'] = None
+            record['error'] = str(ex) if error is None else error
+        self._records.append(record)
+        return self._halt
+
+
+class DottCmdAssertPoint(gdb.Command):
+    def __init__(self):
+        super(DottCmdAssertPoint, self).__init__("dott-bp-assert", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        try:
+            # arguments: <assert_id> <hex-encoded JSON with location, expression, halt flag and record count>
+            assert_id, spec = arg.split(' ', 1)
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            bp = AssertPoint(int(assert_id), spec)
+            global no_stop_bps
+            no_stop_bps.append(bp)
+
+        except Exception as ex:
+            print(str(ex))
+
+
+class DottCmdAssertPointDrain(gdb.Command):
+    def __init__(self):
+        super(DottCmdAssertPointDrain, self).__init__("dott-bp-assert-drain", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        resp_id, assert_id, clear = arg.split(' ')
+        for bp in no_stop_bps:
+            if hasattr(bp, 'get_assert_id') and bp.get_assert_id() == int(assert_id):
+                res = json.dumps(bp.drain(clear == '1'))
+                print(DottResp.format(int(resp_id), 'dott-bp-assert-drain', 'OK',
+                                      binascii.hexlify(res.encode()).decode()))
+                return
+        print(DottResp.format(int(resp_id), 'dott-bp-assert-drain', 'ERR',
+                              binascii.hexlify(b'unknown assert point').decode()))
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class FunctionTimerPoint(gdb.Breakpoint):
+    # entry or exit (return instruction) breakpoint of a function timed by a FunctionTimerGroup
+    def __init__(self, group, func, addr, is_exit):
+        super(FunctionTimerPoint, self).__init__('*0x%x' % addr)
+        self._group = group
+        self._func = func
+        self._is_exit = is_exit
+
+    def stop(self):
+        try:
+            self._group.hit(self._func, self._is_exit)
+        except Exception as ex:
+            self._group.errors.append(str(ex))
+        return False
+
+
+class FunctionTimerGroup(object):
+    """
+    Entry and exit breakpoints of the functions timed by a FunctionTimer. Each hit reads the cycle counter (DWT CYCCNT
+    or SysTick) and updates a shadow call stack from which the inclusive and exclusive time per function and the call
+    graph edges are accumulated. Nothing is sent to the MI process on a hit; the results are drained on demand. The
+    group is kept in no_stop_bps (and deleted by dott-bp-nostop-delete) under the name dott-ftimer-<id>.
+    """
+    DWT_CYCCNT = 0xE0001004
+    SYST_RVR = 0xE000E014
+    SYST_CVR = 0xE000E018
+    ROOT = '<root>'
+
+    def __init__(self, timer_id, spec):
+        self._name = 'dott-ftimer-%d' % timer_id
+        self._timer_id = timer_id
+        self._systick = spec['clock'] == 'systick'
+        self._bo = '<' if spec['byte_order'] == 'little' else '>'
+        self._period = None  # SysTick period (cycles)
+        self._last = None  # last counter value
+        self._now = 0  # cycles since the first hit (excluding the time the target was halted)
+        self._stack = []  # [function, entry time, time spent in callees]
+        self._stats = {}  # function -> [calls, inclusive cycles, exclusive cycles, max inclusive cycles]
+        self._edges = {}  # (caller, callee) -> calls
+        self._hits = 0
+        self._unmatched = 0
+        self.errors = []
+        self._bps = []
+        for func, entry, exits in spec['funcs']:
+            self._bps.append(FunctionTimerPoint(self, func, entry, False))
+            for addr in exits:
+                self._bps.append(FunctionTimerPoint(self, func, addr, True))
+
+    def get_func(self):
+        return self._name
+
+    def get_timer_id(self):
+        return self._timer_id
+
+    def delete(self):
+        for bp in self._bps:
+            bp.delete()
+        self._bps = []
+
+    def close(self):
+        pass
+
+    def _read32(self, addr):
+        mem = DottCmdInterceptPoint.mem_to_bytes(gdb.selected_inferior().read_memory(addr, 4))
+        return struct.unpack(self._bo + 'I', mem)[0]
+
+    def _tick(self):
+        # note: the counters do not advance while the core is halted (i.e., while GDB processes the hit)
+        if self._systick:
+            if self._period is None:
+                self._period = (self._read32(FunctionTimerGroup.SYST_RVR) & 0xffffff) + 1
+            cur = self._read32(FunctionTimerGroup.SYST_CVR) & 0xffffff
+            elapsed = (self._last - cur) % self._period if self._last is not None else 0  # down counter
+        else:
+            cur = self._read32(FunctionTimerGroup.DWT_CYCCNT)
+            elapsed = (cur - self._last) & 0xffffffff if self._last is not None else 0
+        self._last = cur
+        self._now += elapsed
+        return self._now
+
+    def hit(self, func, is_exit):
+        self._hits += 1
+        now = self._tick()
+        if not is_exit:
+            caller = self._stack[-1][0] if len(self._stack) > 0 else FunctionTimerGroup.ROOT
+            self._edges[(caller, func)] = self._edges.get((caller, func), 0) + 1
+            self._stack.append([func, now, 0])
+            return
+        if not any(frame[0] == func for frame in self._stack):
+            self._unmatched += 1  # exit without entry (e.g., timing started within the function)
+            return
+        while self._stack[-1][0] != func:
+            self._stack.pop()  # frames without exit (e.g., tail calls, longjmp)
+            self._unmatched += 1
+        _, entry, callees = self._stack.pop()
+        incl = now - entry
+        stats = self._stats.setdefault(func, [0, 0, 0, 0])
+        stats[0] += 1
+        stats[1] += incl
+        stats[2] += incl - callees
+        stats[3] = max(stats[3], incl)
+        if len(self._stack) > 0:
+            self._stack[-1][2] += incl
+
+    def drain(self, clear):
+        res = {'stats': self._stats, 'edges': [[caller, callee, n] for (caller, callee), n in self._edges.items()],
+               'hits': self._hits, 'unmatched': self._unmatched, 'depth': len(self._stack), 'errors': self.errors}
+        if clear:
+            self._stats, self._edges, self.errors = {}, {}, []
+        return res
+
+
+class DottCmdFunctionTimer(gdb.Command):
+    def __init__(self):
+        super(DottCmdFunctionTimer, self).__init__("dott-ftimer", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        try:
+            # arguments: <timer_id> <hex-encoded JSON with functions (name, entry, exits), clock and byte order>
+            timer_id, spec = arg.split(' ', 1)
+            spec = json.loads(binascii.unhexlify(spec.strip()).decode('utf-8'))
+            group = FunctionTimerGroup(int(timer_id), spec)
+            global no_stop_bps
+            no_stop_bps.append(group)
+
+        except Exception as ex:
+            print(str(ex))
+
+
+class DottCmdFunctionTimerDrain(gdb.Command):
+    def __init__(self):
+        super(DottCmdFunctionTimerDrain, self).__init__("dott-ftimer-drain", gdb.COMMAND_USER)
+
+    def invoke(self, arg, from_tty):
+        resp_id, timer_id, clear = arg.split(' ')
+        for bp in no_stop_bps:
+            if hasattr(bp, 'get_timer_id') and bp.get_timer_id() == int(timer_id):
+                res = json.dumps(bp.drain(clear == '1'))
+                print(DottResp.format(int(resp_id), 'dott-ftimer-drain', 'OK',
+                                      binascii.hexlify(res.encode()).decode()))
+                return
+        print(DottResp.format(int(resp_id), 'dott-ftimer-drain', 'ERR',
+                              binascii.hexlify(b'unknown function timer').decode()))
 
 
 # Initialize command(s)
 DottCmdInterceptPointCmds()
+DottCmdInterceptPointChannel()
 DottCmdInterceptPoint()
+DottCmdInterceptPointActions()
+DottCmdTracePoint()
+DottCmdSnapshotPoint()
+DottCmdTracePointDrain()
+DottCmdInterceptPointFilter()
 DottCmdInterceptPointDelete()
+DottCmdInterceptPointDeleteMany()
 DottCmdIsRunning()
+DottCmdPythonVersion()
+DottCmdTypeLayout()
+DottCmdEvalValue()
+DottCmdBpWatch()
+DottCmdRunScript()
+DottCmdStopRegs()
+DottCmdExecCapture()
+DottCmdStepInst()
+DottCmdCoverageStart()
+DottCmdCoverageAdd()
+DottCmdCoverageRotate()
+DottCmdCoverageStop()
+DottCmdHostCall()
+DottCmdHostCallStimulus()
+DottCmdHostCallDrain()
+DottCmdAssertPoint()
+DottCmdAssertPointDrain()
+DottCmdFunctionTimer()
+DottCmdFunctionTimerDrain()
 
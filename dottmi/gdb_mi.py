@@ -18,39 +18,69 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import asyncio
+import collections
+import copy
+import itertools
+import json
 import queue
 import threading
+import time
 from pprint import pprint
-from typing import Dict
+from typing import Dict, Iterator, List, Tuple
 
-from pygdbmi.gdbcontroller import GdbController
-
-from dottmi.dottexceptions import DottException
-from dottmi.utils import BlockingDict, log
+from dottmi.dottexceptions import DottConnectionError, DottException
+from dottmi.gdb_shared import DottResp
+from dottmi.gdbcontrollerdott import GdbControllerDott
+from dottmi.timeline import timeline
+from dottmi.utils import BlockingDict, MessageRing, log
 
 
 # ----------------------------------------------------------------------------------------------------------------------
 class GdbMi(object):
-    def __init__(self, mi_controller: GdbController):
-        self._mi_controller: GdbController = mi_controller
+    # number of (most recent) notifications without subscriber and console messages which are kept
+    NOTIFY_CAPACITY = 1000
+    CONSOLE_CAPACITY = 5000
+
+    def __init__(self, mi_controller: GdbControllerDott):
+        self._mi_controller: GdbControllerDott = mi_controller
+
+        # command latency statistics (disabled by default)
+        self._stats: GdbMiStats = GdbMiStats()
 
         # GDB machine interface context object used to track from what context GDB is currently accessed.
-        self._mi_context: GdbMiContext = GdbMiContext()
+        self._mi_context: GdbMiContext = GdbMiContext(self._stats)
 
-        self._next_mi_token: int = 1000   # token used for MI communication
-        self._next_cli_token: int = 8000  # id used for DOTT commands implemented in embedded python
+        # note: next() on itertools.count is atomic; hence, any number of threads can draw tokens without locking
+        self._mi_tokens: Iterator[int] = itertools.count(1000)   # tokens used for MI communication
+        self._cli_tokens: Iterator[int] = itertools.count(8000)  # ids used for DOTT commands (embedded python)
+        self._next_heartbeat_token: int = 1  # tokens below 1000 are used by heartbeats (see heartbeat)
+
+        # serializes the writes of all threads issuing commands (including the health monitor, see heartbeat) such that
+        # commands are never interleaved on GDB's input; results are matched to the waiting threads via their tokens
+        self._write_lock: threading.Lock = threading.Lock()
+        self._connection_lost: bool = False
 
         self._trace_commands: bool = False  # enable command tracing
-        self._trace_total_walltime: float = 0.0
 
-        # Dictionaries for different types of gdb responses.
-        self._response_dicts: Dict[str, BlockingDict] = {'result': BlockingDict(),
-                                                         'console': BlockingDict(),
-                                                         'notify': BlockingDict()}
+        # session recorder (see start_recording; disabled by default)
+        self._recorder: 'SessionRecorder' = None
+
+        # Dictionaries for the responses waited for (results and console responses of DOTT commands, both keyed by
+        # unique ids).
+        self._response_dicts: Dict[str, BlockingDict] = {'result': BlockingDict(discard_orphans=True),
+                                                         'console': BlockingDict(discard_orphans=True)}
+
+        # Bounded buffers of notifications without subscriber and of the remaining console output (see notifications
+        # and console).
+        self._notifications: MessageRing = MessageRing(GdbMi.NOTIFY_CAPACITY)
+        self._console: MessageRing = MessageRing(GdbMi.CONSOLE_CAPACITY)
+        self._latest_resps: LatestResps = LatestResps()
 
         # Create and start thread which handles the incoming response from GDB and puts
         # them into the correct response dictionary.
-        self._response_handler = GdbMiResponseHandler(self._mi_controller, self._response_dicts)
+        self._response_handler = GdbMiResponseHandler(self._mi_controller, self._response_dicts, self._stats,
+                                                      self._notifications, self._console, self._latest_resps)
         self._response_handler.start()
 
     ###############################################################################################
@@ -65,6 +95,61 @@ class GdbMi(object):
         """
         return self._response_handler
 
+    @property
+    def stats(self) -> 'GdbMiStats':
+        """
+        Returns the command latency statistics collected by this object.
+
+        Returns:
+            GDB MI command statistics object used by this object.
+        """
+        return self._stats
+
+    @property
+    def notifications(self) -> MessageRing:
+        """
+        Returns the most recent notifications which had no subscriber, keyed by (message, reason), e.g.,
+        gdb_mi.notifications.query(('stopped', 'signal-received')).
+        """
+        return self._notifications
+
+    @property
+    def console(self) -> MessageRing:
+        """
+        Returns the most recent console output of GDB which is not a response of a DOTT command (e.g., output of
+        monitor commands).
+        """
+        return self._console
+
+    def capture_console(self, file_name: str) -> None:
+        """
+        Streams all further console output (see console) to the given file (None stops the capture).
+        """
+        self._console.stream_to(file_name)
+
+    @property
+    def recorder(self) -> 'SessionRecorder':
+        """
+        Returns the recorder of this session or None if the session is not recorded.
+        """
+        return self._recorder
+
+    def start_recording(self, file_name: str) -> None:
+        """
+        Records all MI commands and all MI records of this session to the given file (see dottmi.gdb_replay). Shall
+        be called before the first command is sent to GDB.
+        """
+        from dottmi.gdb_replay import SessionRecorder
+        self._recorder = SessionRecorder(file_name)
+        self._response_handler.recorder = self._recorder
+
+    @property
+    def connection_lost(self) -> bool:
+        """
+        Returns True if the connection to GDB has been lost (GDB terminated, I/O error or failed heartbeat).
+        """
+        return self._connection_lost or self._mi_controller.has_terminated()
+
     @property
     def context(self) -> 'GdbMiContext':
         """
@@ -78,21 +163,28 @@ class GdbMi(object):
     ###############################################################################################
     # Helper functions to get the next CLI and MI tokens
     def _get_next_cli_token(self) -> int:
-        ret = self._next_cli_token
-        self._next_cli_token += 1
-        return ret
+        return next(self._cli_tokens)
 
     def _get_next_mi_token(self) -> int:
-        ret = self._next_mi_token
-        self._next_mi_token += 1
-        return ret
+        return next(self._mi_tokens)
 
     ###############################################################################################
     # Wrapper functions for GDB machine interface (mi)
     def _mi_wait_token_result(self, token: int, timeout: float = None) -> Dict:
         # the pop call is blocking; if timeout is not None a TimeoutError exception is raised
         msg = self._response_dicts['result'].pop(token, timeout)
+        return self._check_result(msg)
 
+    async def _mi_wait_token_result_async(self, token: int, timeout: float = None) -> Dict:
+        fut = self._response_dicts['result'].pop_async(token, asyncio.get_running_loop())
+        try:
+            msg = await asyncio.wait_for(fut, timeout)
+        except asyncio.TimeoutError:
+            self._response_dicts['result'].cancel_async(token)
+            raise TimeoutError from None
+        return self._check_result(msg)
+
+    def _check_result(self, msg: Dict) -> Dict:
         if (msg['message']) in ('done', 'running', 'stopped'):
             # Note: When operating GDB in async mode (as DOTT does it) 'running' and 'stopped' should be seen
             #       as equivalent ot 'done'. In fact, the notion of target state should only be based on notify
@@ -113,36 +205,91 @@ class GdbMi(object):
                 else:
                     raise Exception("GDB Error: %s" % msg['payload']['msg'])
 
-    def write_non_blocking(self, cmd: str) -> int:
+    def write_non_blocking(self, cmd: str, result_only: bool = False) -> int:
         """
-        Sends the provided command to GDB without blocking.
+        Sends the provided command to GDB without blocking. May be called from several threads concurrently; GDB
+        executes the commands in the order in which they are written.
         Args:
             cmd: The command to be sent to GDB.
+            result_only: If True, only the result class (done, error, ...) of the command's result record is
+            evaluated. The payload is not parsed (except for error messages). Use this for commands which are only
+            issued for their side effects.
 
         Returns:
             The token which identifies the command sent to GDB. It is used to related GDB's response to the commands
             sent to it.
         """
-        if self._mi_context.get_context() != GdbMiContext.NORMAL:
-            if self._mi_context.get_context() == GdbMiContext.BP_INTERCEPT:
-                # Provide a more specific error message when in InterceptPoint context.
-                raise DottException('Cannot use normal DOTT commands to interact with the target while executing in '
-                                    'InterceptPoint context. Instead, use eval/exec methods provided by the'
-                                    'InterceptPoint implementation!')
-            else:
-                raise DottException('Cannot use normal DOTT commands to interact with the target while not executing '
-                                    'NORMAL context!')
+        self._mi_context.wait_normal(cmd)
 
-        token = self._get_next_mi_token()
-        if self._trace_commands:
-            log.debug(f'{token}         gdb write: {cmd}')
+        if self._connection_lost:
+            raise DottConnectionError('Connection to GDB has been lost. Check for previous warnings or errors.')
         try:
-            self._mi_controller.write("%d%s" % (token, cmd), read_response=False)
+            with self._write_lock:
+                # note: the token is drawn while holding the write lock such that tokens are written in ascending order
+                token = self._get_next_mi_token()
+                if self._trace_commands:
+                    log.debug(f'{token}         gdb write: {cmd}')
+                if self._stats.active:
+                    self._stats.cmd_sent(token, cmd)
+                if result_only:
+                    self._mi_controller.add_result_only_token(token)
+                if self._recorder is not None:
+                    self._recorder.record_write("%d%s" % (token, cmd))
+                self._mi_controller.write("%d%s" % (token, cmd), read_response=False)
         except IOError:
             log.warn('Got I/O error form gdb client! GDB session might have been closed prematurely due to previous '
                      'errors in this session. Check for any previous warning or error messages.')
+            self.abort()
+            raise DottConnectionError('Connection to GDB has been lost (I/O error).') from None
         return token
 
+    def heartbeat(self, timeout: float = 1.0) -> bool:
+        """
+        Checks if GDB is responsive by sending a cheap MI command which is answered by GDB itself (i.e., without
+        involving the GDB server). In contrast to the other write functions, this function may be called from any
+        thread. While an intercept point is active or waiting, GDB is blocked in the breakpoint's stop handler and
+        does not answer; the check is skipped then (reported as responsive).
+
+        Args:
+            timeout: Time to wait at maximum for GDB's response.
+
+        Returns:
+            True if GDB responded in time (or the check was skipped), False otherwise.
+        """
+        if self.connection_lost:
+            return False
+        if not self._mi_context.is_normal():
+            return True
+        results = self._response_dicts['result']
+        with self._write_lock:
+            token = self._next_heartbeat_token
+            self._next_heartbeat_token = (self._next_heartbeat_token % 999) + 1
+            # note: heartbeat tokens are reused; a stale answer (or orphan mark) of the token's previous use must
+            # neither be taken for the answer of this heartbeat nor swallow it
+            results.forget(token)
+            try:
+                self._mi_controller.write("%d-list-features" % token, read_response=False)
+            except IOError:
+                return False
+        try:
+            results.pop(token, timeout)
+        except TimeoutError:
+            results.orphan(token)  # a late answer is discarded
+            return False
+        except DottConnectionError:
+            return False
+        return True
+
+    def abort(self) -> None:
+        """
+        Marks the connection to GDB as lost. All threads waiting for results of GDB and all subsequent commands raise
+        a DottConnectionError instead of waiting for a timeout.
+        """
+        self._connection_lost = True
+        ex = DottConnectionError('Connection to GDB has been lost. Check for previous warnings or errors.')
+        for response_dict in self._response_dicts.values():
+            response_dict.abort(ex)
+
     def write_blocking(self, cmd: str, timeout: float = None) -> Dict:
         """
         Sends the provided command to GDB and blocks until gdb returns with the result of the command.
@@ -157,63 +304,440 @@ class GdbMi(object):
         token = self.write_non_blocking(cmd)
         return self._mi_wait_token_result(token, timeout)
 
+    def write_dott_cmd(self, dott_cmd: str, args: str = '', timeout: float = None, context: str = '') -> List[str]:
+        """
+        Executes a custom DOTT GDB command (implemented in gdb_cmds.py) which answers with a DottResp console line.
+        Args:
+            dott_cmd: Name of the DOTT GDB command (e.g., dott-type-layout).
+            args: Arguments passed to the command (appended after the response id).
+            timeout: The amount of time to block at maximum while waiting for the response. If the timeout is reached,
+            a TimeoutError exception is raised.
+            context: MI context option the command is executed with (e.g., '--thread 2'; see Target.add_core).
+
+        Returns:
+            The fields of the command's response.
+        """
+        resp_id = self._get_next_cli_token()
+        context = f' {context}' if context else ''
+        # note: the console response is received before the result record of the command
+        self.write_blocking(f'-interpreter-exec{context} console "{dott_cmd} {resp_id} {args}"', timeout=timeout)
+        msg = self._response_dicts['console'].pop(resp_id, timeout)
+        return DottResp.get_fields(msg['payload'])
+
+    def reserve_resp_id(self) -> int:
+        """
+        Returns a response id for DottResp lines which GDB sends without a command of the host (e.g., the values of
+        watch expressions of halt points; see pop_dott_resp).
+        """
+        return self._get_next_cli_token()
+
+    @property
+    def latest_resps(self) -> 'LatestResps':
+        """
+        Latest DottResp lines of the response ids registered for repeated responses (see LatestResps).
+        """
+        return self._latest_resps
+
+    def pop_dott_resp(self, resp_id: int, timeout: float = None) -> List[str]:
+        """
+        Waits for the next DottResp line with the given (reserved) response id and returns its fields.
+        """
+        msg = self._response_dicts['console'].pop(resp_id, timeout)
+        return DottResp.get_fields(msg['payload'])
+
+    async def write_async(self, cmd: str, timeout: float = None) -> Dict:
+        """
+        Asyncio variant of write_blocking. Sends the provided command to GDB and awaits the result without blocking
+        a thread.
+        Args:
+            cmd: The command to be sent to GDB.
+            timeout: The amount of time to wait at maximum for the response. If the timeout is reached, a
+            TimeoutError exception is raised.
+
+        Returns:
+            The result of the command sent to GDB as a dictionary.
+        """
+        token = self.write_non_blocking(cmd)
+        return await self._mi_wait_token_result_async(token, timeout)
+
+    def _orphan_tokens(self, tokens: List[int]) -> None:
+        # the results of commands which are no longer waited for (e.g., the rest of a batch after a timeout) are
+        # discarded when they arrive instead of remaining in the result dict
+        for token in tokens:
+            self._response_dicts['result'].orphan(token)
+
+    def write_batch(self, cmds: List[str], timeout: float = None) -> List[Dict]:
+        """
+        Sends the provided commands to GDB back-to-back without waiting for the individual results in between. Once
+        all commands are sent, the results are collected. Hence, the batch only costs one round trip window instead of
+        one round trip per command.
+        If one or more commands fail, the remaining results are still collected (such that no stale results remain)
+        and the first error is raised afterwards. If a result times out, the results of the remaining commands are
+        discarded once they arrive.
+
+        Args:
+            cmds: The commands to be sent to GDB.
+            timeout: The amount of time to block at maximum while waiting for each response. If the timeout is
+            reached, a TimeoutError exception is raised.
+
+        Returns:
+            List with the results of the commands (in the order of the commands) as dictionaries.
+        """
+        tokens = [self.write_non_blocking(cmd) for cmd in cmds]
+
+        results: List[Dict] = []
+        first_ex: Exception = None
+        for idx, token in enumerate(tokens):
+            try:
+                results.append(self._mi_wait_token_result(token, timeout))
+            except TimeoutError:
+                self._orphan_tokens(tokens[idx + 1:])
+                raise
+            except Exception as ex:
+                results.append(None)
+                if first_ex is None:
+                    first_ex = ex
+
+        if first_ex is not None:
+            raise first_ex
+        return results
+
+    def write_checked(self, cmds: List[str], timeout: float = None) -> None:
+        """
+        Sends the provided commands, which are only issued for their side effects, to GDB back-to-back. Only the
+        result class of the commands is checked once all commands are sent; no result payloads are built.
+        If one or more commands fail, the first error is raised after all results have been collected. If a result
+        times out, the results of the remaining commands are discarded once they arrive.
+
+        Args:
+            cmds: The commands to be sent to GDB.
+            timeout: The amount of time to block at maximum while waiting for each response. If the timeout is
+            reached, a TimeoutError exception is raised.
+        """
+        tokens = [self.write_non_blocking(cmd, result_only=True) for cmd in cmds]
+
+        first_ex: Exception = None
+        for idx, token in enumerate(tokens):
+            try:
+                self._mi_wait_token_result(token, timeout)
+            except TimeoutError:
+                self._orphan_tokens(tokens[idx + 1:])
+                raise
+            except Exception as ex:
+                if first_ex is None:
+                    first_ex = ex
+
+        if first_ex is not None:
+            raise first_ex
+
     def shutdown(self) -> None:
         """
         Stops the gdb response handler.
         """
         self._response_handler.stop()
+        if self._recorder is not None:
+            self._recorder.close()
+
+    def terminate(self) -> None:
+        """
+        Stops the gdb response handler and terminates GDB (used to discard GDB instances which are no longer
+        responsive).
+        """
+        self.abort()
+        self._response_handler.stop()
+        self._response_handler.join(GdbMiResponseHandler.STOP_CHECK_INTERVAL_SEC * 10)
+        if self._recorder is not None:
+            self._recorder.close()
+        try:
+            self._mi_controller.exit()
+        except Exception:
+            pass
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class GdbMiStats(object):
+    """
+    This class collects latency statistics of the MI commands sent to GDB. Statistics are kept per command verb (e.g.,
+    -data-evaluate-expression, -data-read-memory-bytes, -interpreter-exec). The latency of a command is the time
+    between writing it to GDB and the arrival of its result record. If the timeline is recorded, the commands are
+    also added to it (independent of whether statistics are enabled).
+    """
+    # Upper bounds (in milliseconds) of the latency histogram buckets. The last bucket collects all slower commands.
+    HIST_BUCKETS_MS = (0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0)
+
+    def __init__(self):
+        self.enabled: bool = False
+        self._lock: threading.Lock = threading.Lock()
+        self._pending: Dict[int, Tuple[str, float, str, str]] = {}  # token -> (verb, send time, cmd, thread name)
+        self._verbs: Dict[str, Dict] = {}
+
+    @property
+    def active(self) -> bool:
+        # commands have to be tracked if statistics are enabled or the timeline is recorded
+        return self.enabled or timeline.enabled
+
+    @staticmethod
+    def _get_verb(cmd: str) -> str:
+        return cmd.split(maxsplit=1)[0] if cmd.strip() != '' else cmd
+
+    def cmd_sent(self, token: int, cmd: str) -> None:
+        with self._lock:
+            self._pending[token] = (self._get_verb(cmd), time.perf_counter(), cmd,
+                                    threading.current_thread().name)
+
+    def cmd_done(self, token: int) -> None:
+        end_time = time.perf_counter()
+        with self._lock:
+            if token not in self._pending:
+                return
+            verb, start_time, cmd, thread_name = self._pending.pop(token)
+            if self.enabled:
+                self._add(verb, end_time - start_time)
+        # note: commands are shown on one track per sending thread (the result is received by the response thread)
+        timeline.complete(verb, 'gdb', start_time, end_time, {'cmd': cmd[:256], 'token': token},
+                          track=f'GDB MI ({thread_name})')
+
+    def record(self, name: str, secs: float) -> None:
+        """
+        Adds a duration which is not the latency of an MI command (e.g., the time spent waiting for the context).
+        """
+        with self._lock:
+            self._add(name, secs)
+
+    def _add(self, verb: str, latency: float) -> None:
+        # called with the lock held
+        if verb not in self._verbs:
+            self._verbs[verb] = {'count': 0, 'total_s': 0.0, 'min_s': latency, 'max_s': latency,
+                                 'hist': [0] * (len(GdbMiStats.HIST_BUCKETS_MS) + 1)}
+        entry = self._verbs[verb]
+        entry['count'] += 1
+        entry['total_s'] += latency
+        entry['min_s'] = min(entry['min_s'], latency)
+        entry['max_s'] = max(entry['max_s'], latency)
+
+        bucket = len(GdbMiStats.HIST_BUCKETS_MS)
+        for i, bound in enumerate(GdbMiStats.HIST_BUCKETS_MS):
+            if latency * 1000.0 <= bound:
+                bucket = i
+                break
+        entry['hist'][bucket] += 1
+
+    def get(self) -> Dict[str, Dict]:
+        """
+        Returns: A copy of the statistics collected so far (keyed by command verb).
+        """
+        with self._lock:
+            return copy.deepcopy(self._verbs)
+
+    def reset(self) -> None:
+        """
+        Clears all statistics collected so far.
+        """
+        with self._lock:
+            self._verbs = {}
+            self._pending = {}
+
+    @staticmethod
+    def diff(stats_now: Dict[str, Dict], stats_before: Dict[str, Dict]) -> Dict[str, Dict]:
+        """
+        Computes the number of commands and the total time per verb between two statistics snapshots obtained
+        with get(). This is, e.g., used to report the statistics for an individual test.
+        """
+        ret: Dict[str, Dict] = {}
+        for verb, entry in stats_now.items():
+            before = stats_before.get(verb, {'count': 0, 'total_s': 0.0})
+            count = entry['count'] - before['count']
+            if count > 0:
+                ret[verb] = {'count': count, 'total_s': entry['total_s'] - before['total_s']}
+        return ret
+
+    @staticmethod
+    def to_str(stats: Dict[str, Dict]) -> str:
+        """
+        Formats the given statistics as a human-readable table (one line per command verb, slowest total first).
+        """
+        lines = [f'{"command":<40} {"count":>8} {"total [ms]":>12} {"avg [ms]":>10}']
+        for verb, entry in sorted(stats.items(), key=lambda e: e[1]['total_s'], reverse=True):
+            lines.append(f'{verb:<40} {entry["count"]:>8} {entry["total_s"] * 1000.0:>12.2f} '
+                         f'{entry["total_s"] * 1000.0 / entry["count"]:>10.3f}')
+        return '\n'.join(lines)
+
+    def save_json(self, file_name: str, per_test: Dict[str, Dict] = None) -> None:
+        """
+        Writes the collected statistics (and optionally the per-test statistics) to a JSON file.
+        """
+        out = {'hist_buckets_ms': list(GdbMiStats.HIST_BUCKETS_MS), 'commands': self.get()}
+        if per_test is not None:
+            out['tests'] = per_test
+        with open(file_name, 'w') as f:
+            json.dump(out, f, indent=2)
 
 
 # ----------------------------------------------------------------------------------------------------------------------
 class GdbMiContext(object):
     """
     This class is used to represent the context of a host to gdb connection. It is used internally by DOTT.
+    While an intercept point is processed (BP_INTERCEPT), GDB is blocked in the breakpoint's stop handler. Intercept
+    points which fire in the meantime wait for the context in the order of their arrival. Commands of other threads
+    wait until no intercept point is active or waiting anymore, except for commands which are answered by GDB itself
+    (READ_ONLY_VERBS) which are written right away and are executed by GDB once the stop handler returns. The time
+    spent waiting is reported in the GDB MI statistics (pseudo commands <wait intercept> and <wait normal>).
     """
     NORMAL = 0x01
     BP_INTERCEPT = 0x02
 
-    def __init__(self):
-        self._context_lock: threading.Lock = threading.Lock()
+    # commands which neither access nor alter the target; they can be queued in GDB while an intercept point is active
+    READ_ONLY_VERBS = ('-gdb-show', '-list-features', '-break-list', '-info-gdb-mi-command',
+                       '-data-list-register-names', '-symbol-info-functions', '-symbol-info-variables', '-symbol-list-lines')
+
+    # maximum time to wait for the context
+    WAIT_TIMEOUT_SEC = 30.0
+
+    def __init__(self, stats: 'GdbMiStats' = None):
+        self._cond: threading.Condition = threading.Condition()
         self._context: int = GdbMiContext.NORMAL
         self._context_holder = None
+        self._holder_thread: int = None
+        self._waiting: collections.deque = collections.deque()  # context holders waiting for the context (FIFO)
+        self._stats: GdbMiStats = stats
+
+    def _record_wait(self, name: str, start: float) -> None:
+        if self._stats is not None and self._stats.enabled:
+            self._stats.record(name, time.perf_counter() - start)
+        timeline.complete(name, 'gdb', start)
 
     def acquire_context(self, context_holder, context: int) -> None:
-        with self._context_lock:
-            if self._context != GdbMiContext.NORMAL:
-                raise DottException('Unable to switch context while not in normal context.'
-                                    'Current context holder has to release first.')
-            else:
-                self._context = context
-                self._context_holder = context_holder
+        start = time.perf_counter()
+        with self._cond:
+            self._waiting.append(context_holder)
+            granted = self._cond.wait_for(lambda: self._context == GdbMiContext.NORMAL and
+                                          self._waiting[0] is context_holder, GdbMiContext.WAIT_TIMEOUT_SEC)
+            if not granted:
+                self._waiting.remove(context_holder)
+                self._cond.notify_all()
+                raise DottException(f'Unable to switch context within {GdbMiContext.WAIT_TIMEOUT_SEC}s. Current '
+                                    f'context holder has to release first.')
+            self._waiting.popleft()
+            self._context = context
+            self._context_holder = context_holder
+            self._holder_thread = threading.get_ident()
+        self._record_wait('<wait intercept>', start)
 
     def release_context(self, context_holder):
-        with self._context_lock:
+        with self._cond:
             if context_holder != self._context_holder:
                 raise DottException('Context can only be released from the the same '
                                     'entity that did the previous context setting.')
             else:
                 self._context = GdbMiContext.NORMAL
                 self._context_holder = None
+                self._holder_thread = None
+                self._cond.notify_all()
 
     def get_context(self) -> int:
-        with self._context_lock:
+        with self._cond:
             return self._context
 
+    def is_normal(self) -> bool:
+        # True if no intercept point is active or waiting, i.e., GDB is not blocked in a breakpoint's stop handler
+        with self._cond:
+            return self._context == GdbMiContext.NORMAL and len(self._waiting) == 0
+
+    def wait_normal(self, cmd: str) -> None:
+        """
+        Returns once the given command may be written to GDB (see class description). Raises a DottException if the
+        command is issued from within the active context (e.g., from the reached method of an intercept point).
+        """
+        with self._cond:
+            if self._context == GdbMiContext.NORMAL and len(self._waiting) == 0:
+                return
+            if self._holder_thread == threading.get_ident():
+                if self._context == GdbMiContext.BP_INTERCEPT:
+                    # Provide a more specific error message when in InterceptPoint context.
+                    raise DottException('Cannot use normal DOTT commands to interact with the target while executing '
+                                        'in InterceptPoint context. Instead, use eval/exec methods provided by the'
+                                        'InterceptPoint implementation!')
+                raise DottException('Cannot use normal DOTT commands to interact with the target while not executing '
+                                    'NORMAL context!')
+            if GdbMiStats._get_verb(cmd) in GdbMiContext.READ_ONLY_VERBS:
+                return
+            start = time.perf_counter()
+            if not self._cond.wait_for(lambda: self._context == GdbMiContext.NORMAL and len(self._waiting) == 0,
+                                       GdbMiContext.WAIT_TIMEOUT_SEC):
+                raise DottException(f'Intercept point context not released within {GdbMiContext.WAIT_TIMEOUT_SEC}s.')
+        self._record_wait('<wait normal>', start)
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class LatestResps(object):
+    """
+    DottResp lines which GDB sends repeatedly on its own under a registered response id (e.g., the registers captured
+    at every stop; see Target.halt). Only the latest line per id is kept together with the number of lines received
+    so far; a waiter asks for a line newer than the count it saw before (regardless of whether the line is received
+    before or after the related MI notification).
+    """
+    def __init__(self) -> None:
+        self._cv: threading.Condition = threading.Condition()
+        self._resps: Dict[int, List] = {}  # response id -> [count, fields]
+
+    def register(self, resp_id: int) -> None:
+        with self._cv:
+            self._resps.setdefault(resp_id, [0, None])
+
+    def accepts(self, resp_id: int) -> bool:
+        return resp_id in self._resps
+
+    def put(self, resp_id: int, fields: List[str]) -> None:
+        with self._cv:
+            entry = self._resps[resp_id]
+            entry[0] += 1
+            entry[1] = fields
+            self._cv.notify_all()
+
+    def count(self, resp_id: int) -> int:
+        with self._cv:
+            return self._resps[resp_id][0]
+
+    def wait_newer(self, resp_id: int, count: int, timeout: float) -> List[str]:
+        """
+        Returns the fields of the latest line once more than count lines were received (None on timeout).
+        """
+        with self._cv:
+            entry = self._resps[resp_id]
+            if not self._cv.wait_for(lambda: entry[0] > count, timeout):
+                return None
+            return entry[1]
+
 
 # ----------------------------------------------------------------------------------------------------------------------
 class GdbMiResponseHandler(threading.Thread):
-    def __init__(self, mi_controller: GdbController, dicts: Dict) -> None:
+    # Maximum time the response handler blocks while waiting for GDB output before checking if it shall stop.
+    STOP_CHECK_INTERVAL_SEC = 0.1
+
+    def __init__(self, mi_controller: GdbControllerDott, dicts: Dict, stats: 'GdbMiStats' = None,
+                 notifications: MessageRing = None, console: MessageRing = None,
+                 latest_resps: 'LatestResps' = None) -> None:
         super().__init__(name='GdbResponseHandler')
         self._mi_controller = mi_controller
         self._response_dicts = dicts
+        self._stats: GdbMiStats = stats
+        self._notifications: MessageRing = notifications if notifications is not None else MessageRing(0)
+        self._console: MessageRing = console if console is not None else MessageRing(0)
+        self._latest_resps: LatestResps = latest_resps if latest_resps is not None else LatestResps()
         self._running = False
         self._notify_subscribers = {}
+        self.recorder: 'SessionRecorder' = None  # see GdbMi.start_recording
 
     def notify_subscribe(self, subscriber, notify_msg: str, notify_reason: str = None) -> None:
         if (notify_msg, notify_reason) not in self._notify_subscribers:
             self._notify_subscribers[(notify_msg, notify_reason)] = []
         self._notify_subscribers[(notify_msg, notify_reason)].append(subscriber)
 
+    def notify_unsubscribe(self, subscriber) -> None:
+        for subscribers in self._notify_subscribers.values():
+            if subscriber in subscribers:
+                subscribers.remove(subscriber)
+
     def stop(self) -> None:
         self._running = False
 
@@ -222,7 +746,22 @@ class GdbMiResponseHandler(threading.Thread):
 
         while self._running:
             try:
-                messages = self._mi_controller.get_gdb_response(timeout_sec=0.005, raise_error_on_timeout=False)
+                # Block until GDB has written something to its stdout. Afterwards, collect all records which are
+                # available without waiting any further.
+                if not self._mi_controller.wait_for_output(GdbMiResponseHandler.STOP_CHECK_INTERVAL_SEC):
+                    continue
+                messages = self._mi_controller.read_records()
+                if self.recorder is not None:
+                    self.recorder.record_records(messages)
+                if len(messages) == 0 and self._mi_controller.has_terminated():
+                    # pipe is readable but contains no data since GDB has terminated; nothing left to handle
+                    if self._running:
+                        log.warn('GDB process has terminated. Stopping GDB response handler.')
+                    self._running = False
+                    # threads still waiting for results would otherwise only give up after their timeout
+                    for response_dict in self._response_dicts.values():
+                        response_dict.abort(DottConnectionError('GDB process has terminated.'))
+                    break
 
                 for msg in messages:
                     msg_type = str(msg['type']).lower()
@@ -236,16 +775,25 @@ class GdbMiResponseHandler(threading.Thread):
                         else:
                             log.warn('result w/o token: ')
                             pprint(msg)
+                        if self._stats is not None and self._stats.active:
+                            self._stats.cmd_done(msg_token)
                         self._response_dicts['result'].put(msg_token, msg)
 
                     elif msg_type == 'console':
                         if 'payload' in msg:
                             payload = msg['payload']
-                            if 'DOTT_RESP' in payload:
-                                resp_id = (int(payload.split(',')[1]))
-                                self._response_dicts['console'].put(resp_id, msg)
+                            # responses of custom DOTT commands always start with the response prefix; all other
+                            # console output is kept in the (bounded) console buffer
+                            if payload.startswith(DottResp.PREFIX):
+                                resp_id = DottResp.get_id(payload)
+                                if self._latest_resps.accepts(resp_id):
+                                    self._latest_resps.put(resp_id, DottResp.get_fields(payload))
+                                else:
+                                    self._response_dicts['console'].put(resp_id, msg)
+                            else:
+                                self._console.put(None, msg, str(payload).rstrip())
                         else:
-                            self._response_dicts['console'].put(0, msg)
+                            self._console.put(None, msg)
                         # log.debug('[CON] %s' % bytes(msg['payload'], 'ascii').decode('unicode_escape').rstrip())
 
                     elif msg_type == 'output':
@@ -271,17 +819,17 @@ class GdbMiResponseHandler(threading.Thread):
 
                         already_notified = []
                         if (notify_msg, notify_reason) in self._notify_subscribers:
-                            for subscriber in self._notify_subscribers[(notify_msg, notify_reason)]:
+                            for subscriber in self._notify_subscribers[(notify_msg, notify_reason)][:]:
                                 subscriber.notify(msg)
                                 already_notified.append(subscriber)
                         if (notify_msg, None) in self._notify_subscribers:
-                            for subscriber in self._notify_subscribers[(notify_msg, None)]:
+                            for subscriber in self._notify_subscribers[(notify_msg, None)][:]:
                                 if subscriber not in already_notified:
                                     subscriber.notify(msg)
 
-                        # if there are no subscribers for this notification it is stored in a dict for later analysis
+                        # if there are no subscribers for this notification it is kept for later analysis
                         if len(already_notified) == 0:
-                            self._response_dicts['notify'].put((notify_msg, notify_reason), msg)
+                            self._notifications.put((notify_msg, notify_reason), msg)
 
                     elif msg_type == 'log':
                         pass
@@ -302,15 +850,54 @@ class GdbMiResponseHandler(threading.Thread):
 
 # ----------------------------------------------------------------------------------------------------------------------
 class NotifySubscriber(object):
+    # queued to make the dispatch thread exit (see notify_stop)
+    _STOP = object()
+
     def __init__(self):
         self._notifications: queue.Queue = queue.Queue()
+        # Queue and thread used to dispatch notification callbacks. The thread is created once upon the first
+        # notification (and only if the subscriber actually implements _notify_callback).
+        self._dispatch_queue: queue.Queue = queue.Queue()
+        self._dispatch_thread: threading.Thread = None
+        self._dispatch_lock: threading.Lock = threading.Lock()
 
     def notify(self, msg: Dict) -> None:
         self._notifications.put(msg)
         # Note: Callback handlers are executed in own thread to ensure that main gdbmi thread is not blocked. This is
         # important as callback handlers can issue their own GDB requests which might lead to deadlocks if callback
-        # handlers are called in gdbmi context.
-        threading.Thread(target=self._notify_callback).start()
+        # handlers are called in gdbmi context. A single, long-lived dispatch thread per subscriber is used for this
+        # purpose which also ensures that callbacks are executed in the order the notifications were received.
+        if type(self)._notify_callback is NotifySubscriber._notify_callback:
+            return  # subscriber does not implement a callback (e.g., it consumes notifications via its own thread)
+
+        with self._dispatch_lock:
+            if self._dispatch_thread is None:
+                self._dispatch_thread = threading.Thread(target=self._dispatch, args=(self._dispatch_queue,),
+                                                         name='NotifyDispatcher', daemon=True)
+                self._dispatch_thread.start()
+            self._dispatch_queue.put(None)
+
+    def notify_stop(self) -> None:
+        """
+        Makes the dispatch thread exit once the callbacks of the notifications received so far have been executed
+        (e.g., when the subscriber is disconnected). A later notification starts a new dispatch thread.
+        """
+        with self._dispatch_lock:
+            if self._dispatch_thread is None:
+                return
+            # note: the exiting thread keeps its queue; a new thread (if any) gets a new one to preserve the order
+            self._dispatch_queue.put(NotifySubscriber._STOP)
+            self._dispatch_queue = queue.Queue()
+            self._dispatch_thread = None
+
+    def _dispatch(self, dispatch_queue: queue.Queue) -> None:
+        while True:
+            if dispatch_queue.get() is NotifySubscriber._STOP:
+                return
+            try:
+                self._notify_callback()
+            except Exception as ex:
+                log.exception(ex)
 
     def _notify_callback(self):
         pass
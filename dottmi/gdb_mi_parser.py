@@ -0,0 +1,142 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import re
+from typing import Dict, List, Tuple
+
+from pygdbmi import gdbmiparser
+
+# C-string as used by GDB MI (content in group 1, still escaped)
+_CSTR = r'"((?:[^"\\]|\\.)*)"'
+_UNESCAPE_RE = re.compile(r'\\(.)', re.DOTALL)
+
+# Frequently used records which are parsed without going through the generic (character-by-character) parser.
+_VALUE_RE = re.compile(r'^(\d*)\^done,value=' + _CSTR + r'$', re.DOTALL)
+_MEMORY_RE = re.compile(r'^(\d*)\^done,memory=\[\{begin="([^"]*)",offset="([^"]*)",end="([^"]*)",'
+                        r'contents="([0-9a-fA-F]*)"\}\]$')
+_REGISTER_VALUES_RE = re.compile(r'^(\d*)\^done,register-values=\[(.*)\]$', re.DOTALL)
+_REGISTER_VALUE_RE = re.compile(r'\{number="([^"]*)",value=' + _CSTR + r'\}')
+_SIMPLE_RESULT_RE = re.compile(r'^(\d*)\^(\w+)$')
+_RESULT_CLASS_RE = re.compile(r'^(\d+)\^([\w-]+)')
+_CONSOLE_RE = re.compile(r'^~"(.*)"$', re.DOTALL)
+_FINISHED_RE = re.compile(r'^\(gdb\)\s*$')
+
+
+def _unescape(text: str) -> str:
+    # same behavior as pygdbmi: drop the escaping backslash and keep the escaped character
+    if '\\' not in text:
+        return text
+    return _UNESCAPE_RE.sub(r'\1', text)
+
+
+def _token(token: str):
+    return int(token) if token else None
+
+
+def parse_record(line: str) -> Dict:
+    """
+    Parses a single GDB MI record (one line of GDB output). The returned dictionary has the same structure as the one
+    returned by pygdbmi's parse_response. The most frequently used records in DOTT (expression values, memory
+    reads, register values and plain result records) are parsed with dedicated regular expressions; all other records
+    are handed over to pygdbmi.
+
+    Args:
+        line: One line of GDB MI output (without line terminator).
+
+    Returns:
+        Dictionary representing the parsed record.
+    """
+    c = line[:1]
+    if c.isdigit() or c == '^':
+        m = _VALUE_RE.match(line)
+        if m:
+            return {'type': 'result', 'message': 'done', 'payload': {'value': _unescape(m.group(2))},
+                    'token': _token(m.group(1))}
+
+        m = _MEMORY_RE.match(line)
+        if m:
+            mem = {'begin': m.group(2), 'offset': m.group(3), 'end': m.group(4), 'contents': m.group(5)}
+            return {'type': 'result', 'message': 'done', 'payload': {'memory': [mem]}, 'token': _token(m.group(1))}
+
+        m = _SIMPLE_RESULT_RE.match(line)
+        if m:
+            return {'type': 'result', 'message': m.group(2), 'payload': None, 'token': _token(m.group(1))}
+
+        m = _REGISTER_VALUES_RE.match(line)
+        if m:
+            regs: List[Dict] = [{'number': num, 'value': _unescape(val)}
+                                for num, val in _REGISTER_VALUE_RE.findall(m.group(2))]
+            return {'type': 'result', 'message': 'done', 'payload': {'register-values': regs},
+                    'token': _token(m.group(1))}
+
+    elif c == '~':
+        m = _CONSOLE_RE.match(line)
+        if m:
+            return {'type': 'console', 'message': None, 'payload': m.group(1)}
+
+    return gdbmiparser.parse_response(line)
+
+
+def parse_result_class(line: str) -> Dict:
+    """
+    Parses only token and result class of a result record. The payload is not parsed, except for error records
+    where the error message is needed.
+
+    Args:
+        line: One line of GDB MI output (without line terminator).
+
+    Returns:
+        Dictionary representing the parsed record or None if the line is not a result record.
+    """
+    m = _RESULT_CLASS_RE.match(line)
+    if m is None:
+        return None
+    if m.group(2) == 'error':
+        return parse_record(line)
+    return {'type': 'result', 'message': m.group(2), 'payload': None, 'token': _token(m.group(1))}
+
+
+def get_result_token(line: str):
+    """
+    Returns the token of a result record or None if the line is not a result record with token.
+    """
+    m = _RESULT_CLASS_RE.match(line)
+    return int(m.group(1)) if m else None
+
+
+def split_records(data: bytes, incomplete: bytes) -> Tuple[List[str], bytes]:
+    """
+    Splits raw GDB output into complete lines. Data after the last line terminator is returned as incomplete
+    remainder which shall be passed in again together with the next chunk of data.
+
+    Args:
+        data: Data read from GDB.
+        incomplete: Incomplete remainder from the previous call.
+
+    Returns:
+        Tuple with the list of complete lines (without '(gdb)' prompt lines and empty lines) and the new remainder.
+    """
+    data = incomplete + data
+    end = data.rfind(b'\n')
+    if end == -1:
+        return [], data
+
+    lines = data[:end].decode(errors='replace').replace('\r', '').split('\n')
+    return [l for l in lines if l and not _FINISHED_RE.match(l)], data[end + 1:]
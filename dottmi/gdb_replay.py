@@ -0,0 +1,320 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Record and replay of debugger sessions. While recording (gdb_record_file in dott.ini), all MI commands sent to GDB,
+# the MI records received from GDB and the traffic of the intercept point channel are written to a compact binary log
+# (gzip compressed frames). A replayed session (gdb_replay_file in dott.ini) does not start GDB or a GDB server;
+# instead, GDB's responses are served from the log. This allows test logic and host-side code to be developed and
+# profiled without a board. The log only matches a test run which issues the same commands in the same order as the
+# recorded run (i.e., the same tests with the same binaries); commands which differ from the recorded ones (e.g., due to
+# host-specific paths) are counted and logged, a different order of commands aborts the replay.
+
+import gzip
+import json
+import re
+import socket
+import struct
+import threading
+from typing import Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.gdbcontrollerdott import GdbControllerDott
+from dottmi.utils import log
+
+# log file layout: magic followed by frames (kind, payload length, payload)
+_MAGIC = b'DOTTREC\x01'
+_FRAME_HDR_FMT = '<BI'
+_FRAME_HDR_LEN = struct.calcsize(_FRAME_HDR_FMT)
+
+# frame kinds; MI_WRITE and IP_SEND are issued by the host, MI_RECORDS and IP_RECV are produced by GDB
+MI_WRITE = 1
+MI_RECORDS = 2
+IP_SEND = 3
+IP_RECV = 4
+
+# record types which are evaluated by DOTT (see GdbMiResponseHandler); all others are not recorded
+_RECORD_TYPES = ('result', 'console', 'notify')
+
+# heartbeats (see GdbMi.heartbeat) use tokens below 1000; they are neither recorded nor replayed from the log
+_HEARTBEAT_RE = re.compile(r'^(\d{1,3})-')
+
+
+def _is_heartbeat_token(token) -> bool:
+    return isinstance(token, int) and token < 1000
+
+
+# -------------------------------------------------------------------------------------------------
+class SessionRecorder(object):
+    """
+    Writes the frames of a debugger session to a log file (see module description). Thread-safe since MI commands,
+    MI records and intercept point messages are handled by different threads.
+    """
+    def __init__(self, file_name: str) -> None:
+        self._file_name: str = file_name
+        self._file = gzip.open(file_name, 'wb')
+        self._file.write(_MAGIC)
+        self._lock: threading.Lock = threading.Lock()
+        self._num_frames: int = 0
+
+    @property
+    def file_name(self) -> str:
+        return self._file_name
+
+    def record(self, kind: int, payload: bytes) -> None:
+        with self._lock:
+            if self._file is None:
+                return
+            self._file.write(struct.pack(_FRAME_HDR_FMT, kind, len(payload)) + payload)
+            self._num_frames += 1
+
+    def record_write(self, cmd: str) -> None:
+        if _HEARTBEAT_RE.match(cmd) is None:
+            self.record(MI_WRITE, cmd.encode('utf-8'))
+
+    def record_records(self, records: List[Dict]) -> None:
+        records = [r for r in records if str(r.get('type')).lower() in _RECORD_TYPES
+                   and not _is_heartbeat_token(r.get('token'))]
+        if len(records) > 0:
+            self.record(MI_RECORDS, json.dumps(records, separators=(',', ':'), default=str).encode('utf-8'))
+
+    def close(self) -> None:
+        with self._lock:
+            if self._file is None:
+                return
+            self._file.close()
+            self._file = None
+        log.info(f'GDB session recorded to {self._file_name} ({self._num_frames} frames).')
+
+
+# -------------------------------------------------------------------------------------------------
+class RecordingSocket(object):
+    """
+    Wrapper of the intercept point channel's socket which records all data sent and received.
+    """
+    def __init__(self, sock: socket.socket, recorder: SessionRecorder) -> None:
+        self._sock: socket.socket = sock
+        self._recorder: SessionRecorder = recorder
+
+    def sendall(self, data: bytes) -> None:
+        self._recorder.record(IP_SEND, bytes(data))
+        self._sock.sendall(data)
+
+    def recv_into(self, buf, num_bytes: int = 0) -> int:
+        cnt = self._sock.recv_into(buf, num_bytes)
+        if cnt > 0:
+            self._recorder.record(IP_RECV, bytes(buf[:cnt]))
+        return cnt
+
+    def __getattr__(self, name: str):
+        return getattr(self._sock, name)
+
+
+# -------------------------------------------------------------------------------------------------
+class SessionReplay(object):
+    """
+    Serves a recorded debugger session. The frames of the log are consumed in their recorded order: frames produced by
+    GDB (MI records, intercept point messages received by DOTT) are released as soon as all frames before them have
+    been consumed; frames issued by the host (MI commands, intercept point messages sent by DOTT) are consumed when
+    the host issues them again.
+    """
+    # time to wait at maximum for the log position to reach a frame issued by the host (other threads might first have
+    # to consume the frames before it)
+    SYNC_TIMEOUT_SEC = 5.0
+
+    def __init__(self, file_name: str) -> None:
+        self._file_name: str = file_name
+        self._frames: List[Tuple[int, bytes]] = SessionReplay.load(file_name)
+        self._pos: int = 0
+        self._cond: threading.Condition = threading.Condition()
+        self._closed: bool = False
+        self._mi_pending: List[Dict] = []
+        self._ip_pending: bytearray = bytearray()
+        self._mismatches: int = 0
+        with self._cond:
+            self._release()
+        log.info(f'Replaying GDB session from {file_name} ({len(self._frames)} frames).')
+
+    @staticmethod
+    def load(file_name: str) -> List[Tuple[int, bytes]]:
+        """
+        Returns the frames (kind, payload) of the given log file.
+        """
+        with gzip.open(file_name, 'rb') as f:
+            data = f.read()
+        if not data.startswith(_MAGIC):
+            raise DottException(f'{file_name} is not a DOTT session log.')
+        frames = []
+        pos = len(_MAGIC)
+        while pos + _FRAME_HDR_LEN <= len(data):
+            kind, length = struct.unpack_from(_FRAME_HDR_FMT, data, pos)
+            pos += _FRAME_HDR_LEN
+            frames.append((kind, data[pos:pos + length]))
+            pos += length
+        return frames
+
+    @property
+    def closed(self) -> bool:
+        return self._closed
+
+    @property
+    def mismatches(self) -> int:
+        """
+        Number of commands and messages issued by the host which differ from the recorded ones.
+        """
+        return self._mismatches
+
+    def _release(self) -> None:
+        # releases the frames produced by GDB at the current position; called with the condition held
+        while self._pos < len(self._frames) and self._frames[self._pos][0] in (MI_RECORDS, IP_RECV):
+            kind, payload = self._frames[self._pos]
+            if kind == MI_RECORDS:
+                self._mi_pending.extend(json.loads(payload.decode('utf-8')))
+            else:
+                self._ip_pending += payload
+            self._pos += 1
+        self._cond.notify_all()
+
+    def _consume(self, kind: int, payload: bytes, what: str) -> None:
+        with self._cond:
+            self._cond.wait_for(lambda: self._closed or self._pos >= len(self._frames) or
+                                self._frames[self._pos][0] == kind, SessionReplay.SYNC_TIMEOUT_SEC)
+            if self._closed or self._pos >= len(self._frames) or self._frames[self._pos][0] != kind:
+                raise DottException(f'Replayed session diverged from the recording at {what} '
+                                    f'{payload[:80]} (end of log or unexpected order of commands).')
+            recorded = self._frames[self._pos][1]
+            if recorded != payload:
+                # note: commands containing host-specific paths (e.g., temporary files) are expected to differ
+                self._mismatches += 1
+                log.debug(f'Replayed {what} differs from recording: {payload[:80]} (recorded: {recorded[:80]}).')
+            self._pos += 1
+            self._release()
+
+    def mi_write(self, cmd: str) -> None:
+        m = _HEARTBEAT_RE.match(cmd)
+        if m is not None:
+            # heartbeats are answered by the replay itself
+            with self._cond:
+                self._mi_pending.append({'type': 'result', 'message': 'done', 'payload': None,
+                                         'token': int(m.group(1)), 'stream': 'stdout'})
+                self._cond.notify_all()
+            return
+        self._consume(MI_WRITE, cmd.encode('utf-8'), 'MI command')
+
+    def mi_wait(self, timeout: float) -> bool:
+        with self._cond:
+            return self._cond.wait_for(lambda: self._closed or len(self._mi_pending) > 0, timeout)
+
+    def mi_read(self) -> List[Dict]:
+        with self._cond:
+            records, self._mi_pending = self._mi_pending, []
+            return records
+
+    def ip_socket(self) -> 'ReplaySocket':
+        """
+        Returns the stand-in for the socket of the intercept point channel (see BreakpointHandler).
+        """
+        return ReplaySocket(self)
+
+    def ip_send(self, data: bytes) -> None:
+        self._consume(IP_SEND, bytes(data), 'intercept point message')
+
+    def ip_recv_into(self, buf, num_bytes: int) -> int:
+        with self._cond:
+            self._cond.wait_for(lambda: self._closed or len(self._ip_pending) > 0)
+            cnt = min(num_bytes, len(self._ip_pending))
+            buf[:cnt] = self._ip_pending[:cnt]
+            del self._ip_pending[:cnt]
+            return cnt
+
+    def close(self) -> None:
+        with self._cond:
+            if self._closed:
+                return
+            self._closed = True
+            self._cond.notify_all()
+        if self._mismatches > 0:
+            log.info(f'GDB session replay: {self._mismatches} command(s) differed from the recording (see debug log).')
+
+
+# -------------------------------------------------------------------------------------------------
+class ReplaySocket(object):
+    """
+    Stand-in for the intercept point channel's socket of a replayed session.
+    """
+    family = socket.AF_UNIX if hasattr(socket, 'AF_UNIX') else socket.AF_INET
+
+    def __init__(self, replay: SessionReplay) -> None:
+        self._replay: SessionReplay = replay
+        self._closed: bool = False
+
+    def sendall(self, data: bytes) -> None:
+        self._replay.ip_send(data)
+
+    def recv_into(self, buf, num_bytes: int = 0) -> int:
+        # note: returns 0 (i.e., channel closed) once the replay has been closed
+        return self._replay.ip_recv_into(buf, num_bytes or len(buf))
+
+    def settimeout(self, timeout: float) -> None:
+        pass
+
+    def setsockopt(self, *args) -> None:
+        pass
+
+    def shutdown(self, how: int) -> None:
+        self._replay.close()
+
+    def close(self) -> None:
+        self._replay.close()
+
+
+# -------------------------------------------------------------------------------------------------
+class GdbControllerReplay(GdbControllerDott):
+    """
+    Variant of GdbControllerDott which does not talk to a GDB instance but serves GDB's output from a recorded session
+    (see SessionReplay).
+    """
+    def __init__(self, replay: SessionReplay) -> None:
+        # note: GdbController.__init__ is deliberately not called since it would spawn a local GDB process
+        self.gdb_process = None
+        self._fast_parser: bool = True
+        self._replay: SessionReplay = replay
+
+    def write(self, mi_cmd_to_write, timeout_sec=None, raise_error_on_timeout=True, read_response=True):
+        if isinstance(mi_cmd_to_write, str):
+            mi_cmd_to_write = [mi_cmd_to_write]
+        for cmd in mi_cmd_to_write:
+            self._replay.mi_write(cmd)
+        return [] if not read_response else self.read_records()
+
+    def wait_for_output(self, timeout_sec: float) -> bool:
+        return self._replay.mi_wait(timeout_sec)
+
+    def has_terminated(self) -> bool:
+        return self._replay.closed
+
+    def add_result_only_token(self, token: int) -> None:
+        # note: the recorded records already are in the form requested during recording
+        pass
+
+    def read_records(self) -> List[Dict]:
+        return self._replay.mi_read()
+
+    def exit(self) -> None:
+        self._replay.close()
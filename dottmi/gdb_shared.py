@@ -18,32 +18,94 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import binascii
+import mmap
 import os
 import struct
+import threading
+import time
 
 
 class BpSharedConf():
-    # server-side port of TCP connection between MI and GDB process
-    GDB_CMD_SERVER_PORT = 20080
+    # address of the channel which connects the MI process with the GDB process (the port is chosen by the OS)
+    GDB_CMD_SERVER_ADDR = '127.0.0.1'
+
+class DottResp():
+    """
+    Responses of custom DOTT GDB commands which are sent via GDB's console stream. A response is a single console
+    line which starts with PREFIX such that the GDB MI response handler only needs a prefix check to tell responses
+    apart from regular console output (instead of searching every console line).
+    Note: This class is also used in GDB's context (Python 2.7 or 3) and must not use Python 3 only syntax.
+    Format: DOTT_RESP,<resp_id>,<command>,<field>,...,DOTT_RESP_END
+    """
+    PREFIX = 'DOTT_RESP,'
+    END = 'DOTT_RESP_END'
+
+    @staticmethod
+    def format(resp_id, cmd, *fields):
+        return ','.join([DottResp.PREFIX[:-1], str(resp_id), cmd] + [str(f) for f in fields] + [DottResp.END])
+
+    @staticmethod
+    def get_id(payload):
+        return int(payload[len(DottResp.PREFIX):payload.index(',', len(DottResp.PREFIX))])
+
+    @staticmethod
+    def get_fields(payload):
+        end = payload.rfind(DottResp.END)
+        return payload[len(DottResp.PREFIX):end].split(',')[2:-1]
+
 
 class BpMsg():
+    """
+    Message exchanged between the MI process and the GDB process for intercept points. All intercept points of a
+    GDB instance share one channel; messages carry the id of the intercept point they belong to.
+    Header: magic (2 bytes), version (1 byte), type (1 byte), breakpoint id (2 bytes), payload length (4 bytes).
+    """
     # header magic number
     MSG_HDR_MAGIC = b'\xd0\x11'
 
-    # header length (2 bytes for magic, 1 byte for type and 2 bytes for payload length)
-    MSG_HDR_LEN = 5
+    # version of the message format; both sides (MI and GDB process) have to use the same version
+    MSG_VERSION = 2
+
+    # header format and length
+    MSG_HDR_FMT = '<2sBcHI'
+    MSG_HDR_LEN = struct.calcsize(MSG_HDR_FMT)
 
     # message types
     MSG_TYPE_HIT  = b'\x01'
     MSG_TYPE_FINISH_CONT = b'\x02'
-    MSG_TYPE_EVAL = b'\x03'
+    MSG_TYPE_EVAL = b'\x03'  # response: typed value (see encode_value)
     MSG_TYPE_EXEC = b'\x04'
     MSG_TYPE_EXCEPT = b'\x05'
     MSG_TYPE_RESP = b'\x06'
+    MSG_TYPE_EVAL_MANY = b'\x07'  # payload: JSON list of expressions; response: JSON list of [ok, result] pairs
+    MSG_TYPE_EXEC_MANY = b'\x08'  # payload: JSON list of commands; executed until the first failing command
+    MSG_TYPE_RECORD = b'\x09'  # sent by action-based intercept points on every hit (payload: JSON); no response
+    MSG_TYPE_READ_MEM = b'\x0a'  # payload: address and length (see MEM_FMT); response: raw memory
+    MSG_TYPE_WRITE_MEM = b'\x0b'  # payload: address and length (see MEM_FMT) followed by raw memory
+    MSG_TYPE_SNAPSHOT = b'\x0c'  # sent by snapshot points on every hit (see SNAPSHOT_FMT); no response
+
+    # maximum payload length (payload length is encoded with 4 bytes)
+    MSG_PAYLOAD_LEN_MAX = 0xffffffff
+
+    # format of the memory address/length prefix of memory read/write messages
+    MEM_FMT = '<QI'
+
+    # format of the prefix of snapshot messages: hit number, GDB host time and status (0: the raw memory of the
+    # snapshot's regions follows; otherwise an error message follows)
+    SNAPSHOT_FMT = '<IdB'
 
-    def __init__(self, msg_type, payload=None):
+    # tags of typed values
+    VAL_INT = b'i'
+    VAL_FLOAT = b'f'
+    VAL_STR = b's'
+
+    def __init__(self, msg_type, payload=None, bp_id=0):
         self._magic = BpMsg.MSG_HDR_MAGIC
         self._msg_type = msg_type
+        self._bp_id = bp_id
+        if payload is not None and not isinstance(payload, bytes):
+            payload = payload.encode('utf-8')
         self._payload = payload
         if payload is None:
             self._payload_len = 0
@@ -52,8 +114,9 @@ class BpMsg():
 
     def __str__(self):
         ret_val = os.linesep
-        ret_val += 'magic: 0x%s, ' % self._magic.hex()
-        ret_val += 'type:  0x%s, ' % self._msg_type.hex()
+        ret_val += 'magic: 0x%s, ' % binascii.hexlify(self._magic).decode()
+        ret_val += 'type:  0x%s, ' % binascii.hexlify(self._msg_type).decode()
+        ret_val += 'bp id: %d, ' % self._bp_id
         ret_val += 'payload len: %d, ' % self._payload_len
         ret_val += 'payload: %s' % self._payload
         ret_val += os.linesep
@@ -62,43 +125,233 @@ class BpMsg():
     def get_type(self):
         return self._msg_type
 
+    def get_bp_id(self):
+        return self._bp_id
+
     def get_payload(self):
         return self._payload
 
     def get_payload_len(self):
-        return self._payload
+        return self._payload_len
 
-    @classmethod
-    def read_from_socket(cls, sock, timeout=None):
+    @staticmethod
+    def encode_value(val):
+        """
+        Encodes an int, float or str value into a typed binary payload.
+        """
+        if isinstance(val, float):
+            return BpMsg.VAL_FLOAT + struct.pack('<d', val)
+        if isinstance(val, (bytes, type(u''))):
+            return BpMsg.VAL_STR + (val if isinstance(val, bytes) else val.encode('utf-8'))
+        # integers are transferred as (arbitrary length) two's complement
+        num_bytes = 8
+        while not -(1 << (num_bytes * 8 - 1)) <= val < (1 << (num_bytes * 8 - 1)):
+            num_bytes *= 2
+        raw = bytearray(num_bytes)
+        for i in range(num_bytes):
+            raw[i] = (val >> (8 * i)) & 0xff
+        return BpMsg.VAL_INT + bytes(raw)
+
+    @staticmethod
+    def decode_value(payload):
+        """
+        Decodes a typed binary payload (see encode_value).
+        """
+        tag, data = payload[0:1], payload[1:]
+        if tag == BpMsg.VAL_FLOAT:
+            return struct.unpack('<d', data)[0]
+        if tag == BpMsg.VAL_INT:
+            val = 0
+            for i, b in enumerate(bytearray(data)):
+                val |= b << (8 * i)
+            if val >= 1 << (len(data) * 8 - 1):
+                val -= 1 << (len(data) * 8)
+            return val
+        return data.decode('utf-8')
 
-        remaining = cls.MSG_HDR_LEN
-        while remaining > 0:
-            header = sock.recv(remaining)
-            remaining -= len(header)
+    @staticmethod
+    def _recv_exact(sock, num_bytes):
+        buf = bytearray(num_bytes)
+        view = memoryview(buf)
+        pos = 0
+        while pos < num_bytes:
+            cnt = sock.recv_into(view[pos:], num_bytes - pos)
+            if cnt == 0:
+                raise EOFError('Breakpoint channel closed.')
+            pos += cnt
+        return bytes(buf)
 
-        magic = header[0:2]
-        msg_type = header[2:3]
-        payload_len = struct.unpack('H', header[3:5])[0]
+    @classmethod
+    def read_from_socket(cls, sock, timeout=None):
+        header = BpMsg._recv_exact(sock, cls.MSG_HDR_LEN)
+        magic, version, msg_type, bp_id, payload_len = struct.unpack(cls.MSG_HDR_FMT, header)
 
         if magic != BpMsg.MSG_HDR_MAGIC:
             raise ValueError('Wrong header magic for breakpoint message.')
+        if version != BpMsg.MSG_VERSION:
+            raise ValueError('Unsupported breakpoint message version %d (expected %d).' % (version, BpMsg.MSG_VERSION))
 
         payload = None
         if payload_len > 0:
-            payload = b''
-            remaining = payload_len
-            while remaining > 0:
-                payload += sock.recv(remaining)
-                remaining = payload_len - len(payload)
+            payload = BpMsg._recv_exact(sock, payload_len)
 
-        instance = cls(msg_type, payload)
+        instance = cls(msg_type, payload, bp_id)
         return instance
 
     def send_to_socket(self, sock):
-        payload_len_bytes = struct.pack('H', self._payload_len)
-        header = BpMsg.MSG_HDR_MAGIC + self._msg_type + payload_len_bytes
-        sock.sendall(header)
+        header = struct.pack(BpMsg.MSG_HDR_FMT, BpMsg.MSG_HDR_MAGIC, BpMsg.MSG_VERSION, self._msg_type, self._bp_id,
+                             self._payload_len)
         if self._payload_len > 0:
-            sock.sendall(self._payload)
+            sock.sendall(header + self._payload)
+        else:
+            sock.sendall(header)
+
+
+class ShmChannel(object):
+    """
+    Socket-like endpoint of the shared-memory intercept point channel (see bp_channel_shm in dott.ini). The channel
+    consists of two single-producer/single-consumer ring buffers (DOTT -> GDB and GDB -> DOTT) in a memory-mapped file
+    which both processes map. A message is transferred by copying it into the ring and advancing the ring's tail; the
+    consumer polls the tail for SPIN_SECS before it goes to sleep. Only a sleeping consumer is woken up by a byte on
+    the doorbell (the Unix domain socket which was used for the channel so far); hence, the round trips while an
+    intercept point is processed (DOTT and GDB wait for each other's responses) do not require any system call.
+    Closing the doorbell signals the end of the channel to the peer. Provides the subset of the socket interface used
+    by BpMsg and InterceptPointChannel.
+    Note: This class is also used in GDB's context (Python 2.7 or 3) and must not use Python 3 only syntax.
+    """
+    # capacity of each ring (bytes); larger messages are transferred in several chunks
+    RING_SIZE = 1 << 20
+
+    # ring header: consumer position and waiting flag of the consumer (first cache line), producer position (second
+    # cache line); the positions are byte counters which are never wrapped
+    HEAD_FMT = '<QI'
+    TAIL_FMT = '<Q'
+    TAIL_OFFSET = 64
+    HDR_LEN = 128
+    FILE_SIZE = 2 * (HDR_LEN + RING_SIZE)
+
+    # ring producing each endpoint's data
+    RING_DOTT = 0
+    RING_GDB = 1
+
+    # time (seconds) a consumer polls for data before it waits for the doorbell (no polling on single CPU hosts, the
+    # producer could not run while the consumer polls)
+    SPIN_SECS = 0.0002
+
+    def __init__(self, shm_file, doorbell, tx_ring):
+        self._doorbell = doorbell
+        self._family = doorbell.family
+        with open(shm_file, 'r+b') as f:
+            self._mem = mmap.mmap(f.fileno(), ShmChannel.FILE_SIZE)
+        self._tx = tx_ring * (ShmChannel.HDR_LEN + ShmChannel.RING_SIZE)
+        self._rx = (1 - tx_ring) * (ShmChannel.HDR_LEN + ShmChannel.RING_SIZE)
+        self._tx_lock = threading.Lock()
+        self._peer_closed = False
+        self._closed = False
+        try:
+            multi_cpu = os.sysconf('SC_NPROCESSORS_ONLN') > 1
+        except (AttributeError, ValueError, OSError):
+            multi_cpu = False
+        self._spin_secs = ShmChannel.SPIN_SECS if multi_cpu else 0.0
+
+    @staticmethod
+    def create_file(file_name):
+        # creates the (zero-initialized) shared file of a channel
+        with open(file_name, 'wb') as f:
+            f.truncate(ShmChannel.FILE_SIZE)
+
+    @property
+    def family(self):
+        return self._family
+
+    def _head(self, ring):
+        return struct.unpack_from(ShmChannel.HEAD_FMT, self._mem, ring)
+
+    def _tail(self, ring):
+        return struct.unpack_from(ShmChannel.TAIL_FMT, self._mem, ring + ShmChannel.TAIL_OFFSET)[0]
+
+    def _copy(self, ring, pos, data):
+        # copies data into the ring at the given (unwrapped) position
+        start = ring + ShmChannel.HDR_LEN
+        idx = pos % ShmChannel.RING_SIZE
+        first = min(len(data), ShmChannel.RING_SIZE - idx)
+        self._mem[start + idx:start + idx + first] = data[:first]
+        if first < len(data):
+            self._mem[start:start + len(data) - first] = data[first:]
+
+    def sendall(self, data):
+        if self._closed:
+            raise EOFError('Breakpoint channel closed.')
+        data = bytes(data)
+        with self._tx_lock:
+            pos = 0
+            while pos < len(data):
+                head, waiting = self._head(self._tx)
+                tail = self._tail(self._tx)
+                free = ShmChannel.RING_SIZE - (tail - head)
+                if free == 0:
+                    time.sleep(0.0001)  # note: only for messages which exceed the ring size
+                    continue
+                cnt = min(free, len(data) - pos)
+                self._copy(self._tx, tail, data[pos:pos + cnt])
+                struct.pack_into(ShmChannel.TAIL_FMT, self._mem, self._tx + ShmChannel.TAIL_OFFSET, tail + cnt)
+                pos += cnt
+                # note: the waiting flag is re-read after publishing; the consumer re-checks the tail after setting it
+                if self._head(self._tx)[1] != 0:
+                    self._doorbell.sendall(b'\x01')
+
+    def _wait_data(self):
+        # returns the number of bytes available in the receive ring (0: the channel was closed)
+        deadline = time.time() + self._spin_secs
+        while True:
+            head = self._head(self._rx)[0]
+            avail = self._tail(self._rx) - head
+            if avail > 0 or self._closed:
+                return avail
+            if time.time() < deadline:
+                continue
+            struct.pack_into(ShmChannel.HEAD_FMT, self._mem, self._rx, head, 1)
+            avail = self._tail(self._rx) - head
+            if avail == 0 and not self._peer_closed:
+                if self._doorbell.recv(64) == b'':
+                    self._peer_closed = True
+                avail = self._tail(self._rx) - head
+            struct.pack_into(ShmChannel.HEAD_FMT, self._mem, self._rx, head, 0)
+            if avail > 0 or self._peer_closed:
+                return avail
+            deadline = time.time() + self._spin_secs
+
+    def recv_into(self, buf, num_bytes=0):
+        if num_bytes == 0:
+            num_bytes = len(buf)
+        avail = self._wait_data()
+        if avail == 0:
+            return 0
+        cnt = min(avail, num_bytes)
+        head = self._head(self._rx)[0]
+        start = self._rx + ShmChannel.HDR_LEN
+        idx = head % ShmChannel.RING_SIZE
+        first = min(cnt, ShmChannel.RING_SIZE - idx)
+        buf[0:first] = self._mem[start + idx:start + idx + first]
+        if first < cnt:
+            buf[first:cnt] = self._mem[start:start + cnt - first]
+        struct.pack_into(ShmChannel.HEAD_FMT, self._mem, self._rx, head + cnt, 0)
+        return cnt
+
+    def settimeout(self, timeout):
+        self._doorbell.settimeout(timeout)
+
+    def setblocking(self, flag):
+        self._doorbell.setblocking(flag)
 
+    def shutdown(self, how):
+        self._closed = True
+        self._doorbell.shutdown(how)
 
+    def close(self):
+        self._closed = True
+        self._doorbell.close()
+        try:
+            self._mem.close()
+        except Exception:
+            pass  # note: still referenced by a reader (closed with the last reference)
@@ -19,9 +19,17 @@
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
 import logging
+import os
+import platform
+import select
+import socket
+import time
+from typing import Dict, List, Set, Tuple
 
 from pygdbmi.gdbcontroller import GdbController, DEFAULT_TIME_TO_CHECK_FOR_ADDITIONAL_OUTPUT_SEC
 
+from dottmi import gdb_mi_parser
+
 
 # The IoManager.py from pygdbmi uses the global logger for debug output. We suppress it with a filter.
 class LogFilter(logging.Filter):
@@ -32,9 +40,215 @@ class LogFilter(logging.Filter):
 
 
 class GdbControllerDott(GdbController):
+    # Interval used on Windows to check if the GDB pipe has data available (select does not support pipes there).
+    WIN_PIPE_PEEK_INTERVAL_SEC = 0.0005
+
+    # Maximum number of bytes read from a GDB pipe at once.
+    READ_CHUNK_SIZE = 65536
+
     def __init__(self, command,
-                 time_to_check_for_additional_output_sec=DEFAULT_TIME_TO_CHECK_FOR_ADDITIONAL_OUTPUT_SEC):
+                 time_to_check_for_additional_output_sec=DEFAULT_TIME_TO_CHECK_FOR_ADDITIONAL_OUTPUT_SEC,
+                 fast_parser: bool = True):
 
         # set logging filter for pygdbmi
         logging.getLogger().addFilter(LogFilter())
         super().__init__(command, time_to_check_for_additional_output_sec)
+
+        # if enabled, GDB output is read and parsed by DOTT's own MI parser instead of pygdbmi's IoManager
+        self._fast_parser: bool = fast_parser
+        self._incomplete: Dict[str, bytes] = {'stdout': b'', 'stderr': b''}
+
+        # tokens of commands for which only the result class is of interest (payload is not parsed)
+        self._result_only_tokens: Set[int] = set()
+
+    def wait_for_output(self, timeout_sec: float) -> bool:
+        """
+        Blocks until GDB has written new data to its stdout pipe or until the timeout has expired. In contrast to
+        get_gdb_response this function does not read or parse any data. It is intended to be followed by a call to
+        read_records which then collects all records which are available.
+
+        Args:
+            timeout_sec: Maximum time to wait for new data.
+
+        Returns:
+            True if data is available for reading (or the pipe was closed), False if the timeout expired.
+        """
+        stdout = self.gdb_process.stdout
+        if platform.system() != 'Windows':
+            readable, _, _ = select.select([stdout.fileno()], [], [], timeout_sec)
+            return len(readable) > 0
+
+        # On Windows, select only works on sockets. We therefore peek into the pipe to check if data is available.
+        import ctypes
+        import msvcrt
+        from ctypes import wintypes
+
+        handle = msvcrt.get_osfhandle(stdout.fileno())
+        avail = wintypes.DWORD(0)
+        end_time = time.time() + timeout_sec
+        while True:
+            if not ctypes.windll.kernel32.PeekNamedPipe(handle, None, 0, None, ctypes.byref(avail), None):
+                return True  # pipe broken (e.g., GDB has terminated); let the caller find out via read
+            if avail.value > 0:
+                return True
+            if time.time() >= end_time:
+                return False
+            time.sleep(GdbControllerDott.WIN_PIPE_PEEK_INTERVAL_SEC)
+
+    def has_terminated(self) -> bool:
+        """
+        Returns True if the GDB process has terminated, False otherwise.
+        """
+        return self.gdb_process is None or self.gdb_process.poll() is not None
+
+    def add_result_only_token(self, token: int) -> None:
+        """
+        Marks the command with the given token as 'result only'. For such commands, only the result class of the
+        result record is parsed. Has no effect if the fast parser is disabled.
+        """
+        if self._fast_parser:
+            self._result_only_tokens.add(token)
+
+    def _read_available(self, pipe) -> bytes:
+        # Note: pygdbmi puts the GDB pipes into non-blocking mode. Hence, reading stops once the pipe is drained.
+        data = b''
+        while True:
+            try:
+                chunk = os.read(pipe.fileno(), GdbControllerDott.READ_CHUNK_SIZE)
+            except (BlockingIOError, OSError):
+                break
+            if not chunk:
+                break
+            data += chunk
+            if len(chunk) < GdbControllerDott.READ_CHUNK_SIZE:
+                break
+        return data
+
+    def _read_streams(self) -> List[Tuple[str, bytes]]:
+        return [(stream, self._read_available(pipe))
+                for stream, pipe in (('stdout', self.gdb_process.stdout), ('stderr', self.gdb_process.stderr))
+                if pipe is not None]
+
+    def read_records(self) -> List[Dict]:
+        """
+        Reads all GDB output which is currently available without blocking and returns the parsed MI records.
+        Lines which are not yet complete are kept and are returned with the next call.
+
+        Returns:
+            List of parsed records in the same format as returned by get_gdb_response.
+        """
+        if not self._fast_parser:
+            return self.get_gdb_response(timeout_sec=0, raise_error_on_timeout=False)
+
+        records: List[Dict] = []
+        for stream, data in self._read_streams():
+            if not data:
+                continue
+            lines, self._incomplete[stream] = gdb_mi_parser.split_records(data, self._incomplete[stream])
+            for line in lines:
+                record = None
+                if self._result_only_tokens and line[:1].isdigit():
+                    token = gdb_mi_parser.get_result_token(line)
+                    if token in self._result_only_tokens:
+                        self._result_only_tokens.discard(token)
+                        record = gdb_mi_parser.parse_result_class(line)
+                if record is None:
+                    record = gdb_mi_parser.parse_record(line)
+                record['stream'] = stream
+                records.append(record)
+        return records
+
+
+class GdbControllerBroker(GdbControllerDott):
+    """
+    Variant of GdbControllerDott which does not spawn a GDB process itself. Instead, it obtains an already started
+    ('warm') GDB instance from a GDB broker (see dottmi.gdb_broker) and talks to it via a TCP connection. The broker
+    relays GDB's MI input and output 1:1. Since stdout and stderr of the brokered GDB are merged, all records are
+    reported as stdout records.
+    """
+    # timeout for connecting to the broker and for obtaining a GDB instance from it
+    CONNECT_TIMEOUT_SEC = 5.0
+
+    # handover acknowledge sent by the broker once a GDB instance is assigned to the connection
+    ACK = b'DOTT_GDB_BROKER_OK'
+
+    def __init__(self, broker_addr: str, broker_port: int, sock: socket.socket = None):
+        """
+        Constructor.
+
+        Args:
+            broker_addr: Address of the GDB broker.
+            broker_port: Port of the GDB broker.
+            sock: Already connected stream to a GDB instance (e.g., the MI channel of a DOTT agent; see dottmi.agent).
+                  If given, broker_addr and broker_port are ignored and no handover acknowledge is expected.
+        """
+        # note: GdbController.__init__ is deliberately not called since it would spawn a local GDB process
+        logging.getLogger().addFilter(LogFilter())
+        self.gdb_process = None
+        self._fast_parser: bool = True  # the generic pygdbmi reader only works with local pipes
+        self._incomplete: Dict[str, bytes] = {'stdout': b'', 'stderr': b''}
+        self._result_only_tokens: Set[int] = set()
+        self._terminated: bool = False
+
+        if sock is not None:
+            self._sock: socket.socket = sock
+            self._sock.setblocking(False)
+            return
+
+        self._sock = socket.create_connection((broker_addr, broker_port),
+                                              timeout=GdbControllerBroker.CONNECT_TIMEOUT_SEC)
+        self._sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+        # the broker acknowledges the handover of a GDB instance with a single line
+        ack = b''
+        while not ack.endswith(b'\n'):
+            chunk = self._sock.recv(1)
+            if not chunk:
+                raise ConnectionError('GDB broker closed the connection without providing a GDB instance.')
+            ack += chunk
+        if not ack.startswith(GdbControllerBroker.ACK):
+            raise ConnectionError(f'Unexpected response from GDB broker: {ack}')
+        self._sock.setblocking(False)
+
+    def write(self, mi_cmd_to_write, timeout_sec=None, raise_error_on_timeout=True, read_response=True):
+        if isinstance(mi_cmd_to_write, str):
+            mi_cmd_to_write = [mi_cmd_to_write]
+        data = ''.join(f'{cmd}\n' for cmd in mi_cmd_to_write).encode()
+        self._sock.setblocking(True)
+        try:
+            self._sock.sendall(data)
+        finally:
+            self._sock.setblocking(False)
+        return [] if not read_response else self.read_records()
+
+    def wait_for_output(self, timeout_sec: float) -> bool:
+        if self._terminated:
+            return True
+        readable, _, _ = select.select([self._sock], [], [], timeout_sec)
+        return len(readable) > 0
+
+    def has_terminated(self) -> bool:
+        return self._terminated
+
+    def _read_streams(self) -> List[Tuple[str, bytes]]:
+        data = b''
+        while not self._terminated:
+            try:
+                chunk = self._sock.recv(GdbControllerDott.READ_CHUNK_SIZE)
+            except (BlockingIOError, InterruptedError):
+                break
+            except OSError:
+                chunk = b''
+            if not chunk:
+                # the broker closes the connection once the brokered GDB has terminated
+                self._terminated = True
+                break
+            data += chunk
+        return [('stdout', data)]
+
+    def exit(self) -> None:
+        try:
+            self._sock.close()
+        except OSError:
+            pass
+        self._terminated = True
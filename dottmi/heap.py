@@ -0,0 +1,168 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import struct
+from typing import Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+
+# heap trace operations (see DOTT_HEAP_OP_xxx in testhelpers.h)
+_OP_ALLOC = 1
+_OP_FREE = 2
+
+# layout of DOTT_heap_trace_t (see testhelpers.h)
+_HEADER_SIZE = 8
+_EVENT_SIZE = 16
+
+# gaps between live blocks up to this size are the allocator's block headers and alignment (not counted as holes)
+_HOLE_MIN = 16
+
+
+# -------------------------------------------------------------------------------------------------
+class HeapReport(object):
+    """
+    Heap usage of a test as determined from the heap trace (see HeapTrace.stop). Sizes are requested sizes, i.e.,
+    without the allocator's block headers and alignment.
+    """
+    def __init__(self) -> None:
+        self.allocs: int = 0
+        self.frees: int = 0
+        self.failed: int = 0  # allocations which returned NULL
+        self.untracked_frees: int = 0  # releases of blocks allocated before the trace has been started
+        self.lost: int = 0  # events overwritten in the ring buffer before they have been read
+        self.peak_bytes: int = 0
+        self.live: Dict[int, Tuple[int, int]] = {}  # addr -> (size, caller) of blocks not released at the end
+        self.leaks: List[Tuple[int, int, str]] = []  # (addr, size, caller function) of the live blocks
+        self.largest_hole: int = 0
+        self.hole_bytes: int = 0
+
+    @property
+    def live_bytes(self) -> int:
+        return sum(size for size, _ in self.live.values())
+
+    @property
+    def fragmentation(self) -> float:
+        """
+        External fragmentation (0 to 1) of the address range spanned by the live blocks at the end of the test: 1 -
+        largest hole / sum of all holes between the live blocks. 0 if there are no holes.
+        """
+        return 1.0 - self.largest_hole / self.hole_bytes if self.hole_bytes > 0 else 0.0
+
+    def to_dict(self) -> Dict:
+        return {'allocs': self.allocs, 'frees': self.frees, 'failed': self.failed, 'peak_bytes': self.peak_bytes,
+                'leaked_bytes': self.live_bytes, 'leaks': len(self.leaks), 'fragmentation': self.fragmentation,
+                'untracked_frees': self.untracked_frees, 'lost': self.lost}
+
+    def __str__(self) -> str:
+        lines = [f'allocations: {self.allocs} ({self.failed} failed), frees: {self.frees}, peak: {self.peak_bytes} '
+                 f'bytes, not released: {self.live_bytes} bytes in {len(self.leaks)} blocks, fragmentation: '
+                 f'{self.fragmentation:.2f}']
+        if self.lost > 0:
+            lines.append(f'warning: {self.lost} heap events lost (increase DOTT_HEAP_TRACE_ENTRIES)')
+        for addr, size, caller in self.leaks:
+            lines.append(f'  leak: {size} bytes at 0x{addr:08x} allocated by {caller}')
+        return '\n'.join(lines)
+
+
+# -------------------------------------------------------------------------------------------------
+class HeapTrace(object):
+    """
+    Host side of DOTT's heap instrumentation (DOTT_HEAP_TRACE in testhelpers.h). The firmware's wrappers of malloc,
+    calloc, realloc and free record every call in the DOTT_heap_trace ring buffer. start remembers the current position
+    of the ring buffer and stop reads the events recorded since then (with a single bulk read) and analyzes them: peak
+    usage, blocks not released (leaks, with the allocating function) and fragmentation. For example:
+        trace = HeapTrace(dt)
+        trace.start()
+        dt.call('app_ProcessMessage', msg)
+        report = trace.stop()
+        assert 0 == report.live_bytes
+    The heap_trace option in dott.ini does this for every test (see the target_reset_xxx fixtures).
+    """
+    def __init__(self, target: 'Target') -> None:
+        self._target: 'Target' = target
+        if not target.symbols.exists('DOTT_heap_trace'):
+            raise DottException('DOTT_heap_trace not found. Build the firmware with DOTT_HEAP_TRACE.')
+        self._addr: int = target.symbols.addr('DOTT_heap_trace')
+        self._num_entries: int = None
+        self._start_head: int = None
+
+    @property
+    def active(self) -> bool:
+        return self._start_head is not None
+
+    def _read_header(self) -> Tuple[int, int]:
+        return struct.unpack('<II', self._target.mem.read(self._addr, _HEADER_SIZE))
+
+    def start(self) -> None:
+        """
+        Starts a trace at the current position of the ring buffer. The target has to be halted.
+        """
+        head, self._num_entries = self._read_header()
+        if self._num_entries == 0:
+            raise DottException('DOTT_heap_trace is not initialized.')
+        self._start_head = head
+
+    def stop(self) -> HeapReport:
+        """
+        Reads the events recorded since start and returns their analysis. The target has to be halted.
+        """
+        if self._start_head is None:
+            raise DottException('The heap trace has not been started.')
+        head, _ = self._read_header()
+        count = (head - self._start_head) & 0xffffffff
+        self._start_head = None
+
+        report = HeapReport()
+        if count > self._num_entries:
+            report.lost = count - self._num_entries
+            count = self._num_entries
+        data = self._target.mem.read(self._addr + _HEADER_SIZE, self._num_entries * _EVENT_SIZE) if count > 0 else b''
+        events = list(struct.iter_unpack('<IIII', data))
+        first = (head - count) % self._num_entries
+        self._analyze(report, (events[(first + i) % self._num_entries] for i in range(count)))
+        return report
+
+    def _analyze(self, report: HeapReport, events) -> None:
+        live_bytes = 0
+        for op, ptr, size, caller in events:
+            if op == _OP_ALLOC:
+                report.allocs += 1
+                if ptr == 0:
+                    report.failed += 1
+                    continue
+                report.live[ptr] = (size, caller)
+                live_bytes += size
+                report.peak_bytes = max(report.peak_bytes, live_bytes)
+            elif op == _OP_FREE:
+                report.frees += 1
+                if ptr in report.live:
+                    live_bytes -= report.live.pop(ptr)[0]
+                else:
+                    report.untracked_frees += 1
+
+        symbols = self._target.symbols
+        report.leaks = [(addr, size, symbols.func_at(caller & ~1) or f'0x{caller:08x}')
+                        for addr, (size, caller) in sorted(report.live.items())]
+        blocks = sorted((addr, size) for addr, (size, _) in report.live.items())
+        for (addr, size), (next_addr, _) in zip(blocks, blocks[1:]):
+            hole = next_addr - (addr + size)
+            if hole > _HOLE_MIN:
+                report.hole_bytes += hole
+                report.largest_hole = max(report.largest_hole, hole)
@@ -0,0 +1,227 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Micro-benchmarks of DOTT itself (host side). Measured are the startup time (GDB and GDB server up to the connected
+# target), the download, the setup of the target_reset fixture, the latency of Target.eval and Target.exec, the
+# throughput of TargetMem.read/write by transfer size, the latency from continuing the target to the notification of a
+# HaltPoint hit and the round trip of an InterceptPoint hit (including one eval in its reached method). Only symbols of
+# DOTT's testhelpers (DOTT_test_hook_mem, DOTT_bench_nop) are used; hence, any firmware built for DOTT can be used. The
+# application (app_load_elf, app_symbol_elf) and the GDB backend are taken from dott.ini in the current folder; with
+# gdb_replay_file, a recorded session is replayed (see dottmi.gdb_replay; the recording has to be done with the same
+# iteration count). Results are written as JSON and compared against a baseline (e.g., the results of the previous
+# DOTT release); the exit code is 1 if a benchmark regressed by more than the tolerance.
+#
+# Usage: python -m dottmi.host_bench [--output <results>] [--baseline <results>] [--tolerance 0.2] [--iterations 100]
+#                                    [--sram] [--load-elf <elf>] [--symbol-elf <elf>]
+
+import argparse
+import json
+import sys
+import threading
+import time
+from typing import Callable, Dict, List
+
+from dottmi.bench import BenchRecorder
+from dottmi.breakpoint import HaltPoint, InterceptPoint
+
+FILE_VERSION = 1
+
+# transfer sizes (in bytes) of the memory throughput benchmarks (limited to the size of DOTT_test_hook_mem)
+MEM_SIZES = [4, 64, 1024, 4096]
+
+
+class _NoMarkers(object):
+    # stand-in for the pytest request passed to target_reset_common (no dott_mem marker)
+    keywords: Dict = {}
+
+
+class _CountingPoint(InterceptPoint):
+    # intercept point which performs one eval per hit and signals once the requested number of hits is reached
+    def __init__(self, location: str, hits: int) -> None:
+        super().__init__(location)
+        self.remaining: int = hits
+        self.done: threading.Event = threading.Event()
+
+    def reached(self) -> None:
+        self.eval('$sp')
+        self.remaining -= 1
+        if self.remaining == 0:
+            self.done.set()
+
+
+def _latency(name: str, fn: Callable, iterations: int) -> Dict:
+    # times the given function (microseconds per call)
+    samples: List[float] = []
+    for _ in range(iterations):
+        start = time.perf_counter()
+        fn()
+        samples.append((time.perf_counter() - start) * 1e6)
+    samples.sort()
+    return {'name': name, 'unit': 'us', 'iterations': iterations, 'min': samples[0],
+            'median': samples[len(samples) // 2], 'p99': samples[min(len(samples) - 1, int(len(samples) * .99))],
+            'max': samples[-1]}
+
+
+def _throughput(name: str, fn: Callable, num_bytes: int, iterations: int) -> Dict:
+    res = _latency(name, fn, iterations)
+    res['throughput'] = num_bytes / (res['median'] / 1e6) / 1024  # KiB/s (based on the median)
+    return res
+
+
+def run(iterations: int, sram: bool) -> Dict[str, Dict]:
+    """
+    Runs all benchmarks and returns their results (keyed by benchmark name).
+    """
+    from dottmi.dott import dott
+    from dottmi.fixtures import target_load_common, target_reset_common
+
+    results: Dict[str, Dict] = {}
+
+    start = time.perf_counter()
+    dt = dott().target
+    results['startup'] = {'name': 'startup', 'unit': 'us', 'iterations': 1,
+                          'median': (time.perf_counter() - start) * 1e6}
+
+    start = time.perf_counter()
+    target_load_common('SRAM' if sram else 'FLASH', load_to_flash=not sram, silent=True, dt=dt)
+    results['load'] = {'name': 'load', 'unit': 'us', 'iterations': 1, 'median': (time.perf_counter() - start) * 1e6}
+
+    sp, pc = ('0x20000000', '0x20000004') if sram else (None, None)
+
+    def reset() -> None:
+        fixture = target_reset_common(_NoMarkers(), sp=sp, pc=pc, dt=dt)
+        next(fixture)
+        for _ in fixture:
+            pass
+
+    results['fixture_reset'] = _latency('fixture_reset', reset, max(1, iterations // 10))
+    fixture = target_reset_common(_NoMarkers(), sp=sp, pc=pc, dt=dt)
+    next(fixture)
+
+    results['eval'] = _latency('eval', lambda: dt.eval('DOTT_test_hook_mem[0]'), iterations)
+    results['exec'] = _latency('exec', lambda: dt.exec('-gdb-show confirm'), iterations)
+
+    mem_addr = dt.symbols.addr('DOTT_test_hook_mem')
+    mem_size = dt.symbols.size('DOTT_test_hook_mem') or max(MEM_SIZES)
+    for size in (s for s in MEM_SIZES if s <= mem_size):
+        data = bytes(i & 0xff for i in range(size))
+        results[f'mem_write_{size}'] = _throughput(f'mem_write_{size}', lambda: dt.mem.write(mem_addr, data), size,
+                                                   iterations)
+        results[f'mem_read_{size}'] = _throughput(f'mem_read_{size}', lambda: dt.mem.read(mem_addr, size), size,
+                                                  iterations)
+
+    # DOTT_bench_nop returns to itself (lr) such that the target hits the breakpoint over and over again
+    nop = dt.symbols.addr('DOTT_bench_nop') & ~1
+    dt.eval(f'$pc = {nop}')
+    dt.eval(f'$lr = {nop | 1}')
+
+    hp = HaltPoint('DOTT_bench_nop')
+
+    def halt_point_hit() -> None:
+        dt.cont()
+        hp.wait_complete()
+
+    results['halt_point_hit'] = _latency('halt_point_hit', halt_point_hit, iterations)
+    hp.delete()
+
+    ip = _CountingPoint('DOTT_bench_nop', iterations)
+    start = time.perf_counter()
+    dt.cont()
+    ip.done.wait(60)
+    elapsed = time.perf_counter() - start
+    dt.halt()
+    ip.delete()
+    results['intercept_point_round_trip'] = {'name': 'intercept_point_round_trip', 'unit': 'us',
+                                             'iterations': iterations - ip.remaining,
+                                             'median': elapsed * 1e6 / max(1, iterations - ip.remaining)}
+
+    for _ in fixture:
+        pass
+    dott().shutdown()
+    return results
+
+
+def compare(results: Dict[str, Dict], baseline: Dict[str, Dict], tolerance: float) -> List[str]:
+    """
+    Returns the regressions of the results against the baseline: latencies (medians) more than the tolerance above the
+    baseline and throughputs more than the tolerance below it.
+    """
+    regressions = []
+    for key, res in results.items():
+        base = baseline.get(key)
+        if base is None:
+            continue
+        if 'throughput' in res and 'throughput' in base:
+            if res['throughput'] < base['throughput'] * (1.0 - tolerance):
+                regressions.append(f'{key}: {res["throughput"]:.1f} KiB/s is below baseline '
+                                   f'({base["throughput"]:.1f} KiB/s) by more than {tolerance * 100:.0f}%')
+        elif res['median'] > base['median'] * (1.0 + tolerance):
+            regressions.append(f'{key}: {res["median"]:.1f} us exceeds baseline ({base["median"]:.1f} us) by more '
+                               f'than {tolerance * 100:.0f}%')
+    return regressions
+
+
+def report(results: Dict[str, Dict], baseline: Dict[str, Dict]) -> str:
+    lines = [f'{"benchmark":<28}{"median[us]":>14}{"p99[us]":>12}{"KiB/s":>10}{"baseline":>14}']
+    for key, res in results.items():
+        base = baseline.get(key)
+        base_val = '' if base is None else \
+            (f'{base["throughput"]:.1f}' if 'throughput' in res and 'throughput' in base else f'{base["median"]:.1f}')
+        lines.append(f'{key:<28}{res["median"]:>14.1f}{res.get("p99", res["median"]):>12.1f}'
+                     f'{res.get("throughput", 0.0):>10.1f}{base_val:>14}')
+    return '\n'.join(lines)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Benchmarks the host side of DOTT.')
+    parser.add_argument('--output', default=None, help='JSON file the results are written to')
+    parser.add_argument('--baseline', default=None, help='JSON results file the results are compared against')
+    parser.add_argument('--tolerance', type=float, default=0.2, help='relative tolerance (default: 0.2)')
+    parser.add_argument('--iterations', type=int, default=100, help='iterations per benchmark (default: 100)')
+    parser.add_argument('--sram', action='store_true', help='download the application to SRAM')
+    parser.add_argument('--load-elf', default=None, help='application to download (default: app_load_elf)')
+    parser.add_argument('--symbol-elf', default=None, help='symbols of the application (default: app_symbol_elf)')
+    args = parser.parse_args()
+
+    from dottmi.dott import DottConf
+    if args.load_elf is not None:
+        DottConf.conf['app_load_elf'] = args.load_elf
+        DottConf.conf['app_symbol_elf'] = args.symbol_elf if args.symbol_elf is not None else args.load_elf
+
+    baseline: Dict[str, Dict] = {}
+    if args.baseline is not None:
+        with open(args.baseline, 'r') as f:
+            content = json.load(f)
+        if content.get('version') != FILE_VERSION:
+            sys.exit(f'Unsupported baseline file {args.baseline}.')
+        baseline = content['results']
+
+    results = run(args.iterations, args.sram)
+    print(report(results, baseline))
+    if args.output is not None:
+        with open(args.output, 'w') as f:
+            json.dump({'version': FILE_VERSION, 'commit': BenchRecorder._git_commit(), 'results': results}, f,
+                      indent=2)
+
+    regressions = compare(results, baseline, args.tolerance)
+    for regression in regressions:
+        print(f'REGRESSION: {regression}')
+    sys.exit(1 if len(regressions) > 0 else 0)
+
+
+if __name__ == '__main__':
+    main()
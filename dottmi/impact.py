@@ -0,0 +1,278 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Test impact analysis (pytest plugin, loaded with -p dottmi.impact). During a session, the firmware functions executed
+# by each test are recorded using the coverage sweep (see CoverageCollector; probes are re-armed after every test).
+# Together with a hash of each function's code (taken from the symbol ELF) they are stored in the impact file. With
+# --dott-impact-select, only tests are run which are affected by a change of the firmware: tests which executed a
+# function whose code changed (or which was removed), tests which have no record or did not pass last time and tests
+# whose test file changed. A change of initialized data (e.g., constant tables) selects all tests.
+# Function hashes are invariant to code moving around: for ARM Thumb code, BL/BLX call targets and literal pool words
+# which point to symbols are replaced by the symbol name before hashing. Notes:
+# - The per-test record is complete only if all probes are armed at once, i.e., if the coverage breakpoint budget
+#   (coverage_bp_budget) covers all functions (e.g., for targets with FLASH breakpoints or RAM builds). Otherwise, the
+#   record of a test is accumulated over several runs.
+# - Calls of functions through pointers to other parts of the firmware are recorded like any other call. Code which
+#   is not covered by a function symbol (e.g., hand-written assembly without symbol size) is not tracked.
+#
+# Usage: pytest -p dottmi.impact [--dott-impact-file <file>] [--dott-impact-select] [--dott-impact-elf <elf>]
+
+import bisect
+import configparser
+import hashlib
+import json
+import os
+import struct
+from typing import Dict, List, Set, Tuple
+
+from dottmi.dott import DottConf
+from dottmi.elf_file import ElfFile
+from dottmi.symbols import BinarySymbols
+from dottmi.utils import log
+
+# default file which holds the functions executed by each test and the function hashes
+DEFAULT_IMPACT_FILE = '.dott_impact.json'
+
+_SHT_PROGBITS = 1
+_SHF_EXECINSTR = 0x4
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+# ELF hashing
+def _resolver(index: Dict[str, Dict]):
+    syms = sorted((sym['addr'], max(sym['size'], 1), name) for name, sym in index.items()
+                  if sym['type'] in ('func', 'object') and sym['addr'] != 0)
+    starts = [s[0] for s in syms]
+
+    def resolve(addr: int) -> str:
+        i = bisect.bisect_right(starts, addr) - 1
+        if i < 0 or addr >= syms[i][0] + syms[i][1]:
+            return None
+        return syms[i][2] if addr == syms[i][0] else f'{syms[i][2]}+{addr - syms[i][0]}'
+    return resolve
+
+
+def _thumb_call_target(hw1: int, hw2: int, pc: int) -> int:
+    # Thumb-2 BL (hw2 bits 15:14,12 = 11,1) and BLX (hw2 bits 15:14,12 = 11,0; target is word aligned)
+    s = (hw1 >> 10) & 1
+    i1 = 1 - (((hw2 >> 13) & 1) ^ s)
+    i2 = 1 - (((hw2 >> 11) & 1) ^ s)
+    imm = (s << 24) | (i1 << 23) | (i2 << 22) | ((hw1 & 0x3ff) << 12) | ((hw2 & 0x7ff) << 1)
+    if s:
+        imm -= 1 << 25
+    base = pc + 4 if hw2 & 0x1000 else (pc + 4) & ~0x3
+    return base + imm
+
+
+def _normalized_hash(data: bytes, addr: int, bo: str, word: int, thumb: bool, resolve) -> str:
+    # replaces position dependent parts (call targets, pointers to symbols) by symbol names and returns the SHA-1
+    code = bytearray(data)
+    refs: List[str] = []
+    if thumb:
+        i = 0
+        while i + 4 <= len(code):
+            hw1, hw2 = struct.unpack_from(bo + 'HH', code, i)
+            if hw1 & 0xf800 == 0xf000 and hw2 & 0xd000 in (0xd000, 0xc000):
+                name = resolve(_thumb_call_target(hw1, hw2, addr + i))
+                if name is not None:
+                    code[i:i + 4] = b'\x00' * 4
+                    refs.append(f'{i}:{name}')
+                i += 4
+            elif hw1 & 0xe000 == 0xe000 and hw1 & 0x1800 != 0:
+                i += 4  # other 32 bit Thumb-2 instruction
+            else:
+                i += 2
+    fmt = bo + ('I' if word == 4 else 'Q')
+    for i in range((-addr) % word, len(code) - word + 1, word):
+        value, = struct.unpack_from(fmt, code, i)
+        name = resolve(value & ~0x1 if thumb else value) if value != 0 else None
+        if name is not None:
+            code[i:i + word] = b'\x00' * word
+            refs.append(f'{i}:{name}')
+    return hashlib.sha1(bytes(code) + '\n'.join(refs).encode()).hexdigest()
+
+
+def elf_hashes(elf_file: str) -> Dict[str, Dict[str, str]]:
+    """
+    Returns the hashes of the functions and of the initialized data objects of the given ELF file as dictionary with
+    keys 'functions' and 'objects' (each mapping symbol names to hashes).
+    """
+    elf = ElfFile.open(elf_file)
+    res: Dict[str, Dict[str, str]] = {'functions': {}, 'objects': {}}
+    if not elf.is_elf:
+        return res
+    bo, machine, sections, sec_names = elf.sections
+    sec_by_name = {name: sec for name, sec in zip(sec_names, sections)}
+    index = elf.symbols
+    resolve = _resolver(index)
+    with elf.mapped() as data:
+        word = 4 if data[4] == 1 else 8
+        for name, sym in index.items():
+            sec = sec_by_name.get(sym['section'])
+            if sym['type'] not in ('func', 'object') or sec is None or sec[1] != _SHT_PROGBITS or sym['size'] == 0:
+                continue  # note: zero-initialized (NOBITS) data has no content in the ELF
+            start = sec[4] + sym['addr'] - sec[3]
+            content = data[start:start + sym['size']]
+            if sym['type'] == 'func':
+                thumb = machine == BinarySymbols._EM_ARM
+                res['functions'][name] = _normalized_hash(content, sym['addr'], bo, word, thumb, resolve)
+            elif not sec[2] & _SHF_EXECINSTR:
+                res['objects'][name] = _normalized_hash(content, sym['addr'], bo, word, False, resolve)
+    return res
+
+
+def _combined_hash(hashes: Dict[str, str]) -> str:
+    return hashlib.sha1(json.dumps(hashes, sort_keys=True).encode()).hexdigest()
+
+
+def _file_hash(file_name: str) -> str:
+    try:
+        with open(file_name, 'rb') as f:
+            return hashlib.sha1(f.read()).hexdigest()
+    except OSError:
+        return None
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class ImpactMap(object):
+    """
+    Functions executed by each test (with the hashes they had when the test was run) and test selection based on it.
+    """
+    def __init__(self, file_name: str) -> None:
+        self._file_name: str = file_name
+        self._tests: Dict[str, Dict] = {}
+        try:
+            with open(file_name, 'r') as f:
+                self._tests = json.load(f).get('tests', {})
+        except (OSError, ValueError):
+            pass
+
+    def reason(self, nodeid: str, test_file: str, hashes: Dict[str, Dict[str, str]]) -> str:
+        """
+        Returns the reason why the given test has to be run or None if it is not affected by any change.
+        """
+        rec = self._tests.get(nodeid)
+        if rec is None:
+            return 'no record'
+        if not rec.get('passed', False):
+            return 'not passed'
+        if rec.get('file') != _file_hash(test_file):
+            return 'test file changed'
+        if rec.get('objects') != _combined_hash(hashes['objects']):
+            return 'data changed'
+        for func, func_hash in rec.get('functions', {}).items():
+            if hashes['functions'].get(func) != func_hash:
+                return f'function {func} changed'
+        return None
+
+    def update(self, nodeid: str, test_file: str, funcs: Set[str], passed: bool,
+               hashes: Dict[str, Dict[str, str]]) -> None:
+        # note: functions recorded by earlier runs are kept (the sweep may not have armed all probes)
+        prev = set(self._tests.get(nodeid, {}).get('functions', {}))
+        self._tests[nodeid] = {'functions': {f: hashes['functions'][f] for f in sorted(prev | funcs)
+                                             if f in hashes['functions']},
+                               'objects': _combined_hash(hashes['objects']),
+                               'file': _file_hash(test_file),
+                               'passed': passed}
+
+    def save(self) -> None:
+        tmp_file = f'{self._file_name}.{os.getpid()}.tmp'
+        with open(tmp_file, 'w') as f:
+            json.dump({'tests': self._tests}, f, indent=1, sort_keys=True)
+        os.replace(tmp_file, self._file_name)
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+# pytest plugin
+_impact_map: ImpactMap = None
+_hashes: Dict[str, Dict[str, str]] = None
+_executed: Dict[str, Tuple[str, Set[str]]] = {}  # nodeid -> (test file, functions executed by the test)
+_passed: Dict[str, bool] = {}
+
+
+def _symbol_elf(config) -> str:
+    # note: DOTT's configuration is parsed when the first target is created (i.e., after collection)
+    elf = config.getoption('dott_impact_elf')
+    if elf is None:
+        elf = DottConf.conf.get('app_symbol_elf') or DottConf.conf.get('app_load_elf')
+    if elf is None and os.path.exists('dott.ini'):
+        ini = configparser.ConfigParser()
+        ini.read('dott.ini')
+        if ini.has_section('DOTT'):
+            elf = ini['DOTT'].get('app_symbol_elf') or ini['DOTT'].get('app_load_elf')
+    return elf
+
+
+def pytest_addoption(parser) -> None:
+    group = parser.getgroup('dott-impact', 'DOTT test impact analysis')
+    group.addoption('--dott-impact-file', default=DEFAULT_IMPACT_FILE, help='file with the test impact records')
+    group.addoption('--dott-impact-select', action='store_true', default=False,
+                    help='only run tests affected by firmware changes')
+    group.addoption('--dott-impact-elf', default=None, help='symbol ELF (default: app_symbol_elf of dott.ini)')
+
+
+def pytest_configure(config) -> None:
+    global _impact_map, _hashes
+    elf = _symbol_elf(config)
+    if elf is None or not os.path.exists(elf):
+        log.warn(f'Test impact analysis disabled (symbol ELF {elf} not found).')
+        return
+    DottConf.conf['impact_recording'] = True
+    _impact_map = ImpactMap(config.getoption('dott_impact_file'))
+    _hashes = elf_hashes(elf)
+
+
+def pytest_collection_modifyitems(session, config, items) -> None:
+    if _impact_map is None or not config.getoption('dott_impact_select'):
+        return
+    selected, deselected = [], []
+    for item in items:
+        reason = _impact_map.reason(item.nodeid, str(item.fspath), _hashes)
+        (selected if reason is not None else deselected).append(item)
+        if reason is not None:
+            log.debug(f'{item.nodeid} selected ({reason}).')
+    log.info(f'Test impact analysis: {len(selected)} of {len(items)} tests affected by changes.')
+    if len(deselected) > 0:
+        config.hook.pytest_deselected(items=deselected)
+    items[:] = selected
+
+
+def pytest_runtest_makereport(item, call) -> None:
+    # note: the functions are attached to the item by DOTT's cleanup fixture (after the coverage sweep's rotation);
+    # tests without functions (e.g., the sweep was not started) are not recorded
+    if _impact_map is not None and call.when == 'teardown' and hasattr(item, '_dott_functions'):
+        _executed[item.nodeid] = (str(item.fspath), set(item._dott_functions))
+
+
+def pytest_runtest_logreport(report) -> None:
+    # note: skipped and xfailed tests do not count as passed (they are run again by the next selection)
+    if _impact_map is not None:
+        _passed[report.nodeid] = _passed.get(report.nodeid, True) and report.passed
+
+
+def pytest_sessionfinish(session, exitstatus) -> None:
+    if _impact_map is None or len(_executed) == 0:
+        return
+    for nodeid, (test_file, funcs) in _executed.items():
+        _impact_map.update(nodeid, test_file, funcs, _passed.get(nodeid, False), _hashes)
+    try:
+        _impact_map.save()
+    except OSError as ex:
+        log.warn(f'Unable to write test impact file ({ex}).')
@@ -0,0 +1,214 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import struct
+import time
+from typing import List, Tuple
+
+from dottmi.dottexceptions import DottException
+
+# layout of DOTT_irq_latency_t (see testhelpers.h)
+_HEADER_SIZE = 8
+_SAMPLE_SIZE = 8
+
+
+# -------------------------------------------------------------------------------------------------
+def histogram(values: List[int], bins: int = 16) -> List[Tuple[int, int, int]]:
+    """
+    Returns the histogram of the given values as list of (lower bound, upper bound (exclusive), count) with equally
+    sized bins spanning the range of the values.
+    """
+    if len(values) == 0:
+        return []
+    lo, hi = min(values), max(values) + 1
+    width = max(1, -(-(hi - lo) // bins))  # ceil
+    counts = [0] * -(-(hi - lo) // width)
+    for v in values:
+        counts[(v - lo) // width] += 1
+    return [(lo + i * width, lo + (i + 1) * width, n) for i, n in enumerate(counts)]
+
+
+class IrqLatencyReport(object):
+    """
+    Interrupt entry latencies and handler durations (in ticks of the counter used by the handler and, if tick_hz is
+    given, in microseconds) as recorded by DOTT_IRQ_LATENCY_ENTER/EXIT (see IrqLatency).
+    """
+    def __init__(self, samples: List[Tuple[int, int]], lost: int, tick_hz: float = None) -> None:
+        self.latencies: List[int] = [lat for lat, _ in samples]
+        self.durations: List[int] = [dur for _, dur in samples]
+        self.lost: int = lost  # samples overwritten in the ring buffer before they have been read
+        self.tick_hz: float = tick_hz
+
+    @property
+    def count(self) -> int:
+        return len(self.latencies)
+
+    @staticmethod
+    def _stats(values: List[int]) -> Tuple[int, int, float, int, int]:
+        # min, max, mean, median and 99th percentile
+        if len(values) == 0:
+            return 0, 0, 0.0, 0, 0
+        s = sorted(values)
+        return s[0], s[-1], sum(s) / len(s), s[len(s) // 2], s[min(len(s) - 1, (len(s) * 99) // 100)]
+
+    def latency_stats(self) -> Tuple[int, int, float, int, int]:
+        return IrqLatencyReport._stats(self.latencies)
+
+    def duration_stats(self) -> Tuple[int, int, float, int, int]:
+        return IrqLatencyReport._stats(self.durations)
+
+    def us(self, ticks: float) -> float:
+        return ticks * 1e6 / self.tick_hz if self.tick_hz is not None else None
+
+    def histogram_str(self, which: str = 'latency', bins: int = 16, width: int = 50) -> str:
+        """
+        Returns the histogram of the latencies (which='latency') or durations (which='duration') as text.
+        """
+        hist = histogram(self.latencies if which == 'latency' else self.durations, bins)
+        peak = max((n for _, _, n in hist), default=1)
+        lines = []
+        for lo, hi, n in hist:
+            lines.append(f'  {lo:>8}..{hi - 1:<8}{n:>8} {"#" * (n * width // peak)}')
+        return '\n'.join(lines)
+
+    def __str__(self) -> str:
+        def fmt(name: str, stats: Tuple) -> str:
+            line = f'{name}: min {stats[0]}, max {stats[1]}, mean {stats[2]:.1f}, median {stats[3]}, p99 {stats[4]}'
+            if self.tick_hz is not None:
+                line += f' ticks (max {self.us(stats[1]):.2f}us, p99 {self.us(stats[4]):.2f}us)'
+            return line
+
+        lines = [f'{self.count} interrupt samples' + (f' ({self.lost} lost)' if self.lost > 0 else ''),
+                 fmt('latency', self.latency_stats()), self.histogram_str('latency'),
+                 fmt('duration', self.duration_stats()), self.histogram_str('duration')]
+        return '\n'.join(lines)
+
+
+# -------------------------------------------------------------------------------------------------
+class IrqLatency(object):
+    """
+    Host side of DOTT's interrupt latency instrumentation (DOTT_IRQ_LATENCY in testhelpers.h). Handlers instrumented
+    with DOTT_IRQ_LATENCY_ENTER/EXIT record their entry latency and duration in the DOTT_irq_latency ring buffer.
+    The samples are either read with a single bulk read while the target is halted (start/stop) or streamed while
+    the target keeps running (collect, using live access):
+        irq = IrqLatency(dt, tick_hz=48e6)
+        dt.cont()
+        report = irq.collect(live_access, num_samples=5000)
+        log.info(str(report))
+    """
+    # interval (seconds) in which collect polls the ring buffer
+    POLL_INTERVAL_SEC = 0.01
+
+    def __init__(self, target: 'Target', tick_hz: float = None, period: int = None) -> None:
+        """
+        Args:
+            target: Target with the instrumented firmware.
+            tick_hz: Frequency of the counter used by the handlers (used to report microseconds).
+            period: Period (ticks) of the counter; used to correct durations of handlers during which the counter
+                    wrapped around.
+        """
+        self._target: 'Target' = target
+        if not target.symbols.exists('DOTT_irq_latency'):
+            raise DottException('DOTT_irq_latency not found. Build the firmware with DOTT_IRQ_LATENCY.')
+        self._addr: int = target.symbols.addr('DOTT_irq_latency')
+        self._tick_hz: float = tick_hz
+        self._period: int = period
+        self._num_entries: int = None
+        self._start_head: int = None
+
+    def _fmt(self) -> str:
+        return '<' if self._target.byte_order == 'little' else '>'
+
+    def _sample(self, lat: int, dur: int) -> Tuple[int, int]:
+        if self._period is not None and dur & 0x80000000:
+            dur = (dur + self._period) & 0xffffffff
+        return lat, dur
+
+    def _read_samples(self, read, first: int, count: int) -> List[Tuple[int, int]]:
+        # reads count samples starting at (absolute) index first using read(addr, num_bytes) with at most two bulk
+        # reads (the range may wrap around the end of the ring buffer)
+        samples = []
+        while count > 0:
+            idx = first % self._num_entries
+            num = min(count, self._num_entries - idx)
+            data = read(self._addr + _HEADER_SIZE + idx * _SAMPLE_SIZE, num * _SAMPLE_SIZE)
+            samples += [self._sample(lat, dur) for lat, dur in struct.iter_unpack(self._fmt() + 'II', data)]
+            first += num
+            count -= num
+        return samples
+
+    def start(self) -> None:
+        """
+        Starts a measurement at the current position of the ring buffer. The target has to be halted.
+        """
+        head, self._num_entries = struct.unpack(self._fmt() + 'II', self._target.mem.read(self._addr, _HEADER_SIZE))
+        if self._num_entries == 0:
+            raise DottException('DOTT_irq_latency is not initialized.')
+        self._start_head = head
+
+    def stop(self) -> IrqLatencyReport:
+        """
+        Reads the samples recorded since start (with a single bulk read) and returns their analysis. The target has to
+        be halted.
+        """
+        if self._start_head is None:
+            raise DottException('The interrupt latency measurement has not been started.')
+        head = struct.unpack(self._fmt() + 'I', self._target.mem.read(self._addr, 4))[0]
+        count = (head - self._start_head) & 0xffffffff
+        self._start_head = None
+        lost = max(0, count - self._num_entries)
+        samples = self._read_samples(self._target.mem.read, head - (count - lost), count - lost)
+        return IrqLatencyReport(samples, lost, self._tick_hz)
+
+    def collect(self, live, num_samples: int, timeout: float = 10.0) -> IrqLatencyReport:
+        """
+        Streams samples from the ring buffer while the target is running until num_samples samples were collected
+        (or the timeout expired). Samples which the firmware overwrote before they could be read are counted as lost.
+
+        Args:
+            live: TargetDirect instance (e.g., live_access fixture).
+            num_samples: Number of samples to be collected.
+            timeout: Maximum duration of the collection (seconds).
+        """
+        samples: List[Tuple[int, int]] = []
+        lost = 0
+        deadline = time.monotonic() + timeout
+        with live.session():
+            head, self._num_entries = struct.unpack(self._fmt() + 'II', live.mem_read(self._addr, _HEADER_SIZE))
+            if self._num_entries == 0:
+                raise DottException('DOTT_irq_latency is not initialized.')
+            while len(samples) < num_samples and time.monotonic() < deadline:
+                time.sleep(IrqLatency.POLL_INTERVAL_SEC)
+                new_head = live.mem_read_32(self._addr)
+                count = (new_head - head) & 0xffffffff
+                if count > self._num_entries:
+                    lost += count - self._num_entries
+                    head = (new_head - self._num_entries) & 0xffffffff
+                    count = self._num_entries
+                chunk = self._read_samples(live.mem_read, head, count)
+                # samples overwritten while they were read are dropped (the firmware wrote at most after_head - head
+                # samples in the meantime)
+                overwritten = min(count, ((live.mem_read_32(self._addr) - head) & 0xffffffff) - self._num_entries)
+                if overwritten > 0:
+                    lost += overwritten
+                    chunk = chunk[overwritten:]
+                samples += chunk
+                head = new_head
+        return IrqLatencyReport(samples[:num_samples], lost, self._tick_hz)
@@ -0,0 +1,164 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Generator of the DOTT manifest of a firmware image. The manifest is a JSON file placed next to the ELF (app.axf ->
+# app.dott.json) which holds everything DOTT otherwise discovers at runtime: the symbol index (including the
+# DOTT_LABEL_xxx code labels), the layouts and sizes of selected types, the scratchpad region of the test hook and the
+# build-id (or hash) of the ELF it belongs to. Target.load uses the manifest if it matches the ELF. The manifest is
+# generated by the build (see dott_gcc.mk and dott_armclang.mk). Type layouts are determined by running GDB in batch
+# mode (the same dott-type-layout command as used at runtime); they are only included if types are requested.
+#
+# Usage: python -m dottmi.manifest <elf> [-o <manifest>] [--types <type>,<type>,...] [--gdb <gdb executable>]
+
+import argparse
+import binascii
+import json
+import os
+import subprocess
+import sys
+from pathlib import Path
+from typing import Dict, List
+
+from dottmi.dottexceptions import DottException
+from dottmi.gdb_shared import DottResp
+from dottmi.elf_file import ElfFile
+from dottmi.type_cache import TypeCache
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class DottManifest(object):
+    """
+    Build-time description of a firmware image (see module description).
+    """
+    # version of the manifest format; manifests with a different version are ignored
+    FILE_VERSION = 1
+
+    # symbol of the scratchpad memory placed in a dedicated linker section (see DOTT_TEST_HOOK_MEM_SECTION)
+    _SCRATCH_SYMBOL = 'DOTT_test_hook_mem'
+
+    def __init__(self, key: str, symbols: Dict[str, Dict], sizes: Dict[str, int] = None,
+                 layouts: Dict[str, Dict] = None, scratch: Dict[str, int] = None) -> None:
+        self.key: str = key
+        self.symbols: Dict[str, Dict] = symbols
+        self.sizes: Dict[str, int] = sizes if sizes is not None else {}
+        self.layouts: Dict[str, Dict] = layouts if layouts is not None else {}
+        self.scratch: Dict[str, int] = scratch
+
+    @staticmethod
+    def file_name(elf_file: str) -> str:
+        """
+        Returns the name of the manifest belonging to the given ELF file.
+        """
+        return Path(elf_file).with_suffix('.dott.json').as_posix()
+
+    @staticmethod
+    def load(elf_file: str) -> 'DottManifest':
+        """
+        Returns the manifest of the given ELF file or None if there is no manifest or if the manifest does not belong
+        to the ELF (e.g., if the ELF was rebuilt without regenerating the manifest).
+        """
+        file_name = DottManifest.file_name(elf_file)
+        if not os.path.exists(file_name):
+            return None
+        try:
+            with open(file_name, 'r') as f:
+                content = json.load(f)
+            if content.get('version') != DottManifest.FILE_VERSION:
+                return None
+            if content['key'] != TypeCache.elf_key(elf_file):
+                log.warn(f'Ignoring outdated DOTT manifest {file_name} (the ELF has been rebuilt).')
+                return None
+            return DottManifest(content['key'], content['symbols'], content['types']['sizes'],
+                                content['types']['layouts'], content.get('scratch'))
+        except (OSError, ValueError, KeyError) as ex:
+            log.warn(f'Ignoring unreadable DOTT manifest {file_name} ({ex}).')
+            return None
+
+    def save(self, file_name: str) -> None:
+        with open(file_name, 'w') as f:
+            json.dump({'version': DottManifest.FILE_VERSION, 'key': self.key, 'symbols': self.symbols,
+                       'types': {'sizes': self.sizes, 'layouts': self.layouts}, 'scratch': self.scratch}, f)
+
+    @staticmethod
+    def _gdb_type_layouts(elf_file: str, types: List[str], gdb: str) -> Dict[str, Dict]:
+        # runs GDB in batch mode with DOTT's GDB commands and queries the layout of each type
+        dottmi_dir = Path(__file__).resolve().parent
+        cmds = [f'python import sys; sys.path.insert(0, "{dottmi_dir.parent.as_posix()}")',
+                f'source {dottmi_dir.joinpath("gdb_cmds.py").as_posix()}',
+                f'file {Path(elf_file).as_posix()}']
+        cmds += [f'dott-type-layout {i} {t}' for i, t in enumerate(types)]
+        args = [gdb, '-batch', '-nx']
+        for cmd in cmds:
+            args += ['-ex', cmd]
+        res = subprocess.run(args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+
+        layouts = {}
+        for line in res.stdout.splitlines():
+            if not line.startswith(DottResp.PREFIX):
+                continue
+            status, payload = DottResp.get_fields(line)
+            payload = binascii.unhexlify(payload).decode()
+            type_name = types[DottResp.get_id(line)]
+            if status != 'OK':
+                raise DottException(f'Unable to determine layout of type {type_name} ({payload}).')
+            layouts[type_name] = json.loads(payload)
+        missing = [t for t in types if t not in layouts]
+        if len(missing) > 0:
+            raise DottException(f'GDB ({gdb}) did not report the layouts of {", ".join(missing)}:\n{res.stdout}')
+        return layouts
+
+    @staticmethod
+    def generate(elf_file: str, types: List[str] = None, gdb: str = 'arm-none-eabi-gdb') -> 'DottManifest':
+        """
+        Generates the manifest of the given ELF file. Layouts are only determined (using GDB) for the given types.
+        """
+        symbols = ElfFile.open(elf_file).symbols
+        layouts = {}
+        if types is not None and len(types) > 0:
+            layouts = DottManifest._gdb_type_layouts(elf_file, types, gdb)
+        scratch = None
+        if DottManifest._SCRATCH_SYMBOL in symbols:
+            sym = symbols[DottManifest._SCRATCH_SYMBOL]
+            scratch = {'addr': sym['addr'], 'size': sym['size']}
+        return DottManifest(TypeCache.elf_key(elf_file), symbols, {t: lt['size'] for t, lt in layouts.items()},
+                            layouts, scratch)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Generates the DOTT manifest of a firmware image.')
+    parser.add_argument('elf', help='ELF file (e.g., app.axf)')
+    parser.add_argument('-o', '--output', default=None, help='manifest file (default: next to the ELF)')
+    parser.add_argument('--types', default='', help='comma-separated types whose layouts are included')
+    parser.add_argument('--gdb', default='arm-none-eabi-gdb', help='GDB used to determine type layouts')
+    args = parser.parse_args()
+
+    types = [t.strip() for t in args.types.split(',') if t.strip() != '']
+    try:
+        manifest = DottManifest.generate(args.elf, types, args.gdb)
+    except (OSError, DottException) as ex:
+        sys.exit(f'Unable to generate DOTT manifest for {args.elf}: {ex}')
+    output = args.output if args.output is not None else DottManifest.file_name(args.elf)
+    manifest.save(output)
+    print(f'DOTT manifest {output}: {len(manifest.symbols)} symbols, {len(manifest.layouts)} type layouts.')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,89 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# pytest plugin which reorders the collected tests such that tests with the same target requirements (load fixture,
+# reset fixture and on-target memory model) run back-to-back. Transitions between these requirements are expensive
+# (e.g., an SRAM download after tests which used the FLASH image or a PRESTACK test in between TESTHOOK tests which
+# defeats the warm reset); consecutive tests with the same requirements benefit from DOTT's state reuse (skipped
+# downloads of identical images, sram_fast_reload, warm_reset_ram). Groups are ordered by their first test and the
+# tests of a group keep their relative order. With 'module' (default), tests are only reordered within their module
+# such that module and class scoped fixtures are not set up repeatedly; with 'session', tests are reordered across
+# modules (module scoped fixtures may then be set up more than once).
+#
+# Usage: pytest -p dottmi.ordering [--dott-order module|session|none] [pytest args]
+
+from typing import Dict, List, Tuple
+
+from dottmi.utils import log
+
+
+def _fixture_impl(item, name: str) -> str:
+    # name of the fixture function behind the given fixture name (conftest files typically alias the DOTT fixtures,
+    # e.g., target_load = target_load_flash)
+    defs = getattr(item, '_fixtureinfo', None)
+    defs = defs.name2fixturedefs.get(name) if defs is not None else None
+    return defs[-1].func.__name__ if defs else name
+
+
+def requirements(item) -> Tuple[str, str, str]:
+    """
+    Returns the target requirements (load fixture, reset fixture, memory model) of the given test item.
+    """
+    names = getattr(item, 'fixturenames', [])
+    load = next((_fixture_impl(item, n) for n in names if n.startswith('target_load')), '')
+    reset = next((_fixture_impl(item, n) for n in names if n.startswith('target_reset')), '')
+    marker = item.get_closest_marker('dott_mem')
+    model = str(marker.kwargs.get('model', '')) if marker is not None else ''
+    return load, reset, model
+
+
+def _transitions(keys: List[Tuple]) -> int:
+    return sum(1 for prev, cur in zip(keys, keys[1:]) if prev != cur)
+
+
+def order(items: List, scope: str = 'module') -> List:
+    """
+    Returns the items ordered such that items with the same requirements are consecutive (see module description).
+    """
+    first: Dict[Tuple, int] = {}  # (scope key, requirements) -> index of the first item of the group
+    sort_keys = []
+    for idx, item in enumerate(items):
+        scope_key = str(getattr(item, 'fspath', '')) if scope == 'module' else ''
+        group = first.setdefault((scope_key, requirements(item)), idx)
+        # note: modules keep their position (first item of the module); groups are ordered by their first item
+        module_pos = first.setdefault((scope_key, None), idx)
+        sort_keys.append((module_pos, group, idx))
+    return [item for _, item in sorted(zip(sort_keys, items), key=lambda k: k[0])]
+
+
+def pytest_addoption(parser) -> None:
+    group = parser.getgroup('dott-order', 'DOTT test ordering')
+    group.addoption('--dott-order', default='module', choices=('none', 'module', 'session'),
+                    help='group tests with the same target requirements within modules or across the session')
+
+
+def pytest_collection_modifyitems(session, config, items) -> None:
+    scope = config.getoption('dott_order')
+    if scope == 'none' or len(items) < 2:
+        return
+    before = _transitions([requirements(i) for i in items])
+    items[:] = order(items, scope)
+    after = _transitions([requirements(i) for i in items])
+    log.info(f'Test ordering ({scope}): {before} -> {after} transitions between target requirements.')
@@ -0,0 +1,242 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# History of performance results in a local SQLite database. Each test session with perf_history_file configured
+# adds a run (keyed by the firmware build-id, the DOTT version, the board's probe serial number and the git commit)
+# with the samples of its benchmarks (target_bench fixture) and budget measurements (dott_budget marker). A run is
+# compared against a baseline run (default: the previous run on the same board) metric by metric. Metrics with
+# several samples on both sides are compared with a two-sided Mann-Whitney U test; a metric regressed if its median
+# increased by more than the tolerance and the increase is significant (p < alpha). Single value metrics (e.g., the
+# stack usage of a test) can not be tested for significance; they regressed if they exceed the tolerance.
+#
+# Usage: python -m dottmi.perf_history <db file> [--list] [--run <id>] [--baseline <id>] [--board <serial>]
+#                                       [--alpha <p>] [--tolerance <percent>]
+#   Exits with status 1 if a metric regressed compared to the baseline (e.g., to fail the CI job).
+
+import argparse
+import json
+import math
+import sqlite3
+import sys
+import time
+from typing import Dict, List, NamedTuple, Tuple
+
+_SCHEMA = """
+CREATE TABLE IF NOT EXISTS runs (id INTEGER PRIMARY KEY AUTOINCREMENT, time REAL NOT NULL, build_id TEXT,
+                                 dott_version TEXT, board TEXT, git_commit TEXT);
+CREATE TABLE IF NOT EXISTS results (run_id INTEGER NOT NULL REFERENCES runs(id), key TEXT NOT NULL,
+                                    metric TEXT NOT NULL, samples TEXT NOT NULL, PRIMARY KEY (run_id, key, metric));
+CREATE INDEX IF NOT EXISTS runs_board ON runs (board, id);
+"""
+
+
+# -------------------------------------------------------------------------------------------------
+def mann_whitney_u(a: List[float], b: List[float]) -> float:
+    """
+    Returns the two-sided p-value of the Mann-Whitney U test of the given samples (normal approximation with tie
+    and continuity correction; adequate for about ten or more samples per side).
+    """
+    n1, n2 = len(a), len(b)
+    values = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+    n = n1 + n2
+    rank_sum_a = 0.0
+    ties = 0.0
+    i = 0
+    while i < n:
+        j = i
+        while j + 1 < n and values[j + 1][0] == values[i][0]:
+            j += 1
+        rank = (i + j) / 2 + 1  # average rank of the tied values
+        rank_sum_a += rank * sum(1 for k in range(i, j + 1) if values[k][1] == 0)
+        t = j - i + 1
+        ties += t ** 3 - t
+        i = j + 1
+    u = rank_sum_a - n1 * (n1 + 1) / 2
+    mu = n1 * n2 / 2
+    sigma = math.sqrt(n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)))) if n > 1 else 0.0
+    if sigma == 0:
+        return 1.0
+    z = (abs(u - mu) - 0.5) / sigma
+    return min(1.0, math.erfc(max(0.0, z) / math.sqrt(2)))
+
+
+def _median(values: List[float]) -> float:
+    s = sorted(values)
+    mid = len(s) // 2
+    return float(s[mid]) if len(s) % 2 == 1 else (s[mid - 1] + s[mid]) / 2
+
+
+class MetricDiff(NamedTuple):
+    key: str
+    metric: str
+    baseline: float  # median of the baseline samples
+    current: float  # median of the current samples
+    change: float  # relative change of the median (0.1: 10% larger)
+    p_value: float  # None if the significance could not be tested (single samples)
+    regression: bool
+
+
+# -------------------------------------------------------------------------------------------------
+class PerfHistory(object):
+    """
+    SQLite store of the performance results of test sessions (see module description).
+    """
+    # minimum number of samples per side for the significance test
+    MIN_SAMPLES = 5
+
+    def __init__(self, db_file: str) -> None:
+        self._db: sqlite3.Connection = sqlite3.connect(db_file)
+        self._db.executescript(_SCHEMA)
+
+    def close(self) -> None:
+        self._db.close()
+
+    @staticmethod
+    def dott_version() -> str:
+        # version of the installed DOTT package (None if DOTT is used from a source checkout)
+        try:
+            import pkg_resources
+            return pkg_resources.get_distribution('ams-dott').version
+        except Exception:
+            return None
+
+    def add_run(self, build_id: str, dott_version: str, board: str, git_commit: str,
+                results: Dict[Tuple[str, str], List[float]]) -> int:
+        """
+        Adds a run with the given results ((key, metric) -> samples) and returns its id.
+        """
+        with self._db:
+            cur = self._db.execute('INSERT INTO runs (time, build_id, dott_version, board, git_commit) '
+                                   'VALUES (?, ?, ?, ?, ?)', (time.time(), build_id, dott_version, board, git_commit))
+            run_id = cur.lastrowid
+            self._db.executemany('INSERT OR REPLACE INTO results (run_id, key, metric, samples) VALUES (?, ?, ?, ?)',
+                                 [(run_id, key, metric, json.dumps(samples))
+                                  for (key, metric), samples in results.items()])
+        return run_id
+
+    def runs(self, board: str = None, limit: int = 20) -> List[Dict]:
+        """
+        Returns the latest runs (newest first), optionally restricted to the given board.
+        """
+        query = 'SELECT id, time, build_id, dott_version, board, git_commit FROM runs'
+        args: Tuple = ()
+        if board is not None:
+            query += ' WHERE board = ?'
+            args = (board,)
+        rows = self._db.execute(query + ' ORDER BY id DESC LIMIT ?', args + (limit,)).fetchall()
+        return [dict(zip(('id', 'time', 'build_id', 'dott_version', 'board', 'git_commit'), r)) for r in rows]
+
+    def previous_run(self, run_id: int) -> int:
+        """
+        Returns the id of the run preceding the given one on the same board (None if there is none).
+        """
+        row = self._db.execute('SELECT id FROM runs WHERE id < ? AND board IS (SELECT board FROM runs WHERE id = ?) '
+                               'ORDER BY id DESC LIMIT 1', (run_id, run_id)).fetchone()
+        return row[0] if row is not None else None
+
+    def results(self, run_id: int) -> Dict[Tuple[str, str], List[float]]:
+        rows = self._db.execute('SELECT key, metric, samples FROM results WHERE run_id = ?', (run_id,)).fetchall()
+        return {(key, metric): json.loads(samples) for key, metric, samples in rows}
+
+    def compare(self, run_id: int, baseline_id: int = None, alpha: float = 0.05,
+                tolerance: float = 0.05) -> List[MetricDiff]:
+        """
+        Compares the metrics of a run present in both runs against the baseline run (default: previous run on the
+        same board).
+
+        Args:
+            run_id: Run to be compared.
+            baseline_id: Baseline run.
+            alpha: Significance level of the Mann-Whitney U test.
+            tolerance: Relative increase of the median which is accepted (0.05: 5%).
+        """
+        baseline_id = baseline_id if baseline_id is not None else self.previous_run(run_id)
+        if baseline_id is None:
+            return []
+        base = self.results(baseline_id)
+        diffs = []
+        for (key, metric), samples in sorted(self.results(run_id).items()):
+            base_samples = base.get((key, metric))
+            if base_samples is None or len(samples) == 0 or len(base_samples) == 0:
+                continue
+            cur_med, base_med = _median(samples), _median(base_samples)
+            change = (cur_med - base_med) / base_med if base_med != 0 else (0.0 if cur_med == 0 else math.inf)
+            p_value = None
+            if len(samples) >= PerfHistory.MIN_SAMPLES and len(base_samples) >= PerfHistory.MIN_SAMPLES:
+                p_value = mann_whitney_u(samples, base_samples)
+            regression = change > tolerance and (p_value is None or p_value < alpha)
+            diffs.append(MetricDiff(key, metric, base_med, cur_med, change, p_value, regression))
+        return diffs
+
+    @staticmethod
+    def compare_str(diffs: List[MetricDiff]) -> str:
+        lines = [f'  {"key":<60}{"metric":<10}{"baseline":>12}{"current":>12}{"change":>9}{"p":>8}']
+        for d in diffs:
+            p = f'{d.p_value:.3f}' if d.p_value is not None else '-'
+            lines.append(f'  {d.key[-60:]:<60}{d.metric:<10}{d.baseline:>12.1f}{d.current:>12.1f}'
+                         f'{d.change * 100:>8.1f}%{p:>8}{"  REGRESSION" if d.regression else ""}')
+        return '\n'.join(lines)
+
+
+# -------------------------------------------------------------------------------------------------
+def main() -> int:
+    parser = argparse.ArgumentParser(prog='python -m dottmi.perf_history',
+                                     description='Compares DOTT performance results against a baseline run.')
+    parser.add_argument('db_file', help='SQLite performance history (perf_history_file).')
+    parser.add_argument('--list', action='store_true', help='List the latest runs.')
+    parser.add_argument('--run', type=int, help='Run to be compared (default: latest run).')
+    parser.add_argument('--baseline', type=int, help='Baseline run (default: previous run on the same board).')
+    parser.add_argument('--board', help='Restrict to runs of the given board (probe serial number).')
+    parser.add_argument('--alpha', type=float, default=0.05, help='Significance level (default: 0.05).')
+    parser.add_argument('--tolerance', type=float, default=5.0, help='Accepted increase in percent (default: 5).')
+    args = parser.parse_args()
+
+    history = PerfHistory(args.db_file)
+    try:
+        if args.list:
+            for r in history.runs(args.board):
+                print(f'{r["id"]:>6}  {time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(r["time"]))}  '
+                      f'board {r["board"]}  build {r["build_id"]}  dott {r["dott_version"]}  commit {r["git_commit"]}')
+            return 0
+        run_id = args.run
+        if run_id is None:
+            runs = history.runs(args.board, limit=1)
+            if len(runs) == 0:
+                print('No runs found.')
+                return 0
+            run_id = runs[0]['id']
+        baseline_id = args.baseline if args.baseline is not None else history.previous_run(run_id)
+        if baseline_id is None:
+            print(f'No baseline run found for run {run_id}.')
+            return 0
+        diffs = history.compare(run_id, baseline_id, args.alpha, args.tolerance / 100.0)
+        print(f'Run {run_id} compared to baseline run {baseline_id}:')
+        print(PerfHistory.compare_str(diffs))
+        regressions = [d for d in diffs if d.regression]
+        if len(regressions) > 0:
+            print(f'{len(regressions)} of {len(diffs)} metrics regressed.')
+            return 1
+        return 0
+    finally:
+        history.close()
+
+
+if __name__ == '__main__':
+    sys.exit(main())
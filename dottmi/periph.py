@@ -0,0 +1,680 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import collections
+import re
+import threading
+import time
+import xml.etree.ElementTree as ElementTree
+from typing import Deque, Dict, List, NamedTuple, Tuple
+
+from dottmi.dottexceptions import DottException
+
+
+def _svd_int(text: str) -> int:
+    # SVD numbers are decimal, hexadecimal (0x) or binary (#, 0b)
+    text = text.strip().lower()
+    if text.startswith('#'):
+        return int(text[1:].replace('x', '0'), 2)
+    return int(text, 0)
+
+
+def _child(elem, tag: str, default: str = None) -> str:
+    node = elem.find(tag)
+    return node.text.strip() if node is not None and node.text is not None else default
+
+
+# -------------------------------------------------------------------------------------------------
+class SvdField(object):
+    def __init__(self, name: str, lsb: int, width: int, access: str, read_action: str) -> None:
+        self.name: str = name
+        self.lsb: int = lsb
+        self.width: int = width
+        self.access: str = access
+        self.read_action: str = read_action
+
+    @property
+    def mask(self) -> int:
+        return ((1 << self.width) - 1) << self.lsb
+
+
+# -------------------------------------------------------------------------------------------------
+class SvdRegister(object):
+    def __init__(self, name: str, offset: int, size: int, access: str, reset_value: int, read_action: str) -> None:
+        self.name: str = name
+        self.offset: int = offset
+        self.size: int = size  # in bits
+        self.access: str = access
+        self.reset_value: int = reset_value
+        self.read_action: str = read_action
+        self.fields: Dict[str, SvdField] = {}
+
+    @property
+    def num_bytes(self) -> int:
+        return self.size // 8
+
+    @property
+    def readable(self) -> bool:
+        return self.access != 'write-only'
+
+    @property
+    def side_effect_free(self) -> bool:
+        """
+        True if reading the register does not alter the peripheral's state (no readAction on register or fields).
+        """
+        return self.read_action is None and all(f.read_action is None for f in self.fields.values())
+
+
+# -------------------------------------------------------------------------------------------------
+class SvdPeripheral(object):
+    def __init__(self, name: str, base: int) -> None:
+        self.name: str = name
+        self.base: int = base
+        self.registers: Dict[str, SvdRegister] = {}
+
+    def block_ranges(self) -> List[Tuple[int, int, List[SvdRegister]]]:
+        """
+        Returns the contiguous address ranges (offset, number of bytes, registers) covering all registers which can be
+        read without side effects. Write-only registers and registers with a readAction are not covered.
+        """
+        ranges: List[Tuple[int, int, List[SvdRegister]]] = []
+        for reg in sorted(self.registers.values(), key=lambda r: r.offset):
+            if not reg.readable or not reg.side_effect_free:
+                continue
+            if len(ranges) > 0 and ranges[-1][0] + ranges[-1][1] == reg.offset:
+                start, num_bytes, regs = ranges[-1]
+                ranges[-1] = (start, num_bytes + reg.num_bytes, regs + [reg])
+            elif len(ranges) > 0 and reg.offset < ranges[-1][0] + ranges[-1][1]:
+                ranges[-1][2].append(reg)  # alternate register at the same address
+            else:
+                ranges.append((reg.offset, reg.num_bytes, [reg]))
+        return ranges
+
+
+# -------------------------------------------------------------------------------------------------
+class SvdDevice(object):
+    """
+    Peripherals, registers and fields of a device as described by its CMSIS-SVD file. Supported are derived
+    peripherals (derivedFrom), register clusters (flattened to <cluster>_<register>), register arrays (dim) and the
+    access and readAction attributes of registers and fields.
+    """
+    def __init__(self, svd_file: str) -> None:
+        self._svd_file: str = svd_file
+        self.peripherals: Dict[str, SvdPeripheral] = {}
+        root = ElementTree.parse(svd_file).getroot()
+        defaults = self._defaults(root, {'size': 32, 'access': 'read-write', 'resetValue': 0})
+
+        elems = {_child(p, 'name'): p for p in root.iter('peripheral')}
+        for name, elem in elems.items():
+            periph = SvdPeripheral(name, _svd_int(_child(elem, 'baseAddress', '0')))
+            src = elem
+            if elem.get('derivedFrom') is not None and elem.find('registers') is None:
+                src = elems.get(elem.get('derivedFrom'))
+                if src is None:
+                    raise DottException(f'{svd_file}: {name} is derived from unknown peripheral '
+                                        f'{elem.get("derivedFrom")}.')
+            regs = src.find('registers')
+            if regs is not None:
+                self._add_registers(periph, regs, 0, '', self._defaults(src, defaults))
+            self.peripherals[name] = periph
+
+    @staticmethod
+    def _defaults(elem, defaults: Dict) -> Dict:
+        # register properties (size, access, resetValue) are inherited from the enclosing elements
+        res = dict(defaults)
+        for key, conv in (('size', _svd_int), ('access', str), ('resetValue', _svd_int)):
+            val = _child(elem, key)
+            if val is not None:
+                res[key] = conv(val)
+        return res
+
+    @staticmethod
+    def _dim(elem, name: str, offset: int) -> List[Tuple[str, int]]:
+        # expands register arrays and lists (dim, dimIncrement, dimIndex) into (name, offset) pairs
+        dim = _child(elem, 'dim')
+        if dim is None:
+            return [(name, offset)]
+        increment = _svd_int(_child(elem, 'dimIncrement', '0'))
+        indices = _child(elem, 'dimIndex')
+        if indices is None:
+            indices = [str(i) for i in range(_svd_int(dim))]
+        elif re.match(r'^\d+-\d+$', indices):
+            first, last = indices.split('-')
+            indices = [str(i) for i in range(int(first), int(last) + 1)]
+        else:
+            indices = [i.strip() for i in indices.split(',')]
+        return [(name.replace('[%s]', idx).replace('%s', idx), offset + i * increment)
+                for i, idx in enumerate(indices)]
+
+    def _add_registers(self, periph: SvdPeripheral, parent, base: int, prefix: str, defaults: Dict) -> None:
+        for elem in parent:
+            if elem.tag not in ('cluster', 'register'):
+                continue
+            offset = base + _svd_int(_child(elem, 'addressOffset', '0'))
+            if elem.tag == 'cluster':
+                cluster_defaults = self._defaults(elem, defaults)
+                for name, cluster_offset in self._dim(elem, _child(elem, 'name'), offset):
+                    self._add_registers(periph, elem, cluster_offset, f'{prefix}{name}_', cluster_defaults)
+            else:
+                reg_defaults = self._defaults(elem, defaults)
+                fields = [self._field(field, reg_defaults['access']) for field in elem.iter('field')]
+                for name, reg_offset in self._dim(elem, _child(elem, 'name'), offset):
+                    reg = SvdRegister(prefix + name, reg_offset, reg_defaults['size'], reg_defaults['access'],
+                                      reg_defaults['resetValue'], _child(elem, 'readAction'))
+                    reg.fields = {f.name: f for f in fields}
+                    periph.registers[reg.name] = reg
+
+    @staticmethod
+    def _field(elem, access: str) -> SvdField:
+        if _child(elem, 'bitRange') is not None:
+            msb, lsb = (int(v) for v in re.findall(r'\d+', _child(elem, 'bitRange')))
+        elif _child(elem, 'lsb') is not None:
+            lsb, msb = _svd_int(_child(elem, 'lsb')), _svd_int(_child(elem, 'msb'))
+        else:
+            lsb = _svd_int(_child(elem, 'bitOffset', '0'))
+            msb = lsb + _svd_int(_child(elem, 'bitWidth', '1')) - 1
+        return SvdField(_child(elem, 'name'), lsb, msb - lsb + 1, _child(elem, 'access', access),
+                        _child(elem, 'readAction'))
+
+
+# -------------------------------------------------------------------------------------------------
+class PeripheralChange(NamedTuple):
+    periph: str
+    reg: str
+    field: str  # None for bits which are not part of any field
+    old: int
+    new: int
+
+    def __str__(self) -> str:
+        name = f'{self.periph}.{self.reg}' + (f'.{self.field}' if self.field is not None else '')
+        return f'{name}: 0x{self.old:x} -> 0x{self.new:x}'
+
+
+def _field_changes(periph: str, reg: SvdRegister, old_val: int, new_val: int) -> List[PeripheralChange]:
+    # field-level changes of a register value (bits which are not part of any field are reported together)
+    changes: List[PeripheralChange] = []
+    unassigned = old_val ^ new_val
+    for field in reg.fields.values():
+        if (old_val ^ new_val) & field.mask:
+            changes.append(PeripheralChange(periph, reg.name, field.name, (old_val & field.mask) >> field.lsb,
+                                            (new_val & field.mask) >> field.lsb))
+        unassigned &= ~field.mask
+    if unassigned:
+        changes.append(PeripheralChange(periph, reg.name, None, old_val & unassigned, new_val & unassigned))
+    return changes
+
+
+# -------------------------------------------------------------------------------------------------
+class PeripheralSnapshot(object):
+    """
+    Register values of a set of peripherals at one point in time (see Peripherals.snapshot).
+    """
+    def __init__(self, device: SvdDevice, values: Dict[str, Dict[str, int]]) -> None:
+        self._device: SvdDevice = device
+        self._values: Dict[str, Dict[str, int]] = values
+
+    @property
+    def values(self) -> Dict[str, Dict[str, int]]:
+        return self._values
+
+    def diff(self, other: 'PeripheralSnapshot') -> List[PeripheralChange]:
+        """
+        Returns the field-level changes from this snapshot to the given (later) snapshot. Only peripherals and
+        registers contained in both snapshots are compared.
+        """
+        changes: List[PeripheralChange] = []
+        for periph, regs in self._values.items():
+            other_regs = other.values.get(periph, {})
+            for reg_name, old_val in regs.items():
+                new_val = other_regs.get(reg_name, old_val)
+                if new_val == old_val:
+                    continue
+                reg = self._device.peripherals[periph].registers[reg_name]
+                changes += _field_changes(periph, reg, old_val, new_val)
+        return changes
+
+    def diff_str(self, other: 'PeripheralSnapshot') -> str:
+        return '\n'.join(str(c) for c in self.diff(other))
+
+
+# -------------------------------------------------------------------------------------------------
+class PeripheralRegister(object):
+    """
+    Register of a peripheral bound to a target. The value and the fields (as attributes) are read from the
+    peripheral block cached for the current halt (see Peripheral). Assigning a field performs a read-modify-write of
+    the register (write-only registers are based on their reset value).
+    """
+    def __init__(self, periph: 'Peripheral', reg: SvdRegister) -> None:
+        object.__setattr__(self, '_periph', periph)
+        object.__setattr__(self, '_reg', reg)
+
+    @property
+    def addr(self) -> int:
+        return self._periph.svd.base + self._reg.offset
+
+    @property
+    def value(self) -> int:
+        return self._periph.reg_value(self._reg)
+
+    @value.setter
+    def value(self, val: int) -> None:
+        self._periph.reg_write(self._reg, val)
+
+    def read(self, side_effects: bool = False) -> int:
+        """
+        Reads the register from the target (bypassing the cache). Registers whose read alters the peripheral's state
+        (readAction in the SVD, e.g., data registers of FIFOs) are only read if side_effects is True.
+        """
+        return self._periph.reg_read(self._reg, side_effects)
+
+    def fields(self) -> Dict[str, int]:
+        """
+        Returns the values of all fields of the register.
+        """
+        val = self.value
+        return {name: (val & f.mask) >> f.lsb for name, f in self._reg.fields.items()}
+
+    def __getattr__(self, name: str) -> int:
+        if name.startswith('_'):
+            raise AttributeError(name)
+        field = self._reg.fields.get(name)
+        if field is None:
+            raise AttributeError(f'{self._periph.svd.name}.{self._reg.name} has no field {name}.')
+        return (self.value & field.mask) >> field.lsb
+
+    def __setattr__(self, name: str, val: int) -> None:
+        field = self._reg.fields.get(name)
+        if field is None:
+            object.__setattr__(self, name, val)
+            return
+        if field.access == 'read-only':
+            raise DottException(f'{self._periph.svd.name}.{self._reg.name}.{name} is read-only.')
+        base = self.value if self._reg.readable and self._reg.side_effect_free else self._reg.reset_value
+        self.value = (base & ~field.mask) | ((val << field.lsb) & field.mask)
+
+
+# -------------------------------------------------------------------------------------------------
+class Peripheral(object):
+    """
+    Peripheral bound to a target. All registers which can be read without side effects are read with one block
+    transfer per contiguous address range and are cached until the target is resumed. Writes go to the target
+    immediately and update the cache. Note: Memory accesses which bypass the peripheral model (e.g., eval of CMSIS
+    structs or target.mem) are not reflected in the cache until the next halt (see invalidate).
+    """
+    def __init__(self, peripherals: 'Peripherals', svd: SvdPeripheral) -> None:
+        self._peripherals: 'Peripherals' = peripherals
+        self._svd: SvdPeripheral = svd
+        self._cache: Dict[str, int] = None
+        self._cache_epoch: int = None
+
+    @property
+    def svd(self) -> SvdPeripheral:
+        return self._svd
+
+    @property
+    def registers(self) -> List[str]:
+        return list(self._svd.registers.keys())
+
+    def invalidate(self) -> None:
+        self._cache = None
+
+    def _decode(self, data: bytes) -> int:
+        return int.from_bytes(data, self._peripherals.byteorder)
+
+    @property
+    def cached(self) -> bool:
+        epoch = self._peripherals.epoch()
+        return self._cache is not None and epoch is not None and epoch == self._cache_epoch
+
+    def ranges(self) -> List[Tuple[int, int]]:
+        # address ranges (start address, number of bytes) read to fill the cache
+        return [(self._svd.base + offset, num_bytes) for offset, num_bytes, _ in self._svd.block_ranges()]
+
+    def load(self, contents: List[bytes]) -> None:
+        # fills the cache with the contents of the ranges (see ranges) read from the target
+        values: Dict[str, int] = {}
+        for (offset, _, regs), data in zip(self._svd.block_ranges(), contents):
+            for reg in regs:
+                values[reg.name] = self._decode(data[reg.offset - offset:reg.offset - offset + reg.num_bytes])
+        self._cache = values
+        self._cache_epoch = self._peripherals.epoch()
+
+    def read(self) -> Dict[str, int]:
+        """
+        Returns the values of all registers which can be read without side effects (served from the cache if the
+        target has not been resumed since the last read).
+        """
+        if not self.cached:
+            self.load(self._peripherals.target.mem.read_many(self.ranges()))
+        return dict(self._cache)
+
+    def reg_value(self, reg: SvdRegister) -> int:
+        if not reg.readable:
+            raise DottException(f'{self._svd.name}.{reg.name} is write-only.')
+        if not reg.side_effect_free:
+            raise DottException(f'Reading {self._svd.name}.{reg.name} has side effects ({reg.read_action}). Use '
+                                f'read(side_effects=True) to read it anyway.')
+        return self.read()[reg.name]
+
+    def reg_read(self, reg: SvdRegister, side_effects: bool = False) -> int:
+        if not reg.side_effect_free and not side_effects:
+            return self.reg_value(reg)  # raises
+        data = self._peripherals.target.mem.read(self._svd.base + reg.offset, reg.num_bytes)
+        val = self._decode(data)
+        if self._cache is not None and reg.name in self._cache:
+            self._cache[reg.name] = val
+        return val
+
+    def reg_write(self, reg: SvdRegister, val: int) -> None:
+        if reg.access == 'read-only':
+            raise DottException(f'{self._svd.name}.{reg.name} is read-only.')
+        val &= (1 << reg.size) - 1
+        self._peripherals.target.mem.write(self._svd.base + reg.offset,
+                                           val.to_bytes(reg.num_bytes, self._peripherals.byteorder))
+        # note: the register is read back on the next access since bits may have write semantics (e.g., write 1 to
+        # clear) or the write may affect other registers
+        self.invalidate()
+
+    def __getattr__(self, name: str) -> PeripheralRegister:
+        if name.startswith('_'):
+            raise AttributeError(name)
+        reg = self._svd.registers.get(name)
+        if reg is None:
+            raise AttributeError(f'Peripheral {self._svd.name} has no register {name}.')
+        return PeripheralRegister(self, reg)
+
+
+# -------------------------------------------------------------------------------------------------
+class Peripherals(object):
+    """
+    SVD-based model of the peripherals of a target (Target.periph; the SVD file is configured with svd_file in
+    dott.ini). For example:
+        dt.periph.I2C1.CR1.PE = 1
+        assert 1 == dt.periph.I2C1.ISR.TXE
+        regs = dt.periph.DMA1.read()  # all registers of DMA1 (one block transfer)
+    Registers are cached per halt of the target (see Peripheral). Registers whose read has side effects (readAction)
+    are never read implicitly.
+    """
+    def __init__(self, target: 'Target', svd_file: str, byteorder: str = 'little') -> None:
+        self._target: 'Target' = target
+        self._device: SvdDevice = SvdDevice(svd_file)
+        self._byteorder: str = byteorder
+        self._periphs: Dict[str, Peripheral] = {}
+
+    @property
+    def target(self) -> 'Target':
+        return self._target
+
+    @property
+    def byteorder(self) -> str:
+        return self._byteorder
+
+    @property
+    def device(self) -> SvdDevice:
+        return self._device
+
+    def names(self) -> List[str]:
+        return list(self._device.peripherals.keys())
+
+    def epoch(self) -> int:
+        # identifies the current halt of the target (None while it is running, i.e., nothing is cached)
+        if self._target._is_target_running:
+            return None
+        return self._target._stop_count
+
+    def invalidate(self) -> None:
+        for periph in self._periphs.values():
+            periph.invalidate()
+
+    def read(self, names: List[str] = None) -> Dict[str, Dict[str, int]]:
+        """
+        Returns the register values (see Peripheral.read) of the given peripherals (default: all). The register
+        blocks of all peripherals which are not cached for the current halt are read in a single (pipelined) exchange.
+        """
+        periphs = [self[name] for name in (names if names is not None else self.names())]
+        stale = [p for p in periphs if not p.cached]
+        ranges = [p.ranges() for p in stale]
+        contents = self._target.mem.read_many([r for p_ranges in ranges for r in p_ranges])
+        for periph, p_ranges in zip(stale, ranges):
+            periph.load(contents[:len(p_ranges)])
+            contents = contents[len(p_ranges):]
+        return {p.svd.name: p.read() for p in periphs}
+
+    def snapshot(self, names: List[str] = None) -> 'PeripheralSnapshot':
+        """
+        Captures the registers of the given peripherals (default: all; see read). Two snapshots are compared with
+        PeripheralSnapshot.diff. For example:
+            before = dt.periph.snapshot(['I2C1', 'DMA1'])
+            dt.cont()
+            bp.wait_complete()
+            for change in before.diff(dt.periph.snapshot(['I2C1', 'DMA1'])):
+                print(change)
+        Taking a snapshot costs one MI exchange; hence, it can also be done in the reached method of every halt point.
+        """
+        return PeripheralSnapshot(self._device, self.read(names))
+
+    def monitor(self, live, regs: List[str], rate: float = None, duration: float = None,
+                capacity: int = 100000) -> 'PeripheralMonitor':
+        """
+        Starts monitoring the given registers while the firmware runs (see PeripheralMonitor). For example:
+            mon = dt.periph.monitor(live_access, ['I2C1.ISR', 'DMA1.CNDTR5', 'TIM2.CNT'])
+            dt.cont()
+            ...
+            mon.stop()
+            for t, change in mon.changes():
+                log.info(f'{t * 1e3:9.3f} ms  {change}')
+
+        Args:
+            live: Live access connection (e.g., live_access fixture).
+            regs: Registers (<peripheral>.<register>) or peripherals (all registers which can be read without side
+                  effects).
+            rate: Sampling rate in Hz. If None, the registers are sampled as fast as possible.
+            duration: Monitoring duration in seconds. If None, the monitor runs until stop is called.
+            capacity: Maximum number of recorded changes (the oldest ones are discarded).
+        """
+        return PeripheralMonitor(self, live, regs, rate, duration, capacity)
+
+    def __getitem__(self, name: str) -> Peripheral:
+        if name not in self._periphs:
+            svd = self._device.peripherals.get(name)
+            if svd is None:
+                raise KeyError(f'No peripheral {name} in {self._device._svd_file}.')
+            self._periphs[name] = Peripheral(self, svd)
+        return self._periphs[name]
+
+    def __getattr__(self, name: str) -> Peripheral:
+        if name.startswith('_'):
+            raise AttributeError(name)
+        try:
+            return self[name]
+        except KeyError as ex:
+            raise AttributeError(str(ex)) from None
+
+
+# -------------------------------------------------------------------------------------------------
+class PeripheralMonitor(object):
+    """
+    Samples a set of peripheral registers via a live access connection while the target is running (see
+    Peripherals.monitor). The sampler thread reads all registers with one scatter read per sample (registers located
+    close to each other cost a single probe transaction) and only records samples in which at least one register
+    changed; the comparison of a sample with the previous one is the only per-sample work on the host. Field decoding
+    (changes, fields) is done in bulk when the results are requested.
+    Note: Registers whose read has side effects (readAction, e.g., data registers of UARTs) and write-only registers
+    are rejected.
+    """
+    def __init__(self, periphs: Peripherals, live, regs: List[str], rate: float = None, duration: float = None,
+                 capacity: int = 100000) -> None:
+        self._periphs: Peripherals = periphs
+        self._live = live
+        self._regs: List[Tuple[str, SvdRegister, int]] = []  # (peripheral, register, address)
+        for name in regs:
+            self._regs += self._resolve(name)
+        if len(self._regs) == 0:
+            raise DottException('No peripheral registers to monitor.')
+
+        # note: registers narrower than 32 bit are extracted from the word containing them
+        self._words: List[int] = sorted({addr & ~0x3 for _, _, addr in self._regs})
+        self._extract: List[Tuple[int, int, int]] = []  # (word index, shift, mask) per register
+        for _, reg, addr in self._regs:
+            shift = (addr & 0x3) * 8
+            if self._periphs.byteorder != 'little':
+                shift = 32 - reg.size - shift
+            self._extract.append((self._words.index(addr & ~0x3), shift, (1 << reg.size) - 1))
+
+        self._rate: float = rate
+        self._duration: float = duration
+        self._capacity: int = capacity
+        self._samples: Deque[Tuple[float, List[int]]] = collections.deque(maxlen=capacity)  # changed samples
+        self._base: Tuple[float, List[int]] = None  # sample preceding the oldest recorded one (after drops)
+        self._dropped: int = 0
+        self._polls: int = 0
+        self._lock: threading.Lock = threading.Lock()
+        self._stop: threading.Event = threading.Event()
+        self._exception: Exception = None
+        self._thread: threading.Thread = threading.Thread(target=self._run, name='PeripheralMonitor', daemon=True)
+        self._thread.start()
+
+    def _resolve(self, name: str) -> List[Tuple[str, SvdRegister, int]]:
+        periph_name, _, reg_name = name.partition('.')
+        svd = self._periphs.device.peripherals.get(periph_name)
+        if svd is None:
+            raise DottException(f'Unknown peripheral {periph_name}.')
+        if reg_name == '':
+            return [(periph_name, reg, svd.base + reg.offset) for _, _, regs in svd.block_ranges() for reg in regs]
+        reg = svd.registers.get(reg_name)
+        if reg is None:
+            raise DottException(f'Unknown register {name}.')
+        if not reg.readable or not reg.side_effect_free:
+            raise DottException(f'{name} can not be monitored (write-only or read with side effects).')
+        if reg.size > 32 or (reg.offset & 0x3) + reg.num_bytes > 4:
+            raise DottException(f'{name} can not be monitored (not contained in an aligned 32 bit word).')
+        return [(periph_name, reg, svd.base + reg.offset)]
+
+    def _run(self) -> None:
+        period = 1.0 / self._rate if self._rate is not None else 0.0
+        prev = None
+        try:
+            with self._live.session():
+                time_start = time.perf_counter()
+                next_time = time_start
+                while not self._stop.is_set():
+                    now = time.perf_counter()
+                    if self._duration is not None and now - time_start >= self._duration:
+                        break
+                    if now < next_time:
+                        time.sleep(next_time - now)
+                        now = time.perf_counter()
+                    values = self._live.mem_read_scatter(self._words)
+                    self._polls += 1
+                    if values != prev:
+                        with self._lock:
+                            if len(self._samples) == self._capacity:
+                                self._base = self._samples[0]
+                                self._dropped += 1
+                            self._samples.append((now - time_start, values))
+                        prev = values
+                    next_time += period
+        except Exception as ex:
+            self._exception = ex
+
+    @property
+    def running(self) -> bool:
+        return self._thread.is_alive()
+
+    @property
+    def registers(self) -> List[str]:
+        return [f'{periph}.{reg.name}' for periph, reg, _ in self._regs]
+
+    @property
+    def polls(self) -> int:
+        """
+        Number of samples taken so far (recorded or not).
+        """
+        return self._polls
+
+    @property
+    def dropped(self) -> int:
+        """
+        Number of recorded samples which were discarded because the capacity was exceeded.
+        """
+        return self._dropped
+
+    def stop(self) -> None:
+        """
+        Stops the monitor. Exceptions raised by the sampler thread are re-raised.
+        """
+        self._stop.set()
+        self.wait()
+
+    def wait(self, timeout: float = None) -> None:
+        """
+        Waits until the monitor is completed (see duration). Exceptions raised by the sampler thread are re-raised.
+        """
+        self._thread.join(timeout)
+        if self._exception is not None:
+            raise self._exception
+
+    def _recorded(self) -> Tuple[List[float], List[List[int]]]:
+        with self._lock:
+            return [t for t, _ in self._samples], [v for _, v in self._samples]
+
+    def values(self, reg: str) -> Tuple[List[float], List[int]]:
+        """
+        Returns the timestamps (seconds since the start of the monitor) and the values of the given register
+        (<peripheral>.<register>) of the recorded samples.
+        """
+        idx = self._index(reg)
+        word, shift, mask = self._extract[idx]
+        times, samples = self._recorded()
+        return times, [(s[word] >> shift) & mask for s in samples]
+
+    def fields(self, field: str) -> Tuple[List[float], List[int]]:
+        """
+        Returns the timestamps and the values of the given register field (<peripheral>.<register>.<field>) of the
+        recorded samples.
+        """
+        reg_name, _, field_name = field.rpartition('.')
+        svd_field = self._regs[self._index(reg_name)][1].fields.get(field_name)
+        if svd_field is None:
+            raise DottException(f'Unknown register field {field}.')
+        times, values = self.values(reg_name)
+        return times, [(v & svd_field.mask) >> svd_field.lsb for v in values]
+
+    def _index(self, reg: str) -> int:
+        try:
+            return self.registers.index(reg)
+        except ValueError:
+            raise DottException(f'Register {reg} is not monitored.') from None
+
+    def changes(self) -> List[Tuple[float, PeripheralChange]]:
+        """
+        Returns the field-level changes (see PeripheralSnapshot.diff) between consecutive recorded samples together
+        with their timestamps.
+        """
+        with self._lock:
+            recorded = ([self._base] if self._base is not None else []) + list(self._samples)
+        times, samples = [t for t, _ in recorded], [v for _, v in recorded]
+        res: List[Tuple[float, PeripheralChange]] = []
+        for i in range(1, len(samples)):
+            for (periph, reg, _), (word, shift, mask) in zip(self._regs, self._extract):
+                old_val, new_val = (samples[i - 1][word] >> shift) & mask, (samples[i][word] >> shift) & mask
+                if old_val != new_val:
+                    res += [(times[i], change) for change in _field_changes(periph, reg, old_val, new_val)]
+        return res
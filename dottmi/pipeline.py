@@ -0,0 +1,194 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Pipelined execution of a table of test cases against a target function. Each case is prepared on the host (e.g.,
+# numpy signal generation or file I/O), uploaded into an on-target scratch buffer, processed by the function (called
+# via the resident call stub, see Target.call) and its output is read back. Two scratch buffers are used alternately:
+# while the target executes case N from one buffer, the host prepares case N+1 and - if a live access connection with
+# write support is available (TargetMem.direct) - uploads it into the other buffer and reads back the output of case
+# N-1. Without live access, uploads and read backs happen while the target is halted between the cases; the host
+# preparation is still hidden behind the target execution. For example:
+#
+#   pipe = CasePipeline(dt, 'filter_Process', in_size=4096, out_size=4096)
+#   results = pipe.run(cases, prepare=lambda c: gen_signal(c).astype('<i2').tobytes(),
+#                      collect=lambda c, ret, out: np.frombuffer(out, '<i2'))
+#   for case, res in zip(cases, results):
+#       assert np.allclose(res, reference(case))
+#
+# Note: The cases of a pytest parametrization are separate tests which run one after the other; to benefit from the
+# pipelining, the case table is processed within one test (or a module-scoped fixture whose results are checked by
+# the parametrized tests).
+
+import time
+from typing import Any, Callable, Dict, List, Sequence, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+# alignment of the output buffer within a scratch buffer
+_OUT_ALIGN = 8
+
+
+# -------------------------------------------------------------------------------------------------
+class CasePipeline(object):
+    """
+    Double-buffered runner of a table of cases (see module description). The function under test is called with the
+    arguments returned by args (default: input address, input size, output address; the output address is omitted if
+    out_size is 0).
+    """
+    def __init__(self, target: 'Target', func: str, in_size: int, out_size: int = 0,
+                 args: Callable[[Any, int, int, int], Tuple[int, ...]] = None, timeout: float = None,
+                 live: bool = None) -> None:
+        """
+        Constructor. Allocates the two scratch buffers in the on-target scratch memory (Target.mem).
+
+        Args:
+            target: Target (halted, with the scratch memory of the test initialized).
+            func: Name of the function under test.
+            in_size: Maximum size of the input of a case in bytes.
+            out_size: Size of the output of a case in bytes (0: the function only returns a value).
+            args: Returns the arguments of the function (at most four integers) for a case given the case, the
+                  input address, the input size and the output address.
+            timeout: Time (seconds) the function may take per case (default: state change timeout).
+            live: If True, uploads and read backs are overlapped with the target execution using live access (default:
+                  if the memory of the target has a direct connection with write support).
+        """
+        self._dt: 'Target' = target
+        self._func: str = func
+        self._in_size: int = in_size
+        self._out_size: int = out_size
+        self._args = args if args is not None else \
+            (lambda case, in_addr, in_len, out_addr: (in_addr, in_len, out_addr) if out_size > 0 else (in_addr, in_len))
+        self._timeout: float = timeout
+
+        if live is None:
+            live = target.mem.direct is not None and hasattr(target.mem.direct, 'mem_write')
+        self._live = None
+        if live:
+            self._live = target.live_direct()
+            if not hasattr(self._live, 'mem_write'):
+                raise DottException('CasePipeline: the live access connection does not support writes.')
+
+        out_offset = (in_size + _OUT_ALIGN - 1) // _OUT_ALIGN * _OUT_ALIGN
+        self._out_offset: int = out_offset
+        self._bufs = [target.mem.alloc(out_offset + out_size) for _ in range(2)]
+        self._stats: Dict[str, float] = {}
+
+    @property
+    def stats(self) -> Dict[str, float]:
+        """
+        Timing of the last run (seconds): elapsed (whole run), host (preparation and collection of the cases) and
+        wait (host waited for the target to complete a case).
+        """
+        return self._stats
+
+    def _in_addr(self, idx: int) -> int:
+        return self._bufs[idx % 2].addr
+
+    def _out_addr(self, idx: int) -> int:
+        return self._bufs[idx % 2].addr + self._out_offset
+
+    def _upload(self, idx: int, data: bytes, running: bool) -> None:
+        if len(data) > self._in_size:
+            raise DottException(f'CasePipeline: input of case {idx} exceeds in_size ({len(data)} > {self._in_size}).')
+        if running:
+            self._live.mem_write(self._in_addr(idx), data)
+        else:
+            self._dt.mem.write(self._in_addr(idx), data)
+
+    def _read_out(self, idx: int, running: bool) -> bytes:
+        if self._out_size == 0:
+            return b''
+        if running:
+            return self._live.mem_read(self._out_addr(idx), self._out_size)
+        return self._dt.mem.read(self._out_addr(idx), self._out_size)
+
+    def run(self, cases: Sequence, prepare: Callable[[Any], bytes],
+            collect: Callable[[Any, int, bytes], Any] = None, signed: bool = False) -> List:
+        """
+        Runs all cases and returns their results (in the order of the cases).
+
+        Args:
+            cases: The cases (any objects passed to prepare, args and collect).
+            prepare: Returns the input data of a case.
+            collect: Returns the result of a case given the case, the return value of the function and the content of
+                     the output buffer (default: the return value if out_size is 0, otherwise a tuple with return
+                     value and output).
+            signed: If True, the return values are interpreted as signed 32 bit integers.
+        """
+        if collect is None:
+            collect = (lambda case, ret, out: ret) if self._out_size == 0 else (lambda case, ret, out: (ret, out))
+        results: List = [None] * len(cases)
+        host_secs = wait_secs = 0.0
+        start = time.perf_counter()
+        if len(cases) == 0:
+            return results
+
+        data = prepare(cases[0])
+        self._upload(0, data, running=False)
+        prev: Tuple[int, int] = None  # case (index, return value) whose output has not been read yet
+        with self._dt.call_session():
+            for i, case in enumerate(cases):
+                self._dt.call_start(self._func, *self._args(case, self._in_addr(i), len(data), self._out_addr(i)))
+                next_data = None
+                try:
+                    # while the target executes case i: collect case i-1 and prepare (and upload) case i+1
+                    t = time.perf_counter()
+                    if prev is not None and self._live is not None:
+                        results[prev[0]] = collect(cases[prev[0]], prev[1], self._read_out(prev[0], running=True))
+                        prev = None
+                    if i + 1 < len(cases):
+                        next_data = prepare(cases[i + 1])
+                        if self._live is not None:
+                            self._upload(i + 1, next_data, running=True)
+                    host_secs += time.perf_counter() - t
+                finally:
+                    # note: the call is completed in any case such that the call session restores a halted target
+                    t = time.perf_counter()
+                    ret = self._dt.call_wait(signed, self._timeout)
+                    wait_secs += time.perf_counter() - t
+
+                # note: the buffer of case i-1 is the one of case i+1; it is read back before being overwritten
+                t = time.perf_counter()
+                if prev is not None:
+                    results[prev[0]] = collect(cases[prev[0]], prev[1], self._read_out(prev[0], running=False))
+                prev = (i, ret)
+                host_secs += time.perf_counter() - t
+                if next_data is not None:
+                    if self._live is None:
+                        self._upload(i + 1, next_data, running=False)
+                    data = next_data
+
+        results[prev[0]] = collect(cases[prev[0]], prev[1], self._read_out(prev[0], running=False))
+        self._stats = {'elapsed': time.perf_counter() - start, 'host': host_secs, 'wait': wait_secs}
+        log.debug(f'CasePipeline {self._func}: {len(cases)} cases in {self._stats["elapsed"]:.3f}s (host '
+                  f'{host_secs:.3f}s, waited {wait_secs:.3f}s for the target).')
+        return results
+
+    def close(self) -> None:
+        """
+        Frees the scratch buffers.
+        """
+        for buf in self._bufs:
+            self._dt.mem.free(buf)
+        self._bufs = []
+
+    def __enter__(self) -> 'CasePipeline':
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.close()
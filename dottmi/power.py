@@ -0,0 +1,258 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Target current capture using the power trace of J-Link probes with power measurement (e.g., J-Link Pro/Ultra+).
+# A host thread reads the current samples from the probe while the test runs. Test phases (mark, span) and breakpoint
+# hits (attach) are recorded with the same host clock (time.perf_counter) such that the energy spent per phase or per
+# function can be determined afterwards:
+#
+#   with live_access.power_capture(voltage=3.3) as pwr:
+#       pwr.attach(HaltPoint('app_sleep'), 'sleep')  # each hit of the breakpoint starts a "sleep" segment
+#       with pwr.span('processing'):
+#           dott().target.cont()
+#           ...
+#   log.info(str(pwr.report()))
+
+import array
+import bisect
+import contextlib
+import threading
+import time
+from typing import Dict, Iterator, List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+
+@contextlib.contextmanager
+def _exclusive_access():
+    # default probe access of PowerCapture (probe connection not shared, see ProbeBroker)
+    yield
+
+
+# -------------------------------------------------------------------------------------------------
+class PowerReport(object):
+    """
+    Energy per segment name (see PowerCapture.report): accumulated duration (seconds), charge (coulomb), energy
+    (joule) and the average and peak current (ampere) of all segments with that name.
+    """
+    def __init__(self, segments: Dict[str, Dict], total: Dict, num_samples: int) -> None:
+        self.segments: Dict[str, Dict] = segments
+        self.total: Dict = total
+        self.num_samples: int = num_samples
+
+    def __str__(self) -> str:
+        lines = [f'  {"segment":<24}{"count":>7}{"time [ms]":>12}{"avg [mA]":>11}{"peak [mA]":>11}{"energy [uJ]":>13}']
+        for name, s in sorted(self.segments.items(), key=lambda i: -i[1]['energy']) + [('total', self.total)]:
+            lines.append(f'  {name:<24}{s["count"]:>7}{s["duration"] * 1e3:>12.2f}{s["avg_current"] * 1e3:>11.3f}'
+                         f'{s["peak_current"] * 1e3:>11.3f}{s["energy"] * 1e6:>13.2f}')
+        return '\n'.join(lines)
+
+
+# -------------------------------------------------------------------------------------------------
+class PowerCapture(object):
+    """
+    Captures the target current via the power trace of a J-Link probe in a host thread (see module description).
+    Use TargetDirect.power_capture to create an instance. Samples are time-stamped from their index and the sampling
+    frequency reported by the probe, relative to the (host) start time of the power trace.
+    """
+    # interval (in seconds) in which the probe is polled for new samples
+    POLL_INTERVAL = 0.01
+
+    def __init__(self, jlink, freq: int = 10000, channel: int = 0, voltage: float = 3.3, scale: float = 1e-6,
+                 always: bool = True, access=None) -> None:
+        """
+        Constructor.
+
+        Args:
+            jlink: pylink JLink instance (connected to the target).
+            freq: Requested sampling frequency in Hz (the probe may select a different one, see freq).
+            channel: Power trace channel of the probe.
+            voltage: Supply voltage of the target (used to convert charge into energy).
+            scale: Ampere per raw power trace unit (J-Link reports microampere).
+            always: Capture while the CPU is halted too (otherwise, the probe only samples while the CPU runs, which
+                    breaks the time base).
+            access: Context manager factory guarding each use of the probe connection (see ProbeBroker.access).
+        """
+        self._jlink = jlink
+        self._access = access if access is not None else _exclusive_access
+        self._freq_req: int = freq
+        self._freq: float = None
+        self._channel: int = channel
+        self._voltage: float = voltage
+        self._scale: float = scale
+        self._always: bool = always
+        self._currents: array.array = array.array('d')
+        self._marks: List[Tuple[float, str]] = []  # (host time, segment name), sorted by time
+        self._lock: threading.Lock = threading.Lock()
+        self._running: bool = False
+        self._thread: threading.Thread = None
+        self._time_start: float = None
+        self._listeners: List[Tuple['Breakpoint', object]] = []
+
+    @property
+    def freq(self) -> float:
+        """
+        Sampling frequency (Hz) selected by the probe.
+        """
+        return self._freq
+
+    @property
+    def num_samples(self) -> int:
+        return len(self._currents)
+
+    def start(self) -> None:
+        """
+        Configures and starts the power trace of the probe and the capture thread.
+        """
+        if self._running:
+            return
+        with self._access():
+            self._freq = float(self._jlink.power_trace_configure([self._channel], self._freq_req, 0, self._always))
+            self._jlink.power_trace_flush()
+            self._jlink.power_trace_start()
+            self._time_start = time.perf_counter()
+        if self._freq <= 0:
+            raise DottException('Power trace is not supported by the probe.')
+        log.debug(f'Power capture started ({self._freq:.0f}Hz).')
+        self._running = True
+        self._thread = threading.Thread(target=self._capture_loop, name='PowerCapture', daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        """
+        Stops the capture. Samples and marks remain available (see report).
+        """
+        if not self._running:
+            return
+        self._running = False
+        self._thread.join()
+        for bp, listener in self._listeners:
+            bp.remove_complete_listener(listener)
+        self._listeners = []
+        try:
+            with self._access():
+                self._jlink.power_trace_stop()
+        except Exception as ex:
+            log.debug(f'Unable to stop power trace ({ex}).')
+
+    def _capture_loop(self) -> None:
+        while self._running:
+            try:
+                with self._access():
+                    items = self._jlink.power_trace_read()
+            except Exception as ex:
+                log.error(f'Power capture failed ({ex}).')
+                self._running = False
+                return
+            if len(items) == 0:
+                time.sleep(PowerCapture.POLL_INTERVAL)
+                continue
+            self._currents.extend(item.Data * self._scale for item in items)
+
+    def mark(self, name: str, t: float = None) -> None:
+        """
+        Starts a segment with the given name at the given host time (time.perf_counter; default: now). A segment
+        lasts until the next mark.
+        """
+        t = t if t is not None else time.perf_counter()
+        with self._lock:
+            bisect.insort(self._marks, (t, name))
+
+    @contextlib.contextmanager
+    def span(self, name: str, after: str = 'other') -> Iterator[None]:
+        """
+        Context manager which marks its body as segment with the given name (followed by a segment named after).
+        """
+        self.mark(name)
+        try:
+            yield
+        finally:
+            self.mark(after)
+
+    def attach(self, bp: 'Breakpoint', name: str = None) -> None:
+        """
+        Starts a segment (named after the breakpoint's location by default) whenever the given breakpoint completes.
+        Note: The time is taken when DOTT is notified, i.e., it includes the (host-side) breakpoint handling latency.
+        """
+        name = name if name is not None else bp._location
+
+        def listener() -> None:
+            self.mark(name)
+
+        bp.add_complete_listener(listener)
+        self._listeners.append((bp, listener))
+
+    def _time(self, idx: float) -> float:
+        return self._time_start + idx / self._freq
+
+    def samples(self) -> Tuple[List[float], List[float]]:
+        """
+        Returns the host times (time.perf_counter) and currents (ampere) of the samples captured so far.
+        """
+        currents = list(self._currents)
+        return [self._time(i) for i in range(len(currents))], currents
+
+    def _integrate(self, currents: array.array, t_start: float, t_end: float) -> Tuple[float, float]:
+        # charge (sum of the samples within [t_start, t_end) times the sample period) and peak current
+        first = max(0, int((t_start - self._time_start) * self._freq + 0.5))
+        last = min(len(currents), int((t_end - self._time_start) * self._freq + 0.5))
+        if last <= first:
+            return 0.0, 0.0
+        window = currents[first:last]
+        return sum(window) / self._freq, max(window)
+
+    def report(self) -> PowerReport:
+        """
+        Returns the energy per segment name. Samples before the first mark are accounted as segment "start".
+        """
+        if self._time_start is None:
+            raise DottException('The power capture has not been started.')
+        currents = self._currents[:]
+        t_end = self._time(len(currents))
+        with self._lock:
+            marks = [(self._time_start, 'start')] + [m for m in self._marks if m[0] > self._time_start]
+        segments: Dict[str, Dict] = {}
+        for (t0, name), (t1, _) in zip(marks, marks[1:] + [(t_end, None)]):
+            t1 = min(t1, t_end)
+            if t1 <= t0:
+                continue
+            charge, peak = self._integrate(currents, t0, t1)
+            seg = segments.setdefault(name, {'count': 0, 'duration': 0.0, 'charge': 0.0, 'peak_current': 0.0})
+            seg['count'] += 1
+            seg['duration'] += t1 - t0
+            seg['charge'] += charge
+            seg['peak_current'] = max(seg['peak_current'], peak)
+        for seg in segments.values():
+            seg['energy'] = seg['charge'] * self._voltage
+            seg['avg_current'] = seg['charge'] / seg['duration'] if seg['duration'] > 0 else 0.0
+        duration = len(currents) / self._freq
+        total = {'count': 1, 'duration': duration, 'charge': sum(currents) / self._freq,
+                 'peak_current': max(currents, default=0.0)}
+        total['energy'] = total['charge'] * self._voltage
+        total['avg_current'] = total['charge'] / duration if duration > 0 else 0.0
+        return PowerReport(segments, total, len(currents))
+
+    def __enter__(self) -> 'PowerCapture':
+        self.start()
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.stop()
@@ -0,0 +1,160 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Prepared expressions: an expression which denotes a global variable (or a member/element of it with constant
+# indices, e.g., '_tick_cnt', '_data[3]' or 'cfg.limits[1].max') is resolved by GDB once to its address and type
+# layout. Afterwards, the value is read and written as raw memory via the fastest memory backend and decoded on the
+# host; while the target is running, the live access connection is used. All other expressions (locals, pointer
+# dereferences, registers, bitfields, ...) fall back to eval via GDB. For example:
+#
+#   tick = dt.prepare('_tick_cnt')
+#   dt.cont()
+#   while tick.value < 100:  # read via live access while the target runs
+#       ...
+#   a, b = PreparedExpr.read_many([dt.prepare('_data[0]'), dt.prepare('_data[1]')])  # one (pipelined) transfer
+
+import re
+from typing import Dict, List, Union
+
+from dottmi.dottexceptions import DottException
+from dottmi.type_layout import TypeLayout
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class PreparedExpr(object):
+    """
+    Accessor for a prepared expression (see Target.prepare and module description).
+    """
+    # global variable followed by member accesses and constant array indices
+    _LVALUE_RE = re.compile(r'^\s*([A-Za-z_]\w*)(\s*(\.\s*[A-Za-z_]\w*|\[\s*(0x[0-9a-fA-F]+|\d+)\s*\]))*\s*$')
+
+    def __init__(self, target: 'Target', expr: str) -> None:
+        self._target: 'Target' = target
+        self._expr: str = expr
+        self._addr: int = None
+        self._layout: TypeLayout = None
+        self._resolve()
+
+    def _resolve(self) -> None:
+        m = PreparedExpr._LVALUE_RE.match(self._expr)
+        if m is None or not self._target.symbols.exists(m.group(1)):
+            log.debug(f'Prepared expression {self._expr} is evaluated via GDB (not a global lvalue).')
+            return
+        root = m.group(1)
+        try:
+            addr, root_addr = self._target.eval_many([f'(unsigned int) &({self._expr})', f'(unsigned int) &{root}'])
+            layout = self._target.mem.type_layout(f'__typeof__({self._expr})')
+        except Exception as ex:
+            log.debug(f'Prepared expression {self._expr} is evaluated via GDB ({ex}).')
+            return
+        if root_addr != self._target.symbols.addr(root):
+            # note: the name is shadowed by a local variable in the current context
+            log.debug(f'Prepared expression {self._expr} is evaluated via GDB ({root} is not the global variable).')
+            return
+        self._addr, self._layout = int(addr), layout
+
+    @property
+    def expr(self) -> str:
+        return self._expr
+
+    @property
+    def direct(self) -> bool:
+        """
+        True if the expression is accessed as raw memory (False: evaluated via GDB).
+        """
+        return self._addr is not None
+
+    @property
+    def addr(self) -> int:
+        return self._addr
+
+    @property
+    def size(self) -> int:
+        return self._layout.size if self._layout is not None else None
+
+    @property
+    def layout(self) -> TypeLayout:
+        return self._layout
+
+    def _mem_read(self, addr: int, num_bytes: int) -> bytes:
+        if self._target.is_running() and self._target.mem.direct is None:
+            return self._target.live_direct().mem_read(addr, num_bytes)
+        return self._target.mem.read(addr, num_bytes)
+
+    def read(self) -> Union[int, float, Dict, List, bytes]:
+        """
+        Returns the value of the expression (structs as dicts and arrays as lists, see TypeLayout).
+        """
+        if self._addr is None:
+            if self._target.is_running():
+                raise DottException(f'{self._expr} can only be evaluated via GDB while the target is halted.')
+            return self._target.eval_value(self._expr)
+        return self._layout.unpack(self._mem_read(self._addr, self._layout.size))
+
+    def write(self, value: Union[int, float, Dict, List, bytes]) -> None:
+        """
+        Writes the given value. Struct members and array elements not contained in value remain unchanged.
+        """
+        if self._addr is None:
+            if not isinstance(value, (int, float)):
+                raise DottException(f'Only numbers can be assigned to {self._expr} (evaluated via GDB).')
+            self._target.eval(f'{self._expr} = {value}')
+            return
+        base = None if self._layout.is_complete(value) else self._mem_read(self._addr, self._layout.size)
+        data = self._layout.pack(value, base)
+        if self._target.is_running() and self._target.mem.direct is None:
+            live = self._target.live_direct()
+            if not hasattr(live, 'mem_write'):
+                raise DottException('The live access connection does not support writes.')
+            live.mem_write(self._addr, data)
+        else:
+            self._target.mem.write(self._addr, data)
+
+    @property
+    def value(self) -> Union[int, float, Dict, List, bytes]:
+        return self.read()
+
+    @value.setter
+    def value(self, value: Union[int, float, Dict, List, bytes]) -> None:
+        self.write(value)
+
+    @staticmethod
+    def read_many(exprs: List['PreparedExpr']) -> List[Union[int, float, Dict, List, bytes]]:
+        """
+        Returns the values of the given prepared expressions (of the same target). The memory of all expressions
+        accessed as raw memory is read with a single read_many.
+        """
+        raw = [e for e in exprs if e.direct]
+        contents: Dict[int, bytes] = {}
+        if len(raw) > 0:
+            target = raw[0]._target
+            ranges = [(e.addr, e.size) for e in raw]
+            if target.is_running() and target.mem.direct is None:
+                live = target.live_direct()
+                data = [live.mem_read(a, n) for a, n in ranges]
+            else:
+                data = target.mem.read_many(ranges)
+            contents = {id(e): d for e, d in zip(raw, data)}
+        return [e.layout.unpack(contents[id(e)]) if e.direct else e.read() for e in exprs]
+
+    def __repr__(self) -> str:
+        where = f'0x{self._addr:x}, {self._layout.size} bytes' if self._addr is not None else 'gdb'
+        return f'PreparedExpr({self._expr!r}, {where})'
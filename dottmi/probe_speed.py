@@ -0,0 +1,219 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import json
+import os
+import re
+import time
+from pathlib import Path
+from typing import Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class ProbeSpeedCache(object):
+    """
+    Host-side record of the tuned J-Link speeds (see ProbeSpeedTuner) of individual boards (identified by the serial
+    number of their debug probe). Delete the board's file to tune its speed again (e.g., after changing the cabling).
+    """
+    def __init__(self, cache_dir: str) -> None:
+        self._cache_dir: str = cache_dir
+
+    def _file_name(self, board: str) -> Path:
+        board = re.sub(r'[^\w.-]', '_', board)
+        return Path(self._cache_dir).joinpath(f'dott_speed_{board}.json')
+
+    def load(self, board: str, device_name: str, interface: str) -> int:
+        """
+        Returns the tuned speed (in kHz) of the given board or None if there is no (matching) record.
+        """
+        if board is None or not self._file_name(board).exists():
+            return None
+        try:
+            with open(self._file_name(board), 'r') as f:
+                content = json.load(f)
+            if content.get('device') != device_name or content.get('interface') != interface:
+                return None
+            return int(content['speed'])
+        except (OSError, ValueError, KeyError) as ex:
+            log.warn(f'Ignoring unreadable probe speed file {self._file_name(board)} ({ex}).')
+            return None
+
+    def save(self, board: str, device_name: str, interface: str, speed: int, throughput: float) -> None:
+        if board is None:
+            return
+        try:
+            os.makedirs(self._cache_dir, exist_ok=True)
+            tmp_file = f'{self._file_name(board)}.{os.getpid()}.tmp'
+            with open(tmp_file, 'w') as f:
+                json.dump({'device': device_name, 'interface': interface, 'speed': speed,
+                           'throughput': round(throughput)}, f)
+            os.replace(tmp_file, self._file_name(board))
+        except OSError as ex:
+            log.warn(f'Unable to write probe speed file {self._file_name(board)} ({ex}).')
+
+
+# -------------------------------------------------------------------------------------------------
+class ProbeSpeedTuner(object):
+    """
+    Determines the fastest J-Link speed at which a board can be accessed reliably. The reference content of a memory
+    region (by default the start of the code region, i.e., the vector table) is read at a safe speed. Then, starting
+    with the fastest candidate, the region is read repeatedly (bulk reads) and compared with the reference. The first
+    speed at which all reads succeed and match is selected. The memory is only read, i.e., the target's state is not
+    altered. Must be called before the GDB server of the board is started (the probe can not be shared with it).
+    """
+    # candidate speeds in kHz (fastest first); the J-Link clamps speeds above the maximum of the probe
+    SPEEDS = [50000, 30000, 20000, 15000, 12000, 8000, 4000, 2000]
+
+    # speed (in kHz) used to connect and to read the reference content
+    SAFE_SPEED = 1000
+
+    # number of bulk reads which have to match at a candidate speed
+    ROUNDS = 4
+
+    def __init__(self, device_name: str, jlink_serial: str = None, interface: str = 'SWD',
+                 region: Tuple[int, int] = (0x0, 0x1000), jlink_addr_port: str = None) -> None:
+        self._device_name: str = device_name
+        self._jlink_serial: str = jlink_serial
+        self._interface: str = interface
+        self._region: Tuple[int, int] = region
+        self._jlink_addr_port: str = jlink_addr_port
+
+    def _read_ok(self, jlink, reference: List[int]) -> Tuple[bool, float]:
+        # returns whether all rounds matched the reference and the achieved throughput (bytes/s)
+        addr, num_bytes = self._region
+        start = time.perf_counter()
+        for _ in range(ProbeSpeedTuner.ROUNDS):
+            if jlink.memory_read8(addr, num_bytes) != reference:
+                return False, 0.0
+        return True, num_bytes * ProbeSpeedTuner.ROUNDS / (time.perf_counter() - start)
+
+    def tune(self) -> Tuple[str, int, float]:
+        """
+        Runs the measurement.
+
+        Returns:
+            Serial number of the probe, selected speed (in kHz) and throughput (bytes/s) at that speed.
+        """
+        import pylink
+        from dottmi.pylinkdott import _JlinkDott
+
+        jlink = _JlinkDott()
+        jlink.open(self._jlink_serial, self._jlink_addr_port)
+        try:
+            serial = str(jlink.serial_number)
+            jlink.set_tif(pylink.enums.JLinkInterfaces.JTAG if self._interface.upper() == 'JTAG'
+                          else pylink.enums.JLinkInterfaces.SWD)
+            jlink.connect(self._device_name, speed=ProbeSpeedTuner.SAFE_SPEED, verbose=False)
+            reference = jlink.memory_read8(*self._region)
+
+            for speed in ProbeSpeedTuner.SPEEDS:
+                try:
+                    jlink.set_speed(speed)
+                    ok, throughput = self._read_ok(jlink, reference)
+                except Exception as ex:
+                    log.debug(f'Probe speed {speed} kHz failed ({ex}).')
+                    ok, throughput = False, 0.0
+                log.debug(f'Probe speed {speed} kHz: {"ok" if ok else "failed"} ({throughput / 1024:.0f} KiB/s)')
+                if ok:
+                    return serial, speed, throughput
+                # note: the next candidate is tried after accessing the target at the safe speed again
+                jlink.set_speed(ProbeSpeedTuner.SAFE_SPEED)
+            return serial, ProbeSpeedTuner.SAFE_SPEED, 0.0
+        finally:
+            jlink.close()
+
+
+def tuned_speed(cache: ProbeSpeedCache, device_name: str, jlink_serial: str = None, interface: str = 'SWD',
+                region: Tuple[int, int] = (0x0, 0x1000), jlink_addr_port: str = None) -> str:
+    """
+    Returns the tuned speed (in kHz, as string for GdbServerJLink) of the given board. The speed is taken from the
+    cache or, if the board has not been tuned yet, measured (see ProbeSpeedTuner) and stored in the cache.
+    """
+    speed = cache.load(jlink_serial, device_name, interface)
+    if speed is not None:
+        log.info(f'J-LINK speed (tuned):  {speed} kHz (cached for SN {jlink_serial})')
+        return str(speed)
+
+    serial, speed, throughput = ProbeSpeedTuner(device_name, jlink_serial, interface, region, jlink_addr_port).tune()
+    log.info(f'J-LINK speed (tuned):  {speed} kHz ({throughput / 1024:.0f} KiB/s read throughput, SN {serial})')
+    cache.save(serial, device_name, interface, speed, throughput)
+    return str(speed)
+
+
+# -------------------------------------------------------------------------------------------------
+class PacketSizeTuner(object):
+    """
+    Determines the remote protocol packet size for memory transfers between GDB and the GDB server which yields the
+    highest read throughput (see gdb_packet_tune in dott.ini). GDB splits memory reads and writes into packets of at
+    most memory-read-packet-size / memory-write-packet-size bytes; GDB limits both to the packet size announced by
+    the server. The region used by jlink_speed_tune_region is read (bulk reads via GDB) with each candidate size;
+    the fastest size whose reads match the reference content is set for reads and writes. The target has to be
+    halted; its state is not altered.
+    """
+    # candidate packet sizes in bytes
+    SIZES = [512, 1024, 2048, 4096, 8192, 16384]
+
+    # number of bulk reads per candidate size
+    ROUNDS = 4
+
+    def __init__(self, target: 'Target', region: Tuple[int, int] = (0x0, 0x1000)) -> None:
+        self._target: 'Target' = target
+        self._region: Tuple[int, int] = region
+
+    def _set(self, size: int) -> None:
+        self._target.cli_exec(f'set remote memory-read-packet-size {size}')
+        self._target.cli_exec(f'set remote memory-write-packet-size {size}')
+
+    def _read(self) -> bytes:
+        addr, num_bytes = self._region
+        res = self._target.exec(f'-data-read-memory-bytes {addr} {num_bytes}')
+        return bytes.fromhex(res['payload']['memory'][0]['contents'])
+
+    def tune(self) -> Tuple[int, float, Dict[int, float]]:
+        """
+        Runs the measurement and sets the selected packet size.
+
+        Returns:
+            Selected packet size, its read throughput (bytes/s) and the throughput of all candidates which worked.
+        """
+        reference = self._read()
+        results: Dict[int, float] = {}
+        for size in PacketSizeTuner.SIZES:
+            try:
+                self._set(size)
+                start = time.perf_counter()
+                ok = all(self._read() == reference for _ in range(PacketSizeTuner.ROUNDS))
+                throughput = len(reference) * PacketSizeTuner.ROUNDS / (time.perf_counter() - start)
+            except Exception as ex:
+                log.debug(f'Packet size {size} failed ({ex}).')
+                continue
+            log.debug(f'Packet size {size}: {"ok" if ok else "mismatch"} ({throughput / 1024:.0f} KiB/s)')
+            if ok:
+                results[size] = throughput
+        if len(results) == 0:
+            raise DottException('No packet size candidate allowed reliable memory reads.')
+        # note: candidates within 2% of the fastest one are considered equal; the smallest of them is selected
+        fastest = max(results.values())
+        best = min(size for size, throughput in results.items() if throughput >= 0.98 * fastest)
+        self._set(best)
+        return best, results[best], results
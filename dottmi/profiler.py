@@ -0,0 +1,127 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+from collections import Counter
+from typing import Dict, List, Tuple
+
+from dottmi.symbols import BinarySymbols
+
+
+# -------------------------------------------------------------------------------------------------
+class PcProfile(object):
+    """
+    Statistical profile of the firmware built from PC samples (see PcProfiler). Samples which are not located in
+    any function of the symbol index are attributed to UNKNOWN, samples taken while the core was halted or sleeping
+    (PCSR reads 0xffffffff) to IDLE.
+    """
+    UNKNOWN = '<unknown>'
+    IDLE = '<idle>'
+
+    def __init__(self, pcs: List[int], symbols: BinarySymbols) -> None:
+        self._num_samples: int = len(pcs)
+        self._pc_counts: Counter = Counter(pcs)
+        self._func_counts: Counter = Counter()
+        for pc, cnt in self._pc_counts.items():
+            if pc == 0xffffffff:
+                func = PcProfile.IDLE
+            else:
+                func = symbols.func_at(pc & ~0x1)
+                func = PcProfile.UNKNOWN if func is None else func
+            self._func_counts[func] += cnt
+
+    @property
+    def num_samples(self) -> int:
+        return self._num_samples
+
+    @property
+    def pc_counts(self) -> Dict[int, int]:
+        """
+        Number of samples per PC value.
+        """
+        return dict(self._pc_counts)
+
+    def flat(self) -> List[Tuple[str, int, float]]:
+        """
+        Returns the flat profile as list of (function, number of samples, share in percent), sorted by the number of
+        samples (descending).
+        """
+        return [(func, cnt, 100.0 * cnt / self._num_samples) for func, cnt in self._func_counts.most_common()]
+
+    def flat_str(self, limit: int = 20) -> str:
+        """
+        Returns the flat profile (limited to the given number of functions) as human-readable table.
+        """
+        lines = [f'{"samples":>10} {"share":>7}  function']
+        for func, cnt, share in self.flat()[:limit]:
+            lines.append(f'{cnt:>10} {share:6.2f}%  {func}')
+        return '\n'.join(lines)
+
+    def collapsed(self, root: str = 'firmware') -> str:
+        """
+        Returns the profile in the collapsed stack format (one 'frame;frame count' line per stack) as consumed by
+        flamegraph.pl and speedscope. Note: PC sampling does not capture call stacks; the stacks consist of the given
+        root frame and the sampled function.
+        """
+        return '\n'.join(f'{root};{func} {cnt}' for func, cnt in sorted(self._func_counts.items())) + '\n'
+
+    def save_collapsed(self, file_name: str, root: str = 'firmware') -> None:
+        with open(file_name, 'w') as f:
+            f.write(self.collapsed(root))
+
+
+# -------------------------------------------------------------------------------------------------
+class PcProfiler(object):
+    """
+    Statistical profiler which periodically samples the PC of the running target without halting it. The PC is
+    either sampled by reading the DWT program counter sample register (DWT_PCSR) via TargetDirect or taken from the
+    PC samples of a SWO capture (see SwoCapture with pc_sampling enabled). The samples are mapped to functions using
+    the host-side symbol index of the target binary.
+    """
+    DWT_PCSR = 0xe000101c
+
+    def __init__(self, live, symbols: BinarySymbols) -> None:
+        """
+        Constructor.
+
+        Args:
+            live: TargetDirect instance used to read DWT_PCSR (may be None if only SWO captures are profiled).
+            symbols: Symbol index of the target binary (e.g., dott().target.symbols).
+        """
+        self._live = live
+        self._symbols: BinarySymbols = symbols
+
+    def sample(self, duration: float = 1.0, rate: float = None) -> PcProfile:
+        """
+        Samples DWT_PCSR for the given duration (the target has to be running) and returns the profile.
+
+        Args:
+            duration: Sampling duration in seconds.
+            rate: Sampling rate in Hz. If None, the PC is sampled as fast as the probe allows.
+
+        Returns: The profile.
+        """
+        samples = self._live.sample([PcProfiler.DWT_PCSR], rate=rate, duration=duration)
+        return PcProfile(samples.values(0), self._symbols)
+
+    def from_swo(self, swo) -> PcProfile:
+        """
+        Returns the profile built from (and consumes) the PC samples received so far by the given SWO capture.
+        """
+        return PcProfile([pc for _, _, pc in swo.pc_samples.read_all()], self._symbols)
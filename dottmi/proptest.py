@@ -0,0 +1,213 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Property-based testing of firmware functions with Hypothesis. The strategies for the arguments of the function under
+# test are derived from its parameter types as given by the debug information (integer ranges of the parameter sizes
+# and signedness, the enumerators of enum parameters, booleans). Hypothesis calls the property once per example;
+# executing each example on the target (one call via the call stub each) would limit a property test to a few hundred
+# examples per second. Instead, the examples are generated up front (a run of the Hypothesis test which only records
+# the arguments) and executed in batches by the sweep engine (Target.sweep, one driver loop on the target per batch).
+# The actual Hypothesis run then checks the property with the cached results. Examples not in the cache (the
+# candidates tried while shrinking a failing example) are executed together with their simpler neighbours in one
+# sweep; hence, shrinking mostly runs on the host as well. For example:
+#
+#   prop = PropertyTest(dt, 'example_Addition')
+#   prop.check(lambda a, b, ret: ret == (a + b) & 0xffffffff, max_examples=20000)
+#   prop = PropertyTest(dt, 'example_Clamp', strategies=[None, st.integers(0, 100)])  # explicit argument strategy
+#
+# Note: The function under test has to be callable with Target.sweep (up to four integer arguments, integer return
+# value) and must not depend on state changed by previous calls (the results are cached per argument tuple).
+# Hypothesis has to be installed (pip install hypothesis).
+
+import time
+from typing import Callable, Dict, Iterable, List, Sequence, Tuple
+
+from hypothesis import HealthCheck, Phase, given, settings
+from hypothesis import strategies as st
+from hypothesis.strategies import SearchStrategy
+
+from dottmi.dottexceptions import DottException
+from dottmi.type_layout import TypeLayout
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+def type_strategy(layout: TypeLayout) -> Tuple[SearchStrategy, Tuple[int, int]]:
+    """
+    Returns the strategy for values of the given (integer, enum or bool) target type and the value range of integer
+    types (None for enums and bools). A DottException is raised for types which cannot be drawn automatically (e.g.,
+    pointers, structs, 64 bit integers or floating point values).
+    """
+    if layout.kind != 'int' or layout.size > 4 or layout.type.rstrip().endswith('*'):
+        raise DottException(f'No strategy for parameters of type {layout.type}; an explicit strategy is required.')
+    if layout.values is not None and len(layout.values) > 0:
+        return st.sampled_from(sorted(set(layout.values))), None
+    if layout.type in ('bool', '_Bool'):
+        return st.booleans().map(int), None
+    bits = layout.size * 8
+    lo, hi = (-(1 << (bits - 1)), (1 << (bits - 1)) - 1) if layout.signed else (0, (1 << bits) - 1)
+    return st.integers(lo, hi), (lo, hi)
+
+
+def func_strategies(target: 'Target', func: str) -> List[SearchStrategy]:
+    """
+    Returns the argument strategies of the given function derived from its parameter types (see type_strategy).
+    """
+    return [type_strategy(p)[0] for p in _func_layout(target, func).params]
+
+
+def _func_layout(target: 'Target', func: str) -> TypeLayout:
+    layout = target.mem.type_layout(f'__typeof__({func})')
+    if layout.kind != 'func':
+        raise DottException(f'{func} is not a function.')
+    return layout
+
+
+# -------------------------------------------------------------------------------------------------
+class PropertyTest(object):
+    """
+    Batched property-based test of a target function (see module description).
+    """
+    def __init__(self, target: 'Target', func: str, strategies: Sequence[SearchStrategy] = None,
+                 batch_size: int = 1024, timeout: float = None) -> None:
+        """
+        Constructor.
+
+        Args:
+            target: Target (halted, with the scratch memory of the test initialized).
+            func: Name of the function under test.
+            strategies: Strategy per argument; None (or None entries) selects the strategy derived from the parameter
+                        type.
+            batch_size: Maximum number of examples executed with one sweep.
+            timeout: Time (in seconds) to wait for each sweep to complete.
+        """
+        self._dt: 'Target' = target
+        self._func: str = func
+        self._batch_size: int = batch_size
+        self._timeout: float = timeout
+        layout = _func_layout(target, func)
+        params = layout.params
+        if len(params) > 4:
+            raise DottException(f'{func} has more than four parameters (see Target.sweep).')
+        if strategies is not None and len(strategies) != len(params):
+            raise DottException(f'{func} has {len(params)} parameters but {len(strategies)} strategies were given.')
+        self._signed: bool = layout.ret is not None and layout.ret.signed
+        self._strategies: List[SearchStrategy] = []
+        self._ranges: List[Tuple[int, int]] = []  # value ranges of derived integer strategies (shrink neighbours)
+        for i, param in enumerate(params):
+            if strategies is not None and strategies[i] is not None:
+                self._strategies.append(strategies[i])
+                self._ranges.append(None)
+            else:
+                strategy, value_range = type_strategy(param)
+                self._strategies.append(strategy)
+                self._ranges.append(value_range)
+        self._results: Dict[Tuple[int, ...], int] = {}  # argument tuple -> return value
+        self._stats: Dict[str, float] = {'examples': 0, 'executed': 0, 'sweeps': 0, 'target_secs': 0.0}
+
+    @property
+    def strategies(self) -> List[SearchStrategy]:
+        return list(self._strategies)
+
+    @property
+    def stats(self) -> Dict[str, float]:
+        """
+        Counters of the checks so far: examples (checked by Hypothesis), executed (examples executed on the target),
+        sweeps and target_secs (time spent in sweeps).
+        """
+        return dict(self._stats)
+
+    def execute(self, rows: Iterable[Tuple[int, ...]]) -> None:
+        """
+        Executes the given argument tuples which are not cached yet in batches on the target and caches the results.
+        """
+        pending = list(dict.fromkeys(tuple(r) for r in rows if tuple(r) not in self._results))
+        for start in range(0, len(pending), self._batch_size):
+            chunk = pending[start:start + self._batch_size]
+            t = time.perf_counter()
+            res = self._dt.sweep(self._func, chunk, self._signed, self._timeout)
+            self._stats['target_secs'] += time.perf_counter() - t
+            self._stats['sweeps'] += 1
+            self._stats['executed'] += len(chunk)
+            self._results.update(zip(chunk, res))
+
+    def result(self, *args: int) -> int:
+        """
+        Returns the return value of the function for the given arguments. Executes the arguments (and their simpler
+        neighbours, which are likely to be tried next while shrinking) on the target if they are not cached.
+        """
+        if args not in self._results:
+            self.execute([args] + self._neighbours(args))
+        return self._results[args]
+
+    def _neighbours(self, args: Tuple[int, ...]) -> List[Tuple[int, ...]]:
+        # simpler variants of the arguments (each argument moved towards zero, the range bound closest to zero if zero
+        # is out of range) in the order Hypothesis' integer shrinking tends to try them
+        res: List[Tuple[int, ...]] = []
+        simplest = list(args)
+        for i, value in enumerate(args):
+            if self._ranges[i] is None:
+                continue
+            lo, hi = self._ranges[i]
+            target = min(max(0, lo), hi)
+            simplest[i] = target
+            for cand in (target, target + (value - target) // 2, value - 1 if value > target else value + 1, -value):
+                if lo <= cand <= hi and cand != value:
+                    res.append(args[:i] + (cand,) + args[i + 1:])
+        res.append(tuple(simplest))
+        return res
+
+    def _settings(self, max_examples: int, phases: List[Phase]) -> settings:
+        # note: derandomized such that the checking run draws the examples generated by the recording run
+        return settings(max_examples=max_examples, derandomize=True, database=None, deadline=None, phases=phases,
+                        suppress_health_check=list(HealthCheck))
+
+    def check(self, prop: Callable[..., bool], max_examples: int = 1000) -> None:
+        """
+        Checks the given property for max_examples examples. The property is called with the arguments and the return
+        value of the function and returns False (or raises an AssertionError) if the property does not hold. A failing
+        example is shrunk by Hypothesis which then raises the failure for the minimal example found.
+        """
+        start = time.perf_counter()
+        rows: List[Tuple[int, ...]] = []
+
+        def record(args):
+            rows.append(tuple(int(a) for a in args))
+
+        # note: the arguments are drawn as one tuple (given does not support functions with variable arguments)
+        args_strategy = st.tuples(*self._strategies)
+        with self._dt.call_session():
+            self._settings(max_examples, [Phase.explicit, Phase.generate])(given(args_strategy)(record))()
+            self.execute(rows)
+
+            def run(args):
+                self._stats['examples'] += 1
+                args = tuple(int(a) for a in args)
+                ret = self.result(*args)
+                res = prop(*args, ret)
+                assert res is None or res, f'{self._func}{args} returned {ret}'
+
+            try:
+                phases = [Phase.explicit, Phase.generate, Phase.shrink]
+                self._settings(max_examples, phases)(given(args_strategy)(run))()
+            finally:
+                log.debug(f'PropertyTest {self._func}: {self._stats["examples"]} examples checked, '
+                          f'{self._stats["executed"]} executed on the target in {self._stats["sweeps"]} sweeps '
+                          f'({self._stats["target_secs"]:.2f}s of {time.perf_counter() - start:.2f}s).')
@@ -18,16 +18,23 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import array
+import contextlib
 import logging
 import os
 import tempfile
-from typing import List
+import threading
+import time
+from typing import Callable, Dict, Iterator, List, NamedTuple, Tuple, Union
 
 import pylink
 from pylink import JLink
 
 from dottmi.dott import DottConf
 from dottmi.dottexceptions import DottException
+from dottmi.swo import SwoCapture
+from dottmi.timeline import timeline
+from dottmi.utils import log
 
 
 class _JlinkDott(JLink):
@@ -59,17 +66,572 @@ class _JlinkDott(JLink):
 
 
 # -------------------------------------------------------------------------------------------------
-class TargetDirect(object):
-    def __init__(self, device_name: str):
-        jlink_ip_addr = DottConf.get('jlink_server_addr')
-        jlink_port = DottConf.get('jlink_server_port')
-        jlink_serial = DottConf.get('jlink_serial')
+class WaitResult(NamedTuple):
+    time: float  # time (time.perf_counter) at which the condition became true
+    window: float  # uncertainty of time (time between the last read before the condition held and the first after)
+    value: int  # the (unmasked) 32bit value which satisfied the condition
+    polls: int  # number of reads
 
-        jlink_addr_port = f'{jlink_ip_addr}:{jlink_port}' if jlink_ip_addr is not None else None
 
+def poll_until(read_32: Callable[[int], int], addr: int, mask: int, value: int, timeout: float) -> WaitResult:
+    """
+    Reads the 32bit word at addr with read_32 in a tight loop until (word & mask) == value. Each read is timestamped
+    with the middle of its transaction; the condition became true between the last non-matching read and the first
+    matching one. If the condition already held at the first read, window is 0.
+
+    Raises:
+        DottException: If the condition did not become true within timeout seconds.
+    """
+    deadline = time.perf_counter() + timeout
+    t_prev: float = None
+    polls = 0
+    while True:
+        t_start = time.perf_counter()
+        word = read_32(addr)
+        t_now = (t_start + time.perf_counter()) / 2
+        polls += 1
+        if word & mask == value:
+            if t_prev is None:
+                return WaitResult(t_now, 0.0, word, polls)
+            return WaitResult((t_prev + t_now) / 2, t_now - t_prev, word, polls)
+        if t_now > deadline:
+            raise DottException(f'Condition (*0x{addr:x} & 0x{mask:x}) == 0x{value:x} did not become true within '
+                                f'{timeout} seconds (last value: 0x{word:x}).')
+        t_prev = t_now
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetDirectSamples(object):
+    """
+    Samples acquired by TargetDirect.sample. The samples are stored in preallocated ring buffers. If more samples are
+    acquired than fit into the buffers, the oldest samples are overwritten. If a file name is given, the buffers are
+    a memory-mapped file (numpy.memmap) instead of host memory: capacity timestamps (float64) followed by capacity
+    records of one uint32 value per address (see load).
+    """
+    def __init__(self, addrs: List[int], capacity: int, file_name: str = None) -> None:
+        self._addrs: List[int] = addrs
+        self._capacity: int = capacity
+        self._file_name: str = file_name
+        if file_name is None:
+            self._times = array.array('d', bytes(8 * capacity))
+            self._values = array.array('I', bytes(4 * capacity * len(addrs)))
+        else:
+            self._times, self._values = TargetDirectSamples._map(file_name, capacity, len(addrs), 'w+')
+        self._count: int = 0  # total number of samples acquired (including overwritten ones)
+        self._thread: threading.Thread = None
+        self._stop: threading.Event = threading.Event()
+        self._exception: Exception = None
+
+    def _append(self, timestamp: float, values: List[int]) -> None:
+        pos = self._count % self._capacity
+        self._times[pos] = timestamp
+        self._values[pos * len(self._addrs):(pos + 1) * len(self._addrs)] = array.array('I', values)
+        self._count += 1
+
+    @staticmethod
+    def _map(file_name: str, capacity: int, width: int, mode: str) -> Tuple:
+        import numpy  # note: numpy is only required if samples are written to a file
+        if mode == 'w+':
+            with open(file_name, 'wb') as f:
+                f.truncate((8 + 4 * width) * capacity)
+            mode = 'r+'
+        times = numpy.memmap(file_name, dtype='<f8', mode=mode, shape=(capacity,))
+        values = numpy.memmap(file_name, dtype='<u4', mode=mode, offset=8 * capacity, shape=(capacity * width,))
+        return times, values
+
+    @staticmethod
+    def load(file_name: str, num_addrs: int) -> Tuple:
+        """
+        Opens the sample file of a sampling run (see TargetDirect.sample) read-only without loading it into memory.
+
+        Returns:
+            The timestamps (shape: capacity) and the values (shape: capacity x num_addrs) as memory-mapped numpy
+            arrays. Entries which have not been written are zero; if the ring buffer wrapped, the oldest sample is
+            located right after the one with the largest timestamp.
+        """
+        import os
+        capacity = os.path.getsize(file_name) // (8 + 4 * num_addrs)
+        times, values = TargetDirectSamples._map(file_name, capacity, num_addrs, 'r')
+        return times, values.reshape(capacity, num_addrs)
+
+    def _flush(self) -> None:
+        if self._file_name is not None:
+            self._times.flush()
+            self._values.flush()
+
+    def _order(self) -> List[int]:
+        # buffer positions of the available samples (oldest first)
+        num = min(self._count, self._capacity)
+        start = self._count - num
+        return [(start + i) % self._capacity for i in range(num)]
+
+    @property
+    def addrs(self) -> List[int]:
+        return self._addrs
+
+    @property
+    def count(self) -> int:
+        """
+        Number of samples available (i.e., not yet overwritten).
+        """
+        return min(self._count, self._capacity)
+
+    @property
+    def dropped(self) -> int:
+        """
+        Number of samples which were overwritten because the ring buffer was full.
+        """
+        return max(0, self._count - self._capacity)
+
+    @property
+    def running(self) -> bool:
+        return self._thread is not None and self._thread.is_alive()
+
+    def timestamps(self) -> List[float]:
+        """
+        Host timestamps (in seconds, relative to the start of the sampling) of the available samples.
+        """
+        return [self._times[pos] for pos in self._order()]
+
+    def values(self, idx: int = 0) -> List[int]:
+        """
+        Sampled values of the idx-th address passed to TargetDirect.sample.
+        """
+        return [int(self._values[pos * len(self._addrs) + idx]) for pos in self._order()]
+
+    def to_numpy(self) -> Tuple:
+        """
+        Returns the timestamps (shape: count) and the values (shape: count x number of addresses) as numpy arrays.
+        As long as the ring buffer did not wrap, the arrays are views of the buffers (i.e., of the memory-mapped
+        file if samples are written to a file) instead of copies.
+        """
+        import numpy  # note: numpy is only required if this function is used
+        times = numpy.frombuffer(self._times, dtype=numpy.float64)
+        values = numpy.frombuffer(self._values, dtype=numpy.uint32).reshape(self._capacity, len(self._addrs))
+        if self._count <= self._capacity:
+            return times[:self._count], values[:self._count]
+        order = self._order()
+        return times[order], values[order]
+
+    def since(self, count: int) -> Tuple[int, List[Tuple[float, List[int]]]]:
+        """
+        Returns the samples acquired after the first count samples (e.g., while the sampling is still running).
+        Samples which have already been overwritten are skipped.
+
+        Returns: Tuple of the total number of samples acquired so far (to be passed to the next call) and the list of
+                 new samples as (timestamp, values).
+        """
+        total = self._count  # note: _append increments the count after the sample has been written
+        width = len(self._addrs)
+        new = []
+        for i in range(max(count, total - self._capacity), total):
+            pos = i % self._capacity
+            new.append((self._times[pos], self._values[pos * width:(pos + 1) * width].tolist()))
+        return total, new
+
+    def stop(self) -> None:
+        """
+        Stops the sampling (before the requested duration has elapsed).
+        """
+        self._stop.set()
+        self.wait()
+
+    def wait(self, timeout: float = None) -> None:
+        """
+        Waits until the sampling is completed. Exceptions raised by the sampling thread are re-raised.
+        """
+        if self._thread is not None:
+            self._thread.join(timeout)
+        if self._exception is not None:
+            raise self._exception
+
+
+# -------------------------------------------------------------------------------------------------
+class IrqInjection(object):
+    """
+    Interrupt injection run of TargetDirect.irq_inject. For every injection, the planned and the achieved time
+    (host timestamps relative to the start of the run) are recorded. An injection is counted as overrun if the
+    interrupt was still pending from a previous injection (i.e., the firmware did not keep up with the rate).
+    """
+    def __init__(self, schedule: List[Tuple[float, int]]) -> None:
+        self._schedule: List[Tuple[float, int]] = schedule
+        self._actual: array.array = array.array('d', bytes(8 * len(schedule)))
+        self._count: int = 0
+        self._overruns: int = 0
+        self._thread: threading.Thread = None
+        self._stop: threading.Event = threading.Event()
+        self._exception: Exception = None
+
+    @property
+    def count(self) -> int:
+        """
+        Number of interrupts injected so far.
+        """
+        return self._count
+
+    @property
+    def overruns(self) -> int:
+        return self._overruns
+
+    @property
+    def running(self) -> bool:
+        return self._thread is not None and self._thread.is_alive()
+
+    def planned(self) -> List[float]:
+        return [t for t, _ in self._schedule[:self._count]]
+
+    def actual(self) -> List[float]:
+        return self._actual[:self._count].tolist()
+
+    def lateness(self) -> List[float]:
+        """
+        Delay (in seconds) of each injection relative to its planned time.
+        """
+        return [a - p for a, p in zip(self.actual(), self.planned())]
+
+    def report(self) -> Dict:
+        """
+        Returns the achieved timing: number of injections, overruns, achieved rate (Hz) and the mean, 99th
+        percentile and maximum lateness (in microseconds).
+        """
+        late = sorted(self.lateness())
+        if len(late) == 0:
+            return {'count': 0, 'overruns': 0, 'rate': 0.0, 'mean_us': 0.0, 'p99_us': 0.0, 'max_us': 0.0}
+        actual = self.actual()
+        span = actual[-1] - actual[0]
+        return {'count': self._count, 'overruns': self._overruns,
+                'rate': (len(actual) - 1) / span if span > 0 else 0.0,
+                'mean_us': sum(late) / len(late) * 1e6, 'p99_us': late[min(len(late) - 1, int(len(late) * .99))] * 1e6,
+                'max_us': late[-1] * 1e6}
+
+    def __str__(self) -> str:
+        rep = self.report()
+        return (f'{rep["count"]} interrupts injected at {rep["rate"]:.1f} Hz ({rep["overruns"]} overruns), lateness: '
+                f'mean {rep["mean_us"]:.0f} us, p99 {rep["p99_us"]:.0f} us, max {rep["max_us"]:.0f} us')
+
+    def stop(self) -> None:
+        """
+        Stops the injection (before the schedule has been completed).
+        """
+        self._stop.set()
+        self.wait()
+
+    def wait(self, timeout: float = None) -> None:
+        """
+        Waits until the schedule is completed. Exceptions raised by the injection thread are re-raised.
+        """
+        if self._thread is not None:
+            self._thread.join(timeout)
+        if self._exception is not None:
+            raise self._exception
+
+
+# -------------------------------------------------------------------------------------------------
+class StreamInjection(object):
+    """
+    Streaming run of TargetDirect.stream_inject. Records the number of bytes written into the target's ring buffer and
+    the number of stalls (the buffer was full, i.e., the firmware did not consume the data fast enough).
+    """
+    def __init__(self, num_bytes: int) -> None:
+        self._num_bytes: int = num_bytes
+        self._sent: int = 0
+        self._stalls: int = 0
+        self._time_start: float = None
+        self._time_end: float = None
+        self._thread: threading.Thread = None
+        self._stop: threading.Event = threading.Event()
+        self._exception: Exception = None
+
+    @property
+    def sent(self) -> int:
+        """
+        Number of bytes written into the ring buffer so far.
+        """
+        return self._sent
+
+    @property
+    def stalls(self) -> int:
+        return self._stalls
+
+    @property
+    def complete(self) -> bool:
+        return self._sent == self._num_bytes
+
+    @property
+    def running(self) -> bool:
+        return self._thread is not None and self._thread.is_alive()
+
+    def throughput(self) -> float:
+        """
+        Achieved throughput (in bytes/s).
+        """
+        if self._time_start is None:
+            return 0.0
+        span = (self._time_end if self._time_end is not None else time.perf_counter()) - self._time_start
+        return self._sent / span if span > 0 else 0.0
+
+    def __str__(self) -> str:
+        return (f'{self._sent} of {self._num_bytes} bytes injected at {self.throughput() / 1024:.1f} KiB/s '
+                f'({self._stalls} stalls)')
+
+    def stop(self) -> None:
+        """
+        Stops the injection (before all data has been written).
+        """
+        self._stop.set()
+        self.wait()
+
+    def wait(self, timeout: float = None) -> None:
+        """
+        Waits until all data has been written. Exceptions raised by the injection thread are re-raised.
+        """
+        if self._thread is not None:
+            self._thread.join(timeout)
+        if self._exception is not None:
+            raise self._exception
+
+
+# -------------------------------------------------------------------------------------------------
+class ConsistentRead(object):
+    """
+    Background read of TargetDirect.read_consistent. Holds the data read so far, the number of retried block reads
+    and whether a consistent state of the region was captured.
+    """
+    def __init__(self, num_bytes: int) -> None:
+        self._num_bytes: int = num_bytes
+        self._data: bytes = None
+        self._retries: int = 0
+        self._consistent: bool = False
+        self._thread: threading.Thread = None
+        self._exception: Exception = None
+
+    @property
+    def data(self) -> bytes:
+        """
+        Content of the region (None if the read has not finished yet).
+        """
+        return self._data
+
+    @property
+    def retries(self) -> int:
+        """
+        Number of blocks (or, in sequence counter mode, of entire passes) which had to be read again.
+        """
+        return self._retries
+
+    @property
+    def consistent(self) -> bool:
+        return self._consistent
+
+    @property
+    def running(self) -> bool:
+        return self._thread is not None and self._thread.is_alive()
+
+    def wait(self, timeout: float = None) -> bytes:
+        """
+        Waits until the read has finished and returns the data. Exceptions raised by the read thread are re-raised.
+        """
+        if self._thread is not None:
+            self._thread.join(timeout)
+        if self._exception is not None:
+            raise self._exception
+        return self._data
+
+
+# -------------------------------------------------------------------------------------------------
+class ProbeBroker(object):
+    """
+    Owns the (single) pylink connection to a debug probe which is shared by all TargetDirect instances (and hence by
+    live access, sampling, SWO and RTT) of the same probe and device. Accesses via the connection are serialized and
+    prioritized against the run-control operations (halt, continue, reset, download) which DOTT performs via the GDB
+    server: while a run-control operation is in progress, no new live accesses are started. After each run-control
+    operation or target state change (see Target.probe_broker), the connection's state is re-synchronized with the
+    hardware upon the next access.
+    Note: The J-Link GDB server uses its own connection to the probe which can not be shared with pylink.
+    """
+    _brokers: Dict[Tuple, 'ProbeBroker'] = {}
+    _brokers_lock: threading.Lock = threading.Lock()
+
+    def __init__(self, key: Tuple, device_name: str, jlink_serial, jlink_addr_port: str) -> None:
+        self._key: Tuple = key
         self._jlink = _JlinkDott()
         self._jlink.open(jlink_serial, jlink_addr_port)
         self._jlink.connect(device_name, verbose=False)
+        self._ref_count: int = 0
+        self._cv: threading.Condition = threading.Condition()
+        self._busy: bool = False  # a live access is in progress
+        self._control_pending: int = 0  # number of run-control operations waiting or in progress
+        self._epoch: int = 0  # incremented on every run-control operation and target state change
+        self._target = None
+
+    @staticmethod
+    def acquire(device_name: str, target=None, jlink_serial: str = None) -> 'ProbeBroker':
+        """
+        Returns the broker of the configured probe and the given device (the probe connection is established by
+        the first call). Each call has to be matched with a call to release().
+
+        Args:
+            device_name: Name of the target device (as used by J-Link).
+            target: The Target (GDB connection) using the same probe; it is coordinated with live accesses.
+            jlink_serial: Serial number of the probe. Default: jlink_serial of the DOTT configuration.
+        """
+        jlink_ip_addr = DottConf.get('jlink_server_addr')
+        jlink_port = DottConf.get('jlink_server_port')
+        if jlink_serial is None:
+            jlink_serial = DottConf.get('jlink_serial')
+        jlink_addr_port = f'{jlink_ip_addr}:{jlink_port}' if jlink_ip_addr is not None else None
+
+        key = (jlink_serial, jlink_addr_port, device_name)
+        with ProbeBroker._brokers_lock:
+            broker = ProbeBroker._brokers.get(key)
+            if broker is None:
+                broker = ProbeBroker(key, device_name, jlink_serial, jlink_addr_port)
+                ProbeBroker._brokers[key] = broker
+            broker._ref_count += 1
+        if target is not None and broker._target is None:
+            broker._target = target
+            target.probe_broker = broker
+        return broker
+
+    def release(self) -> None:
+        """
+        Releases the broker. The probe connection is closed once the broker is no longer used.
+        """
+        with ProbeBroker._brokers_lock:
+            self._ref_count -= 1
+            if self._ref_count > 0:
+                return
+            del ProbeBroker._brokers[self._key]
+        if self._target is not None and self._target.probe_broker is self:
+            self._target.probe_broker = None
+        self._jlink.close()
+
+    @property
+    def jlink(self) -> JLink:
+        return self._jlink
+
+    def ensure_connected(self) -> None:
+        """
+        Re-establishes the probe connection if it was lost (e.g., due to a power cycle of the target) and forces a
+        re-synchronization with the hardware upon the next access.
+        """
+        jlink_serial, jlink_addr_port, device_name = self._key
+        with self.access():
+            try:
+                connected = self._jlink.opened() and self._jlink.target_connected()
+            except Exception:
+                connected = False
+            if not connected:
+                log.warn('Live access connection to the target was lost. Reconnecting.')
+                try:
+                    self._jlink.close()
+                except Exception:
+                    pass
+                self._jlink.open(jlink_serial, jlink_addr_port)
+                self._jlink.connect(device_name, verbose=False)
+            self._epoch += 1
+
+    @property
+    def epoch(self) -> int:
+        return self._epoch
+
+    def state_changed(self) -> None:
+        """
+        Called if the target state was changed outside of the broker (e.g., a breakpoint was hit).
+        """
+        self._epoch += 1
+
+    @contextlib.contextmanager
+    def access(self) -> Iterator[JLink]:
+        """
+        Context manager for a (short) live access via the probe connection. Waits while a run-control operation is
+        pending.
+        """
+        with self._cv:
+            while self._busy or self._control_pending > 0:
+                self._cv.wait()
+            self._busy = True
+        try:
+            yield self._jlink
+        finally:
+            with self._cv:
+                self._busy = False
+                self._cv.notify_all()
+
+    @contextlib.contextmanager
+    def control(self) -> Iterator[None]:
+        """
+        Context manager for run-control operations performed via GDB. No new live accesses are started (and an
+        access in progress is completed) before the operation is performed.
+        """
+        with self._cv:
+            self._control_pending += 1
+            while self._busy:
+                self._cv.wait()
+        try:
+            yield
+        finally:
+            with self._cv:
+                self._control_pending -= 1
+                self._epoch += 1
+                self._cv.notify_all()
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetDirect(object):
+    # addresses closer than this (in bytes) are read in a single probe transaction (see mem_read_scatter)
+    SCATTER_MERGE_GAP = 64
+
+    def __init__(self, device_name: str, target=None, jlink_serial: str = None):
+        """
+        Creates a live access to the target. All instances for the same probe and device share a single probe
+        connection (see ProbeBroker).
+
+        Args:
+            device_name: Name of the target device (as used by J-Link).
+            target: The Target (GDB connection) of the device. If given, run-control operations of the target pause
+                    live accesses.
+            jlink_serial: Serial number of the probe. Default: jlink_serial of the DOTT configuration.
+        """
+        self._broker: ProbeBroker = ProbeBroker.acquire(device_name, target, jlink_serial)
+        self._jlink = self._broker.jlink
+        self._session_depth: int = 0
+        self._sync_epoch: int = -1  # broker epoch in which pylink's state was last synchronized
+        self._scatter_plans: Dict[Tuple[int, ...], Tuple] = {}
+
+    def resync(self) -> None:
+        """
+        This function re-synchronizes the live access with the target (reconnecting if the connection was lost). It is
+        called at the start of each test if the live access is shared across tests (see live_access fixture).
+        """
+        self._broker.ensure_connected()
+
+    def _sync(self) -> None:
+        # note: to be called while holding a broker access
+        if self._session_depth == 0 or self._sync_epoch != self._broker.epoch:
+            self._sync_epoch = self._broker.epoch
+            self._jlink.halted()  # no-op required to ensure that pylink's state is in sync with the hardware
+
+    @contextlib.contextmanager
+    def session(self) -> Iterator['TargetDirect']:
+        """
+        Context manager for streaming (e.g., monitoring) sessions. pylink's state is synchronized with the hardware
+        once when the session is entered. Within the session, reads are issued without the per-call synchronization
+        which halves the number of probe transactions. The state is re-synchronized if the target's run state changes
+        while the session is active (see ProbeBroker). Example:
+
+        with live_access.session():
+            for i in range(1000):
+                cnt, state = live_access.mem_read_scatter([cnt_addr, state_addr])
+        """
+        with self._broker.access():
+            self._sync_epoch = self._broker.epoch
+            self._jlink.halted()
+        self._session_depth += 1
+        try:
+            yield self
+        finally:
+            self._session_depth -= 1
 
     def mem_read_32(self, addr: int, cnt: int = 1) -> int:
         """
@@ -82,8 +644,9 @@ class TargetDirect(object):
         Returns: 32bit integer containing content read form target if cnt is 1, otherwise a list of 32bit integers
                  is returned.
         """
-        self._jlink.halted()  # no-op required to ensure that pylink's state is in sync with the hardware
-        ret = self._jlink.memory_read(addr, cnt, nbits=32)
+        with self._broker.access():
+            self._sync()
+            ret = self._jlink.memory_read(addr, cnt, nbits=32)
         return ret[0] if len(ret) > 0 else ret
 
     def mem_write_32(self, addr: int, data: List) -> int:
@@ -96,14 +659,504 @@ class TargetDirect(object):
         Returns: The number of 32bit words written.
 
         """
-        ret = self._jlink.memory_write(addr, data, nbits=32)
+        with self._broker.access():
+            ret = self._jlink.memory_write(addr, data, nbits=32)
         return ret  # number of units written
 
+    def mem_read(self, addr: int, num_bytes: int) -> bytes:
+        """
+        This function reads a block of target memory (byte-wise access).
+
+        Args:
+            addr: Target memory address to read from.
+            num_bytes: Number of bytes to be read from the target.
+
+        Returns: The bytes read from the target.
+        """
+        with self._broker.access():
+            self._sync()
+            return bytes(self._jlink.memory_read8(addr, num_bytes))
+
+    def mem_write(self, addr: int, data: bytes) -> int:
+        """
+        This function writes a block of target memory (byte-wise access).
+
+        Args:
+            addr: Target memory address to write to.
+            data: Bytes to be written to the target starting at the provided address.
+
+        Returns: The number of bytes written.
+        """
+        with self._broker.access():
+            self._sync()
+            return self._jlink.memory_write8(addr, list(data))
+
+    def _scatter_plan(self, addrs: List[int]) -> Tuple:
+        # groups the addresses into spans which are read with a single transaction each; plans are cached per
+        # address list since monitoring loops typically read the same addresses over and over again
+        key = tuple(addrs)
+        if key not in self._scatter_plans:
+            spans: List[List[int]] = []  # [start address, number of words]
+            for addr in sorted(set(addrs)):
+                if len(spans) > 0 and addr - (spans[-1][0] + 4 * spans[-1][1]) <= TargetDirect.SCATTER_MERGE_GAP:
+                    spans[-1][1] = (addr - spans[-1][0]) // 4 + 1
+                else:
+                    spans.append([addr, 1])
+            index = [next((i, (addr - start) // 4) for i, (start, num) in enumerate(spans)
+                          if start <= addr < start + 4 * num) for addr in addrs]
+            self._scatter_plans[key] = ([tuple(span) for span in spans], index)
+        return self._scatter_plans[key]
+
+    def mem_read_scatter(self, addrs: List[int]) -> List[int]:
+        """
+        This function reads multiple (not necessarily contiguous) 32bit words from target memory while the target
+        is running. Addresses located close to each other (see SCATTER_MERGE_GAP) are read with a single probe
+        transaction. Hence, monitoring variables which are located in the same memory area (e.g., in .bss) costs a
+        single transaction per sample.
+
+        Args:
+            addrs: Target memory addresses (32bit aligned) to read from.
+
+        Returns: List of 32bit integers containing the content of the given addresses (in the given order).
+        """
+        spans, index = self._scatter_plan(addrs)
+        with self._broker.access():
+            self._sync()
+            span_data = [self._jlink.memory_read32(start, num) for start, num in spans]
+        return [span_data[span][word] for span, word in index]
+
+    def wait_until(self, addr: int, mask: int, value: int, timeout: float = 1.0) -> WaitResult:
+        """
+        This function waits (while the target is running) until the 32bit word at addr satisfies
+        (word & mask) == value. The word is polled with back-to-back probe transactions within a live access session
+        (i.e., without per-read synchronization). The polling loop releases the probe between reads such that
+        run-control operations are not blocked. See poll_until.
+
+        Returns: The time at which the condition became true (see WaitResult).
+        """
+        def read_32(a: int) -> int:
+            with self._broker.access():
+                self._sync()
+                return self._jlink.memory_read32(a, 1)[0]
+
+        with self.session():
+            return poll_until(read_32, addr, mask, value, timeout)
+
+    def read_consistent(self, addr: int, num_bytes: int, seq_addr: int = None, block_size: int = 1024,
+                        max_retries: int = 16, block: bool = True) -> ConsistentRead:
+        """
+        This function reads a (large) memory region which is modified by the running firmware (e.g., a DMA or sample
+        buffer) such that the data is not torn. The region is read in blocks by a background thread (the probe is
+        released between blocks). Two protocols are supported:
+        - Sequence counter (seq_addr given): the firmware brackets modifications of the region with
+          DOTT_SEQ_WRITE_BEGIN/DOTT_SEQ_WRITE_END (testhelpers.h). The read is consistent if the counter was even
+          and did not change while the region was read; otherwise the region is read again.
+        - Double read (default): each block is read again until two consecutive reads agree. Only the blocks which
+          changed are retried. Each block is consistent on its own (choose block_size according to the firmware's
+          update granularity, e.g., the size of a DMA half-buffer).
+        Example:
+
+        res = live_access.read_consistent(adc_buf_addr, 8192, seq_addr=adc_seq_addr)
+        assert res.consistent
+
+        Args:
+            addr: Start address of the region.
+            num_bytes: Size of the region in bytes.
+            seq_addr: Address of the firmware's 32bit sequence counter (see DOTT_SEQ_WRITE_BEGIN).
+            block_size: Number of bytes read per probe transaction.
+            max_retries: Maximum number of retries (passes in sequence counter mode) before giving up.
+            block: If True, this function returns once the read has finished. Otherwise, it returns immediately.
+
+        Returns: Read object whose data is set once the read has finished (see ConsistentRead.wait).
+        """
+        res = ConsistentRead(num_bytes)
+        blocks = [(offset, min(block_size, num_bytes - offset)) for offset in range(0, num_bytes, block_size)]
+
+        def read_blocks(indices: List[int]) -> Dict[int, bytes]:
+            return {i: self.mem_read(addr + blocks[i][0], blocks[i][1]) for i in indices}
+
+        def read_loop() -> None:
+            try:
+                with self.session():
+                    if seq_addr is not None:
+                        data = None
+                        for attempt in range(max_retries + 1):
+                            res._retries = attempt
+                            seq = self.mem_read_32(seq_addr)
+                            if seq % 2 != 0:
+                                continue  # the firmware is modifying the region
+                            data = read_blocks(list(range(len(blocks))))
+                            if self.mem_read_32(seq_addr) == seq:
+                                res._consistent = True
+                                break
+                    else:
+                        data = read_blocks(list(range(len(blocks))))
+                        pending = list(range(len(blocks)))
+                        for _ in range(max_retries + 1):
+                            again = read_blocks(pending)
+                            pending = [i for i in pending if again[i] != data[i]]
+                            data.update(again)
+                            if len(pending) == 0:
+                                res._consistent = True
+                                break
+                            res._retries += len(pending)
+                    if data is not None:
+                        res._data = b''.join(data[i] for i in range(len(blocks)))
+                if not res._consistent:
+                    log.warn(f'No consistent read of 0x{addr:x} ({num_bytes} bytes) after {max_retries} retries.')
+            except Exception as ex:
+                res._exception = ex
+
+        res._thread = threading.Thread(target=read_loop, name='TargetDirectConsistentRead', daemon=True)
+        res._thread.start()
+        if block:
+            res.wait()
+        return res
+
+    def sample(self, addrs: List[int], rate: float = None, duration: float = 1.0, capacity: int = None,
+               block: bool = True, file_name: str = None) -> TargetDirectSamples:
+        """
+        This function periodically samples the given 32bit target memory locations while the target is running. The
+        sampling is done by a background thread. Addresses located close to each other are read in a single probe
+        transaction. The samples are timestamped and stored in a preallocated ring buffer. Example:
+
+        samples = live_access.sample([cnt_addr, state_addr], duration=2.0)
+        plot(samples.timestamps(), samples.values(0))
+
+        Args:
+            addrs: Target memory addresses (32bit aligned) to be sampled.
+            rate: Sampling rate in Hz. If None, the target is sampled as fast as possible.
+            duration: Sampling duration in seconds. If None, the sampling runs until stop() is called on the returned
+                      object.
+            capacity: Number of samples the ring buffer can hold. Default: rate * duration or 100000 if the rate or
+                      the duration is not given.
+            block: If True, this function returns once the sampling is completed. Otherwise, it returns immediately.
+            file_name: If given, the ring buffer is a memory-mapped file (requires numpy) such that long captures do
+                       not have to fit into host memory (see TargetDirectSamples.load).
+
+        Returns: Samples object which is filled with samples by the sampling thread.
+        """
+        if capacity is None:
+            capacity = int(rate * duration) + 1 if rate is not None and duration is not None else 100000
+
+        samples = TargetDirectSamples(list(addrs), capacity, file_name)
+
+        def sample_loop() -> None:
+            try:
+                with self.session():
+                    self._sample_loop(samples, rate, duration)
+            except Exception as ex:
+                samples._exception = ex
+            finally:
+                samples._flush()
+
+        samples._thread = threading.Thread(target=sample_loop, name='TargetDirectSampler', daemon=True)
+        samples._thread.start()
+        if block:
+            samples.wait()
+        return samples
+
+    def _sample_loop(self, samples: TargetDirectSamples, rate: float, duration: float) -> None:
+        period = 1.0 / rate if rate is not None else 0.0
+        time_start = time.perf_counter()
+        next_time = time_start
+        while not samples._stop.is_set():
+            now = time.perf_counter()
+            if duration is not None and now - time_start >= duration:
+                break
+            if now < next_time:
+                time.sleep(next_time - now)
+                now = time.perf_counter()
+            values = self.mem_read_scatter(samples.addrs)
+            samples._append(now - time_start, values)
+            if timeline.enabled:
+                timeline.counter('live samples', {f'0x{addr:08x}': val for addr, val in zip(samples.addrs, values)})
+            next_time += period
+
+    # NVIC interrupt set-pending registers (one bit per interrupt)
+    NVIC_ISPR = 0xE000E200
+
+    # remaining wait time (in seconds) below which the injection thread spins instead of sleeping
+    _IRQ_SPIN_SEC = 0.002
+
+    def irq_inject(self, irqs: Union[int, List[Tuple[float, int]]], rate: float = None, count: int = None,
+                   check_pending: bool = True, block: bool = True) -> IrqInjection:
+        """
+        This function pends NVIC interrupts (ISPR writes via the probe) on a schedule while the target is running. The
+        injection is done by a background thread which sleeps until shortly before each injection and then spins
+        such that the injections are issued at the planned times (within the latency of one probe transaction).
+        Example:
+
+        inj = live_access.irq_inject(18, rate=1000, count=5000)  # TIM7 (IRQ 18 on STM32F072) at 1 kHz
+        log.info(str(inj))
+
+        Args:
+            irqs: Interrupt number for a periodic injection (see rate and count) or schedule given as list of
+                  (time in seconds relative to the start, interrupt number).
+            rate: Rate (in Hz) of a periodic injection.
+            count: Number of injections of a periodic injection.
+            check_pending: If True, each injection first checks whether the interrupt is still pending (overrun).
+                           This costs one additional probe transaction per injection.
+            block: If True, this function returns once the schedule is completed. Otherwise, it returns immediately.
+
+        Returns: Injection object with the achieved timing.
+        """
+        if isinstance(irqs, int):
+            if rate is None or count is None:
+                raise DottException('Periodic interrupt injection requires rate and count.')
+            schedule = [(i / rate, irqs) for i in range(count)]
+        else:
+            schedule = sorted(irqs)
+        injection = IrqInjection(schedule)
+
+        def inject_loop() -> None:
+            try:
+                with self.session():
+                    self._irq_inject_loop(injection, check_pending)
+            except Exception as ex:
+                injection._exception = ex
+
+        injection._thread = threading.Thread(target=inject_loop, name='TargetDirectIrqInjector', daemon=True)
+        injection._thread.start()
+        if block:
+            injection.wait()
+        return injection
+
+    def _irq_inject_loop(self, injection: IrqInjection, check_pending: bool) -> None:
+        time_start = time.perf_counter()
+        for planned, irq in injection._schedule:
+            while not injection._stop.is_set():
+                remaining = planned - (time.perf_counter() - time_start)
+                if remaining <= 0:
+                    break
+                if remaining > TargetDirect._IRQ_SPIN_SEC:
+                    time.sleep(remaining - TargetDirect._IRQ_SPIN_SEC)
+            if injection._stop.is_set():
+                break
+            reg, bit = TargetDirect.NVIC_ISPR + 4 * (irq // 32), 1 << (irq % 32)
+            with self._broker.access():
+                self._sync()
+                if check_pending and self._jlink.memory_read32(reg, 1)[0] & bit:
+                    injection._overruns += 1
+                self._jlink.memory_write32(reg, [bit])
+            injection._actual[injection._count] = time.perf_counter() - time_start
+            injection._count += 1
+
+    # size (in bytes) of the head and tail indices in front of the ring buffer (see DOTT_stream_t in testhelpers.h)
+    _STREAM_HDR_SIZE = 8
+
+    # wait time (in seconds) before the tail index is polled again if the ring buffer is full
+    _STREAM_STALL_SEC = 0.0005
+
+    def stream_inject(self, data: bytes, addr: int = None, size: int = None, chunk: int = 1024,
+                      timeout: float = None, block: bool = True) -> StreamInjection:
+        """
+        This function streams data into a ring buffer of the running target (DOTT_stream of DOTT's testhelpers,
+        built with DOTT_STREAM). The data is written by a background thread via live access: it reads the tail index
+        (advanced by the firmware when consuming data, see DOTT_stream_read), writes as much data as fits into the
+        free space and then advances the head index. If the buffer is full, the thread waits until the firmware has
+        consumed data (flow control). Hence, large inputs (e.g., recorded sensor data) can be fed to the firmware
+        at the rate it consumes them without halting it. Example:
+
+        inj = live_access.stream_inject(Path('samples.bin').read_bytes(), timeout=10.0)
+        log.info(str(inj))
+
+        Args:
+            data: Data to be streamed into the target.
+            addr: Address of the ring buffer (head index, tail index and buffer as DOTT_stream_t). Default: address
+                  of DOTT_stream (requires the target passed to the constructor).
+            size: Size of the buffer in bytes (without the indices). Default: derived from the size of DOTT_stream.
+            chunk: Maximum number of bytes written per probe transaction.
+            timeout: Time (in seconds) after which the injection is aborted if the firmware does not consume data.
+            block: If True, this function returns once all data has been written. Otherwise, it returns immediately.
+
+        Returns: Injection object with the number of bytes sent and the achieved throughput.
+        """
+        target = self._broker._target
+        if addr is None or size is None:
+            if target is None:
+                raise DottException('Address and size of the stream buffer are required if no target is given.')
+            if addr is None:
+                addr = target.symbols.addr('DOTT_stream')
+            if size is None:
+                size = target.symbols.size('DOTT_stream') - TargetDirect._STREAM_HDR_SIZE
+        if size <= 1:
+            raise DottException(f'Invalid stream buffer size ({size} bytes).')
+        injection = StreamInjection(len(data))
+
+        def inject_loop() -> None:
+            try:
+                with self.session():
+                    self._stream_inject_loop(injection, bytes(data), addr, size, max(1, chunk), timeout)
+            except Exception as ex:
+                injection._exception = ex
+            finally:
+                injection._time_end = time.perf_counter()
+
+        injection._thread = threading.Thread(target=inject_loop, name='TargetDirectStreamInjector', daemon=True)
+        injection._thread.start()
+        if block:
+            injection.wait()
+        return injection
+
+    def _stream_inject_loop(self, injection: StreamInjection, data: bytes, addr: int, size: int, chunk: int,
+                            timeout: float) -> None:
+        buf_addr = addr + TargetDirect._STREAM_HDR_SIZE
+        with self._broker.access():
+            self._sync()
+            head = self._jlink.memory_read32(addr, 1)[0]
+        injection._time_start = time.perf_counter()
+        time_progress = injection._time_start
+        while injection._sent < len(data) and not injection._stop.is_set():
+            with self._broker.access():
+                self._sync()
+                tail = self._jlink.memory_read32(addr + 4, 1)[0]
+                if head >= size or tail >= size:
+                    raise DottException(f'Corrupted stream buffer indices (head: {head}, tail: {tail}).')
+                free = (tail - head - 1) % size  # one byte is kept free to distinguish a full from an empty buffer
+                num = min(free, chunk, len(data) - injection._sent)
+                if num > 0:
+                    # the data is written up to the end of the buffer; the rest follows with the next iteration
+                    num = min(num, size - head)
+                    self._jlink.memory_write8(buf_addr + head, list(data[injection._sent:injection._sent + num]))
+                    head = (head + num) % size
+                    self._jlink.memory_write32(addr, [head])
+            if num > 0:
+                injection._sent += num
+                time_progress = time.perf_counter()
+                continue
+            injection._stalls += 1
+            if timeout is not None and time.perf_counter() - time_progress > timeout:
+                raise DottException(f'Stream injection timed out ({injection._sent} of {len(data)} bytes sent).')
+            time.sleep(TargetDirect._STREAM_STALL_SEC)
+
+    def swo_capture(self, cpu_speed: int = None, swo_speed: int = None, port_mask: int = 0xffffffff,
+                    pc_sampling: bool = False) -> SwoCapture:
+        """
+        This function creates a SWO capture (ITM stimulus ports and optionally DWT PC samples) for the target. The
+        capture is started with start() (or by using it as context manager). Example:
+
+        with live_access.swo_capture(pc_sampling=True) as swo:
+            dott().target.cont()
+            time.sleep(1)
+            log = swo.channel(0).read_text()
+
+        Args:
+            cpu_speed: Clock frequency of the target CPU in Hz. Default: swo_cpu_speed from DOTT config.
+            swo_speed: SWO speed in Hz. Default: swo_speed from DOTT config or the fastest supported speed.
+            port_mask: Mask of the ITM stimulus ports to be enabled.
+            pc_sampling: If True, the DWT is configured to emit periodic PC samples.
+
+        Returns: The (not yet started) SWO capture.
+        """
+        cpu_speed = DottConf.get('swo_cpu_speed') if cpu_speed is None else cpu_speed
+        swo_speed = DottConf.get('swo_speed') if swo_speed is None else swo_speed
+        if cpu_speed is None:
+            raise DottException('SWO capture requires the CPU speed of the target (swo_cpu_speed in DOTT config).')
+        return SwoCapture(self._jlink, cpu_speed, swo_speed, port_mask, pc_sampling, access=self._broker.access)
+
+    def power_capture(self, freq: int = 10000, channel: int = 0, voltage: float = 3.3, scale: float = 1e-6,
+                      always: bool = True) -> 'PowerCapture':
+        """
+        This function creates a capture of the target current using the power trace of the J-Link (see
+        PowerCapture). The capture is started with start() (or by using it as context manager). Example:
+
+        with live_access.power_capture(voltage=1.8) as pwr:
+            with pwr.span('measurement'):
+                dott().target.cont()
+                time.sleep(1)
+        log.info(str(pwr.report()))
+
+        Args:
+            freq: Requested sampling frequency in Hz.
+            channel: Power trace channel of the probe.
+            voltage: Supply voltage of the target (used to compute the energy).
+            scale: Ampere per raw power trace unit.
+            always: Capture while the CPU is halted too.
+
+        Returns: The (not yet started) power capture.
+        """
+        from dottmi.power import PowerCapture
+        return PowerCapture(self._jlink, freq, channel, voltage, scale, always, access=self._broker.access)
+
+    def rtt_start(self, block_addr: int = None, timeout: float = 2.0) -> int:
+        """
+        This function starts RTT (SEGGER Real Time Transfer) on the probe and waits until the RTT control block of
+        the target (e.g., the one provided by testhelpers.c if built with DOTT_RTT) is found. RTT allows the running
+        target to stream data (e.g., test results or logs) to the host at high speed. Example:
+
+        live_access.rtt_start(dott().target.symbols.addr('_SEGGER_RTT'))
+        dott().target.cont()
+        results = live_access.rtt_read_exact(1024, timeout=5)
+
+        Args:
+            block_addr: Address of the RTT control block (_SEGGER_RTT). If None, the probe searches the target RAM.
+            timeout: Maximum time (in seconds) to wait until the control block is found.
+
+        Returns: The number of up (target to host) buffers of the control block.
+        """
+        with self._broker.access():
+            if block_addr is None:
+                self._jlink.rtt_start()
+            else:
+                self._jlink.rtt_start(block_addr)
+
+        end_time = time.time() + timeout
+        while True:
+            try:
+                with self._broker.access():
+                    return self._jlink.rtt_get_num_up_buffers()
+            except Exception:  # note: pylink raises as long as the control block has not been found
+                if time.time() > end_time:
+                    raise DottException('RTT control block not found on target.') from None
+                time.sleep(0.01)
+
+    def rtt_stop(self) -> None:
+        """
+        This function stops RTT on the probe.
+        """
+        with self._broker.access():
+            self._jlink.rtt_stop()
+
+    def rtt_read(self, num_bytes: int = 4096, buffer_idx: int = 0) -> bytes:
+        """
+        This function reads (at most num_bytes) data which is available in the given RTT up buffer (non-blocking).
+        """
+        with self._broker.access():
+            return bytes(self._jlink.rtt_read(buffer_idx, num_bytes))
+
+    def rtt_read_exact(self, num_bytes: int, timeout: float = None, buffer_idx: int = 0) -> bytes:
+        """
+        This function reads exactly num_bytes from the given RTT up buffer. It raises an exception if the data is not
+        available within timeout seconds (or waits forever if timeout is None).
+        """
+        data = bytearray()
+        end_time = time.time() + timeout if timeout is not None else None
+        while len(data) < num_bytes:
+            with self._broker.access():
+                chunk = self._jlink.rtt_read(buffer_idx, num_bytes - len(data))
+            if len(chunk) > 0:
+                data.extend(chunk)
+            elif end_time is not None and time.time() > end_time:
+                raise DottException(f'Only {len(data)} of {num_bytes} bytes received via RTT within {timeout}s.')
+            else:
+                time.sleep(0.001)
+        return bytes(data)
+
+    def rtt_write(self, data: bytes, buffer_idx: int = 0) -> int:
+        """
+        This function writes data to the given RTT down buffer. Returns the number of bytes written (which is less than
+        len(data) if the down buffer is full).
+        """
+        with self._broker.access():
+            return self._jlink.rtt_write(buffer_idx, list(data))
+
     def disconnect(self) -> None:
         """
-        This function closes te live access connection to the target.
+        This function closes te live access connection to the target (the probe connection is closed once it is no
+        longer used by any TargetDirect instance).
         """
-        self._jlink.close()
+        self._broker.release()
 
     @property
     def jlink_raw(self) -> JLink:
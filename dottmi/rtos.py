@@ -0,0 +1,214 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# RTOS awareness: the threads of the RTOS running on the (halted) target with their state, priority, stack usage and
+# CPU time. The kernel structures are read with a few bulk memory reads (read_many, i.e., pipelined via GDB) and
+# decoded on the host using the type layouts of the kernel's types (queried from GDB once and then cached, see
+# TargetMem.type_layout) instead of evaluating the individual fields via GDB. For example:
+#
+#   rtos = dt.rtos  # detected from the kernel's symbols (None if no supported RTOS is found)
+#   for t in rtos.threads():
+#       log.info(f'{t.name}: {t.state}, prio {t.priority}, stack free {t.stack_free}, cpu {t.cpu_share:.1%}')
+
+from abc import ABC, abstractmethod
+from typing import Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class RtosThread(object):
+    def __init__(self, handle: int, name: str, state: str, priority: int) -> None:
+        self.handle: int = handle  # address of the thread's control block
+        self.name: str = name
+        self.state: str = state  # running, ready, blocked, suspended or deleted
+        self.priority: int = priority
+        self.stack_base: int = None  # lowest address of the thread's stack
+        self.stack_free: int = None  # bytes of the stack which have never been used (high-water mark)
+        self.stack_size: int = None  # size of the stack (if known to the kernel)
+        self.sp: int = None  # saved stack pointer (top of stack); not up to date for the running thread
+        self.run_time: int = None  # accumulated run time counter (if the kernel collects run time statistics)
+        self.cpu_share: float = None  # share of the total run time
+
+    def __repr__(self) -> str:
+        return f'RtosThread({self.name!r}, {self.state}, prio={self.priority}, stack_free={self.stack_free})'
+
+
+class Rtos(ABC):
+    """
+    Base class of the RTOS plugins. A plugin is selected by Rtos.detect based on the symbols of the target binary.
+    """
+    # plugins in the order they are tried (see register)
+    _plugins: List = []
+
+    def __init__(self, target: 'Target') -> None:
+        self._target: 'Target' = target
+
+    @staticmethod
+    def register(plugin) -> None:
+        """
+        Registers an RTOS plugin (sub-class of Rtos with a static method present(target) -> bool).
+        """
+        if plugin not in Rtos._plugins:
+            Rtos._plugins.append(plugin)
+
+    @staticmethod
+    def detect(target: 'Target') -> 'Rtos':
+        """
+        Returns an instance of the first plugin whose RTOS is present in the target binary (None if there is none).
+        """
+        for plugin in Rtos._plugins:
+            if plugin.present(target):
+                log.debug(f'RTOS detected: {plugin.NAME}')
+                return plugin(target)
+        return None
+
+    @abstractmethod
+    def threads(self) -> List[RtosThread]:
+        """
+        Returns the threads of the RTOS. The target has to be halted.
+        """
+        pass
+
+    def current(self) -> RtosThread:
+        for t in self.threads():
+            if t.state == 'running':
+                return t
+        return None
+
+    def threads_str(self) -> str:
+        lines = [f'  {"thread":<20}{"state":<11}{"prio":>5}{"stack free":>12}{"stack size":>12}{"cpu":>8}']
+        for t in self.threads():
+            cpu = f'{t.cpu_share * 100:.1f}%' if t.cpu_share is not None else '-'
+            lines.append(f'  {t.name:<20}{t.state:<11}{t.priority:>5}{t.stack_free!s:>12}{t.stack_size!s:>12}'
+                         f'{cpu:>8}')
+        return '\n'.join(lines)
+
+
+# -------------------------------------------------------------------------------------------------
+class FreeRtos(Rtos):
+    """
+    FreeRTOS plugin. Threads are collected from the kernel's task lists (ready lists per priority, delayed lists,
+    pending ready, suspended and waiting termination lists). The free stack is determined from the tskSTACK_FILL_BYTE
+    fill of the stacks (requires configCHECK_FOR_STACK_OVERFLOW > 1 or INCLUDE_uxTaskGetStackHighWaterMark); the
+    stack size is known if configRECORD_STACK_HIGH_ADDRESS is set and the run time if configGENERATE_RUN_TIME_STATS
+    is set.
+    """
+    NAME = 'FreeRTOS'
+    STACK_FILL_BYTE = 0xa5
+    STACK_SCAN_CHUNK = 256
+
+    # task lists (static variables of tasks.c) and the state of the tasks contained in them
+    _LISTS = [('xDelayedTaskList1', 'blocked'), ('xDelayedTaskList2', 'blocked'), ('xPendingReadyList', 'ready'),
+              ('xSuspendedTaskList', 'suspended'), ('xTasksWaitingTermination', 'deleted')]
+
+    @staticmethod
+    def present(target: 'Target') -> bool:
+        return target.symbols.exists('pxCurrentTCB') and target.symbols.exists('pxReadyTasksLists')
+
+    def __init__(self, target: 'Target') -> None:
+        super().__init__(target)
+        mem = target.mem
+        self._tcb = mem.type_layout('TCB_t')
+        self._list = mem.type_layout('List_t')
+        names = self._tcb.field_names
+        self._state_item: str = 'xStateListItem' if 'xStateListItem' in names else 'xGenericListItem'  # < V9
+        self._ptr_size: int = mem.sizeof('void *')
+
+    def _ptr(self, data: bytes, offset: int = 0) -> int:
+        return int.from_bytes(data[offset:offset + self._ptr_size], self._target.byte_order)
+
+    def _lists(self) -> List[Tuple[int, str, str]]:
+        # (address, state, name of the TCB's list item linked into the list) of all task lists
+        symbols = self._target.symbols
+        ready = symbols.addr('pxReadyTasksLists')
+        lists = [(ready + i * self._list.size, 'ready', self._state_item)
+                 for i in range(symbols.size('pxReadyTasksLists') // self._list.size)]
+        for sym, state in FreeRtos._LISTS:
+            if symbols.exists(sym):
+                item = 'xEventListItem' if sym == 'xPendingReadyList' else self._state_item
+                lists.append((symbols.addr(sym), state, item))
+        return lists
+
+    def _walk(self, lists: List[Tuple[int, str, str]]) -> Dict[int, Tuple[str, Dict]]:
+        # walks all lists in parallel: each step reads the next TCB of every list with one pipelined read_many
+        mem = self._target.mem
+        end_offset = self._list.field_offset('xListEnd')
+        cursors = []  # [list end address, remaining items, state, item field, address of the next item]
+        for (addr, state, item), head in zip(lists, mem.read_many([(addr, self._list.size) for addr, _, _ in lists])):
+            head = self._list.unpack(head)
+            if head['uxNumberOfItems'] > 0:
+                cursors.append([addr + end_offset, head['uxNumberOfItems'], state, item, head['xListEnd']['pxNext']])
+        tcbs: Dict[int, Tuple[str, Dict]] = {}
+        while len(cursors) > 0:
+            addrs = [c[4] - self._tcb.field_offset(c[3]) for c in cursors]
+            for c, addr, data in zip(cursors, addrs, mem.read_many([(a, self._tcb.size) for a in addrs])):
+                tcb = self._tcb.unpack(data)
+                tcbs.setdefault(addr, (c[2], tcb))  # a task may be in a state list and the pending ready list
+                c[1] -= 1
+                c[4] = tcb[c[3]]['pxNext']
+            cursors = [c for c in cursors if c[1] > 0 and c[4] != c[0]]
+        return tcbs
+
+    def _stack_free(self, stacks: List[int], sizes: List[int]) -> List[int]:
+        # counts the fill bytes from the bottom of each stack (up to its size if known); the chunks of all stacks are
+        # read with one read_many
+        free = [0] * len(stacks)
+        pending = list(range(len(stacks)))
+        while len(pending) > 0:
+            ranges = [(stacks[i] + free[i], FreeRtos.STACK_SCAN_CHUNK) for i in pending]
+            still = []
+            for i, data in zip(pending, self._target.mem.read_many(ranges)):
+                n = len(data) - len(data.lstrip(bytes([FreeRtos.STACK_FILL_BYTE])))
+                free[i] += n
+                if n == len(data) and (sizes[i] is None or free[i] < sizes[i]):
+                    still.append(i)
+            pending = still
+        return free
+
+    def threads(self) -> List[RtosThread]:
+        if self._target.is_running():
+            raise DottException('The target has to be halted to read the RTOS threads.')
+        current = self._ptr(self._target.mem.read(self._target.symbols.addr('pxCurrentTCB'), self._ptr_size))
+        tcbs = self._walk(self._lists())
+        names = self._tcb.field_names
+        threads = []
+        for addr, (state, tcb) in tcbs.items():
+            name = bytes(c & 0xff for c in tcb['pcTaskName']).split(b'\0', 1)[0].decode('ascii', 'replace')
+            t = RtosThread(addr, name, 'running' if addr == current else state, tcb['uxPriority'])
+            t.stack_base = tcb['pxStack']
+            t.sp = tcb['pxTopOfStack']
+            if 'pxEndOfStack' in names:
+                t.stack_size = tcb['pxEndOfStack'] - tcb['pxStack'] + self._ptr_size
+            if 'ulRunTimeCounter' in names:
+                t.run_time = tcb['ulRunTimeCounter']
+            threads.append(t)
+        for t, free in zip(threads, self._stack_free([t.stack_base for t in threads],
+                                                     [t.stack_size for t in threads])):
+            t.stack_free = free if t.stack_size is None else min(free, t.stack_size)
+        total = sum(t.run_time for t in threads if t.run_time is not None)
+        for t in threads:
+            if t.run_time is not None and total > 0:
+                t.cpu_share = t.run_time / total
+        return sorted(threads, key=lambda t: (-t.priority, t.name))
+
+
+Rtos.register(FreeRtos)
@@ -0,0 +1,300 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import gzip
+import json
+import struct
+import threading
+import time
+from typing import Callable, Dict, Iterator, List, NamedTuple, Tuple, Union
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+FILE_VERSION = 1
+
+
+# -------------------------------------------------------------------------------------------------
+class SoakViolation(NamedTuple):
+    time: float  # seconds since the start of the run
+    invariant: str
+    values: Dict[str, int]
+
+
+class _SignalStats(object):
+    # running statistics of one signal (constant memory): min, max, first and last value and the least-squares slope
+    def __init__(self) -> None:
+        self.count: int = 0
+        self.min: int = None
+        self.max: int = None
+        self.first: int = None
+        self.last: int = None
+        self._sums: List[float] = [0.0] * 5  # t, v, t*t, t*v (t relative to the first sample), v*v
+
+    def add(self, t: float, val: int) -> None:
+        if self.count == 0:
+            self.min = self.max = self.first = val
+        self.min = min(self.min, val)
+        self.max = max(self.max, val)
+        self.last = val
+        self.count += 1
+        s = self._sums
+        s[0] += t
+        s[1] += val
+        s[2] += t * t
+        s[3] += t * val
+        s[4] += val * val
+
+    def slope(self) -> float:
+        # change per second (least-squares fit over all samples)
+        n, s = self.count, self._sums
+        den = n * s[2] - s[0] * s[0]
+        return (n * s[3] - s[0] * s[1]) / den if n > 1 and den > 0 else 0.0
+
+
+# -------------------------------------------------------------------------------------------------
+class SoakReport(object):
+    """
+    Result of a soak run (see SoakRunner): per-signal statistics (min, max, first, last and drift per hour), the
+    invariant violations and the signals whose drift exceeded their limit.
+    """
+    def __init__(self, duration: float, samples: int, overruns: int, stats: Dict[str, _SignalStats],
+                 violations: List[SoakViolation], num_violations: int, drift_limits: Dict[str, float]) -> None:
+        self.duration: float = duration
+        self.samples: int = samples
+        self.overruns: int = overruns  # samples which were taken late (the probe did not keep up with the rate)
+        self.violations: List[SoakViolation] = violations  # the first violations (see SoakRunner.MAX_VIOLATIONS)
+        self.num_violations: int = num_violations
+        self.signals: Dict[str, Dict] = {name: {'min': s.min, 'max': s.max, 'first': s.first, 'last': s.last,
+                                                'drift_per_hour': s.slope() * 3600.0} for name, s in stats.items()}
+        self.drifting: List[str] = [name for name, limit in drift_limits.items()
+                                    if abs(self.signals[name]['drift_per_hour']) > limit]
+
+    @property
+    def ok(self) -> bool:
+        return self.num_violations == 0 and len(self.drifting) == 0
+
+    def __str__(self) -> str:
+        lines = [f'Soak run: {self.samples} samples in {self.duration:.0f}s ({self.overruns} late), '
+                 f'{self.num_violations} invariant violations, {len(self.drifting)} drifting signals',
+                 f'  {"signal":<24}{"min":>12}{"max":>12}{"first":>12}{"last":>12}{"drift/h":>12}']
+        for name, sig in self.signals.items():
+            mark = ' (drift)' if name in self.drifting else ''
+            lines.append(f'  {name:<24}{sig["min"]!s:>12}{sig["max"]!s:>12}{sig["first"]!s:>12}{sig["last"]!s:>12}'
+                         f'{sig["drift_per_hour"]:>12.2f}{mark}')
+        for v in self.violations[:10]:
+            lines.append(f'  violation of {v.invariant} at {v.time:.1f}s: {v.values}')
+        if self.num_violations > 10:
+            lines.append(f'  ... {self.num_violations - 10} further violations')
+        return '\n'.join(lines)
+
+
+# -------------------------------------------------------------------------------------------------
+class SoakRunner(object):
+    """
+    Endurance (soak) test runner. While the firmware runs (e.g., for hours under stimulus), the configured signals
+    (32bit variables or peripheral registers) are sampled periodically via live access, i.e., without halting the
+    core. Each sample is checked against the invariants and added to running statistics from which the drift (e.g.,
+    of a heap usage counter or a free-buffer count) is determined. Samples are streamed gzip-compressed to a file
+    (see load) instead of being kept in memory; hence, host memory stays flat over arbitrarily long runs. Example:
+
+        soak = SoakRunner(live_access, {'heap_used': 'app_heap_used', 'tim2_cnt': 'TIM2.CNT'}, rate=10,
+                          invariants={'heap bounded': lambda s: s['heap_used'] < 4096},
+                          drift_limits={'heap_used': 16.0}, file_name='soak.bin.gz')
+        dott().target.cont()
+        report = soak.run(duration=4 * 3600)
+        assert report.ok, str(report)
+
+    Signals are given as address, symbol name or peripheral register (PERIPHERAL.REGISTER, see Target.periph;
+    only registers without read side effects).
+    """
+    # number of invariant violations which are kept in detail (all violations are counted)
+    MAX_VIOLATIONS = 100
+
+    # interval (in seconds) in which the sample file is flushed (such that it can be analysed while the run continues)
+    FLUSH_INTERVAL_SEC = 5.0
+
+    def __init__(self, live, signals: Dict[str, Union[int, str]], rate: float = 1.0,
+                 invariants: Dict[str, Callable[[Dict[str, int]], bool]] = None, drift_limits: Dict[str, float] = None,
+                 file_name: str = None, target: 'Target' = None) -> None:
+        """
+        Constructor.
+
+        Args:
+            live: TargetDirect instance (e.g., live_access fixture).
+            signals: Names of the signals and their locations (address, symbol or PERIPHERAL.REGISTER).
+            rate: Sampling rate in Hz.
+            invariants: Names of the invariants and functions which get the values of a sample (keyed by signal
+                        name) and return False if the invariant is violated.
+            drift_limits: Maximum absolute drift (change per hour) of the given signals.
+            file_name: File to which the samples are written (gzip-compressed). If None, samples are not stored.
+            target: Target used to resolve symbols and peripheral registers. Default: the default target.
+        """
+        self._live = live
+        self._names: List[str] = list(signals.keys())
+        self._addrs: List[int] = [self._resolve(loc, target) for loc in signals.values()]
+        self._period: float = 1.0 / rate
+        self._invariants: Dict[str, Callable[[Dict[str, int]], bool]] = invariants if invariants is not None else {}
+        self._drift_limits: Dict[str, float] = drift_limits if drift_limits is not None else {}
+        for name in self._drift_limits:
+            if name not in signals:
+                raise DottException(f'Drift limit given for unknown signal {name}.')
+        self._file_name: str = file_name
+        self._stop: threading.Event = threading.Event()
+        self._thread: threading.Thread = None
+        self._report: SoakReport = None
+        self._exception: Exception = None
+
+    @staticmethod
+    def _resolve(loc: Union[int, str], target: 'Target') -> int:
+        if isinstance(loc, int):
+            addr = loc
+        else:
+            if target is None:
+                from dottmi.dott import dott
+                target = dott().target
+            if '.' in loc:
+                periph_name, reg_name = loc.split('.', 1)
+                reg = getattr(target.periph[periph_name], reg_name)
+                if not reg._reg.side_effect_free:
+                    raise DottException(f'{loc} can not be sampled since reading it has side effects.')
+                addr = reg.addr
+            else:
+                addr = target.symbols.addr(loc)
+        if addr % 4 != 0:
+            raise DottException(f'Signal location 0x{addr:x} is not 32bit aligned.')
+        return addr
+
+    def run(self, duration: float) -> SoakReport:
+        """
+        Runs the soak test for the given duration (seconds) or until stop is called and returns the report.
+        """
+        self._stop.clear()
+        stats = {name: _SignalStats() for name in self._names}
+        violations: List[SoakViolation] = []
+        num_violations = 0
+        overruns = 0
+        samples = 0
+        fmt = struct.Struct(f'<d{len(self._addrs)}I')
+        out = gzip.open(self._file_name, 'wb') if self._file_name is not None else None
+        try:
+            if out is not None:
+                header = {'version': FILE_VERSION, 'signals': self._names, 'addrs': self._addrs,
+                          'rate': 1.0 / self._period, 'start': time.time()}
+                out.write(json.dumps(header).encode() + b'\n')
+            time_start = time.perf_counter()
+            next_time = time_start
+            next_flush = time_start + SoakRunner.FLUSH_INTERVAL_SEC
+            with self._live.session():
+                while not self._stop.is_set():
+                    now = time.perf_counter()
+                    if now - time_start >= duration:
+                        break
+                    if now < next_time:
+                        self._stop.wait(next_time - now)
+                        continue
+                    if now - next_time > self._period:
+                        overruns += 1
+                        next_time = now  # no catching up on missed samples
+                    values = self._live.mem_read_scatter(self._addrs)
+                    t = now - time_start
+                    sample = dict(zip(self._names, values))
+                    for name, val in sample.items():
+                        stats[name].add(t, val)
+                    for name, check in self._invariants.items():
+                        if not check(sample):
+                            num_violations += 1
+                            if all(v.invariant != name for v in violations):
+                                log.warn(f'Soak invariant {name} violated at {t:.1f}s: {sample}')
+                            if len(violations) < SoakRunner.MAX_VIOLATIONS:
+                                violations.append(SoakViolation(t, name, sample))
+                    if out is not None:
+                        out.write(fmt.pack(t, *values))
+                        if now >= next_flush:
+                            out.flush()
+                            next_flush = now + SoakRunner.FLUSH_INTERVAL_SEC
+                    samples += 1
+                    next_time += self._period
+            elapsed = time.perf_counter() - time_start
+        finally:
+            if out is not None:
+                out.close()
+        self._report = SoakReport(elapsed, samples, overruns, stats, violations, num_violations, self._drift_limits)
+        return self._report
+
+    def start(self, duration: float) -> None:
+        """
+        Runs the soak test in a background thread (see run, wait and stop).
+        """
+        def soak_loop() -> None:
+            try:
+                self.run(duration)
+            except Exception as ex:
+                self._exception = ex
+
+        self._report = None
+        self._exception = None
+        self._thread = threading.Thread(target=soak_loop, name='DottSoakRunner', daemon=True)
+        self._thread.start()
+
+    def wait(self, timeout: float = None) -> SoakReport:
+        """
+        Waits until the soak test started with start has finished and returns its report. Exceptions raised by the
+        soak thread are re-raised.
+        """
+        if self._thread is not None:
+            self._thread.join(timeout)
+        if self._exception is not None:
+            raise self._exception
+        return self._report
+
+    def stop(self) -> SoakReport:
+        self._stop.set()
+        return self.wait()
+
+    @staticmethod
+    def load(file_name: str) -> Tuple[Dict, Iterator[Tuple[float, List[int]]]]:
+        """
+        Reads a sample file written by a soak run (also while the run is still in progress).
+
+        Returns:
+            The file's header (signals, addrs, rate, start) and an iterator over the samples as (time relative to the
+            start in seconds, values in the order of the signals).
+        """
+        f = gzip.open(file_name, 'rb')
+        header = json.loads(f.readline().decode())
+        if header.get('version') != FILE_VERSION:
+            f.close()
+            raise DottException(f'Unsupported soak sample file {file_name}.')
+        fmt = struct.Struct(f'<d{len(header["signals"])}I')
+
+        def samples() -> Iterator[Tuple[float, List[int]]]:
+            with f:
+                while True:
+                    try:
+                        rec = f.read(fmt.size)
+                    except EOFError:  # file of a run which is still in progress (unterminated gzip stream)
+                        break
+                    if len(rec) < fmt.size:
+                        break
+                    vals = fmt.unpack(rec)
+                    yield vals[0], list(vals[1:])
+
+        return header, samples()
@@ -0,0 +1,107 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+from typing import Tuple
+
+from dottmi.dottexceptions import DottException
+
+
+# -------------------------------------------------------------------------------------------------
+class StackMonitor(object):
+    """
+    Measures the peak stack usage (high-water mark) of the target. paint fills the unused part of the stack (from the
+    bottom of the stack region up to the current stack pointer) with a pattern and peak searches for the lowest
+    overwritten word. Both run on the target (DOTT_stack_paint and DOTT_stack_scan in testhelpers.c) such that neither
+    the fill nor the search transfers the stack content. For example:
+        mon = StackMonitor(dt)
+        mon.paint()
+        dt.call('example_Recursion', 10)
+        log.info(f'peak stack usage: {mon.peak()} of {mon.size} bytes')
+    The stack_watch option in dott.ini does this for every test (see the target_reset_xxx fixtures).
+    """
+    PATTERN = 0xC5C5C5C5
+
+    # symbols (bottom, top) describing the stack region in common startup files and linker scripts
+    _REGION_SYMBOLS = [('Stack_Mem', '__initial_sp'),  # Arm Compiler startup files (startup_xxx.s)
+                       ('Image$$ARM_LIB_STACK$$ZI$$Base', 'Image$$ARM_LIB_STACK$$ZI$$Limit'),  # armlink scatter file
+                       ('__StackLimit', '__StackTop'),  # CMSIS GCC linker scripts
+                       ('_sstack', '_estack')]
+
+    def __init__(self, target: 'Target', region: Tuple[int, int] = None) -> None:
+        """
+        Constructor.
+
+        Args:
+            target: Target whose stack is monitored.
+            region: Stack region (start, size). If not given, the region is determined from the symbols.
+        """
+        self._target: 'Target' = target
+        if region is None:
+            region = StackMonitor.find_region(target)
+        self._bottom: int = region[0]
+        self._top: int = region[0] + region[1]
+        self._painted_end: int = None
+
+    @staticmethod
+    def find_region(target: 'Target') -> Tuple[int, int]:
+        """
+        Returns the stack region (start, size) as given by the symbols of the loaded application.
+        """
+        symbols = target.symbols
+        for bottom, top in StackMonitor._REGION_SYMBOLS:
+            if symbols.exists(bottom) and symbols.exists(top):
+                start, end = symbols.addr(bottom), symbols.addr(top)
+                if end > start:
+                    return start, end - start
+        raise DottException('Unable to determine the stack region from the symbols of the application. Set '
+                            'stack_region (<start>:<size>) in dott.ini.')
+
+    @property
+    def size(self) -> int:
+        return self._top - self._bottom
+
+    @property
+    def painted(self) -> bool:
+        return self._painted_end is not None
+
+    def paint(self) -> None:
+        """
+        Paints the unused part of the stack. The target has to be halted.
+        """
+        end = self._target.call('DOTT_stack_paint', self._bottom, StackMonitor.PATTERN)
+        if not self._bottom <= end <= self._top:
+            raise DottException(f'Stack pointer (0x{end:x}) is outside of the stack region '
+                                f'(0x{self._bottom:x}-0x{self._top:x}).')
+        self._painted_end = end
+
+    def peak(self) -> int:
+        """
+        Returns the peak stack usage (in bytes) since the stack has been painted. The target has to be halted.
+        """
+        if self._painted_end is None:
+            raise DottException('The stack has not been painted.')
+        addr = self._target.call('DOTT_stack_scan', self._bottom, self._painted_end, StackMonitor.PATTERN)
+        return self._top - addr
+
+    def overflow(self, peak: int) -> bool:
+        """
+        Returns True if the given peak usage reached the bottom of the stack (i.e., the stack most likely overflowed).
+        """
+        return peak >= self.size
@@ -0,0 +1,128 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import struct
+from typing import List, Union
+
+from dottmi.dott import dott
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+# SRAM region of the Cortex-M memory map; code outside of it (i.e., in flash) can not be patched
+_SRAM_START = 0x20000000
+_SRAM_END = 0x40000000
+
+# Thumb instructions used by the stubs (all of them are available on ARMv6-M, i.e., also on Cortex-M0)
+_LDR_R0_PC = 0x4800  # ldr r0, [pc, #imm8 * 4]
+_BX_LR = 0x4770  # bx lr
+_PUSH_R0_R1 = 0xb403  # push {r0, r1}
+_STR_R0_SP_4 = 0x9001  # str r0, [sp, #4]
+_POP_R0_PC = 0xbd01  # pop {r0, pc}
+_NOP = 0xbf00
+
+
+def _with_literal(addr: int, code: List[int], ldr_idx: int, literal: int) -> bytes:
+    # appends a (word-aligned) literal to the given Thumb code and fixes the offset of the pc-relative ldr at ldr_idx
+    lit_addr = (addr + 2 * len(code) + 3) & ~3
+    base = (addr + 2 * ldr_idx + 4) & ~3  # Align(PC, 4) of the ldr
+    code = code[:]
+    code[ldr_idx] |= (lit_addr - base) // 4
+    code += [_NOP] * ((lit_addr - addr) // 2 - len(code))
+    return struct.pack(f'<{len(code)}H', *code) + struct.pack('<I', literal & 0xffffffff)
+
+
+# -------------------------------------------------------------------------------------------------
+class FunctionStub(object):
+    """
+    Replaces a function of firmware which runs from SRAM (e.g., downloaded with target_load_sram) by patching its
+    first instructions. Calls of the patched function run at native speed (no breakpoint and no host round trip per
+    call as with an InterceptPoint which calls ret). The function either returns the given value (return_value,
+    in r0) or branches to the replacement function (replacement, with the original arguments). The original code is
+    restored with restore; stubs which are still active at the end of a test are restored automatically. For example:
+        stub = FunctionStub('app_ReadSensor', return_value=42)
+        assert 42 * 2 == dt.eval('app_ProcessSensor()')
+        stub.restore()
+    The target has to be halted while stubs are applied and restored. Note: Devices with an instruction cache (e.g.,
+    Cortex-M7) may execute stale code if the cache is enabled.
+    """
+    _stubs: List['FunctionStub'] = []
+
+    def __init__(self, func: str, return_value: Union[int, None] = None, replacement: str = None,
+                 target: 'Target' = None) -> None:
+        self._target: 'Target' = target if target is not None else dott().target
+        self._func: str = func
+        self._addr: int = self._target.symbols.addr(func) & ~1
+        if not _SRAM_START <= self._addr < _SRAM_END:
+            raise DottException(f'{func} is not located in SRAM (0x{self._addr:08x}); only firmware which runs from '
+                                f'SRAM (e.g., target_load_sram) can be stubbed.')
+
+        if replacement is not None:
+            if return_value is not None:
+                raise DottException('Either a return value or a replacement function can be stubbed, not both.')
+            dest = self._target.symbols.addr(replacement) | 1
+            code = _with_literal(self._addr, [_PUSH_R0_R1, _LDR_R0_PC, _STR_R0_SP_4, _POP_R0_PC], 1, dest)
+        elif return_value is not None:
+            code = _with_literal(self._addr, [_LDR_R0_PC, _BX_LR], 0, int(return_value))
+        else:
+            code = struct.pack('<H', _BX_LR)
+
+        size = self._target.symbols.size(func)
+        if 0 < size < len(code):
+            raise DottException(f'{func} ({size} bytes) is too small to be stubbed ({len(code)} bytes required).')
+
+        self._orig: bytes = self._target.mem.read(self._addr, len(code))
+        self._target.mem.write(self._addr, code)
+        FunctionStub._stubs.append(self)
+        log.debug(f'Stubbed {func} at 0x{self._addr:08x} ({len(code)} bytes).')
+
+    @property
+    def active(self) -> bool:
+        return self in FunctionStub._stubs
+
+    def restore(self) -> None:
+        """
+        Restores the original code of the function.
+        """
+        if self.active:
+            self._target.mem.write(self._addr, self._orig)
+            FunctionStub._stubs.remove(self)
+
+    def __enter__(self) -> 'FunctionStub':
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.restore()
+
+    @staticmethod
+    def restore_all(discard: bool = False) -> None:
+        """
+        Restores all active stubs (in reverse order such that stubs of the same function are undone correctly). With
+        discard, the stubs are dropped without accessing the target (e.g., after the connection has been lost; the
+        firmware is downloaded again anyway).
+        """
+        for stub in reversed(FunctionStub._stubs[:]):
+            if discard:
+                FunctionStub._stubs.remove(stub)
+            else:
+                try:
+                    stub.restore()
+                except Exception as ex:
+                    FunctionStub._stubs.remove(stub)
+                    log.warn(f'Restoring stubbed function {stub._func} failed ({ex}).')
@@ -0,0 +1,323 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import contextlib
+import queue
+import threading
+import time
+from typing import Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+
+@contextlib.contextmanager
+def _exclusive_access():
+    # default probe access of SwoCapture (probe connection not shared, see ProbeBroker)
+    yield
+
+
+# -------------------------------------------------------------------------------------------------
+class ItmDecoder(object):
+    """
+    Decoder for the ITM/DWT packet protocol (see Armv7-M Architecture Reference Manual, Appendix D) as emitted via
+    SWO. The decoder is fed with raw SWO bytes (which may end in the middle of a packet) and returns the decoded
+    stimulus port (software) and DWT (hardware) source packets.
+    """
+    # decoded event kinds
+    SWIT = 'swit'  # stimulus port write: (SWIT, port, value, size, timestamp)
+    DWT = 'dwt'  # DWT packet: (DWT, discriminator, value, size, timestamp)
+    OVERFLOW = 'overflow'  # ITM FIFO overflow: (OVERFLOW, None, None, 0, timestamp)
+
+    # DWT discriminator ID of periodic PC sample packets
+    DWT_PC_SAMPLE = 2
+
+    _SIZES = {1: 1, 2: 2, 3: 4}
+
+    def __init__(self) -> None:
+        self._buf: bytearray = bytearray()
+        self._timestamp: int = 0  # accumulated local timestamp (in timestamp prescaler ticks)
+
+    @property
+    def timestamp(self) -> int:
+        return self._timestamp
+
+    def _continuation(self, pos: int) -> int:
+        # returns the position after a packet payload with continuation bits (or -1 if incomplete)
+        while pos < len(self._buf):
+            if self._buf[pos] & 0x80 == 0:
+                return pos + 1
+            pos += 1
+        return -1
+
+    def feed(self, data: bytes) -> List[Tuple]:
+        """
+        Decodes the given SWO bytes.
+
+        Returns:
+            List of decoded events (see SWIT, DWT and OVERFLOW).
+        """
+        self._buf.extend(data)
+        events: List[Tuple] = []
+        pos = 0
+        while pos < len(self._buf):
+            header = self._buf[pos]
+            if header == 0x00 or header == 0x80:  # synchronization packet
+                end = pos + 1
+            elif header == 0x70:  # overflow
+                events.append((ItmDecoder.OVERFLOW, None, None, 0, self._timestamp))
+                end = pos + 1
+            elif header & 0x03 != 0:  # source packet (software or hardware)
+                size = ItmDecoder._SIZES[header & 0x03]
+                end = pos + 1 + size
+                if end > len(self._buf):
+                    break
+                value = int.from_bytes(self._buf[pos + 1:end], 'little')
+                kind = ItmDecoder.DWT if header & 0x04 else ItmDecoder.SWIT
+                events.append((kind, header >> 3, value, size, self._timestamp))
+            elif header & 0x0f == 0x00:  # local timestamp
+                if header & 0x80 == 0:  # single byte format (timestamp value in header)
+                    self._timestamp += (header >> 4) & 0x07
+                    end = pos + 1
+                else:
+                    end = self._continuation(pos + 1)
+                    if end < 0:
+                        break
+                    delta = 0
+                    for i, b in enumerate(self._buf[pos + 1:end]):
+                        delta |= (b & 0x7f) << (7 * i)
+                    self._timestamp += delta
+            else:  # global timestamp, extension and reserved packets are skipped
+                end = self._continuation(pos + 1) if header & 0x80 else pos + 1
+                if end < 0:
+                    break
+            pos = end
+        del self._buf[:pos]
+        return events
+
+
+# -------------------------------------------------------------------------------------------------
+class SwoChannel(object):
+    """
+    Channel which receives the values written to one ITM stimulus port (or the PC samples of the DWT). Each entry is
+    given as (host time, ITM timestamp, value) where the host time is relative to the start of the capture.
+    """
+    def __init__(self, port: int) -> None:
+        self._port: int = port
+        self._queue: queue.Queue = queue.Queue()
+
+    @property
+    def port(self) -> int:
+        return self._port
+
+    def _put(self, entry: Tuple[float, int, int]) -> None:
+        self._queue.put(entry)
+
+    def get(self, timeout: float = None) -> Tuple[float, int, int]:
+        """
+        Returns the next entry of the channel. Blocks up to timeout seconds (or forever if timeout is None) if the
+        channel is empty.
+        """
+        try:
+            return self._queue.get(timeout=timeout)
+        except queue.Empty:
+            raise DottException(f'No data received on SWO channel {self._port} within {timeout}s.') from None
+
+    def read_all(self) -> List[Tuple[float, int, int]]:
+        """
+        Returns (and removes) all entries currently in the channel.
+        """
+        entries = []
+        while True:
+            try:
+                entries.append(self._queue.get_nowait())
+            except queue.Empty:
+                return entries
+
+    def read_text(self) -> str:
+        """
+        Returns (and removes) all entries of the channel as text, e.g., if the target outputs characters via
+        ITM_SendChar or DOTT_itm_write8.
+        """
+        return ''.join(chr(value & 0xff) for _, _, value in self.read_all())
+
+
+# -------------------------------------------------------------------------------------------------
+class SwoCapture(object):
+    """
+    Captures ITM stimulus port writes and DWT PC samples emitted by the target via SWO (using J-Link's SWO support)
+    without halting the target. A host thread continuously reads the SWO data from the probe, decodes it and
+    dispatches the stimulus port writes to per-port channels. Use TargetDirect.swo_capture or the swo_capture
+    fixture to create an instance.
+    """
+    # Cortex-M debug registers used to set up DWT PC sampling
+    _DEMCR = 0xe000edfc
+    _DEMCR_TRCENA = 0x01000000
+    _ITM_LAR = 0xe0000fb0
+    _ITM_TCR = 0xe0000e80
+    _ITM_TCR_ITMENA_TSENA_SYNCENA_DWTENA = 0x0000000f
+    _DWT_CTRL = 0xe0001000
+    _DWT_CTRL_PCSAMPLENA_CYCTAP_CYCCNTENA = 0x00001201
+
+    # interval (in seconds) in which the probe is polled for new SWO data if the previous poll returned no data
+    POLL_INTERVAL = 0.001
+
+    def __init__(self, jlink, cpu_speed: int, swo_speed: int = None, port_mask: int = 0xffffffff,
+                 pc_sampling: bool = False, pc_sample_postpreset: int = 15, access=None) -> None:
+        """
+        Constructor.
+
+        Args:
+            jlink: pylink JLink instance (connected to the target).
+            cpu_speed: Clock frequency of the target CPU in Hz (required to compute the SWO prescaler).
+            swo_speed: SWO speed in Hz. If None, the fastest speed supported by probe and target is used.
+            port_mask: Mask of the ITM stimulus ports to be enabled.
+            pc_sampling: If True, the DWT is configured to emit periodic PC samples (see pc_samples).
+            pc_sample_postpreset: DWT POSTPRESET value which determines the PC sampling interval (every
+                                  (pc_sample_postpreset + 1) * 1024 CPU cycles).
+            access: Context manager factory guarding each use of the probe connection if it is shared (see
+                    ProbeBroker.access).
+        """
+        self._jlink = jlink
+        self._access = access if access is not None else _exclusive_access
+        self._cpu_speed: int = cpu_speed
+        self._swo_speed: int = swo_speed
+        self._port_mask: int = port_mask
+        self._pc_sampling: bool = pc_sampling
+        self._pc_sample_postpreset: int = pc_sample_postpreset & 0x0f
+        self._decoder: ItmDecoder = ItmDecoder()
+        self._channels: Dict[int, SwoChannel] = {port: SwoChannel(port) for port in range(32)}
+        self._pc_samples: SwoChannel = SwoChannel(-1)
+        self._overflows: int = 0
+        self._num_bytes: int = 0
+        self._running: bool = False
+        self._thread: threading.Thread = None
+        self._time_start: float = None
+
+    @property
+    def swo_speed(self) -> int:
+        return self._swo_speed
+
+    @property
+    def overflows(self) -> int:
+        """
+        Number of ITM overflow packets received (i.e., the target emitted data faster than SWO could transfer).
+        """
+        return self._overflows
+
+    @property
+    def num_bytes(self) -> int:
+        """
+        Number of raw SWO bytes received so far.
+        """
+        return self._num_bytes
+
+    def channel(self, port: int) -> SwoChannel:
+        """
+        Returns the channel of the given ITM stimulus port (0..31).
+        """
+        return self._channels[port]
+
+    @property
+    def pc_samples(self) -> SwoChannel:
+        """
+        Channel receiving the DWT PC samples (only if PC sampling is enabled).
+        """
+        return self._pc_samples
+
+    def start(self) -> None:
+        """
+        Configures SWO on probe and target and starts the capture thread.
+        """
+        if self._running:
+            return
+        with self._access():
+            self._configure()
+
+        log.debug(f'SWO capture started (CPU speed: {self._cpu_speed}Hz, SWO speed: {self._swo_speed}Hz).')
+        self._time_start = time.perf_counter()
+        self._running = True
+        self._thread = threading.Thread(target=self._capture_loop, name='SwoCapture', daemon=True)
+        self._thread.start()
+
+    def _configure(self) -> None:
+        if self._swo_speed is None:
+            speeds = self._jlink.swo_supported_speeds(self._cpu_speed, 1)
+            if len(speeds) == 0:
+                raise DottException('Unable to determine a SWO speed supported by probe and target.')
+            self._swo_speed = speeds[0]
+        self._jlink.swo_enable(self._cpu_speed, self._swo_speed, self._port_mask)
+        self._jlink.swo_flush()
+
+        if self._pc_sampling:
+            demcr = self._jlink.memory_read32(SwoCapture._DEMCR, 1)[0]
+            self._jlink.memory_write32(SwoCapture._DEMCR, [demcr | SwoCapture._DEMCR_TRCENA])
+            self._jlink.memory_write32(SwoCapture._ITM_LAR, [0xc5acce55])  # unlock ITM registers
+            tcr = self._jlink.memory_read32(SwoCapture._ITM_TCR, 1)[0]
+            self._jlink.memory_write32(SwoCapture._ITM_TCR, [tcr | SwoCapture._ITM_TCR_ITMENA_TSENA_SYNCENA_DWTENA])
+            ctrl = self._jlink.memory_read32(SwoCapture._DWT_CTRL, 1)[0] & ~0x1e  # clear POSTPRESET
+            self._jlink.memory_write32(SwoCapture._DWT_CTRL, [ctrl | (self._pc_sample_postpreset << 1) |
+                                                             SwoCapture._DWT_CTRL_PCSAMPLENA_CYCTAP_CYCCNTENA])
+
+    def stop(self) -> None:
+        """
+        Stops the capture thread and disables SWO. Data already received remains available in the channels.
+        """
+        if not self._running:
+            return
+        self._running = False
+        self._thread.join()
+        try:
+            with self._access():
+                self._jlink.swo_stop()
+        except Exception as ex:
+            log.debug(f'Unable to stop SWO ({ex}).')
+
+    def _dispatch(self, host_time: float, events: List[Tuple]) -> None:
+        for kind, port, value, _, timestamp in events:
+            if kind == ItmDecoder.SWIT:
+                self._channels[port]._put((host_time, timestamp, value))
+            elif kind == ItmDecoder.DWT and port == ItmDecoder.DWT_PC_SAMPLE:
+                self._pc_samples._put((host_time, timestamp, value))
+            elif kind == ItmDecoder.OVERFLOW:
+                self._overflows += 1
+
+    def _capture_loop(self) -> None:
+        while self._running:
+            try:
+                with self._access():
+                    num_bytes = self._jlink.swo_num_bytes()
+                    data = bytes(self._jlink.swo_read(0, num_bytes, True)) if num_bytes > 0 else b''
+            except Exception as ex:
+                log.error(f'SWO capture failed ({ex}).')
+                self._running = False
+                return
+            if len(data) == 0:
+                time.sleep(SwoCapture.POLL_INTERVAL)
+                continue
+            self._num_bytes += len(data)
+            self._dispatch(time.perf_counter() - self._time_start, self._decoder.feed(data))
+
+    def __enter__(self) -> 'SwoCapture':
+        self.start()
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.stop()
@@ -18,17 +18,261 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import bisect
+import json
 import logging
+import os
+import re
+import struct
+from pathlib import Path
+from typing import Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.elf_file import ElfFile
+from dottmi.type_cache import TypeCache
+from dottmi.utils import log
 
 logging.basicConfig(level=logging.DEBUG)
 
 
 class BinarySymbols(object):
+    """
+    Symbols of the target binary. Once bound to an ELF file (see bind), symbol lookups are answered from a host-side
+    index of the ELF's symbol table (names, addresses, sizes, types and sections) without a debugger round trip. The
+    index is built once per ELF and, if a cache directory is configured (type_cache_dir), persisted on disk keyed by
+    the ELF's build-id (or hash).
+    """
+    # ELF constants used to parse the symbol table
+    _SHT_SYMTAB = 2
+    _EM_ARM = 40
+    _STT_FUNC = 2
+    _SHN_LORESERVE = 0xff00
+    _SYM_TYPES = {0: 'notype', 1: 'object', 2: 'func', 3: 'section', 4: 'file', 5: 'common', 6: 'tls'}
+
+    # version of the on-disk format; files with a different version are ignored
+    FILE_VERSION = 1
+
+    _IDENTIFIER_RE = re.compile(r'^[A-Za-z_$.][\w$.]*$')
 
-    def __init__(self, target):
+    def __init__(self, target, cache_dir: str = None):
         self._target = target
+        self._cache_dir: str = cache_dir
+        self._key: str = None
+        self._elf_file: str = None
+        self._index: Dict[str, Dict] = None
+        self._funcs: Tuple[str, List[int], List[Tuple[int, str]]] = None  # (key, start addresses, (end, name))
+
+    def bind(self, elf_file: str, manifest: 'DottManifest' = None) -> None:
+        """
+        Binds the symbol index to the given ELF file. The index is taken from the ELF's DOTT manifest (if given),
+        loaded from the cache directory (if available) or built from the ELF's symbol table.
+        """
+        try:
+            key = manifest.key if manifest is not None else TypeCache.elf_key(elf_file)
+        except OSError as ex:
+            log.warn(f'Unable to read {elf_file} ({ex}). Symbol lookups are performed by GDB.')
+            self._key, self._index = None, None
+            return
+        self._elf_file = elf_file
+        if key == self._key and self._index is not None:
+            return
+        self._key = key
+        if manifest is not None:
+            self._index = manifest.symbols
+            return
+
+        file_name = None
+        if self._cache_dir is not None:
+            file_name = Path(self._cache_dir).joinpath(f'dott_symbols_{key}.json')
+            try:
+                with open(file_name, 'r') as f:
+                    content = json.load(f)
+                if content.get('version') == BinarySymbols.FILE_VERSION:
+                    self._index = content['symbols']
+                    return
+            except FileNotFoundError:
+                pass
+            except (OSError, ValueError, KeyError) as ex:
+                log.warn(f'Ignoring unreadable symbol index file {file_name} ({ex}).')
+
+        self._index = ElfFile.open(elf_file).symbols
+
+        if file_name is not None:
+            try:
+                os.makedirs(self._cache_dir, exist_ok=True)
+                tmp_file = f'{file_name}.{os.getpid()}.tmp'
+                with open(tmp_file, 'w') as f:
+                    json.dump({'version': BinarySymbols.FILE_VERSION, 'symbols': self._index}, f)
+                os.replace(tmp_file, file_name)  # atomic replacement; concurrent sessions may share the cache
+            except OSError as ex:
+                log.warn(f'Unable to write symbol index file {file_name} ({ex}).')
+
+    @staticmethod
+    def _elf_str_at(data: bytes, sec: Tuple, offset: int) -> str:
+        start = sec[4] + offset
+        end = data.find(b'\x00', start)  # note: find works for bytes and memory maps
+        return data[start:end if end >= 0 else len(data)].decode(errors='replace')
+
+    @staticmethod
+    def elf_sections(data: bytes) -> Tuple[str, int, List[Tuple], List[str]]:
+        """
+        Parses the section headers of an ELF file. Returns the byte order (struct prefix), the machine, the section
+        headers (name, type, flags, addr, offset, size, link, info, addralign, entsize) and the section names.
+        """
+        bo = '<' if data[5] == 1 else '>'
+        machine, = struct.unpack_from(bo + 'H', data, 0x12)
+        if data[4] == 1:  # 32 bit ELF
+            sh_off, = struct.unpack_from(bo + 'I', data, 0x20)
+            sh_entsize, sh_num, sh_strndx = struct.unpack_from(bo + 'HHH', data, 0x2e)
+            sh_fmt = bo + 'IIIIIIIIII'
+        else:  # 64 bit ELF
+            sh_off, = struct.unpack_from(bo + 'Q', data, 0x28)
+            sh_entsize, sh_num, sh_strndx = struct.unpack_from(bo + 'HHH', data, 0x3a)
+            sh_fmt = bo + 'IIQQQQIIQQ'
+        sections = [struct.unpack_from(sh_fmt, data, sh_off + i * sh_entsize) for i in range(sh_num)]
+        sec_names = [BinarySymbols._elf_str_at(data, sections[sh_strndx], sec[0]) for sec in sections] \
+            if sh_strndx < sh_num else []
+        return bo, machine, sections, sec_names
+
+    @staticmethod
+    def _elf_symbols(data: bytes) -> Dict[str, Dict]:
+        if data[:4] != b'\x7fELF':
+            return {}
+        bo, machine, sections, sec_names = BinarySymbols.elf_sections(data)
+        if data[4] == 1:  # 32 bit ELF
+            sym_fmt, sym_fields = bo + 'IIIBBH', (0, 1, 2, 3, 5)  # name, value, size, info, shndx
+        else:  # 64 bit ELF
+            sym_fmt, sym_fields = bo + 'IBBHQQ', (0, 4, 5, 1, 3)
+
+        def str_at(sec, offset: int) -> str:
+            return BinarySymbols._elf_str_at(data, sec, offset)
+
+        index: Dict[str, Dict] = {}
+        for sec in sections:
+            if sec[1] != BinarySymbols._SHT_SYMTAB or sec[9] == 0:
+                continue
+            strtab = sections[sec[6]]
+            for pos in range(sec[4] + sec[9], sec[4] + sec[5], sec[9]):  # note: entry 0 is the undefined symbol
+                fields = struct.unpack_from(sym_fmt, data, pos)
+                st_name, value, size, info, shndx = (fields[i] for i in sym_fields)
+                name = str_at(strtab, st_name)
+                sym_type = info & 0xf
+                if name == '' or sym_type in (3, 4) or shndx == 0:  # skip unnamed, section, file, undefined symbols
+                    continue
+                if machine == BinarySymbols._EM_ARM and sym_type == BinarySymbols._STT_FUNC:
+                    value &= ~0x1  # Thumb bit
+                sym = {'addr': value, 'size': size, 'type': BinarySymbols._SYM_TYPES.get(sym_type, 'other'),
+                       'section': sec_names[shndx] if shndx < BinarySymbols._SHN_LORESERVE and sec_names else None,
+                       'global': (info >> 4) != 0}
+                # note: global symbols take precedence over local (static) symbols with the same name
+                if name not in index or (sym['global'] and not index[name]['global']):
+                    index[name] = sym
+        return index
+
+    def lookup(self, sym_name: str) -> Dict:
+        """
+        Returns the index entry (dictionary with addr, size, type, section and global) of the given symbol or None if
+        the symbol is not found (or no ELF is bound).
+        """
+        if self._index is None:
+            return None
+        return self._index.get(sym_name)
+
+    def addr(self, sym_name: str) -> int:
+        """
+        Returns the address of the given symbol. A DottException is raised if the symbol is unknown.
+        """
+        return self._get(sym_name)['addr']
+
+    def size(self, sym_name: str) -> int:
+        """
+        Returns the size (in bytes) of the given symbol. A DottException is raised if the symbol is unknown.
+        """
+        return self._get(sym_name)['size']
+
+    def _get(self, sym_name: str) -> Dict:
+        sym = self.lookup(sym_name)
+        if sym is None:
+            raise DottException(f'Symbol {sym_name} not found in the symbol index.')
+        return sym
+
+    def content(self, sym_name: str) -> bytes:
+        """
+        Returns the content of the given symbol (e.g., the code of a function) as stored in the bound ELF file or None
+        if the symbol has no content in the ELF (e.g., zero-initialized data) or is unknown.
+        """
+        sym = self.lookup(sym_name)
+        if sym is None or sym['section'] is None:
+            return None
+        elf = ElfFile.open(self._elf_file)
+        _, _, sections, sec_names = elf.sections
+        sec = sections[sec_names.index(sym['section'])]
+        if sec[1] == 8:  # SHT_NOBITS
+            return None
+        return elf.read(sec[4] + sym['addr'] - sec[3], sym['size'])
+
+    def func_at(self, addr: int) -> str:
+        """
+        Returns the name of the function which contains the given code address or None if the address is not part of
+        any function of the symbol index (e.g., for addresses outside of the binary).
+        """
+        if self._index is None:
+            return None
+        if self._funcs is None or self._funcs[0] != self._key:
+            funcs = sorted((sym['addr'], sym['addr'] + max(sym['size'], 1), name)
+                           for name, sym in self._index.items() if sym['type'] == 'func')
+            self._funcs = (self._key, [start for start, _, _ in funcs], [(end, name) for _, end, name in funcs])
+        _, starts, ends = self._funcs
+        i = bisect.bisect_right(starts, addr) - 1
+        if i >= 0 and addr < ends[i][0]:
+            return ends[i][1]
+        return None
+
+    @property
+    def elf_file(self) -> str:
+        """
+        ELF file the index is bound to (None if no ELF is bound).
+        """
+        return self._elf_file
+
+    @property
+    def key(self) -> str:
+        """
+        Key (build-id or hash) of the ELF file the index is bound to (None if no ELF is bound).
+        """
+        return self._key
+
+    def functions(self) -> Dict[str, int]:
+        """
+        Returns the start addresses of all functions of the symbol index.
+        """
+        if self._index is None:
+            return {}
+        return {name: sym['addr'] for name, sym in self._index.items() if sym['type'] == 'func'}
+
+    def labels(self, prefix: str = 'DOTT_LABEL_') -> List[str]:
+        """
+        Returns the names of all code labels (e.g., set with DOTT_LABEL in the target code) with the given prefix.
+        """
+        if self._index is None:
+            return []
+        return sorted(n for n, sym in self._index.items() if n.startswith(prefix) and sym['type'] == 'notype')
+
+    def gdb_location(self, location: str) -> str:
+        """
+        Returns the location as passed to GDB when creating a breakpoint. Code labels (symbols without type such as
+        the ones set with DOTT_LABEL) are resolved to their address using the symbol index such that GDB does not
+        have to look them up. Functions are not resolved as GDB places function breakpoints after the prologue.
+        """
+        sym = self.lookup(location.strip())
+        if sym is not None and sym['type'] == 'notype':
+            return f'*{sym["addr"]:#x}'
+        return location
 
     def exists(self, sym_name: str) -> bool:
+        # plain symbol names are answered by the index; everything else (e.g., file:line) is resolved by GDB
+        if self._index is not None and BinarySymbols._IDENTIFIER_RE.match(sym_name.strip()):
+            return sym_name.strip() in self._index
         try:
             self._target.cli_exec(f'info address {sym_name}')
             return True
@@ -20,25 +20,65 @@
 
 import logging
 import os
+import re
 import threading
 import time
+import zlib
+import contextlib
 import datetime
-from pathlib import Path, PurePosixPath
-from typing import Dict, Union
+import json
+import shutil
+import struct
+import tempfile
+from pathlib import Path
+from typing import Dict, Tuple, Union
 from typing import List
 
-from dottmi.breakpointhandler import BreakpointHandler
+from dottmi.batch import TargetBatch
+from dottmi.bench import BenchResult
+from dottmi.breakpointhandler import BreakpointHandler, BreakpointManager, BreakpointRegistry, InterceptPointChannel
 from dottmi.dott import DottConf
-from dottmi.dottexceptions import DottException
+from dottmi.dottexceptions import DottConnectionError, DottException, TargetFaultException
+from dottmi.elf_file import ElfFile
+from dottmi.flash_image import FlashImage, FlashStateCache
+from dottmi.flash_loader import FlashLoader
 from dottmi.gdb import GdbClient, GdbServer, GdbServerQuirks
 from dottmi.gdb_mi import NotifySubscriber
+from dottmi.manifest import DottManifest
+from dottmi.periph import Peripherals
 from dottmi.symbols import BinarySymbols
-from dottmi.target_mem import TargetMem, TargetMemNoAlloc
+from dottmi.target_mem import TargetMem, TargetMemCache, TargetMemNoAlloc, TargetMemVectorCache
+from dottmi.tdesc_cache import TargetDesc, TargetDescCache
+from dottmi.timeline import timeline
+from dottmi.type_cache import TypeCache
 from dottmi.utils import cast_str, log
 
 logging.basicConfig(level=logging.DEBUG)
 
 
+class TargetHealthMonitor(threading.Thread):
+    """
+    Periodically checks if the GDB client and the GDB server of a target are still alive (see Target.check_health).
+    Once the connection is lost, pending and subsequent target commands (and waits for breakpoints) fail right away
+    instead of running into their timeouts. Since GDB does not answer while busy with long-running commands, the
+    monitor does not send heartbeats but only checks the involved processes and connections.
+    """
+    def __init__(self, target: 'Target', interval: float) -> None:
+        super().__init__(name='TargetHealthMonitor', daemon=True)
+        self._target: 'Target' = target
+        self._interval: float = interval
+        self._stop_event: threading.Event = threading.Event()
+
+    def stop(self) -> None:
+        self._stop_event.set()
+
+    def run(self) -> None:
+        while not self._stop_event.wait(self._interval):
+            if not self._target.check_health(heartbeat=False):
+                break
+
+
+# ----------------------------------------------------------------------------------------------------------------------
 class Target(NotifySubscriber):
 
     def __init__(self, gdb_server: GdbServer, gdb_client: GdbClient, auto_connect: bool = True) -> None:
@@ -50,31 +90,77 @@ class Target(NotifySubscriber):
         NotifySubscriber.__init__(self)
         self._load_elf_file_name = None
         self._symbol_elf_file_name = None
+        self._symbol_elf_loaded: Tuple = None  # (file name, mtime, size, ELF key) of the symbols loaded into GDB
+        self._symbol_reload_skipped: bool = False
+        self._gdb_mem_regions: List[List[int]] = None  # cached memory regions configured in GDB (see gdb_mem_cache)
+        self._link_rtt: float = None  # round trip time of the link to a remote GDB server (see link_rtt)
+        self._link_batching: bool = False
 
         self._gdb_client: GdbClient = gdb_client
         self._gdb_server: GdbServer = gdb_server
+        # board the target is connected to (kept to be able to recover a lost connection, see recover)
+        self._device_name: str = None if gdb_server is None else gdb_server.device_id
+        self._serial_number: str = None if gdb_server is None else gdb_server.serial_number
 
         # condition variable and status flag used to implement helpers
         # allowing callers to wait until target is stopped or running
         self._cv_target_state: threading.Condition = threading.Condition()
         self._is_target_running: bool = True
+        self._stop_count: int = 0  # number of 'stopped' notifications processed so far
+        self._halt_confirmed_count: int = 0  # stop (count) for which GDB's internal state was confirmed as halted
+        self._fault_stop_count: int = -1  # stop (count) at which the target halted in DOTT's fault hook (see fault)
+
+        # multi-core targets (see add_core): MI context option prepended to the options of this core's commands (e.g.,
+        # '--thread 1'), GDB threads of this core (None: all notifications concern this target) and the added cores
+        self._mi_context: str = ''
+        self._thread_ids: List[str] = None
+        self._cores: Dict[str, 'TargetCore'] = {}
 
         # Default number of seconds to wait for a target state change (i.e., halt -> running and vice versa) before
         # raising a timeout exception.
         self._state_change_wait_secs: float = 5.0
 
         # instantiate delegates
-        self._symbols: BinarySymbols = BinarySymbols(self)
+        self._symbols: BinarySymbols = BinarySymbols(self, DottConf.conf.get('type_cache_dir'))
+        self._type_cache: TypeCache = TypeCache(DottConf.conf.get('type_cache_dir'))
+        self._flash_state: FlashStateCache = FlashStateCache(DottConf.conf.get('flash_state_dir'))
+        self._sram_images: Dict[str, Tuple[str, FlashImage]] = {}  # (ELF key, image) of SRAM-resident load ELFs
+        self._call_stub: Dict = None  # addresses of the resident call stub (see call)
+        self._call_addrs: Dict[str, int] = {}
+        self._call_saved_regs: Dict = None
+        self._call_session_depth: int = 0
+        self._call_func: int = None  # function of the pending call (see call_start)
+        self._call_stop_count: int = 0
+        self._reg_names: List[str] = None
+        self._reg_cache: Dict[str, Union[int, str]] = None  # register values of the current stop (see reg_get)
+        self._reg_cache_stop: int = -1  # stop (count) for which the register cache is valid
+        self._stop_regs_id: int = None  # response id of the registers GDB captures at every stop (see halt)
+        self._stop_regs: Tuple[int, Dict[str, int]] = None  # (stop count, registers) captured at the last halt
         self._mem: TargetMem = TargetMemNoAlloc(self)
+        self._mem_cache: TargetMemCache = None
+        self._vector_cache: TargetMemVectorCache = TargetMemVectorCache()
+        self._mem_write_compress: bool = bool(DottConf.conf.get('mem_write_compress', False))
+        self._periph: Peripherals = None
+        self._rtos: Tuple[str, 'Rtos'] = None  # (key of the symbol ELF, detected RTOS plugin)
+        self._probe_broker = None  # broker of a live access connection to the same probe (see ProbeBroker)
+        self._wait_direct = None  # live access used by wait_until if mem has no direct connection
+        self._clock_lock: threading.RLock = threading.RLock()
+        self._clock_phases: List[str] = []  # active clock phases (see clock_phase)
+        self._clock_khz: int = None  # interface speed currently set (None: switching disabled or not used yet)
+        self._clock_launch_khz: int = None  # interface speed the GDB server was launched with
 
         # start breakpoint handler
-        self._bp_handler: BreakpointHandler = BreakpointHandler()
-        self._gdb_client.gdb_mi.response_handler.notify_subscribe(self._bp_handler, 'stopped', 'breakpoint-hit')
-        self._bp_handler.start()
+        self._bp_handler: BreakpointHandler = self._bp_handler_start()
+
+        # breakpoint manager which keeps track of the hardware breakpoint comparators
+        self._bp_manager: BreakpointManager = BreakpointManager(self, DottConf.conf.get('hw_breakpoints', 4))
+
+        # channel for intercept points (created when the first intercept point is created)
+        self._ip_channel: InterceptPointChannel = None
+        self._ip_channel_lock: threading.Lock = threading.Lock()
 
-        # register to get notified if the target state changes
-        self._gdb_client.gdb_mi.response_handler.notify_subscribe(self, 'stopped', None)
-        self._gdb_client.gdb_mi.response_handler.notify_subscribe(self, 'running', None)
+        # register to get notified about breakpoint hits and target state changes
+        self._subscribe_notifications()
 
         # delay after device startup / continue
         self._startup_delay: float = 0.0
@@ -84,9 +170,28 @@ class Target(NotifySubscriber):
 
         self._gdb_srv_quirks: GdbServerQuirks = None
 
+        # connection health (see check_health); the monitor is started once the GDB client is connected
+        self._connection_lost: bool = False
+        self._health_monitor: TargetHealthMonitor = None
+
         if auto_connect:
             self.gdb_client_connect()
 
+    def _bp_handler_start(self) -> BreakpointHandler:
+        bp_handler = BreakpointHandler()
+        bp_handler.start()
+        return bp_handler
+
+    def _subscribe_notifications(self) -> None:
+        response_handler = self._gdb_client.gdb_mi.response_handler
+        response_handler.notify_subscribe(self._bp_handler, 'stopped', 'breakpoint-hit')
+        for reason in BreakpointHandler.WATCH_REASONS:
+            response_handler.notify_subscribe(self._bp_handler, 'stopped', reason)
+        response_handler.notify_subscribe(self, 'stopped', None)
+        response_handler.notify_subscribe(self, 'running', None)
+        for notification in BreakpointRegistry._NOTIFICATIONS:
+            response_handler.notify_subscribe(self._bp_handler.registry, notification, None)
+
     def gdb_client_connect(self) -> None:
         """
         Connects the GDB client instance to the GDB server.
@@ -96,24 +201,143 @@ class Target(NotifySubscriber):
                                 'it again you may need to create and set a new GDB server instance (because DOTT '
                                 'auto-launches JLINK GDB server in singlerun mode.')
 
+        # target description and memory map recorded by a previous connect (see gdb_tdesc_cache)
+        tdesc_cache, tdesc_key, tdesc = None, None, None
+        if DottConf.conf.get('gdb_tdesc_cache') and DottConf.conf.get('gdb_replay_file') is None:
+            tdesc_cache = TargetDescCache(DottConf.conf.get('flash_state_dir') or tempfile.gettempdir())
+            tdesc_key = (self._device_name, type(self._gdb_server).__name__, self._serial_number)
+            tdesc = tdesc_cache.load(tdesc_key)
+
+        attach_only: bool = DottConf.conf.get('attach_only', False)
+        start = time.perf_counter()
+        self.exec('-gdb-set mi-async on', timeout=5)
+        if DottConf.conf.get('gdb_non_stop') or attach_only:
+            # note: has to be set before connecting; lets the cores of a multi-core target run independently and
+            # makes GDB attach to a running target without stopping it (attach_only)
+            self.exec('-gdb-set non-stop on', timeout=5)
+        if tdesc is not None:
+            self._tdesc_apply(tdesc)
         try:
-            self.exec('-gdb-set mi-async on', timeout=5)
             self.exec(f'-target-select remote {self._gdb_server.addr}:{self._gdb_server.port}', timeout=5)
-            self.cli_exec('set mem inaccessible-by-default off', timeout=1)
         except Exception as ex:
-            raise ex
+            if tdesc is None:
+                raise ex
+            log.warn(f'Connect with recorded target description failed ({ex}). Retrying without it.')
+            tdesc_cache.invalidate(tdesc_key)
+            tdesc = None
+            self._tdesc_apply(None)
+            self.exec(f'-target-select remote {self._gdb_server.addr}:{self._gdb_server.port}', timeout=5)
+        self.cli_exec('set mem inaccessible-by-default off', timeout=1)
+        if attach_only:
+            self._attach_state_sync()
 
         # source script with custom GDB commands (custom Python commands executed in GDB context)
-        my_dir = Path(__file__).absolute().parent
-        gdb_script_file = my_dir.joinpath('./gdb_cmds.py')
+        if not self._gdb_client.gdb_cmds_loaded:
+            self.cli_exec(f'source {GdbClient.gdb_cmds_script()}')
+            _, version = self.exec_dott('dott-python-version', timeout=5)
+            log.info(f'GDB commands loaded (GDB-internal Python {version}).')
 
-        # note: GDB expects paths to be POSIX-formatted.
-        gdb_script_file = str(PurePosixPath(gdb_script_file))
-        self.cli_exec(f'source {gdb_script_file}')
+        if tdesc_cache is not None and tdesc is None:
+            try:
+                tdesc_cache.save(tdesc_key, self.cli_capture('maint print xml-tdesc'), self.cli_capture('info mem'))
+            except DottException as ex:
+                log.debug(f'Target description not recorded ({ex}).')
 
         self._gdb_srv_quirks = GdbServerQuirks.instantiate_quirks(self)
         self._gdb_client_is_connected = True
 
+        self._link_rtt, self._link_batching = None, False
+        threshold = DottConf.conf.get('remote_rtt_threshold', 0)
+        if threshold and str(self._gdb_server.addr or '') not in Target._LOCAL_ADDRS and not self.is_running():
+            self._link_rtt = self._link_rtt_measure()
+            self._link_batching = self._link_rtt * 1000 >= threshold
+            log.info(f'GDB server link RTT:   {self._link_rtt * 1000:.1f}ms'
+                     f'{" (batched transfers)" if self._link_batching else ""}')
+
+        if (DottConf.conf.get('gdb_packet_tune') or self._link_batching) and not self.is_running():
+            from dottmi.probe_speed import PacketSizeTuner
+            try:
+                size, throughput, _ = PacketSizeTuner(self, DottConf.conf['jlink_speed_tune_region']).tune()
+                log.info(f'GDB packet size:       {size} bytes ({throughput / 1024:.0f} KiB/s read throughput)')
+            except Exception as ex:
+                log.warn(f'GDB packet size tuning failed ({ex}).')
+
+        interval = DottConf.conf.get('health_check_interval', 0)
+        if interval and self._health_monitor is None:
+            self._health_monitor = TargetHealthMonitor(self, interval)
+            self._health_monitor.start()
+
+        if attach_only:
+            log.info(f'Attached to {"running" if self.is_running() else "halted"} target in '
+                     f'{time.perf_counter() - start:.3f}s (attach only).')
+
+    # GDB server addresses which are considered local (i.e., the link latency is not measured)
+    _LOCAL_ADDRS = ('', 'localhost', '127.0.0.1', '::1')
+
+    # number of remote protocol round trips used to measure the link latency (the fastest one is taken)
+    _LINK_RTT_SAMPLES = 5
+
+    def _link_rtt_measure(self) -> float:
+        # round trip time (seconds) of a minimal remote protocol packet (qC, current thread) which is answered by the
+        # GDB server without accessing the target; includes the (local) MI exchange with GDB
+        rtts: List[float] = []
+        for _ in range(Target._LINK_RTT_SAMPLES):
+            start = time.perf_counter()
+            self.cli_exec('maint packet qC', timeout=5)
+            rtts.append(time.perf_counter() - start)
+        return min(rtts)
+
+    @property
+    def link_rtt(self) -> float:
+        """
+        Round trip time (seconds) of the link to a remote GDB server as measured when connecting (None for local GDB
+        servers or if remote_rtt_threshold is 0). If it exceeds remote_rtt_threshold (dott.ini), transfers are
+        batched (link_batching): GDB's packet size is tuned and GDB's data cache is used for the memory of the image
+        with large cache lines, i.e., fewer remote protocol packets are exchanged.
+        """
+        return self._link_rtt
+
+    @property
+    def link_batching(self) -> bool:
+        return self._link_batching
+
+    def _attach_state_sync(self) -> None:
+        # Without a 'stopped' notification on connect (non-stop attach), the initial state of the target is taken from
+        # GDB's thread list (the target is not halted by DOTT).
+        res = self.exec('-thread-info')
+        running = any(t.get('state') == 'running' for t in res['payload'].get('threads', []))
+        with self._cv_target_state:
+            if running != self._is_target_running:
+                self._is_target_running = running
+                if not running:
+                    self._stop_count += 1
+            self._cv_target_state.notify_all()
+
+    def _tdesc_apply(self, tdesc: TargetDesc) -> None:
+        # Makes GDB use the recorded target description instead of fetching it from the GDB server. The memory map is
+        # supplied as user-defined memory regions only if it has no flash regions since GDB only programs flash
+        # (e.g., -target-download) in regions of the server's memory map. tdesc None restores the defaults.
+        if tdesc is None:
+            self.cli_exec('unset tdesc filename')
+            self.cli_exec('set remote memory-map-packet auto')
+            self.cli_exec('delete mem')
+            return
+        self.cli_exec(f'set tdesc filename {self._gdb_client.file_path(tdesc.xml_file)}')
+        if len(tdesc.regions) > 0 and not any(r.flash for r in tdesc.regions):
+            self.cli_exec('set remote memory-map-packet off')
+            for r in tdesc.regions:
+                self.cli_exec(f'mem {r.start:#x} {r.end:#x} {r.attrs}')
+
+    def cli_capture(self, cmd: str, timeout: float = None) -> str:
+        """
+        Executes a GDB CLI command and returns its console output.
+        """
+        status, payload = self.exec_dott('dott-exec-capture', cmd.encode().hex(), timeout=timeout)
+        payload = bytes.fromhex(payload).decode(errors='replace')
+        if status != 'OK':
+            raise DottException(f'GDB command {cmd} failed ({payload}).')
+        return payload
+
     def gdb_client_disconnect(self) -> None:
         """
         Disconnects the GDB client from the GDB server. The target is not resumed.
@@ -155,16 +379,190 @@ class Target(NotifySubscriber):
         Disconnect first closes the GDB client connection and then terminates the GDB server. The target is not resumed.
         After calling disconnect, the target instance can no longer be used (i.e., there is not reconnect).
         """
+        self._type_cache.save()
+        self._health_monitor_stop()
+        for core in self._cores.values():
+            core.disconnect()
         if self._gdb_client is not None:
-            self.exec_noblock('-gdb-exit')
+            try:
+                self.exec_noblock('-gdb-exit')
+            except DottConnectionError:
+                pass
             self._gdb_client.gdb_mi.shutdown()
             self._bp_handler.stop()
+            self.notify_stop()
+            if self._ip_channel is not None:
+                self._ip_channel.close()
+                self._ip_channel = None
             self._gdb_client = None
             self._gdb_client_is_connected = False
         if self._gdb_server is not None:
             self._gdb_server.shutdown()
             self._gdb_server = None
 
+    ###############################################################################################
+    # Multi-core targets
+
+    # GDB inferior (thread group) of the target the GDB client connects to first
+    _PRIMARY_INFERIOR = 'i1'
+
+    def _group_threads(self, group: str) -> List[str]:
+        res = self._gdb_client.gdb_mi.write_blocking(f'-list-thread-groups {group}')
+        return [t['id'] for t in res['payload'].get('threads', [])]
+
+    def add_core(self, name: str, gdb_server: GdbServer) -> 'TargetCore':
+        """
+        Adds a further core of a multi-core MCU to the GDB session of this target. The core is connected (as GDB
+        inferior) to the given GDB server (e.g., a second J-Link GDB server instance for the core or the per-core port
+        of OpenOCD) and is controlled by the returned TargetCore which offers the interface of Target (load, eval, mem,
+        halt/cont, registers, ...). Breakpoints created for the core (HaltPoint(..., target=core)) only halt at hits
+        of this core. Afterwards, the commands of each core are issued with an explicit MI thread context.
+        Note: The cores only run and halt independently of each other if GDB's non-stop mode is enabled (gdb_non_stop
+        in dott.ini; requires non-stop support of the GDB servers). Otherwise, GDB halts and resumes all cores
+        together.
+
+        Args:
+            name: Name of the core (see core).
+            gdb_server: GDB server of the core.
+
+        Returns:
+            The core.
+        """
+        from dottmi.target_core import TargetCore
+        if name in self._cores:
+            raise DottException(f'A core named {name} has already been added.')
+        if self._thread_ids is None:
+            self._thread_ids = self._group_threads(Target._PRIMARY_INFERIOR)
+            if len(self._thread_ids) == 0:
+                raise DottException('Unable to determine the GDB thread of the target.')
+            self._mi_context = f'--thread {self._thread_ids[0]}'
+            if not DottConf.conf.get('gdb_non_stop'):
+                # note: in all-stop mode, -exec-continue otherwise only resumes the inferior of the command
+                self.cli_exec('set schedule-multiple on')
+        core = TargetCore(self, name, gdb_server)
+        self._cores[name] = core
+        return core
+
+    @property
+    def cores(self) -> Dict[str, 'TargetCore']:
+        """
+        Cores added to the GDB session of this target (name -> core; see add_core).
+        """
+        return dict(self._cores)
+
+    def core(self, name: str) -> 'TargetCore':
+        if name not in self._cores:
+            raise DottException(f'No core named {name} (added cores: {", ".join(self._cores) or "none"}).')
+        return self._cores[name]
+
+    @property
+    def thread_ids(self) -> List[str]:
+        """
+        GDB threads of this core (None as long as no further core has been added, see add_core).
+        """
+        return self._thread_ids
+
+    ###############################################################################################
+    # Connection health
+
+    @property
+    def connection_lost(self) -> bool:
+        """
+        Returns True if the connection to GDB or the GDB server has been found to be lost (see check_health).
+        """
+        return self._connection_lost or self._gdb_client is None or self._gdb_client.gdb_mi.connection_lost
+
+    def check_health(self, heartbeat: bool = True, timeout: float = 1.0) -> bool:
+        """
+        Checks if the GDB client and the GDB server of the target are still alive. If heartbeat is True, GDB is also
+        required to answer a cheap MI command (answered by GDB itself) within the given timeout. Note that GDB does
+        not answer while it is busy with a long-running command (e.g., a download); hence, the heartbeat should only
+        be used while no other command is in flight.
+        If the connection is found to be lost, all threads waiting for GDB and all subsequent commands fail with a
+        DottConnectionError. The connection can then be re-established with recover (done automatically by DOTT's
+        fixtures at the end of a test).
+
+        Returns:
+            True if the connection is healthy, False otherwise.
+        """
+        if self._gdb_client is None or self._connection_lost:
+            return False
+        reason: str = None
+        if self._gdb_client.gdb_mi.connection_lost:
+            reason = 'GDB has terminated'
+        elif self._gdb_server is not None and not self._gdb_server.is_alive():
+            reason = 'GDB server has terminated'
+        elif heartbeat and not self._gdb_client.gdb_mi.heartbeat(timeout):
+            reason = f'GDB did not respond within {timeout}s'
+        if reason is None:
+            return True
+
+        log.error(f'Connection to target lost ({reason})!')
+        self._connection_lost = True
+        self._gdb_client.gdb_mi.abort()
+        return False
+
+    def _health_monitor_stop(self) -> None:
+        if self._health_monitor is not None:
+            self._health_monitor.stop()
+            self._health_monitor = None
+
+    def recover(self, gdb_server: GdbServer, gdb_client: GdbClient) -> None:
+        """
+        Replaces the GDB server and the GDB client of a target whose connection has been lost (see check_health) and
+        connects the new ones. The previous GDB client and server are terminated. Breakpoints, intercept points and any
+        state cached from the target are discarded; the target binary has to be loaded again afterwards. Usually,
+        Dott().recover_target, which creates the new GDB server and client, is used instead of calling this directly.
+
+        Args:
+            gdb_server: New GDB server instance (as created by Dott().create_gdb_server).
+            gdb_client: New, already connected GDB client instance.
+        """
+        from dottmi.breakpoint import InterceptPoint
+
+        self._health_monitor_stop()
+        if self._ip_channel is not None:
+            self._ip_channel.close()
+            self._ip_channel = None
+        InterceptPoint.discard_all(self)
+        if self._gdb_client is not None:
+            self._gdb_client.gdb_mi.terminate()
+        if self._gdb_server is not None:
+            try:
+                self._gdb_server.shutdown()
+            except Exception as ex:
+                log.warn(f'Shutdown of previous GDB server failed ({ex}).')
+
+        self._gdb_server = gdb_server
+        self._gdb_client = gdb_client
+        self._gdb_client_is_connected = False
+        self._connection_lost = False
+        with self._cv_target_state:
+            self._is_target_running = True
+        self._bp_manager = BreakpointManager(self, DottConf.conf.get('hw_breakpoints', 4))
+        self._bp_handler.registry.clear()
+        # note: the restarted GDB server runs at its launch speed again (see clock_phase)
+        with self._clock_lock:
+            self._clock_khz = None
+            self._clock_launch_khz = None
+        self._mem_cache = None if self._mem_cache is None else TargetMemCache(self, self._mem_cache.page_size,
+                                                                              self._mem_cache.prefetch)
+        self._sram_images = {}
+        self._symbol_elf_loaded = None
+        self._gdb_mem_regions = None
+        self._call_stub = None
+        self._call_addrs = {}
+        self._call_saved_regs = None
+        self._call_session_depth = 0
+        self._call_func = None
+        self._reg_names = None
+        self._reg_cache = None
+        self._stop_regs_id = None
+        self._stop_regs = None
+        self._subscribe_notifications()
+        self.gdb_client_connect()
+        log.info('Connection to target re-established.')
+
     ###############################################################################################
     # Properties
 
@@ -172,6 +570,18 @@ class Target(NotifySubscriber):
     def gdb_client(self):
         return self._gdb_client
 
+    @property
+    def device_name(self) -> str:
+        return self._device_name
+
+    @property
+    def serial_number(self) -> str:
+        return self._serial_number
+
+    @property
+    def gdb_server(self) -> GdbServer:
+        return self._gdb_server
+
     @property
     def symbols(self) -> BinarySymbols:
         return self._symbols
@@ -188,10 +598,216 @@ class Target(NotifySubscriber):
             raise DottException('mem has to be an instance of TargetMem')
         self._mem = target_mem
 
+    @property
+    def type_cache(self) -> TypeCache:
+        return self._type_cache
+
+    @property
+    def periph(self) -> Peripherals:
+        """
+        Returns the SVD-based peripheral model of the target (see Peripherals; requires svd_file in dott.ini).
+        """
+        if self._periph is None:
+            if DottConf.conf.get('svd_file') is None:
+                raise DottException('No SVD file configured (svd_file in dott.ini).')
+            self._periph = Peripherals(self, DottConf.conf['svd_file'], DottConf.conf.get('device_endianess', 'little'))
+        return self._periph
+
+    @property
+    def rtos(self) -> 'Rtos':
+        """
+        Returns the RTOS awareness plugin (see rtos.py) for the RTOS found in the target binary or None if no
+        supported RTOS is found. The plugin is detected once per symbol ELF.
+        """
+        if self._rtos is None or self._rtos[0] != self.symbols.key:
+            from dottmi.rtos import Rtos
+            self._rtos = (self.symbols.key, Rtos.detect(self))
+        return self._rtos[1]
+
+    @property
+    def probe_broker(self) -> 'ProbeBroker':
+        """
+        Broker of the live access (pylink) connection to the target's probe (set by ProbeBroker.acquire). Live
+        accesses are paused while run-control operations (halt, continue, reset, download) are performed.
+        """
+        return self._probe_broker
+
+    @probe_broker.setter
+    def probe_broker(self, broker: 'ProbeBroker') -> None:
+        self._probe_broker = broker
+
+    # phases of clock_phase; their interface speeds are configured with jlink_speed_<phase> (dott.ini)
+    CLOCK_PHASES = ('bulk', 'safe')
+
+    @contextlib.contextmanager
+    def clock_phase(self, phase: str):
+        """
+        Context manager which runs the with block at the interface speed of the given phase: 'bulk' for transfers
+        limited by the interface speed (download, large memory transfers, snapshot restore) and 'safe' for phases
+        sensitive to it (reset, low-power modes of the firmware). The speed is switched to jlink_speed_bulk or
+        jlink_speed_safe (dott.ini) with a monitor command of the GDB server and switched back at the end of the
+        phase; the command is only issued if the speed actually changes. DOTT runs downloads, large transfers and
+        snapshot restores as bulk and resets as safe phase; low-power phases have to be marked by the test, e.g.:
+
+            with dt.clock_phase('safe'):
+                dt.cont()
+                ...
+                dt.halt()
+
+        Phases can be nested and a safe phase takes precedence over bulk phases (i.e., a large transfer during a
+        low-power phase keeps the safe speed). Nothing is switched if no phase speed is configured, the GDB server does
+        not support speed changes or the target is running (GDB cannot send monitor commands while the target runs).
+
+        Args:
+            phase: 'bulk', 'safe' or None (the with block runs at the current speed).
+        """
+        if phase is not None and phase not in Target.CLOCK_PHASES:
+            raise ValueError(f'Unknown clock phase {phase} (expected one of {", ".join(Target.CLOCK_PHASES)}).')
+        if phase is None or not self._clock_enabled():
+            yield
+            return
+        with self._clock_lock:
+            self._clock_phases.append(phase)
+            self._clock_apply()
+        try:
+            yield
+        finally:
+            with self._clock_lock:
+                self._clock_phases.remove(phase)
+                self._clock_apply()
+
+    def _clock_enabled(self) -> bool:
+        # checks (once) whether per-phase speed switching is configured and supported by the GDB server
+        if self._clock_khz is not None:
+            return True
+        if self._clock_launch_khz is not None or all(DottConf.conf.get(f'jlink_speed_{p}') is None
+                                                     for p in Target.CLOCK_PHASES):
+            return False
+        with self._clock_lock:
+            speed = self._gdb_server.speed if self._gdb_server is not None else None
+            speed = str(speed if speed is not None else DottConf.conf.get('jlink_speed', '')).strip()
+            if self._gdb_srv_quirks.monitor_speed(0) is None:
+                log.warn('The GDB server does not support changing the interface speed; jlink_speed_bulk and '
+                         'jlink_speed_safe are ignored.')
+            elif not speed.isdigit():
+                log.warn(f'The launch interface speed of the GDB server is unknown ({speed}); jlink_speed_bulk and '
+                         f'jlink_speed_safe are ignored.')
+            else:
+                self._clock_khz = int(speed)
+            # note: the launch speed is also set if switching is not possible such that the check is done once
+            self._clock_launch_khz = int(speed) if speed.isdigit() else 0
+        return self._clock_khz is not None
+
+    def _clock_apply(self) -> None:
+        # switches to the interface speed of the active clock phases (launch speed outside of any phase)
+        phase = 'safe' if 'safe' in self._clock_phases else 'bulk' if 'bulk' in self._clock_phases else None
+        khz = DottConf.conf.get(f'jlink_speed_{phase}') if phase is not None else None
+        khz = khz if khz is not None else self._clock_launch_khz
+        if khz == self._clock_khz:
+            return
+        if self.is_running():
+            # note: the speed is switched with the next phase change while the target is halted
+            log.debug(f'Target is running; interface speed stays at {self._clock_khz} kHz.')
+            return
+        try:
+            self.cli_exec(self._gdb_srv_quirks.monitor_speed(khz))
+        except DottException as ex:
+            log.warn(f'Switching the interface speed to {khz} kHz failed ({ex}).')
+            return
+        log.debug(f'Interface speed switched from {self._clock_khz} kHz to {khz} kHz ({phase or "launch"}).')
+        self._clock_khz = khz
+
+    @contextlib.contextmanager
+    def _run_control(self):
+        # performs a run-control operation with higher priority than concurrent live accesses (see ProbeBroker)
+        broker = self._probe_broker
+        if broker is None:
+            yield
+        else:
+            with broker.control():
+                yield
+
+    @property
+    def mem_cache(self) -> TargetMemCache:
+        """
+        Returns the host-side target memory cache or None if the cache is not enabled.
+        """
+        return self._mem_cache
+
+    def mem_cache_enable(self, page_size: int = TargetMemCache.PAGE_SIZE, prefetch: bool = False) -> TargetMemCache:
+        """
+        Enables the host-side target memory cache (see TargetMemCache) and returns it. With prefetch, the cache learns
+        the pages accessed at each breakpoint location and prefetches them with one transfer on subsequent hits. For
+        example:
+            cache = dt.mem_cache_enable(prefetch=True)
+            bp = HaltPoint('app_Process')
+            for _ in range(100):
+                dt.cont()
+                bp.wait_complete()
+                state, buf = cache.read(p_state, 16), cache.read(p_buf, 64)  # one transfer from the second hit on
+        """
+        if self._mem_cache is None:
+            self._mem_cache = TargetMemCache(self, page_size, prefetch)
+        return self._mem_cache
+
+    def mem_cache_disable(self) -> None:
+        """
+        Writes back all modifications held in the host-side target memory cache and disables the cache.
+        """
+        if self._mem_cache is not None:
+            self._mem_cache.sync()
+            self._mem_cache = None
+
+    def _mem_cache_sync(self) -> None:
+        # called before commands which resume the target or might modify target memory
+        if self._mem_cache is not None:
+            self._mem_cache.sync()
+
+    @property
+    def mem_write_compress(self) -> bool:
+        """
+        If set, large memory writes of TargetMem are expanded on the target by the batch executor (fills) or uploaded
+        run-length encoded (see TargetMem.write). Default: mem_write_compress option of the DOTT configuration.
+        """
+        return self._mem_write_compress
+
+    @mem_write_compress.setter
+    def mem_write_compress(self, enable: bool) -> None:
+        self._mem_write_compress = enable
+
+    @property
+    def vector_cache(self) -> TargetMemVectorCache:
+        """
+        Record of the data vectors uploaded to target memory (see TargetMem.upload).
+        """
+        return self._vector_cache
+
+    @property
+    def gdb_srv_quirks(self) -> GdbServerQuirks:
+        return self._gdb_srv_quirks
+
     @property
     def bp_handler(self) -> BreakpointHandler:
         return self._bp_handler
 
+    @property
+    def bp_manager(self) -> BreakpointManager:
+        return self._bp_manager
+
+    @property
+    def bp_registry(self) -> BreakpointRegistry:
+        """
+        Host-side table of the breakpoints known to GDB (see BreakpointRegistry).
+        """
+        return self._bp_handler.registry
+
+    @property
+    def ip_channel(self) -> InterceptPointChannel:
+        with self._ip_channel_lock:
+            if self._ip_channel is None:
+                self._ip_channel = InterceptPointChannel(self, DottConf.conf.get('bp_channel_shm', False))
+            return self._ip_channel
+
     @property
     def byte_order(self) -> str:
         return DottConf.get('device_endianess')
@@ -218,6 +834,10 @@ class Target(NotifySubscriber):
     ###############################################################################################
     # General-purpose wrappers for on target command execution/evaluation
 
+    # expressions which only read a register (served by the register cache) and expressions with an assignment
+    _REG_EXPR_RE = re.compile(r'^\s*\$(\w+)\s*$')
+    _ASSIGN_RE = re.compile(r'(?<![=!<>])=(?!=)|<<=|>>=')
+
     def eval(self, expr: str, timeout: float = None) -> Union[int, float, bool, str, None]:
         """
         This method takes an expression to be evaluated. It is assumed that the target is halted when calling eval.
@@ -238,7 +858,137 @@ class Target(NotifySubscriber):
         Returns:
             The evaluation result converted to a suitable Python data type.
         """
-        res = self.exec(f'-data-evaluate-expression "{expr}"', timeout=timeout)
+        m = Target._REG_EXPR_RE.match(expr)
+        if m is not None and not self.is_running():
+            val = self.reg_get(m.group(1))
+            if val is not None:
+                return val
+        elif Target._ASSIGN_RE.search(expr) is not None:
+            self.reg_cache_invalidate()  # note: the expression might modify a register
+
+        self._mem_cache_sync()
+        try:
+            res = self.exec(f'-data-evaluate-expression "{expr}"', timeout=timeout)
+        except Exception:
+            self.check_fault()  # e.g., a called function faulted
+            raise
+        return self._eval_res_to_py(expr, res)
+
+    def eval_many(self, exprs: List[str], timeout: float = None) -> List[Union[int, float, bool, str, None]]:
+        """
+        Pipelined variant of eval. All expressions are sent to GDB back-to-back and the results are collected
+        afterwards. This is considerably faster than calling eval for each expression individually, e.g., when
+        reading many global variables or when setting up many struct members.
+        For example:
+          t.eval_many(['p->a = 55', 'p->b = 22', 'p->sum = 0'])
+          a, b = t.eval_many(['glob_a', 'glob_b'])
+
+        Args:
+            exprs: The expressions to be evaluated (in the given order) in the current context of the target.
+            timeout: Optional timeout applied while waiting for each individual result.
+
+        Returns:
+            List with the evaluation results converted to suitable Python data types.
+        """
+        if any(Target._ASSIGN_RE.search(expr) is not None for expr in exprs):
+            self.reg_cache_invalidate()  # note: the expressions might modify registers
+        self._mem_cache_sync()
+        results = self.exec_many([f'-data-evaluate-expression "{expr}"' for expr in exprs], timeout=timeout)
+        return [self._eval_res_to_py(expr, res) for expr, res in zip(exprs, results)]
+
+    def prepare(self, expr: str) -> 'PreparedExpr':
+        """
+        Prepares the given expression for repeated access. An expression denoting a global variable (or a member or
+        element of it with constant indices, e.g., '_tick_cnt' or '_data[3]') is resolved once to its address and type;
+        its value is then read and written as raw memory without involving GDB's expression evaluation (also while
+        the target is running, via live access). Other expressions are evaluated via GDB (see PreparedExpr).
+        For example:
+          tick = t.prepare('_tick_cnt')
+          tick.value += 1
+
+        Args:
+            expr: The expression to be prepared.
+
+        Returns:
+            The accessor of the expression.
+        """
+        from dottmi.prepared import PreparedExpr
+        return PreparedExpr(self, expr)
+
+    def eval_value(self, expr: str, timeout: float = None) -> Union[Dict, List, int, float, bool, str]:
+        """
+        Evaluates the given expression (like eval) and returns its value as nested Python objects: structs and unions
+        are returned as dicts (member name -> value), arrays as lists, numbers, pointers and enums as int or float.
+        The whole value is converted by GDB in a single call (instead of one eval per member).
+        For example:
+          t.eval_value('my_struct')  # returns, e.g., {'a': 1, 'b': [2, 3], 'c': {'x': 1.5}}
+
+        Args:
+            expr: The expression to be evaluated in the current context of the target.
+            timeout: Optional timeout for the evaluation.
+
+        Returns:
+            The value of the expression.
+        """
+        if Target._ASSIGN_RE.search(expr) is not None:
+            self.reg_cache_invalidate()  # note: the expression might modify a register
+        self._mem_cache_sync()
+        status, payload = self.exec_dott('dott-eval-value', expr.encode().hex(), timeout=timeout)
+        payload = bytes.fromhex(payload).decode()
+        if status != 'OK':
+            self.check_fault()  # e.g., a called function faulted
+            raise DottException(f'Unable to evaluate {expr} ({payload}).')
+        return json.loads(payload)
+
+    # steps of run_script and their number of arguments
+    _SCRIPT_OPS = {'eval': 1, 'set': 2, 'exec': 1, 'read': 2, 'write': 2}
+
+    def run_script(self, steps: List[Union[str, Tuple]], timeout: float = None) -> List:
+        """
+        Executes the given steps in GDB's context and returns the results of all steps with a single exchange between
+        DOTT and GDB (instead of one exchange per step). This speeds up, e.g., the setup of many variables followed by
+        a function call and reading back its results. Steps (a plain string is the same as an 'eval' step):
+          ('eval', expr)                 result: value of expr (structs as dicts and arrays as lists, see eval_value)
+          ('set', lvalue, value)         assigns value (number or expression) to lvalue; result: None
+          ('exec', cli_cmd)              executes a GDB CLI command; result: its console output
+          ('read', addr, num_bytes)      reads memory at addr (address or expression); result: bytes
+          ('write', addr, data)          writes data (bytes) to memory at addr; result: None
+        For example:
+          _, _, res, buf = t.run_script([('set', 'cfg.gain', 5), ('set', 'cfg.offset', -3), 'app_Filter(&cfg)',
+                                         ('read', '&out_buf', 64)])
+
+        Args:
+            steps: The steps to be executed (in the given order).
+            timeout: Optional timeout for the execution of the whole script.
+
+        Returns:
+            List with the result of each step. A DottException is raised if a step fails (subsequent steps are not
+            executed).
+        """
+        spec = []
+        for step in steps:
+            step = ('eval', step) if isinstance(step, str) else tuple(step)
+            if Target._SCRIPT_OPS.get(step[0]) != len(step) - 1:
+                raise DottException(f'Invalid script step {step}.')
+            if step[0] == 'set':
+                step = ('set', step[1], str(int(step[2]) if isinstance(step[2], bool) else step[2]))
+            elif step[0] in ('read', 'write'):
+                addr = str(step[1]) if isinstance(step[1], int) else step[1]
+                step = (step[0], addr, step[2].hex() if step[0] == 'write' else int(step[2]))
+            spec.append(step)
+
+        # note: the steps might call functions or modify registers and memory
+        self.reg_cache_invalidate()
+        self._mem_cache_sync()
+        status, payload = self.exec_dott('dott-run-script', json.dumps(spec).encode().hex(), timeout=timeout)
+        res = json.loads(bytes.fromhex(payload).decode())
+        if status != 'OK':
+            self.check_fault()  # e.g., a called function faulted
+            raise DottException(f'Script step {res["step"]} {spec[res["step"]]} failed ({res["msg"]}).')
+        return [bytes.fromhex(r) if s[0] == 'read' else r for s, r in zip(spec, res)]
+
+    @staticmethod
+    def _eval_res_to_py(expr: str, res: Dict) -> Union[int, float, bool, str, None]:
         if res is None:
             log.warn(f'Eval of {expr} did not succeed (return value is None)!')
             return None
@@ -246,46 +996,407 @@ class Target(NotifySubscriber):
         res = res['payload']['value']
         ret_val = cast_str(res)
 
-        if '<optimized out>' in str(ret_val):
+        if isinstance(ret_val, str) and '<optimized out>' in ret_val:
             log.warn(f'Accessed entity {expr} is optimized out in the target binary.')
 
         return ret_val
 
+    def mi_cmd(self, cmd: str) -> str:
+        """
+        Returns the given MI command with the context option of this core (e.g., '--thread 2') inserted after the
+        command name. Commands are returned unchanged for single-core targets (see add_core).
+        """
+        if self._mi_context == '' or not cmd.startswith('-'):
+            return cmd
+        name, _, args = cmd.partition(' ')
+        return f'{name} {self._mi_context} {args}'.rstrip()
+
     def exec(self, cmd: str, timeout: float = None) -> Dict:
-        return self._gdb_client.gdb_mi.write_blocking(cmd, timeout=timeout)
+        return self._gdb_client.gdb_mi.write_blocking(self.mi_cmd(cmd), timeout=timeout)
+
+    def exec_many(self, cmds: List[str], timeout: float = None) -> List[Dict]:
+        """
+        Sends the given MI commands to GDB in a pipelined fashion and returns their results in the same order.
+        """
+        return self._gdb_client.gdb_mi.write_batch([self.mi_cmd(cmd) for cmd in cmds], timeout=timeout)
+
+    def exec_check(self, cmds: Union[str, List[str]], timeout: float = None) -> None:
+        """
+        Sends the given MI command(s), which are only issued for their side effects, to GDB. Commands are pipelined
+        and only the result class of each command is checked (no result payload is built). If one of the commands
+        fails, the first error is raised once the results of all commands have been collected.
+        """
+        if isinstance(cmds, str):
+            cmds = [cmds]
+        self._gdb_client.gdb_mi.write_checked([self.mi_cmd(cmd) for cmd in cmds], timeout=timeout)
 
     def exec_noblock(self, cmd: str) -> int:
-        return self._gdb_client.gdb_mi.write_non_blocking(cmd)
+        return self._gdb_client.gdb_mi.write_non_blocking(self.mi_cmd(cmd))
 
     def cli_exec(self, cmd: str, timeout: float = None) -> Dict:
-        return self._gdb_client.gdb_mi.write_blocking(f'-interpreter-exec console "{cmd}"', timeout=timeout)
+        return self.exec(f'-interpreter-exec console "{cmd}"', timeout=timeout)
+
+    def exec_dott(self, dott_cmd: str, args: str = '', timeout: float = None) -> List[str]:
+        """
+        Executes a custom DOTT GDB command (see gdb_cmds.py) in the context of this core and returns the fields of its
+        response (see GdbMi.write_dott_cmd).
+        """
+        return self._gdb_client.gdb_mi.write_dott_cmd(dott_cmd, args, timeout=timeout, context=self._mi_context)
 
     ###############################################################################################
     # Execution-related target commands
 
-    def load(self, load_elf_file_name: str, symbol_elf_file_name: str = None, enable_flash: bool = False) -> None:
+    # granularity (in bytes) in which SRAM images are checked and restored by the SRAM fast reload
+    _SRAM_BLOCK_SIZE = 1024
+
+    def load(self, load_elf_file_name: str, symbol_elf_file_name: str = None, enable_flash: bool = False,
+             download: bool = True, extra_load_elfs: List[str] = None) -> None:
+        # extra_load_elfs: further images (e.g., the bootloader) which are programmed to flash together with
+        # load_elf_file_name in a single download (see FlashImage.combined); ignored for SRAM downloads
+        self._mem_cache_sync()
         self._load_elf_file_name = load_elf_file_name
         self._symbol_elf_file_name = symbol_elf_file_name
+        self._call_stub = None
+        self._call_addrs = {}
+        self._reg_names = None
+        self._reg_cache = None
 
+        # note: the file paths as seen by GDB differ from the local ones if GDB runs on the host of a DOTT agent
         if load_elf_file_name is not None:
-            self.exec(f'-file-exec-file {self._load_elf_file_name}')
+            self.exec(f'-file-exec-file {self._gdb_client.file_path(self._load_elf_file_name)}')
+        self._symbol_reload_skipped = False
         if symbol_elf_file_name is not None:
-            self.exec(f'-file-symbol-file')  # note: -file-symbol-file without arguments clears GDB's symbol table
-            self.exec(f'-file-symbol-file {self._symbol_elf_file_name}')
+            if self._symbol_elf_unchanged(symbol_elf_file_name):
+                self._symbol_reload_skipped = True
+                log.debug(f'Symbols of {symbol_elf_file_name} are unchanged; skipping the symbol reload.')
+            else:
+                self._symbol_elf_loaded = None
+                self.exec(f'-file-symbol-file')  # note: -file-symbol-file without arguments clears GDB's symbol table
+                self.exec(f'-file-symbol-file {self._gdb_client.file_path(self._symbol_elf_file_name)}')
+                st = os.stat(symbol_elf_file_name)
+                self._symbol_elf_loaded = (os.path.abspath(symbol_elf_file_name), st.st_mtime_ns, st.st_size,
+                                           TypeCache.elf_key(symbol_elf_file_name))
+
+        # type information (sizes, layouts) and the symbol index are cached per symbol ELF; if the build generated a
+        # DOTT manifest (see manifest.py) for the ELF, both are taken from it
+        sym_elf = symbol_elf_file_name if symbol_elf_file_name is not None else load_elf_file_name
+        if sym_elf is not None:
+            manifest = DottManifest.load(sym_elf)
+            if manifest is not None:
+                log.debug(f'Using DOTT manifest {DottManifest.file_name(sym_elf)}.')
+            self._type_cache.bind(sym_elf, manifest)
+            self._symbols.bind(sym_elf, manifest)
+
+        # note: when attaching with symbols only (attach_only), the flash device is not set (saves a round trip)
+        cmd = self._gdb_srv_quirks.monitor_flash_device(self._gdb_server.device_id)
+        attach_symbols_only = load_elf_file_name is None and not enable_flash and DottConf.conf.get('attach_only')
+        if cmd is not None and not attach_symbols_only:
+            self.cli_exec(cmd)
+
+        if enable_flash and self._gdb_srv_quirks.monitor_flash_download is not None:
+            self.cli_exec(self._gdb_srv_quirks.monitor_flash_download)
+
+        if load_elf_file_name is not None and download:
+            with self.clock_phase('bulk'):
+                self._download(load_elf_file_name, enable_flash, extra_load_elfs)
+
+        if (DottConf.conf.get('gdb_mem_cache') or self._link_batching) and (load_elf_file_name or sym_elf) is not None:
+            self._gdb_mem_regions_apply(load_elf_file_name or sym_elf)
+
+    def _download(self, load_elf_file_name: str, enable_flash: bool, extra_load_elfs: List[str]) -> None:
+        # downloads the image of load (flash or SRAM; incremental, via the flash loader or with GDB's load)
+        self._vector_cache.invalidate()
+        self._gdb_mem_regions_reset()
+        incremental = DottConf.conf.get('flash_download_mode') == 'incremental'
+        if enable_flash and extra_load_elfs:
+            sector_size = DottConf.conf.get('flash_sector_size', 2048)
+            image = FlashImage.combined([FlashImage(elf, sector_size) for elf in extra_load_elfs] +
+                                        [FlashImage(load_elf_file_name, sector_size)])
+            if DottConf.conf.get('flash_loader_elf') is not None:
+                self._download_image(image, incremental)
+            else:
+                with self._run_control():
+                    self._download_image(image, incremental)
+        elif enable_flash and DottConf.conf.get('flash_loader_elf') is not None:
+            # note: not run under _run_control since the loader's live mode relies on concurrent live accesses
+            self._download_incremental(load_elf_file_name, incremental)
+        else:
+            with self._run_control():
+                if enable_flash and DottConf.conf.get('flash_download_mode') == 'incremental':
+                    self._download_incremental(load_elf_file_name)
+                elif not enable_flash and DottConf.conf.get('sram_fast_reload') and \
+                        self._sram_restore(load_elf_file_name):
+                    pass
+                else:
+                    self.exec('-target-download')
+                    if enable_flash:
+                        self._flash_state.invalidate(self._gdb_server.serial_number)
+                    elif DottConf.conf.get('sram_fast_reload'):
+                        image = FlashImage(load_elf_file_name, Target._SRAM_BLOCK_SIZE, zero_fill=True)
+                        self._sram_images[load_elf_file_name] = (TypeCache.elf_key(load_elf_file_name), image)
+
+    # number of lines (64 bytes each by default) of GDB's data cache used for the memory regions of the image (see
+    # gdb_mem_cache)
+    _DCACHE_LINES = 4096
+
+    # size of the lines of GDB's data cache (bytes) for high latency links (see link_batching); each cache miss is
+    # filled with a single remote protocol packet
+    _DCACHE_LINE_SIZE_BATCHED = 1024
+
+    # image sections closer than this (in bytes) are covered by a single cached memory region
+    _MEM_REGION_MERGE_GAP = 4096
+
+    def _gdb_mem_regions_apply(self, elf_file_name: str) -> None:
+        # Configures GDB's data cache for the memory of the image: the allocated sections of the ELF (code and
+        # constants in flash, .data/.bss/heap/stack in SRAM) become cached memory regions. All other memory (in
+        # particular peripherals) stays uncached. GDB invalidates the cache whenever the target is resumed; hence,
+        # SRAM is cached while the target is halted. Regions are rw since DOTT may write to the image (e.g., SRAM
+        # fast reload) and may place software breakpoints in it.
+        _, _, sections, _ = ElfFile.open(elf_file_name).sections
+        spans: List[List[int]] = []
+        for sec in sorted((s for s in sections if s[2] & 0x2 and s[5] > 0), key=lambda s: s[3]):  # SHF_ALLOC
+            start, end = sec[3], sec[3] + sec[5]
+            if len(spans) > 0 and start - spans[-1][1] <= Target._MEM_REGION_MERGE_GAP:
+                spans[-1][1] = max(spans[-1][1], end)
+            else:
+                spans.append([start, end])
+        if len(spans) == 0:
+            return
+        # note: the first region command switches GDB from the server's memory map to user-defined regions
+        cmds = ['delete mem'] + [f'mem {start:#x} {end:#x} rw cache' for start, end in spans]
+        if self._link_batching:
+            cmds.append(f'set dcache line-size {Target._DCACHE_LINE_SIZE_BATCHED}')
+        cmds += [f'set dcache size {Target._DCACHE_LINES}', 'set stack-cache on', 'set code-cache on']
+        self.exec_check([f'-interpreter-exec console "{cmd}"' for cmd in cmds])
+        self._gdb_mem_regions = spans
+        log.debug(f'GDB data cache enabled for {len(spans)} memory region(s) of {elf_file_name}.')
+
+    def _gdb_mem_regions_reset(self) -> None:
+        # GDB only programs flash in regions of the server's memory map; hence, the server's map is restored before
+        # each download (see _gdb_mem_regions_apply)
+        if self._gdb_mem_regions is not None:
+            self.cli_exec('mem auto')
+            self._gdb_mem_regions = None
+
+    def gdb_cache_invalidate(self) -> None:
+        """
+        Invalidates GDB's data cache (see gdb_mem_cache), e.g., after target memory has been modified without GDB
+        while the target was halted (live access or external equipment).
+        """
+        if self._gdb_mem_regions is not None:
+            self.cli_exec(f'set dcache size {Target._DCACHE_LINES}')  # note: changing the size flushes the cache
+
+    def _symbol_elf_unchanged(self, symbol_elf_file_name: str) -> bool:
+        # True if GDB already holds the symbols of the given file (same path and same content). The ELF key (build-id
+        # or content hash) is only computed if the file's modification time or size changed since it was loaded.
+        if self._symbol_elf_loaded is None:
+            return False
+        path, mtime, size, key = self._symbol_elf_loaded
+        if path != os.path.abspath(symbol_elf_file_name):
+            return False
+        st = os.stat(symbol_elf_file_name)
+        if (st.st_mtime_ns, st.st_size) == (mtime, size):
+            return True
+        if TypeCache.elf_key(symbol_elf_file_name) != key:
+            return False
+        self._symbol_elf_loaded = (path, st.st_mtime_ns, st.st_size, key)
+        return True
+
+    @property
+    def symbol_reload_skipped(self) -> bool:
+        """
+        True if the last load kept the symbols already held by GDB since the symbol ELF did not change.
+        """
+        return self._symbol_reload_skipped
 
-        self.cli_exec(f'monitor flash device {self._gdb_server.device_id}')
+    def _flash_read_crcs(self, image: FlashImage) -> Dict[int, int]:
+        # returns the CRC of each sector of the target memory covered by the image. If the target-side CRC helper is
+        # resident (i.e., identical to the one of the image), the target computes the CRC of each piece and only
+        # pieces which differ from the image are read back (pipelined); otherwise all pieces are read back.
+        pieces = [(sector, addr, data) for sector in image.sectors for addr, data in image.sector_pieces(sector)]
+        try:
+            crcs = self.mem.crcs([(addr, len(data)) for _, addr, data in pieces], verify_helper=True)
+        except DottException as ex:
+            log.debug(f'{ex} Reading back all image pieces.')
+            crcs = [None] * len(pieces)
+        to_read = [(addr, len(data)) for (_, addr, data), crc in zip(pieces, crcs) if crc != zlib.crc32(data)]
+        results = self.exec_many([f'-data-read-memory-bytes {addr} {num}' for addr, num in to_read])
+        read_back = {addr: bytes.fromhex(res['payload']['memory'][0]['contents'])
+                     for (addr, _), res in zip(to_read, results)}
+        board_pieces: Dict[int, List] = {}
+        for sector, addr, data in pieces:
+            board_pieces.setdefault(sector, []).append((addr, read_back.get(addr, data)))
+        return {sector: FlashImage.pieces_crc(p) for sector, p in board_pieces.items()}
+
+    def flash_image_matches(self, load_elf_file_name: str) -> bool:
+        """
+        Checks if the target already holds the image of the given ELF file. If the ELF's GNU build-id is located in
+        flash (i.e., .note.gnu.build-id is placed in a loadable section by the linker script), only the build-id is
+        read back from the target and compared. Otherwise, the memory covered by the image is read back and
+        compared (based on CRCs).
 
-        if enable_flash:
-            self.cli_exec('monitor flash download=1')
+        Args:
+            load_elf_file_name: ELF file to be checked.
 
-        if load_elf_file_name is not None:
-            self.exec('-target-download')
+        Returns:
+            True if the target memory matches the image, False otherwise.
+        """
+        image = FlashImage(load_elf_file_name, DottConf.conf.get('flash_sector_size', 2048))
+        try:
+            if image.build_id_note is not None:
+                addr, note = image.build_id_note
+                res = self.exec(f'-data-read-memory-bytes {addr} {len(note)}')
+                return bytes.fromhex(res['payload']['memory'][0]['contents']) == note
+            return self._flash_read_crcs(image) == image.crcs()
+        except Exception as ex:
+            log.warn(f'Unable to read back target memory to check for image {load_elf_file_name} ({ex}).')
+            return False
+
+    def _download_incremental(self, load_elf_file_name: str, incremental: bool = True) -> None:
+        image = FlashImage(load_elf_file_name, DottConf.conf.get('flash_sector_size', 2048))
+        self._download_image(image, incremental)
+
+    def flash_download(self, image: FlashImage, incremental: bool = True, hex_files: Dict = None) -> int:
+        """
+        Programs an already parsed flash image (see load with enable_flash for the configuration options involved).
+        This is used to program the same image to several boards without parsing it for each board (see
+        flash_broadcast.broadcast_load).
+
+        Args:
+            image: Flash image to be programmed.
+            incremental: If True, only sectors which differ from the ones on the target are programmed.
+            hex_files: Optional cache (shared by the boards) of the Intel HEX files of programmed sector sets.
+
+        Returns:
+            Number of sectors programmed.
+        """
+        self._mem_cache_sync()
+        elf = self._gdb_mem_regions is not None and (self._load_elf_file_name or self._symbol_elf_file_name)
+        self._gdb_mem_regions_reset()
+        try:
+            if DottConf.conf.get('flash_loader_elf') is not None:
+                return self._download_image(image, incremental, hex_files)
+            with self._run_control():
+                return self._download_image(image, incremental, hex_files)
+        finally:
+            if elf:
+                self._gdb_mem_regions_apply(elf)
+
+    def _download_image(self, image: FlashImage, incremental: bool = True, hex_files: Dict = None) -> int:
+        # Only sectors whose content differs from the one on the target are downloaded (all sectors if not
+        # incremental). The current flash content is taken from the host-side flash state record of the board (if
+        # available) or is read back from the target. Sectors are programmed by the RAM-resident flash loader (if
+        # flash_loader_elf is configured) or by the GDB server.
+        board = self._gdb_server.serial_number
+        board_crcs = {}
+        if incremental:
+            board_crcs = self._flash_state.load(board, image.sector_size)
+            if board_crcs is None:
+                board_crcs = self._flash_read_crcs(image)
+
+        image_crcs = image.crcs()
+        changed = [sector for sector in image.sectors if board_crcs.get(sector) != image_crcs[sector]]
+        if incremental:
+            log.info(f'Incremental flash download: {len(changed)} of {len(image.sectors)} sector(s) changed.')
+        if len(changed) > 0 and DottConf.conf.get('flash_loader_elf') is not None:
+            self._flash_state.invalidate(board)
+            live = None
+            if DottConf.conf.get('flash_loader_live'):
+                from dottmi.pylinkdott import TargetDirect
+                live = TargetDirect(DottConf.conf['device_name'], self)
+            FlashLoader(self, DottConf.conf['flash_loader_elf'], live).program(image, changed)
+        elif len(changed) > 0 and hex_files is not None:
+            self._flash_state.invalidate(board)  # note: the flash content is unknown if the download fails
+            key = tuple(changed)
+            if key not in hex_files:
+                hex_files[key] = Path(tempfile.mkdtemp(prefix='dott_flash_')).joinpath('changed_sectors.hex').as_posix()
+                image.write_ihex(hex_files[key], changed)
+            self.cli_exec(f'load \\"{self._gdb_client.file_path(hex_files[key])}\\"')
+        elif len(changed) > 0:
+            self._flash_state.invalidate(board)
+            tmp_dir = tempfile.mkdtemp(prefix='dott_flash_')
+            try:
+                hex_file = Path(tmp_dir).joinpath('changed_sectors.hex').as_posix()
+                image.write_ihex(hex_file, changed)
+                self.cli_exec(f'load \\"{self._gdb_client.file_path(hex_file)}\\"')
+            finally:
+                shutil.rmtree(tmp_dir, ignore_errors=True)
+        board_crcs.update(image_crcs)
+        self._flash_state.save(board, image.sector_size, board_crcs)
+        return len(changed)
+
+    def _sram_restore(self, load_elf_file_name: str) -> bool:
+        # Restores an image which was previously downloaded to SRAM. The target computes the CRC-32 of each block of
+        # the image (DOTT_mem_crc32) and only blocks which differ from the image (typically .data, .bss and whatever
+        # the previous test modified) are written. .text usually stays resident. Returns False if the image is not
+        # resident (or if the target is unable to compute CRCs) in which case a full download is required.
+        key, image = self._sram_images.pop(load_elf_file_name, (None, None))
+        if image is None or key != TypeCache.elf_key(load_elf_file_name):
+            return False
+
+        pieces = [p for block in image.sectors for p in image.sector_pieces(block)]
+        try:
+            crcs = self.mem.crcs([(addr, len(data)) for addr, data in pieces], verify_helper=True)
+        except DottException as ex:
+            log.debug(f'{ex} Falling back to full SRAM download.')
+            return False
+
+        changed = [(addr, data) for (addr, data), crc in zip(pieces, crcs) if crc != zlib.crc32(data)]
+        log.debug(f'SRAM fast reload: {len(changed)} of {len(pieces)} block(s) restored.')
+        cmds = []
+        for addr, data in changed:
+            if data.count(0) == len(data):
+                cmds.append(f'-data-write-memory-bytes {addr} "00" {len(data)}')
+            else:
+                cmds.append(f'-data-write-memory-bytes {addr} "{data.hex()}"')
+        if len(cmds) > 0:
+            self.exec_check(cmds)
+        self.eval(f'$pc = {image.entry}')  # as done by -target-download
+        self._sram_images[load_elf_file_name] = (key, image)
+        return True
 
     def reset(self, flush_reg_cache: bool = True) -> None:
-        self.cli_exec(self._gdb_srv_quirks.monitor_reset)
+        self._mem_cache_sync()
+        with self._run_control(), self.clock_phase('safe'):
+            self.cli_exec(self._gdb_srv_quirks.monitor_reset)
+        self.gdb_cache_invalidate()
+        with self._cv_target_state:
+            self._fault_stop_count = -1
+        self.reg_cache_invalidate()
         if flush_reg_cache:
             self.reg_flush_cache()
 
+    def _snapshot_cmd(self, cmd: str) -> None:
+        if cmd is None:
+            raise DottException('The GDB server does not support machine snapshots (see GdbServerQemu).')
+        # note: QEMU's monitor only produces output for savevm/loadvm if the command failed
+        out = self.cli_capture(cmd).strip()
+        if out != '':
+            raise DottException(f'Machine snapshot command "{cmd}" failed ({out}).')
+
+    def snapshot_save(self, name: str) -> None:
+        """
+        Saves the complete machine state (CPU, memory and peripherals) of an emulated target under the given name. The
+        target has to be halted. Only supported by emulator backends (e.g., QEMU with reset_snapshot enabled).
+        """
+        self._mem_cache_sync()
+        self._snapshot_cmd(self._gdb_srv_quirks.monitor_snapshot_save(name))
+
+    def snapshot_restore(self, name: str) -> None:
+        """
+        Restores the machine state saved with snapshot_save. The target remains halted. All host-side and GDB caches
+        of target state (registers, memory, uploaded vectors) are invalidated.
+        """
+        with self._run_control(), self.clock_phase('bulk'):
+            self._snapshot_cmd(self._gdb_srv_quirks.monitor_snapshot_load(name))
+        if self._mem_cache is not None:
+            self._mem_cache.invalidate()
+        self._vector_cache.invalidate()
+        self.gdb_cache_invalidate()
+        with self._cv_target_state:
+            self._fault_stop_count = -1
+        self.reg_flush_cache()
+
     def cont(self) -> None:
         """
         Continues target execution.
@@ -293,10 +1404,18 @@ class Target(NotifySubscriber):
         if self.is_running():
             return
 
-        self.exec('-exec-continue')
-        self.wait_running()
+        self._mem_cache_sync()
+        # note: the GDB server reprograms flash when resuming if flash breakpoints changed (see BreakpointManager)
+        start = time.perf_counter() if self._bp_manager.flash_pending else None
+        with self._run_control():
+            self.exec('-exec-continue')
+            self.wait_running()
+        if start is not None:
+            self._bp_manager.flash_resumed(time.perf_counter() - start)
 
     def ret(self, ret_val: Union[int, str] = None) -> None:
+        self._mem_cache_sync()
+        self.reg_cache_invalidate()
         if ret_val is None:
             self.exec('-exec-return')
         else:
@@ -322,27 +1441,134 @@ class Target(NotifySubscriber):
         if not self.is_running():
             return
 
-        self.exec('-exec-interrupt --all')
-        self.wait_halted()
+        stop_regs = self._stop_regs_setup() if not halt_in_it_block else None
+        count = self._gdb_client.gdb_mi.latest_resps.count(stop_regs) if stop_regs is not None else 0
+        with self._run_control():
+            self.exec(self.interrupt_cmd())
+            self.wait_halted()
 
         if not halt_in_it_block:
+            # pc, sp and xPSR are captured by GDB at the stop; in the common case (not halted in an IT block), the halt
+            # does not need any further exchange with GDB
+            xpsr_name = self._gdb_srv_quirks.xpsr_name
+            regs = self._stop_regs_get(stop_regs, count) if stop_regs is not None else None
+            if regs is not None and xpsr_name in regs and not self.reg_xpsr_in_it_block(regs[xpsr_name]):
+                return
             # check if we have halted in an IT block; if yes, do instruction stepping until we have left the IT block
-            while self.reg_xpsr_in_it_block(self.eval(f'${self._gdb_srv_quirks.xpsr_name}')):
-                self.step_inst()
+            # note: an IT block covers at most four instructions; stepping is done by GDB in a single round trip
+            self._step_inst_gdb({'n': 8, 'it_exit_reg': xpsr_name})
+
+    # maximum time to wait for the registers captured by GDB at a stop (see halt)
+    _STOP_REGS_TIMEOUT_SEC = 0.5
+
+    def _stop_regs_setup(self) -> int:
+        # registers pc, sp and xPSR to be captured by GDB at every stop (dott-stop-regs in gdb_cmds.py); returns the
+        # response id of the captured registers (None if not supported, e.g., when replaying an old session)
+        if self._stop_regs_id is None:
+            gdb_mi = self._gdb_client.gdb_mi
+            stop_id = gdb_mi.reserve_resp_id()
+            gdb_mi.latest_resps.register(stop_id)
+            regs = json.dumps(['pc', 'sp', self._gdb_srv_quirks.xpsr_name]).encode().hex()
+            try:
+                self.exec_dott('dott-stop-regs', f'{stop_id} {regs}', timeout=2)
+                self._stop_regs_id = stop_id
+            except Exception as ex:
+                log.debug(f'Capturing registers at stops is not available ({ex}).')
+                self._stop_regs_id = -1
+        return self._stop_regs_id if self._stop_regs_id >= 0 else None
+
+    def _stop_regs_get(self, stop_id: int, count: int) -> Dict[str, int]:
+        # returns the registers captured at the stop following the given response count (None if not received)
+        fields = self._gdb_client.gdb_mi.latest_resps.wait_newer(stop_id, count, Target._STOP_REGS_TIMEOUT_SEC)
+        if fields is None or fields[0] != 'OK':
+            return None
+        regs = json.loads(bytes.fromhex(fields[1]).decode())
+        with self._cv_target_state:
+            self._stop_regs = (self._stop_count, regs)
+        return regs
+
+    def interrupt_cmd(self) -> str:
+        """
+        Returns the MI command which halts this target. In non-stop mode (gdb_non_stop), only the threads of this core
+        are interrupted; otherwise all cores of the GDB session are halted (see add_core).
+        """
+        if self._thread_ids is not None and DottConf.conf.get('gdb_non_stop'):
+            return '-exec-interrupt'
+        return '-exec-interrupt --all'
 
-    def step(self):
+    def step(self) -> None:
+        """
+        Performs a source line step (into function calls) and returns once the target is halted again.
+        """
+        self._mem_cache_sync()
         with self._cv_target_state:
             self._is_target_running = True
+            stop_count = self._stop_count
         self.exec('-exec-step')
-        while self.is_running():
-            pass
+        self._wait_stop_count(stop_count + 1)
+
+    def step_inst(self, n: int = 1) -> int:
+        """
+        Performs n instruction steps and returns once the target is halted again. For n > 1, the steps are performed
+        by GDB in a single round trip (instead of one round trip per step).
+
+        Args:
+            n: Number of instruction steps.
+
+        Returns:
+            The number of steps performed.
+        """
+        if n == 1:
+            self._mem_cache_sync()
+            with self._cv_target_state:
+                self._is_target_running = True
+                stop_count = self._stop_count
+            self.exec('-exec-step-instruction')
+            self._wait_stop_count(stop_count + 1)
+            return 1
+        return self._step_inst_gdb({'n': n})['steps']
+
+    def step_until(self, pc: int, max_steps: int = 1000) -> int:
+        """
+        Performs instruction steps until the program counter reaches pc or max_steps steps were performed. The steps
+        are performed by GDB in a single round trip.
 
-    def step_inst(self):
+        Args:
+            pc: Program counter value at which stepping stops (the Thumb bit is ignored).
+            max_steps: Maximum number of instruction steps.
+
+        Returns:
+            The number of steps performed. A DottException is raised if pc was not reached within max_steps steps.
+        """
+        res = self._step_inst_gdb({'n': max_steps, 'until_pc': pc & ~0x1})
+        if res['pc'] != pc & ~0x1:
+            raise DottException(f'PC {pc:#x} not reached within {max_steps} steps (pc: {res["pc"]:#x}).')
+        return res['steps']
+
+    def _step_inst_gdb(self, spec: Dict) -> Dict:
+        # Performs instruction stepping on the GDB side (dott-step-inst in gdb_cmds.py). Each performed step results
+        # in one 'stopped' notification which are counted to determine when the target state is up to date.
+        self._mem_cache_sync()
         with self._cv_target_state:
-            self._is_target_running = True
-        self.exec('-exec-step-instruction')
-        while self.is_running():
-            pass
+            stop_count = self._stop_count
+        spec_hex = json.dumps(spec).encode().hex()
+        status, payload = self.exec_dott('dott-step-inst', spec_hex)
+        res = json.loads(bytes.fromhex(payload).decode())
+        self._wait_stop_count(stop_count + res['steps'])
+        if status != 'OK':
+            raise DottException(f'Instruction stepping failed after {res["steps"]} step(s) ({res["error"]}).')
+        return res
+
+    def _wait_stop_count(self, stop_count: int, wait_secs: float = None) -> None:
+        # waits (without busy spinning) until the given number of 'stopped' notifications has been processed
+        if not wait_secs:
+            wait_secs = self._state_change_wait_secs
+        with self._cv_target_state:
+            if not self._cv_target_state.wait_for(lambda: self._stop_count >= stop_count, wait_secs):
+                raise DottException(f'Target did not change to "halted" state within {wait_secs} seconds.')
+            if self._fault_stop_count != self._stop_count:
+                return
+        self.check_fault()
 
     ###############################################################################################
     # Status-related target commands
@@ -354,32 +1580,205 @@ class Target(NotifySubscriber):
         # by the notifier upon the availability of the new message. Hence, no actual waiting here.
         msg = self.wait_for_notification()
         notify_msg = msg['message']
+        if not self.owns_notification(msg.get('payload')):
+            return
         with self._cv_target_state:
             if 'stopped' in notify_msg:
-                # Note: The call to _wait_until_halted is needed here since a 'stopped' notification from GDB is not
-                # always in-sync with GDB's internal target state. Hence, we explicitly wait until GDB's internal
-                # state agrees with the notification status.
+                # Note: The call to _internal_wait_halted (in wait_halted) is needed since a 'stopped' notification
+                # from GDB is not always in-sync with GDB's internal target state. Hence, we explicitly wait until
+                # GDB's internal state agrees with the notification status.
                 self._is_target_running = False
+                self._stop_count += 1
+                if self._is_fault_stop(msg.get('payload')):
+                    self._fault_stop_count = self._stop_count
+                if self._mem_cache is not None:
+                    self._mem_cache.stopped_at(self._stop_location(msg.get('payload')))
                 self._cv_target_state.notify_all()
             elif 'running' in notify_msg:
+                if self._mem_cache is not None:
+                    self._mem_cache.resumed()
                 self._is_target_running = True
                 self._cv_target_state.notify_all()
             else:
                 log.warn(f'Unhandled notification: {notify_msg}')
+        if timeline.enabled and ('stopped' in notify_msg or 'running' in notify_msg):
+            timeline.state(f'target {self._device_name or ""} {self._serial_number or ""}'.strip(),
+                           'halted' if 'stopped' in notify_msg else 'running')
+        if self._probe_broker is not None:
+            self._probe_broker.state_changed()
+        if self.fault_pending:
+            self._bp_handler.fault_wakeup()  # note: waiting halt points then raise a TargetFaultException
+
+    def _stop_location(self, payload: Dict) -> str:
+        # location of the DOTT breakpoint at which the target halted (None if no DOTT breakpoint was hit); note: the
+        # 'running' and 'stopped' notifications are handled in the same thread, i.e., hits and resumes are in order
+        if not isinstance(payload, dict) or payload.get('reason') != 'breakpoint-hit':
+            return None
+        bp = self.bp_registry.owner(int(payload.get('bkptno', -1)))
+        return bp.get_location() if bp is not None else None
+
+    def owns_notification(self, payload: Dict) -> bool:
+        """
+        Returns True if the given 'stopped' or 'running' notification (payload) concerns this core. Notifications for
+        all threads (all-stop mode) concern every core of the GDB session (see add_core).
+        """
+        if self._thread_ids is None or not isinstance(payload, dict):
+            return True
+        threads = payload.get('stopped-threads', payload.get('thread-id', 'all'))
+        if threads == 'all':
+            return True
+        if isinstance(threads, str):
+            threads = [threads]
+        return any(t in self._thread_ids for t in threads)
+
+    # function of testhelpers.c in which the target halts (bkpt) after a fault (see DOTT_fault_hook)
+    _FAULT_FUNC = 'DOTT_fault_save'
+    # layout of DOTT_fault_info_t (see testhelpers.h)
+    _FAULT_INFO_FIELDS = ('r0', 'r1', 'r2', 'r3', 'r12', 'lr', 'pc', 'xpsr', 'exc_return', 'sp', 'cfsr', 'hfsr',
+                          'mmfar', 'bfar')
+
+    def _is_fault_stop(self, payload: Dict) -> bool:
+        # note: called from the notification thread; hence only host-side information is used
+        frame = payload.get('frame') if isinstance(payload, dict) else None
+        if not isinstance(frame, dict):
+            return False
+        if frame.get('func') is not None:
+            return frame['func'] == Target._FAULT_FUNC
+        try:
+            return self._symbols.func_at(int(frame['addr'], 16)) == Target._FAULT_FUNC
+        except (KeyError, TypeError, ValueError):
+            return False
+
+    @property
+    def fault_pending(self) -> bool:
+        """
+        Returns True if the target is halted in DOTT's fault hook (DOTT_fault_hook in testhelpers.c), i.e., the
+        firmware hit a fault and can not continue.
+        """
+        with self._cv_target_state:
+            return self._fault_stop_count == self._stop_count and not self._is_target_running
+
+    def fault(self) -> Dict[str, int]:
+        """
+        Returns the exception frame and the fault status registers saved by DOTT's fault hook (see DOTT_fault_info_t
+        in testhelpers.h) or None if the target did not halt in the fault hook.
+        """
+        if not self.fault_pending:
+            return None
+        try:
+            addr = self._symbols.addr('DOTT_fault_info')
+            res = self.exec(f'-data-read-memory-bytes {addr} {4 * len(Target._FAULT_INFO_FIELDS)}')
+        except Exception:
+            return None
+        content = bytes.fromhex(res['payload']['memory'][0]['contents'])
+        bo = '<' if self.byte_order == 'little' else '>'
+        values = struct.unpack(f'{bo}{len(Target._FAULT_INFO_FIELDS)}I', content)
+        return dict(zip(Target._FAULT_INFO_FIELDS, values))
+
+    def check_fault(self) -> None:
+        """
+        Raises a TargetFaultException if the target is halted in DOTT's fault hook. Called by DOTT whenever a wait for
+        the target (e.g., a halt point or eval) is interrupted such that a fault is reported immediately instead of
+        after a timeout.
+        """
+        if not self.fault_pending:
+            return
+        info = self.fault()
+        if info is None:
+            raise TargetFaultException('Target halted in fault hook (fault information not available).')
+        func = self._symbols.func_at(info['pc'])
+        raise TargetFaultException(f'Target fault at pc {info["pc"]:#x}{f" ({func})" if func else ""} '
+                                   f'(lr: {info["lr"]:#x}, sp: {info["sp"]:#x}, cfsr: {info["cfsr"]:#x}, '
+                                   f'hfsr: {info["hfsr"]:#x}).', info)
+
+    # regions closer than this (in bytes) are captured as one region by core_dump
+    _CORE_MERGE_GAP = 256
+
+    def _ram_regions(self) -> List[Tuple[int, int]]:
+        # writable sections (.data, .bss, heap, stack) of the symbol ELF as (start address, number of bytes)
+        elf = self._symbol_elf_file_name if self._symbol_elf_file_name is not None else self._load_elf_file_name
+        if elf is None:
+            raise DottException('No ELF loaded. Memory regions to be captured have to be given explicitly.')
+        _, _, sections, _ = ElfFile.open(elf).sections
+        spans: List[List[int]] = []
+        for sec in sorted((s for s in sections if s[2] & 0x3 == 0x3 and s[5] > 0), key=lambda s: s[3]):  # WRITE|ALLOC
+            start, end = sec[3], sec[3] + sec[5]
+            if len(spans) > 0 and start - spans[-1][1] <= Target._CORE_MERGE_GAP:
+                spans[-1][1] = max(spans[-1][1], end)
+            else:
+                spans.append([start, end])
+        return [(start, end - start) for start, end in spans]
+
+    def core_dump(self, file_name: str, regions: List[Tuple[int, int]] = None, periph: bool = True) -> 'CoreDump':
+        """
+        Captures the state of the halted target into an ELF core file: all registers, the given memory regions and
+        (if an SVD file is configured) a snapshot of the peripherals. The dump can be analysed afterwards without the
+        board (see dottmi.coredump.open_core_dump). Example (e.g., in a test which failed):
+            dott().target.core_dump(f'{request.node.name}.core')
+
+        Args:
+            file_name: Core file to be written.
+            regions: Memory regions (start address, number of bytes) to be captured. Default: the writable sections
+                     (.data, .bss, heap and stack) of the symbol ELF.
+            periph: If True, the readable peripheral registers without read side effects are captured as well.
+
+        Returns:
+            The captured core dump.
+        """
+        from dottmi.coredump import CoreDump
+
+        if self.is_running():
+            raise DottException('Target has to be halted to capture a core dump.')
+        regions = regions if regions is not None else self._ram_regions()
+        names = self.reg_get_names()
+        regs = {}
+        for entry in self.reg_get_content():
+            name = names[int(entry['number'])] if int(entry['number']) < len(names) else ''
+            val = cast_str(entry['value'])
+            if name != '' and isinstance(val, int) and 0 <= val <= 0xffffffff:
+                regs[name] = val
+        contents = [self.mem.read(addr, num_bytes) for addr, num_bytes in regions]
+        periph_values = self.periph.snapshot().values if periph and DottConf.conf.get('svd_file') else None
+        info = {'device': self._device_name, 'serial': self._serial_number, 'symbol_elf': self._symbol_elf_file_name,
+                'load_elf': self._load_elf_file_name, 'time': datetime.datetime.now().isoformat(timespec='seconds')}
+        dump = CoreDump(regs, list(zip((addr for addr, _ in regions), contents)), periph_values, info)
+        dump.save(file_name)
+        log.debug(f'Core dump with {sum(n for _, n in regions)} bytes of memory written to {file_name}.')
+        return dump
 
     def _internal_wait_halted(self, wait_secs: float = 1.0):
-        start_time = time.time()
-        while (time.time() - start_time) <= wait_secs:
+        # Waits for the 'stopped' notification and then confirms once per stop that GDB's internal state agrees (see
+        # _notify_callback). Only if GDB still reports the target as running, the confirmation is repeated with an
+        # increasing back-off instead of flooding GDB (and the debug probe) with requests.
+        end_time = time.time() + wait_secs
+        with self._cv_target_state:
+            if not self._cv_target_state.wait_for(lambda: not self._is_target_running, wait_secs):
+                raise DottException(f'Target did not change to "halted" state within {wait_secs} seconds.')
+            stop_count = self._stop_count
+            if self._halt_confirmed_count == stop_count:
+                return
+
+        backoff = .001
+        while True:
             try:
                 # Note: Ideally the documented (but not implemented) GDB MI command "-target-exec-status" would be used
                 # here to check if the target is halted or not. As an alternative, an info command is used which
                 # raises and exception if the target is running.
-                self.exec('-thread-info')
-                # command succeeded => target is halted
-                return
-            except:
-                time.sleep(0)  # yield current thread
-        raise DottException(f'Target not halted within {wait_secs} second(s) despite reported as "stopped" by GDB.')
+                res = self.exec('-thread-info')
+                # command succeeded => target is halted (in non-stop mode, the command reports the thread states)
+                if self._thread_ids is None or all(t.get('state') != 'running' for t in res['payload']['threads']
+                                                   if t.get('id') in self._thread_ids):
+                    break
+                raise DottException('Target still running.')
+            except Exception:
+                if time.time() + backoff > end_time:
+                    raise DottException(f'Target not halted within {wait_secs} second(s) despite reported as '
+                                        f'"stopped" by GDB.')
+                time.sleep(backoff)
+                backoff = min(backoff * 2, .05)
+
+        with self._cv_target_state:
+            self._halt_confirmed_count = max(self._halt_confirmed_count, stop_count)
 
     def is_running(self) -> bool:
         """
@@ -402,11 +1801,7 @@ class Target(NotifySubscriber):
         if not wait_secs:
             wait_secs = self._state_change_wait_secs
 
-        with self._cv_target_state:
-            if self._is_target_running:
-                self._cv_target_state.wait(wait_secs)
-            if self._is_target_running:
-                raise DottException(f'Target did not change to "halted" state within {wait_secs} seconds.')
+        self._internal_wait_halted(wait_secs)
 
     def wait_running(self, wait_secs: float = None) -> None:
         """
@@ -425,23 +1820,447 @@ class Target(NotifySubscriber):
             if not self._is_target_running:
                 raise DottException(f'Target did not change to "running" state within {wait_secs} seconds.')
 
+    def live_direct(self) -> 'TargetDirect':
+        """
+        Returns the direct probe connection used for accesses while the target is running: the direct connection of
+        mem if set, otherwise a J-Link live access connection which is established on first use.
+        """
+        if self.mem.direct is not None:
+            return self.mem.direct
+        if self._wait_direct is None:
+            from dottmi.pylinkdott import TargetDirect
+            self._wait_direct = TargetDirect(DottConf.conf['device_name'], self)
+        return self._wait_direct
+
+    def wait_until(self, addr: Union[int, str], mask: int = 0xffffffff, value: int = 1,
+                   timeout: float = None) -> 'WaitResult':
+        """
+        Waits until the 32bit word at the given address (or symbol) satisfies (word & mask) == value while the target
+        is running, e.g., wait_until('_tick_cnt', 0xffffffff, 100) or wait_until(status_reg_addr, 0x4, 0x4). Instead
+        of polling via eval from the host, the word is read in a tight loop via the direct probe connection (the
+        direct connection of mem if set, otherwise the J-Link live access). If the target is halted, the condition
+        is checked once since it can not change.
+
+        Args:
+            addr: Address or symbol name of the 32bit word.
+            mask: Mask applied to the word before comparing it to value.
+            value: Expected value of the masked word.
+            timeout: Number of seconds to wait before a DottException is thrown (default: state_change_wait_secs).
+
+        Returns:
+            A WaitResult with the time (time.perf_counter) at which the condition became true, the time window
+            between the last non-matching and the first matching read, the value read and the number of reads.
+        """
+        from dottmi.pylinkdott import WaitResult, poll_until
+        timeout = timeout if timeout is not None else self._state_change_wait_secs
+        addr = self.symbols.addr(addr) if isinstance(addr, str) else addr
+        if not self.is_running():
+            return poll_until(lambda a: int.from_bytes(self.mem.read(a, 4), self.byte_order), addr, mask, value, 0)
+
+        live = self.live_direct()
+        if hasattr(live, 'wait_until'):
+            return live.wait_until(addr, mask, value, timeout)
+        return poll_until(lambda a: live.mem_read_32(a), addr, mask, value, timeout)
+
+    ###############################################################################################
+    # Function call-related target commands
+
+    # caller-saved registers which are modified when calling into the resident call stub
+    _CALL_SAVED_REGS = ['r0', 'r1', 'r2', 'r3', 'r12', 'sp', 'lr', 'pc']
+    _CALL_MAILBOX_FMT = 'IIIIIII'  # func, args[4], ret, state (see DOTT_call_mailbox_t in testhelpers.h)
+    _CALL_PENDING = 1
+    _CALL_DONE = 2
+
+    # pattern the stack below the stack pointer is painted with to measure the stack usage of benchmarked functions
+    _STACK_PAINT = b'\xa5\x5a\xc3\x3c'
+
+    def _call_init(self) -> Dict:
+        if self._call_stub is None:
+            try:
+                mailbox, stub = self.eval_many(['(unsigned int) &DOTT_call_mailbox', '(unsigned int) &DOTT_call_stub'])
+            except Exception:
+                raise DottException('Target.call requires the resident call stub (DOTT_call_stub in '
+                                    'testhelpers.c) to be linked into the target binary!') from None
+            self._call_stub = {'mailbox': mailbox, 'stub': stub}
+        return self._call_stub
+
+    def _call_func_addr(self, func: Union[str, int]) -> int:
+        if isinstance(func, str):
+            if func not in self._call_addrs:
+                self._call_addrs[func] = self.eval(f'(unsigned int) &{func}')
+            return self._call_addrs[func]
+        return func
+
+    def _call_save_regs(self) -> None:
+        regs = Target._CALL_SAVED_REGS + [self._gdb_srv_quirks.xpsr_name]
+        self._call_saved_regs = {r: self.eval(f'${r}') for r in regs}  # note: served by the register cache
+
+    def _call_restore_regs(self) -> None:
+        self.reg_cache_invalidate()
+        self.exec_check([f'-data-evaluate-expression "${r} = {v}"' for r, v in self._call_saved_regs.items()])
+        self._call_saved_regs = None
+
+    @contextlib.contextmanager
+    def call_session(self):
+        """
+        Context manager for a sequence of Target.call invocations. The register context of the halted target is only
+        saved on entry and restored on exit (instead of for every call) which further reduces the register traffic
+        per call. The target must not be resumed by other means while the session is active.
+        For example:
+            with dt.call_session():
+                for a, b in args:
+                    assert dt.call('example_Addition', a, b) == a + b
+        """
+        if self._call_session_depth == 0:
+            self._call_init()
+            self._call_save_regs()
+        self._call_session_depth += 1
+        try:
+            yield self
+        finally:
+            self._call_session_depth -= 1
+            if self._call_session_depth == 0:
+                self._call_restore_regs()
+
+    # alignment of buffer arguments marshalled into the on-target scratch memory (see call)
+    _CALL_BUF_ALIGN = 8
+
+    def call(self, func: Union[str, int], *args: Union[int, bytes, bytearray, memoryview], signed: bool = False,
+             timeout: float = None, readback: bool = False) -> int:
+        """
+        Calls a target function via the resident call stub (DOTT_call_stub in testhelpers.c). Compared to calling a
+        function with eval (which relies on GDB's inferior function call machinery), only the mailbox and a few
+        registers are transferred per call. This makes call well suited for tight unit-test loops (see also
+        call_session).
+        Arguments which are buffers (bytes, bytearray, memoryview or objects supporting the buffer protocol such as
+        numpy arrays) are copied into the on-target scratch memory (Target.mem) with a single write and the function
+        is called with their addresses. With readback, the buffers are read back after the call (again with a single
+        read) and mutable buffers are updated in place. The scratch memory is released after the call.
+        For example:
+          dt.call('example_SumElements', np.array([1, 2, 3], dtype=np.uint16), 3)
+          dt.call('example_Reverse', buf, len(buf), readback=True)  # buf: bytearray or numpy array
+        Note: Only functions with up to four integer (or pointer) arguments which return a 32 bit integer value (or
+        nothing) are supported. Floating point registers of the interrupted context are not preserved.
+
+        Args:
+            func: Name or address of the function to be called.
+            args: Arguments of the function (integers, negative values are passed in two's complement, or buffers).
+            signed: If True, the return value is interpreted as signed 32 bit integer.
+            timeout: Time (in seconds) to wait for the function to return. Defaults to the state change timeout.
+            readback: If True, mutable buffer arguments are updated with the buffer contents after the call.
+
+        Returns:
+            The return value of the function.
+        """
+        args, block, bufs = self._call_marshal(args)
+        in_session = self._call_session_depth > 0
+        if not in_session:
+            self._call_init()
+            self._call_save_regs()
+        try:
+            self._call_start(func, args)
+            ret = self.call_wait(signed, timeout)
+            if readback and len(bufs) > 0:
+                self._call_unmarshal(block, bufs)
+            return ret
+        finally:
+            if not in_session:
+                self._call_restore_regs()
+            if block is not None:
+                self.mem.free(block)
+
+    def _call_marshal(self, args: Tuple) -> Tuple[Tuple[int, ...], 'TypedPtr', List[Tuple[int, memoryview]]]:
+        # replaces buffer arguments by their addresses in one scratch memory block; returns the integer arguments,
+        # the block (None if there are no buffers) and the offset and byte view of each buffer
+        views = [None if isinstance(a, int) else memoryview(a).cast('B') for a in args]
+        if all(v is None for v in views):
+            return args, None, []
+        offsets, size = [], 0
+        for v in views:
+            offsets.append(size)
+            if v is not None:
+                size += (v.nbytes + Target._CALL_BUF_ALIGN - 1) // Target._CALL_BUF_ALIGN * Target._CALL_BUF_ALIGN
+        block = self.mem.alloc(max(size, 1), align=Target._CALL_BUF_ALIGN)
+        data = bytearray(size)
+        bufs = []
+        for v, offset in zip(views, offsets):
+            if v is not None:
+                data[offset:offset + v.nbytes] = v
+                bufs.append((offset, v))
+        self.mem.write(block.addr, bytes(data))
+        int_args = tuple(a if v is None else block.addr + offset for a, v, offset in zip(args, views, offsets))
+        return int_args, block, bufs
+
+    def _call_unmarshal(self, block: 'TypedPtr', bufs: List[Tuple[int, memoryview]]) -> None:
+        end = max(offset + v.nbytes for offset, v in bufs)
+        data = self.mem.read(block.addr, end)
+        for offset, v in bufs:
+            if not v.readonly:
+                v[:] = data[offset:offset + v.nbytes]
+
+    def call_start(self, func: Union[str, int], *args: int) -> None:
+        """
+        Starts a call of a target function via the resident call stub (see call) and returns while the function is
+        executed by the target. The call has to be completed with call_wait before the target is used otherwise.
+        Hence, the host can, e.g., prepare the next inputs while the target is busy (see CasePipeline).
+        Note: Only available within a call_session.
+        """
+        if self._call_session_depth == 0:
+            raise DottException('Target.call_start requires an active call_session.')
+        self._call_start(func, args)
+
+    def _call_start(self, func: Union[str, int], args: Tuple[int, ...]) -> None:
+        if len(args) > 4:
+            raise DottException(f'Target.call supports at most four arguments ({len(args)} given).')
+        stub = self._call_init()
+        func = self._call_func_addr(func)
+        bo = '<' if self.byte_order == 'little' else '>'
+        call_args = [a & 0xffffffff for a in args] + [0] * (4 - len(args))
+        mailbox = struct.pack(bo + Target._CALL_MAILBOX_FMT, func | 0x1, *call_args, 0, Target._CALL_PENDING)
+        xpsr = self._call_saved_regs[self._gdb_srv_quirks.xpsr_name]
+        # note: IT bits are cleared in xPSR such that the stub is not executed conditionally
+        self._mem_cache_sync()
+        self.reg_cache_invalidate()
+        self.exec_check([f'-data-write-memory-bytes {stub["mailbox"]} "{mailbox.hex()}"',
+                         f'-data-evaluate-expression "$pc = {stub["stub"]}"',
+                         f'-data-evaluate-expression "${self._gdb_srv_quirks.xpsr_name} = '
+                         f'{xpsr & ~((0b11 << 25) | (0b111111 << 10))}"'])
+
+        with self._cv_target_state:
+            self._call_stop_count = self._stop_count
+        self._call_func = func
+        self.exec('-exec-continue')
+
+    def call_wait(self, signed: bool = False, timeout: float = None) -> int:
+        """
+        Waits for the completion of the call started with call_start and returns the return value of the function
+        (see call for the arguments).
+        """
+        if self._call_func is None:
+            raise DottException('No target call pending.')
+        func, self._call_func = self._call_func, None
+        self._wait_stop_count(self._call_stop_count + 1, timeout)
+
+        stub = self._call_stub
+        bo = '<' if self.byte_order == 'little' else '>'
+        size = struct.calcsize(Target._CALL_MAILBOX_FMT)
+        res = self.exec(f'-data-read-memory-bytes {stub["mailbox"]} {size}')
+        content = bytes.fromhex(res['payload']['memory'][0]['contents'])
+        fields = struct.unpack(bo + Target._CALL_MAILBOX_FMT, content)
+        if fields[6] != Target._CALL_DONE:
+            raise DottException(f'Target call of {func:#x} did not complete (target stopped at pc '
+                                f'{self.eval("$pc"):#x}).')
+        ret = fields[5]
+        if signed and ret & 0x80000000:
+            ret -= 0x100000000
+        return ret
+
+    def sweep(self, func: Union[str, int], arg_table: List, signed: bool = False,
+              timeout: float = None) -> List[int]:
+        """
+        Calls a target function once for every row of the given argument table. The argument table is uploaded into
+        the on-target scratch memory (Target.mem) and a driver loop on the target (DOTT_call_sweep in testhelpers.c)
+        performs the calls. The results are then transferred back in one bulk read. If the table does not fit into the
+        available scratch memory at once, it is processed in chunks. Hence, thousands of calls cost a few round trips
+        instead of one inferior function call each.
+        The same restrictions as for Target.call apply (up to four integer arguments, 32 bit integer return value).
+        For example:
+            res = dt.sweep('example_Addition', [(a, b) for a in range(100) for b in range(100)])
+
+        Args:
+            func: Name or address of the function to be called.
+            arg_table: List of argument rows. Each row is a tuple (or list) of integers or a single integer. All rows
+            must have the same number of arguments.
+            signed: If True, the return values are interpreted as signed 32 bit integers.
+            timeout: Time (in seconds) to wait for each chunk of calls to complete.
+
+        Returns:
+            List with the return value of each call (in the order of the argument table).
+        """
+        return self._sweep('DOTT_call_sweep', func, arg_table, signed, timeout)
+
+    def _sweep(self, driver: str, func: Union[str, int], arg_table: List, signed: bool,
+               timeout: float) -> List[int]:
+        # runs the given on-target driver loop (DOTT_call_sweep or DOTT_call_bench) for the argument table
+        rows = [row if isinstance(row, (list, tuple)) else (row,) for row in arg_table]
+        if len(rows) == 0:
+            return []
+        num_args = len(rows[0])
+        if num_args > 4 or any(len(row) != num_args for row in rows):
+            raise DottException('Target.sweep requires rows with the same number of arguments (at most four).')
+
+        desc_fmt = '<IIIII' if self.byte_order == 'little' else '>IIIII'
+        desc_sz = struct.calcsize(desc_fmt)
+        row_sz = (num_args + 1) * 4  # arguments plus result
+        rows_per_chunk = (self.mem.get_num_free_bytes() - desc_sz - 4) // row_sz  # note: 4 bytes for alignment
+        if rows_per_chunk < 1:
+            raise DottException('Not enough on-target memory available for Target.sweep.')
+        rows_per_chunk = min(rows_per_chunk, len(rows))
+        func = self._call_func_addr(func) | 0x1
+        results: List[int] = []
+
+        desc = self.mem.alloc(desc_sz + rows_per_chunk * row_sz)
+        try:
+            with self.call_session():
+                for start in range(0, len(rows), rows_per_chunk):
+                    chunk = rows[start:start + rows_per_chunk]
+                    args_addr = desc.addr + desc_sz
+                    res_addr = args_addr + len(chunk) * num_args * 4
+                    data = struct.pack(desc_fmt, func, num_args, len(chunk), args_addr, res_addr)
+                    data += struct.pack(f'{desc_fmt[0]}{len(chunk) * num_args}I',
+                                        *[a & 0xffffffff for row in chunk for a in row])
+                    self.mem.write(desc.addr, data)
+                    if self.call(driver, desc.addr, timeout=timeout) != len(chunk):
+                        raise DottException('Target.sweep did not complete all calls.')
+                    fmt = f'{desc_fmt[0]}{len(chunk)}{"i" if signed else "I"}'
+                    results += struct.unpack(fmt, self.mem.read(res_addr, len(chunk) * 4))
+        finally:
+            self.mem.free(desc)
+        return results
+
+    def bench(self, func: Union[str, int], *args: int, iterations: int = 100, warmup: int = 3,
+              timeout: float = None, stack_bytes: int = None) -> 'BenchResult':
+        """
+        Measures the execution time (in CPU cycles) of a target function. The function is called warmup + iterations
+        times by an on-target driver loop (DOTT_call_bench in testhelpers.c) which reads the cycle counter (DWT CYCCNT
+        or SysTick on cores without CYCCNT such as the Cortex-M0) around each call. The overhead of the measurement
+        (determined by benchmarking an empty function) is subtracted. Note: Interrupts are not disabled; interrupts
+        occurring during a call add to its cycle count (see BenchResult.min and median for robust figures).
+        If stack_bytes is given, the peak stack usage of the function is measured as well: the given number of bytes
+        below the current stack pointer are painted with a pattern before the calls and checked afterwards. The
+        stack usage of the driver loop (again determined with the empty function) is subtracted.
+        For example:
+            res = dt.bench('example_Addition', 3, 4, iterations=1000)
+            log.info(f'example_Addition: {res}')
+
+        Args:
+            func: Name or address of the function to be benchmarked.
+            args: Integer arguments (at most four) passed to the function.
+            iterations: Number of measured calls.
+            warmup: Number of calls before the measured calls (e.g., to warm up caches and flash accelerators).
+            timeout: Time (in seconds) to wait for each chunk of calls to complete.
+            stack_bytes: Size of the stack region (below the stack pointer) used to measure the peak stack usage.
+
+        Returns:
+            Benchmark result with the cycles of each measured call (and the stack usage if requested).
+        """
+        sp = self._stack_paint(stack_bytes)
+        overhead = min(self._sweep('DOTT_call_bench', 'DOTT_bench_nop', [()] * 8, False, timeout))
+        overhead_stack = self._stack_used(sp, stack_bytes)
+        self._stack_paint(stack_bytes)
+        cycles = self._sweep('DOTT_call_bench', func, [tuple(args)] * (warmup + iterations), False, timeout)[warmup:]
+        if any(c == 0xffffffff for c in cycles):
+            raise DottException('Target.bench: call took too long to be measured with SysTick (2^24 cycles).')
+        name = func if isinstance(func, str) else f'0x{func:x}'
+        stack = None
+        if stack_bytes:
+            used = self._stack_used(sp, stack_bytes)
+            if used >= stack_bytes:
+                log.warn(f'Target.bench: {name} used the entire painted stack region ({stack_bytes} bytes); the '
+                         f'reported stack usage is a lower bound.')
+            stack = max(0, used - overhead_stack)
+        return BenchResult(name, [max(0, c - overhead) for c in cycles], stack)
+
+    def _stack_paint(self, num_bytes: int) -> int:
+        # paints num_bytes (if given) below the current stack pointer and returns the (word aligned) stack pointer
+        if not num_bytes:
+            return None
+        sp = self.eval('$sp') & ~0x3
+        num_words = num_bytes // 4
+        self.mem.write(sp - num_words * 4, Target._STACK_PAINT * num_words)
+        return sp
+
+    def _stack_used(self, sp: int, num_bytes: int) -> int:
+        # returns the number of bytes below sp which no longer hold the paint pattern (deepest modified word)
+        if not num_bytes:
+            return None
+        num_words = num_bytes // 4
+        data = self.mem.read(sp - num_words * 4, num_words * 4)
+        for i in range(num_words):
+            if data[i * 4:i * 4 + 4] != Target._STACK_PAINT:
+                return (num_words - i) * 4
+        return 0
+
+    def batch(self, timeout: float = None) -> 'TargetBatch':
+        """
+        Returns a new batch of memory and call commands which are executed on the target with a single target resume
+        (see TargetBatch; requires DOTT_batch_run from testhelpers.c). For example:
+            with dt.batch() as b:
+                b.memset(buf_addr, 0, 64)
+                res = b.call('example_Fill', buf_addr, 64)
+                data = b.read(buf_addr, 64)
+            assert res.value == 64 and data.value == bytes(range(64))
+
+        Args:
+            timeout: Time (in seconds) to wait for the batch to complete. Defaults to the state change timeout.
+        """
+        return TargetBatch(self, timeout)
+
     ###############################################################################################
     # Breakpoint-related target commands
 
     def bp_clear_all(self) -> None:
-        self.cli_exec('dott-bp-nostop-delete')
-        self.exec('-break-delete')
-        self.cli_exec(self._gdb_srv_quirks.monitor_clear_all_bps)
+        # note: halt points are parked by the breakpoint manager (i.e., disabled for later reuse) instead of deleted
+        bp_cmds = self._bp_manager.clear_cmds(self.bp_registry.numbers())
+        cmds = ['-interpreter-exec console "dott-bp-nostop-delete"'] + bp_cmds
+        if self._gdb_srv_quirks.monitor_clear_all_bps is not None:
+            cmds.append(f'-interpreter-exec console "{self._gdb_srv_quirks.monitor_clear_all_bps}"')
+        self.exec_check(cmds)
+        for cmd in bp_cmds:
+            self.bp_registry.applied(cmd)
+
+    def bp_arm_labels(self, labels: List[str] = None, bp_class: type = None) -> Dict[str, 'HaltPoint']:
+        """
+        Creates halt points for code labels (set with DOTT_LABEL in the target code) in one batched MI exchange.
+        The label addresses are taken from the symbol index (see BinarySymbols) such that GDB does not need to
+        resolve them.
+        For example:
+            bps = dt.bp_arm_labels(['I2C_READ_DONE', 'I2C_WRITE_DONE'])
+            dt.cont()
+            bps['I2C_READ_DONE'].wait_complete()
+
+        Args:
+            labels: Label names (with or without DOTT_LABEL_ prefix). Default: all DOTT labels of the target binary.
+            bp_class: HaltPoint (sub-)class used for the halt points (see HaltPoint.create_many). Default: HaltPoint.
+
+        Returns:
+            Dictionary which maps the given label names to the created halt points.
+        """
+        from dottmi.breakpoint import HaltPoint
+        if bp_class is None:
+            bp_class = HaltPoint
+        if labels is None:
+            labels = self._symbols.labels()
+        locations = [label if label.startswith('DOTT_LABEL_') else f'DOTT_LABEL_{label}' for label in labels]
+        return dict(zip(labels, bp_class.create_many(locations, target=self)))
 
     def bp_get_count(self) -> int:
-        res = self.exec('-break-list')
-        cnt = int(res['payload']['BreakpointTable']['nr_rows'])
-        return cnt
+        """
+        Returns the number of breakpoints set in GDB (not counting breakpoints parked by the breakpoint manager). The
+        count is taken from the breakpoint registry (no GDB exchange).
+        """
+        return self.bp_registry.count - self._bp_manager.num_parked
 
-    def _bp_get_list(self) -> []:
+    def bp_find(self, location: str) -> List[Dict]:
+        """
+        Returns GDB's breakpoint info (number, enabled, times, ...) of the breakpoints set for the given location
+        (host-local lookup in the breakpoint registry).
+        """
+        return self.bp_registry.find(location)
+
+    def bp_sync(self) -> None:
+        """
+        Re-reads the breakpoint table from GDB (-break-list) into the breakpoint registry. Only needed if breakpoints
+        were changed by MI commands issued outside of DOTT's breakpoint classes (e.g., exec('-break-delete 3')).
+        """
         res = self.exec('-break-list')
-        bp_list = res['payload']['BreakpointTable']['body']
-        return bp_list
+        bp_list = [bp.get('bkpt', bp) for bp in res['payload']['BreakpointTable']['body']]
+        nums = {int(bp['number']) for bp in bp_list if '.' not in str(bp.get('number', '.'))}
+        for num in self.bp_registry.numbers():
+            if num not in nums:
+                self.bp_registry.remove(num)
+        for bp_info in bp_list:
+            self.bp_registry.update(bp_info)
 
     ###############################################################################################
     # Register-related target commands
@@ -458,6 +2277,59 @@ class Target(NotifySubscriber):
         res = self.exec('-data-list-register-names %s' % ' '.join(str(r) for r in regs))
         return res['payload']['register-names']
 
+    def reg_get(self, name: str) -> Union[int, str, None]:
+        """
+        Returns the value of the given register (e.g., 'pc', 'sp' or 'xpsr') of the halted target. Register values are
+        cached per target stop: The first access after a stop updates the cache with the registers which changed
+        since the previous update (see reg_get_changed); all subsequent accesses do not involve GDB. eval() uses this
+        cache for expressions which only consist of a register (e.g., eval('$pc')).
+
+        Args:
+            name: Register name (without leading '$').
+
+        Returns:
+            The register value or None if the register is not known.
+        """
+        with self._cv_target_state:
+            stop_count = self._stop_count
+        if self._reg_cache is None or self._reg_cache_stop != stop_count:
+            stop_regs = self._stop_regs
+            if stop_regs is not None and stop_regs[0] == stop_count and name in stop_regs[1]:
+                return stop_regs[1][name]  # captured by GDB at the stop (see halt)
+            self._reg_cache_update()
+            self._reg_cache_stop = stop_count
+        return self._reg_cache.get(name)
+
+    def reg_cache_invalidate(self) -> None:
+        """
+        Invalidates the register cache (see reg_get). Only needed if registers are modified by other means than the
+        functions of Target (e.g., by sending MI commands with exec).
+        """
+        self._reg_cache_stop = -1
+        self._stop_regs = None
+
+    def _reg_cache_update(self) -> None:
+        if self._reg_names is None:
+            self._reg_names = self.reg_get_names()
+
+        if self._reg_cache is None:
+            # note: -data-list-changed-registers is issued as well to set GDB's baseline for the following updates
+            _, res = self.exec_many(['-data-list-changed-registers',
+                                     '-data-list-register-values --skip-unavailable x'])
+            reg_values = res['payload']['register-values']
+            self._reg_cache = {}
+        else:
+            changed = self.reg_get_changed()
+            reg_values = self.reg_get_content('x', changed) if len(changed) > 0 else []
+
+        for reg in reg_values:
+            num = int(reg['number'])
+            if num < len(self._reg_names) and self._reg_names[num] != '':
+                try:
+                    self._reg_cache[self._reg_names[num]] = int(reg['value'], 0)
+                except ValueError:
+                    self._reg_cache[self._reg_names[num]] = reg['value']  # e.g., vector registers
+
     def reg_get_changed(self) -> Dict:
         res = self.exec('-data-list-changed-registers')
         return res['payload']['changed-registers']
@@ -468,6 +2340,26 @@ class Target(NotifySubscriber):
         is outside the control/awareness of GDB.
         """
         self.cli_exec('flushregs')
+        self.reg_cache_invalidate()
+
+    # core registers which make up the execution state of an Arm Cortex-M core (see reg_snapshot)
+    _CORE_STATE_REGS = ['r0', 'r1', 'r2', 'r3', 'r4', 'r5', 'r6', 'r7', 'r8', 'r9', 'r10', 'r11', 'r12', 'msp', 'psp',
+                        'sp', 'lr', 'pc', 'xpsr', 'primask', 'basepri', 'faultmask', 'control']
+
+    def reg_snapshot(self) -> Dict[str, int]:
+        """
+        Returns the current values of the core registers (general purpose and special registers such as MSP, PSP,
+        xPSR and CONTROL) of the halted target. The registers can be restored with reg_restore.
+        """
+        self.reg_get('pc')  # note: (re-)fills the register cache for the current stop
+        return {name: val for name, val in self._reg_cache.items()
+                if name.lower() in Target._CORE_STATE_REGS and isinstance(val, int)}
+
+    def reg_restore(self, regs: Dict[str, int]) -> None:
+        """
+        Writes the given register values (as returned by reg_snapshot) to the halted target.
+        """
+        self.eval_many([f'${name} = {val}' for name, val in regs.items()])
 
     def reg_xpsr_to_str(self, xpsr: int) -> str:
         """
@@ -0,0 +1,267 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import asyncio
+import binascii
+from typing import Dict, List, Union
+
+from dottmi.breakpoint import Breakpoint
+from dottmi.dottexceptions import DottException
+from dottmi.target import Target
+from dottmi.target_mem import TypedPtr
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class _AsyncStateSubscriber(object):
+    """
+    Notification subscriber which forwards target state changes to an AsyncTarget. Note: notify is called in the
+    context of the GDB MI response handler thread. It therefore only hands the state change over to the event loop.
+    """
+    def __init__(self, async_target: 'AsyncTarget'):
+        self._async_target: 'AsyncTarget' = async_target
+
+    def notify(self, msg: Dict) -> None:
+        self._async_target._state_notify(msg)
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class AsyncTarget(object):
+    """
+    Asyncio facade for a Target. All methods are coroutines which await their results from GDB without blocking a
+    thread. This allows a single host process (and a single thread) to drive several targets and other test equipment
+    concurrently. An AsyncTarget shall only be used from one event loop.
+
+    Example:
+        async def run(t0: AsyncTarget, t1: AsyncTarget):
+            bp0 = HaltPoint('app_main', target=t0.target)
+            bp1 = HaltPoint('app_main', target=t1.target)
+            await asyncio.gather(t0.cont(), t1.cont())
+            await asyncio.gather(t0.wait_complete(bp0), t1.wait_complete(bp1))
+            res = await asyncio.gather(t0.eval('_tick_cnt'), t1.eval('_tick_cnt'))
+
+        asyncio.run(run(AsyncTarget(dott().target), AsyncTarget(other_target)))
+    """
+    def __init__(self, target: Target):
+        self._target: Target = target
+        self._loop: asyncio.AbstractEventLoop = None
+        self._state_changed: asyncio.Event = None
+        self._is_target_running: bool = target.is_running()
+        self._mem: AsyncTargetMem = AsyncTargetMem(self)
+
+        # register to get notified if the target state changes
+        self._state_subscriber = _AsyncStateSubscriber(self)
+        self._target.gdb_client.gdb_mi.response_handler.notify_subscribe(self._state_subscriber, 'stopped', None)
+        self._target.gdb_client.gdb_mi.response_handler.notify_subscribe(self._state_subscriber, 'running', None)
+
+    def close(self) -> None:
+        """
+        Stops forwarding of target state changes to this AsyncTarget. The underlying Target is not affected.
+        """
+        self._target.gdb_client.gdb_mi.response_handler.notify_unsubscribe(self._state_subscriber)
+
+    ###############################################################################################
+    # Properties
+
+    @property
+    def target(self) -> Target:
+        return self._target
+
+    @property
+    def mem(self) -> 'AsyncTargetMem':
+        return self._mem
+
+    ###############################################################################################
+    # Event loop and target state handling
+
+    def _bind_loop(self) -> asyncio.AbstractEventLoop:
+        loop = asyncio.get_running_loop()
+        if self._loop is None:
+            self._loop = loop
+            self._state_changed = asyncio.Event()
+        elif self._loop is not loop:
+            raise DottException('An AsyncTarget can only be used from a single event loop.')
+        return loop
+
+    def _state_notify(self, msg: Dict) -> None:
+        if not self._target.owns_notification(msg.get('payload')):
+            return  # state change of another core (see Target.add_core)
+        running = 'running' in msg['message']
+        loop = self._loop
+        if loop is None:
+            self._is_target_running = running
+        else:
+            loop.call_soon_threadsafe(self._set_state, running)
+
+    def _set_state(self, running: bool) -> None:
+        self._is_target_running = running
+        self._state_changed.set()
+
+    async def _wait_state(self, running: bool, wait_secs: float = None) -> None:
+        loop = self._bind_loop()
+        if not wait_secs:
+            wait_secs = self._target.state_change_wait_secs
+        end_time = loop.time() + wait_secs
+
+        while self._is_target_running != running:
+            remaining = end_time - loop.time()
+            if remaining <= 0:
+                state = 'running' if running else 'halted'
+                raise DottException(f'Target did not change to "{state}" state within {wait_secs} seconds.')
+            self._state_changed.clear()
+            if self._is_target_running == running:
+                break
+            try:
+                await asyncio.wait_for(self._state_changed.wait(), remaining)
+            except asyncio.TimeoutError:
+                pass
+
+    def is_running(self) -> bool:
+        return self._is_target_running
+
+    async def wait_halted(self, wait_secs: float = None) -> None:
+        await self._wait_state(False, wait_secs)
+
+    async def wait_running(self, wait_secs: float = None) -> None:
+        await self._wait_state(True, wait_secs)
+
+    ###############################################################################################
+    # General-purpose wrappers for on target command execution/evaluation
+
+    async def exec(self, cmd: str, timeout: float = None) -> Dict:
+        self._bind_loop()
+        return await self._target.gdb_client.gdb_mi.write_async(self._target.mi_cmd(cmd), timeout=timeout)
+
+    def exec_noblock(self, cmd: str) -> int:
+        return self._target.exec_noblock(cmd)
+
+    async def cli_exec(self, cmd: str, timeout: float = None) -> Dict:
+        return await self.exec(f'-interpreter-exec console "{cmd}"', timeout=timeout)
+
+    async def eval(self, expr: str, timeout: float = None) -> Union[int, float, bool, str, None]:
+        res = await self.exec(f'-data-evaluate-expression "{expr}"', timeout=timeout)
+        return Target._eval_res_to_py(expr, res)
+
+    async def eval_many(self, exprs: List[str], timeout: float = None) -> List[Union[int, float, bool, str, None]]:
+        # note: commands are written to GDB in order and the results are awaited concurrently
+        res = await asyncio.gather(*[self.exec(f'-data-evaluate-expression "{expr}"', timeout=timeout)
+                                     for expr in exprs])
+        return [Target._eval_res_to_py(expr, r) for expr, r in zip(exprs, res)]
+
+    ###############################################################################################
+    # Execution-related target commands
+
+    async def cont(self) -> None:
+        if self._is_target_running:
+            return
+        await self.exec('-exec-continue')
+        await self.wait_running()
+
+    async def halt(self, halt_in_it_block: bool = False) -> None:
+        """
+        Halts target execution. Refer to Target.halt for a description of the halt_in_it_block argument.
+        """
+        if not self._is_target_running:
+            return
+
+        await self.exec(self._target.interrupt_cmd())
+        await self.wait_halted()
+
+        if not halt_in_it_block:
+            xpsr_name = self._target.gdb_srv_quirks.xpsr_name
+            while self._target.reg_xpsr_in_it_block(await self.eval(f'${xpsr_name}')):
+                await self.step_inst()
+
+    async def step_inst(self) -> None:
+        self._is_target_running = True
+        await self.exec('-exec-step-instruction')
+        await self.wait_halted()
+
+    async def step(self) -> None:
+        self._is_target_running = True
+        await self.exec('-exec-step')
+        await self.wait_halted()
+
+    ###############################################################################################
+    # Breakpoint-related commands
+
+    async def wait_complete(self, bp: Breakpoint, timeout: float = None) -> None:
+        """
+        Awaits the completion of the given breakpoint (HaltPoint or InterceptPoint).
+
+        Args:
+            bp: The breakpoint to wait for.
+            timeout: Maximum time to wait. If exceeded, a TimeoutError is raised.
+        """
+        loop = self._bind_loop()
+        completed = asyncio.Event()
+
+        def _listener():
+            loop.call_soon_threadsafe(completed.set)
+
+        bp.add_complete_listener(_listener)
+        try:
+            end_time = None if timeout is None else loop.time() + timeout
+            while True:
+                completed.clear()
+                if bp.poll_complete():
+                    return
+                remaining = None if end_time is None else end_time - loop.time()
+                if remaining is not None and remaining <= 0:
+                    raise TimeoutError(f'Timeout while waiting to reach breakpoint at {bp.get_location()}.')
+                try:
+                    await asyncio.wait_for(completed.wait(), remaining)
+                except asyncio.TimeoutError:
+                    pass
+        finally:
+            bp.remove_complete_listener(_listener)
+
+
+# ----------------------------------------------------------------------------------------------------------------------
+class AsyncTargetMem(object):
+    """
+    Asyncio variant of the bulk memory access functions of TargetMem. On-target memory allocation is still done with
+    the (synchronous) TargetMem instance of the target.
+    """
+    def __init__(self, async_target: AsyncTarget):
+        self._async_target: AsyncTarget = async_target
+
+    async def read(self, src_addr: Union[int, str, TypedPtr], num_bytes: int) -> bytes:
+        """
+        Reads the requested number of bytes from the specified source address. The individual read commands are
+        pipelined.
+        """
+        addr = self._async_target.target.mem._addr_to_int(src_addr)
+        chunk_sz = self._async_target.target.mem.read_chunk_size
+        cmds = []
+        for offset in range(0, num_bytes, chunk_sz):
+            cnt = min(chunk_sz, num_bytes - offset)
+            cmds.append(self._async_target.exec(f'-data-read-memory-bytes -o 0 {addr + offset} {cnt}'))
+        results = await asyncio.gather(*cmds)
+        return binascii.unhexlify(''.join(r['payload']['memory'][0]['contents'] for r in results))
+
+    async def write(self, dst_addr: Union[int, str, TypedPtr], val: Union[int, bytes, str], cnt: int = 1) -> None:
+        """
+        Writes the provided data to target memory at destination address. Refer to TargetMem.write for details.
+        """
+        pattern = self._async_target.target.mem._val_to_bytes(val)
+        if len(pattern) == 0 or cnt <= 0:
+            return
+        content = binascii.hexlify(pattern).decode('utf8')
+        await self._async_target.exec(f'-data-write-memory-bytes {dst_addr} "{content}" {len(pattern) * cnt}')
@@ -0,0 +1,140 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Further cores of a multi-core MCU controlled in the GDB session of the primary target. Each core is a GDB inferior
+# with its own connection to a GDB server, its own symbols, register cache, memory model and hardware breakpoints.
+# The commands of each core are issued with an explicit MI thread context (--thread); hence, the cores can be used
+# concurrently without re-selecting GDB's current thread. For example:
+#
+#   net = dott().target.add_core('net', GdbServerJLink(..., device_id='nRF5340_xxAA_NET', port=2341, ...))
+#   net.load('build/net_core.elf', 'build/net_core.elf')
+#   bp = HaltPoint('ipc_rx_handler', target=net)  # halts at hits of the network core only
+#   net.cont()
+#   bp.wait_complete()
+#   log.info(net.eval('rx_count'))
+#
+# With gdb_non_stop enabled (dott.ini), halting one core (halt, breakpoint hit) does not stop the other cores.
+
+from typing import List
+
+from dottmi.breakpointhandler import BreakpointHandler, InterceptPointChannel
+from dottmi.dottexceptions import DottException
+from dottmi.gdb import GdbClient, GdbServer, GdbServerQuirks
+from dottmi.target import Target
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetCore(Target):
+    """
+    Further core of a multi-core MCU in the GDB session of its primary target (see Target.add_core). The breakpoint
+    handler and the intercept point channel of the GDB session are shared with the primary target.
+    """
+    def __init__(self, primary: Target, name: str, gdb_server: GdbServer) -> None:
+        self._primary: Target = primary
+        self._name: str = name
+        self._inferior: str = None  # GDB thread group of the core (e.g., 'i2')
+        super().__init__(gdb_server, primary.gdb_client, auto_connect=True)
+
+    def _bp_handler_start(self) -> BreakpointHandler:
+        return self._primary.bp_handler
+
+    def _subscribe_notifications(self) -> None:
+        # note: breakpoint hits are dispatched by the shared breakpoint handler (breakpoint numbers are unique per GDB)
+        response_handler = self._gdb_client.gdb_mi.response_handler
+        response_handler.notify_subscribe(self, 'stopped', None)
+        response_handler.notify_subscribe(self, 'running', None)
+
+    @property
+    def name(self) -> str:
+        return self._name
+
+    @property
+    def primary(self) -> Target:
+        return self._primary
+
+    @property
+    def inferior(self) -> str:
+        return self._inferior
+
+    @property
+    def ip_channel(self) -> InterceptPointChannel:
+        return self._primary.ip_channel
+
+    def gdb_client_connect(self) -> None:
+        """
+        Adds a GDB inferior for the core and connects it to the core's GDB server.
+        """
+        if self._gdb_server is None:
+            raise DottException(f'No GDB server instance set for core {self._name}.')
+
+        with self._cv_target_state:
+            self._thread_ids = []  # note: only notifications for all threads concern the core until it is connected
+        res = self._gdb_client.gdb_mi.write_blocking('-add-inferior')
+        self._inferior = res['payload']['inferior']
+        # note: until the thread of the core is known, commands are issued in the context of its inferior
+        self._mi_context = f'--thread-group {self._inferior}'
+        self.exec(f'-target-select remote {self._gdb_server.addr}:{self._gdb_server.port}', timeout=5)
+        thread_ids: List[str] = self._group_threads(self._inferior)
+        if len(thread_ids) == 0:
+            raise DottException(f'Unable to determine the GDB thread of core {self._name}.')
+        self._mi_context = f'--thread {thread_ids[0]}'
+
+        # the 'stopped' notification of the connect may have been received before the thread of the core was known;
+        # hence, the initial state is taken from GDB's thread list
+        res = self.exec(f'-thread-info {thread_ids[0]}')
+        running = any(t.get('state') == 'running' for t in res['payload'].get('threads', []))
+        with self._cv_target_state:
+            self._thread_ids = thread_ids
+            if running != self._is_target_running:
+                self._is_target_running = running
+                if not running:
+                    self._stop_count += 1
+            self._cv_target_state.notify_all()
+
+        self._gdb_srv_quirks = GdbServerQuirks.instantiate_quirks(self)
+        self._gdb_client_is_connected = True
+        log.info(f'Core {self._name} connected (GDB inferior {self._inferior}, thread {thread_ids[0]}).')
+
+    def gdb_client_disconnect(self) -> None:
+        if self._gdb_client_is_connected:
+            self.exec(f'-target-detach {self._inferior}')
+            self._gdb_client_is_connected = False
+            self.gdb_server_stop()
+
+    def disconnect(self) -> None:
+        """
+        Terminates the GDB server of the core. The GDB session is closed by the primary target.
+        """
+        self._type_cache.save()
+        if self._gdb_client is not None:
+            self._gdb_client.gdb_mi.response_handler.notify_unsubscribe(self)
+            self.notify_stop()
+            self._gdb_client = None
+            self._gdb_client_is_connected = False
+        if self._gdb_server is not None:
+            self._gdb_server.shutdown()
+            self._gdb_server = None
+
+    def recover(self, gdb_server: GdbServer, gdb_client: GdbClient) -> None:
+        raise DottException(f'Core {self._name} is recovered together with its primary target.')
+
+    def add_core(self, name: str, gdb_server: GdbServer) -> 'TargetCore':
+        return self._primary.add_core(name, gdb_server)
@@ -19,12 +19,20 @@
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
 import binascii
+import dataclasses
+import json
 import math
 import struct
+import threading
+import time
+import weakref
+import zlib
 from enum import Enum
-from typing import Union, Dict
+from typing import Union, Dict, List, Set, Tuple
 
 from dottmi.dottexceptions import DottException
+from dottmi.type_cache import TypeCache
+from dottmi.type_layout import TypeLayout
 from dottmi.utils import log
 
 ALIGN_DEFAULT = 4  # default alignment for memory allocation is 4 bytes
@@ -37,6 +45,7 @@ class TargetMemModel(Enum):
     NOALLOC  = 0x0  # Don't use any of the built-in on-target memory allocation models.
     TESTHOOK = 0x1  # DOTT test-hook based memory allocation
     PRESTACK = 0x2  # memory allocation prior to stack memory ('stack stealing')
+    SECTION  = 0x3  # memory allocation in a dedicated linker section (see DOTT_TEST_HOOK_MEM_SECTION)
 
     @classmethod
     def get_keys(cls):
@@ -91,20 +100,26 @@ class TypedPtr:
         """
         return self._target.eval(f'*({self.__str__()})')
 
-    def __getitem__(self, key) -> Union[int, float, bool, str, None]:
+    def __getitem__(self, key) -> Union[int, float, bool, str, None, List]:
         """
         Allows access to items pointed to by TypedPtr in index notation. Example:
         p = dott().target.mem.alloc_type('uint32_t', cnt=16)
         p[8] = 0xdeadbeef
         print('0x%x' % p[8])
 
+        Slices (e.g., p[0:16]) are read from the target with a single memory transfer and are decoded on the host.
+        Slices are supported for integer and floating point element types.
+
         Important: The implementation does not perform array index checking.
 
         Args:
-            key: Index used for accessing the array data pointed to by the TypedPtr instance.
+            key: Index (or slice) used for accessing the array data pointed to by the TypedPtr instance.
 
-        Returns: The value at index key.
+        Returns: The value at index key (or a list of values if key is a slice).
         """
+        if isinstance(key, slice):
+            start, stop, step = self._slice_range(key)
+            return self._read_elems(start, stop - start)[::step]
         return self._target.eval(f'{self.__str__()}[{key}]')
 
     def __setitem__(self, key, value) -> None:
@@ -112,17 +127,75 @@ class TypedPtr:
         Allows access to items pointed to by TypedPtr in index notation. Example:
         p = dott().target.mem.alloc_type('uint32_t', cnt=16)
         p[8] = 0xdeadbeef
+        p[0:4] = [1, 2, 3, 4]
         print('0x%x' % p[8])
 
+        Slice assignments are written to the target with a single memory transfer. If the slice has no stop index,
+        the number of elements is defined by the provided values.
+
         Important: The implementation does not perform array index checking.
 
         Args:
-            key: Index used for accessing the array data pointed to by the TypedPtr instance.
-
-        Returns: The value at index key.
+            key: Index (or slice) used for accessing the array data pointed to by the TypedPtr instance.
+            value: The value (or sequence of values if key is a slice) to be written.
         """
+        if isinstance(key, slice):
+            start, stop, step = self._slice_range(key, len(value))
+            if step != 1:
+                raise ValueError('Slice assignment only supports a step size of 1.')
+            if stop - start != len(value):
+                raise ValueError(f'Slice assignment requires {stop - start} values but {len(value)} were given.')
+            self._write_elems(start, value)
+            return
         self._target.eval(f'{self.__str__()}[{key}] = {value}')
 
+    def _slice_range(self, key: slice, default_len: int = None) -> Tuple[int, int, int]:
+        start = 0 if key.start is None else key.start
+        step = 1 if key.step is None else key.step
+        stop = key.stop
+        if stop is None:
+            if default_len is None:
+                raise ValueError('Slices of a TypedPtr require a stop index.')
+            stop = start + default_len
+        if start < 0 or stop < start or step < 1:
+            raise ValueError('Slices of a TypedPtr only support non-negative, ascending ranges.')
+        return start, stop, step
+
+    def _elem_fmt(self) -> Tuple[int, str]:
+        sz, fmt = self._target.mem.elem_format(self._var_type)
+        byte_order = '<' if self._target.byte_order == 'little' else '>'
+        return sz, byte_order + fmt
+
+    def _read_elems(self, start: int, cnt: int) -> List:
+        sz, fmt = self._elem_fmt()
+        data = self._target.mem.read(self._addr + start * sz, cnt * sz)
+        return list(struct.unpack(f'{fmt[0]}{cnt}{fmt[1:]}', data))
+
+    def _write_elems(self, start: int, values) -> None:
+        sz, fmt = self._elem_fmt()
+        data = struct.pack(f'{fmt[0]}{len(values)}{fmt[1:]}', *values)
+        self._target.mem.write(self._addr + start * sz, data)
+
+    def to_numpy(self, cnt: int, start: int = 0) -> 'numpy.ndarray':
+        """
+        Reads cnt elements (starting at element index start) with a single memory transfer and returns them as
+        numpy array with a dtype matching the element type (size, signedness and byte order).
+        """
+        import numpy
+        sz, fmt = self._elem_fmt()
+        data = self._target.mem.read(self._addr + start * sz, cnt * sz)
+        return numpy.frombuffer(bytearray(data), dtype=numpy.dtype(fmt))
+
+    def from_numpy(self, arr: 'numpy.ndarray', start: int = 0) -> None:
+        """
+        Writes the elements of the given numpy array (converted to the element type) to the target with a single
+        memory transfer, starting at element index start.
+        """
+        import numpy
+        sz, fmt = self._elem_fmt()
+        data = numpy.asarray(arr).astype(numpy.dtype(fmt)).tobytes()
+        self._target.mem.write(self._addr + start * sz, data)
+
     def __str__(self) -> str:
         """
         This function returns a string containing address in hex (pre-fixed with 0x) together with the type of
@@ -134,8 +207,156 @@ class TypedPtr:
         return f'(({self._var_type}*)0x{self._addr:x})'
 
 
+# -------------------------------------------------------------------------------------------------
+class MemBackend(object):
+    """
+    Transport used by TargetMem for bulk memory transfers. TargetMem selects the backend per transfer based on the
+    target state (see usable) and the estimated duration of the transfer (see estimate). The estimate is a simple
+    cost model (per-transfer latency plus bytes over throughput) whose parameters start at the class defaults and
+    follow the measured transfers.
+    """
+    NAME = 'none'
+    LATENCY_SEC = 0.002  # default duration of a small transfer (seconds)
+    THROUGHPUT = 500e3  # default throughput of large transfers (bytes per second)
+
+    # transfers up to this size update the latency estimate; larger transfers update the throughput estimate
+    SMALL_TRANSFER = 256
+
+    def __init__(self) -> None:
+        self.latency: float = type(self).LATENCY_SEC
+        self.throughput: float = type(self).THROUGHPUT
+        self.num_transfers: int = 0
+        self.num_bytes: int = 0
+
+    def usable(self, running: bool, write: bool) -> bool:
+        return False
+
+    def estimate(self, num_bytes: int) -> float:
+        """
+        Returns the estimated duration (in seconds) of a transfer of num_bytes bytes.
+        """
+        return self.latency + num_bytes / self.throughput
+
+    def _account(self, num_bytes: int, duration: float) -> None:
+        self.num_transfers += 1
+        self.num_bytes += num_bytes
+        if duration <= 0:
+            return
+        if num_bytes <= MemBackend.SMALL_TRANSFER:
+            self.latency = 0.75 * self.latency + 0.25 * duration
+        else:
+            self.throughput = 0.75 * self.throughput + 0.25 * num_bytes / max(duration - self.latency, duration / 2)
+
+    def read(self, addr: int, num_bytes: int, out: memoryview = None) -> Union[bytes, None]:
+        raise NotImplementedError()
+
+    def read_many(self, ranges: List[Tuple[int, int]]) -> List[bytes]:
+        return [self.read(addr, num_bytes) for addr, num_bytes in ranges]
+
+    def write(self, addr: Union[int, str], data: bytes, num_bytes: int = None) -> None:
+        raise NotImplementedError()
+
+    def __str__(self) -> str:
+        return f'{self.NAME} ({self.latency * 1e3:.2f}ms, {self.throughput / 1e6:.2f}MB/s)'
+
+
+class MemBackendGdb(MemBackend):
+    """
+    Memory transfers via GDB (MI). Requires the target to be halted.
+    """
+    NAME = 'gdb'
+
+    def __init__(self, mem: 'TargetMem') -> None:
+        super().__init__()
+        self._mem: 'TargetMem' = mem
+
+    def usable(self, running: bool, write: bool) -> bool:
+        return not running
+
+    def read(self, addr: int, num_bytes: int, out: memoryview = None) -> Union[bytes, None]:
+        return self._mem._read_mi(addr, num_bytes, out)
+
+    def read_many(self, ranges: List[Tuple[int, int]]) -> List[bytes]:
+        # the reads of all ranges are pipelined, i.e., they cost a single MI exchange
+        results = self._mem._target.exec_many([f'-data-read-memory-bytes -o 0 {addr} {n}' for addr, n in ranges])
+        contents = []
+        for (addr, num_bytes), res in zip(ranges, results):
+            data = binascii.unhexlify(res['payload']['memory'][0]['contents'])
+            if len(data) < num_bytes:
+                data += self._mem._read_mi(addr + len(data), num_bytes - len(data))
+            contents.append(data)
+        return contents
+
+    def write(self, addr: Union[int, str], data: bytes, num_bytes: int = None) -> None:
+        # note: if num_bytes exceeds the length of data, GDB repeats data until num_bytes bytes are written
+        content = binascii.hexlify(data).decode('utf8')
+        if num_bytes is None or num_bytes == len(data):
+            self._mem._target.exec_check(f'-data-write-memory-bytes {addr} "{content}"')
+        else:
+            self._mem._target.exec_check(f'-data-write-memory-bytes {addr} "{content}" {num_bytes}')
+
+
+class MemBackendDirect(MemBackend):
+    """
+    Memory transfers via a direct probe connection (TargetDirect or AgentTargetDirect) which bypasses GDB. Reads are
+    also possible while the target is running; writes require a direct connection with byte-wise write support
+    (mem_write). GDB's data cache is invalidated after writes to the halted target.
+    """
+    NAME = 'direct'
+    LATENCY_SEC = 0.001
+    THROUGHPUT = 1e6
+
+    def __init__(self, direct: 'TargetDirect', target: 'Target') -> None:
+        super().__init__()
+        self.direct: 'TargetDirect' = direct
+        self._target: 'Target' = target
+
+    def usable(self, running: bool, write: bool) -> bool:
+        return not write or hasattr(self.direct, 'mem_write')
+
+    def read(self, addr: int, num_bytes: int, out: memoryview = None) -> Union[bytes, None]:
+        if out is None:
+            return self.direct.mem_read(addr, num_bytes)
+        for offset in range(0, num_bytes, TargetMem.READ_BATCH_SIZE):
+            n = min(TargetMem.READ_BATCH_SIZE, num_bytes - offset)
+            out[offset:offset + n] = self.direct.mem_read(addr + offset, n)
+        return None
+
+    def read_many(self, ranges: List[Tuple[int, int]]) -> List[bytes]:
+        if hasattr(self.direct, 'mem_read_batch'):
+            return self.direct.mem_read_batch(ranges)  # a single network round trip via a DOTT agent
+        return super().read_many(ranges)
+
+    def write(self, addr: int, data: bytes, num_bytes: int = None) -> None:
+        if num_bytes is not None and num_bytes != len(data):
+            data = (data * -(-num_bytes // len(data)))[:num_bytes]
+        for offset in range(0, len(data), TargetMem.READ_BATCH_SIZE):
+            self.direct.mem_write(addr + offset, data[offset:offset + TargetMem.READ_BATCH_SIZE])
+        if not self._target.is_running():
+            self._target.gdb_cache_invalidate()
+
+
 # -------------------------------------------------------------------------------------------------
 class TargetMem(object):
+    # Number of bytes per MI memory read command. GDB internally splits reads according to the packet size supported
+    # by the GDB server. Hence, large chunks save MI round trips. The chunk size is reduced (down to the minimum)
+    # if the GDB server rejects reads of the current chunk size.
+    READ_CHUNK_SIZE_MAX = 16384
+    READ_CHUNK_SIZE_MIN = 256
+
+    # Maximum number of bytes requested with one pipelined batch of MI read commands (and read from a direct
+    # connection at once). This bounds the host memory used for responses in flight when large captures are read
+    # into a buffer (see read and read_to_file).
+    READ_BATCH_SIZE = 1024 * 1024
+
+    # minimum size of writes which are compressed if enabled (see Target.mem_write_compress); smaller writes do not
+    # amortize the target resume of the batch executor
+    COMPRESS_MIN_BYTES = 4096
+
+    # minimum size of GDB transfers which run at the bulk interface speed (see Target.clock_phase); smaller transfers
+    # do not amortize the two speed switches
+    BULK_CLOCK_MIN_BYTES = 64 * 1024
+
     def __init__(self, target: 'Target', target_mem_start_addr: int, target_mem_num_bytes: int, zero_mem: bool = True):
         """
         Constructor.
@@ -144,24 +365,143 @@ class TargetMem(object):
             target: The target instance.
             target_mem_start_addr: The memory address where DOTT's on-target scratchpad memory starts.
             target_mem_num_bytes: The size in bytes of DOTT's on-target scratchpad memory.
-            zero_mem: Zero out the on-target scratchpad memory when calling reset (default: True).
+            zero_mem: Zero out on-target scratchpad memory when it is allocated (default: True).
         """
         self._target: 'Target' = target
-        self._sz_types: Dict = {}  # dict with target sizes (cache used by sizeof)
+        # cache with target sizes, element decoding formats and type layouts (shared by all TargetMem instances of
+        # the target and persisted across sessions; see TypeCache)
+        self._types: TypeCache = target.type_cache
         self._heap_next_free_addr: int = target_mem_start_addr
         self._target_mem_base_addr: int = target_mem_start_addr
         self._target_mem_num_bytes: int = target_mem_num_bytes
         self._zero_mem = zero_mem
+        self._free_blocks: List[Tuple[int, int]] = []  # sorted list of freed blocks (address, size)
+        self._allocs: Dict[int, int] = {}  # live allocations (address -> size)
+        self._read_chunk_size: int = TargetMem.READ_CHUNK_SIZE_MAX
+        self._read_throughput: float = 0.0
+        self._direct: 'TargetDirect' = None
+        self._backends: List[MemBackend] = [MemBackendGdb(self)]
+        self._last_backend: MemBackend = None
         self.reset()
 
+    @property
+    def direct(self) -> 'TargetDirect':
+        """
+        Direct connection to the target (TargetDirect or AgentTargetDirect) which is added as memory transport
+        backend (see backends). Set to None to only use GDB for memory accesses (default).
+        """
+        return self._direct
+
+    @direct.setter
+    def direct(self, direct: 'TargetDirect') -> None:
+        self._backends = [b for b in self._backends if not isinstance(b, MemBackendDirect)]
+        if direct is not None:
+            self._backends.append(MemBackendDirect(direct, self._target))
+        self._direct = direct
+
+    @property
+    def backends(self) -> List[MemBackend]:
+        """
+        The memory transport backends available for transfers. Each transfer is performed by the usable backend
+        (given the target state) with the lowest estimated duration. While the target is running, backends other
+        than GDB are preferred. GDB is used if no other backend is usable.
+        """
+        return self._backends
+
+    @property
+    def last_backend(self) -> MemBackend:
+        """
+        The backend which performed the last transfer.
+        """
+        return self._last_backend
+
+    def add_backend(self, backend: MemBackend) -> None:
+        """
+        Adds a memory transport backend (e.g., for a high-speed debug link of the board).
+        """
+        self._backends.append(backend)
+
+    def _select(self, num_bytes: int, write: bool, addr: Union[int, str] = 0) -> MemBackend:
+        running = self._target.is_running()
+        usable = [b for b in self._backends if b.usable(running, write)]
+        if not isinstance(addr, int):
+            usable = []  # address expressions can only be evaluated by GDB
+        if running:
+            usable = [b for b in usable if not isinstance(b, MemBackendGdb)] or usable
+        backend = min(usable, key=lambda b: b.estimate(num_bytes)) if len(usable) > 0 else self._backends[0]
+        self._last_backend = backend
+        return backend
+
+    def _clock_phase(self, backend: MemBackend, num_bytes: int):
+        # large transfers via GDB (i.e., via the GDB server's probe connection) run as bulk clock phase
+        bulk = isinstance(backend, MemBackendGdb) and num_bytes >= TargetMem.BULK_CLOCK_MIN_BYTES
+        return self._target.clock_phase('bulk' if bulk else None)
+
+    @property
+    def region(self) -> Tuple[int, int]:
+        """
+        Start address and size (in bytes) of the on-target scratchpad memory.
+        """
+        return self._target_mem_base_addr, self._target_mem_num_bytes
+
+    @property
+    def read_chunk_size(self) -> int:
+        return self._read_chunk_size
+
+    @property
+    def read_throughput(self) -> float:
+        """
+        Returns the throughput (in MB/s) of the last call to read.
+        """
+        return self._read_throughput
+
     def _bytes_needed(self, n):
         if n == 0:
             return 1
         return int(math.log(n, 256)) + 1
 
-    def _write_raw(self, dst_addr: Union[int, str, TypedPtr], values: bytes) -> None:
-        content = binascii.hexlify(struct.pack('<%dB' % len(values), *values)).decode('utf8')
-        self._target.exec(f'-data-write-memory-bytes {dst_addr} "{content}"')
+    def _write_raw(self, dst_addr: Union[int, str, TypedPtr], values: bytes, num_bytes: int = None,
+                   compress: bool = True) -> None:
+        # note: if num_bytes exceeds the length of values, values is repeated until num_bytes bytes are written
+        if isinstance(dst_addr, TypedPtr):
+            dst_addr = dst_addr.addr
+        elif isinstance(dst_addr, str) and dst_addr.strip().isdigit():
+            dst_addr = int(dst_addr)
+        n = num_bytes if num_bytes is not None else len(values)
+        if isinstance(dst_addr, int):
+            self._target.vector_cache.invalidate(dst_addr, n)
+            if compress and n >= TargetMem.COMPRESS_MIN_BYTES and self._target.mem_write_compress and \
+                    self._write_compressed(dst_addr, values, n):
+                return
+        backend = self._select(n, True, dst_addr)
+        with self._clock_phase(backend, n):
+            start = time.perf_counter()
+            backend.write(dst_addr, values, num_bytes)
+            backend._account(n, time.perf_counter() - start)
+
+    def _write_compressed(self, dst_addr: int, values: bytes, num_bytes: int) -> bool:
+        # writes via the on-target batch executor (see TargetBatch): fills are expanded by the target and other data
+        # is uploaded run-length encoded. Returns False (nothing written) if the data does not compress to at most
+        # half of its size or if the batch executor is not available.
+        from dottmi.batch import TargetBatch
+        if self._target.is_running() or not self._target.symbols.exists('DOTT_batch_run'):
+            return False
+        batch = TargetBatch(self._target)
+        if num_bytes > len(values):
+            batch.fill(dst_addr, values, num_bytes)
+        else:
+            encoded = TargetBatch.rle_encode(values)
+            if len(encoded) > num_bytes // 2:
+                return False
+            res = batch.write_rle(dst_addr, values, encoded)
+        try:
+            batch.run()
+        except DottException as ex:
+            log.debug(f'Compressed write of {num_bytes} bytes failed ({ex}). Writing uncompressed.')
+            return False
+        if num_bytes == len(values) and res.value != num_bytes:
+            raise DottException(f'Compressed write to 0x{dst_addr:x} wrote {res.value} of {num_bytes} bytes.')
+        return True
 
     def sizeof(self, target_type: str) -> int:
         """
@@ -173,16 +513,97 @@ class TargetMem(object):
         Returns:
             The size in bytes of the data type on target.
         """
-        if target_type not in self._sz_types.keys():
+        if target_type not in self._types.sizes:
             try:
                 sz = int(self._target.eval('sizeof(%s)' % target_type))
-                self._sz_types[target_type] = sz
+                self._types.sizes[target_type] = sz
+                self._types.mark_dirty()
             except:
                 log.error('Unable to determine size for target type %s' % target_type)
 
-        return self._sz_types[target_type]
+        return self._types.sizes[target_type]
 
-    def write(self, dst_addr: Union[int, str, TypedPtr], val: Union[int, bytes, str], cnt: int = 1) -> None:
+    def type_layout(self, target_type: str) -> TypeLayout:
+        """
+        This function returns the memory layout (member offsets, sizes and types) of the given target data type.
+        The layout is queried from GDB once and is then cached.
+
+        Args:
+            target_type: Name of the target data type (e.g., 'my_add_t' or 'struct my_struct').
+
+        Returns:
+            The layout of the target type.
+        """
+        if target_type not in self._types.layouts:
+            status, payload = self._target.exec_dott('dott-type-layout', target_type)
+            payload = bytes.fromhex(payload).decode()
+            if status != 'OK':
+                raise DottException(f'Unable to determine layout of type {target_type} ({payload}).')
+            layout = json.loads(payload)
+            self._types.layouts[target_type] = layout
+            self._types.sizes[target_type] = layout['size']
+            self._types.mark_dirty()
+        return TypeLayout(self._types.layouts[target_type], self._target.byte_order)
+
+    def read_struct(self, src_addr: Union[int, str, TypedPtr], target_type: str) -> Union[Dict, List, int, float]:
+        """
+        This function reads a variable of the given (typically composite) target type with a single memory read and
+        converts it into a Python value. Structs and unions are returned as dicts, arrays as lists.
+
+        Args:
+            src_addr: The target's source memory address to read from.
+            target_type: Name of the target data type.
+
+        Returns:
+            The Python representation of the variable.
+        """
+        layout = self.type_layout(target_type)
+        return layout.unpack(self.read(src_addr, layout.size))
+
+    def write_struct(self, dst_addr: Union[int, str, TypedPtr], target_type: str, val) -> None:
+        """
+        This function converts the given Python value (dict or dataclass for structs, list for arrays) to the memory
+        representation of the target type and writes it with a single memory write. If val does not provide all
+        members, the remaining members keep their current content on the target.
+
+        Args:
+            dst_addr: The target's destination memory address to write to.
+            target_type: Name of the target data type.
+            val: The value to be written.
+        """
+        layout = self.type_layout(target_type)
+        base = None if layout.is_complete(val) else self.read(dst_addr, layout.size)
+        self.write(dst_addr, layout.pack(val, base))
+
+    def elem_format(self, target_type: str) -> Tuple[int, str]:
+        """
+        This function returns size and struct format character (without byte order) used to decode elements of the
+        given scalar (integer or floating point) target type on the host.
+
+        Args:
+            target_type: Name of the target data type.
+
+        Returns:
+            Tuple with the size in bytes of the type and the struct format character.
+        """
+        if target_type not in self._types.elem_fmts:
+            sz = self.sizeof(target_type)
+            is_float, is_signed = self._target.eval_many([f'(({target_type})0.5) != 0', f'(({target_type})-1) < 0'])
+            if is_float and sz in (4, 8):
+                fmt = {4: 'f', 8: 'd'}[sz]
+            elif sz in (1, 2, 4, 8):
+                fmt = {1: 'b', 2: 'h', 4: 'i', 8: 'q'}[sz]
+                if not is_signed:
+                    fmt = fmt.upper()
+            else:
+                raise DottException(f'Type {target_type} (size: {sz}) is not a scalar integer or floating point type.')
+            self._types.elem_fmts[target_type] = [sz, fmt]
+            self._types.mark_dirty()
+        sz, fmt = self._types.elem_fmts[target_type]
+        return sz, fmt
+
+    def write(self, dst_addr: Union[int, str, TypedPtr], val: Union[int, bytes, str], cnt: int = 1,
+              verify: bool = False) -> None:
         """
         This function writes the provided data to target memory at destination address. If cnt is other than one,
         the provided data is replicated cnt times.
@@ -191,71 +612,259 @@ class TargetMem(object):
             dst_addr: The target's destination memory address to write to.
             val: Content to be written to the target.
             cnt: The number of times val shall be repeated when writing to the target.
+            verify: If True, the written memory is verified afterwards (see verify).
+        """
+        pattern = self._val_to_bytes(val)
+        if len(pattern) == 0 or cnt <= 0:
+            return
+        # the pattern is only transferred once; GDB replicates it on the target
+        self._write_raw(dst_addr, pattern, len(pattern) * cnt)
+        if verify:
+            self.verify(dst_addr, pattern, len(pattern) * cnt)
+
+    def fill(self, dst_addr: Union[int, str, TypedPtr], byte_val: int, num_bytes: int, verify: bool = False) -> None:
+        """
+        This function fills the given target memory region with a byte value. Only the value (and not the entire
+        content of the memory region) is transferred to GDB.
+
+        Args:
+            dst_addr: The target's destination memory address to write to.
+            byte_val: The value (0..255) each byte of the memory region shall be set to.
+            num_bytes: The size of the memory region in bytes.
+            verify: If True, the written memory is verified afterwards (see verify).
+        """
+        if num_bytes > 0:
+            self._write_raw(dst_addr, bytes([byte_val]), num_bytes)
+            if verify:
+                self.verify(dst_addr, bytes([byte_val]), num_bytes)
+
+    # number of bytes of a repeated pattern passed to zlib.crc32 at once (see verify)
+    _VERIFY_CRC_CHUNK = 65536
+
+    def verify(self, dst_addr: Union[int, str, TypedPtr], data: bytes, num_bytes: int = None) -> None:
+        """
+        Verifies that the target memory at the given address holds data (repeated until num_bytes bytes if num_bytes
+        exceeds the length of data). The target computes the CRC-32 of the memory (see crc) which is compared to the
+        CRC-32 computed on the host, i.e., only the CRC has to be transferred instead of the memory content. If the
+        target is running or the target-side CRC helper is not available, the memory is read back and compared. A
+        DottException is raised if the memory differs. Example:
+            dt.mem.write(p_buf, test_vector, verify=True)
         """
+        data = bytes(data)
+        n = num_bytes if num_bytes is not None else len(data)
+        if n <= 0 or len(data) == 0:
+            return
+        if isinstance(dst_addr, str) and not dst_addr.strip().isdigit():
+            addr = int(self._target.eval(f'(unsigned long)({dst_addr})'))
+        else:
+            addr = self._addr_to_int(int(dst_addr) if isinstance(dst_addr, str) else dst_addr)
+
+        if not self._target.is_running():
+            expected = 0
+            block = data * max(1, TargetMem._VERIFY_CRC_CHUNK // len(data))
+            for offset in range(0, n, len(block)):
+                expected = zlib.crc32(block[:min(len(block), n - offset)], expected)
+            try:
+                crc = self.crc(addr, n)
+            except DottException as ex:
+                log.debug(f'Verifying write by reading back memory ({ex}).')
+            else:
+                if crc != expected:
+                    raise DottException(f'Verification of {n} bytes written to 0x{addr:08x} failed (target CRC '
+                                        f'0x{crc:08x}, expected 0x{expected:08x}).')
+                return
+
+        content = self.read(addr, n)
+        expected_data = (data * -(-n // len(data)))[:n]
+        if content != expected_data:
+            offset = next(i for i in range(n) if content[i] != expected_data[i])
+            raise DottException(f'Verification of {n} bytes written to 0x{addr:08x} failed (first difference at '
+                                f'0x{addr + offset:08x}).')
+
+    def _val_to_bytes(self, val: Union[int, bytes, str], cnt: int = 1) -> bytes:
         if isinstance(val, int):
             # note: int.to_bytes raises exception if type_sz != val size
             bval = val.to_bytes(self._bytes_needed(val), byteorder=self._target.byte_order)
-            self._write_raw(dst_addr, bval * cnt)
+            return bval * cnt
         elif isinstance(val, bytes):
-            self._write_raw(dst_addr, val * cnt)
+            return val * cnt
         elif isinstance(val, str):
             bval = bytes(val, encoding='ascii')
-            self._write_raw(dst_addr, bval * cnt)
+            return bval * cnt
         else:
             raise ValueError('Only int, bytes or str (ascii) are supported as val types')
 
-    def read(self, src_addr: Union[int, str, TypedPtr], num_bytes: int) -> bytes:
+    @staticmethod
+    def _addr_to_int(addr: Union[int, str, TypedPtr]) -> int:
+        if isinstance(addr, int):
+            return addr
+        elif isinstance(addr, str):
+            return int(addr, 10)
+        elif isinstance(addr, TypedPtr):
+            return addr.addr
+        else:
+            raise ValueError('Illegal type for src_addr')
+
+    def read(self, src_addr: Union[int, str, TypedPtr], num_bytes: int, out=None) -> Union[bytes, object]:
         """
-        This function reads the requested number of bytes from the specified source address.
+        This function reads the requested number of bytes from the specified source address. The data is read via
+        the memory transport backend with the lowest estimated duration (see backends), e.g., via a direct (J-Link)
+        connection (see property direct) or via GDB using pipelined read commands.
 
         Args:
             src_addr: The target's source memory address to read from.
             num_bytes: The number of bytes to read from target memory.
+            out: Optional writable buffer (e.g., bytearray or numpy.memmap) of at least num_bytes bytes. If given,
+                 the data is written into this buffer while it is received (in batches of READ_BATCH_SIZE bytes)
+                 instead of being collected in a bytes object. See also read_to_file.
 
         Returns:
-            Returns the bytes read from the target.
-        """
-        num_remaining: int = num_bytes
-        if isinstance(src_addr, int):
-            addr_to_read = src_addr
-        elif isinstance(src_addr, str):
-            addr_to_read = int(src_addr, 10)
-        elif isinstance(src_addr, TypedPtr):
-            addr_to_read = src_addr.addr
-        else:
-            raise ValueError('Illegal type for src_addr')
-        content = ''
+            Returns the bytes read from the target (or out if given).
+        """
+        addr_to_read = self._addr_to_int(src_addr)
+        view = memoryview(out).cast('B') if out is not None else None
+        if view is not None and len(view) < num_bytes:
+            raise DottException(f'Output buffer ({len(view)} bytes) is smaller than the read ({num_bytes} bytes).')
+        backend = self._select(num_bytes, False)
+
+        with self._clock_phase(backend, num_bytes):
+            start = time.perf_counter()
+            if out is not None:
+                backend.read(addr_to_read, num_bytes, view)
+                content = out
+            else:
+                content = backend.read(addr_to_read, num_bytes)
+            duration = time.perf_counter() - start
+
+        backend._account(num_bytes, duration)
+        if duration > 0:
+            self._read_throughput = (num_bytes / (1024 * 1024)) / duration
+        return content
+
+    def read_many(self, ranges: List[Tuple[int, int]]) -> List[bytes]:
+        """
+        Reads several (small) memory ranges. Via GDB, the reads of all ranges are pipelined, i.e., they cost a single
+        MI exchange instead of one per range.
 
-        while num_remaining > 0:
-            bytes_to_read = 1024
-            if num_remaining < 1024:
-                bytes_to_read = num_remaining
+        Args:
+            ranges: Memory ranges given as (start address, number of bytes).
 
-            data = self._target.exec(f'-data-read-memory-bytes -o 0 {addr_to_read} {bytes_to_read}')
-            buf = data['payload']['memory'][0]['contents']
-            buf_len = len(buf) / 2
-            content += buf
+        Returns:
+            The content of each range (in the order of the given ranges).
+        """
+        if len(ranges) == 0:
+            return []
+        num_bytes = sum(n for _, n in ranges)
+        backend = self._select(num_bytes, False)
+        start = time.perf_counter()
+        contents = backend.read_many(ranges)
+        backend._account(num_bytes, time.perf_counter() - start)
+        return contents
+
+    def read_to_file(self, src_addr: Union[int, str, TypedPtr], num_bytes: int, file_name: str,
+                     dtype: str = 'u1') -> 'numpy.memmap':
+        """
+        Reads a (large) memory range, e.g., a capture buffer in external RAM, directly into a memory-mapped file.
+        The capture does not have to fit into the Python heap and can be analysed incrementally afterwards (the
+        file is a raw memory image which can be opened again with numpy.memmap). Example:
+            frames = dott().target.mem.read_to_file(0x60000000, 8 * 1024 * 1024, 'frames.bin', dtype='<u2')
+            print(frames[:1024].mean())
 
-            num_remaining -= buf_len
-            addr_to_read += buf_len
+        Args:
+            src_addr: The target's source memory address to read from.
+            num_bytes: The number of bytes to read (a multiple of the element size of dtype).
+            file_name: File to be written (an existing file is overwritten).
+            dtype: numpy data type of the elements of the returned array.
 
-        return binascii.unhexlify(content)
+        Returns:
+            The memory-mapped file as numpy array.
+        """
+        import numpy  # note: numpy is only required if this function is used
+        dt = numpy.dtype(dtype)
+        if num_bytes % dt.itemsize != 0:
+            raise DottException(f'{num_bytes} bytes are not a multiple of the element size of {dtype}.')
+        arr = numpy.memmap(file_name, dtype=dt, mode='w+', shape=(num_bytes // dt.itemsize,))
+        self.read(src_addr, num_bytes, out=arr)
+        arr.flush()
+        return arr
+
+    def _read_mi(self, addr: int, num_bytes: int, out: memoryview = None) -> Union[bytes, None]:
+        buf = out if out is not None else bytearray(num_bytes)
+        offset = 0
+
+        while offset < num_bytes:
+            chunk_sz = self._read_chunk_size
+            batch_end = min(num_bytes, offset + max(chunk_sz, TargetMem.READ_BATCH_SIZE))
+            chunks = [(o, min(chunk_sz, batch_end - o)) for o in range(offset, batch_end, chunk_sz)]
+            try:
+                results = self._target.exec_many([f'-data-read-memory-bytes -o 0 {addr + o} {n}' for o, n in chunks])
+            except TimeoutError:
+                raise
+            except Exception:
+                # Some GDB servers reject large reads. Reduce the chunk size (it is kept for subsequent reads).
+                if chunk_sz <= TargetMem.READ_CHUNK_SIZE_MIN:
+                    raise
+                self._read_chunk_size = max(chunk_sz // 2, TargetMem.READ_CHUNK_SIZE_MIN)
+                log.debug(f'Memory read failed. Reducing read chunk size to {self._read_chunk_size} bytes.')
+                continue
+
+            for (o, n), res in zip(chunks, results):
+                data = binascii.unhexlify(res['payload']['memory'][0]['contents'])
+                buf[o:o + len(data)] = data
+                offset = o + len(data)
+                if len(data) < n:
+                    break  # short read; continue reading right after the data received so far
+
+        return bytes(buf) if out is None else None
 
     def reset(self) -> None:
         """
-        This function resets the on-target memory. It sets the next_element pointer back to the first element and it
-        zeros out the on-target memory region used for memory allocation.
+        This function resets the on-target memory. It sets the next_element pointer back to the first element and
+        discards all allocations. Note: Memory is zeroed lazily, i.e., when it is handed out by alloc.
         """
         self._heap_next_free_addr = self._target_mem_base_addr
-        if self._zero_mem:
-            # note: bytes(sz) creates zero-filled bytes object of length sz
-            self.write(self._target_mem_base_addr, bytes(self._target_mem_num_bytes))
+        self._free_blocks = []
+        self._allocs = {}
+
+    def _alloc(self, req_num_bytes: int, align: int, zero_mem: bool) -> int:
+        addr: int = None
+
+        # first-fit search in the list of freed blocks
+        for i, (blk_addr, blk_sz) in enumerate(self._free_blocks):
+            align_delta = (align - blk_addr % align) % align
+            if align_delta + req_num_bytes <= blk_sz:
+                addr = blk_addr + align_delta
+                rest = [(blk_addr, align_delta), (addr + req_num_bytes, blk_sz - align_delta - req_num_bytes)]
+                self._free_blocks[i:i + 1] = [(a, n) for a, n in rest if n > 0]
+                break
+
+        if addr is None:
+            align_delta: int = 0
+            if self._heap_next_free_addr % align != 0:
+                align_delta = align - (self._heap_next_free_addr % align)
+
+            # number of bytes still available on target for memory allocation
+            avail_bytes: int = (self._target_mem_base_addr + self._target_mem_num_bytes) - (self._heap_next_free_addr + align_delta)
+
+            assert(req_num_bytes <= avail_bytes), 'unable to allocate %d bytes of on-target memory' % req_num_bytes
+
+            addr = self._heap_next_free_addr + align_delta
+            if align_delta > 0:
+                self._free_blocks.append((self._heap_next_free_addr, align_delta))
+            self._heap_next_free_addr += align_delta + req_num_bytes
+
+        self._allocs[addr] = req_num_bytes
+        if zero_mem:
+            self.fill(addr, 0x00, req_num_bytes)
+        return addr
 
     def alloc(self, req_num_bytes: int, var_name: str = None, align: int = ALIGN_DEFAULT) -> TypedPtr:
         """
         This function allocates the requested number of bytes on the target device. The allocated memory is guaranteed
         to be word (32bit aligned). Optionally, a GDB convenience variable with the provided variable name is created
         which can be optionally used to reference the allocated memory in GDB commands.
+        Memory released with free is reused by subsequent allocations (first fit). If zero_mem was set for this
+        TargetMem instance, the allocated memory is zeroed.
 
         Args:
             req_num_bytes: Requested number of bytes.
@@ -265,23 +874,237 @@ class TargetMem(object):
         Returns:
             Returns the address of the allocated on-target memory as a TypedPtr.
         """
-        align_delta: int = 0
-        if self._heap_next_free_addr % align != 0:
-            align_delta = align - (self._heap_next_free_addr % align)
-
-        # number of bytes still available on target for memory allocation
-        avail_bytes: int = (self._target_mem_base_addr + self._target_mem_num_bytes) - (self._heap_next_free_addr + align_delta)
-
-        assert(req_num_bytes <= avail_bytes), 'unable to allocate %d bytes of on-target memory' % req_num_bytes
-
-        addr: int = self._heap_next_free_addr + align_delta
-        self._heap_next_free_addr += align_delta + req_num_bytes
+        addr: int = self._alloc(req_num_bytes, align, self._zero_mem)
 
         if var_name is not None:
             self._target.cli_exec(f'set var {var_name} = (void*){addr}')
 
         return TypedPtr(self._target, addr, 'void')
 
+    def free(self, ptr: Union[int, TypedPtr]) -> None:
+        """
+        This function releases memory previously allocated with alloc or alloc_type such that it can be reused by
+        subsequent allocations.
+
+        Args:
+            ptr: Address returned by alloc or alloc_type.
+        """
+        addr = self._addr_to_int(ptr)
+        if addr not in self._allocs:
+            raise DottException(f'Address 0x{addr:x} was not allocated from this on-target memory or already freed.')
+        num_bytes = self._allocs.pop(addr)
+
+        # insert freed block (sorted by address) and merge it with adjacent free blocks
+        blocks = sorted(self._free_blocks + [(addr, num_bytes)])
+        merged: List[Tuple[int, int]] = []
+        for blk_addr, blk_sz in blocks:
+            if merged and merged[-1][0] + merged[-1][1] == blk_addr:
+                merged[-1] = (merged[-1][0], merged[-1][1] + blk_sz)
+            else:
+                merged.append((blk_addr, blk_sz))
+
+        # a free block at the top of the heap is given back to the bump allocator
+        if merged and merged[-1][0] + merged[-1][1] == self._heap_next_free_addr:
+            self._heap_next_free_addr = merged.pop()[0]
+        self._free_blocks = merged
+
+    def arena(self, num_bytes: int, align: int = ALIGN_DEFAULT) -> 'TargetMemArena':
+        """
+        This function allocates a sub-arena of the given size. The sub-arena provides the same allocation functions
+        as TargetMem. It is intended to be used as context manager. When leaving the context, all memory allocated
+        from the sub-arena is returned at once. Example:
+
+        with dott().target.mem.arena(512) as a:
+            p = a.alloc_type('uint32_t', cnt=32)
+            ...
+
+        Args:
+            num_bytes: Size of the sub-arena in bytes.
+            align: Alignment of the sub-arena. Default is 4 bytes.
+
+        Returns:
+            The sub-arena.
+        """
+        return TargetMemArena(self, num_bytes, align)
+
+    def crc_helper_resident(self) -> bool:
+        """
+        Checks if the target-side CRC helper (DOTT_mem_crc32 and its table from testhelpers.c) in target memory is
+        identical to the one of the loaded symbol ELF. This is required before calling the helper while the target
+        memory may hold a different image than the symbol ELF (e.g., before the decision to skip a flash download).
+        """
+        symbols = self._target.symbols
+        try:
+            for sym_name in ('DOTT_mem_crc32', 'DOTT_crc32_table'):
+                sym = symbols.lookup(sym_name)
+                if sym is None:
+                    if sym_name == 'DOTT_mem_crc32':
+                        return False
+                    continue  # note: no table if the hardware CRC unit is used
+                content = symbols.content(sym_name)
+                if content is None or self.read(sym['addr'], len(content)) != content:
+                    return False
+            return True
+        except Exception as ex:
+            log.debug(f'Unable to check target-side CRC helper ({ex}).')
+            return False
+
+    def crcs(self, ranges: List[Tuple[int, int]], verify_helper: bool = False) -> List[int]:
+        """
+        Computes the CRC-32 (as computed by zlib.crc32) of each of the given memory ranges on the target (using
+        DOTT_mem_crc32 from testhelpers.c; pipelined, one target function call per range). Only the CRCs are
+        transferred instead of the memory content. A DottException is raised if the target does not provide the
+        helper.
+
+        Args:
+            ranges: Memory ranges given as (start address, number of bytes).
+            verify_helper: If True, the helper is only called if it is resident (see crc_helper_resident).
+
+        Returns:
+            The CRC-32 of each range.
+        """
+        if verify_helper and not self.crc_helper_resident():
+            raise DottException('Target-side CRC helper (DOTT_mem_crc32) not resident.')
+        ranges = [(self._addr_to_int(addr), num_bytes) for addr, num_bytes in ranges]
+        try:
+            crcs = self._target.eval_many([f'DOTT_mem_crc32({addr}, {num_bytes})' for addr, num_bytes in ranges])
+        except Exception as ex:
+            raise DottException(f'Target-side CRC (DOTT_mem_crc32) not available ({ex}).') from None
+        if any(not isinstance(crc, int) for crc in crcs):
+            raise DottException('Unexpected result of target-side CRC (DOTT_mem_crc32).')
+        return [crc & 0xffffffff for crc in crcs]
+
+    def crc(self, addr: Union[int, str, TypedPtr], num_bytes: int) -> int:
+        """
+        Computes the CRC-32 (as computed by zlib.crc32) of the given memory range on the target (see crcs). Example:
+
+        assert dott().target.mem.crc(0x20000000, 0x1000) == zlib.crc32(expected)
+        """
+        return self.crcs([(addr, num_bytes)])[0]
+
+    # granularity (in bytes) in which an uploaded vector is compared to the vector already on the target (see upload)
+    UPLOAD_DELTA_BLOCK = 32
+
+    def upload(self, dst_addr: Union[int, TypedPtr], data: bytes, verify: bool = False) -> int:
+        """
+        Writes a (large) data vector, e.g., an input vector of a parametrized test, to target memory. DOTT remembers
+        the vectors uploaded to each start address (see Target.vector_cache). If a vector was uploaded to the same
+        address before, the target is asked for the CRC-32 of that memory (see crc) to verify that it still holds the
+        vector. In this case, only the blocks in which the new vector differs are sent (nothing if it is the same
+        vector). Otherwise (or if the target-side CRC helper is not available), the entire vector is written.
+
+        Args:
+            dst_addr: The target's destination memory address to write to.
+            data: The vector to be written.
+            verify: If True, the vector in target memory is verified afterwards (see verify).
+
+        Returns:
+            The number of bytes which were actually sent to the target.
+        """
+        addr = self._addr_to_int(dst_addr)
+        data = bytes(data)
+        cache = self._target.vector_cache
+        prev = cache.get(addr)
+        if prev is not None:
+            try:
+                resident = self.crc(addr, len(prev)) == zlib.crc32(prev)
+            except DottException:
+                resident = False
+            runs = TargetMem._delta_runs(prev, data, TargetMem.UPLOAD_DELTA_BLOCK) if resident else None
+            if runs is not None and sum(len(run) for _, run in runs) < len(data):
+                for offset, run in runs:
+                    self._write_raw(addr + offset, run)
+                cache.put(addr, data)
+                sent = sum(len(run) for _, run in runs)
+                cache.bytes_saved += len(data) - sent
+                if verify:
+                    self.verify(addr, data)
+                return sent
+        if len(data) > 0:
+            self._write_raw(addr, data)
+            if verify:
+                self.verify(addr, data)
+        cache.put(addr, data)
+        return len(data)
+
+    @staticmethod
+    def _delta_runs(prev: bytes, data: bytes, block: int) -> List[Tuple[int, bytes]]:
+        # runs (offset, bytes) of data which differ from prev (consecutive differing blocks form a single run); the
+        # part of data beyond the end of prev always differs
+        runs: List[Tuple[int, bytes]] = []
+        start = None
+        common = min(len(prev), len(data))
+        for offset in range(0, common, block):
+            if prev[offset:offset + block] != data[offset:offset + block]:
+                start = offset if start is None else start
+            elif start is not None:
+                runs.append((start, data[start:offset]))
+                start = None
+        if start is not None or len(data) > common:
+            start = common if start is None else start
+            runs.append((start, data[start:]))
+        return runs
+
+    def snapshot(self, regions: Union[Tuple[int, int], List[Tuple[int, int]]],
+                 block_size: int = 1024, base: 'TargetMemSnapshot' = None) -> 'TargetMemSnapshot':
+        """
+        This function takes a snapshot of the given target memory regions. If a base snapshot (of the same regions
+        and block size) is given, the target is asked to compute the CRC-32 of each block (using DOTT_mem_crc32 from
+        testhelpers.c) and only blocks whose CRC differs from the base snapshot are transferred. If the target does
+        not provide DOTT_mem_crc32, all blocks are read. Example:
+
+        before = dott().target.mem.snapshot([(0x20000000, 0x1000)])
+        ...
+        after = dott().target.mem.snapshot([(0x20000000, 0x1000)], base=before)
+        assert before.diff(after) == []
+
+        Args:
+            regions: Memory region or list of memory regions given as (start address, number of bytes).
+            block_size: Granularity (in bytes) in which changes are detected and transferred.
+            base: Optional previous snapshot of the same regions.
+
+        Returns:
+            The snapshot.
+        """
+        if isinstance(regions, tuple):
+            regions = [regions]
+        regions = [(self._addr_to_int(addr), num_bytes) for addr, num_bytes in regions]
+
+        if base is None or base.regions != regions or base.block_size != block_size:
+            return TargetMemSnapshot(regions, block_size, [self.read(addr, num_bytes) for addr, num_bytes in regions])
+
+        blocks = [(r, addr + off, min(block_size, num_bytes - off))
+                  for r, (addr, num_bytes) in enumerate(regions) for off in range(0, num_bytes, block_size)]
+        try:
+            crcs = self.crcs([(addr, sz) for _, addr, sz in blocks])
+        except DottException:
+            log.debug('Target-side CRC not available (DOTT_mem_crc32). Reading all snapshot blocks.')
+            crcs = [None] * len(blocks)
+
+        data = [bytearray(base.data(r)) for r in range(len(regions))]
+        for (r, addr, sz), crc in zip(blocks, crcs):
+            if crc is not None and crc == base.block_crc(addr, sz):
+                continue
+            off = addr - regions[r][0]
+            data[r][off:off + sz] = self.read(addr, sz)
+        return TargetMemSnapshot(regions, block_size, [bytes(d) for d in data])
+
+    def restore(self, snapshot: 'TargetMemSnapshot') -> None:
+        """
+        This function restores the target memory content captured by the given snapshot. Only memory ranges which
+        differ from the snapshot are written. Changed blocks are detected as described for snapshot.
+
+        Args:
+            snapshot: The snapshot to be restored.
+        """
+        with self._target.clock_phase('bulk'):
+            current = self.snapshot(snapshot.regions, snapshot.block_size, base=snapshot)
+            changes = snapshot.diff(current)
+            log.debug(f'Restoring {len(changes)} memory range(s) from snapshot.')
+            if len(changes) > 0:
+                self._target.exec_check([f'-data-write-memory-bytes {addr} "{data.hex()}"'
+                                         for addr, data, _ in changes])
+
     def alloc_type(self, var_type: str, val: Union[int, bytes, str] = None, cnt: int = 1, var_name: str = None, align: int = ALIGN_DEFAULT) -> TypedPtr:
         """
         This function allocates on-target memory for cnt number of variables of the specified type. The start of the
@@ -296,6 +1119,7 @@ class TargetMem(object):
         Args:
             var_type: Type of variable to be allocated on-target.
             val: Value for the newly assigned variable. Note that if cnt > 1 this value is set for all the elements.
+                 For struct types, val can also be a dict or dataclass (members not provided are zero).
             cnt: Number of elements to be allocated.
             var_name: Optional GDB variable name used for the newly allocated memory.
             align: Alignment for allocated memory. Default is 4 bytes.
@@ -305,7 +1129,10 @@ class TargetMem(object):
         """
         type_sz: int = self.sizeof(var_type)
         p_var: TypedPtr = self.alloc(type_sz * cnt, var_name, align)
-        if val is not None:
+        if isinstance(val, dict) or dataclasses.is_dataclass(val):
+            layout = self.type_layout(var_type)
+            self.write(p_var, layout.pack(val), cnt)
+        elif val is not None:
             self.write(p_var, val, cnt)
 
         # optionally create a gdb convenience variable and cast to concrete type as specified by var_type
@@ -319,6 +1146,395 @@ class TargetMem(object):
         """
         return self._heap_next_free_addr - self._target_mem_base_addr
 
+    def get_num_free_bytes(self) -> int:
+        """
+        Returns: Number of contiguous bytes still available for allocation (at the top of the on-target memory).
+        """
+        return self._target_mem_base_addr + self._target_mem_num_bytes - self._heap_next_free_addr
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetMemArena(TargetMem):
+    """
+    This class implements a sub-arena of a TargetMem instance (see TargetMem.arena). Memory allocated from the
+    sub-arena is zeroed (if enabled for the parent) when it is handed out. On close (or when leaving the 'with'
+    block) the entire sub-arena is returned to the parent.
+    """
+    def __init__(self, parent: TargetMem, num_bytes: int, align: int = ALIGN_DEFAULT):
+        # note: the sub-arena itself is not zeroed; memory is zeroed when allocated from the sub-arena
+        self._parent: TargetMem = parent
+        self._block_addr: int = parent._alloc(num_bytes, align, False)
+        super().__init__(parent._target, self._block_addr, num_bytes, parent._zero_mem)
+
+    def close(self) -> None:
+        if self._block_addr is not None:
+            self._parent.free(self._block_addr)
+            self._block_addr = None
+
+    def __enter__(self) -> 'TargetMemArena':
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.close()
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetMemSnapshot(object):
+    """
+    Host-side copy of one or more target memory regions as taken by TargetMem.snapshot. Snapshots can be compared
+    with each other (see diff), e.g., to check that a piece of code did not modify memory outside of a certain area.
+    """
+    def __init__(self, regions: List[Tuple[int, int]], block_size: int, data: List[bytes]) -> None:
+        self._regions: List[Tuple[int, int]] = regions
+        self._block_size: int = block_size
+        self._data: List[bytes] = data
+        self._crcs: Dict[Tuple[int, int], int] = {}
+
+    @property
+    def regions(self) -> List[Tuple[int, int]]:
+        return self._regions
+
+    @property
+    def block_size(self) -> int:
+        return self._block_size
+
+    def data(self, region_idx: int = 0) -> bytes:
+        return self._data[region_idx]
+
+    def _locate(self, addr: int, num_bytes: int) -> Tuple[int, int]:
+        for r, (start, size) in enumerate(self._regions):
+            if start <= addr and addr + num_bytes <= start + size:
+                return r, addr - start
+        raise ValueError(f'Memory range 0x{addr:x} (+{num_bytes}) is not part of the snapshot.')
+
+    def get(self, addr: int, num_bytes: int) -> bytes:
+        """
+        Returns the content of the given memory range (which has to be part of the snapshot).
+        """
+        r, off = self._locate(addr, num_bytes)
+        return self._data[r][off:off + num_bytes]
+
+    def block_crc(self, addr: int, num_bytes: int) -> int:
+        """
+        Returns the CRC-32 (as computed by zlib.crc32 and DOTT_mem_crc32) of the given memory range.
+        """
+        key = (addr, num_bytes)
+        if key not in self._crcs:
+            self._crcs[key] = zlib.crc32(self.get(addr, num_bytes))
+        return self._crcs[key]
+
+    def diff(self, other: 'TargetMemSnapshot') -> List[Tuple[int, bytes, bytes]]:
+        """
+        Compares this snapshot with another snapshot of the same memory regions.
+
+        Args:
+            other: The snapshot to compare with.
+
+        Returns:
+            List of contiguous differing memory ranges given as (start address, bytes in this snapshot, bytes in
+            other snapshot). The list is empty if the snapshots are equal.
+        """
+        if self._regions != other.regions:
+            raise ValueError('Only snapshots of the same memory regions can be compared.')
+
+        changes: List[Tuple[int, bytes, bytes]] = []
+        for r, (start, size) in enumerate(self._regions):
+            mine, theirs = self._data[r], other.data(r)
+            if mine == theirs:
+                continue
+            # blocks are compared as a whole first; only differing blocks are compared byte by byte
+            runs: List[List[int]] = []
+            for blk in range(0, size, self._block_size):
+                blk_end = min(blk + self._block_size, size)
+                if mine[blk:blk_end] == theirs[blk:blk_end]:
+                    continue
+                for off in range(blk, blk_end):
+                    if mine[off] != theirs[off]:
+                        if runs and runs[-1][1] == off:
+                            runs[-1][1] = off + 1
+                        else:
+                            runs.append([off, off + 1])
+            changes += [(start + b, mine[b:e], theirs[b:e]) for b, e in runs]
+        return changes
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetMemVectorCache(object):
+    """
+    Host-side record of the data vectors uploaded with TargetMem.upload (vector per start address). The record is
+    kept per target (i.e., across TargetMem instances and tests) and is only a hint: before it is relied on, the
+    content of the target memory is verified with an on-target CRC. Entries are dropped when the memory is written
+    via TargetMem and when an image is downloaded.
+    """
+    def __init__(self) -> None:
+        self._vectors: Dict[int, bytes] = {}
+        self.bytes_saved: int = 0  # number of bytes which did not have to be sent thanks to the record
+
+    def get(self, addr: int) -> Union[bytes, None]:
+        return self._vectors.get(addr)
+
+    def put(self, addr: int, data: bytes) -> None:
+        self.invalidate(addr, len(data))
+        if len(data) > 0:
+            self._vectors[addr] = data
+
+    def invalidate(self, addr: int = None, num_bytes: int = 0) -> None:
+        """
+        Drops the vectors overlapping the given memory range (all vectors if addr is None).
+        """
+        if addr is None:
+            self._vectors = {}
+        elif len(self._vectors) > 0:
+            self._vectors = {a: v for a, v in self._vectors.items() if a + len(v) <= addr or a >= addr + num_bytes}
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetMemCache(object):
+    """
+    This class implements an opt-in, host-side cache of target memory. Memory is cached in pages which are read from
+    the target on first access while the target is halted. Writes are applied to the cached pages and are written
+    back (coalesced per contiguous dirty range) when the cache is flushed. The cache is created with
+    Target.mem_cache_enable(). Its content is automatically written back and invalidated before the target is resumed
+    (cont, step, step_inst, ret, reset, load) and before expressions are evaluated (eval, eval_many) since these may
+    involve function calls or memory modifications. While the target is running, accesses bypass the cache.
+
+    Important: Memory accesses which bypass the cache (e.g., target.mem.write or exec/cli_exec commands) while the
+    target is halted are not tracked. Call invalidate() afterwards. Only use the cache for RAM and not for memory
+    mapped peripherals.
+
+    Example:
+        cache = dott().target.mem_cache_enable()
+        data = cache.read(p_buf, 64)  # reads the pages covering p_buf .. p_buf + 64 from the target
+        elem = cache.read(p_buf + 4, 4)  # served from the cache
+        cache.write(p_buf, 0x0, 64)  # only updates the cached pages
+        dott().target.cont()  # dirty pages are written back before the target is resumed
+
+    With prefetch enabled, the cache learns which pages are accessed while the target is halted at a breakpoint
+    (per breakpoint location, from the hit until the target is resumed). On the next hit of the same location, the
+    first access reads all pages learned for the location (and the requested ones) with one pipelined transfer. The
+    pages of each location are re-learned with every hit, i.e., pages which are no longer accessed drop out.
+    """
+    PAGE_SIZE = 256
+
+    # maximum number of pages prefetched per breakpoint location
+    PREFETCH_MAX_PAGES = 64
+
+    def __init__(self, target: 'Target', page_size: int = PAGE_SIZE, prefetch: bool = False) -> None:
+        self._target: 'Target' = target
+        self._page_size: int = page_size
+        self._pages: Dict[int, bytearray] = {}
+        self._dirty: Dict[int, List[int]] = {}  # page number -> [start offset, end offset] of the dirty range
+        self._lock: threading.RLock = threading.RLock()
+        self._hits: int = 0
+        self._misses: int = 0
+
+        self._prefetch: bool = prefetch
+        self._profiles: Dict[str, List[int]] = {}  # breakpoint location -> pages accessed after its latest hit
+        self._stop_location: str = None  # location of the breakpoint the target is halted at (None: other halt)
+        self._touched: Set[int] = set()  # pages accessed since the hit of _stop_location
+        self._prefetch_pending: bool = False
+        self._prefetched: int = 0
+
+    @property
+    def page_size(self) -> int:
+        return self._page_size
+
+    @property
+    def hits(self) -> int:
+        """
+        Returns the number of page accesses served from the cache.
+        """
+        return self._hits
+
+    @property
+    def misses(self) -> int:
+        """
+        Returns the number of page accesses which required reading the page from the target.
+        """
+        return self._misses
+
+    @property
+    def prefetch(self) -> bool:
+        return self._prefetch
+
+    @property
+    def prefetched(self) -> int:
+        """
+        Returns the number of pages read ahead of time based on the pages learned for breakpoint locations.
+        """
+        return self._prefetched
+
+    @property
+    def profiles(self) -> Dict[str, List[int]]:
+        """
+        Returns the pages (page numbers) learned per breakpoint location.
+        """
+        with self._lock:
+            return {loc: list(pages) for loc, pages in self._profiles.items()}
+
+    def stopped_at(self, location: str) -> None:
+        """
+        Called when the target halted at a breakpoint (location None for other halts). Starts learning the pages
+        accessed for the location and arms the prefetch of the pages learned on its previous hits.
+        """
+        if not self._prefetch:
+            return
+        with self._lock:
+            self._stop_location = location
+            self._touched = set()
+            self._prefetch_pending = location in self._profiles
+
+    def resumed(self) -> None:
+        """
+        Called when the target resumed. Stores the pages accessed since the latest breakpoint hit and invalidates the
+        cache.
+        """
+        with self._lock:
+            if self._stop_location is not None and len(self._touched) > 0:
+                self._profiles[self._stop_location] = sorted(self._touched)[:TargetMemCache.PREFETCH_MAX_PAGES]
+            self._stop_location = None
+            self._touched = set()
+            self._prefetch_pending = False
+        self.invalidate()
+
+    def _page_range(self, addr: int, num_bytes: int) -> Tuple[int, int]:
+        return addr // self._page_size, (addr + num_bytes - 1) // self._page_size
+
+    def _page_runs(self, pages: List[int]) -> List[Tuple[int, int]]:
+        # (first page, number of pages) of each run of consecutive pages
+        runs: List[List[int]] = []
+        for p in sorted(pages):
+            if len(runs) > 0 and runs[-1][0] + runs[-1][1] == p:
+                runs[-1][1] += 1
+            else:
+                runs.append([p, 1])
+        return [(first, num) for first, num in runs]
+
+    def _load_pages(self, first: int, last: int) -> None:
+        if self._stop_location is not None:
+            self._touched.update(range(first, last + 1))
+        if self._prefetch_pending:
+            # note: the learned pages are read together with the requested ones (one pipelined transfer)
+            self._prefetch_pending = False
+            learned = [p for p in self._profiles[self._stop_location] if p not in self._pages]
+            requested = [p for p in range(first, last + 1) if p not in self._pages]
+            runs = self._page_runs(set(learned) | set(requested))
+            contents = self._target.mem.read_many([(p * self._page_size, n * self._page_size) for p, n in runs])
+            for (p, n), data in zip(runs, contents):
+                for k in range(n):
+                    self._pages[p + k] = bytearray(data[k * self._page_size:(k + 1) * self._page_size])
+            self._prefetched += len(set(learned) - set(requested))
+            self._misses += len(requested)
+            self._hits += (last - first + 1) - len(requested)
+            return
+
+        missing = [p for p in range(first, last + 1) if p not in self._pages]
+        self._misses += len(missing)
+        self._hits += (last - first + 1) - len(missing)
+
+        # read consecutive missing pages with a single memory read
+        i = 0
+        while i < len(missing):
+            j = i
+            while j + 1 < len(missing) and missing[j + 1] == missing[j] + 1:
+                j += 1
+            num_pages = j - i + 1
+            data = self._target.mem.read(missing[i] * self._page_size, num_pages * self._page_size)
+            for k in range(num_pages):
+                self._pages[missing[i] + k] = bytearray(data[k * self._page_size:(k + 1) * self._page_size])
+            i = j + 1
+
+    def read(self, src_addr: Union[int, str, TypedPtr], num_bytes: int) -> bytes:
+        """
+        This function reads the requested number of bytes from the specified source address. Pages not yet
+        cached are read from the target.
+
+        Args:
+            src_addr: The target's source memory address to read from.
+            num_bytes: The number of bytes to read.
+
+        Returns:
+            Returns the bytes read.
+        """
+        addr = TargetMem._addr_to_int(src_addr)
+        if num_bytes <= 0:
+            return b''
+        if self._target.is_running():
+            return self._target.mem.read(addr, num_bytes)
+
+        with self._lock:
+            first, last = self._page_range(addr, num_bytes)
+            self._load_pages(first, last)
+            data = b''.join(self._pages[p] for p in range(first, last + 1))
+            offset = addr - first * self._page_size
+            return data[offset:offset + num_bytes]
+
+    def write(self, dst_addr: Union[int, str, TypedPtr], val: Union[int, bytes, str], cnt: int = 1) -> None:
+        """
+        This function writes the provided data to the cached pages. The data is written to the target when the
+        cache is flushed. Refer to TargetMem.write for a description of the arguments.
+        """
+        addr = TargetMem._addr_to_int(dst_addr)
+        if self._target.is_running():
+            self._target.mem.write(addr, val, cnt)
+            return
+
+        data = self._target.mem._val_to_bytes(val, cnt)
+        if len(data) == 0:
+            return
+
+        with self._lock:
+            first, last = self._page_range(addr, len(data))
+            self._load_pages(first, last)
+            for p in range(first, last + 1):
+                page_addr = p * self._page_size
+                start = max(addr, page_addr) - page_addr
+                end = min(addr + len(data), page_addr + self._page_size) - page_addr
+                src = page_addr + start - addr
+                self._pages[p][start:end] = data[src:src + (end - start)]
+                if p in self._dirty:
+                    self._dirty[p] = [min(self._dirty[p][0], start), max(self._dirty[p][1], end)]
+                else:
+                    self._dirty[p] = [start, end]
+
+    def flush(self) -> None:
+        """
+        Writes all modified data back to the target. Dirty ranges which are contiguous across pages are written
+        with a single write command.
+        """
+        with self._lock:
+            runs: List[Tuple[int, bytearray]] = []
+            for p in sorted(self._dirty.keys()):
+                start, end = self._dirty[p]
+                addr = p * self._page_size + start
+                if runs and runs[-1][0] + len(runs[-1][1]) == addr:
+                    runs[-1][1].extend(self._pages[p][start:end])
+                else:
+                    runs.append((addr, bytearray(self._pages[p][start:end])))
+            self._dirty.clear()
+
+            if runs:
+                self._target.exec_check([f'-data-write-memory-bytes {addr} "{binascii.hexlify(data).decode()}"'
+                                         for addr, data in runs])
+
+    def invalidate(self) -> None:
+        """
+        Discards all cached pages. Modifications which have not been flushed are lost.
+        """
+        with self._lock:
+            if self._dirty:
+                log.warn('Discarding modified but not yet flushed target memory cache pages.')
+            self._pages.clear()
+            self._dirty.clear()
+
+    def sync(self) -> None:
+        """
+        Flushes and then invalidates the cache.
+        """
+        with self._lock:
+            self.flush()
+            self.invalidate()
+
 
 # -------------------------------------------------------------------------------------------------
 class TargetMemTestHook(TargetMem):
@@ -327,28 +1543,62 @@ class TargetMemTestHook(TargetMem):
     used for on-target memory allocation. In addition to setting the correct memory address (in stack from of the
     test hook) this class also checks that allocation is only performed if the target is halted in the context of the
     test hook.
+    The size of the scratchpad memory is taken from the target (see DOTT_TEST_HOOK_MEM_WORDS in testhelpers.h). If
+    the target places the scratchpad in a dedicated linker section (DOTT_TEST_HOOK_MEM_SECTION), the memory is
+    globally accessible and allocation is also possible outside of the test hook's context.
     """
     def __init__(self, target: 'Target'):
-        start_addr = target.eval('dbg_mem_u32')
-        num_bytes = int(target.eval('dbg_mem_u32_sz'))
+        self._global_mem: bool = False
+        try:
+            start_addr, num_bytes = _scratch_section(target)
+            self._global_mem = True
+        except Exception:
+            start_addr = target.eval('dbg_mem_u32')
+            num_bytes = int(target.eval('dbg_mem_u32_sz'))
         super().__init__(target, start_addr, num_bytes)
 
-    def alloc(self, req_num_bytes: int, var_name: str = None, align: int = ALIGN_DEFAULT):
+    def _check_context(self) -> None:
+        if self._global_mem:
+            return
         try:
             self._target.eval('dbg_mem_u32')  # raises exception if symbol is not accessible in current context
-        except:
+        except Exception:
             raise DottException('Test-hook based memory allocation is only possible '
                                 'if program is halted in the test hook!') from None
+
+    def alloc(self, req_num_bytes: int, var_name: str = None, align: int = ALIGN_DEFAULT):
+        self._check_context()
         return super().alloc(req_num_bytes, var_name, align)
 
     def alloc_type(self, var_type: str, val: Union[int, bytes, str] = None, cnt: int = 1, var_name: str = None, align: int = ALIGN_DEFAULT):
+        self._check_context()
+        return super().alloc_type(var_type, val, cnt, var_name, align)
+
+
+def _scratch_section(target: 'Target') -> Tuple[int, int]:
+    # returns address and size of the scratchpad memory placed in a dedicated linker section (DOTT_test_hook_mem);
+    # taken from the symbol index (e.g., from the DOTT manifest) if available
+    sym = target.symbols.lookup('DOTT_test_hook_mem')
+    if sym is not None and sym['size'] > 0:
+        return sym['addr'], sym['size']
+    return target.eval('&DOTT_test_hook_mem[0]'), int(target.eval('sizeof(DOTT_test_hook_mem)'))
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetMemSection(TargetMem):
+    """
+    This class implements a variation of the TargetMem class which uses the scratchpad memory placed in a dedicated
+    linker section (DOTT_test_hook_mem, see DOTT_TEST_HOOK_MEM_SECTION in testhelpers.h) for on-target memory
+    allocation. The memory is globally accessible and is not touched by the target's startup code (the section must
+    be NOLOAD/UNINIT). Hence, it can be used right after reset without running the target up to a certain location.
+    """
+    def __init__(self, target: 'Target'):
         try:
-            self._target.eval('dbg_mem_u32')  # raises exception if symbol is not accessible in current context
+            start_addr, num_bytes = _scratch_section(target)
         except Exception:
-           raise DottException('Test-hook based memory allocation is only possible '
-                               'if program is halted in the test hook!') from None
-
-        return super().alloc_type(var_type, val, cnt, var_name, align)
+            raise DottException('Section-based memory allocation requires the target to be built with '
+                                'DOTT_TEST_HOOK_MEM_SECTION (symbol DOTT_test_hook_mem not found)!') from None
+        super().__init__(target, start_addr, num_bytes)
 
 
 # -------------------------------------------------------------------------------------------------
@@ -398,7 +1648,21 @@ class TargetMemScoped(object):
                 dott().target.eval(f'{addr}[{i}] = {elements[i]}')
             res = dott().target.eval(f'example_SumElements({addr}, {len(elements)})')
             assert (sum(elements) == res), f'expected: {sum(elements)}, is: {res}'
+
+    Scopes entered while another scope of the same target is active are carved from the chunk of the enclosing
+    scope (see TargetMemArena) with host-side bookkeeping only, i.e., without touching SP. Hence, scoped allocations
+    in loops are free on the wire when an enclosing scope reserves the stack once:
+
+        with TargetMemScoped(dott().target, 4096):
+            for elements in cases:
+                with TargetMemScoped(dott().target, 128) as m:
+                    ...
+
+    A nested scope which does not fit into the remaining chunk of the enclosing scope reserves its own stack chunk.
     """
+    # active scopes per target (innermost last)
+    _active: 'weakref.WeakKeyDictionary[Target, List[TargetMemScoped]]' = weakref.WeakKeyDictionary()
+
     def __init__(self, target: 'Target', num_bytes: int, suppress_warnings: bool = False):
         """
         Constructor.
@@ -415,6 +1679,7 @@ class TargetMemScoped(object):
         self._sp_init: int = 0x0  # the stack pointer upon entering the 'with' block
         self._sp_init_dec: int = 0x0  # the decremented _sp_init
         self._mem: TargetMem = None
+        self._arena: TargetMemArena = None  # chunk carved from the enclosing scope (None: own stack chunk)
         # ensure that the requested number of bytes is a multiple of 8 (double-word alignment of stack; cp.
         # "Procedure Call Standard for the Arm® Architecture").
         if num_bytes % 8 != 0:
@@ -426,6 +1691,14 @@ class TargetMemScoped(object):
         if self._target.is_running():
             raise DottException('Target must be halted when initializing scoped on-target memory.')
 
+        scopes = TargetMemScoped._active.setdefault(self._target, [])
+        if len(scopes) > 0 and scopes[-1]._mem.get_num_free_bytes() >= self._num_bytes + 8:
+            # note: the chunk of the enclosing scope is located below the SP; no target interaction is needed
+            self._arena = scopes[-1]._mem.arena(self._num_bytes, 8)
+            self._mem = self._arena
+            scopes.append(self)
+            return self._mem
+
         # save current stack pointer and program counter
         self._sp_init = self._target.eval('$sp')
         self._pc_init = self._target.eval('$pc')
@@ -448,6 +1721,7 @@ class TargetMemScoped(object):
         # Finally, adjust the SP to reserve the requested chunk of the stack. Create and return a memory manager for it.
         self._target.eval(f'$sp = {self._sp_init_dec}')
         self._mem = TargetMem(self._target, self._sp_init_dec, self._num_bytes)
+        scopes.append(self)
         return self._mem
 
     def __reset_sp(self):
@@ -488,10 +1762,17 @@ class TargetMemScoped(object):
         if self._target.is_running():
             raise DottException('Target must be halted when leaving "with" block of scoped on-target memory.')
 
+        scopes = TargetMemScoped._active.get(self._target, [])
+        if self in scopes:
+            scopes.remove(self)
         # reset the internal state of the TargetMem instance with respect to the memory it managed.
         self._mem.reset()
-        # reset the SP to the state it had before the 'with' block
-        self.__reset_sp()
+        if self._arena is not None:
+            # return the chunk to the enclosing scope
+            self._arena.close()
+        else:
+            # reset the SP to the state it had before the 'with' block
+            self.__reset_sp()
         # make alloc/reset functions of the TargetMem instance unusable after the 'with' block.
         self._mem.alloc = self.__func_unavailable
         self._mem.alloc_type = self.__func_unavailable
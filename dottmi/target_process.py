@@ -0,0 +1,279 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Hosting of targets in worker processes. Each Target runs a couple of threads (GDB MI response handler, breakpoint
+# handler, notification and intercept point threads) which compete for the GIL with the threads of all other targets
+# of the process; with many boards, the latency of each board's event handling grows with the number of boards. With
+# target_process=yes (dott.ini) or Dott.create_targets(..., process=True), each target (its GDB client, GDB server and
+# all its threads) lives in a worker process of its own and the test uses a TargetProxy. The proxy forwards attribute
+# accesses and method calls to the worker (one request/response pair over a pipe per call); results which can not be
+# transferred (e.g., the TargetMem of the target or typed pointers) stay in the worker and are represented by proxies as
+# well. For example:
+#
+#   targets = dott().create_targets([('STM32F072RB', sn) for sn in serials], process=True)
+#   for t in targets:
+#       t.load('build/app.elf', 'build/app.elf')
+#   counts = [t.eval('_tick_cnt') for t in targets]
+#   hits = [t.run(wait_for_label, 'DOTT_LABEL_SAFE_MAIN') for t in targets]  # runs in the target's worker
+#
+# Note: Objects which refer to a target (breakpoints, intercept points, fixtures' helpers) have to be created in the
+# worker process. TargetProxy.run calls a (module-level, i.e., picklable) function in the worker with the target as
+# first argument for that purpose. The default target (dott().target) always lives in the test process.
+
+import multiprocessing
+import os
+import pickle
+import threading
+from typing import Any, Callable, Dict, List, Tuple
+
+from dottmi.dottexceptions import DottException
+
+# distance of the GDB server port ranges of two workers (each GDB server occupies three consecutive ports)
+PORT_STRIDE = 100
+
+# handle of the target within a worker (see _Worker)
+_TARGET_HANDLE = 0
+
+
+# -------------------------------------------------------------------------------------------------
+class _Worker(object):
+    """
+    Request loop of a worker process. Objects which are handed out as proxies are kept in a handle table until the
+    test process releases them.
+    """
+    def __init__(self, conn, target: 'Target') -> None:
+        self._conn = conn
+        self._objs: Dict[int, Any] = {_TARGET_HANDLE: target}
+        self._next_handle: int = _TARGET_HANDLE + 1
+
+    def _result(self, val: Any) -> Tuple:
+        if callable(val) and not isinstance(val, type):
+            return 'call', None
+        try:
+            pickle.dumps(val)
+            return 'val', val
+        except Exception:
+            handle = self._next_handle
+            self._next_handle += 1
+            self._objs[handle] = val
+            return 'obj', (handle, type(val).__name__)
+
+    def serve(self) -> None:
+        while True:
+            try:
+                op, handle, name, args, kwargs, released = self._conn.recv()
+            except (EOFError, OSError):
+                return
+            for h in released:
+                self._objs.pop(h, None)
+            try:
+                obj = self._objs[handle]
+                if op == 'get':
+                    res = self._result(getattr(obj, name))
+                elif op == 'set':
+                    setattr(obj, name, args[0])
+                    res = 'val', None
+                elif op == 'call':
+                    res = self._result(getattr(obj, name)(*args, **kwargs))
+                elif op == 'run':
+                    res = self._result(args[0](obj, *args[1:], **kwargs))
+                else:  # exit
+                    self._conn.send(('val', None))
+                    return
+            except BaseException as ex:
+                try:
+                    pickle.dumps(ex)
+                    res = 'err', ex
+                except Exception:
+                    res = 'err', DottException(f'{type(ex).__name__}: {ex}')
+            self._conn.send(res)
+
+
+def _worker_main(conn, conf: Dict, dev_name: str, jlink_serial: str) -> None:
+    # entry point of a worker process: set up DOTT with the configuration of the test process and create the target
+    from dottmi.dott import Dott, DottConf
+
+    try:
+        # note: the worker's GDB server port range has to be known while DOTT is set up (see Dott.__init__)
+        os.environ['DOTTGDBSRVPORT'] = conf['gdb_server_port']
+        dott = Dott()
+        DottConf.conf.update(conf)
+        tgt = dott.create_target(dev_name, jlink_serial)
+        if tgt is None:
+            raise DottException(f'GDB server of target {dev_name} could not be reached.')
+    except BaseException as ex:
+        conn.send(('err', DottException(f'{type(ex).__name__}: {ex}')))
+        return
+    conn.send(('val', os.getpid()))
+    try:
+        _Worker(conn, tgt).serve()
+    finally:
+        dott.shutdown()
+
+
+# -------------------------------------------------------------------------------------------------
+class RemoteObject(object):
+    """
+    Proxy of an object which lives in a worker process. Attribute reads, writes and method calls are forwarded to the
+    worker.
+    """
+    def __init__(self, channel: '_Channel', handle: int, type_name: str) -> None:
+        object.__setattr__(self, '_channel', channel)
+        object.__setattr__(self, '_handle', handle)
+        object.__setattr__(self, '_type_name', type_name)
+        object.__setattr__(self, '_methods', set())  # note: bound methods are looked up once per object
+
+    def __getattr__(self, name: str) -> Any:
+        if name.startswith('__'):
+            raise AttributeError(name)
+        res = _CALLABLE if name in self._methods else self._channel.request('get', self._handle, name)
+        if res is _CALLABLE:
+            self._methods.add(name)
+            def method(*args, **kwargs):
+                return self._channel.request('call', self._handle, name, args, kwargs)
+            method.__name__ = name
+            return method
+        return res
+
+    def __setattr__(self, name: str, val: Any) -> None:
+        self._channel.request('set', self._handle, name, (val,))
+
+    def __del__(self) -> None:
+        if self._handle != _TARGET_HANDLE:
+            self._channel.release(self._handle)
+
+    def __repr__(self) -> str:
+        return f'<remote {self._type_name} in worker {self._channel.pid}>'
+
+
+_CALLABLE = object()
+
+
+class _Channel(object):
+    # request/response channel to one worker process (requests of several threads are serialized)
+    def __init__(self, conn, process: multiprocessing.Process) -> None:
+        self._conn = conn
+        self._process: multiprocessing.Process = process
+        self._lock: threading.Lock = threading.Lock()
+        self._released: List[int] = []  # handles released since the last request (see RemoteObject.__del__)
+        self.pid: int = None
+
+    def wait_ready(self, timeout: float) -> None:
+        if not self._conn.poll(timeout):
+            self._process.terminate()
+            raise DottException(f'Target worker process did not start up within {timeout}s.')
+        kind, val = self._conn.recv()
+        if kind == 'err':
+            self._process.join()
+            raise val
+        self.pid = val
+
+    def release(self, handle: int) -> None:
+        # note: called from __del__, i.e., at any point in time; the release is sent with the next request
+        self._released.append(handle)
+
+    def request(self, op: str, handle: int, name: str = None, args: Tuple = (), kwargs: Dict = None) -> Any:
+        with self._lock:
+            released, self._released = self._released, []
+            try:
+                self._conn.send((op, handle, name, args, kwargs or {}, released))
+                kind, val = self._conn.recv()
+            except (EOFError, OSError):
+                raise DottException(f'Target worker process {self.pid} is not available.') from None
+        if kind == 'err':
+            raise val
+        if kind == 'call':
+            return _CALLABLE
+        if kind == 'obj':
+            return RemoteObject(self, val[0], val[1])
+        return val
+
+    def close(self, timeout: float) -> None:
+        if self._process.is_alive():
+            try:
+                self.request('exit', _TARGET_HANDLE)
+            except DottException:
+                pass
+            self._process.join(timeout)
+            if self._process.is_alive():
+                self._process.terminate()
+        self._conn.close()
+
+
+# -------------------------------------------------------------------------------------------------
+class TargetProxy(RemoteObject):
+    """
+    Test-side proxy of a Target which lives in a worker process (see module description).
+    """
+    # maximum time (seconds) to wait for a worker to create its target and to shut down
+    STARTUP_TIMEOUT = 120.0
+    SHUTDOWN_TIMEOUT = 20.0
+
+    @staticmethod
+    def start(targets: List[Tuple[str, str]], conf: Dict) -> List['TargetProxy']:
+        """
+        Starts one worker process per target and returns the proxies of the targets once all workers are ready (the
+        targets are created concurrently).
+
+        Args:
+            targets: List of (device name, JLINK serial number) tuples.
+            conf: DOTT configuration (DottConf.conf) of the workers.
+        """
+        ctx = multiprocessing.get_context('spawn')
+        channels: List[_Channel] = []
+        try:
+            for idx, (dev_name, jlink_serial) in enumerate(targets):
+                worker_conf = dict(conf)
+                worker_conf['target_process'] = False
+                # note: each worker discovers free GDB server ports in a range of its own
+                worker_conf['gdb_server_port'] = str(int(conf['gdb_server_port']) + idx * PORT_STRIDE)
+                conn, child_conn = ctx.Pipe()
+                process = ctx.Process(target=_worker_main, args=(child_conn, worker_conf, dev_name, jlink_serial),
+                                      name=f'DottTarget-{dev_name}-{jlink_serial}', daemon=True)
+                process.start()
+                child_conn.close()
+                channels.append(_Channel(conn, process))
+            for channel in channels:
+                channel.wait_ready(TargetProxy.STARTUP_TIMEOUT)
+        except BaseException:
+            for channel in channels:
+                channel.close(TargetProxy.SHUTDOWN_TIMEOUT)
+            raise
+        return [TargetProxy(channel, _TARGET_HANDLE, 'Target') for channel in channels]
+
+    @property
+    def pid(self) -> int:
+        """
+        Process id of the worker process.
+        """
+        return self._channel.pid
+
+    def run(self, func: Callable[..., Any], *args, **kwargs) -> Any:
+        """
+        Calls func(target, *args, **kwargs) in the worker process and returns its result. func has to be picklable,
+        i.e., a module-level function.
+        """
+        return self._channel.request('run', _TARGET_HANDLE, None, (func,) + args, kwargs)
+
+    def disconnect(self) -> None:
+        """
+        Disconnects the target and terminates the worker process.
+        """
+        self._channel.close(TargetProxy.SHUTDOWN_TIMEOUT)
@@ -0,0 +1,101 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import json
+import os
+import re
+from pathlib import Path
+from typing import List, NamedTuple, Tuple
+
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class MemRegion(NamedTuple):
+    start: int
+    end: int  # exclusive
+    attrs: str  # attributes as reported by GDB's info mem (e.g., 'flash blocksize 0x800 nocache' or 'rw nocache')
+
+    @property
+    def flash(self) -> bool:
+        return self.attrs.split(' ')[0] == 'flash'
+
+
+class TargetDesc(NamedTuple):
+    xml_file: str  # target description (as printed by maint print xml-tdesc)
+    regions: List[MemRegion]  # memory map provided by the GDB server
+
+
+class TargetDescCache(object):
+    """
+    Host-side record of the target description (register layout) and the memory map which GDB fetches from the GDB
+    server on each connect (qXfer:features and qXfer:memory-map). The records are kept per device, GDB server type
+    and probe (see gdb_tdesc_cache in dott.ini). Delete the files to have them fetched again (e.g., after a GDB server
+    update).
+    """
+    _INFO_MEM_RE = re.compile(r'^\s*\d+\s+y\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(.*?)\s*$')
+
+    def __init__(self, cache_dir: str) -> None:
+        self._cache_dir: str = cache_dir
+
+    def _file_name(self, key: Tuple[str, str, str], ext: str) -> Path:
+        name = re.sub(r'[^\w.-]', '_', '_'.join(k if k is not None else 'any' for k in key))
+        return Path(self._cache_dir).joinpath(f'dott_tdesc_{name}.{ext}')
+
+    def load(self, key: Tuple[str, str, str]) -> TargetDesc:
+        """
+        Returns the recorded description of the given (device, GDB server type, probe serial) or None.
+        """
+        xml_file, json_file = self._file_name(key, 'xml'), self._file_name(key, 'json')
+        if not xml_file.exists() or not json_file.exists():
+            return None
+        try:
+            with open(json_file, 'r') as f:
+                regions = [MemRegion(int(start), int(end), str(attrs)) for start, end, attrs in json.load(f)['regions']]
+            return TargetDesc(xml_file.as_posix(), regions)
+        except (OSError, ValueError, KeyError, TypeError) as ex:
+            log.warn(f'Ignoring unreadable target description record {json_file} ({ex}).')
+            return None
+
+    def save(self, key: Tuple[str, str, str], xml: str, info_mem: str) -> None:
+        """
+        Records the target description (XML) and the memory map (output of GDB's info mem).
+        """
+        regions = []
+        for line in info_mem.splitlines():
+            m = TargetDescCache._INFO_MEM_RE.match(line)
+            if m is not None:
+                regions.append((int(m.group(1), 16), int(m.group(2), 16), m.group(3)))
+        try:
+            os.makedirs(self._cache_dir, exist_ok=True)
+            for ext, content in (('xml', xml), ('json', json.dumps({'regions': regions}))):
+                tmp_file = f'{self._file_name(key, ext)}.{os.getpid()}.tmp'
+                with open(tmp_file, 'w') as f:
+                    f.write(content)
+                os.replace(tmp_file, self._file_name(key, ext))
+        except OSError as ex:
+            log.warn(f'Unable to write target description record {self._file_name(key, "json")} ({ex}).')
+
+    def invalidate(self, key: Tuple[str, str, str]) -> None:
+        for ext in ('xml', 'json'):
+            try:
+                self._file_name(key, ext).unlink()
+            except OSError:
+                pass
@@ -0,0 +1,191 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import collections
+import contextlib
+import json
+import os
+import threading
+import time
+from typing import Deque, Dict, Iterator, Tuple
+
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class Timeline(object):
+    """
+    Timeline of host, GDB and target events in Chrome trace event format (viewable with chrome://tracing or
+    https://ui.perfetto.dev). DOTT records MI commands (with duration), running/halted intervals of the targets,
+    breakpoint hits, the phases of its fixtures, the tests and live samples. Tests can add their own events, e.g.,
+    for calls of external equipment:
+        with timeline.span('i2c write', 'equipment', {'len': len(data)}):
+            pi.i2c_write_device(dev, data)
+    Recording is enabled with the timeline_file option in dott.ini (or with start()). Events are kept in a ring buffer
+    of max_events entries, i.e., the oldest events are dropped during very long sessions.
+    """
+    # default capacity of the event ring buffer (one event takes about 300 bytes of host memory)
+    MAX_EVENTS = 1000000
+
+    def __init__(self) -> None:
+        self.enabled: bool = False
+        self._lock: threading.Lock = threading.Lock()
+        self._events: Deque[Dict] = collections.deque(maxlen=Timeline.MAX_EVENTS)
+        self._dropped: int = 0
+        self._time_start: float = time.perf_counter()
+        self._pid: int = os.getpid()
+        self._threads: Dict[int, str] = {}  # tid -> thread name
+        self._tracks: Dict[str, int] = {}  # name of a virtual track (e.g., target state) -> tid
+        self._states: Dict[str, Tuple[str, float]] = {}  # track -> (current state, start time)
+
+    def start(self, max_events: int = None) -> None:
+        """
+        Starts (or restarts) recording. Previously recorded events are discarded.
+        """
+        with self._lock:
+            self._events = collections.deque(maxlen=max_events if max_events is not None else Timeline.MAX_EVENTS)
+            self._dropped = 0
+            self._states = {}
+            self._time_start = time.perf_counter()
+            self.enabled = True
+
+    def stop(self) -> None:
+        self.enabled = False
+
+    @property
+    def dropped(self) -> int:
+        """
+        Number of events which were dropped since the ring buffer was full.
+        """
+        return self._dropped
+
+    def _ts(self, t: float) -> float:
+        # Chrome trace timestamps are microseconds
+        return (t - self._time_start) * 1e6
+
+    def _tid(self, track: str = None) -> int:
+        # called with the lock held
+        if track is None:
+            tid = threading.get_ident()
+            if tid not in self._threads:
+                self._threads[tid] = threading.current_thread().name
+            return tid
+        if track not in self._tracks:
+            self._tracks[track] = len(self._tracks) + 1
+        return self._tracks[track]
+
+    def _add(self, event: Dict, track: str = None) -> None:
+        with self._lock:
+            event['pid'] = self._pid
+            event['tid'] = self._tid(track)
+            if len(self._events) == self._events.maxlen:
+                self._dropped += 1
+            self._events.append(event)
+
+    def complete(self, name: str, cat: str, start: float, end: float = None, args: Dict = None,
+                 track: str = None) -> None:
+        """
+        Adds an event with duration.
+
+        Args:
+            name: Name of the event.
+            cat: Category of the event (e.g., gdb, target, fixture, equipment).
+            start: Start time (time.perf_counter).
+            end: End time (time.perf_counter). Default: now.
+            args: Arguments shown with the event.
+            track: Name of a virtual track the event is shown on. Default: the track of the calling thread.
+        """
+        if not self.enabled:
+            return
+        end = end if end is not None else time.perf_counter()
+        event = {'name': name, 'cat': cat, 'ph': 'X', 'ts': self._ts(start), 'dur': (end - start) * 1e6}
+        if args is not None:
+            event['args'] = args
+        self._add(event, track)
+
+    def instant(self, name: str, cat: str, args: Dict = None, track: str = None) -> None:
+        if not self.enabled:
+            return
+        event = {'name': name, 'cat': cat, 'ph': 'i', 's': 't', 'ts': self._ts(time.perf_counter())}
+        if args is not None:
+            event['args'] = args
+        self._add(event, track)
+
+    def counter(self, name: str, values: Dict[str, float], cat: str = 'samples') -> None:
+        """
+        Adds values of a counter track (e.g., live samples).
+        """
+        if not self.enabled:
+            return
+        self._add({'name': name, 'cat': cat, 'ph': 'C', 'ts': self._ts(time.perf_counter()), 'args': values})
+
+    def state(self, track: str, state: str, cat: str = 'target') -> None:
+        """
+        Switches the state shown on the given track (e.g., running/halted of a target). The interval of the previous
+        state is added as event with duration.
+        """
+        if not self.enabled:
+            return
+        now = time.perf_counter()
+        with self._lock:
+            prev = self._states.get(track)
+            if prev is not None and prev[0] == state:
+                return
+            self._states[track] = (state, now)
+        if prev is not None:
+            self.complete(prev[0], cat, prev[1], now, track=track)
+
+    @contextlib.contextmanager
+    def span(self, name: str, cat: str, args: Dict = None) -> Iterator[None]:
+        """
+        Context manager which adds an event with the duration of its body.
+        """
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.complete(name, cat, start, args=args)
+
+    def save(self, file_name: str) -> None:
+        """
+        Writes the recorded events (with the still open state intervals) as Chrome trace JSON file.
+        """
+        now = time.perf_counter()
+        with self._lock:
+            events = list(self._events)
+            states = dict(self._states)
+            threads = dict(self._threads)
+            tracks = dict(self._tracks)
+        for track, (state, start) in states.items():
+            events.append({'name': state, 'cat': 'target', 'ph': 'X', 'ts': self._ts(start),
+                           'dur': (now - start) * 1e6, 'pid': self._pid, 'tid': tracks[track]})
+        meta = [{'name': 'process_name', 'ph': 'M', 'pid': self._pid, 'args': {'name': 'DOTT'}}]
+        meta += [{'name': 'thread_name', 'ph': 'M', 'pid': self._pid, 'tid': tid, 'args': {'name': name}}
+                 for tid, name in threads.items()]
+        meta += [{'name': 'thread_name', 'ph': 'M', 'pid': self._pid, 'tid': tid, 'args': {'name': name}}
+                 for name, tid in tracks.items()]
+        with open(file_name, 'w') as f:
+            json.dump({'traceEvents': meta + events, 'displayTimeUnit': 'ms'}, f)
+        log.info(f'Timeline with {len(events)} events written to {file_name}'
+                 f'{f" ({self._dropped} oldest events dropped)" if self._dropped > 0 else ""}.')
+
+
+# timeline of the DOTT session (see timeline_file)
+timeline: Timeline = Timeline()
@@ -0,0 +1,254 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Instruction trace based on the Micro Trace Buffer (MTB) of Cortex-M0+ cores. The MTB records every non-sequential
+# change of the program counter (branches, exception entries and returns) as packet of source and destination address
+# into a circular buffer in SRAM. The buffer is drained in bulk while the target is halted (e.g., at a halt point) and
+# decoded against the symbol index into the sequence of executed branches:
+#
+#   mtb = MtbTrace(dt)  # MTB located via the ROM table; buffer DOTT_mtb_buffer (see DOTT_MTB_BUFFER)
+#   mtb.start()
+#   hp = HaltPoint('app_error_handler')
+#   dt.cont()
+#   hp.wait_complete()
+#   trace = mtb.drain()
+#   print(trace.path_str(20))  # how did we get here (last 20 branches)
+
+import struct
+from typing import Dict, List, NamedTuple, Set, Tuple
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+_ROM_TABLE = 0xE00FF000  # Cortex-M ROM table
+_ROM_TABLE_MAX_ENTRIES = 32
+_PART_NUM_MTB = 0x932  # part number of the CoreSight MTB-M0+ (PIDR0/PIDR1)
+
+# MTB registers (offsets from the MTB base address)
+_MTB_POSITION = 0x000  # [31:3] offset of the next packet from MTB_BASE, [2] WRAP
+_MTB_MASTER = 0x004  # [31] EN, [4:0] MASK (buffer size: 2^(MASK + 4) bytes)
+_MTB_FLOW = 0x008
+_MTB_BASE = 0x00C  # SRAM address the buffer offsets are relative to (read-only)
+_MTB_MASTER_EN = 1 << 31
+_MTB_POSITION_WRAP = 1 << 2
+
+
+# -------------------------------------------------------------------------------------------------
+class TraceBranch(NamedTuple):
+    src: int  # address of the branch instruction (or the interrupted instruction for exceptions)
+    dst: int  # address of the first instruction executed after the branch
+    exception: bool  # branch was an exception entry or return (A bit)
+    start: bool  # first packet after the trace was (re-)started (S bit)
+
+
+# -------------------------------------------------------------------------------------------------
+class InstructionTrace(object):
+    """
+    Decoded instruction trace: the executed branches (oldest first) together with the functions of their source and
+    destination addresses. Between two branches, the code from the destination of the first branch up to the source
+    of the next one was executed sequentially (see executed_ranges).
+    """
+    UNKNOWN = '<unknown>'
+
+    def __init__(self, branches: List[TraceBranch], symbols: 'BinarySymbols', wrapped: bool) -> None:
+        self._branches: List[TraceBranch] = branches
+        self._symbols: 'BinarySymbols' = symbols
+        self._wrapped: bool = wrapped
+
+    @property
+    def branches(self) -> List[TraceBranch]:
+        return self._branches
+
+    @property
+    def wrapped(self) -> bool:
+        """
+        True if the trace buffer wrapped around, i.e., the oldest branches were overwritten.
+        """
+        return self._wrapped
+
+    def _func(self, addr: int) -> str:
+        func = self._symbols.func_at(addr) if self._symbols is not None else None
+        return func if func is not None else InstructionTrace.UNKNOWN
+
+    def steps(self) -> List[Tuple[str, int, str, int, bool]]:
+        """
+        Returns the branches as (source function, source address, destination function, destination address,
+        exception) tuples.
+        """
+        return [(self._func(b.src), b.src, self._func(b.dst), b.dst, b.exception) for b in self._branches]
+
+    def path(self, last: int = None) -> List[Tuple[str, int, str, int, bool]]:
+        """
+        Returns the last branches (all if last is None) leading to the halt in which control moved from one function
+        to another (branches within a function are skipped).
+        """
+        steps = [s for s in self.steps() if s[0] != s[2] or s[4]]
+        return steps if last is None else steps[-last:]
+
+    def path_str(self, last: int = 20) -> str:
+        lines = []
+        for src_func, src, dst_func, dst, exc in self.path(last):
+            lines.append(f'  {src_func} (0x{src:08x}) -> {dst_func} (0x{dst:08x}){" [exception]" if exc else ""}')
+        return '\n'.join(lines)
+
+    def executed_ranges(self) -> List[Tuple[int, int]]:
+        """
+        Returns the code ranges (start address, end address inclusive) which were executed sequentially between two
+        consecutive branches. Ranges crossing a trace restart are not included.
+        """
+        ranges = []
+        for prev, cur in zip(self._branches, self._branches[1:]):
+            if not cur.start and prev.dst <= cur.src:
+                ranges.append((prev.dst, cur.src))
+        return ranges
+
+    def functions(self) -> Dict[str, int]:
+        """
+        Returns the number of times each function was entered (as destination of a branch from another function).
+        """
+        counts: Dict[str, int] = {}
+        for src_func, _, dst_func, _, exc in self.steps():
+            if src_func != dst_func or exc:
+                counts[dst_func] = counts.get(dst_func, 0) + 1
+        return counts
+
+    def covered_functions(self) -> Set[str]:
+        """
+        Returns the functions in which code was executed according to the trace (coverage without breakpoints).
+        """
+        covered = {self._func(b.dst) for b in self._branches} | {self._func(b.src) for b in self._branches}
+        covered.discard(InstructionTrace.UNKNOWN)
+        return covered
+
+
+# -------------------------------------------------------------------------------------------------
+class MtbTrace(object):
+    """
+    Configuration and drain of the Micro Trace Buffer (MTB) of Cortex-M0+ targets. The trace buffer is a power of
+    two sized, size aligned memory area in SRAM which the firmware reserves for the MTB (see DOTT_MTB_BUFFER in
+    testhelpers.h) or which is given explicitly. All accesses are done while the target is halted.
+    """
+    PACKET_SIZE = 8
+
+    def __init__(self, target: 'Target', base: int = None, buffer_addr: int = None, buffer_size: int = None) -> None:
+        """
+        Constructor.
+
+        Args:
+            target: Target to be traced (Cortex-M0+ with MTB).
+            base: Address of the MTB registers. Default: located via the ROM table.
+            buffer_addr: Address of the trace buffer. Default: symbol DOTT_mtb_buffer.
+            buffer_size: Size of the trace buffer in bytes (power of two, at least 16). Default: size of
+                         DOTT_mtb_buffer.
+        """
+        self._target: 'Target' = target
+        self._base: int = base if base is not None else self._find_mtb()
+        if buffer_addr is None:
+            if not target.symbols.exists('DOTT_mtb_buffer'):
+                raise DottException('No MTB trace buffer given and DOTT_mtb_buffer (DOTT_MTB_BUFFER) not found.')
+            buffer_addr = target.symbols.addr('DOTT_mtb_buffer')
+            buffer_size = buffer_size if buffer_size is not None else target.symbols.size('DOTT_mtb_buffer')
+        if buffer_size is None or buffer_size < 16 or buffer_size & (buffer_size - 1) != 0:
+            raise DottException(f'MTB trace buffer size ({buffer_size}) has to be a power of two (at least 16).')
+        if buffer_addr % buffer_size != 0:
+            raise DottException(f'MTB trace buffer 0x{buffer_addr:x} is not aligned to its size ({buffer_size}).')
+        self._buffer_addr: int = buffer_addr
+        self._buffer_size: int = buffer_size
+        self._mtb_sram: int = self._reg(_MTB_BASE)
+
+    def _reg(self, offset: int, val: int = None) -> int:
+        fmt = '<I' if self._target.byte_order == 'little' else '>I'
+        if val is None:
+            return struct.unpack(fmt, self._target.mem.read(self._base + offset, 4))[0]
+        self._target.mem.write(self._base + offset, struct.pack(fmt, val & 0xffffffff))
+        return val
+
+    def _read32(self, addr: int) -> int:
+        fmt = '<I' if self._target.byte_order == 'little' else '>I'
+        return struct.unpack(fmt, self._target.mem.read(addr, 4))[0]
+
+    def _find_mtb(self) -> int:
+        # walks the Cortex-M ROM table for the CoreSight component with the part number of the MTB-M0+
+        for i in range(_ROM_TABLE_MAX_ENTRIES):
+            entry = self._read32(_ROM_TABLE + 4 * i)
+            if entry == 0:
+                break
+            if entry & 0x1 == 0:
+                continue  # entry not present
+            offset = entry & 0xfffff000
+            comp = (_ROM_TABLE + (offset - (1 << 32) if offset & 0x80000000 else offset)) & 0xffffffff
+            pidr0, pidr1 = self._read32(comp + 0xFE0), self._read32(comp + 0xFE4)
+            if (pidr0 & 0xff) | ((pidr1 & 0xf) << 8) == _PART_NUM_MTB:
+                log.debug(f'MTB found at 0x{comp:x}.')
+                return comp
+        raise DottException('No Micro Trace Buffer (MTB) found in the ROM table of the target.')
+
+    @property
+    def base(self) -> int:
+        return self._base
+
+    @property
+    def buffer(self) -> Tuple[int, int]:
+        """
+        Address and size of the trace buffer.
+        """
+        return self._buffer_addr, self._buffer_size
+
+    def start(self) -> None:
+        """
+        Clears the trace buffer and enables tracing (the trace is recorded once the target is resumed).
+        """
+        mask = self._buffer_size.bit_length() - 1 - 4
+        self._reg(_MTB_MASTER, 0)
+        self._reg(_MTB_POSITION, (self._buffer_addr - self._mtb_sram) & ~0x7)
+        self._reg(_MTB_FLOW, 0)
+        self._reg(_MTB_MASTER, _MTB_MASTER_EN | mask)
+
+    def stop(self) -> None:
+        self._reg(_MTB_MASTER, self._reg(_MTB_MASTER) & ~_MTB_MASTER_EN)
+
+    def drain(self, clear: bool = True) -> InstructionTrace:
+        """
+        Reads the trace buffer (in one bulk read) and decodes it. The target has to be halted. Tracing continues
+        when the target is resumed.
+
+        Args:
+            clear: If True, the buffer is cleared such that the next drain only returns new branches.
+        """
+        pos = self._reg(_MTB_POSITION)
+        wrapped = pos & _MTB_POSITION_WRAP != 0
+        write_offset = ((pos & ~0x7) + self._mtb_sram - self._buffer_addr) % self._buffer_size
+        data = self._target.mem.read(self._buffer_addr, self._buffer_size)
+        data = data[write_offset:] + data[:write_offset] if wrapped else data[:write_offset]
+        if clear:
+            self._reg(_MTB_POSITION, (self._buffer_addr - self._mtb_sram) & ~0x7)
+        return InstructionTrace(MtbTrace.decode(data, self._target.byte_order), self._target.symbols, wrapped)
+
+    @staticmethod
+    def decode(data: bytes, byte_order: str = 'little') -> List[TraceBranch]:
+        """
+        Decodes raw MTB packets (oldest first) into branches.
+        """
+        fmt = ('<' if byte_order == 'little' else '>') + 'II'
+        branches = []
+        for offset in range(0, len(data) - len(data) % MtbTrace.PACKET_SIZE, MtbTrace.PACKET_SIZE):
+            src, dst = struct.unpack_from(fmt, data, offset)
+            branches.append(TraceBranch(src & ~0x1, dst & ~0x1, src & 0x1 != 0, dst & 0x1 != 0))
+        return branches
@@ -0,0 +1,150 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import hashlib
+import json
+import os
+import struct
+from pathlib import Path
+from typing import Dict, List
+
+from dottmi.elf_file import ElfFile
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class TypeCache(object):
+    """
+    Cache for target type information (sizes, element formats and layouts) which is shared by all TargetMem
+    instances of a target. The cache is bound to the symbol ELF file loaded into GDB and is keyed by the ELF's GNU
+    build-id (or a hash of the ELF file if it has no build-id). If a cache directory is configured, the cache content
+    is persisted per key such that it survives across test sessions.
+    """
+    # ELF constants used to locate the GNU build-id note
+    _SHT_NOTE = 7
+    _NT_GNU_BUILD_ID = 3
+
+    # version of the on-disk format; files with a different version are ignored
+    FILE_VERSION = 2
+
+    def __init__(self, cache_dir: str = None) -> None:
+        self._cache_dir: str = cache_dir
+        self._key: str = None
+        self._dirty: bool = False
+        self.sizes: Dict[str, int] = {}
+        self.elem_fmts: Dict[str, List] = {}
+        self.layouts: Dict[str, Dict] = {}
+
+    @property
+    def key(self) -> str:
+        return self._key
+
+    def _file_name(self) -> Path:
+        return Path(self._cache_dir).joinpath(f'dott_types_{self._key}.json')
+
+    def bind(self, elf_file: str, manifest: 'DottManifest' = None) -> None:
+        """
+        Binds the cache to the given ELF file. If the ELF differs from the one the cache is currently bound to, the
+        cache is saved and the entries for the new ELF are loaded (if available on disk). Type sizes and layouts of
+        the ELF's DOTT manifest (if given) are added to the cache.
+        """
+        try:
+            key = manifest.key if manifest is not None else TypeCache.elf_key(elf_file)
+        except OSError as ex:
+            log.warn(f'Unable to determine build-id of {elf_file} ({ex}). Type cache is not persisted.')
+            key = None
+        if key == self._key and key is not None:
+            return
+
+        self.save()
+        self._key = key
+        self._dirty = False
+        self.sizes, self.elem_fmts, self.layouts = {}, {}, {}
+        if manifest is not None:
+            self.sizes.update(manifest.sizes)
+            self.layouts.update(manifest.layouts)
+
+        if self._key is None or self._cache_dir is None or not self._file_name().exists():
+            return
+        try:
+            with open(self._file_name(), 'r') as f:
+                content = json.load(f)
+            if content.get('version') == TypeCache.FILE_VERSION:
+                self.sizes.update(content['sizes'])
+                self.elem_fmts = content['elem_fmts']
+                self.layouts.update(content['layouts'])
+        except (OSError, ValueError, KeyError) as ex:
+            log.warn(f'Ignoring unreadable type cache file {self._file_name()} ({ex}).')
+
+    def mark_dirty(self) -> None:
+        self._dirty = True
+
+    def save(self) -> None:
+        """
+        Writes the cache to disk (if a cache directory is configured and there are new entries).
+        """
+        if not self._dirty or self._key is None or self._cache_dir is None:
+            return
+        try:
+            os.makedirs(self._cache_dir, exist_ok=True)
+            tmp_file = f'{self._file_name()}.{os.getpid()}.tmp'
+            with open(tmp_file, 'w') as f:
+                json.dump({'version': TypeCache.FILE_VERSION, 'sizes': self.sizes, 'elem_fmts': self.elem_fmts,
+                           'layouts': self.layouts}, f)
+            os.replace(tmp_file, self._file_name())  # atomic replacement; concurrent sessions may share the cache
+            self._dirty = False
+        except OSError as ex:
+            log.warn(f'Unable to write type cache file {self._file_name()} ({ex}).')
+
+    @staticmethod
+    def elf_key(elf_file: str) -> str:
+        """
+        Returns the GNU build-id of the given ELF file as hex string. If the ELF has no build-id, the SHA-1 hash of
+        the file is returned instead.
+        """
+        return ElfFile.open(elf_file).key
+
+    @staticmethod
+    def _elf_build_id(data: bytes) -> str:
+        if data[:4] != b'\x7fELF':
+            return None
+        bo = '<' if data[5] == 1 else '>'
+        if data[4] == 1:  # 32 bit ELF
+            sh_off, = struct.unpack_from(bo + 'I', data, 0x20)
+            sh_entsize, sh_num = struct.unpack_from(bo + 'HH', data, 0x2e)
+            sh_fmt, sh_type_off, sh_offset_off = bo + 'IIIIII', 1, 4
+        else:  # 64 bit ELF
+            sh_off, = struct.unpack_from(bo + 'Q', data, 0x28)
+            sh_entsize, sh_num = struct.unpack_from(bo + 'HH', data, 0x3a)
+            sh_fmt, sh_type_off, sh_offset_off = bo + 'IIQQQQ', 1, 4
+
+        for i in range(sh_num):
+            sh = struct.unpack_from(sh_fmt, data, sh_off + i * sh_entsize)
+            if sh[sh_type_off] != TypeCache._SHT_NOTE:
+                continue
+            pos, end = sh[sh_offset_off], sh[sh_offset_off] + sh[sh_offset_off + 1]
+            while pos + 12 <= end:
+                name_sz, desc_sz, note_type = struct.unpack_from(bo + 'III', data, pos)
+                name_start = pos + 12
+                desc_start = name_start + ((name_sz + 3) & ~3)
+                if note_type == TypeCache._NT_GNU_BUILD_ID and data[name_start:name_start + name_sz] == b'GNU\x00':
+                    return data[desc_start:desc_start + desc_sz].hex()
+                pos = desc_start + ((desc_sz + 3) & ~3)
+        return None
@@ -0,0 +1,181 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import dataclasses
+import struct
+from typing import Dict, List, Union
+
+from dottmi.dottexceptions import DottException
+
+
+# -------------------------------------------------------------------------------------------------
+class TypeLayout(object):
+    """
+    Memory layout of a target data type as reported by GDB (see dott-type-layout in gdb_cmds.py). It is used to
+    marshal Python values to/from the raw target memory representation of the type on the host. Supported are
+    integer, enum, pointer and floating point types as well as (nested) structs, unions and arrays thereof.
+    Structs and unions are represented as dicts (or dataclasses when writing), arrays as lists.
+    """
+    _INT_FMTS = {1: 'b', 2: 'h', 4: 'i', 8: 'q'}
+    _FLT_FMTS = {4: 'f', 8: 'd'}
+
+    def __init__(self, layout: Dict, byte_order: str) -> None:
+        """
+        Constructor.
+
+        Args:
+            layout: Layout dictionary as returned by the dott-type-layout GDB command.
+            byte_order: Byte order of the target ('little' or 'big').
+        """
+        self._layout: Dict = layout
+        self._byte_order: str = byte_order
+
+    @property
+    def size(self) -> int:
+        return self._layout['size']
+
+    @property
+    def type(self) -> str:
+        return self._layout['type']
+
+    @property
+    def kind(self) -> str:
+        # 'int', 'float', 'func' or 'raw' (None for structs, unions and arrays)
+        return self._layout.get('kind')
+
+    @property
+    def signed(self) -> bool:
+        return self._layout.get('signed', False)
+
+    @property
+    def values(self) -> List[int]:
+        # values of the enumerators of enum types (None for all other types)
+        return self._layout.get('values')
+
+    @property
+    def params(self) -> List['TypeLayout']:
+        # layouts of the parameters of function types
+        return [TypeLayout(p, self._byte_order) for p in self._layout.get('params', [])]
+
+    @property
+    def ret(self) -> 'TypeLayout':
+        # layout of the return type of function types (None for void functions)
+        ret = self._layout.get('ret')
+        return TypeLayout(ret, self._byte_order) if ret is not None else None
+
+    @property
+    def field_names(self) -> List[str]:
+        return [f['name'] for f in self._layout.get('fields', [])]
+
+    def field_offset(self, name: str) -> int:
+        for f in self._layout.get('fields', []):
+            if f['name'] == name:
+                return f['offset']
+        raise KeyError(f'{self.type} has no member {name}')
+
+    def _scalar_fmt(self, lt: Dict) -> str:
+        bo = '<' if self._byte_order == 'little' else '>'
+        if lt['kind'] == 'float' and lt['size'] in TypeLayout._FLT_FMTS:
+            return bo + TypeLayout._FLT_FMTS[lt['size']]
+        if lt['kind'] == 'int' and lt['size'] in TypeLayout._INT_FMTS:
+            fmt = TypeLayout._INT_FMTS[lt['size']]
+            return bo + (fmt if lt['signed'] else fmt.upper())
+        raise DottException(f'Unable to marshal values of type {lt["type"]}.')
+
+    def _unpack(self, lt: Dict, data: bytes, offset: int):
+        if 'fields' in lt:
+            return {f['name']: self._unpack_field(f, data, offset) for f in lt['fields']}
+        elif 'elem' in lt:
+            elem_sz = lt['elem']['size']
+            return [self._unpack(lt['elem'], data, offset + i * elem_sz) for i in range(lt['count'])]
+        elif lt['kind'] == 'raw':
+            return bytes(data[offset:offset + lt['size']])
+        return struct.unpack_from(self._scalar_fmt(lt), data, offset)[0]
+
+    def _unpack_field(self, f: Dict, data: bytes, offset: int):
+        offset += f['offset']
+        if 'bitsize' not in f:
+            return self._unpack(f, data, offset)
+        nbytes, mask = self._bitfield_geometry(f)
+        return (int.from_bytes(data[offset:offset + nbytes], 'little') >> f['bitpos']) & mask
+
+    def _bitfield_geometry(self, f: Dict):
+        if self._byte_order != 'little':
+            raise DottException('Bitfields are only supported for little endian targets.')
+        nbytes = (f['bitpos'] + f['bitsize'] + 7) // 8
+        return nbytes, (1 << f['bitsize']) - 1
+
+    def _pack(self, lt: Dict, buf: bytearray, offset: int, value) -> None:
+        if dataclasses.is_dataclass(value):
+            value = dataclasses.asdict(value)
+        if 'fields' in lt:
+            for f in lt['fields']:
+                if f['name'] in value:
+                    self._pack_field(f, buf, offset, value[f['name']])
+        elif 'elem' in lt:
+            elem_sz = lt['elem']['size']
+            if len(value) > lt['count']:
+                raise ValueError(f'Too many elements for {lt["type"]} ({len(value)} > {lt["count"]}).')
+            for i, v in enumerate(value):
+                self._pack(lt['elem'], buf, offset + i * elem_sz, v)
+        elif lt['kind'] == 'raw':
+            buf[offset:offset + lt['size']] = bytes(value)[:lt['size']]
+        else:
+            struct.pack_into(self._scalar_fmt(lt), buf, offset, value)
+
+    def _pack_field(self, f: Dict, buf: bytearray, offset: int, value) -> None:
+        offset += f['offset']
+        if 'bitsize' not in f:
+            self._pack(f, buf, offset, value)
+            return
+        nbytes, mask = self._bitfield_geometry(f)
+        unit = int.from_bytes(buf[offset:offset + nbytes], 'little')
+        unit = (unit & ~(mask << f['bitpos'])) | ((value & mask) << f['bitpos'])
+        buf[offset:offset + nbytes] = unit.to_bytes(nbytes, 'little')
+
+    def _is_complete(self, lt: Dict, value) -> bool:
+        if dataclasses.is_dataclass(value):
+            value = dataclasses.asdict(value)
+        if 'fields' in lt:
+            return all(f['name'] in value and self._is_complete(f, value[f['name']]) for f in lt['fields'])
+        elif 'elem' in lt:
+            return len(value) == lt['count'] and all(self._is_complete(lt['elem'], v) for v in value)
+        return True
+
+    def unpack(self, data: bytes) -> Union[Dict, List, int, float, bytes]:
+        """
+        Converts the raw target memory representation into a Python value.
+        """
+        return self._unpack(self._layout, data, 0)
+
+    def pack(self, value, base: bytes = None) -> bytes:
+        """
+        Converts the given Python value into the raw target memory representation. Struct members (and array
+        elements) not contained in value are taken from base (or are zero if base is None).
+        """
+        buf = bytearray(base) if base is not None else bytearray(self.size)
+        self._pack(self._layout, buf, 0, value)
+        return bytes(buf)
+
+    def is_complete(self, value) -> bool:
+        """
+        Returns True if value provides all struct members and array elements of the type.
+        """
+        return self._is_complete(self._layout, value)
@@ -0,0 +1,240 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Capture of the serial (UART) output of the target. A dedicated reader thread drains the serial port into a host-side
+# buffer as soon as data arrives (the OS receive buffer is enlarged where supported) such that serial logging firmware
+# can be verified at full baud rate. Each received chunk is stamped with the host time (time.perf_counter) it was read
+# at; the arrival times of its bytes are estimated from the baud rate. Since DOTT's events use the same clock (e.g.,
+# Breakpoint.hit_time and the timeline, see timeline_file), the output can be correlated with them. For example:
+#
+#   bp = HaltPoint('DOTT_LABEL_CONFIG_DONE')
+#   dt.cont()
+#   bp.wait_complete()
+#   assert uart_capture.wait_for('config ok', timeout=1.0) < bp.hit_time  # printed before the label was reached
+#   lines = uart_capture.lines(t_end=bp.hit_time)
+
+import bisect
+import threading
+import time
+from typing import List, Tuple, Union
+
+import serial
+
+from dottmi.dottexceptions import DottException
+from dottmi.timeline import timeline
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class UartCapture(object):
+    """
+    Captures the data received on a serial port in a reader thread (see module description). Use the uart_capture
+    fixture (uart_port in dott.ini) or create an instance directly.
+    """
+    # timeout (seconds) of a single read of the reader thread
+    READ_TIMEOUT = 0.005
+
+    def __init__(self, port: str, baudrate: int = 115200, bytesize: int = serial.EIGHTBITS,
+                 parity: str = serial.PARITY_NONE, stopbits: float = serial.STOPBITS_ONE,
+                 rx_buffer_size: int = 1024 * 1024) -> None:
+        """
+        Constructor. The port is opened by start.
+
+        Args:
+            port: Serial port (e.g., COM3 or /dev/ttyACM0).
+            baudrate: Baud rate.
+            bytesize: Number of data bits.
+            parity: Parity (see pyserial).
+            stopbits: Number of stop bits.
+            rx_buffer_size: Size of the OS receive buffer (only applied where supported, e.g., on Windows).
+        """
+        self._port: str = port
+        self._baudrate: int = baudrate
+        self._bytesize: int = bytesize
+        self._parity: str = parity
+        self._stopbits: float = stopbits
+        self._rx_buffer_size: int = rx_buffer_size
+        # transmission time of one character (start bit, data bits, parity bit and stop bits)
+        bits = 1 + bytesize + (0 if parity == serial.PARITY_NONE else 1) + stopbits
+        self._char_secs: float = bits / baudrate
+
+        self._serial: serial.Serial = None
+        self._thread: threading.Thread = None
+        self._running: bool = False
+        self._cv: threading.Condition = threading.Condition()
+        self._data: bytearray = bytearray()
+        self._chunk_ends: List[int] = []  # end offset (in _data) of each received chunk
+        self._chunk_times: List[float] = []  # host time at which each chunk was read
+        self._error: Exception = None
+
+    @property
+    def port(self) -> str:
+        return self._port
+
+    @property
+    def num_bytes(self) -> int:
+        """
+        Number of bytes received (since start or the last clear).
+        """
+        return len(self._data)
+
+    def start(self) -> None:
+        """
+        Opens the serial port and starts the reader thread.
+        """
+        if self._running:
+            return
+        try:
+            self._serial = serial.Serial(self._port, self._baudrate, bytesize=self._bytesize, parity=self._parity,
+                                         stopbits=self._stopbits, timeout=UartCapture.READ_TIMEOUT)
+        except serial.SerialException as ex:
+            raise DottException(f'Unable to open serial port {self._port} ({ex}).') from None
+        if hasattr(self._serial, 'set_buffer_size'):
+            self._serial.set_buffer_size(rx_size=self._rx_buffer_size)
+        self._serial.reset_input_buffer()
+        self._error = None
+        self._running = True
+        self._thread = threading.Thread(target=self._read_loop, name='UartCapture', daemon=True)
+        self._thread.start()
+        log.debug(f'UART capture of {self._port} started ({self._baudrate} baud).')
+
+    def stop(self) -> None:
+        """
+        Stops the reader thread and closes the serial port. Data already received remains available.
+        """
+        if not self._running:
+            return
+        self._running = False
+        self._thread.join()
+        self._serial.close()
+        self._serial = None
+
+    def clear(self) -> None:
+        """
+        Discards the data received so far.
+        """
+        with self._cv:
+            self._data = bytearray()
+            self._chunk_ends = []
+            self._chunk_times = []
+
+    def _read_loop(self) -> None:
+        track = f'UART {self._port}'
+        while self._running:
+            try:
+                data = self._serial.read(max(1, self._serial.in_waiting))
+            except (serial.SerialException, OSError) as ex:
+                log.error(f'UART capture of {self._port} failed ({ex}).')
+                self._error = ex
+                self._running = False
+                with self._cv:
+                    self._cv.notify_all()
+                return
+            if len(data) == 0:
+                continue
+            now = time.perf_counter()
+            with self._cv:
+                self._data.extend(data)
+                self._chunk_ends.append(len(self._data))
+                self._chunk_times.append(now)
+                self._cv.notify_all()
+            timeline.complete(f'{len(data)} bytes', 'uart', now - len(data) * self._char_secs, now, track=track)
+
+    def _byte_time(self, offset: int) -> float:
+        # estimated arrival time of the byte at the given offset: the bytes of a chunk arrived back to back before it
+        # was read (called with the lock held)
+        idx = bisect.bisect_right(self._chunk_ends, offset)
+        t = self._chunk_times[idx] - (self._chunk_ends[idx] - 1 - offset) * self._char_secs
+        return max(t, self._chunk_times[idx - 1]) if idx > 0 else t
+
+    def _offset(self, t: float) -> int:
+        # offset of the first byte which arrived at or after t (called with the lock held)
+        lo, hi = 0, len(self._data)
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self._byte_time(mid) < t:
+                lo = mid + 1
+            else:
+                hi = mid
+        return lo
+
+    def _range(self, t_start: float, t_end: float) -> Tuple[int, int]:
+        start = 0 if t_start is None else self._offset(t_start)
+        end = len(self._data) if t_end is None else self._offset(t_end)
+        return start, max(start, end)
+
+    def data(self, t_start: float = None, t_end: float = None) -> bytes:
+        """
+        Returns the bytes which arrived within [t_start, t_end) (host times, see time.perf_counter; default: all).
+        """
+        with self._cv:
+            start, end = self._range(t_start, t_end)
+            return bytes(self._data[start:end])
+
+    def text(self, t_start: float = None, t_end: float = None, encoding: str = 'utf-8') -> str:
+        return self.data(t_start, t_end).decode(encoding, errors='replace')
+
+    def lines(self, t_start: float = None, t_end: float = None,
+              encoding: str = 'utf-8') -> List[Tuple[float, str]]:
+        """
+        Returns the complete lines (terminated with '\\n') which arrived within [t_start, t_end) as (arrival time of
+        the line end, line without line ending) tuples.
+        """
+        res: List[Tuple[float, str]] = []
+        with self._cv:
+            start, end = self._range(t_start, t_end)
+            pos = start
+            while True:
+                nl = self._data.find(b'\n', pos, end)
+                if nl < 0:
+                    return res
+                line = bytes(self._data[pos:nl]).rstrip(b'\r').decode(encoding, errors='replace')
+                res.append((self._byte_time(nl), line))
+                pos = nl + 1
+
+    def wait_for(self, pattern: Union[str, bytes], timeout: float = 5.0, t_start: float = None) -> float:
+        """
+        Waits until the given text has been received (after t_start if given) and returns the (estimated) arrival time
+        of its last byte. Raises a DottException if it is not received within timeout seconds.
+        """
+        if isinstance(pattern, str):
+            pattern = pattern.encode()
+        deadline = time.perf_counter() + timeout
+        with self._cv:
+            start, _ = self._range(t_start, None)
+            while True:
+                idx = self._data.find(pattern, start)
+                if idx >= 0:
+                    return self._byte_time(idx + len(pattern) - 1)
+                # note: a match may start in the data already searched
+                start = max(start, len(self._data) - len(pattern) + 1)
+                remaining = deadline - time.perf_counter()
+                if self._error is not None or remaining <= 0:
+                    break
+                self._cv.wait(remaining)
+        reason = f' (capture failed: {self._error})' if self._error is not None else ''
+        raise DottException(f'{pattern!r} not received on {self._port} within {timeout}s{reason}.')
+
+    def __enter__(self) -> 'UartCapture':
+        self.start()
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.stop()
@@ -18,10 +18,16 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import array
+import asyncio
+import collections
 import logging
+import re
 import struct
+import sys
 import threading
-from typing import Union, List
+import time
+from typing import Any, Callable, Deque, List, Tuple, Union
 
 log = logging.getLogger('DOTT')
 
@@ -54,6 +60,104 @@ def singleton(cls, *args, **kw):
 
 # -------------------------------------------------------------------------------------------------
 class DottConvert(object):
+    """
+    Conversion of target memory content (bytes) from/to Python values. decode, decode_array and encode are generic
+    codecs for the element types in DottConvert.FORMATS; the bytes_to_xxx and xxx_to_bytes functions are shorthands
+    for the most common types. Data may be given as bytes, bytearray or memoryview (e.g., a slice of a larger capture
+    buffer) and is not copied unless it has to be byte-swapped.
+    """
+    # element types and their struct/array format characters
+    FORMATS = {'uint8': 'B', 'int8': 'b', 'uint16': 'H', 'int16': 'h', 'uint32': 'I', 'int32': 'i',
+               'uint64': 'Q', 'int64': 'q', 'float': 'f', 'double': 'd'}
+
+    @staticmethod
+    def _format(dtype: str, byte_order: str) -> Tuple[str, bool]:
+        # returns the format character of the type and whether the byte order differs from the host's byte order
+        if dtype not in DottConvert.FORMATS:
+            raise ValueError(f'Unsupported type ({dtype})!')
+        if byte_order not in ('little', 'big'):
+            raise ValueError(f'Unsupported byte order ({byte_order})!')
+        return DottConvert.FORMATS[dtype], byte_order != sys.byteorder
+
+    @staticmethod
+    def _view(data: Union[bytes, bytearray, memoryview], fmt: str) -> memoryview:
+        view = memoryview(data)
+        if view.format != 'B' or view.ndim != 1:
+            view = view.cast('B')
+        size = struct.calcsize(fmt)
+        if (len(view) % size) != 0:
+            raise ValueError(f'Data shall have a length which is a multiple of {size}!')
+        return view
+
+    @staticmethod
+    def decode(data: Union[bytes, bytearray, memoryview], dtype: str = 'uint32',
+               byte_order: str = 'little') -> List[Union[int, float]]:
+        """
+        Converts the given data to a list of values of the given type.
+        Args:
+            data: Bytes to be converted (bytes, bytearray or memoryview).
+            dtype: Element type (see DottConvert.FORMATS).
+            byte_order: Either 'little' for little endian (default) or 'big' for big endian.
+
+        Returns:
+            A list containing the converted values.
+        """
+        fmt, swap = DottConvert._format(dtype, byte_order)
+        view = DottConvert._view(data, fmt)
+        if not swap:
+            return view.cast(fmt).tolist()
+        return list(struct.unpack(f'>{len(view) // struct.calcsize(fmt)}{fmt}', view))
+
+    @staticmethod
+    def decode_array(data: Union[bytes, bytearray, memoryview], dtype: str = 'uint32',
+                     byte_order: str = 'little') -> array.array:
+        """
+        Converts the given data to an array of values of the given type. Compared to decode, the values are not
+        converted to individual Python objects which makes this the preferred function for large buffers. For numpy
+        arrays, use numpy.frombuffer(data, dtype='<u4') etc. directly.
+        Args:
+            data: Bytes to be converted (bytes, bytearray or memoryview).
+            dtype: Element type (see DottConvert.FORMATS).
+            byte_order: Either 'little' for little endian (default) or 'big' for big endian.
+
+        Returns:
+            An array.array containing the converted values.
+        """
+        fmt, swap = DottConvert._format(dtype, byte_order)
+        ret_val = array.array(fmt)
+        ret_val.frombytes(DottConvert._view(data, fmt))
+        if swap:
+            ret_val.byteswap()
+        return ret_val
+
+    @staticmethod
+    def encode(data: Union[int, float, List[Union[int, float]], array.array], dtype: str = 'uint32',
+               byte_order: str = 'little') -> bytes:
+        """
+        Converts the given value(s) of the given type to bytes.
+        Args:
+            data: A single value, a list of values or an array.array.
+            dtype: Element type (see DottConvert.FORMATS).
+            byte_order: Either 'little' for little endian (default) or 'big' for big endian.
+
+        Returns:
+            A bytes object containing the serialized data.
+        """
+        fmt, swap = DottConvert._format(dtype, byte_order)
+        if isinstance(data, (int, float)):
+            data = [data]
+        if isinstance(data, array.array) and data.typecode == fmt:
+            if swap:
+                data = array.array(fmt, data)
+                data.byteswap()
+            return data.tobytes()
+        order = '>' if byte_order == 'big' else '<'
+        return struct.pack(f'{order}{len(data)}{fmt}', *data)
+
+    @staticmethod
+    def _scalar_or_list(values: List) -> Union[int, float, List]:
+        return values[0] if len(values) == 1 else values
+
     @staticmethod
     def bytes_to_uint32(data: bytes, byte_order: str = 'little') -> Union[int, List[int]]:
         """
@@ -66,20 +170,7 @@ class DottConvert(object):
         Returns:
         An int or and int list if data is longer than four bytes.
         """
-        if (len(data) % 4) != 0:
-            raise ValueError(f'Data shall have a length which is a multiple of 4!')
-
-        if byte_order == 'little':
-            ret_val = struct.unpack('<%dI' % (len(data) / 4), data)
-        elif byte_order == 'big':
-            ret_val = struct.unpack('>%dI' % (len(data) / 4), data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        if len(ret_val) == 1:
-            return ret_val[0]
-        else:
-            return list(ret_val)
+        return DottConvert._scalar_or_list(DottConvert.decode(data, 'uint32', byte_order))
 
     @staticmethod
     def bytes_to_uint16(data: bytes, byte_order: str = 'little')  -> Union[int, List[int]]:
@@ -93,20 +184,7 @@ class DottConvert(object):
         Returns:
         An int or an int list if data is longer than two bytes.
         """
-        if (len(data) % 2) != 0:
-            raise ValueError(f'Data shall have a length which is a multiple of 2!')
-
-        if byte_order == 'little':
-            ret_val = struct.unpack('<%dH' % (len(data) / 2), data)
-        elif byte_order == 'big':
-            ret_val = struct.unpack('>%dH' % (len(data) / 2), data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        if len(ret_val) == 1:
-            return ret_val[0]
-        else:
-            return list(ret_val)
+        return DottConvert._scalar_or_list(DottConvert.decode(data, 'uint16', byte_order))
 
     @staticmethod
     def bytes_to_int32(data: bytes, byte_order: str = 'little')  -> Union[int, List[int]]:
@@ -120,20 +198,7 @@ class DottConvert(object):
         Returns:
         An int or and int list if data is longer than four bytes.
         """
-        if (len(data) % 4) != 0:
-            raise ValueError(f'Data shall have a length which is a multiple of 4!')
-
-        if byte_order == 'little':
-            ret_val = struct.unpack('<%di' % (len(data) / 4), data)
-        elif byte_order == 'big':
-            ret_val = struct.unpack('>%di' % (len(data) / 4), data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        if len(ret_val) == 1:
-            return ret_val[0]
-        else:
-            return list(ret_val)
+        return DottConvert._scalar_or_list(DottConvert.decode(data, 'int32', byte_order))
 
     @staticmethod
     def bytes_to_int16(data: bytes, byte_order: str = 'little') -> Union[int, List[int]]:
@@ -147,20 +212,7 @@ class DottConvert(object):
         Returns:
         An int or and int list if data is longer than two bytes.
         """
-        if (len(data) % 2) != 0:
-            raise ValueError(f'Data shall have a length which is a multiple of 2!')
-
-        if byte_order == 'little':
-            ret_val = struct.unpack('<%dh' % (len(data) / 2), data)
-        elif byte_order == 'big':
-            ret_val = struct.unpack('>%dh' % (len(data) / 2), data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        if len(ret_val) == 1:
-            return ret_val[0]
-        else:
-            return list(ret_val)
+        return DottConvert._scalar_or_list(DottConvert.decode(data, 'int16', byte_order))
 
     @staticmethod
     def uint32_to_bytes(data: Union[int, List[int]], byte_order: str = 'little') -> bytes:
@@ -174,16 +226,7 @@ class DottConvert(object):
         Returns:
             A bytes object containing the serialized integer data.
         """
-        if isinstance(data, int):
-            data = [data]
-        if byte_order == 'little':
-            ret_val = struct.pack('<%dI' % len(data), *data)
-        elif byte_order == 'big':
-            ret_val = struct.pack('>%dI' % len(data), *data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        return ret_val
+        return DottConvert.encode(data, 'uint32', byte_order)
 
     @staticmethod
     def uint16_to_bytes(data: Union[int, List[int]], byte_order: str = 'little') -> bytes:
@@ -197,16 +240,7 @@ class DottConvert(object):
         Returns:
             A bytes object containing the serialized integer data.
         """
-        if isinstance(data, int):
-            data = [data]
-        if byte_order == 'little':
-            ret_val = struct.pack('<%dH' % len(data), *data)
-        elif byte_order == 'big':
-            ret_val = struct.pack('>%dH' % len(data), *data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        return ret_val
+        return DottConvert.encode(data, 'uint16', byte_order)
 
     @staticmethod
     def int32_to_bytes(data: Union[int, List[int]], byte_order: str = 'little') -> bytes:
@@ -219,16 +253,7 @@ class DottConvert(object):
 
         Returns: A bytes object containing the serialized integer data.
         """
-        if isinstance(data, int):
-            data = [data]
-        if byte_order == 'little':
-            ret_val = struct.pack('<%di' % len(data), *data)
-        elif byte_order == 'big':
-            ret_val = struct.pack('>%di' % len(data), *data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        return ret_val
+        return DottConvert.encode(data, 'int32', byte_order)
 
     @staticmethod
     def int16_to_bytes(data: Union[int, List[int]], byte_order: str = 'little') -> bytes:
@@ -241,16 +266,7 @@ class DottConvert(object):
 
         Returns: A bytes object containing the serialized integer data.
         """
-        if isinstance(data, int):
-            data = [data]
-        if byte_order == 'little':
-            ret_val = struct.pack('<%dh' % len(data), *data)
-        elif byte_order == 'big':
-            ret_val = struct.pack('>%dh' % len(data), *data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        return ret_val
+        return DottConvert.encode(data, 'int16', byte_order)
 
     @staticmethod
     def float_to_bytes(data: Union[float, List[float]], byte_order: str = 'little') -> bytes:
@@ -263,16 +279,7 @@ class DottConvert(object):
 
         Returns: A bytes object containing the serialized float data.
         """
-        if isinstance(data, float):
-            data = [data]
-        if byte_order == 'little':
-            ret_val = struct.pack('<%df' % len(data), *data)
-        elif byte_order == 'big':
-            ret_val = struct.pack('>%df' % len(data), *data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
-
-        return ret_val
+        return DottConvert.encode(data, 'float', byte_order)
 
     @staticmethod
     def bytes_to_float(data: bytes, byte_order: str = 'little') -> Union[float, List[float]]:
@@ -286,27 +293,23 @@ class DottConvert(object):
         Returns:
         A float or and float list if data is longer than four bytes.
         """
-        if (len(data) % 4) != 0:
-            raise ValueError(f'Data shall have a length which is a multiple of 4!')
+        return DottConvert._scalar_or_list(DottConvert.decode(data, 'float', byte_order))
 
-        if byte_order == 'little':
-            ret_val = struct.unpack('<%df' % (len(data) / 4), data)
-        elif byte_order == 'big':
-            ret_val = struct.unpack('>%df' % (len(data) / 4), data)
-        else:
-            raise ValueError(f'Unsupported byte order ({byte_order})!')
 
-        if len(ret_val) == 1:
-            return ret_val[0]
-        else:
-            return list(ret_val)
+# -------------------------------------------------------------------------------------------------
+# value formats of GDB/MI results: hex values, optionally prefixed with @ (C++ references) and followed by the symbol
+# ('0x0304 <func_name>') or string ('0x65 "abc"') pointed to; chars ("2 '\\002'") and decimal integers
+_CAST_BOOL = {'true': True, 'false': False}
+_CAST_HEX_RE = re.compile(r'@?0x([0-9a-fA-F]+)(?: <.*>| ".*")?$', re.DOTALL)
+_CAST_CHAR_RE = re.compile(r"(-?[0-9]+) '.*'$", re.DOTALL)
+_CAST_INT_RE = re.compile(r'-?[0-9]+$')
 
 
-# -------------------------------------------------------------------------------------------------
 def cast_str(data: Union[str, bytes]) -> Union[int, float, bool, str]:
     """
     This function attempts to 'smart-cast' data (received from GDB) as string into Python int, float, bool or, if
-    other conversion fail, str types.
+    other conversion fail, str types. The value has to match one of GDB's value formats as a whole, i.e., strings or
+    aggregates containing, e.g., 'true' or a number are returned as str.
     Args:
         data: Data string to the interpreted/casted.
 
@@ -316,61 +319,240 @@ def cast_str(data: Union[str, bytes]) -> Union[int, float, bool, str]:
     if type(data) == bytes:
         data = data.decode('ascii')
 
-    # single chars are returned by MI in a format like this: "2 '\\002'"
-    # if this format is detected, it is split up such that an int is returned
-    if " '" in str(data):
-        data = str(data).split(" '")[0]
-
-    if 'false' in str(data).lower():
-        return False
-    elif 'true' in str(data).lower():
-        return True
-
+    ret_val = _CAST_BOOL.get(data)
+    if ret_val is not None:
+        return ret_val
+    if _CAST_INT_RE.match(data) is not None:
+        return int(data)
+    m = _CAST_HEX_RE.match(data)
+    if m is not None:
+        return int(m.group(1), 16)
+    m = _CAST_CHAR_RE.match(data)
+    if m is not None:
+        return int(m.group(1))
     try:
-        if data.startswith('@0x'):
-            # GDB returns CPP references (e.g., "MyFoo& GetInstance();" ) as @0xAABBCCDD). Stripping the leading @ here.
-            data = data.lstrip('@')
-
-        if data.startswith('0x'):
-            tmp = data
-            if ' <' in tmp:
-                # function pointers typically are return in this format '0x0304 <func_name>'
-                tmp = tmp.split(' <')[0]
-            elif ' "' in tmp:
-                # character pointers (char* and sometimes uint8_t*) are return in this format '0x65 ""'
-                tmp = tmp.split(' "')[0]
-            return int(tmp, 16)
-    except Exception:
-        # if the data is not just a 'pure' hex value (e.g., more (string) data after the hex value)
-        pass
-
-    for fn in (int, float):
-        try:
-            return fn(data)
-        except ValueError:
-            pass
-        except TypeError:
-            pass
-    return data  # return as string
+        return float(data)
+    except ValueError:
+        return data  # return as string
 
 
 # -------------------------------------------------------------------------------------------------
 class BlockingDict(object):
-    def __init__(self):
+    """
+    Thread-safe dictionary where pop blocks until an item with the requested key is available. Each key that is waited
+    for has its own condition variable such that a put only wakes up the thread(s) waiting for this very key.
+    """
+    # maximum number of orphaned keys which are remembered (see discard_orphans); the oldest ones are forgotten first
+    # since their items are the least likely to still arrive
+    MAX_ORPHANED_KEYS = 1024
+
+    def __init__(self, discard_orphans: bool = False):
+        """
+        Constructor.
+
+        Args:
+            discard_orphans: If True, items which arrive after their waiter has timed out are discarded instead of
+                             being stored forever. Only use this if keys are unique (e.g., MI tokens).
+        """
         self._items = {}
-        self._cv = threading.Condition()
+        self._lock = threading.Lock()
+        self._waiters = {}  # key -> [condition variable, number of waiting threads]
+        self._discard_orphans: bool = discard_orphans
+        self._orphaned_keys: collections.OrderedDict = collections.OrderedDict()  # keys in order of orphaning
+        self._async_waiters = {}  # key -> (event loop, future)
+        self._abort_ex: Exception = None  # exception raised by all (current and future) waiters (see abort)
+
+    @staticmethod
+    def _set_future_result(fut: asyncio.Future, value) -> None:
+        if not fut.done():
+            fut.set_result(value)
+
+    @staticmethod
+    def _set_exception(fut: asyncio.Future, ex: Exception) -> None:
+        if not fut.done():
+            fut.set_exception(ex)
+
+    def _add_orphan(self, key) -> None:
+        # note: the lock is held by the caller
+        self._orphaned_keys[key] = None
+        self._orphaned_keys.move_to_end(key)
+        if len(self._orphaned_keys) > BlockingDict.MAX_ORPHANED_KEYS:
+            self._orphaned_keys.popitem(last=False)
 
     def put(self, key, value):
-        with self._cv:
+        with self._lock:
+            if key in self._orphaned_keys:
+                # waiter for this item has already given up
+                del self._orphaned_keys[key]
+                return
+            if key in self._async_waiters:
+                # hand the item over to the asyncio waiter (executed in the context of the waiter's event loop)
+                loop, fut = self._async_waiters.pop(key)
+                loop.call_soon_threadsafe(BlockingDict._set_future_result, fut, value)
+                return
             self._items[key] = value
-            self._cv.notify_all()
+            if key in self._waiters:
+                self._waiters[key][0].notify_all()
+
+    def pop(self, key, timeout: float = None):
+        with self._lock:
+            if key in self._items:
+                return self._items.pop(key)
+            if self._abort_ex is not None:
+                raise self._abort_ex
+
+            if key not in self._waiters:
+                self._waiters[key] = [threading.Condition(self._lock), 0]
+            waiter = self._waiters[key]
+            waiter[1] += 1
+            try:
+                end_time = None if timeout is None else time.monotonic() + timeout
+                while key not in self._items:
+                    if self._abort_ex is not None:
+                        raise self._abort_ex
+                    remaining = None if end_time is None else end_time - time.monotonic()
+                    if remaining is not None and remaining <= 0:
+                        # timeout hit
+                        if self._discard_orphans:
+                            self._add_orphan(key)
+                        raise TimeoutError
+                    waiter[0].wait(remaining)
+
+                return self._items.pop(key)
+            finally:
+                waiter[1] -= 1
+                if waiter[1] == 0:
+                    self._waiters.pop(key)
+
+    def orphan(self, key) -> None:
+        """
+        Gives up on the item with the given key without waiting for it: an item which is already available is removed
+        and, if discard_orphans is set, an item which arrives later is discarded.
+        """
+        with self._lock:
+            if key in self._items:
+                del self._items[key]
+            elif self._discard_orphans:
+                self._add_orphan(key)
+
+    def forget(self, key) -> None:
+        """
+        Removes any state of the given key (an available item and the orphan mark) before the key is reused.
+        """
+        with self._lock:
+            self._items.pop(key, None)
+            self._orphaned_keys.pop(key, None)
 
-    def pop(self, key, timeout: float =None):
-        with self._cv:
-            while key not in self._items:
-                new_item = self._cv.wait(timeout)
-                if not new_item:
-                    # timeout hit
-                    raise TimeoutError
+    def pop_async(self, key, loop: asyncio.AbstractEventLoop) -> asyncio.Future:
+        """
+        Asyncio variant of pop. Returns a future (bound to the given event loop) which is completed with the item
+        once it is available. No thread is blocked while waiting for the item.
+        """
+        fut = loop.create_future()
+        with self._lock:
+            if key in self._items:
+                fut.set_result(self._items.pop(key))
+            elif self._abort_ex is not None:
+                fut.set_exception(self._abort_ex)
+            else:
+                self._async_waiters[key] = (loop, fut)
+        return fut
+
+    def cancel_async(self, key) -> None:
+        """
+        Removes the asyncio waiter for the given key (e.g., after a timeout).
+        """
+        with self._lock:
+            if self._async_waiters.pop(key, None) is not None and self._discard_orphans:
+                self._add_orphan(key)
+
+    def abort(self, ex: Exception) -> None:
+        """
+        Wakes up all waiters and makes them (and all future waiters of items which are not available) raise the given
+        exception instead of waiting (e.g., once the producer of the items is known to be gone).
+        """
+        with self._lock:
+            self._abort_ex = ex
+            for waiter in self._waiters.values():
+                waiter[0].notify_all()
+            for loop, fut in self._async_waiters.values():
+                loop.call_soon_threadsafe(BlockingDict._set_exception, fut, ex)
+            self._async_waiters = {}
+
+
+# -------------------------------------------------------------------------------------------------
+class MessageRing(object):
+    """
+    Thread-safe ring buffer of the most recent messages (e.g., GDB notifications or console output), each stored with a
+    sequence number, a timestamp (time.time) and a key. Once the capacity is reached, the oldest messages are dropped,
+    i.e., memory consumption is bounded for arbitrarily long sessions. Messages can additionally be streamed to a file
+    (see stream_to) such that nothing is lost.
+    """
+    def __init__(self, capacity: int) -> None:
+        self._lock = threading.Lock()
+        self._items: Deque[Tuple[int, float, Any, Any]] = collections.deque(maxlen=capacity)
+        self._seq: int = 0
+        self._file = None
+
+    @property
+    def seq(self) -> int:
+        """
+        Sequence number of the next message (i.e., number of messages put so far).
+        """
+        return self._seq
+
+    @property
+    def dropped(self) -> int:
+        """
+        Number of (old) messages which have been dropped from the ring buffer.
+        """
+        with self._lock:
+            return self._seq - len(self._items)
+
+    def put(self, key, msg, text: str = None) -> None:
+        """
+        Adds a message. If given, text is written to the stream file (if any).
+        """
+        now = time.time()
+        with self._lock:
+            self._items.append((self._seq, now, key, msg))
+            self._seq += 1
+            if self._file is not None and text is not None:
+                self._file.write(f'{now:.6f} {text}\n')
+
+    def query(self, key=None, since: int = 0, match: Callable[[Any], bool] = None) -> List[Tuple[int, float, Any, Any]]:
+        """
+        Returns the buffered messages (as tuples of sequence number, timestamp, key and message; oldest first).
 
-            return self._items.pop(key)
+        Args:
+            key: Only return messages with this key (e.g., ('stopped', 'breakpoint-hit') for notifications).
+            since: Only return messages with a sequence number of at least since (e.g., a previously read seq).
+            match: Only return messages for which this function returns True.
+        """
+        with self._lock:
+            items = list(self._items)
+        return [item for item in items if item[0] >= since and (key is None or item[2] == key) and
+                (match is None or match(item[3]))]
+
+    def last(self, key=None):
+        """
+        Returns the most recent message (with the given key) or None.
+        """
+        with self._lock:
+            for item in reversed(self._items):
+                if key is None or item[2] == key:
+                    return item[3]
+        return None
+
+    def clear(self) -> None:
+        with self._lock:
+            self._items.clear()
+
+    def stream_to(self, file_name: Union[str, None]) -> None:
+        """
+        Appends the text of all further messages to the given file (or stops streaming if file_name is None).
+        """
+        with self._lock:
+            if self._file is not None:
+                self._file.close()
+            self._file = open(file_name, 'a', buffering=1) if file_name is not None else None
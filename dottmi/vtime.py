@@ -0,0 +1,125 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+from typing import List, Tuple, Union
+
+from dottmi.dott import dott
+from dottmi.dottexceptions import DottException
+
+# SysTick control and status register and interrupt control and state register (Cortex-M system control space)
+_SYST_CSR = 0xE000E010
+_SYST_CSR_ENABLE = 0x1
+_ICSR = 0xE000ED04
+_ICSR_PENDSTCLR = 1 << 25
+
+# counter enable bit of the CR1 register of STM32 timers (TIMx_CR1 is located at the base address of the timer)
+_TIM_CR1_CEN = 0x1
+
+
+# -------------------------------------------------------------------------------------------------
+class VirtualTime(object):
+    """
+    Virtual time for firmware driven by SysTick (and optionally by timers). freeze stops the SysTick counter (and
+    the given timers) such that time only advances if requested. advance(n) then runs the tick handlers n times on
+    the halted target via the on-target call driver (see Target.sweep), i.e., thousands of ticks cost a few round
+    trips instead of n times the tick period of wall-clock time. thaw restores the original configuration. For
+    example:
+        with VirtualTime() as vt:  # freezes SysTick; SysTick_Handler is run per tick
+            vt.advance(1000)
+            assert 1000 == dt.eval('_tick_cnt')
+    Timer ticks are run by calling the timer's period callback, e.g.,
+        VirtualTime(handlers=[('SysTick_Handler', ()), ('HAL_TIM_PeriodElapsedCallback', (htim7_addr,))],
+                    timers=[0x40001400])
+    Note: The handlers of one advance are run one after the other (all ticks of the first handler, then all ticks of
+    the second one, ...); use step to interleave them more finely. The target has to be halted.
+    """
+    def __init__(self, target: 'Target' = None, handlers: List[Tuple[str, Tuple]] = None,
+                 timers: List[int] = None) -> None:
+        self._target: 'Target' = target if target is not None else dott().target
+        self._handlers: List[Tuple[str, Tuple]] = handlers if handlers is not None else [('SysTick_Handler', ())]
+        self._timers: List[int] = timers if timers is not None else []
+        self._saved: List[Tuple[int, int]] = None  # (register address, original value) of the frozen counters
+        self._ticks: int = 0
+
+    @property
+    def ticks(self) -> int:
+        """
+        Number of ticks advanced since the time has been frozen.
+        """
+        return self._ticks
+
+    @property
+    def frozen(self) -> bool:
+        return self._saved is not None
+
+    def _reg(self, addr: int, val: int = None) -> Union[int, None]:
+        expr = f'*(unsigned int *){addr:#x}'
+        if val is None:
+            return int(self._target.eval(expr)) & 0xffffffff
+        self._target.eval(f'{expr} = {val:#x}')
+        return None
+
+    def freeze(self) -> None:
+        """
+        Stops the SysTick counter and the configured timers and discards a pending SysTick exception.
+        """
+        if self.frozen:
+            return
+        self._saved = [(addr, self._reg(addr)) for addr in [_SYST_CSR] + self._timers]
+        for addr, val in self._saved:
+            self._reg(addr, val & ~(_SYST_CSR_ENABLE if addr == _SYST_CSR else _TIM_CR1_CEN))
+        self._reg(_ICSR, _ICSR_PENDSTCLR)
+        self._ticks = 0
+
+    def advance(self, ticks: int, step: int = None) -> None:
+        """
+        Advances the virtual time by the given number of ticks.
+
+        Args:
+            ticks: Number of ticks.
+            step: Number of ticks each handler is run before the next handler is run (default: all ticks at once).
+        """
+        if not self.frozen:
+            raise DottException('Virtual time has to be frozen before it can be advanced.')
+        step = ticks if step is None else max(1, step)
+        done = 0
+        while done < ticks:
+            num = min(step, ticks - done)
+            for func, args in self._handlers:
+                self._target.sweep(func, [tuple(args)] * num)
+            done += num
+        self._ticks += ticks
+
+    def thaw(self) -> None:
+        """
+        Restores the original configuration of SysTick and the timers (i.e., real time continues).
+        """
+        if not self.frozen:
+            return
+        for addr, val in self._saved:
+            self._reg(addr, val)
+        self._saved = None
+
+    def __enter__(self) -> 'VirtualTime':
+        self.freeze()
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.thaw()
@@ -0,0 +1,287 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Live variable watch service. The service samples a set of target variables via TargetDirect (see
+# TargetDirect.sample) at a fixed rate and publishes the samples on a local TCP port. Any number of viewers (e.g.,
+# the console/plot viewer of this module or custom dashboards) can subscribe. Viewers never slow down the sampling:
+# the samples are acquired by the sampler thread into a ring buffer and are forwarded to the viewers by a separate
+# publisher thread in batches. Viewers which do not keep up are disconnected.
+#
+# Protocol: newline-delimited JSON. After connecting, a viewer receives a header message
+#   {"type": "header", "names": [...], "addrs": [...], "rate": <Hz or null>}
+# followed by sample batches
+#   {"type": "samples", "t": [<host time in s>, ...], "v": [[<value of names[0]>, ...], ...]}
+#
+# Viewer usage: python -m dottmi.watch [--host <host>] [--port <port>] [--plot]
+
+import argparse
+import json
+import socket
+import threading
+import time
+from typing import Dict, Iterator, List, Tuple, Union
+
+from dottmi.dottexceptions import DottException
+from dottmi.utils import log
+
+
+# -------------------------------------------------------------------------------------------------
+class WatchService(object):
+    # default TCP port the service listens on
+    DEFAULT_PORT = 20091
+
+    # interval (in seconds) in which new samples are forwarded to the viewers
+    PUBLISH_INTERVAL = 0.05
+
+    # viewers which do not accept a sample batch within this time (in seconds) are disconnected
+    SEND_TIMEOUT = 1.0
+
+    def __init__(self, live, variables: Union[List[str], Dict[str, int]], rate: float = 100.0,
+                 port: int = DEFAULT_PORT, addr: str = '127.0.0.1', symbols=None, capacity: int = 100000) -> None:
+        """
+        Constructor.
+
+        Args:
+            live: TargetDirect instance used to sample the target.
+            variables: Names of the (32bit) variables to be watched, resolved via the given symbol index, or a
+                       dictionary which maps names to target addresses.
+            rate: Sampling rate in Hz. If None, the target is sampled as fast as possible.
+            port: TCP port viewers connect to. If 0, a free port is chosen (see port property).
+            addr: Address the service binds to.
+            symbols: Symbol index (e.g., dott().target.symbols) used to resolve variable names.
+            capacity: Size of the sample ring buffer.
+        """
+        if isinstance(variables, dict):
+            self._names: List[str] = list(variables.keys())
+            self._addrs: List[int] = list(variables.values())
+        else:
+            if symbols is None:
+                raise DottException('A symbol index is required to resolve the watched variable names.')
+            self._names = list(variables)
+            self._addrs = [symbols.addr(name) for name in self._names]
+        self._live = live
+        self._rate: float = rate
+        self._addr: str = addr
+        self._port: int = port
+        self._capacity: int = capacity
+        self._samples = None
+        self._srv: socket.socket = None
+        self._viewers: List[socket.socket] = []
+        self._viewers_lock: threading.Lock = threading.Lock()
+        self._running: bool = False
+        self._threads: List[threading.Thread] = []
+
+    @property
+    def port(self) -> int:
+        return self._port
+
+    @property
+    def names(self) -> List[str]:
+        return self._names
+
+    @property
+    def samples(self):
+        """
+        Samples acquired so far (see TargetDirectSamples) or None if the service has not been started.
+        """
+        return self._samples
+
+    @property
+    def num_viewers(self) -> int:
+        with self._viewers_lock:
+            return len(self._viewers)
+
+    def _header(self) -> bytes:
+        return (json.dumps({'type': 'header', 'names': self._names, 'addrs': self._addrs, 'rate': self._rate}) +
+                '\n').encode()
+
+    def start(self) -> None:
+        """
+        Opens the listening socket and starts sampling the target (which is expected to be running).
+        """
+        if self._running:
+            return
+        self._srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self._srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._srv.bind((self._addr, self._port))
+        self._srv.listen()
+        self._srv.settimeout(0.1)  # allows the accept loop to check for stop
+        self._port = self._srv.getsockname()[1]
+
+        self._samples = self._live.sample(self._addrs, rate=self._rate, duration=None, capacity=self._capacity,
+                                          block=False)
+        self._running = True
+        self._threads = [threading.Thread(target=self._accept_loop, name='WatchServiceAccept', daemon=True),
+                         threading.Thread(target=self._publish_loop, name='WatchServicePublish', daemon=True)]
+        for thread in self._threads:
+            thread.start()
+        log.debug(f'Watch service for {", ".join(self._names)} listening on {self._addr}:{self._port}.')
+
+    def stop(self) -> None:
+        """
+        Stops the sampling and disconnects all viewers. The samples acquired so far remain available (see samples).
+        """
+        if not self._running:
+            return
+        self._running = False
+        for thread in self._threads:
+            thread.join()
+        self._samples.stop()
+        self._srv.close()
+        with self._viewers_lock:
+            for conn in self._viewers:
+                conn.close()
+            self._viewers = []
+
+    def _accept_loop(self) -> None:
+        while self._running:
+            try:
+                conn, _ = self._srv.accept()
+            except socket.timeout:
+                continue
+            except OSError:
+                return
+            try:
+                conn.settimeout(WatchService.SEND_TIMEOUT)
+                conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                conn.sendall(self._header())
+            except OSError:
+                conn.close()
+                continue
+            with self._viewers_lock:
+                self._viewers.append(conn)
+
+    def _publish_loop(self) -> None:
+        count = 0
+        while self._running:
+            time.sleep(WatchService.PUBLISH_INTERVAL)
+            count, new = self._samples.since(count)
+            with self._viewers_lock:
+                if len(new) == 0 or len(self._viewers) == 0:
+                    continue
+                msg = (json.dumps({'type': 'samples', 't': [t for t, _ in new], 'v': [v for _, v in new]}) +
+                       '\n').encode()
+                for conn in list(self._viewers):
+                    try:
+                        conn.sendall(msg)
+                    except OSError:  # viewer disconnected or too slow
+                        conn.close()
+                        self._viewers.remove(conn)
+
+    def __enter__(self) -> 'WatchService':
+        self.start()
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.stop()
+
+
+# -------------------------------------------------------------------------------------------------
+class WatchClient(object):
+    """
+    Viewer-side connection to a WatchService.
+    """
+    def __init__(self, host: str = '127.0.0.1', port: int = WatchService.DEFAULT_PORT, timeout: float = None) -> None:
+        self._sock: socket.socket = socket.create_connection((host, port), timeout=timeout)
+        self._file = self._sock.makefile('r')
+        header = self._read()
+        if header is None or header.get('type') != 'header':
+            raise DottException(f'No watch service header received from {host}:{port}.')
+        self._names: List[str] = header['names']
+        self._rate: float = header['rate']
+
+    def _read(self) -> Dict:
+        line = self._file.readline()
+        return json.loads(line) if line else None
+
+    @property
+    def names(self) -> List[str]:
+        return self._names
+
+    @property
+    def rate(self) -> float:
+        return self._rate
+
+    def batches(self) -> Iterator[Tuple[List[float], List[List[int]]]]:
+        """
+        Yields the sample batches published by the service as (timestamps, values) until the service disconnects.
+        Each entry of values holds the values of all watched variables (in the order of names).
+        """
+        while True:
+            msg = self._read()
+            if msg is None:
+                return
+            if msg.get('type') == 'samples':
+                yield msg['t'], msg['v']
+
+    def samples(self) -> Iterator[Tuple[float, Dict[str, int]]]:
+        """
+        Yields the published samples one by one as (timestamp, {name: value}).
+        """
+        for times, values in self.batches():
+            for t, v in zip(times, values):
+                yield t, dict(zip(self._names, v))
+
+    def close(self) -> None:
+        self._file.close()
+        self._sock.close()
+
+    def __enter__(self) -> 'WatchClient':
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.close()
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Viewer for the DOTT live variable watch service.')
+    parser.add_argument('--host', default='127.0.0.1', help='host the watch service runs on')
+    parser.add_argument('--port', type=int, default=WatchService.DEFAULT_PORT, help='TCP port of the watch service')
+    parser.add_argument('--plot', action='store_true', help='plot the samples (requires matplotlib)')
+    parser.add_argument('--window', type=float, default=10.0, help='time window (in seconds) shown by the plot')
+    args = parser.parse_args()
+
+    with WatchClient(args.host, args.port) as client:
+        if not args.plot:
+            print('time\t' + '\t'.join(client.names))
+            for times, values in client.batches():
+                for t, v in zip(times, values):
+                    print(f'{t:.4f}\t' + '\t'.join(str(x) for x in v))
+            return
+
+        from matplotlib import pyplot  # note: matplotlib is only required for plotting
+        times_all: List[float] = []
+        values_all: List[List[int]] = []
+        for times, values in client.batches():  # one redraw per batch (not per sample)
+            times_all.extend(times)
+            values_all.extend(values)
+            while len(times_all) > 0 and times_all[0] < times_all[-1] - args.window:
+                del times_all[0]
+                del values_all[0]
+            pyplot.clf()
+            for idx, name in enumerate(client.names):
+                pyplot.plot(times_all, [v[idx] for v in values_all], label=name)
+            pyplot.xlabel('host runtime')
+            pyplot.legend(loc='upper left')
+            pyplot.pause(0.001)
+
+
+if __name__ == '__main__':
+    main()
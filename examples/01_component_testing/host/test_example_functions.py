@@ -17,10 +17,13 @@
 
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
+import pytest
+
 from dottmi.target_mem import TypedPtr
 from dottmi.utils import DottConvert
 from dottmi.dott import DottConf, dott
 from dottmi.breakpoint import HaltPoint, InterceptPoint, InterceptPointCmds
+from dottmi.fuzz import Fuzzer
 
 class TestExampleFunctions(object):
 
@@ -57,6 +60,58 @@ class TestExampleFunctions(object):
         res = dott().target.eval('example_Addition(31, 11)')
         assert(42 == res)
 
+    ##
+    # \amsTestDesc Test function calls via the resident call stub.
+    # \amsTestPrec None
+    # \amsTestImpl Call target function which takes two arguments using Target.call (within a call session).
+    # \amsTestResp Return values should be the sum of the two provided arguments.
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230, RS_0240, RS_0270
+    def test_example_Addition_CallStub(self, target_load, target_reset):
+        assert(42 == dott().target.call('example_Addition', 31, 11))
+        with dott().target.call_session():
+            for a in range(10):
+                assert(a + 11 == dott().target.call('example_Addition', a, 11))
+
+    ##
+    # \amsTestDesc Test function call sweep over an argument table.
+    # \amsTestPrec None
+    # \amsTestImpl Call target function which takes two arguments for all combinations of the arguments using
+    #              Target.sweep.
+    # \amsTestResp Return values should be the sum of the two provided arguments.
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230, RS_0240, RS_0270
+    def test_example_Addition_Sweep(self, target_load, target_reset):
+        args = [(a, b) for a in range(-20, 20) for b in range(0, 100, 7)]
+        res = dott().target.sweep('example_Addition', args, signed=True)
+        assert([a + b for a, b in args] == res)
+
+    ##
+    # \amsTestDesc Test on-target benchmarking of a function.
+    # \amsTestPrec None
+    # \amsTestImpl Benchmark target function which takes two arguments using the target_bench fixture.
+    # \amsTestResp Cycle counts shall be reported for all iterations and shall be consistent.
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230, RS_0240, RS_0270
+    def test_example_Addition_Bench(self, target_load, target_reset, target_bench):
+        res = target_bench('example_Addition', 31, 11, iterations=50)
+        assert(50 == len(res.cycles))
+        assert(res.min <= res.median <= res.p99 <= res.max)
+
+    ##
+    # \amsTestDesc Test per-test performance budgets.
+    # \amsTestPrec None
+    # \amsTestImpl Call target function for an argument table using Target.sweep in a test with a stack and a wall
+    #              time budget (dott_budget marker; the example's Cortex-M0 has no DWT cycle counter).
+    # \amsTestResp Return values should be the sum of the two provided arguments and the test shall stay within its
+    #              budgets.
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230, RS_0240, RS_0270
+    @pytest.mark.dott_budget(stack=256, wall_ms=2000)
+    def test_example_Addition_Budget(self, target_load, target_reset):
+        args = [(a, 11) for a in range(100)]
+        assert([a + 11 for a, _ in args] == dott().target.sweep('example_Addition', args))
+
     ##
     # \amsTestDesc Test function call with two pointer arguments.
     # \amsTestPrec None
@@ -169,6 +224,42 @@ class TestExampleFunctions(object):
         res = dt.eval(f'example_AdditionStruct(*{p_dat})')
         assert(77 == res), 'Unexpected return value'
 
+    ##
+    # \amsTestDesc Test function call with a struct as argument. The struct members are set up using a single,
+    #              pipelined eval_many call instead of individual eval calls.
+    # \amsTestPrec None
+    # \amsTestImpl Call target function with a struct argument. Allocate on-target memory for the struct.
+    # \amsTestResp Return value should be the sum of the two provided arguments.
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230, RS_0240, RS_0260, RS_0270
+    def test_example_AdditionStruct_EvalMany(self, target_load, target_reset):
+        dt = dott().target
+        p_dat = dt.mem.alloc_type('my_add_t')
+        dt.eval_many([f'{p_dat}->a = 55', f'{p_dat}->b = 22', f'{p_dat}->sum = 0'])
+        a, b, res = dt.eval_many([f'{p_dat}->a', f'{p_dat}->b', f'example_AdditionStruct(*{p_dat})'])
+        assert(55 == a), 'Unexpected struct member value'
+        assert(22 == b), 'Unexpected struct member value'
+        assert(77 == res), 'Unexpected return value'
+
+    ##
+    # \amsTestDesc Test function call with a struct as argument. The struct is marshalled from a Python dict using
+    #              the struct layout reported by GDB and is written with a single memory transfer.
+    # \amsTestPrec None
+    # \amsTestImpl Allocate on-target memory for the struct and initialize it from a dict. Call the target function
+    #              with the struct argument and read back the struct as dict.
+    # \amsTestResp Return value should be the sum of the two provided arguments.
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230, RS_0240, RS_0260, RS_0270
+    def test_example_AdditionStruct_Layout(self, target_load, target_reset):
+        dt = dott().target
+        p_dat = dt.mem.alloc_type('my_add_t', val={'a': 55, 'b': 22, 'sum': 0})
+        res = dt.eval(f'example_AdditionStruct(*{p_dat})')
+        assert(77 == res), 'Unexpected return value'
+
+        dt.mem.write_struct(p_dat, 'my_add_t', {'b': 11})
+        dat = dt.mem.read_struct(p_dat, 'my_add_t')
+        assert(55 == dat['a'] and 11 == dat['b']), f'Unexpected struct content: {dat}'
+
     ##
     # \amsTestDesc Test ctypes-based declaration and initialization of target struct. The target struct is replicated
     #              on the host using ctypes and then bulk-copied to the target using mem write. This significantly
@@ -290,6 +381,21 @@ class TestExampleFunctions(object):
         res = dott().target.eval(f'example_StringLen({addr})')
         assert(len(msg) - 1 == res), f'expected: {len(msg)}, is: {res}'
 
+    ##
+    # \amsTestDesc Test coverage-guided on-target fuzzing of a function.
+    # \amsTestPrec None
+    # \amsTestImpl Fuzz the target function which takes a string as argument with random (zero-terminated) inputs.
+    # \amsTestResp All inputs shall be processed without faults or hangs and the return values shall match the
+    #              length of the strings.
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230, RS_0240, RS_0270
+    def test_example_StringLen_Fuzz(self, target_load, target_reset):
+        with Fuzzer(dott().target, 'example_StringLen', args=('data',), max_len=32, seeds=[b'Sensing is life.'],
+                    terminate=True, check=lambda data, res: res == len(data.split(b'\0')[0]), rng_seed=42) as fuzz:
+            report = fuzz.run(execs=2000)
+        assert(2000 == report.execs)
+        assert(0 == len(report.findings)), str(report)
+
     ##
     # \amsTestDesc Test function which takes an integer array as argument and returns the sum of the elements.
     # \amsTestPrec None
@@ -318,6 +424,14 @@ class TestExampleFunctions(object):
         res = dt.eval(f'example_SumElements({p}, {len(elements)})')
         assert (sum(elements) == res), f'expected: {sum(elements)}, is: {res}'
 
+        # slices are transferred with a single memory access
+        elements = [10, 20, 30, 40, 50]
+        p[0:len(elements)] = elements
+        assert (p[0:len(elements)] == elements), f'expected: {elements}, is: {p[0:len(elements)]}'
+
+        res = dt.eval(f'example_SumElements({p}, {len(elements)})')
+        assert (sum(elements) == res), f'expected: {sum(elements)}, is: {res}'
+
     ##
     # \amsTestDesc Test function itself calls two sub functions, adds the results of the sub functions and returns this
     #              result.
@@ -0,0 +1,152 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Command throughput load bench for the command dispatcher of example_cmd.c. Add commands are written via I2C at a
+# given offered rate while the target keeps running. Two trace points record (GDB-side, without a round trip to DOTT)
+# the timestamp of every command read (I2C_READ_DONE) and completion (CMD_ADD_EXIT, together with operand a which
+# identifies the command). From these, the achieved throughput, the end-to-end latency (I2C write until completion)
+# and the on-target processing time (read until completion) are determined per load step:
+#
+#   bench = CmdLoadBench(i2c_comm)
+#   dott().target.cont()
+#   steps = bench.sweep([50, 100, 200, None], num=200)  # None: back-to-back writes
+#   log.info(CmdLoadBench.curve_str(steps))
+#
+# Note: The end-to-end latency requires GDB to run on the same host as DOTT (both timestamps are taken with
+# time.time()). Commands which the target does not accept (I2C NACK since the previous command is still processed)
+# are counted as rejected.
+
+import time
+from typing import List, NamedTuple
+
+from dottmi.breakpoint import TracePoint
+from dottmi.utils import DOTT_LABEL, DottConvert, log
+
+CMD_ID_ADD = 0x10
+CMD_ADD_OPERAND_B = 12345678
+
+
+class LoadStep(NamedTuple):
+    offered_rate: float  # commands per second written by the host (None: back-to-back)
+    sent: int
+    rejected: int  # writes failed on the I2C bus
+    processed: int  # commands completed by the target
+    wrong: int  # commands completed with a wrong result
+    throughput: float  # completed commands per second
+    latency: List[float]  # end-to-end latency (seconds) of the completed commands
+    processing: List[float]  # on-target processing time (seconds) of the completed commands
+
+    @staticmethod
+    def _percentile(values: List[float], pct: float) -> float:
+        if len(values) == 0:
+            return 0.0
+        values = sorted(values)
+        return values[min(len(values) - 1, int(round(pct / 100.0 * (len(values) - 1))))]
+
+    def latency_pct(self, pct: float) -> float:
+        return LoadStep._percentile(self.latency, pct)
+
+    def processing_pct(self, pct: float) -> float:
+        return LoadStep._percentile(self.processing, pct)
+
+
+class CmdLoadBench(object):
+    """
+    Load bench driving sustained add command traffic to the example_cmd firmware (see module description).
+    """
+    def __init__(self, comm: 'CommDev', buffer_size: int = 4096) -> None:
+        self._comm: 'CommDev' = comm
+        self._tp_read: TracePoint = TracePoint(DOTT_LABEL('I2C_READ_DONE'), buffer_size=buffer_size)
+        self._tp_done: TracePoint = TracePoint(DOTT_LABEL('CMD_ADD_EXIT'), ['a', 'sum'], buffer_size=buffer_size)
+        self._next_a: int = 1
+
+    def run_step(self, rate: float = None, num: int = 100, timeout: float = 10.0) -> LoadStep:
+        """
+        Writes num add commands at the given rate (commands per second; None: back-to-back) to the running target and
+        waits (at most timeout seconds) until all accepted commands have been completed.
+        """
+        self._tp_read.drain()
+        self._tp_done.drain()
+        sent_times = {}
+        rejected = 0
+        start = time.time()
+        for i in range(num):
+            if rate is not None:
+                delay = start + i / rate - time.time()
+                if delay > 0:
+                    time.sleep(delay)
+            a = self._next_a
+            self._next_a = (self._next_a + 1) & 0x7fffffff
+            data = [CMD_ID_ADD, *DottConvert.uint32_to_bytes(a), *DottConvert.uint32_to_bytes(CMD_ADD_OPERAND_B)]
+            t = time.time()
+            try:
+                self._comm.pi.i2c_write_device(self._comm.dev, data)
+                sent_times[a] = t
+            except Exception:
+                rejected += 1
+
+        deadline = time.time() + timeout
+        while self._tp_done.get_hits() < len(sent_times) and time.time() < deadline:
+            time.sleep(.05)
+
+        reads = [ts for _, ts, _ in self._tp_read.drain()]
+        done = self._tp_done.drain()
+        latency, processing, wrong = [], [], 0
+        for (_, ts, (a, res)), ts_read in zip(done, reads):
+            if a not in sent_times:
+                continue  # completion of a command of a previous step
+            if res != (a + CMD_ADD_OPERAND_B) & 0xffffffff:
+                wrong += 1
+            latency.append(ts - sent_times[a])
+            processing.append(ts - ts_read)
+        done_times = [ts for _, ts, (a, _) in done if a in sent_times]
+        throughput = (len(done_times) - 1) / (done_times[-1] - done_times[0]) if len(done_times) > 1 else 0.0
+        step = LoadStep(rate, num, rejected, len(latency), wrong, throughput, latency, processing)
+        log.debug(f'Load step {rate}: {step.processed}/{num} processed, {throughput:.1f} commands/s')
+        return step
+
+    def sweep(self, rates: List[float], num: int = 100, timeout: float = 10.0) -> List[LoadStep]:
+        """
+        Runs one load step per offered rate and returns the steps (throughput curve).
+        """
+        return [self.run_step(rate, num, timeout) for rate in rates]
+
+    @staticmethod
+    def curve_str(steps: List[LoadStep]) -> str:
+        lines = [f'  {"offered/s":>10}{"sent":>7}{"rej":>6}{"done":>7}{"cmds/s":>10}{"lat p50":>10}{"lat p95":>10}'
+                 f'{"lat max":>10}{"proc p50":>10}   (latencies in ms)']
+        for s in steps:
+            offered = f'{s.offered_rate:.0f}' if s.offered_rate is not None else 'max'
+            lines.append(f'  {offered:>10}{s.sent:>7}{s.rejected:>6}{s.processed:>7}{s.throughput:>10.1f}'
+                         f'{s.latency_pct(50) * 1e3:>10.2f}{s.latency_pct(95) * 1e3:>10.2f}'
+                         f'{s.latency_pct(100) * 1e3:>10.2f}{s.processing_pct(50) * 1e3:>10.2f}')
+        return '\n'.join(lines)
+
+    def save_csv(self, steps: List[LoadStep], file_name: str) -> None:
+        with open(file_name, 'w') as f:
+            f.write('offered_rate,sent,rejected,processed,wrong,throughput,lat_p50,lat_p95,lat_max,proc_p50\n')
+            for s in steps:
+                f.write(f'{s.offered_rate if s.offered_rate is not None else ""},{s.sent},{s.rejected},{s.processed},'
+                        f'{s.wrong},{s.throughput:.3f},{s.latency_pct(50):.6f},{s.latency_pct(95):.6f},'
+                        f'{s.latency_pct(100):.6f},{s.processing_pct(50):.6f}\n')
+
+    def delete(self) -> None:
+        self._tp_read.delete()
+        self._tp_done.delete()
@@ -0,0 +1,50 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+from dottmi.dott import dott
+from dottmi.utils import log
+
+from .cmd_load_bench import CmdLoadBench
+
+
+class TestCmdLoad(object):
+
+    ##
+    # \amsTestDesc This test measures the command throughput and latency of the command dispatcher under sustained
+    #              I2C command traffic at increasing offered rates.
+    # \amsTestPrec None
+    # \amsTestImpl Write add commands at several offered rates (and back-to-back) to the running target. Record the
+    #              read and completion of each command with trace points and compute throughput and latencies.
+    # \amsTestResp All completed commands shall have the correct result. Note: The throughput curve is reported
+    #              (and written to test_cmd_load.csv) for information.
+    # \amsTestType System
+    # \amsTestReqs RS_0220, RS_0110, RS_0400, RS_0410
+    def test_CmdThroughput(self, target_load, target_reset, i2c_comm):
+        bench = CmdLoadBench(i2c_comm)
+        dott().target.cont()
+        steps = bench.sweep([20, 50, 100, 200, None], num=100)
+        dott().target.halt()
+        bench.delete()
+
+        log.info('Command throughput:\n' + CmdLoadBench.curve_str(steps))
+        bench.save_csv(steps, 'test_cmd_load.csv')
+        for s in steps:
+            assert (s.wrong == 0), f'{s.wrong} commands with wrong result at offered rate {s.offered_rate}'
+        assert (steps[0].processed > 0), 'No command processed at the lowest offered rate'
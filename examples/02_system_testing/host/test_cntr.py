@@ -29,6 +29,7 @@ from dottmi.breakpoint import HaltPoint, InterceptPoint
 from dottmi.dott import dott
 from dottmi.pylinkdott import TargetDirect
 from dottmi.utils import DOTT_LABEL
+from dottmi.watch import WatchClient
 
 
 class TestCounters(object):
@@ -63,11 +64,12 @@ class TestCounters(object):
         assert (0 == cnt_last), 'Systick count shall initially be zero.'
         dott().target.cont()
 
-        for i in range(10):
-            time.sleep(.5)
-            cnt = live_access.mem_read_32(cnt_addr)
-            assert (cnt > cnt_last), 'Systick counter should have advanced'
-            cnt_last = cnt
+        with live_access.session():  # note: target run state is not changed while sampling
+            for i in range(10):
+                time.sleep(.5)
+                cnt = live_access.mem_read_32(cnt_addr)
+                assert (cnt > cnt_last), 'Systick counter should have advanced'
+                cnt_last = cnt
 
     ##
     # \amsTestDesc This test demonstrates to live-access the systick counter of the running target and plot the
@@ -101,6 +103,11 @@ class TestCounters(object):
         addr = dott().target.eval('&_tick_cnt')
         (host_time, msecs_samples) = sample_mem_addr(addr, 1.0, live_access, plot_live=False)
 
+        # alternatively, let DOTT's sampler (background thread, preallocated buffer) acquire the samples at a fixed rate
+        samples = live_access.sample([addr], rate=1000, duration=1.0)
+        assert (samples.count > 0), 'Sampler should have acquired samples'
+        assert (samples.values()[-1] >= samples.values()[0]), 'Systick counter should not decrease'
+
         dott().target.halt()
 
         # plot the data samples from the target
@@ -110,6 +117,26 @@ class TestCounters(object):
         pyplot.xlabel('host runtime')
         pyplot.savefig('test_systick_sample_live', dpi=200)
 
+    ##
+    # \amsTestDesc This test demonstrates to publish the systick counter of the running target via the live watch
+    #              service to which live viewers (e.g., python -m dottmi.watch --plot) can subscribe.
+    # \amsTestPrec None
+    # \amsTestImpl Let target boot, continue execution, publish the systick counter and subscribe to the service.
+    # \amsTestResp The viewer shall receive samples of the counter.
+    # \amsTestType System
+    # \amsTestReqs RS_0110, RS_0280
+    @pytest.mark.live_access
+    def test_SystickWatchLive(self, target_load, target_reset, live_watch):
+        dott().target.cont()
+
+        # viewers subscribe to the service without slowing down the sampling
+        watch = live_watch(['_tick_cnt'], rate=500, port=0)
+        with WatchClient(port=watch.port, timeout=5.0) as viewer:
+            _, values = next(viewer.batches())
+        watch.stop()
+        dott().target.halt()
+        assert (len(values) > 0), 'Watch service should have published samples'
+
     ##
     # \amsTestDesc This test checks if the timer counter for timer 7 (TIM7) advances.
     # \amsTestPrec None
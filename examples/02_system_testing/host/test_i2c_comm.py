@@ -18,9 +18,13 @@
 # Authors:
 # - Thomas Winkler, ams AG, thomas.winkler@ams.com
 
+import threading
+
+import pytest
+
 from dottmi.breakpoint import HaltPoint, InterceptPoint
 from dottmi.dott import dott
-from dottmi.utils import DOTT_LABEL, DottConvert
+from dottmi.utils import DOTT_LABEL, DottConvert, log
 
 
 class TestI2cCommunication(object):
@@ -77,6 +81,28 @@ class TestI2cCommunication(object):
         sum = dott().target.eval('sum')
         assert ((a + b) == sum), 'sum does not match expected value'
 
+    ##
+    # \amsTestDesc This test sends a sequence of add commands to the target via I2C without halting the target and
+    #              checks the results of all of them.
+    # \amsTestPrec None
+    # \amsTestImpl Queue the add commands in an asynchronous stimulus queue. The target keeps running and acknowledges
+    #              each processed command at a defined location (intercept point) where the result is read.
+    # \amsTestResp All addition results shall match the expected ones.
+    # \amsTestType System
+    # \amsTestReqs RS_0220, RS_0110, RS_0400, RS_0410
+    def test_CmdAddStream(self, target_load, target_reset, i2c_comm):
+        stim = i2c_comm.stimulus(DOTT_LABEL('CMD_ADD_EXIT'), exprs=['sum'])
+        operands = [(i * 1000, i * 7 + 3) for i in range(50)]
+        for a, b in operands:
+            stim.send([0x10, *DottConvert.uint32_to_bytes(a), *DottConvert.uint32_to_bytes(b)])
+
+        dott().target.cont()
+        results = stim.run(timeout=20)
+        log.info(f'{stim.throughput():.1f} commands/s')
+
+        for (a, b), (_, (sum,)) in zip(operands, results):
+            assert ((a + b) == sum), 'sum does not match expected value'
+
     ##
     # \amsTestDesc This test checks if a certain label (error handling code) is reached if an unknown (unsupported)
     #              command is sent to the target via I2C.
@@ -129,3 +155,35 @@ class TestI2cCommunication(object):
             hp.wait_complete(timeout=4)
         except TimeoutError:
             assert False, 'Command not detected as unknown command.'
+
+    ##
+    # \amsTestDesc This test demonstrates statistical PC sampling (profiling) of the running target while it receives
+    #              I2C commands.
+    # \amsTestPrec None
+    # \amsTestImpl Let target run, repeatedly send commands via I2C and sample the target's PC at the same time.
+    # \amsTestResp The profile shall contain samples. Note: This is mainly a demonstration test.
+    # \amsTestType System
+    # \amsTestReqs RS_0220, RS_0110, RS_0280
+    @pytest.mark.live_access
+    def test_CmdAddProfile(self, target_load, target_reset, i2c_comm, pc_profiler, tmp_path):
+        a_bytes = DottConvert.uint32_to_bytes(78231231)
+        b_bytes = DottConvert.uint32_to_bytes(12345678)
+
+        def send_cmds():
+            for _ in range(50):
+                i2c_comm.pi.i2c_write_device(i2c_comm.dev, [0x10, *a_bytes, *b_bytes])
+
+        dott().target.cont()
+        traffic = threading.Thread(target=send_cmds)
+        traffic.start()
+        profile = pc_profiler.sample(duration=1.0)
+        traffic.join()
+        dott().target.halt()
+
+        log.info('PC profile (flat):\n' + profile.flat_str(limit=10))
+        assert (profile.num_samples > 0), 'No PC samples acquired'
+
+        # collapsed stacks (input of flamegraph tools); written to pytest's temporary directory of the test
+        folded = tmp_path / 'test_cmd_add_profile.folded'
+        profile.save_collapsed(folded)
+        assert (folded.read_text().strip() != ''), 'Collapsed profile is empty'
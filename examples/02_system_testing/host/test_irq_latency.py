@@ -0,0 +1,109 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# Interrupt latency measurement of the SysTick and TIM7 handlers (stm32f0xx_it.c). Requires the firmware to be built
+# with DOTT_IRQ_LATENCY (see Makefile). The samples of both handlers are recorded in the same ring buffer; the
+# tests therefore only enable one of the two interrupt sources at a time.
+
+import struct
+import time
+
+import pytest
+
+from dottmi.dott import dott
+from dottmi.irq_latency import IrqLatency
+from dottmi.utils import log
+
+CORE_HZ = 48e6
+
+# SysTick and TIM7 registers (STM32F072)
+SYST_CSR = 0xE000E010
+SYST_CSR_TICKINT = 0x2
+NVIC_ICER = 0xE000E180
+TIM7_IRQN = 18
+TIM7_BASE = 0x40001400
+TIM7_EGR, TIM7_PSC, TIM7_ARR = TIM7_BASE + 0x14, TIM7_BASE + 0x28, TIM7_BASE + 0x2C
+TIM7_PERIOD = 4800  # 100us at a prescaler of 1 (timer clock = core clock)
+
+
+def write32(addr: int, val: int) -> None:
+    dott().target.mem.write(addr, struct.pack('<I', val))
+
+
+def read32(addr: int) -> int:
+    return struct.unpack('<I', dott().target.mem.read(addr, 4))[0]
+
+
+@pytest.fixture(scope='function')
+def irq_latency(target_load, target_reset) -> IrqLatency:
+    if not dott().target.symbols.exists('DOTT_irq_latency'):
+        pytest.skip('Firmware not built with DOTT_IRQ_LATENCY.')
+    yield IrqLatency(dott().target, tick_hz=CORE_HZ)
+
+
+class TestIrqLatency(object):
+
+    ##
+    # \amsTestDesc This test measures the entry latency and duration of the SysTick handler.
+    # \amsTestPrec Firmware built with DOTT_IRQ_LATENCY.
+    # \amsTestImpl Let the target run with the TIM7 interrupt disabled and stream the latency samples recorded by the
+    #              SysTick handler (elapsed SysTick cycles at entry and exit) via live access.
+    # \amsTestResp The latency shall be well below the SysTick period. Note: The histograms are reported for
+    #              information.
+    # \amsTestType System
+    # \amsTestReqs RS_0220, RS_0280
+    @pytest.mark.live_access
+    def test_SysTickLatency(self, irq_latency, live_access):
+        dt = dott().target
+        write32(NVIC_ICER, 1 << TIM7_IRQN)
+
+        dt.cont()
+        report = irq_latency.collect(live_access, num_samples=2000, timeout=10)
+        dt.halt()
+
+        log.info(f'SysTick_Handler:\n{report}')
+        assert (report.count == 2000), 'Not all latency samples collected'
+        assert (report.latency_stats()[1] < read32(SYST_CSR + 4)), 'SysTick latency exceeds the SysTick period'
+
+    ##
+    # \amsTestDesc This test measures the entry latency and duration of the TIM7 handler.
+    # \amsTestPrec Firmware built with DOTT_IRQ_LATENCY.
+    # \amsTestImpl Reconfigure TIM7 to count core clock cycles with a period of 100us, disable the SysTick interrupt
+    #              and let the target run. Then, read the samples recorded by the TIM7 handler with a single bulk
+    #              read.
+    # \amsTestResp Samples shall have been recorded with a latency below the timer period.
+    # \amsTestType System
+    # \amsTestReqs RS_0220, RS_0280
+    def test_Tim7Latency(self, irq_latency):
+        dt = dott().target
+        write32(SYST_CSR, read32(SYST_CSR) & ~SYST_CSR_TICKINT)
+        write32(TIM7_PSC, 0)
+        write32(TIM7_ARR, TIM7_PERIOD - 1)
+        write32(TIM7_EGR, 0x1)  # update event: load the new prescaler
+
+        irq_latency.start()
+        dt.cont()
+        time.sleep(.02)  # about 200 interrupts (the ring buffer keeps the last DOTT_IRQ_LATENCY_ENTRIES samples)
+        dt.halt()
+        report = irq_latency.stop()
+
+        log.info(f'TIM7_IRQHandler:\n{report}')
+        assert (report.count > 0), 'No latency samples recorded'
+        assert (report.latency_stats()[1] < TIM7_PERIOD), 'TIM7 latency exceeds the timer period'
@@ -115,12 +115,16 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
-
+#if defined(DOTT_IRQ_LATENCY)
+  DOTT_IRQ_LATENCY_ENTER(DOTT_IRQ_LATENCY_SYSTICK);
+#endif
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   HAL_SYSTICK_IRQHandler();
   /* USER CODE BEGIN SysTick_IRQn 1 */
-
+#if defined(DOTT_IRQ_LATENCY)
+  DOTT_IRQ_LATENCY_EXIT(DOTT_IRQ_LATENCY_SYSTICK);
+#endif
   /* USER CODE END SysTick_IRQn 1 */
 }
 
@@ -165,10 +169,16 @@ void DMA1_Channel2_3_IRQHandler(void)
 void TIM7_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM7_IRQn 0 */
+#if defined(DOTT_IRQ_LATENCY)
+  DOTT_IRQ_LATENCY_ENTER(TIM7->CNT);
+#endif
   timer_advance();
   /* USER CODE END TIM7_IRQn 0 */
   HAL_TIM_IRQHandler(&htim7);
   /* USER CODE BEGIN TIM7_IRQn 1 */
+#if defined(DOTT_IRQ_LATENCY)
+  DOTT_IRQ_LATENCY_EXIT(TIM7->CNT);
+#endif
   DOTT_LABEL("TIM7_IRQHandler_End");
   /* USER CODE END TIM7_IRQn 1 */
 }
@@ -0,0 +1,48 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+import os
+
+import pytest
+
+from dottmi.dott import DottConf
+from dottmi.fixtures import target_load_flash, target_reset_flash
+
+# toolchain the benchmark firmware was built with (see target/Makefile); selected with the DOTT_DSP_TOOLCHAIN
+# environment variable (armclang or gcc).
+toolchain = os.environ.get('DOTT_DSP_TOOLCHAIN', 'armclang').lower()
+if toolchain not in ('armclang', 'gcc'):
+    raise ValueError(f'DOTT_DSP_TOOLCHAIN must be armclang or gcc (not {toolchain}).')
+
+# set binaries used for the tests in this folder (relative to main conftest file)
+DottConf.conf['exec_type'] = 'FLASH'
+DottConf.conf['app_load_elf'] = f'03_dsp_benchmark/target/build/{toolchain}/dott_example_03/dott_example_03.bin.elf'
+DottConf.conf['app_symbol_elf'] = f'03_dsp_benchmark/target/build/{toolchain}/dott_example_03/dott_example_03.axf'
+
+target_load = target_load_flash
+target_reset = target_reset_flash
+
+
+@pytest.fixture(scope='session')
+def dsp_toolchain() -> str:
+    """
+    Returns the toolchain (armclang or gcc) the benchmark firmware was built with.
+    """
+    return toolchain
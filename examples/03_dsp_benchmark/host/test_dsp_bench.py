@@ -0,0 +1,223 @@
+# vim: set tabstop=4 expandtab :
+###############################################################################
+#   Copyright (c) 2019-2021 ams AG
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+###############################################################################
+
+# Authors:
+# - Thomas Winkler, ams AG, thomas.winkler@ams.com
+
+# CMSIS-DSP kernel benchmarks. Each test writes the input vectors into the buffers of the benchmark firmware (bulk
+# memory writes), runs the kernel once and compares its output with a numpy reference (bit-exact for the q15 kernels
+# which accumulate in 64 bits, relative tolerance for the f32 kernels). Then, the kernel is benchmarked with the
+# target_bench fixture. The toolchain and optimization level variants of the firmware are compared with
+#   python -m dottmi.bench_compare bench_variants.json (run from 03_dsp_benchmark)
+
+import numpy as np
+import pytest
+
+from dottmi.dott import dott
+from dottmi.utils import log
+
+Q15_MIN, Q15_MAX = -32768, 32767
+
+
+def write_array(sym: str, arr: np.ndarray) -> int:
+    # writes the array (little-endian) to the given firmware buffer and returns the buffer's address
+    addr = dott().target.symbols.addr(sym)
+    dott().target.mem.write(addr, arr.astype(arr.dtype.newbyteorder('<')).tobytes())
+    return addr
+
+
+def read_array(sym: str, dtype: str, cnt: int) -> np.ndarray:
+    data = dott().target.mem.read(dott().target.symbols.addr(sym), cnt * np.dtype(dtype).itemsize)
+    return np.frombuffer(bytearray(data), dtype=np.dtype(dtype))
+
+
+def q15_random(rng: np.random.Generator, cnt: int, scale: float = 1.0) -> np.ndarray:
+    return (rng.uniform(-scale, scale, cnt) * Q15_MAX).astype(np.int16)
+
+
+def q15_sat(acc: np.ndarray, shift: int) -> np.ndarray:
+    return np.clip(acc >> shift, Q15_MIN, Q15_MAX).astype(np.int16)
+
+
+def bench_kernel(target_bench, toolchain: str, kernel: str, *args: int, num: int, iterations: int = 20):
+    # benchmarks the kernel and logs its cycles per element (sample, output value or product) and its code size
+    res = target_bench(kernel, *args, iterations=iterations)
+    log.info(f'{kernel} [{toolchain}] ({num} elements): {res.median:.0f} cycles '
+             f'({res.median / num:.1f} cycles/element), code size: {dott().target.symbols.size(kernel)} bytes')
+    return res
+
+
+class TestDspBench(object):
+
+    ##
+    # \amsTestDesc Benchmark of the q15 FIR filter.
+    # \amsTestPrec None
+    # \amsTestImpl Set up the filter, write coefficients and input samples, filter one block and benchmark the kernel.
+    # \amsTestResp Output matches the numpy reference (bit-exact).
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230
+    @pytest.mark.parametrize('num_taps, block_size', [(16, 64), (32, 128)])
+    def test_arm_fir_q15(self, target_load, target_reset, target_bench, dsp_toolchain, num_taps, block_size):
+        dt = dott().target
+        rng = np.random.default_rng(1)
+        coeffs = q15_random(rng, num_taps, 0.25)
+        src = q15_random(rng, block_size)
+
+        write_array('bench_coeffs', coeffs)
+        assert 0 == dt.call('bench_fir_q15_init', num_taps, block_size)
+        args = (dt.symbols.addr('bench_fir_q15'), write_array('bench_src', src), dt.symbols.addr('bench_dst'))
+        dt.call('arm_fir_q15', *args, block_size)
+
+        # note: coefficients are stored in time reversed order (pCoeffs[0] is applied to the oldest sample)
+        ref = q15_sat(np.convolve(src.astype(np.int64), coeffs[::-1].astype(np.int64))[:block_size], 15)
+        assert np.array_equal(ref, read_array('bench_dst', 'int16', block_size))
+
+        bench_kernel(target_bench, dsp_toolchain, 'arm_fir_q15', *args, block_size, num=block_size)
+
+    ##
+    # \amsTestDesc Benchmark of the f32 FIR filter.
+    # \amsTestPrec None
+    # \amsTestImpl Set up the filter, write coefficients and input samples, filter one block and benchmark the kernel.
+    # \amsTestResp Output matches the numpy reference (within single precision tolerance).
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230
+    @pytest.mark.parametrize('num_taps, block_size', [(16, 64)])
+    def test_arm_fir_f32(self, target_load, target_reset, target_bench, dsp_toolchain, num_taps, block_size):
+        dt = dott().target
+        rng = np.random.default_rng(2)
+        coeffs = rng.uniform(-.25, .25, num_taps).astype(np.float32)
+        src = rng.uniform(-1., 1., block_size).astype(np.float32)
+
+        write_array('bench_coeffs', coeffs)
+        assert 0 == dt.call('bench_fir_f32_init', num_taps, block_size)
+        args = (dt.symbols.addr('bench_fir_f32'), write_array('bench_src', src), dt.symbols.addr('bench_dst'))
+        dt.call('arm_fir_f32', *args, block_size)
+
+        ref = np.convolve(src.astype(np.float64), coeffs[::-1].astype(np.float64))[:block_size]
+        assert np.allclose(ref, read_array('bench_dst', 'float32', block_size), rtol=1e-4, atol=1e-5)
+
+        bench_kernel(target_bench, dsp_toolchain, 'arm_fir_f32', *args, block_size, num=block_size)
+
+    ##
+    # \amsTestDesc Benchmark of the q15 biquad cascade (direct form I).
+    # \amsTestPrec None
+    # \amsTestImpl Set up the cascade, write coefficients and input samples, filter one block and benchmark the kernel.
+    # \amsTestResp Output matches the numpy reference (bit-exact).
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230
+    def test_arm_biquad_cascade_df1_q15(self, target_load, target_reset, target_bench, dsp_toolchain):
+        dt = dott().target
+        num_stages, post_shift, block_size = 2, 1, 64
+        # stable low pass sections (b0, 0, b1, b2, a1, a2 in q14 due to the post shift of 1)
+        sections = [(0.0675, 0.1349, 0.0675, 1.1430, -0.4128), (0.0675, 0.1349, 0.0675, 1.1430, -0.4128)]
+        coeffs = np.array([[round(c * 2 ** 14) for c in (b0, 0., b1, b2, a1, a2)]
+                           for b0, b1, b2, a1, a2 in sections], dtype=np.int16).flatten()
+        src = q15_random(np.random.default_rng(3), block_size, 0.5)
+
+        write_array('bench_coeffs', coeffs)
+        assert 0 == dt.call('bench_biquad_q15_init', num_stages, post_shift)
+        args = (dt.symbols.addr('bench_biquad_q15'), write_array('bench_src', src), dt.symbols.addr('bench_dst'))
+        dt.call('arm_biquad_cascade_df1_q15', *args, block_size)
+
+        ref = [int(x) for x in src]
+        for stage in range(num_stages):
+            b0, _, b1, b2, a1, a2 = (int(c) for c in coeffs[6 * stage:6 * stage + 6])
+            xn1 = xn2 = yn1 = yn2 = 0
+            out = []
+            for xn in ref:
+                acc = b0 * xn + b1 * xn1 + b2 * xn2 + a1 * yn1 + a2 * yn2
+                yn = min(max(acc >> (15 - post_shift), Q15_MIN), Q15_MAX)
+                xn2, xn1, yn2, yn1 = xn1, xn, yn1, yn
+                out.append(yn)
+            ref = out
+        assert np.array_equal(np.array(ref, dtype=np.int16), read_array('bench_dst', 'int16', block_size))
+
+        bench_kernel(target_bench, dsp_toolchain, 'arm_biquad_cascade_df1_q15', *args, block_size, num=block_size)
+
+    ##
+    # \amsTestDesc Benchmark of the q15 matrix multiplication.
+    # \amsTestPrec None
+    # \amsTestImpl Set up and write the matrices, multiply them once and benchmark the kernel.
+    # \amsTestResp Result matches the numpy reference (bit-exact).
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230
+    @pytest.mark.parametrize('rows, inner, cols', [(8, 8, 8), (4, 16, 4)])
+    def test_arm_mat_mult_q15(self, target_load, target_reset, target_bench, dsp_toolchain, rows, inner, cols):
+        dt = dott().target
+        rng = np.random.default_rng(4)
+        a = q15_random(rng, rows * inner, 0.25)
+        b = q15_random(rng, inner * cols, 0.25)
+
+        write_array('bench_src', a)
+        write_array('bench_src2', b)
+        assert 0 == dt.call('bench_mat_q15_init', rows, inner, cols)
+        mats = dt.symbols.addr('bench_mat_q15')
+        args = (mats, mats + 8, mats + 16, dt.symbols.addr('bench_state'))  # note: sizeof(arm_matrix_instance_q15)
+        assert 0 == dt.call('arm_mat_mult_q15', *args)
+
+        ref = q15_sat(a.astype(np.int64).reshape(rows, inner) @ b.astype(np.int64).reshape(inner, cols), 15)
+        assert np.array_equal(ref.flatten(), read_array('bench_dst', 'int16', rows * cols))
+
+        bench_kernel(target_bench, dsp_toolchain, 'arm_mat_mult_q15', *args, num=rows * inner * cols)
+
+    ##
+    # \amsTestDesc Benchmark of the f32 matrix multiplication.
+    # \amsTestPrec None
+    # \amsTestImpl Set up and write the matrices, multiply them once and benchmark the kernel.
+    # \amsTestResp Result matches the numpy reference (within single precision tolerance).
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230
+    def test_arm_mat_mult_f32(self, target_load, target_reset, target_bench, dsp_toolchain):
+        dt = dott().target
+        rows, inner, cols = 8, 8, 8
+        rng = np.random.default_rng(5)
+        a = rng.uniform(-1., 1., rows * inner).astype(np.float32)
+        b = rng.uniform(-1., 1., inner * cols).astype(np.float32)
+
+        write_array('bench_src', a)
+        write_array('bench_src2', b)
+        assert 0 == dt.call('bench_mat_f32_init', rows, inner, cols)
+        mats = dt.symbols.addr('bench_mat_f32')
+        args = (mats, mats + 8, mats + 16)  # note: sizeof(arm_matrix_instance_f32)
+        assert 0 == dt.call('arm_mat_mult_f32', *args)
+
+        ref = a.astype(np.float64).reshape(rows, inner) @ b.astype(np.float64).reshape(inner, cols)
+        assert np.allclose(ref.flatten(), read_array('bench_dst', 'float32', rows * cols), rtol=1e-4, atol=1e-5)
+
+        bench_kernel(target_bench, dsp_toolchain, 'arm_mat_mult_f32', *args, num=rows * inner * cols)
+
+    ##
+    # \amsTestDesc Benchmark of the q15 dot product.
+    # \amsTestPrec None
+    # \amsTestImpl Write both vectors, compute the dot product once and benchmark the kernel.
+    # \amsTestResp Result (34.30 format) matches the numpy reference (bit-exact).
+    # \amsTestType Component
+    # \amsTestReqs RS_0110, RS_0230
+    def test_arm_dot_prod_q15(self, target_load, target_reset, target_bench, dsp_toolchain):
+        dt = dott().target
+        num = 256
+        rng = np.random.default_rng(6)
+        a = q15_random(rng, num)
+        b = q15_random(rng, num)
+
+        args = (write_array('bench_src', a), write_array('bench_src2', b), num, dt.symbols.addr('bench_dst'))
+        dt.call('arm_dot_prod_q15', *args)
+
+        ref = int(np.dot(a.astype(np.int64), b.astype(np.int64)))
+        assert ref == int(read_array('bench_dst', 'int64', 1)[0])
+
+        bench_kernel(target_bench, dsp_toolchain, 'arm_dot_prod_q15', *args, num=num)
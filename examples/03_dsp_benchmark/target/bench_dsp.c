@@ -0,0 +1,133 @@
+/*
+ *   Copyright (c) 2019-2021 ams AG
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ Authors:
+ - Thomas Winkler, ams AG, thomas.winkler@ams.com
+*/
+
+/*
+ * CMSIS-DSP benchmark firmware. The host writes the input vectors and coefficients into the buffers below (bulk
+ * memory writes), sets up the kernel instances with the bench_xxx_init functions and then calls (and benchmarks) the
+ * CMSIS-DSP kernels directly with the addresses of the instances and buffers as arguments (see test_dsp_bench.py).
+ */
+
+#include "stdint.h"
+#include "arm_math.h"
+#include "testhelpers.h"
+
+/* Buffer sizes in 32 bit words. */
+#define BENCH_BUF_WORDS   256U
+#define BENCH_COEFF_WORDS 128U
+#define BENCH_STATE_WORDS 320U
+
+/* Input (bench_src, bench_src2), output and coefficient buffers as well as the state of the kernels. */
+uint32_t __attribute__((used)) bench_src[BENCH_BUF_WORDS];
+uint32_t __attribute__((used)) bench_src2[BENCH_BUF_WORDS];
+uint32_t __attribute__((used)) bench_dst[BENCH_BUF_WORDS];
+uint32_t __attribute__((used)) bench_coeffs[BENCH_COEFF_WORDS];
+uint32_t __attribute__((used)) bench_state[BENCH_STATE_WORDS];
+
+/* Kernel instances. Matrices: A (bench_src), B (bench_src2) and C (bench_dst). */
+arm_fir_instance_q15 __attribute__((used)) bench_fir_q15;
+arm_fir_instance_f32 __attribute__((used)) bench_fir_f32;
+arm_biquad_casd_df1_inst_q15 __attribute__((used)) bench_biquad_q15;
+arm_matrix_instance_q15 __attribute__((used)) bench_mat_q15[3];
+arm_matrix_instance_f32 __attribute__((used)) bench_mat_f32[3];
+
+/* Kernels are only called by the host; this table keeps them in the image. */
+const void * const __attribute__((used)) bench_kernels[] = {
+    (const void *) arm_fir_q15,
+    (const void *) arm_fir_f32,
+    (const void *) arm_biquad_cascade_df1_q15,
+    (const void *) arm_mat_mult_q15,
+    (const void *) arm_mat_mult_f32,
+    (const void *) arm_dot_prod_q15,
+};
+
+
+/**
+ * Sets up bench_fir_q15 with num_taps coefficients (bench_coeffs) for blocks of block_size samples.
+ */
+int32_t __attribute__((used)) bench_fir_q15_init(uint32_t num_taps, uint32_t block_size)
+{
+    if ((num_taps > 2U * BENCH_COEFF_WORDS) || (block_size > 2U * BENCH_BUF_WORDS) ||
+        (num_taps + block_size - 1U > 2U * BENCH_STATE_WORDS)) {
+        return ARM_MATH_LENGTH_ERROR;
+    }
+    return arm_fir_init_q15(&bench_fir_q15, (uint16_t) num_taps, (q15_t *) bench_coeffs, (q15_t *) bench_state,
+                            block_size);
+}
+
+
+/**
+ * Sets up bench_fir_f32 with num_taps coefficients (bench_coeffs) for blocks of block_size samples.
+ */
+int32_t __attribute__((used)) bench_fir_f32_init(uint32_t num_taps, uint32_t block_size)
+{
+    if ((num_taps > BENCH_COEFF_WORDS) || (block_size > BENCH_BUF_WORDS) ||
+        (num_taps + block_size - 1U > BENCH_STATE_WORDS)) {
+        return ARM_MATH_LENGTH_ERROR;
+    }
+    arm_fir_init_f32(&bench_fir_f32, (uint16_t) num_taps, (float32_t *) bench_coeffs, (float32_t *) bench_state,
+                     block_size);
+    return ARM_MATH_SUCCESS;
+}
+
+
+/**
+ * Sets up bench_biquad_q15 with num_stages stages (6 coefficients per stage in bench_coeffs).
+ */
+int32_t __attribute__((used)) bench_biquad_q15_init(uint32_t num_stages, int32_t post_shift)
+{
+    if ((6U * num_stages > 2U * BENCH_COEFF_WORDS) || (4U * num_stages > 2U * BENCH_STATE_WORDS)) {
+        return ARM_MATH_LENGTH_ERROR;
+    }
+    arm_biquad_cascade_df1_init_q15(&bench_biquad_q15, (uint8_t) num_stages, (q15_t *) bench_coeffs,
+                                    (q15_t *) bench_state, (int8_t) post_shift);
+    return ARM_MATH_SUCCESS;
+}
+
+
+/**
+ * Sets up the q15 matrices A (rows x inner), B (inner x cols) and C (rows x cols).
+ */
+int32_t __attribute__((used)) bench_mat_q15_init(uint32_t rows, uint32_t inner, uint32_t cols)
+{
+    if ((rows * inner > 2U * BENCH_BUF_WORDS) || (inner * cols > 2U * BENCH_BUF_WORDS) ||
+        (rows * cols > 2U * BENCH_BUF_WORDS) || (inner * cols > 2U * BENCH_STATE_WORDS)) {
+        return ARM_MATH_LENGTH_ERROR;
+    }
+    arm_mat_init_q15(&bench_mat_q15[0], (uint16_t) rows, (uint16_t) inner, (q15_t *) bench_src);
+    arm_mat_init_q15(&bench_mat_q15[1], (uint16_t) inner, (uint16_t) cols, (q15_t *) bench_src2);
+    arm_mat_init_q15(&bench_mat_q15[2], (uint16_t) rows, (uint16_t) cols, (q15_t *) bench_dst);
+    return ARM_MATH_SUCCESS;
+}
+
+
+/**
+ * Sets up the f32 matrices A (rows x inner), B (inner x cols) and C (rows x cols).
+ */
+int32_t __attribute__((used)) bench_mat_f32_init(uint32_t rows, uint32_t inner, uint32_t cols)
+{
+    if ((rows * inner > BENCH_BUF_WORDS) || (inner * cols > BENCH_BUF_WORDS) || (rows * cols > BENCH_BUF_WORDS)) {
+        return ARM_MATH_LENGTH_ERROR;
+    }
+    arm_mat_init_f32(&bench_mat_f32[0], (uint16_t) rows, (uint16_t) inner, (float32_t *) bench_src);
+    arm_mat_init_f32(&bench_mat_f32[1], (uint16_t) inner, (uint16_t) cols, (float32_t *) bench_src2);
+    arm_mat_init_f32(&bench_mat_f32[2], (uint16_t) rows, (uint16_t) cols, (float32_t *) bench_dst);
+    return ARM_MATH_SUCCESS;
+}
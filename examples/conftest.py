@@ -21,11 +21,16 @@
 import logging
 import os
 import socket
+import threading
+import time
+from typing import List, Tuple
 
 import pigpio
 
+from dottmi.breakpoint import InterceptPoint
 from dottmi.dott import dott
 from dottmi.fixtures import dott_auto_func_cleanup, dott_auto_connect_and_disconnect, target_reset_common
+from dottmi.timeline import timeline
 
 # set working directory to the folder which contains this conftest file
 import pytest
@@ -66,11 +71,108 @@ def set_config_options() -> None:
 set_config_options()
 
 
+class _StimulusAck(InterceptPoint):
+    # non-stopping breakpoint at the label which marks a processed transaction; it records the given expressions
+    def __init__(self, stimulus: 'I2cStimulus', location: str, exprs: List[str]) -> None:
+        super().__init__(location)
+        self._stimulus: 'I2cStimulus' = stimulus
+        self._exprs: List[str] = exprs
+
+    def reached(self) -> None:
+        values = self.eval_many(self._exprs) if len(self._exprs) > 0 else []
+        self._stimulus._ack(values)
+
+
+class I2cStimulus(object):
+    """
+    Asynchronous stimulus queue for the I2C test equipment. Transactions are queued with send() and written to the
+    target by a background thread while the target keeps running. The target acknowledges each processed transaction
+    by reaching the given label (intercepted without halting the test) where the given expressions are evaluated.
+    Transactions and label hits are correlated in order; at most window transactions are outstanding (i.e., written
+    but not yet acknowledged). Example:
+        stim = i2c_comm.stimulus(DOTT_LABEL('CMD_ADD_EXIT'), exprs=['sum'])
+        for a, b in operands:
+            stim.send([0x10, *DottConvert.uint32_to_bytes(a), *DottConvert.uint32_to_bytes(b)])
+        dott().target.cont()
+        results = stim.run(timeout=10)  # list of (transaction, [sum])
+    """
+    def __init__(self, comm: 'CommDev', label: str, exprs: List[str] = None, window: int = 1) -> None:
+        self._comm: 'CommDev' = comm
+        self._queue: List[List[int]] = []
+        self._acks: List[Tuple[float, List]] = []
+        self._sent: List[float] = []
+        self._window: threading.Semaphore = threading.Semaphore(window)
+        self._done: threading.Condition = threading.Condition()
+        self._ip: _StimulusAck = _StimulusAck(self, label, exprs if exprs is not None else [])
+
+    def send(self, data: List[int]) -> int:
+        """
+        Queues a transaction (bytes written to the I2C device) and returns its index.
+        """
+        self._queue.append(list(data))
+        return len(self._queue) - 1
+
+    def _ack(self, values: List) -> None:
+        with self._done:
+            self._acks.append((time.perf_counter(), values))
+            self._done.notify_all()
+        self._window.release()
+
+    def run(self, timeout: float = None) -> List[Tuple[List[int], List]]:
+        """
+        Writes all queued transactions (the target has to be running) and waits until the target has acknowledged
+        all of them.
+
+        Returns:
+            List of (transaction, values of the expressions at the acknowledging label hit).
+        """
+        deadline = None if timeout is None else time.perf_counter() + timeout
+
+        def remaining() -> float:
+            return None if deadline is None else max(0.0, deadline - time.perf_counter())
+
+        for data in self._queue[len(self._sent):]:
+            if not self._window.acquire(timeout=remaining()):
+                break
+            self._sent.append(time.perf_counter())
+            with timeline.span('i2c write', 'equipment', {'data': data}):
+                self._comm.pi.i2c_write_device(self._comm.dev, data)
+
+        with self._done:
+            if not self._done.wait_for(lambda: len(self._acks) >= len(self._queue), timeout=remaining()):
+                raise TimeoutError(f'Target acknowledged {len(self._acks)} of {len(self._queue)} transactions within '
+                                   f'timeout of {timeout}secs.')
+        return [(data, values) for data, (_, values) in zip(self._queue, self._acks)]
+
+    def latencies(self) -> List[float]:
+        """
+        Time (in seconds) from writing each transaction until it was acknowledged by the target.
+        """
+        return [ack - sent for sent, (ack, _) in zip(self._sent, self._acks)]
+
+    def throughput(self) -> float:
+        """
+        Achieved number of transactions per second.
+        """
+        if len(self._acks) < 2:
+            return 0.0
+        return (len(self._acks) - 1) / (self._acks[-1][0] - self._acks[0][0])
+
+    def delete(self) -> None:
+        self._ip.delete()
+
+
 class CommDev(object):
     def __init__(self, pi, dev):
         self.pi = pi
         self.dev = dev
 
+    def stimulus(self, label: str, exprs: List[str] = None, window: int = 1) -> I2cStimulus:
+        """
+        Creates an asynchronous stimulus queue (see I2cStimulus) for this device.
+        """
+        return I2cStimulus(self, label, exprs, window)
+
 
 @pytest.fixture(scope='function')
 def i2c_comm() -> CommDev:
@@ -50,6 +50,20 @@ CFLAGS += -fno-rtti -flto -funsigned-char -fshort-enums -fshort-wchar
 CFLAGS += -MD -gdwarf-4 -Oz -ffunction-sections
 CFLAGS += -D__MICROLIB -DARMCM0 -DCONF_LOGGING="1"
 
+# Size of the DOTT_test_hook scratchpad memory (in 32 bit words) and optional linker section to place it in. The
+# section has to be provided by the linker script as NOLOAD/UNINIT section (see e.g. the standard template). It is
+# required for the SECTION on-target memory model.
+#CFLAGS += -DDOTT_TEST_HOOK_MEM_WORDS=256
+#CFLAGS += -DDOTT_TEST_HOOK_MEM_SECTION=.dott_scratch
+
+# Uncomment to record malloc/calloc/realloc/free in the DOTT_heap_trace ring buffer (see heap_trace in dott.ini). The
+# wrappers use armlink's $Sub$$/$Super$$ mechanism; no linker options are required.
+#CFLAGS += -DDOTT_HEAP_TRACE
+# Uncomment to provide the DOTT_irq_latency ring buffer for handlers instrumented with DOTT_IRQ_LATENCY_ENTER/EXIT.
+#CFLAGS += -DDOTT_IRQ_LATENCY
+# Uncomment to provide DOTT_LOG (deferred formatting, see DeferredLog) with the DOTT_log ring buffer.
+#CFLAGS += -DDOTT_DEFERRED_LOG
+
 # Enable compiler warnings
 WARNINGS  = -Wall
 CFLAGS   += $(WARNINGS)
@@ -64,3 +78,14 @@ LDFLAGS += --list $(MAPFILE)
 
 # archiver flags
 ARFLAGS = --create
+
+# DOTT manifest (symbol index, DOTT_LABEL_xxx addresses, type layouts, scratchpad region and build-id) generated next
+# to the ELF (app.axf -> app.dott.json) and used by DOTT instead of querying GDB at runtime. Add the manifest to the
+# targets of the including Makefile (e.g., all: app.axf app.dott.json). DOTT_MANIFEST_TYPES is a comma-separated list
+# of types whose layouts are included (determined with DOTT_GDB; requires the dottmi package in the Python path).
+PYTHON ?= python
+DOTT_GDB ?= arm-none-eabi-gdb
+DOTT_MANIFEST_TYPES ?=
+
+%.dott.json: %.axf
+	$(PYTHON) -m dottmi.manifest $< -o $@ --gdb $(DOTT_GDB) --types "$(DOTT_MANIFEST_TYPES)"
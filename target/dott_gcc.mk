@@ -55,6 +55,12 @@ CFLAGS += -mcpu=cortex-m0 -march=armv6-m -mthumb -mlittle-endian -mno-unaligned-
 #CFLAGS += -MD -gdwarf-3 -Oz -ffunction-sections
 #CFLAGS += -D__MICROLIB -DARMCM0 -DCONF_LOGGING="1"
 
+# Size of the DOTT_test_hook scratchpad memory (in 32 bit words) and optional linker section to place it in. The
+# section has to be provided by the linker script as NOLOAD/UNINIT section (see e.g. the standard template). It is
+# required for the SECTION on-target memory model.
+#CFLAGS += -DDOTT_TEST_HOOK_MEM_WORDS=256
+#CFLAGS += -DDOTT_TEST_HOOK_MEM_SECTION=.dott_scratch
+
 # Enable compiler warnings
 WARNINGS  = -Wall
 CFLAGS   += $(WARNINGS)
@@ -65,6 +71,16 @@ LDFLAGS += --specs=nano.specs
 LDFLAGS += -Xlinker --gc-sections
 LDFLAGS += -Wl,-Map,$(MAPFILE)
 LDFLAGS += -nostartfiles
+# Uncomment to embed a GNU build-id which is used to detect that the target already holds the image (see
+# flash_skip_identical in dott.ini). The linker script has to place .note.gnu.build-id in flash (see gcc_arm.ld).
+#LDFLAGS += -Wl,--build-id
+# Uncomment to record malloc/calloc/realloc/free in the DOTT_heap_trace ring buffer (see heap_trace in dott.ini).
+#CFLAGS += -DDOTT_HEAP_TRACE
+#LDFLAGS += -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+# Uncomment to provide the DOTT_irq_latency ring buffer for handlers instrumented with DOTT_IRQ_LATENCY_ENTER/EXIT.
+#CFLAGS += -DDOTT_IRQ_LATENCY
+# Uncomment to provide DOTT_LOG (deferred formatting, see DeferredLog) with the DOTT_log ring buffer.
+#CFLAGS += -DDOTT_DEFERRED_LOG
 #LDFLAGS += -fprofile-arcs
 
 
@@ -76,3 +92,23 @@ LDFLAGS += -nostartfiles
 
 # archiver flags
 ARFLAGS = rv
+
+# DOTT manifest (symbol index, DOTT_LABEL_xxx addresses, type layouts, scratchpad region and build-id) generated next
+# to the ELF (app.axf -> app.dott.json) and used by DOTT instead of querying GDB at runtime. Add the manifest to the
+# targets of the including Makefile (e.g., all: app.axf app.dott.json). DOTT_MANIFEST_TYPES is a comma-separated list
+# of types whose layouts are included (determined with DOTT_GDB; requires the dottmi package in the Python path).
+PYTHON ?= python
+DOTT_GDB ?= $(CCPATH)$(PREFIX)gdb
+DOTT_MANIFEST_TYPES ?=
+
+%.dott.json: %.axf
+	$(PYTHON) -m dottmi.manifest $< -o $@ --gdb $(DOTT_GDB) --types "$(DOTT_MANIFEST_TYPES)"
+
+# GDB symbol index (.gdb_index section) which speeds up symbol loading of large firmware with GDB (and hence DOTT's
+# target load). Call it at the end of the link recipe of the including Makefile, e.g.,
+#     $(LD) $(LDFLAGS) ... -o $@
+#     $(call dott_gdb_index,$@)
+# GDB writes the index next to the ELF (<elf>.gdb-index) from where it is added to the ELF as .gdb_index section.
+dott_gdb_index = $(DOTT_GDB) -batch -nx -ex "save gdb-index $(dir $(1))" $(1) && \
+	$(OBJCOPY) --add-section .gdb_index=$(1).gdb-index --set-section-flags .gdb_index=readonly $(1) $(1) && \
+	rm -f $(1).gdb-index
@@ -0,0 +1,99 @@
+/*
+ *   Copyright (c) 2019-2021 ams AG
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ Authors:
+ - Thomas Winkler, ams AG, thomas.winkler@ams.com
+*/
+
+
+#include "stdint.h"
+
+#include "testhelpers.h"
+#include "flashloader.h"
+
+static uint8_t __attribute__ ((aligned (4))) DOTT_flash_loader_bufs[DOTT_FLASH_LOADER_NUM_BUFS][DOTT_FLASH_LOADER_PAGE_SIZE];
+
+uint32_t __attribute__ ((aligned (8))) DOTT_flash_loader_stack[DOTT_FLASH_LOADER_STACK_WORDS];
+
+/* note: initialized data; the host reads the layout from the downloaded image */
+volatile DOTT_flash_loader_ctrl_t DOTT_flash_loader_ctrl = {
+    DOTT_FLASH_LOADER_MAGIC, DOTT_FLASH_LOADER_PAGE_SIZE, DOTT_FLASH_LOADER_NUM_BUFS, 1U, 0U, 1, { 0U, }, { { 0U, }, }
+};
+
+static void DOTT_flash_loader_halt(void)
+{
+    for (;;) {
+        __asm volatile("bkpt #0x03");
+    }
+}
+
+/**
+ * Entry point of the RAM-resident flash loader. Runs the commands posted by the host (see flashloader.h).
+ */
+void DOTT_NO_INLINE DOTT_flash_loader_run(void)
+{
+    volatile DOTT_flash_loader_ctrl_t *ctrl = &DOTT_flash_loader_ctrl;
+    volatile DOTT_flash_cmd_t *cmd;
+    uint32_t i;
+    int32_t res;
+
+    if (ctrl->init_result > 0) {
+        /* note: init_result is 1 in the downloaded image and set to the port's result on first entry */
+        for (i = 0U; i < DOTT_FLASH_LOADER_NUM_BUFS; i++) {
+            ctrl->bufs[i] = (uint32_t) (uintptr_t) DOTT_flash_loader_bufs[i];
+        }
+        ctrl->init_result = DOTT_flash_port_init();
+    }
+    if (ctrl->init_result != 0) {
+        DOTT_flash_loader_halt();
+    }
+
+    for (;;) {
+        cmd = &ctrl->cmds[ctrl->next];
+        while (cmd->state != DOTT_FLASH_STATE_FULL) {
+            if (ctrl->halt_when_idle != 0U) {
+                DOTT_flash_loader_halt();
+            }
+        }
+        cmd->state = DOTT_FLASH_STATE_BUSY;
+
+        switch (cmd->op) {
+        case DOTT_FLASH_OP_ERASE:
+            res = DOTT_flash_port_erase(cmd->addr, cmd->len);
+            break;
+        case DOTT_FLASH_OP_PROGRAM:
+            res = (cmd->len <= DOTT_FLASH_LOADER_PAGE_SIZE) ?
+                  DOTT_flash_port_program(cmd->addr, DOTT_flash_loader_bufs[ctrl->next], cmd->len) : -1;
+            break;
+        case DOTT_FLASH_OP_EXIT:
+            cmd->state = DOTT_FLASH_STATE_DONE;
+            ctrl->next = (ctrl->next + 1U) % DOTT_FLASH_LOADER_NUM_BUFS;
+            DOTT_flash_loader_halt();
+            break;
+        default:
+            res = -1;
+            break;
+        }
+
+        cmd->error = (uint32_t) res;
+        cmd->state = (res == 0) ? DOTT_FLASH_STATE_DONE : DOTT_FLASH_STATE_ERROR;
+        ctrl->next = (ctrl->next + 1U) % DOTT_FLASH_LOADER_NUM_BUFS;
+        if (res != 0) {
+            DOTT_flash_loader_halt();
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ *   Copyright (c) 2019-2021 ams AG
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ Authors:
+ - Thomas Winkler, ams AG, thomas.winkler@ams.com
+*/
+
+
+#ifndef UTILS_FLASHLOADER_H_
+#define UTILS_FLASHLOADER_H_
+
+#include "stdint.h"
+
+/*
+ * RAM-resident flash loader used by DOTT (see FlashLoader in flash_loader.py and flash_loader_elf in dott.ini) instead
+ * of the GDB server's generic flash loader. The loader is linked into a small RAM-only image together with a board
+ * specific port (DOTT_flash_port_xxx functions). The host downloads the image into RAM and streams commands (erase
+ * sector, program page) through a ring of RAM buffers: while the loader programs one buffer, the host fills the next
+ * one.
+ */
+
+/* Number of page buffers (at least two for double buffering) and size of each buffer in bytes. */
+#ifndef DOTT_FLASH_LOADER_NUM_BUFS
+#define DOTT_FLASH_LOADER_NUM_BUFS 2
+#endif
+#ifndef DOTT_FLASH_LOADER_PAGE_SIZE
+#define DOTT_FLASH_LOADER_PAGE_SIZE 1024
+#endif
+
+/* Size of the loader's stack (in 32 bit words). The host sets the stack pointer to its end. */
+#ifndef DOTT_FLASH_LOADER_STACK_WORDS
+#define DOTT_FLASH_LOADER_STACK_WORDS 128
+#endif
+
+#define DOTT_FLASH_LOADER_MAGIC 0x464C4453UL /* 'SDLF' */
+
+/* commands */
+#define DOTT_FLASH_OP_ERASE   1U /* erase the sector starting at addr (len: sector size) */
+#define DOTT_FLASH_OP_PROGRAM 2U /* program len bytes of the command's buffer to addr */
+#define DOTT_FLASH_OP_EXIT    3U /* stop the loader */
+
+/* command states */
+#define DOTT_FLASH_STATE_EMPTY 0U /* buffer can be filled by the host */
+#define DOTT_FLASH_STATE_FULL  1U /* command posted by the host */
+#define DOTT_FLASH_STATE_BUSY  2U /* command is being executed */
+#define DOTT_FLASH_STATE_DONE  3U /* command completed successfully (buffer can be refilled) */
+#define DOTT_FLASH_STATE_ERROR 4U /* command failed (see error) */
+
+typedef struct {
+    uint32_t op;             /* DOTT_FLASH_OP_xxx */
+    uint32_t addr;           /* flash address */
+    uint32_t len;            /* number of bytes */
+    volatile uint32_t state; /* DOTT_FLASH_STATE_xxx (written last by the host and by the loader) */
+    uint32_t error;          /* error code returned by the port (if state is DOTT_FLASH_STATE_ERROR) */
+} DOTT_flash_cmd_t;
+
+typedef struct {
+    uint32_t magic;                               /* DOTT_FLASH_LOADER_MAGIC */
+    uint32_t page_size;                           /* size of each buffer */
+    uint32_t num_bufs;                            /* number of buffers (and commands) */
+    uint32_t halt_when_idle;                      /* if not 0, the loader halts (bkpt) if no command is pending */
+    uint32_t next;                                /* index of the next command to be executed */
+    int32_t init_result;                          /* result of DOTT_flash_port_init */
+    uint32_t bufs[DOTT_FLASH_LOADER_NUM_BUFS];    /* buffer addresses */
+    DOTT_flash_cmd_t cmds[DOTT_FLASH_LOADER_NUM_BUFS];
+} DOTT_flash_loader_ctrl_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern volatile DOTT_flash_loader_ctrl_t DOTT_flash_loader_ctrl;
+extern uint32_t DOTT_flash_loader_stack[DOTT_FLASH_LOADER_STACK_WORDS];
+
+/*
+ * Entry point of the loader (the host sets the PC to it). Executes the posted commands in ring order. If
+ * halt_when_idle is set, the loader halts once no command is pending and the host restarts it after posting the next
+ * commands. Otherwise, it waits for commands (posted by the host while the target is running) until the EXIT command.
+ */
+void DOTT_flash_loader_run(void);
+
+/*
+ * Board specific port. All functions return 0 on success or a (port specific) error code otherwise.
+ */
+int32_t DOTT_flash_port_init(void); /* called once before the first command (e.g., unlock flash, set wait states) */
+int32_t DOTT_flash_port_erase(uint32_t addr, uint32_t len);
+int32_t DOTT_flash_port_program(uint32_t addr, const uint8_t *data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UTILS_FLASHLOADER_H_ */
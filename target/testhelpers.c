@@ -25,6 +25,13 @@
 
 #include "testhelpers.h"
 
+#if defined(DOTT_TEST_HOOK_MEM_SECTION)
+/* Scratchpad memory placed in a dedicated linker section (instead of the test hook's stack frame). The section has to
+ * be provided by the linker script (typically as NOLOAD section). The buffer is not (re-)initialized on entry of the
+ * test hook; the host zeroes memory when allocating from it. */
+uint32_t __attribute__ ((aligned (4), section (DOTT_STR(DOTT_TEST_HOOK_MEM_SECTION)))) DOTT_test_hook_mem[DOTT_TEST_HOOK_MEM_WORDS];
+#endif
+
 /**
  * This is the chained test hook which is used as entry point for the tests
  * executed on the host.
@@ -38,6 +45,593 @@ void DOTT_NO_OPTIMIZE DOTT_test_hook_chained(uint32_t *dbg_mem_u32, uint32_t dbg
 }
 
 
+#if defined(DOTT_CRC32_HW_STM32)
+#define DOTT_CRC_DR8      (*(volatile uint8_t *)(DOTT_CRC32_HW_BASE + 0x00UL))
+#define DOTT_CRC_DR       (*(volatile uint32_t *)(DOTT_CRC32_HW_BASE + 0x00UL))
+#define DOTT_CRC_CR       (*(volatile uint32_t *)(DOTT_CRC32_HW_BASE + 0x08UL))
+#define DOTT_CRC_INIT     (*(volatile uint32_t *)(DOTT_CRC32_HW_BASE + 0x10UL))
+#define DOTT_CRC_CR_RESET        0x00000001UL
+#define DOTT_CRC_CR_REV_IN_BYTE  0x00000020UL
+#define DOTT_CRC_CR_REV_OUT      0x00000080UL
+#else
+/* CRC-32 table for 4 bit at a time processing (small enough for Cortex-M0 class devices) */
+const uint32_t DOTT_crc32_table[16] = {
+    0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU, 0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+    0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU, 0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU
+};
+#endif
+
+/**
+ * Computes the CRC-32 (IEEE 802.3, same as zlib's crc32) of the given memory region. The function is called by the
+ * host (see TargetMem.crc) to detect changed memory blocks without transferring the memory content.
+ *
+ * \param data       Start of the memory region.
+ * \param num_bytes  Size of the memory region in bytes.
+ *
+ * \return CRC-32 of the memory region.
+ */
+uint32_t DOTT_NO_INLINE DOTT_mem_crc32(const uint8_t *data, uint32_t num_bytes)
+{
+#if defined(DOTT_CRC32_HW_STM32)
+    /* note: the CRC unit's clock has to be enabled by the application */
+    DOTT_CRC_INIT = 0xffffffffU;
+    DOTT_CRC_CR = DOTT_CRC_CR_REV_IN_BYTE | DOTT_CRC_CR_REV_OUT | DOTT_CRC_CR_RESET;
+    while (num_bytes-- > 0U) {
+        DOTT_CRC_DR8 = *data++;
+    }
+    return ~DOTT_CRC_DR;
+#else
+    uint32_t crc = 0xffffffffU;
+
+    while (num_bytes-- > 0U) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ DOTT_crc32_table[crc & 0xfU];
+        crc = (crc >> 4) ^ DOTT_crc32_table[crc & 0xfU];
+    }
+    return ~crc;
+#endif
+}
+
+
+#if defined(DOTT_DMA_STM32)
+#define DOTT_DMA_ISR   (*(volatile uint32_t *)(DOTT_DMA_BASE + 0x00UL))
+#define DOTT_DMA_IFCR  (*(volatile uint32_t *)(DOTT_DMA_BASE + 0x04UL))
+#define DOTT_DMA_CCR   (*(volatile uint32_t *)(DOTT_DMA_BASE + 0x08UL + 0x14UL * (DOTT_DMA_CHANNEL - 1U)))
+#define DOTT_DMA_CNDTR (*(volatile uint32_t *)(DOTT_DMA_BASE + 0x0CUL + 0x14UL * (DOTT_DMA_CHANNEL - 1U)))
+#define DOTT_DMA_CPAR  (*(volatile uint32_t *)(DOTT_DMA_BASE + 0x10UL + 0x14UL * (DOTT_DMA_CHANNEL - 1U)))
+#define DOTT_DMA_CMAR  (*(volatile uint32_t *)(DOTT_DMA_BASE + 0x14UL + 0x14UL * (DOTT_DMA_CHANNEL - 1U)))
+#define DOTT_DMA_ISR_TCIF  (0x2UL << (4U * (DOTT_DMA_CHANNEL - 1U)))
+#define DOTT_DMA_ISR_TEIF  (0x8UL << (4U * (DOTT_DMA_CHANNEL - 1U)))
+#define DOTT_DMA_IFCR_CGIF (0x1UL << (4U * (DOTT_DMA_CHANNEL - 1U)))
+#define DOTT_DMA_CCR_EN      0x00000001UL
+#define DOTT_DMA_CCR_PINC    0x00000040UL
+#define DOTT_DMA_CCR_MINC    0x00000080UL
+#define DOTT_DMA_CCR_WORDS   0x00000A00UL /* PSIZE and MSIZE: 32 bit */
+#define DOTT_DMA_CCR_PL_HIGH 0x00002000UL
+#define DOTT_DMA_CCR_MEM2MEM 0x00004000UL
+#define DOTT_DMA_MAX_UNITS   0xFFFFUL
+
+/* source of DMA fills (the fill byte in all four bytes) */
+static volatile uint32_t DOTT_dma_fill;
+
+/**
+ * Transfers num_units units (bytes or words as given by ccr) from src (the "peripheral" side of a memory-to-memory
+ * transfer; incremented if ccr has PINC set) to dst. The core waits for the completion of each transfer.
+ *
+ * \return Number of units which were not transferred due to a transfer error (to be handled by the core).
+ */
+static uint32_t DOTT_dma_xfer(uint32_t dst, uint32_t src, uint32_t num_units, uint32_t ccr)
+{
+    uint32_t unit = ((ccr & DOTT_DMA_CCR_WORDS) != 0U) ? 4U : 1U;
+    uint32_t n;
+
+    ccr |= DOTT_DMA_CCR_MEM2MEM | DOTT_DMA_CCR_PL_HIGH | DOTT_DMA_CCR_MINC;
+    while (num_units > 0U) {
+        n = (num_units > DOTT_DMA_MAX_UNITS) ? DOTT_DMA_MAX_UNITS : num_units;
+        DOTT_DMA_CCR = 0U;
+        DOTT_DMA_IFCR = DOTT_DMA_IFCR_CGIF;
+        DOTT_DMA_CPAR = src;
+        DOTT_DMA_CMAR = dst;
+        DOTT_DMA_CNDTR = n;
+        __asm__ __volatile__("dmb" ::: "memory");  /* note: pending writes of the core have to reach the memory first */
+        DOTT_DMA_CCR = ccr | DOTT_DMA_CCR_EN;
+        while ((DOTT_DMA_ISR & (DOTT_DMA_ISR_TCIF | DOTT_DMA_ISR_TEIF)) == 0U) {
+        }
+        DOTT_DMA_CCR = 0U;
+        if ((DOTT_DMA_ISR & DOTT_DMA_ISR_TEIF) != 0U) {
+            DOTT_DMA_IFCR = DOTT_DMA_IFCR_CGIF;
+            return num_units;
+        }
+        DOTT_DMA_IFCR = DOTT_DMA_IFCR_CGIF;
+        __asm__ __volatile__("dmb" ::: "memory");
+        if ((ccr & DOTT_DMA_CCR_PINC) != 0U) {
+            src += n * unit;
+        }
+        dst += n * unit;
+        num_units -= n;
+    }
+    return 0U;
+}
+#endif
+
+/**
+ * Copies num_bytes bytes from src to dst (non-overlapping). See DOTT_DMA_STM32 in testhelpers.h.
+ *
+ * \param dst        Destination.
+ * \param src        Source.
+ * \param num_bytes  Number of bytes.
+ */
+void DOTT_mem_copy(void *dst, const void *src, uint32_t num_bytes)
+{
+#if defined(DOTT_DMA_STM32)
+    uint32_t d = (uint32_t) (uintptr_t) dst;
+    uint32_t s = (uint32_t) (uintptr_t) src;
+    uint32_t done;
+
+    if (num_bytes >= DOTT_DMA_MIN_BYTES) {
+        if (((d | s) & 3U) == 0U) {
+            done = (num_bytes / 4U - DOTT_dma_xfer(d, s, num_bytes / 4U, DOTT_DMA_CCR_PINC | DOTT_DMA_CCR_WORDS)) * 4U;
+        } else {
+            done = num_bytes - DOTT_dma_xfer(d, s, num_bytes, DOTT_DMA_CCR_PINC);
+        }
+        dst = (uint8_t *) dst + done;
+        src = (const uint8_t *) src + done;
+        num_bytes -= done;
+    }
+#endif
+    memcpy(dst, src, num_bytes);
+}
+
+/**
+ * Fills num_bytes bytes at dst with val. See DOTT_DMA_STM32 in testhelpers.h.
+ *
+ * \param dst        Destination.
+ * \param val        Fill value.
+ * \param num_bytes  Number of bytes.
+ */
+void DOTT_mem_set(void *dst, uint8_t val, uint32_t num_bytes)
+{
+#if defined(DOTT_DMA_STM32)
+    uint32_t d = (uint32_t) (uintptr_t) dst;
+    uint32_t done;
+
+    if (num_bytes >= DOTT_DMA_MIN_BYTES) {
+        DOTT_dma_fill = 0x01010101UL * val;
+        if ((d & 3U) == 0U) {
+            done = (num_bytes / 4U - DOTT_dma_xfer(d, (uint32_t) (uintptr_t) &DOTT_dma_fill, num_bytes / 4U,
+                                                   DOTT_DMA_CCR_WORDS)) * 4U;
+        } else {
+            done = num_bytes - DOTT_dma_xfer(d, (uint32_t) (uintptr_t) &DOTT_dma_fill, num_bytes, 0U);
+        }
+        dst = (uint8_t *) dst + done;
+        num_bytes -= done;
+    }
+#endif
+    memset(dst, val, num_bytes);
+}
+
+
+volatile DOTT_call_mailbox_t DOTT_call_mailbox;
+
+typedef uint32_t (*DOTT_call_func_t)(uint32_t, uint32_t, uint32_t, uint32_t);
+
+/**
+ * Resident call stub used by the host (see Target.call) for fast target function calls. The host fills the mailbox,
+ * sets the PC to this function and resumes the target. The stub calls the function given in the mailbox and stops at
+ * a software breakpoint once the function has returned. The host then restores the interrupted register context.
+ */
+void DOTT_NO_INLINE DOTT_call_stub(void)
+{
+    DOTT_call_func_t func = (DOTT_call_func_t) (uintptr_t) DOTT_call_mailbox.func;
+
+    DOTT_call_mailbox.ret = func(DOTT_call_mailbox.args[0], DOTT_call_mailbox.args[1],
+                                 DOTT_call_mailbox.args[2], DOTT_call_mailbox.args[3]);
+    DOTT_call_mailbox.state = DOTT_CALL_DONE;
+    for (;;) {
+        __asm volatile("bkpt #0x02");
+    }
+}
+
+
+/**
+ * Function call sweep driver. Calls the function given in the descriptor for each row of the argument table and
+ * stores the return values in the result table. The host (see Target.sweep) uploads the argument table and calls
+ * this function via the resident call stub such that many calls only cost a single target resume.
+ *
+ * \param desc  Sweep descriptor.
+ *
+ * \return Number of performed calls.
+ */
+uint32_t DOTT_NO_INLINE DOTT_call_sweep(const DOTT_sweep_desc_t *desc)
+{
+    DOTT_call_func_t func = (DOTT_call_func_t) (uintptr_t) desc->func;
+    const uint32_t *args = (const uint32_t *) (uintptr_t) desc->args;
+    uint32_t *results = (uint32_t *) (uintptr_t) desc->results;
+    uint32_t a[DOTT_CALL_MAX_ARGS];
+    uint32_t row;
+    uint32_t i;
+
+    for (row = 0U; row < desc->num_rows; row++) {
+        for (i = 0U; i < DOTT_CALL_MAX_ARGS; i++) {
+            a[i] = (i < desc->num_args) ? args[i] : 0U;
+        }
+        results[row] = func(a[0], a[1], a[2], a[3]);
+        args += desc->num_args;
+    }
+    return row;
+}
+
+
+#if defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_8M_BASE__)
+/* no DWT cycle counter; SysTick (24 bit down counter clocked by the core clock) is used instead */
+#define DOTT_SYST_CSR   (*(volatile uint32_t *)0xE000E010UL)
+#define DOTT_SYST_RVR   (*(volatile uint32_t *)0xE000E014UL)
+#define DOTT_SYST_CVR   (*(volatile uint32_t *)0xE000E018UL)
+#define DOTT_SYST_CSR_ENABLE_CLKSOURCE 0x00000005UL
+#define DOTT_SYST_CSR_COUNTFLAG        0x00010000UL
+#else
+#define DOTT_DEMCR      (*(volatile uint32_t *)0xE000EDFCUL)
+#define DOTT_DWT_CTRL   (*(volatile uint32_t *)0xE0001000UL)
+#define DOTT_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004UL)
+#define DOTT_DEMCR_TRCENA         0x01000000UL
+#define DOTT_DWT_CTRL_CYCCNTENA   0x00000001UL
+#endif
+
+/**
+ * Calls the function of the sweep descriptor once per row of the argument table and stores the number of CPU cycles
+ * taken by each call in the result table.
+ *
+ * \param desc  Sweep descriptor (see DOTT_sweep_desc_t).
+ *
+ * \return Number of performed calls.
+ */
+uint32_t DOTT_NO_INLINE DOTT_call_bench(const DOTT_sweep_desc_t *desc)
+{
+    DOTT_call_func_t func = (DOTT_call_func_t) (uintptr_t) desc->func;
+    const uint32_t *args = (const uint32_t *) (uintptr_t) desc->args;
+    uint32_t *results = (uint32_t *) (uintptr_t) desc->results;
+    uint32_t a[DOTT_CALL_MAX_ARGS];
+    uint32_t row;
+    uint32_t i;
+    uint32_t start;
+#if defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_8M_BASE__)
+    uint32_t syst_csr = DOTT_SYST_CSR;
+    uint32_t syst_rvr = DOTT_SYST_RVR;
+
+    DOTT_SYST_CSR = 0U;
+    DOTT_SYST_RVR = 0x00FFFFFFUL;
+    DOTT_SYST_CVR = 0U;
+    DOTT_SYST_CSR = DOTT_SYST_CSR_ENABLE_CLKSOURCE; /* note: SysTick interrupt is disabled while benchmarking */
+#else
+    DOTT_DEMCR |= DOTT_DEMCR_TRCENA;
+    DOTT_DWT_CTRL |= DOTT_DWT_CTRL_CYCCNTENA;
+#endif
+
+    for (row = 0U; row < desc->num_rows; row++) {
+        for (i = 0U; i < DOTT_CALL_MAX_ARGS; i++) {
+            a[i] = (i < desc->num_args) ? args[i] : 0U;
+        }
+#if defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_8M_BASE__)
+        (void) DOTT_SYST_CSR; /* clears COUNTFLAG */
+        start = DOTT_SYST_CVR;
+        (void) func(a[0], a[1], a[2], a[3]);
+        results[row] = (start - DOTT_SYST_CVR) & 0x00FFFFFFUL;
+        if ((DOTT_SYST_CSR & DOTT_SYST_CSR_COUNTFLAG) != 0U) {
+            results[row] = 0xFFFFFFFFUL; /* counter wrapped; call took too long to be measured */
+        }
+#else
+        start = DOTT_DWT_CYCCNT;
+        (void) func(a[0], a[1], a[2], a[3]);
+        results[row] = DOTT_DWT_CYCCNT - start;
+#endif
+        args += desc->num_args;
+    }
+
+#if defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_8M_BASE__)
+    DOTT_SYST_CSR = 0U;
+    DOTT_SYST_RVR = syst_rvr;
+    DOTT_SYST_CVR = 0U;
+    DOTT_SYST_CSR = syst_csr;
+#endif
+    return row;
+}
+
+/**
+ * Empty function which is benchmarked by the host to determine the measurement overhead of DOTT_call_bench.
+ */
+uint32_t DOTT_NO_INLINE DOTT_bench_nop(void)
+{
+    return 0U;
+}
+
+
+/**
+ * Fuzzing driver. Restores the state region from its pristine copy and calls the function under test for each record
+ * of the input table. The index of the current input is kept in the descriptor such that the host can attribute
+ * coverage probe hits and faults to the input which caused them.
+ *
+ * \param desc  Fuzzing descriptor (see DOTT_fuzz_desc_t).
+ *
+ * \return Number of performed calls.
+ */
+uint32_t DOTT_NO_INLINE DOTT_fuzz_run(volatile DOTT_fuzz_desc_t *desc)
+{
+    DOTT_call_func_t func = (DOTT_call_func_t) (uintptr_t) desc->func;
+    const uint32_t *rec = (const uint32_t *) (uintptr_t) desc->inputs;
+    uint32_t *results = (uint32_t *) (uintptr_t) desc->results;
+    uint32_t i;
+
+    for (i = 0U; i < desc->num_inputs; i++) {
+        if (desc->state_size != 0U) {
+            DOTT_mem_copy((void *) (uintptr_t) desc->state, (const void *) (uintptr_t) desc->state_copy,
+                          desc->state_size);
+        }
+        desc->current = i;
+        results[i] = func(rec[1], rec[2], rec[3], rec[4]);
+        rec += 5U + ((rec[0] + 3U) / 4U);
+    }
+    desc->current = i;
+    return i;
+}
+
+
+/**
+ * Decodes run-length encoded data (see DOTT_BATCH_UNRLE in testhelpers.h).
+ *
+ * \param dst        Destination of the decoded data.
+ * \param src        Encoded data.
+ * \param num_bytes  Size of the encoded data in bytes.
+ *
+ * \return Number of bytes written to dst.
+ */
+static uint32_t DOTT_rle_decode(uint8_t *dst, const uint8_t *src, uint32_t num_bytes)
+{
+    const uint8_t *end = src + num_bytes;
+    uint8_t *out = dst;
+    uint32_t n;
+
+    while (src < end) {
+        n = *src++;
+        if ((n & 0x80U) == 0U) {
+            n += 1U;
+            DOTT_mem_copy(out, src, n);
+            src += n;
+        } else {
+            n = (n & 0x7FU) + 3U;
+            DOTT_mem_set(out, *src++, n);
+        }
+        out += n;
+    }
+    return (uint32_t) (out - dst);
+}
+
+
+/**
+ * Batch executor. Runs the memory and call commands of the given table (uploaded by the host, see Target.batch) in
+ * order and stores the result of each command in the table. The host reads the table back afterwards such that a
+ * whole batch costs one target resume and a few bulk memory transfers.
+ *
+ * \param cmds      Command table.
+ * \param num_cmds  Number of commands in the table.
+ *
+ * \return Number of executed commands.
+ */
+uint32_t DOTT_NO_INLINE DOTT_batch_run(DOTT_batch_cmd_t *cmds, uint32_t num_cmds)
+{
+    DOTT_batch_cmd_t *cmd;
+    uint32_t i;
+
+    for (i = 0U; i < num_cmds; i++) {
+        cmd = &cmds[i];
+        switch (cmd->op) {
+        case DOTT_BATCH_MEMCPY:
+            DOTT_mem_copy((void *) (uintptr_t) cmd->p[0], (const void *) (uintptr_t) cmd->p[1], cmd->p[2]);
+            cmd->ret = 0U;
+            break;
+        case DOTT_BATCH_MEMSET:
+            DOTT_mem_set((void *) (uintptr_t) cmd->p[0], (uint8_t) cmd->p[1], cmd->p[2]);
+            cmd->ret = 0U;
+            break;
+        case DOTT_BATCH_CRC32:
+            cmd->ret = DOTT_mem_crc32((const uint8_t *) (uintptr_t) cmd->p[0], cmd->p[1]);
+            break;
+        case DOTT_BATCH_CALL:
+            cmd->ret = ((DOTT_call_func_t) (uintptr_t) cmd->p[0])(cmd->p[1], cmd->p[2], cmd->p[3], cmd->p[4]);
+            break;
+        case DOTT_BATCH_UNRLE:
+            cmd->ret = DOTT_rle_decode((uint8_t *) (uintptr_t) cmd->p[0], (const uint8_t *) (uintptr_t) cmd->p[1],
+                                       cmd->p[2]);
+            break;
+        default:
+            return i;
+        }
+    }
+    return i;
+}
+
+
+/**
+ * Paints the stack from bottom up to the current stack pointer with the pattern (see StackMonitor).
+ *
+ * \param bottom   Lowest address of the stack.
+ * \param pattern  Paint pattern.
+ *
+ * \return End (exclusive) of the painted region.
+ */
+uint32_t DOTT_NO_INLINE DOTT_stack_paint(uint32_t bottom, uint32_t pattern)
+{
+    uint32_t sp;
+    volatile uint32_t *p = (volatile uint32_t *) (uintptr_t) ((bottom + 3U) & ~3U);
+
+    /* note: the loop does not use the stack; words below the stack pointer are free */
+    __asm volatile("mov %0, sp" : "=r" (sp));
+    while ((uint32_t) (uintptr_t) p < (sp & ~3U)) {
+        *p++ = pattern;
+    }
+    return sp & ~3U;
+}
+
+
+/**
+ * Searches the painted stack region for the lowest word which has been overwritten (the high-water mark).
+ *
+ * \param bottom   Lowest address of the stack.
+ * \param end      End (exclusive) of the painted region (see DOTT_stack_paint).
+ * \param pattern  Paint pattern.
+ *
+ * \return Address of the lowest overwritten word or end if the painted region is unchanged.
+ */
+uint32_t DOTT_NO_INLINE DOTT_stack_scan(uint32_t bottom, uint32_t end, uint32_t pattern)
+{
+    const volatile uint32_t *p = (const volatile uint32_t *) (uintptr_t) ((bottom + 3U) & ~3U);
+
+    while (((uint32_t) (uintptr_t) p < end) && (*p == pattern)) {
+        p++;
+    }
+    return (uint32_t) (uintptr_t) p;
+}
+
+
+#if defined(DOTT_RTT)
+/* RTT buffer descriptor (layout as expected by J-Link, see SEGGER_RTT_BUFFER_UP/DOWN) */
+typedef struct {
+    const char *name;
+    char *buffer;
+    uint32_t size;
+    volatile uint32_t wr_off;
+    volatile uint32_t rd_off;
+    uint32_t flags;
+} DOTT_rtt_buffer_t;
+
+/* RTT control block (layout as expected by J-Link, see SEGGER_RTT_CB) */
+typedef struct {
+    char id[16];
+    int32_t max_num_up;
+    int32_t max_num_down;
+    DOTT_rtt_buffer_t up[1];
+    DOTT_rtt_buffer_t down[1];
+} DOTT_rtt_cb_t;
+
+DOTT_rtt_cb_t _SEGGER_RTT;
+static char DOTT_rtt_up_buffer[DOTT_RTT_UP_BUFFER_SIZE];
+static char DOTT_rtt_down_buffer[DOTT_RTT_DOWN_BUFFER_SIZE];
+
+/**
+ * Initializes the RTT control block. The ID (which is searched for by J-Link) is written last and is composed at
+ * runtime such that J-Link does not find a copy of it in the initialization data.
+ */
+void DOTT_rtt_init(void)
+{
+    memset(&_SEGGER_RTT, 0, sizeof(_SEGGER_RTT));
+    _SEGGER_RTT.max_num_up = 1;
+    _SEGGER_RTT.max_num_down = 1;
+    _SEGGER_RTT.up[0].name = "DOTT";
+    _SEGGER_RTT.up[0].buffer = DOTT_rtt_up_buffer;
+    _SEGGER_RTT.up[0].size = sizeof(DOTT_rtt_up_buffer);
+    _SEGGER_RTT.down[0].name = "DOTT";
+    _SEGGER_RTT.down[0].buffer = DOTT_rtt_down_buffer;
+    _SEGGER_RTT.down[0].size = sizeof(DOTT_rtt_down_buffer);
+
+    strcpy(&_SEGGER_RTT.id[7], "RTT");
+    __asm__ __volatile__("" ::: "memory");
+    strcpy(&_SEGGER_RTT.id[0], "SEGGER");
+    _SEGGER_RTT.id[6] = ' ';
+}
+
+/**
+ * Writes data to the RTT up buffer without blocking. If the host does not read fast enough, only the part of the data
+ * which fits into the buffer is written.
+ *
+ * \param data       Data to be written.
+ * \param num_bytes  Number of bytes to be written.
+ *
+ * \return Number of bytes written.
+ */
+uint32_t DOTT_rtt_write(const void *data, uint32_t num_bytes)
+{
+    DOTT_rtt_buffer_t *up = &_SEGGER_RTT.up[0];
+    const uint8_t *src = (const uint8_t *) data;
+    uint32_t wr, rd, avail, i;
+
+    if (_SEGGER_RTT.id[0] == '\0') {
+        DOTT_rtt_init();
+    }
+
+    wr = up->wr_off;
+    rd = up->rd_off;
+    avail = (rd > wr) ? (rd - wr - 1U) : (up->size - (wr - rd) - 1U);
+    if (num_bytes > avail) {
+        num_bytes = avail;
+    }
+    for (i = 0U; i < num_bytes; i++) {
+        up->buffer[wr] = (char) src[i];
+        wr = (wr + 1U == up->size) ? 0U : (wr + 1U);
+    }
+    __asm__ __volatile__("" ::: "memory"); /* data has to be in the buffer before the write offset is updated */
+    up->wr_off = wr;
+    return num_bytes;
+}
+
+/**
+ * Reads data written by the host from the RTT down buffer without blocking.
+ *
+ * \param data       Destination buffer.
+ * \param num_bytes  Maximum number of bytes to be read.
+ *
+ * \return Number of bytes read.
+ */
+uint32_t DOTT_rtt_read(void *data, uint32_t num_bytes)
+{
+    DOTT_rtt_buffer_t *down = &_SEGGER_RTT.down[0];
+    uint8_t *dst = (uint8_t *) data;
+    uint32_t wr, rd, i = 0U;
+
+    if (_SEGGER_RTT.id[0] == '\0') {
+        DOTT_rtt_init();
+    }
+
+    rd = down->rd_off;
+    wr = down->wr_off;
+    while ((i < num_bytes) && (rd != wr)) {
+        dst[i++] = (uint8_t) down->buffer[rd];
+        rd = (rd + 1U == down->size) ? 0U : (rd + 1U);
+    }
+    __asm__ __volatile__("" ::: "memory");
+    down->rd_off = rd;
+    return i;
+}
+#endif
+
+
+#if defined(DOTT_STREAM)
+DOTT_stream_t DOTT_stream;
+
+/**
+ * Reads data injected by the host into the stream ring buffer without blocking.
+ *
+ * \param data       Destination buffer.
+ * \param num_bytes  Maximum number of bytes to be read.
+ *
+ * \return Number of bytes read.
+ */
+uint32_t DOTT_stream_read(void *data, uint32_t num_bytes)
+{
+    uint8_t *dst = (uint8_t *) data;
+    uint32_t head = DOTT_stream.head;
+    uint32_t tail = DOTT_stream.tail;
+    uint32_t i = 0U;
+
+    while ((i < num_bytes) && (tail != head)) {
+        dst[i++] = DOTT_stream.buffer[tail];
+        tail = (tail + 1U == DOTT_STREAM_BUFFER_SIZE) ? 0U : (tail + 1U);
+    }
+    __asm__ __volatile__("" ::: "memory"); /* data has to be read before the buffer space is released */
+    DOTT_stream.tail = tail;
+    return i;
+}
+#endif
+
+
 /**
  * This method is used as entry point for debugger-based on target testing.
  * Note: For this function optimization is intentionally disabled to ensure that all variables and especially the label
@@ -45,14 +639,261 @@ void DOTT_NO_OPTIMIZE DOTT_test_hook_chained(uint32_t *dbg_mem_u32, uint32_t dbg
  */
 void DOTT_NO_OPTIMIZE DOTT_test_hook(void)
 {
+#if defined(DOTT_TEST_HOOK_MEM_SECTION)
+    uint32_t *dbg_mem_u32 = DOTT_test_hook_mem;
+    uint32_t dbg_mem_u32_sz = sizeof(DOTT_test_hook_mem);
+#else
     /* word-aligned junk of memory */
-    uint32_t __attribute__ ((aligned (4))) dbg_mem_u32[64] = { 0, };
+    uint32_t __attribute__ ((aligned (4))) dbg_mem_u32[DOTT_TEST_HOOK_MEM_WORDS] = { 0, };
+    uint32_t dbg_mem_u32_sz = sizeof(dbg_mem_u32);
+#endif
+    /* reference the host-called helpers such that they are not removed by the linker */
+    __asm__ __volatile__("" :: "r" (DOTT_mem_crc32), "r" (DOTT_call_stub), "r" (DOTT_call_sweep));
+    __asm__ __volatile__("" :: "r" (DOTT_call_bench), "r" (DOTT_bench_nop), "r" (DOTT_batch_run));
+    __asm__ __volatile__("" :: "r" (DOTT_stack_paint), "r" (DOTT_stack_scan), "r" (DOTT_fuzz_run));
     goto test_start; /* silence gcc's 'unused label' warning; the label is not used in the code but for the tests */
 
 test_start:
 
-    DOTT_test_hook_chained(dbg_mem_u32, sizeof(dbg_mem_u32));
+    DOTT_test_hook_chained(dbg_mem_u32, dbg_mem_u32_sz);
+}
+
+
+volatile DOTT_host_call_mailbox_t DOTT_host_call_mailbox;
+
+void DOTT_NO_INLINE DOTT_host_call_bp(void)
+{
+    __asm volatile("nop");
+}
+
+/**
+ * Requests a service from the host. The request is stored in the mailbox which is serviced by the host (see
+ * HostCallPoint) when DOTT_host_call_bp is reached. The target only halts for as long as GDB needs to service the
+ * request.
+ *
+ * \param id   Service (DOTT_HOST_CALL_xxx).
+ * \param buf  Data passed to or returned by the host.
+ * \param len  Size of the buffer in bytes.
+ *
+ * \return Result of the service or DOTT_HOST_CALL_UNHANDLED.
+ */
+int32_t DOTT_NO_INLINE DOTT_host_call(uint32_t id, void *buf, uint32_t len)
+{
+    DOTT_host_call_mailbox.id = id;
+    DOTT_host_call_mailbox.buf = (uint32_t) (uintptr_t) buf;
+    DOTT_host_call_mailbox.len = len;
+    DOTT_host_call_mailbox.ret = DOTT_HOST_CALL_UNHANDLED;
+    DOTT_host_call_bp();
+    return DOTT_host_call_mailbox.ret;
+}
+
+
+#if defined(DOTT_FAULT_HOOK)
+volatile DOTT_fault_info_t DOTT_fault_info;
+
+/**
+ * Saves the exception frame (and the fault status registers) to DOTT_fault_info and halts. Called by DOTT_fault_hook.
+ *
+ * \param frame       Stacked exception frame.
+ * \param exc_return  EXC_RETURN value of the exception.
+ */
+void DOTT_NO_INLINE DOTT_fault_save(const uint32_t *frame, uint32_t exc_return)
+{
+    DOTT_fault_info.r0 = frame[0];
+    DOTT_fault_info.r1 = frame[1];
+    DOTT_fault_info.r2 = frame[2];
+    DOTT_fault_info.r3 = frame[3];
+    DOTT_fault_info.r12 = frame[4];
+    DOTT_fault_info.lr = frame[5];
+    DOTT_fault_info.pc = frame[6];
+    DOTT_fault_info.xpsr = frame[7];
+    DOTT_fault_info.exc_return = exc_return;
+    DOTT_fault_info.sp = (uint32_t) (uintptr_t) frame;
+#if defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_8M_BASE__)
+    DOTT_fault_info.cfsr = 0U;
+    DOTT_fault_info.hfsr = 0U;
+    DOTT_fault_info.mmfar = 0U;
+    DOTT_fault_info.bfar = 0U;
+#else
+    DOTT_fault_info.cfsr = *(volatile uint32_t *) 0xE000ED28UL;
+    DOTT_fault_info.hfsr = *(volatile uint32_t *) 0xE000ED2CUL;
+    DOTT_fault_info.mmfar = *(volatile uint32_t *) 0xE000ED34UL;
+    DOTT_fault_info.bfar = *(volatile uint32_t *) 0xE000ED38UL;
+#endif
+    for (;;) {
+        __asm volatile("bkpt #0x04");
+    }
+}
+
+/**
+ * Fault handler which selects the stack the exception frame was pushed to (bit 2 of EXC_RETURN) and passes it to
+ * DOTT_fault_save. Only uses instructions available on all Cortex-M cores.
+ */
+void __attribute__((naked)) DOTT_fault_hook(void)
+{
+    __asm volatile(
+            "movs r0, #4\n\t"
+            "mov r1, lr\n\t"
+            "tst r0, r1\n\t"
+            "beq 1f\n\t"
+            "mrs r0, psp\n\t"
+            "b DOTT_fault_save\n\t"
+            "1:\n\t"
+            "mrs r0, msp\n\t"
+            "b DOTT_fault_save\n\t"
+    );
+}
+
+#if !defined(DOTT_FAULT_HOOK_NO_HANDLER)
+void __attribute__((naked)) HardFault_Handler(void)
+{
+    __asm volatile("b DOTT_fault_hook");
+}
+#endif
+#endif
+
+
+#if defined(DOTT_HEAP_TRACE)
+#include "stddef.h"
+
+#if defined(__ARMCC_VERSION)
+#define DOTT_HEAP_REAL(FUNC) $Super$$##FUNC
+#define DOTT_HEAP_WRAP(FUNC) $Sub$$##FUNC
+#else
+#define DOTT_HEAP_REAL(FUNC) __real_##FUNC
+#define DOTT_HEAP_WRAP(FUNC) __wrap_##FUNC
+#endif
+
+extern void *DOTT_HEAP_REAL(malloc)(size_t size);
+extern void *DOTT_HEAP_REAL(calloc)(size_t num, size_t size);
+extern void *DOTT_HEAP_REAL(realloc)(void *ptr, size_t size);
+extern void DOTT_HEAP_REAL(free)(void *ptr);
+
+DOTT_heap_trace_t __attribute__((used)) DOTT_heap_trace = {0U, DOTT_HEAP_TRACE_ENTRIES, {{0U, 0U, 0U, 0U}}};
+
+/**
+ * Adds an event to the heap trace (overwriting the oldest event if the ring buffer is full).
+ *
+ * \param op      DOTT_HEAP_OP_xxx.
+ * \param ptr     Address of the block.
+ * \param size    Requested size in bytes.
+ * \param caller  Return address of the wrapped call.
+ */
+static void DOTT_heap_record(uint32_t op, const void *ptr, size_t size, const void *caller)
+{
+    uint32_t head = DOTT_heap_trace.head;
+    DOTT_heap_event_t *ev = &DOTT_heap_trace.events[head % DOTT_HEAP_TRACE_ENTRIES];
+
+    ev->op = op;
+    ev->ptr = (uint32_t) (uintptr_t) ptr;
+    ev->size = (uint32_t) size;
+    ev->caller = (uint32_t) (uintptr_t) caller;
+    DOTT_heap_trace.head = head + 1U;
+}
+
+void *DOTT_HEAP_WRAP(malloc)(size_t size)
+{
+    void *ptr = DOTT_HEAP_REAL(malloc)(size);
+    DOTT_heap_record(DOTT_HEAP_OP_ALLOC, ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *DOTT_HEAP_WRAP(calloc)(size_t num, size_t size)
+{
+    void *ptr = DOTT_HEAP_REAL(calloc)(num, size);
+    DOTT_heap_record(DOTT_HEAP_OP_ALLOC, ptr, num * size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *DOTT_HEAP_WRAP(realloc)(void *ptr, size_t size)
+{
+    void *new_ptr = DOTT_HEAP_REAL(realloc)(ptr, size);
+    /* recorded as release of the old block and allocation of the new one (the old block remains if realloc fails) */
+    if ((ptr != NULL) && ((new_ptr != NULL) || (size == 0U))) {
+        DOTT_heap_record(DOTT_HEAP_OP_FREE, ptr, 0U, __builtin_return_address(0));
+    }
+    if (size != 0U) {
+        DOTT_heap_record(DOTT_HEAP_OP_ALLOC, new_ptr, size, __builtin_return_address(0));
+    }
+    return new_ptr;
+}
+
+void DOTT_HEAP_WRAP(free)(void *ptr)
+{
+    DOTT_HEAP_REAL(free)(ptr);
+    if (ptr != NULL) {
+        DOTT_heap_record(DOTT_HEAP_OP_FREE, ptr, 0U, __builtin_return_address(0));
+    }
+}
+#endif
+
+
+#if defined(DOTT_IRQ_LATENCY)
+DOTT_irq_latency_t __attribute__((used)) DOTT_irq_latency = {0U, DOTT_IRQ_LATENCY_ENTRIES, {{0U, 0U}}};
+
+/**
+ * Adds an interrupt latency sample to the ring buffer (overwriting the oldest sample if the buffer is full). Interrupts
+ * are masked while the sample is written such that nested handlers do not write the same slot.
+ *
+ * \param t_enter  Ticks since the interrupt event at handler entry.
+ * \param t_exit   Ticks since the interrupt event at handler exit.
+ */
+void DOTT_irq_latency_record(uint32_t t_enter, uint32_t t_exit)
+{
+    uint32_t primask;
+    __asm__ __volatile__("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+
+    uint32_t head = DOTT_irq_latency.head;
+    DOTT_irq_sample_t *s = &DOTT_irq_latency.samples[head % DOTT_IRQ_LATENCY_ENTRIES];
+    s->latency = t_enter;
+    s->duration = t_exit - t_enter;
+    DOTT_irq_latency.head = head + 1U;
+
+    __asm__ __volatile__("msr primask, %0" :: "r" (primask) : "memory");
+}
+#endif
+
+#if defined(DOTT_DEFERRED_LOG)
+#if defined(DOTT_LOG_TIMESTAMP)
+#define DOTT_LOG_TIMESTAMP_WORDS 1U
+#else
+#define DOTT_LOG_TIMESTAMP_WORDS 0U
+#endif
+
+DOTT_log_t __attribute__((used)) DOTT_log = {0U, 0U, DOTT_LOG_BUFFER_WORDS,
+                                              DOTT_LOG_TIMESTAMP_WORDS * DOTT_LOG_FLAG_TIMESTAMP, 0U, {0U}};
+
+/**
+ * Adds a deferred log record to the ring buffer. The record is discarded (and counted in DOTT_log.dropped) if the
+ * buffer does not have enough free space. Interrupts are masked while the record is written such that nested callers
+ * do not interleave their records.
+ *
+ * \param header    Address of the format string ORed with the number of arguments.
+ * \param args      Arguments of the record.
+ * \param num_args  Number of arguments.
+ */
+void DOTT_log_write(uint32_t header, const uint32_t *args, uint32_t num_args)
+{
+    uint32_t primask;
+    __asm__ __volatile__("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+
+    uint32_t head = DOTT_log.head;
+    if (DOTT_LOG_BUFFER_WORDS - (head - DOTT_log.tail) < 1U + DOTT_LOG_TIMESTAMP_WORDS + num_args) {
+        DOTT_log.dropped++;
+    } else {
+        DOTT_log.words[head++ % DOTT_LOG_BUFFER_WORDS] = header;
+#if defined(DOTT_LOG_TIMESTAMP)
+        DOTT_log.words[head++ % DOTT_LOG_BUFFER_WORDS] = (uint32_t) (DOTT_LOG_TIMESTAMP);
+#endif
+        for (uint32_t i = 0U; i < num_args; i++) {
+            DOTT_log.words[head++ % DOTT_LOG_BUFFER_WORDS] = args[i];
+        }
+        DOTT_log.head = head;
+    }
+
+    __asm__ __volatile__("msr primask, %0" :: "r" (primask) : "memory");
 }
+#endif
 
 
 /**
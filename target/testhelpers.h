@@ -23,6 +23,8 @@
 #ifndef UTILS_TESTHELPERS_H_
 #define UTILS_TESTHELPERS_H_
 
+#include "stdint.h"
+
 /* Macro for different compilers to prevent optimization on a per-function
  * basis.
  */
@@ -39,6 +41,10 @@
     #error Unsupported compiler.
 #endif
 
+/* Macros to turn a (macro) argument into a string literal. */
+#define DOTT_STR_(X) #X
+#define DOTT_STR(X) DOTT_STR_(X)
+
 /* Macro to set a label which can then be used by DOTT-based tests. */
 #define DOTT_LABEL(NAME) __asm__("DOTT_LABEL_" NAME ":")
 #define DOTT_LABEL_SAFE(NAME) __asm("nop"); \
@@ -52,6 +58,38 @@
  */
 #define DOTT_VAR_KEEP(NAME) __asm__ __volatile__("" :: "m" (NAME));
 
+/*
+ * Sequence counter protocol for buffers which are read by the host while the target is running (see
+ * TargetDirect.read_consistent). The firmware increments a volatile uint32_t counter before and after modifying the
+ * buffer, i.e., the counter is odd while the buffer is being modified. For example:
+ *     DOTT_SEQ_WRITE_BEGIN(adc_seq);
+ *     memcpy(adc_buf, dma_buf, sizeof(adc_buf));
+ *     DOTT_SEQ_WRITE_END(adc_seq);
+ * The data memory barriers ensure that the counter updates are not reordered with the buffer accesses.
+ */
+#define DOTT_SEQ_WRITE_BEGIN(SEQ) do { (SEQ)++; __asm__ __volatile__("dmb" ::: "memory"); } while (0)
+#define DOTT_SEQ_WRITE_END(SEQ) do { __asm__ __volatile__("dmb" ::: "memory"); (SEQ)++; } while (0)
+
+/*
+ * Reserves the trace buffer of the Micro Trace Buffer (Cortex-M0+) which is used by the host (see MtbTrace). SIZE is
+ * the size in bytes (a power of two, at least 16); the buffer has to be located in the SRAM the MTB writes to.
+ */
+#define DOTT_MTB_BUFFER(SIZE) uint8_t DOTT_mtb_buffer[SIZE] __attribute__((aligned(SIZE), used))
+
+/*
+ * Size (in 32 bit words) of the scratchpad memory provided by DOTT_test_hook to the host for on-target memory
+ * allocation. Can be overridden at build time (e.g., -DDOTT_TEST_HOOK_MEM_WORDS=256).
+ */
+#ifndef DOTT_TEST_HOOK_MEM_WORDS
+#define DOTT_TEST_HOOK_MEM_WORDS 64
+#endif
+
+/*
+ * If defined (e.g., -DDOTT_TEST_HOOK_MEM_SECTION=.dott_scratch) the scratchpad memory is not placed on the stack
+ * of DOTT_test_hook but in a global buffer (DOTT_test_hook_mem) located in the given linker section. This allows for
+ * scratchpad sizes beyond what the stack can accommodate and for allocations outside of the test hook's context.
+ */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -62,11 +100,440 @@ extern "C" {
  */
 void DOTT_test_hook(void);
 
+#if defined(DOTT_TEST_HOOK_MEM_SECTION)
+/*
+ * Scratchpad memory of the test hook if placed in a dedicated linker section.
+ */
+extern uint32_t DOTT_test_hook_mem[DOTT_TEST_HOOK_MEM_WORDS];
+#endif
+
+/*
+ * CRC-32 of a memory region. Called by the host to detect modified memory blocks. By default, a 64 byte table is
+ * used (processing 4 bits at a time). If DOTT_CRC32_HW_STM32 is defined, the CRC unit of STM32 devices with
+ * programmable input/output reversal (e.g., STM32F0/F3/F7/G0/G4/L0/L4/H7) is used instead. Its base address is given
+ * by DOTT_CRC32_HW_BASE and its clock has to be enabled by the application.
+ */
+#if defined(DOTT_CRC32_HW_STM32) && !defined(DOTT_CRC32_HW_BASE)
+#define DOTT_CRC32_HW_BASE 0x40023000UL
+#endif
+
+uint32_t DOTT_mem_crc32(const uint8_t *data, uint32_t num_bytes);
+
+/*
+ * Bulk memory moves and fills of the batch executor, the RLE decoder and the fuzzing state restore (see DOTT_batch_run
+ * and DOTT_fuzz_run). By default, memcpy and memset are used. If DOTT_DMA_STM32 is defined, moves and fills of at least
+ * DOTT_DMA_MIN_BYTES bytes are performed by a memory-to-memory transfer of channel DOTT_DMA_CHANNEL (1..7) of the
+ * STM32 DMA controller (STM32F0/F1/F3/L0/L4/G0/G4 style, see RM0091) at DOTT_DMA_BASE. Word transfers are used if
+ * the addresses are word aligned (otherwise byte transfers); the remainder and regions the DMA can not access (transfer
+ * error) are handled by the core. The DMA clock has to be enabled by the application and the channel must not be used
+ * by it.
+ */
+#if defined(DOTT_DMA_STM32)
+#ifndef DOTT_DMA_BASE
+#define DOTT_DMA_BASE 0x40020000UL
+#endif
+#ifndef DOTT_DMA_CHANNEL
+#define DOTT_DMA_CHANNEL 7U
+#endif
+#ifndef DOTT_DMA_MIN_BYTES
+#define DOTT_DMA_MIN_BYTES 64U
+#endif
+#endif
+
+void DOTT_mem_copy(void *dst, const void *src, uint32_t num_bytes);
+void DOTT_mem_set(void *dst, uint8_t val, uint32_t num_bytes);
+
+/*
+ * Mailbox of the resident call stub (DOTT_call_stub). It is written by the host (see Target.call) to pass the function
+ * to be called and its arguments and read back for the return value.
+ */
+#define DOTT_CALL_MAX_ARGS 4U
+#define DOTT_CALL_PENDING  1U
+#define DOTT_CALL_DONE     2U
+
+typedef struct {
+    uint32_t func;                     /* address of the function to be called (Thumb bit set) */
+    uint32_t args[DOTT_CALL_MAX_ARGS]; /* arguments passed in r0..r3 */
+    uint32_t ret;                      /* return value (r0) */
+    uint32_t state;                    /* DOTT_CALL_PENDING (set by host) or DOTT_CALL_DONE (set by stub) */
+} DOTT_call_mailbox_t;
+
+extern volatile DOTT_call_mailbox_t DOTT_call_mailbox;
+
+/*
+ * Resident call stub. The host sets the PC to this function to call a target function without GDB's inferior call
+ * machinery. Not intended to be called from target code.
+ */
+void DOTT_call_stub(void);
+
+/*
+ * Descriptor of a function call sweep (see DOTT_call_sweep). Addresses are given as 32 bit words such that the
+ * host can set up the descriptor without knowing the target's pointer representation.
+ */
+typedef struct {
+    uint32_t func;     /* address of the function to be called (Thumb bit set) */
+    uint32_t num_args; /* number of arguments per row (at most DOTT_CALL_MAX_ARGS) */
+    uint32_t num_rows; /* number of rows (calls) in the argument table */
+    uint32_t args;     /* address of the argument table (num_rows * num_args words) */
+    uint32_t results;  /* address of the result table (num_rows words) */
+} DOTT_sweep_desc_t;
+
+/*
+ * Calls the function of the sweep descriptor once per row of the argument table. Called by the host (see
+ * Target.sweep) via the resident call stub.
+ */
+uint32_t DOTT_call_sweep(const DOTT_sweep_desc_t *desc);
+
+/*
+ * Like DOTT_call_sweep but stores the number of CPU cycles of each call (instead of its return value) in the result
+ * table. Cycles are measured with the DWT cycle counter or, on cores without DWT CYCCNT (Armv6-M, Armv8-M Baseline),
+ * with SysTick (calls taking 2^24 cycles or more are reported as 0xFFFFFFFF). Called by the host (see Target.bench).
+ */
+uint32_t DOTT_call_bench(const DOTT_sweep_desc_t *desc);
+
+/*
+ * Empty function used by the host to calibrate the measurement overhead of DOTT_call_bench.
+ */
+uint32_t DOTT_bench_nop(void);
+
+/*
+ * Descriptor of a fuzzing batch (see DOTT_fuzz_run). The input table holds one record per input: a word with the size
+ * of the input data, the four call arguments (computed by the host, e.g., the address and size of the data) and the
+ * data itself (padded to a multiple of four bytes).
+ */
+typedef struct {
+    uint32_t func;       /* address of the function under test (Thumb bit set) */
+    uint32_t num_inputs; /* number of records in the input table */
+    uint32_t inputs;     /* address of the input table */
+    uint32_t results;    /* address of the result table (num_inputs words) */
+    uint32_t state;      /* address of the state region restored before each call (0: no state restore) */
+    uint32_t state_copy; /* address of the pristine copy of the state region */
+    uint32_t state_size; /* size of the state region in bytes */
+    uint32_t current;    /* index of the input being processed (read by the host's coverage probes) */
+} DOTT_fuzz_desc_t;
+
+/*
+ * Calls the function of the fuzzing descriptor once per input record after restoring the state region. Called by the
+ * host (see Fuzzer) via the resident call stub. Returns the number of performed calls.
+ */
+uint32_t DOTT_fuzz_run(volatile DOTT_fuzz_desc_t *desc);
+
+/*
+ * Command of a batch executed by DOTT_batch_run. The host (see Target.batch) uploads a table of commands and runs all
+ * of them with a single target resume (via the resident call stub) instead of one or more MI round trips each.
+ */
+#define DOTT_BATCH_MEMCPY 1U /* p[0]: destination, p[1]: source, p[2]: number of bytes */
+#define DOTT_BATCH_MEMSET 2U /* p[0]: destination, p[1]: value, p[2]: number of bytes */
+#define DOTT_BATCH_CRC32  3U /* p[0]: address, p[1]: number of bytes; ret: CRC-32 (see DOTT_mem_crc32) */
+#define DOTT_BATCH_CALL   4U /* p[0]: function (Thumb bit set), p[1..4]: arguments; ret: return value */
+#define DOTT_BATCH_UNRLE  5U /* p[0]: destination, p[1]: RLE data, p[2]: size of RLE data; ret: bytes written */
+
+/*
+ * Run-length encoding used by DOTT_BATCH_UNRLE (compressed memory writes, see TargetMem.write). The data is a sequence
+ * of records starting with a control byte c: if bit 7 of c is clear, c + 1 literal bytes follow; otherwise, the next
+ * byte is repeated (c & 0x7F) + 3 times.
+ */
+
+typedef struct {
+    uint32_t op;   /* DOTT_BATCH_xxx */
+    uint32_t p[5]; /* parameters (addresses as 32 bit words) */
+    uint32_t ret;  /* result of the command (written by DOTT_batch_run) */
+} DOTT_batch_cmd_t;
+
+/*
+ * Executes the commands of the given table in order. Execution stops at the first unknown command. Called by the
+ * host via the resident call stub. Returns the number of executed commands.
+ */
+uint32_t DOTT_batch_run(DOTT_batch_cmd_t *cmds, uint32_t num_cmds);
+
+/*
+ * Stack high-water mark measurement (see StackMonitor). DOTT_stack_paint fills the unused part of the stack (from
+ * bottom up to the current stack pointer) with the given pattern and returns the end of the painted region.
+ * DOTT_stack_scan returns the address of the lowest word in [bottom, end) which no longer holds the pattern (end if
+ * all words are unchanged). Both are called by the host via the resident call stub.
+ */
+uint32_t DOTT_stack_paint(uint32_t bottom, uint32_t pattern);
+uint32_t DOTT_stack_scan(uint32_t bottom, uint32_t end, uint32_t pattern);
+
+#if defined(DOTT_RTT)
+/*
+ * If DOTT_RTT is defined, a minimal SEGGER RTT compatible control block (_SEGGER_RTT) with one up (target to host)
+ * and one down (host to target) buffer is provided which is read/written by the host (see TargetDirect.rtt_start)
+ * while the target is running. Do not define DOTT_RTT if the application uses SEGGER's RTT implementation.
+ */
+#ifndef DOTT_RTT_UP_BUFFER_SIZE
+#define DOTT_RTT_UP_BUFFER_SIZE 1024
+#endif
+#ifndef DOTT_RTT_DOWN_BUFFER_SIZE
+#define DOTT_RTT_DOWN_BUFFER_SIZE 64
+#endif
+
+/*
+ * Initializes the RTT control block. Called implicitly by DOTT_rtt_write and DOTT_rtt_read.
+ */
+void DOTT_rtt_init(void);
+
+/*
+ * Writes up to num_bytes to the up buffer (non-blocking). Returns the number of bytes written.
+ */
+uint32_t DOTT_rtt_write(const void *data, uint32_t num_bytes);
+
+/*
+ * Reads up to num_bytes from the down buffer (non-blocking). Returns the number of bytes read.
+ */
+uint32_t DOTT_rtt_read(void *data, uint32_t num_bytes);
+#endif
+
+#if defined(DOTT_STREAM)
+/*
+ * If DOTT_STREAM is defined, a ring buffer (DOTT_stream) is provided which is filled by the host via live access
+ * while the target is running (see TargetDirect.stream_inject). The host advances head after writing data, the
+ * firmware advances tail after consuming it (DOTT_stream_read); one byte of the buffer is kept free.
+ */
+#ifndef DOTT_STREAM_BUFFER_SIZE
+#define DOTT_STREAM_BUFFER_SIZE 4096
+#endif
+
+typedef struct {
+    volatile uint32_t head; /* write index (advanced by the host) */
+    volatile uint32_t tail; /* read index (advanced by the firmware) */
+    volatile uint8_t buffer[DOTT_STREAM_BUFFER_SIZE];
+} DOTT_stream_t;
+
+extern DOTT_stream_t DOTT_stream;
+
+/*
+ * Reads up to num_bytes injected by the host (non-blocking). Returns the number of bytes read.
+ */
+uint32_t DOTT_stream_read(void *data, uint32_t num_bytes);
+#endif
+
 /*
  * Add a software breakpoint.
  */
 void DOTT_break_here(void);
 
+/*
+ * Host calls: firmware requests a service of the host (see HostCallPoint). The request is passed in a mailbox and
+ * serviced by GDB (a no-stop breakpoint on DOTT_host_call_bp) without waking up the test. If the host does not service
+ * host calls, DOTT_host_call returns DOTT_HOST_CALL_UNHANDLED.
+ */
+#define DOTT_HOST_CALL_LOG      1U /* buf: text of len bytes which is added to the host-side log; returns len */
+#define DOTT_HOST_CALL_WRITE    2U /* buf: len bytes which are appended to the host-side file; returns len */
+#define DOTT_HOST_CALL_RANDOM   3U /* buf: filled with len random bytes; returns len */
+#define DOTT_HOST_CALL_STIMULUS 4U /* buf: filled with up to len bytes of stimulus queued by the host; returns count */
+
+#define DOTT_HOST_CALL_UNHANDLED (-1)
+
+typedef struct {
+    uint32_t id;  /* DOTT_HOST_CALL_xxx */
+    uint32_t buf; /* buffer address */
+    uint32_t len; /* buffer size in bytes */
+    int32_t ret;  /* result (written by the host) */
+} DOTT_host_call_mailbox_t;
+
+extern volatile DOTT_host_call_mailbox_t DOTT_host_call_mailbox;
+
+int32_t DOTT_host_call(uint32_t id, void *buf, uint32_t len);
+
+/*
+ * Location of the host's no-stop breakpoint. Not intended to be called directly.
+ */
+void DOTT_host_call_bp(void);
+
+#if defined(DOTT_FAULT_HOOK)
+/*
+ * If DOTT_FAULT_HOOK is defined, DOTT_fault_hook is provided as HardFault_Handler (the CMSIS name used by the vector
+ * tables of the device startup files; define DOTT_FAULT_HOOK_NO_HANDLER to wire DOTT_fault_hook into the vector table
+ * manually, e.g., also for MemManage, BusFault and UsageFault). The hook saves the stacked exception frame and the
+ * fault status registers to DOTT_fault_info and halts at a software breakpoint. The host (see Target) recognizes
+ * the halt and raises a TargetFaultException instead of waiting for a timeout.
+ */
+typedef struct {
+    uint32_t r0, r1, r2, r3, r12, lr, pc, xpsr; /* stacked exception frame */
+    uint32_t exc_return;                        /* EXC_RETURN value (LR on exception entry) */
+    uint32_t sp;                                /* stack pointer at the time of the fault (frame address) */
+    uint32_t cfsr, hfsr, mmfar, bfar;           /* fault status registers (0 on Armv6-M and Armv8-M Baseline) */
+} DOTT_fault_info_t;
+
+extern volatile DOTT_fault_info_t DOTT_fault_info;
+
+void DOTT_fault_hook(void);
+#endif
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+/*
+ * Writes to ITM stimulus ports which are captured by the host via SWO (see SwoCapture). The writes are dropped if the
+ * port is not enabled (e.g., no capture is active). Only available on cores with ITM (Cortex-M3 and higher).
+ */
+#define DOTT_ITM_STIM8(PORT)  (*(volatile uint8_t *)(0xE0000000UL + 4UL * (PORT)))
+#define DOTT_ITM_STIM32(PORT) (*(volatile uint32_t *)(0xE0000000UL + 4UL * (PORT)))
+#define DOTT_ITM_TER          (*(volatile uint32_t *)0xE0000E00UL)
+
+static inline void DOTT_itm_write8(uint32_t port, uint8_t value)
+{
+    if ((DOTT_ITM_TER & (1UL << port)) != 0U) {
+        while (DOTT_ITM_STIM32(port) == 0U) { } /* wait until the stimulus port FIFO is ready */
+        DOTT_ITM_STIM8(port) = value;
+    }
+}
+
+static inline void DOTT_itm_write32(uint32_t port, uint32_t value)
+{
+    if ((DOTT_ITM_TER & (1UL << port)) != 0U) {
+        while (DOTT_ITM_STIM32(port) == 0U) { }
+        DOTT_ITM_STIM32(port) = value;
+    }
+}
+#endif
+
+#if defined(DOTT_HEAP_TRACE)
+/*
+ * If DOTT_HEAP_TRACE is defined, malloc, calloc, realloc and free are wrapped and each call is recorded in the
+ * DOTT_heap_trace ring buffer which is read by the host after the test (see HeapTrace). GCC: link with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free (see DOTT_HEAP_TRACE in dott_gcc.mk). Arm Compiler: the
+ * wrappers are provided as $Sub$$malloc etc. and no linker option is required. Note: Allocations made by the C library
+ * itself (e.g., _malloc_r called by printf) are not recorded. The wrappers are not interrupt-safe.
+ */
+#ifndef DOTT_HEAP_TRACE_ENTRIES
+#define DOTT_HEAP_TRACE_ENTRIES 256
+#endif
+
+#define DOTT_HEAP_OP_ALLOC 1U /* ptr: allocated block (0 if the allocation failed), size: requested size */
+#define DOTT_HEAP_OP_FREE  2U /* ptr: released block, size: 0 */
+
+typedef struct {
+    uint32_t op;     /* DOTT_HEAP_OP_xxx */
+    uint32_t ptr;    /* address of the block */
+    uint32_t size;   /* requested size in bytes */
+    uint32_t caller; /* return address of the malloc/calloc/realloc/free call */
+} DOTT_heap_event_t;
+
+typedef struct {
+    volatile uint32_t head; /* number of recorded events (wraps around); events[head % num_entries] is written next */
+    uint32_t num_entries;   /* DOTT_HEAP_TRACE_ENTRIES */
+    DOTT_heap_event_t events[DOTT_HEAP_TRACE_ENTRIES];
+} DOTT_heap_trace_t;
+
+extern DOTT_heap_trace_t DOTT_heap_trace;
+#endif
+
+#if defined(DOTT_IRQ_LATENCY)
+/*
+ * If DOTT_IRQ_LATENCY is defined, interrupt handlers instrumented with DOTT_IRQ_LATENCY_ENTER/EXIT record their entry
+ * latency and duration in the DOTT_irq_latency ring buffer which is read in bulk by the host (see IrqLatency). NOW is
+ * an expression returning the ticks elapsed since the interrupt event, e.g., the counter of the up-counting timer
+ * which raised the interrupt (reset to 0 by the update event) or DOTT_IRQ_LATENCY_SYSTICK in SysTick_Handler. The
+ * application can define DOTT_IRQ_LATENCY_GPIO_SET/CLR to toggle a GPIO during the handler (e.g., to cross-check the
+ * results with an oscilloscope). For example:
+ *     void TIM7_IRQHandler(void)
+ *     {
+ *         DOTT_IRQ_LATENCY_ENTER(TIM7->CNT);
+ *         HAL_TIM_IRQHandler(&htim7);
+ *         DOTT_IRQ_LATENCY_EXIT(TIM7->CNT);
+ *     }
+ */
+#ifndef DOTT_IRQ_LATENCY_ENTRIES
+#define DOTT_IRQ_LATENCY_ENTRIES 1024
+#endif
+#ifndef DOTT_IRQ_LATENCY_GPIO_SET
+#define DOTT_IRQ_LATENCY_GPIO_SET()
+#endif
+#ifndef DOTT_IRQ_LATENCY_GPIO_CLR
+#define DOTT_IRQ_LATENCY_GPIO_CLR()
+#endif
+
+/* core clock cycles elapsed since the SysTick counter was reloaded (i.e., since the SysTick exception was raised) */
+#define DOTT_IRQ_LATENCY_SYSTICK ((*(volatile uint32_t *)0xE000E014UL) - (*(volatile uint32_t *)0xE000E018UL))
+
+#define DOTT_IRQ_LATENCY_ENTER(NOW) uint32_t DOTT_irq_t_enter_ = (uint32_t) (NOW); DOTT_IRQ_LATENCY_GPIO_SET()
+#define DOTT_IRQ_LATENCY_EXIT(NOW) do { \
+        DOTT_IRQ_LATENCY_GPIO_CLR(); \
+        DOTT_irq_latency_record(DOTT_irq_t_enter_, (uint32_t) (NOW)); \
+    } while (0)
+
+typedef struct {
+    uint32_t latency;  /* ticks from the interrupt event until DOTT_IRQ_LATENCY_ENTER */
+    uint32_t duration; /* ticks from DOTT_IRQ_LATENCY_ENTER until DOTT_IRQ_LATENCY_EXIT */
+} DOTT_irq_sample_t;
+
+typedef struct {
+    volatile uint32_t head; /* number of recorded samples (wraps around); samples[head % num_entries] is written next */
+    uint32_t num_entries;   /* DOTT_IRQ_LATENCY_ENTRIES */
+    DOTT_irq_sample_t samples[DOTT_IRQ_LATENCY_ENTRIES];
+} DOTT_irq_latency_t;
+
+extern DOTT_irq_latency_t DOTT_irq_latency;
+
+/*
+ * Adds a sample to DOTT_irq_latency (used by DOTT_IRQ_LATENCY_EXIT). Safe to be called from nested interrupts.
+ */
+void DOTT_irq_latency_record(uint32_t t_enter, uint32_t t_exit);
+#endif
+
+#if defined(DOTT_DEFERRED_LOG)
+/*
+ * If DOTT_DEFERRED_LOG is defined, DOTT_LOG(FMT, ...) provides printf-style logging whose formatting is deferred to
+ * the host (see DeferredLog). A call only writes the address of the format string and the (up to DOTT_LOG_MAX_ARGS)
+ * arguments as 32 bit words into the DOTT_log ring buffer from which the host drains the records in bulk (while the
+ * target is halted or via live access). The format strings are placed in the DOTT_LOG_FMT_SECTION section which the
+ * host reads from the ELF file. If the linker script declares the section as non-loaded, the format strings take no
+ * target memory at all (GCC: .dott_log_fmt 0 (INFO) : { KEEP(*(.dott_log_fmt)) }). Arguments are integers or
+ * pointers (cast to uint32_t); floats are passed with DOTT_LOG_F32. Strings (%s) are resolved by the host from the
+ * ELF file (e.g., string literals) or the target memory at the time the record is drained. For example:
+ *     DOTT_LOG("adc ch%u: %d mV (gain %f)", ch, mv, DOTT_LOG_F32(gain));
+ * If DOTT_LOG_TIMESTAMP is defined (e.g., -DDOTT_LOG_TIMESTAMP=DWT->CYCCNT), each record also carries the value of this
+ * expression. If the buffer is full, records are discarded (and counted) until the host has drained the buffer.
+ */
+#ifndef DOTT_LOG_BUFFER_WORDS
+#define DOTT_LOG_BUFFER_WORDS 1024
+#endif
+#ifndef DOTT_LOG_FMT_SECTION
+#define DOTT_LOG_FMT_SECTION ".dott_log_fmt"
+#endif
+
+#define DOTT_LOG_MAX_ARGS 7U
+#define DOTT_LOG_FLAG_TIMESTAMP 1U /* each record carries a timestamp word after the header word */
+
+/*
+ * Each record consists of a header word (address of the format string which is aligned to 8 bytes, number of
+ * arguments in bits 0..2), the timestamp (if enabled) and the arguments.
+ */
+typedef struct {
+    volatile uint32_t head;    /* number of words written (wraps around); words[head % num_words] is written next */
+    volatile uint32_t tail;    /* number of words drained by the host */
+    uint32_t num_words;        /* DOTT_LOG_BUFFER_WORDS */
+    uint32_t flags;            /* DOTT_LOG_FLAG_xxx */
+    volatile uint32_t dropped; /* number of records discarded since the buffer was full */
+    uint32_t words[DOTT_LOG_BUFFER_WORDS];
+} DOTT_log_t;
+
+extern DOTT_log_t DOTT_log;
+
+#define DOTT_LOG(FMT, ...) do { \
+        static const char DOTT_log_fmt_[] __attribute__((section(DOTT_LOG_FMT_SECTION), aligned(8), used)) = FMT; \
+        const uint32_t DOTT_log_args_[] = {0U, __VA_ARGS__}; \
+        const uint32_t DOTT_log_num_args_ = (uint32_t) (sizeof(DOTT_log_args_) / sizeof(uint32_t)) - 1U; \
+        (void) sizeof(char[DOTT_log_num_args_ <= DOTT_LOG_MAX_ARGS ? 1 : -1]); \
+        DOTT_log_write((uint32_t) DOTT_log_fmt_ | DOTT_log_num_args_, &DOTT_log_args_[1], DOTT_log_num_args_); \
+    } while (0)
+
+/* bit pattern of a float argument (formatted with %f, %e or %g) */
+#define DOTT_LOG_F32(X) DOTT_log_f32(X)
+
+static inline uint32_t DOTT_log_f32(float value)
+{
+    union { float f; uint32_t u; } v;
+    v.f = value;
+    return v.u;
+}
+
+/*
+ * Adds a record to DOTT_log (used by DOTT_LOG). Safe to be called from interrupt handlers.
+ */
+void DOTT_log_write(uint32_t header, const uint32_t *args, uint32_t num_args);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
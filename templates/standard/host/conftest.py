@@ -56,6 +56,14 @@ def set_config_options():
 # set host-specific parameters
 set_config_options()
 
-# re-target fixtures
-target_reset = target_reset_flash
-target_load = target_load_flash
+# re-target fixtures; if the DOTT_RUN_SRAM environment variable is 'yes', the tests are executed with the SRAM-based
+# binary (dott_template_std_sram, see target/Makefile) which is downloaded without flash programming
+if os.environ.get('DOTT_RUN_SRAM', '').lower() == 'yes':
+    DottConf.set('exec_type', 'SRAM')
+    DottConf.set('app_load_elf', '../target/build/dott_template_std_sram/dott_template_std_sram.bin.elf')
+    DottConf.set('app_symbol_elf', '../target/build/dott_template_std_sram/dott_template_std_sram.axf')
+    target_reset = target_reset_sram
+    target_load = target_load_sram
+else:
+    target_reset = target_reset_flash
+    target_load = target_load_flash